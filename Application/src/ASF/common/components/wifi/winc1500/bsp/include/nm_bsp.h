@@ -281,6 +281,16 @@ void nm_bsp_register_isr(tpfNmBspIsr pfIsr);
 void nm_bsp_interrupt_ctrl(uint8 u8Enable);
   /**@}*/
 
+/*!
+ * @fn           void nm_bsp_app_isr_hook(void);
+ * @brief        Called from the WINC interrupt after the HIF ISR has run.
+ *				 The default implementation does nothing. The application can override it to wake the task that calls
+ *				 m2m_wifi_handle_events, so that task can block instead of polling the driver.
+ * @note         Runs in interrupt context.
+ * @return       None
+ */
+void nm_bsp_app_isr_hook(void);
+
 #ifdef __cplusplus
 }
 #endif
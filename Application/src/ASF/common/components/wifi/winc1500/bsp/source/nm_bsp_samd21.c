@@ -40,11 +40,16 @@
 
 static tpfNmBspIsr gpfIsr;
 
+WEAK void nm_bsp_app_isr_hook(void)
+{
+}
+
 static void chip_isr(void)
 {
 	if (gpfIsr) {
 		gpfIsr();
 	}
+	nm_bsp_app_isr_hook();
 }
 
 /*
@@ -120,18 +120,19 @@ enum status_code crc32_recalculate(const void *data, size_t length, crc32_t *crc
 	crc32_t temp_crc = COMPLEMENT_CRC(*crc);
 	word_t word;
 
-	// Calculate for initial bytes to get word-aligned
-	if (length < WORD_SIZE) {
+	// Calculate for initial bytes to get word-aligned. A buffer shorter than a word may start and end
+	// inside one word, so the bytes are shifted down from where they start rather than from the word end.
+	temp_length = ~WORD_ALIGNMENT_MASK & (WORD_SIZE - (uintptr_t)data);
+	if (temp_length > length) {
 		temp_length = length;
-	} else {
-		temp_length = ~WORD_ALIGNMENT_MASK & (WORD_SIZE - (uintptr_t)data);
 	}
 
 	if (temp_length) {
 		length -= temp_length;
 
 		word = *(word_ptr++);
-		word >>= 8 * (WORD_SIZE - temp_length);
+		word >>= 8 * (~WORD_ALIGNMENT_MASK & (uintptr_t)data);
+		word &= 0xffffffffUL >> (8 * (WORD_SIZE - temp_length));
 		temp_crc = _crc32_recalculate_bytes_helper(word, temp_crc, temp_length);
 	}
 
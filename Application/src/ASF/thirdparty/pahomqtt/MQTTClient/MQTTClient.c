@@ -15,6 +15,11 @@
  *    Microchip Technologies            - Fixed crash issues in subscribe function
  *******************************************************************************/
 #include "MQTTClient.h"
+#include <string.h>
+
+#define MQTT_DISPATCH_LEVEL 0
+#define MQTT_DISPATCH_PLUS  1
+#define MQTT_DISPATCH_HASH  2
 
 /*Function prototypes to remove build warnings*/
 int deliverMessage(MQTTClient* c, MQTTString* topicName, MQTTMessage* message);
@@ -22,6 +27,9 @@ int keepalive(MQTTClient* c);
 int cycle(MQTTClient* c, Timer* timer);
 void MQTTRun(void* parm);
 int waitfor(MQTTClient* c, int packet_type, Timer* timer);
+static void retransmit(MQTTClient* c);
+static int handlePacket(MQTTClient* c, int packet_type, Timer* timer);
+static void dispatchBuild(MQTTClient* c);
 
 
 static void NewMessageData(MessageData* md, MQTTString* aTopicName, MQTTMessage* aMessage) {
@@ -30,19 +38,34 @@ static void NewMessageData(MessageData* md, MQTTString* aTopicName, MQTTMessage*
 }
 
 
+static MQTTInflight* findInflight(MQTTClient *c, unsigned short id) {
+    int i;
+    for (i = 0; i < c->inflight_window; ++i)
+    {
+        if (c->inflight[i].id == id)
+            return &c->inflight[i];
+    }
+    return NULL;
+}
+
+
 static int getNextPacketId(MQTTClient *c) {
-    return c->next_packetid = (c->next_packetid == MAX_PACKET_ID) ? 1 : c->next_packetid + 1;
+    do
+    {
+        c->next_packetid = (c->next_packetid == MAX_PACKET_ID) ? 1 : c->next_packetid + 1;
+    } while (findInflight(c, c->next_packetid) != NULL); // never reuse an id that is still waiting for its ack
+    return c->next_packetid;
 }
 
 
-static int sendPacket(MQTTClient* c, int length, Timer* timer)
+static int sendBuffer(MQTTClient* c, unsigned char* buf, int length, Timer* timer)
 {
     int rc = FAILURE, 
         sent = 0;
     
     while (sent < length && !TimerIsExpired(timer))
     {
-        rc = c->ipstack->mqttwrite(c->ipstack, &c->buf[sent], length, TimerLeftMS(timer));
+        rc = c->ipstack->mqttwrite(c->ipstack, &buf[sent], length - sent, TimerLeftMS(timer));
         if (rc < 0)  // there was an error writing the data
             break;
         sent += rc;
@@ -58,6 +81,12 @@ static int sendPacket(MQTTClient* c, int length, Timer* timer)
 }
 
 
+static int sendPacket(MQTTClient* c, int length, Timer* timer)
+{
+    return sendBuffer(c, c->buf, length, timer);
+}
+
+
 void MQTTClientInit(MQTTClient* c, Network* network, unsigned int command_timeout_ms,
 		unsigned char* sendbuf, size_t sendbuf_size, unsigned char* readbuf, size_t readbuf_size)
 {
@@ -66,6 +95,7 @@ void MQTTClientInit(MQTTClient* c, Network* network, unsigned int command_timeou
     
     for (i = 0; i < MAX_MESSAGE_HANDLERS; ++i)
         c->messageHandlers[i].topicFilter = 0;
+    dispatchBuild(c);
     c->command_timeout_ms = command_timeout_ms;
     c->buf = sendbuf;
     c->buf_size = sendbuf_size;
@@ -75,65 +105,79 @@ void MQTTClientInit(MQTTClient* c, Network* network, unsigned int command_timeou
     c->ping_outstanding = 0;
     c->defaultMessageHandler = NULL;
 	c->next_packetid = 1;
+    c->inflight_window = 0;
+    c->inflight_slot_size = 0;
+    for (i = 0; i < MAX_INFLIGHT_PUBLISH; ++i)
+        c->inflight[i].id = 0;
+    c->read_len = 0;
+    c->read_rem_len = 0;
+    c->read_hdr_len = 0;
     TimerInit(&c->ping_timer);
+    TimerInit(&c->pingresp_timer);
 #if defined(MQTT_TASK)
 	MutexInit(&c->mutex);
 #endif
 }
 
 
-static int decodePacket(MQTTClient* c, int* value, int timeout)
+static int resetPacket(MQTTClient* c, int rc)
+{
+    c->read_len = 0;
+    c->read_rem_len = 0;
+    c->read_hdr_len = 0;
+    return rc;
+}
+
+
+/* Add whatever the network has already received to the packet being assembled in readbuf.
+ * Returns the packet type once the whole packet is in readbuf, 0 if more bytes are needed,
+ * or a negative code if the stream is broken. Never waits, so it can be called on every event. */
+static int readPacketPoll(MQTTClient* c)
 {
-    unsigned char i;
-    int multiplier = 1;
-    int len = 0;
     const int MAX_NO_OF_REMAINING_LENGTH_BYTES = 4;
+    MQTTHeader header = {0};
+    int total, rc;
 
-    *value = 0;
-    do
+    /* 1. the header byte and the remaining length, one byte at a time since the length is variable in itself */
+    while (c->read_hdr_len == 0)
     {
-        int rc = MQTTPACKET_READ_ERROR;
+        unsigned char* next = c->readbuf + c->read_len;
+
+        if ((rc = c->ipstack->mqttpoll(c->ipstack, next, 1)) <= 0)
+            return (rc < 0) ? resetPacket(c, rc) : 0;
+        if (++c->read_len == 1)
+            continue;
+        c->read_rem_len += (*next & 127) << (7 * (c->read_len - 2));
+        if ((*next & 128) == 0)
+            c->read_hdr_len = c->read_len;
+        else if (c->read_len > MAX_NO_OF_REMAINING_LENGTH_BYTES)
+            return resetPacket(c, MQTTPACKET_READ_ERROR); /* bad data */
+    }
 
-        if (++len > MAX_NO_OF_REMAINING_LENGTH_BYTES)
-        {
-            rc = MQTTPACKET_READ_ERROR; /* bad data */
-            goto exit;
-        }
-        rc = c->ipstack->mqttread(c->ipstack, &i, 1, timeout);
-        if (rc != 1)
-            goto exit;
-        *value += (i & 127) * multiplier;
-        multiplier *= 128;
-    } while ((i & 128) != 0);
-exit:
-    return len;
+    /* 2. the rest of the packet, as much of it as has arrived */
+    total = c->read_hdr_len + c->read_rem_len;
+    if (total > (int)c->readbuf_size)
+        return resetPacket(c, BUFFER_OVERFLOW);
+    while (c->read_len < total)
+    {
+        if ((rc = c->ipstack->mqttpoll(c->ipstack, c->readbuf + c->read_len, total - c->read_len)) <= 0)
+            return (rc < 0) ? resetPacket(c, rc) : 0;
+        c->read_len += rc;
+    }
+
+    /* the packet stays in readbuf until the next call starts assembling another one */
+    header.byte = c->readbuf[0];
+    return resetPacket(c, header.bits.type);
 }
 
 
 static int readPacket(MQTTClient* c, Timer* timer)
 {
-    int rc = FAILURE;
-    MQTTHeader header = {0};
-    int len = 0;
-    int rem_len = 0;
-
-    /* 1. read the header byte.  This has the packet type in it */
-    if (c->ipstack->mqttread(c->ipstack, c->readbuf, 1, TimerLeftMS(timer)) != 1)
-        goto exit;
+    int rc;
 
-    len = 1;
-    /* 2. read the remaining length.  This is variable in itself */
-    decodePacket(c, &rem_len, TimerLeftMS(timer));
-    len += MQTTPacket_encode(c->readbuf + 1, rem_len); /* put the original remaining length back into the buffer */
-
-    /* 3. read the rest of the buffer using a callback to supply the rest of the data */
-    if (rem_len > 0 && (c->ipstack->mqttread(c->ipstack, c->readbuf + len, rem_len, TimerLeftMS(timer)) != rem_len))
-        goto exit;
-
-    header.byte = c->readbuf[0];
-    rc = header.bits.type;
-exit:
-    return rc;
+    while ((rc = readPacketPoll(c)) == 0 && !TimerIsExpired(timer))
+        ;
+    return (rc == 0) ? FAILURE : rc;
 }
 
 
@@ -168,15 +212,160 @@ static char isTopicMatched(char* topicFilter, MQTTString* topicName)
 }
 
 
+static unsigned int hashBytes(const char* s, int len)
+{
+    unsigned int h = 2166136261u; // FNV-1a
+    while (len-- > 0)
+        h = (h ^ (unsigned char)*s++) * 16777619u;
+    return h;
+}
+
+
+static int dispatchInsert(MQTTDispatch* d, const char* filter, int handler)
+{
+    const char* level = filter;
+    int node = 0;
+
+    while (1)
+    {
+        const char* end = level;
+        unsigned char type = MQTT_DISPATCH_LEVEL;
+        unsigned int hash = 0;
+        int child;
+
+        while (*end && *end != '/')
+            end++;
+        if (end - level == 1 && *level == '+')
+            type = MQTT_DISPATCH_PLUS;
+        else if (end - level == 1 && *level == '#')
+            type = MQTT_DISPATCH_HASH;
+        else
+            hash = hashBytes(level, end - level);
+
+        for (child = d->nodes[node].child; child != 0; child = d->nodes[child].sibling)
+        {
+            if (d->nodes[child].type == type && d->nodes[child].hash == hash)
+                break;
+        }
+        if (child == 0)
+        {
+            if (d->node_count > MQTT_DISPATCH_NODES)
+                return FAILURE;
+            child = d->node_count++;
+            d->nodes[child].hash = hash;
+            d->nodes[child].handlers = 0;
+            d->nodes[child].type = type;
+            d->nodes[child].child = 0;
+            d->nodes[child].sibling = d->nodes[node].child;
+            d->nodes[node].child = child;
+        }
+        node = child;
+        if (*end == '\0')
+            break;
+        level = end + 1;
+    }
+    d->nodes[node].handlers |= 1UL << handler;
+    return SUCCESS;
+}
+
+
+/* exact filters go into an open addressing hash table, wildcard filters into a trie of topic levels */
+static void dispatchBuild(MQTTClient* c)
+{
+    MQTTDispatch* d = &c->dispatch;
+    int i;
+
+    memset(d->exact_handler, -1, sizeof(d->exact_handler));
+    memset(&d->nodes[0], 0, sizeof(d->nodes[0]));
+    d->node_count = 1;
+    d->overflow = 0;
+    d->wildcards = 0;
+
+    for (i = 0; i < MAX_MESSAGE_HANDLERS; ++i)
+    {
+        const char* filter = c->messageHandlers[i].topicFilter;
+        if (filter == 0)
+            continue;
+        if (strpbrk(filter, "+#") == NULL)
+        {
+            unsigned int hash = hashBytes(filter, strlen(filter));
+            int slot = hash & (MQTT_DISPATCH_SLOTS - 1);
+            while (d->exact_handler[slot] >= 0) // always terminates, there are more slots than handlers
+                slot = (slot + 1) & (MQTT_DISPATCH_SLOTS - 1);
+            d->exact_hash[slot] = hash;
+            d->exact_handler[slot] = i;
+        }
+        else
+        {
+            d->wildcards |= 1UL << i;
+            if (!d->overflow && dispatchInsert(d, filter, i) != SUCCESS)
+                d->overflow = 1;
+        }
+    }
+}
+
+
+static unsigned long dispatchTrie(MQTTDispatch* d, int node, const char* level, const char* end)
+{
+    const char* sep = level;
+    unsigned long handlers = 0;
+    unsigned int hash;
+    int child;
+
+    while (sep < end && *sep != '/')
+        sep++;
+    hash = hashBytes(level, sep - level);
+
+    for (child = d->nodes[node].child; child != 0; child = d->nodes[child].sibling)
+    {
+        MQTTDispatchNode* n = &d->nodes[child];
+        if (n->type == MQTT_DISPATCH_HASH)
+            handlers |= n->handlers; // '#' takes this level and everything below it
+        else if (n->type == MQTT_DISPATCH_PLUS || n->hash == hash)
+        {
+            if (sep == end)
+                handlers |= n->handlers;
+            else
+                handlers |= dispatchTrie(d, child, sep + 1, end);
+        }
+    }
+    return handlers;
+}
+
+
+/* candidates only: hashes can collide, so deliverMessage still checks each filter before calling its handler */
+static unsigned long dispatchMatch(MQTTClient* c, MQTTString* topicName)
+{
+    MQTTDispatch* d = &c->dispatch;
+    const char* name = topicName->lenstring.data;
+    int len = topicName->lenstring.len;
+    unsigned int hash = hashBytes(name, len);
+    unsigned long handlers = 0;
+    int slot;
+
+    for (slot = hash & (MQTT_DISPATCH_SLOTS - 1); d->exact_handler[slot] >= 0; slot = (slot + 1) & (MQTT_DISPATCH_SLOTS - 1))
+    {
+        if (d->exact_hash[slot] == hash)
+            handlers |= 1UL << d->exact_handler[slot];
+    }
+    if (d->overflow)
+        handlers |= d->wildcards;
+    else if (d->nodes[0].child != 0)
+        handlers |= dispatchTrie(d, 0, name, name + len);
+    return handlers;
+}
+
+
 int deliverMessage(MQTTClient* c, MQTTString* topicName, MQTTMessage* message)
 {
     int i;
     int rc = FAILURE;
+    unsigned long candidates = dispatchMatch(c, topicName);
 
     // we have to find the right message handler - indexed by topic
-    for (i = 0; i < MAX_MESSAGE_HANDLERS; ++i)
+    for (i = 0; candidates != 0; ++i, candidates >>= 1)
     {
-        if (c->messageHandlers[i].topicFilter != 0 && (MQTTPacket_equals(topicName, (char*)c->messageHandlers[i].topicFilter) ||
+        if ((candidates & 1) && (MQTTPacket_equals(topicName, (char*)c->messageHandlers[i].topicFilter) ||
                 isTopicMatched((char*)c->messageHandlers[i].topicFilter, topicName)))
         {
             if (c->messageHandlers[i].fp != NULL)
@@ -201,27 +390,33 @@ int deliverMessage(MQTTClient* c, MQTTString* topicName, MQTTMessage* message)
 }
 
 
+/* Returns FAILURE only when the connection has to be considered lost: the ping could not be sent,
+ * or the broker has not answered it within another keepalive interval */
 int keepalive(MQTTClient* c)
 {
-    int rc = FAILURE;
+    int rc = SUCCESS;
 
     if (c->keepAliveInterval == 0)
-    {
-        rc = SUCCESS;
         goto exit;
-    }
 
-    if (TimerIsExpired(&c->ping_timer))
+    if (c->ping_outstanding)
+    {
+        if (TimerIsExpired(&c->pingresp_timer))
+            rc = FAILURE;
+    }
+    else if (TimerIsExpired(&c->ping_timer))
     {
-        if (!c->ping_outstanding)
+        Timer timer;
+        TimerInit(&timer);
+        TimerCountdownMS(&timer, 1000);
+        int len = MQTTSerialize_pingreq(c->buf, c->buf_size);
+        if (len > 0 && (rc = sendPacket(c, len, &timer)) == SUCCESS) // send the ping packet
         {
-            Timer timer;
-            TimerInit(&timer);
-            TimerCountdownMS(&timer, 1000);
-            int len = MQTTSerialize_pingreq(c->buf, c->buf_size);
-            if (len > 0 && (rc = sendPacket(c, len, &timer)) == SUCCESS) // send the ping packet
-                c->ping_outstanding = 1;
+            c->ping_outstanding = 1;
+            TimerCountdown(&c->pingresp_timer, c->keepAliveInterval);
         }
+        else
+            rc = FAILURE;
     }
 
 exit:
@@ -233,16 +428,37 @@ int cycle(MQTTClient* c, Timer* timer)
 {
     // read the socket, see what work is due
     unsigned short packet_type = readPacket(c, timer);
-    
+    int rc = handlePacket(c, packet_type, timer);
+
+    if (rc == FAILURE)
+        return rc;
+    keepalive(c);
+    retransmit(c);
+    return packet_type;
+}
+
+
+static int handlePacket(MQTTClient* c, int packet_type, Timer* timer)
+{
     int len = 0,
         rc = SUCCESS;
 
     switch (packet_type)
     {
         case CONNACK:
-        case PUBACK:
         case SUBACK:
             break;
+        case PUBACK:
+        {
+            // free the inflight slot of a pipelined publish; a blocking MQTTPublish matches its own id in readbuf
+            unsigned short mypacketid;
+            unsigned char dup, type;
+            MQTTInflight* slot;
+            if (MQTTDeserialize_ack(&type, &dup, &mypacketid, c->readbuf, c->readbuf_size) == 1 &&
+                (slot = findInflight(c, mypacketid)) != NULL)
+                slot->id = 0;
+            break;
+        }
         case PUBLISH:
         {
             MQTTString topicName;
@@ -288,14 +504,70 @@ int cycle(MQTTClient* c, Timer* timer)
             c->ping_outstanding = 0;
             break;
     }
-    keepalive(c);
 exit:
-    if (rc == SUCCESS)
-        rc = packet_type;
     return rc;
 }
 
 
+int MQTTPoll(MQTTClient* c)
+{
+    int rc = SUCCESS,
+        packet_type;
+    Timer timer;
+
+    if (!c->isconnected)
+        return FAILURE;
+
+#if defined(MQTT_TASK)
+	MutexLock(&c->mutex);
+#endif
+    TimerInit(&timer);
+    TimerCountdownMS(&timer, c->command_timeout_ms); // bounds the acks sent back for received packets
+
+    // handle every packet that is already complete, then return without waiting for more
+    while ((packet_type = readPacketPoll(c)) > 0)
+    {
+        if ((rc = handlePacket(c, packet_type, &timer)) == FAILURE)
+            goto exit;
+    }
+    if (packet_type < 0 || keepalive(c) == FAILURE)
+    {
+        rc = FAILURE;
+        goto exit;
+    }
+    retransmit(c);
+
+exit:
+#if defined(MQTT_TASK)
+	MutexUnlock(&c->mutex);
+#endif
+    return rc;
+}
+
+
+int MQTTNextDeadlineMS(MQTTClient* c)
+{
+    int i,
+        left = -1;
+
+    if (!c->isconnected)
+        return -1;
+
+    if (c->keepAliveInterval > 0)
+        left = TimerLeftMS(c->ping_outstanding ? &c->pingresp_timer : &c->ping_timer);
+    for (i = 0; i < c->inflight_window; ++i)
+    {
+        if (c->inflight[i].id != 0)
+        {
+            int slot_left = TimerLeftMS(&c->inflight[i].retry_timer);
+            if (left < 0 || slot_left < left)
+                left = slot_left;
+        }
+    }
+    return left;
+}
+
+
 int MQTTYield(MQTTClient* c, int timeout_ms)
 {
     int rc = SUCCESS;
@@ -346,6 +618,26 @@ int MQTTStartTask(MQTTClient* client)
 #endif
 
 
+static void retransmit(MQTTClient* c)
+{
+    int i;
+
+    for (i = 0; i < c->inflight_window; ++i)
+    {
+        MQTTInflight* slot = &c->inflight[i];
+        if (slot->id != 0 && TimerIsExpired(&slot->retry_timer))
+        {
+            Timer timer;
+            TimerInit(&timer);
+            TimerCountdownMS(&timer, 1000);
+            slot->packet[0] |= 0x08; // DUP flag of the fixed header
+            sendBuffer(c, slot->packet, slot->len, &timer);
+            TimerCountdownMS(&slot->retry_timer, INFLIGHT_RETRY_MS);
+        }
+    }
+}
+
+
 int waitfor(MQTTClient* c, int packet_type, Timer* timer)
 {
     int rc = FAILURE;
@@ -381,7 +673,9 @@ int MQTTConnect(MQTTClient* c, MQTTPacket_connectData* options)
         options = &default_options; /* set default options if none were supplied */
     
     c->keepAliveInterval = options->keepAliveInterval;
+    c->ping_outstanding = 0;
     TimerCountdown(&c->ping_timer, c->keepAliveInterval);
+    resetPacket(c, SUCCESS); // nothing left over from a previous connection
     if ((len = MQTTSerialize_connect(c->buf, c->buf_size, options)) <= 0)
         goto exit;
     if ((rc = sendPacket(c, len, &connect_timer)) != SUCCESS)  // send the connect packet
@@ -402,7 +696,13 @@ int MQTTConnect(MQTTClient* c, MQTTPacket_connectData* options)
     
 exit:
     if (rc == SUCCESS)
+    {
+        int i;
         c->isconnected = 1;
+        // publishes left over from the last connection go out again on the next cycle
+        for (i = 0; i < c->inflight_window; ++i)
+            TimerCountdownMS(&c->inflight[i].retry_timer, 0);
+    }
 
 #if defined(MQTT_TASK)
 	MutexUnlock(&c->mutex);
@@ -452,6 +752,7 @@ int MQTTSubscribe(MQTTClient* c, const char* topicFilter, enum QoS qos, messageH
                 {
                     c->messageHandlers[i].topicFilter = topicFilter;
                     c->messageHandlers[i].fp = msgHandler;
+                    dispatchBuild(c);
                     rc = 0;
                     break;
                 }
@@ -495,7 +796,16 @@ int MQTTUnsubscribe(MQTTClient* c, const char* topicFilter)
     {
         unsigned short mypacketid;  // should be the same as the packetid above
         if (MQTTDeserialize_unsuback(&mypacketid, c->readbuf, c->readbuf_size) == 1)
-            rc = 0; 
+        {
+            int i;
+            for (i = 0; i < MAX_MESSAGE_HANDLERS; ++i)
+            {
+                if (c->messageHandlers[i].topicFilter != 0 && strcmp(c->messageHandlers[i].topicFilter, topicFilter) == 0)
+                    c->messageHandlers[i].topicFilter = 0;
+            }
+            dispatchBuild(c);
+            rc = 0;
+        }
     }
     else
         rc = FAILURE;
@@ -537,15 +847,20 @@ int MQTTPublish(MQTTClient* c, const char* topicName, MQTTMessage* message)
     
     if (message->qos == QOS1)
     {
-        if (waitfor(c, PUBACK, &timer) == PUBACK)
+        rc = FAILURE;
+        // PUBACKs of pipelined publishes may arrive first, keep waiting for ours
+        while (waitfor(c, PUBACK, &timer) == PUBACK)
         {
             unsigned short mypacketid;
             unsigned char dup, type;
             if (MQTTDeserialize_ack(&type, &dup, &mypacketid, c->readbuf, c->readbuf_size) != 1)
-                rc = FAILURE;
+                break;
+            if (mypacketid == message->id)
+            {
+                rc = SUCCESS;
+                break;
+            }
         }
-        else
-            rc = FAILURE;
     }
     else if (message->qos == QOS2)
     {
@@ -568,6 +883,91 @@ exit:
 }
 
 
+int MQTTSetInflightWindow(MQTTClient* c, int window, unsigned char* buf, size_t slot_size)
+{
+    int i;
+
+    if (window == c->inflight_window && slot_size == c->inflight_slot_size && c->inflight_window > 0 &&
+        buf == c->inflight[0].packet)
+        return SUCCESS; // same window set again, the publishes in it are kept
+    if (window < 1 || window > MAX_INFLIGHT_PUBLISH || buf == NULL || MQTTInflightCount(c) != 0)
+        return FAILURE;
+
+    for (i = 0; i < window; ++i)
+    {
+        c->inflight[i].id = 0;
+        c->inflight[i].packet = buf + i * slot_size;
+        TimerInit(&c->inflight[i].retry_timer);
+    }
+    c->inflight_slot_size = slot_size;
+    c->inflight_window = window;
+    return SUCCESS;
+}
+
+
+int MQTTInflightCount(MQTTClient* c)
+{
+    int i, count = 0;
+
+    for (i = 0; i < c->inflight_window; ++i)
+    {
+        if (c->inflight[i].id != 0)
+            count++;
+    }
+    return count;
+}
+
+
+int MQTTPublishAsync(MQTTClient* c, const char* topicName, MQTTMessage* message)
+{
+    int rc = FAILURE;
+    Timer timer;
+    MQTTString topic = MQTTString_initializer;
+    topic.cstring = (char *)topicName;
+    MQTTInflight* slot = NULL;
+    int len = 0;
+
+    if (message->qos == QOS0)
+        return MQTTPublish(c, topicName, message);
+    if (message->qos != QOS1 || c->inflight_window == 0)
+        return FAILURE;
+
+#if defined(MQTT_TASK)
+	MutexLock(&c->mutex);
+#endif
+	if (!c->isconnected)
+		goto exit;
+
+    TimerInit(&timer);
+    TimerCountdownMS(&timer, c->command_timeout_ms);
+
+    // window full: keep reading acks until a slot frees up
+    while ((slot = findInflight(c, 0)) == NULL)
+    {
+        if (TimerIsExpired(&timer) || cycle(c, &timer) == FAILURE)
+            goto exit;
+    }
+
+    message->id = getNextPacketId(c);
+    len = MQTTSerialize_publish(slot->packet, c->inflight_slot_size, 0, message->qos, message->retained, message->id,
+              topic, (unsigned char*)message->payload, message->payloadlen);
+    if (len <= 0)
+        goto exit;
+    if ((rc = sendBuffer(c, slot->packet, len, &timer)) != SUCCESS)
+        goto exit;
+
+    slot->id = message->id;
+    slot->len = len;
+    TimerCountdownMS(&slot->retry_timer, INFLIGHT_RETRY_MS);
+
+exit:
+#if defined(MQTT_TASK)
+	MutexUnlock(&c->mutex);
+#endif
+    return rc;
+}
+
+
 int MQTTDisconnect(MQTTClient* c)
 {  
     int rc = FAILURE;
@@ -51,7 +51,29 @@
 #define MAX_PACKET_ID 65535 /* according to the MQTT specification - do not change! */
 
 #if !defined(MAX_MESSAGE_HANDLERS)
-#define MAX_MESSAGE_HANDLERS 5 /* redefinable - how many subscriptions do you want? */
+#define MAX_MESSAGE_HANDLERS 16 /* redefinable - how many subscriptions do you want? */
+#endif
+#if MAX_MESSAGE_HANDLERS > 32
+#error "MAX_MESSAGE_HANDLERS is limited to 32, the dispatch table keeps handlers in a 32 bit mask"
+#endif
+
+#if !defined(MQTT_DISPATCH_SLOTS)
+#define MQTT_DISPATCH_SLOTS 32 /* redefinable - exact topic hash slots, a power of two larger than MAX_MESSAGE_HANDLERS */
+#endif
+#if (MQTT_DISPATCH_SLOTS & (MQTT_DISPATCH_SLOTS - 1)) != 0 || MQTT_DISPATCH_SLOTS <= MAX_MESSAGE_HANDLERS
+#error "MQTT_DISPATCH_SLOTS must be a power of two larger than MAX_MESSAGE_HANDLERS"
+#endif
+
+#if !defined(MQTT_DISPATCH_NODES)
+#define MQTT_DISPATCH_NODES MAX_MESSAGE_HANDLERS /* redefinable - wildcard trie levels; when exceeded, wildcards are matched linearly */
+#endif
+
+#if !defined(MAX_INFLIGHT_PUBLISH)
+#define MAX_INFLIGHT_PUBLISH 2 /* redefinable - how many QoS 1 publishes may wait for their PUBACK at once */
+#endif
+
+#if !defined(INFLIGHT_RETRY_MS)
+#define INFLIGHT_RETRY_MS 5000 /* redefinable - resend an unacknowledged QoS 1 publish with DUP set after this long */
 #endif
 
 enum QoS { QOS0, QOS1, QOS2 };
@@ -65,6 +87,7 @@ enum returnCode { BUFFER_OVERFLOW = -2, FAILURE = -1, SUCCESS = 0 };
 typedef struct Network
 {
 	int (*mqttread)(Network*, unsigned char* read_buffer, int, int);
+	int (*mqttpoll)(Network*, unsigned char* read_buffer, int);  // non-blocking: bytes already received, 0 if none
 	int (*mqttwrite)(Network*, unsigned char* send_buffer, int, int);
 } Network;*/
 
@@ -94,6 +117,37 @@ typedef struct MessageData
 
 typedef void (*messageHandler)(MessageData*);
 
+/* A QoS 1 publish sent by MQTTPublishAsync that has not been acknowledged yet */
+typedef struct MQTTInflight
+{
+    unsigned short id;      /* packet id, 0 when the slot is free */
+    int len;                /* length of the serialized packet */
+    unsigned char* packet;  /* serialized PUBLISH, kept for retransmission */
+    Timer retry_timer;
+} MQTTInflight;
+
+/* One topic level of a wildcard subscription. Levels are compared by hash only; a handler found through the
+ * trie is confirmed against its full filter before it is called. */
+typedef struct MQTTDispatchNode
+{
+    unsigned int hash;                  /* FNV-1a of the level text, 0 for '+' and '#' */
+    unsigned long handlers;             /* messageHandlers[] bits of the filters that end at this level */
+    unsigned char type;                 /* MQTT_DISPATCH_LEVEL, _PLUS or _HASH */
+    unsigned char child;                /* first node one level down, 0 for none (node 0 is the root) */
+    unsigned char sibling;              /* next node with the same parent, 0 for none */
+} MQTTDispatchNode;
+
+/* Lookup structure rebuilt from messageHandlers[] whenever a subscription is added or removed */
+typedef struct MQTTDispatch
+{
+    unsigned int exact_hash[MQTT_DISPATCH_SLOTS];       /* FNV-1a of topic filters without wildcards */
+    signed char exact_handler[MQTT_DISPATCH_SLOTS];     /* messageHandlers[] index, -1 marks an empty slot */
+    MQTTDispatchNode nodes[MQTT_DISPATCH_NODES + 1];
+    unsigned char node_count;
+    unsigned char overflow;                             /* trie is full, every wildcard handler is a candidate */
+    unsigned long wildcards;                            /* messageHandlers[] bits of all wildcard filters */
+} MQTTDispatch;
+
 typedef struct MQTTClient
 {
     unsigned int next_packetid,
@@ -111,11 +165,21 @@ typedef struct MQTTClient
         const char* topicFilter;
         void (*fp) (MessageData*);
     } messageHandlers[MAX_MESSAGE_HANDLERS];      /* Message handlers are indexed by subscription topic */
+    MQTTDispatch dispatch;                        /* Finds the handlers of an incoming topic without scanning them all */
 
     void (*defaultMessageHandler) (MessageData*);
 
     Network* ipstack;
     Timer ping_timer;
+    Timer pingresp_timer;                         /* Deadline for the PINGRESP while ping_outstanding */
+
+    int read_len;                                 /* Bytes of the packet being assembled that are in readbuf */
+    int read_rem_len;                             /* Its remaining length, complete once read_hdr_len is set */
+    int read_hdr_len;                             /* Its fixed header size, 0 while the length is still arriving */
+
+    MQTTInflight inflight[MAX_INFLIGHT_PUBLISH];  /* Pipelined QoS 1 publishes, keyed by packet id */
+    int inflight_window;                          /* Number of usable slots, 0 until MQTTSetInflightWindow */
+    size_t inflight_slot_size;
 #if defined(MQTT_TASK)
 	Mutex mutex;
 	Thread thread;
@@ -150,6 +214,32 @@ DLLExport int MQTTConnect(MQTTClient* client, MQTTPacket_connectData* options);
  */
 DLLExport int MQTTPublish(MQTTClient* client, const char*, MQTTMessage*);
 
+/** MQTT Set Inflight Window - give the client storage to keep pipelined QoS 1 publishes until they are acknowledged
+ *  @param client - the client object to use
+ *  @param window - number of publishes that may be in flight at once (1 to MAX_INFLIGHT_PUBLISH)
+ *  @param buf - storage for window serialized packets of slot_size bytes each
+ *  @param slot_size - largest serialized PUBLISH that can be sent with MQTTPublishAsync
+ *  @return success code. Setting the same window again succeeds and keeps the publishes in it; changing it fails
+ *          while publishes are in flight.
+ */
+DLLExport int MQTTSetInflightWindow(MQTTClient* client, int window, unsigned char* buf, size_t slot_size);
+
+/** MQTT Publish Async - send an MQTT publish packet without waiting for the ack.
+ *  QoS 1 publishes are kept in the inflight window until cycle() sees their PUBACK, and are sent again with DUP set
+ *  if no PUBACK arrives within INFLIGHT_RETRY_MS. Blocks only while the window is full.
+ *  @param client - the client object to use
+ *  @param topic - the topic to publish to
+ *  @param message - the message to send. QoS 2 is not supported.
+ *  @return success code
+ */
+DLLExport int MQTTPublishAsync(MQTTClient* client, const char*, MQTTMessage*);
+
+/** MQTT Inflight Count - number of QoS 1 publishes waiting for their PUBACK
+ *  @param client - the client object to use
+ *  @return number of unacknowledged publishes
+ */
+DLLExport int MQTTInflightCount(MQTTClient* client);
+
 /** MQTT Subscribe - send an MQTT subscribe packet and wait for suback before returning.
  *  @param client - the client object to use
  *  @param topicFilter - the topic filter to subscribe to
@@ -178,6 +268,20 @@ DLLExport int MQTTDisconnect(MQTTClient* client);
  */
 DLLExport int MQTTYield(MQTTClient* client, int time);
 
+/** MQTT Poll - handle the packets that have already arrived, send a ping or retransmit if one is due, and return.
+ *  Never waits for data: a packet that is only partly received is kept and completed on a later call.
+ *  Call it whenever the network signals an event or MQTTNextDeadlineMS has passed.
+ *  @param client - the client object to use
+ *  @return success code; FAILURE if the connection is broken or the broker stopped answering pings
+ */
+DLLExport int MQTTPoll(MQTTClient* client);
+
+/** MQTT Next Deadline - time until MQTTPoll has timed work to do (keepalive ping, ping timeout or retransmit)
+ *  @param client - the client object to use
+ *  @return milliseconds until the earliest deadline, 0 if one is due, -1 if there is none
+ */
+DLLExport int MQTTNextDeadlineMS(MQTTClient* client);
+
 #if defined(MQTT_TASK)
 /** MQTT start background thread for a client.  After this, MQTTYield should not be called.
 *  @param client - the client object to use
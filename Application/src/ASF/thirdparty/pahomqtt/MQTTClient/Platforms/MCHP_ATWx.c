@@ -24,7 +24,9 @@
 #include "string.h"
 
 #define IPV4_BYTE(val,index) 	((val >> (index * 8)) & 0xFF)
-#define MQTT_RX_POOL_SIZE		256
+#define MQTT_RX_POOL_SIZE		256	//ring the receive callback fills, must hold a whole MQTT_RX_STAGE_SIZE chunk
+#define MQTT_RX_HEADER_MAX		5	//packet type byte plus at most 4 remaining length bytes
+#define MQTT_RX_STAGE_SIZE		128	//buffer handed to the outstanding recv()
 
 static unsigned long MilliTimer=0;
 static int32_t gi32MQTTBrokerIp=0;
@@ -32,10 +34,17 @@ static int32_t gi32MQTTBrokerRxLen=0;
 static bool gbMQTTBrokerIpresolved=false;
 static bool gbMQTTBrokerConnected=false;
 static bool gbMQTTBrokerSendDone=false;
-static bool gbMQTTBrokerRecvDone=false;
+static bool gbMQTTRxPosted=false;	//a recv() is outstanding on the broker socket
+static bool gbMQTTRxError=false;	//socket closed or failed; the stream is lost
+static unsigned char gcMQTTRxStage[MQTT_RX_STAGE_SIZE];
 static unsigned char gcMQTTRxFIFO[MQTT_RX_POOL_SIZE];
-static uint32_t gu32MQTTRxFIFOPtr=0;
-static uint32_t gu32MQTTRxFIFOLen=0;
+static uint32_t gu32MQTTRxFIFOPtr=0;	//read position in the ring
+static uint32_t gu32MQTTRxFIFOLen=0;	//bytes waiting in the ring
+static unsigned char gcMQTTRxHead[MQTT_RX_HEADER_MAX];	//fixed header of the next packet, held back until its length is known
+static uint32_t gu32MQTTRxHeadLen=0;	//bytes in gcMQTTRxHead
+static uint32_t gu32MQTTRxBodyLeft=0;	//body bytes of the current packet still to come
+static bool gbMQTTRxSkip=false;		//the current packet did not fit and its body is being discarded
+static uint32_t gu32MQTTRxOverruns=0;	//packets discarded because the FIFO was full
 static char *gpcHostAddr;
 
 static bool isMQTTSocket(SOCKET sock)
@@ -55,6 +64,88 @@ static bool isMQTTSocket(SOCKET sock)
 	return false;
 }
 
+static void WINC1500_reset_rx(void)
+{
+	gbMQTTRxPosted=false;
+	gbMQTTRxError=false;
+	gu32MQTTRxFIFOPtr=0;
+	gu32MQTTRxFIFOLen=0;
+	gu32MQTTRxHeadLen=0;
+	gu32MQTTRxBodyLeft=0;
+	gbMQTTRxSkip=false;
+}
+
+static void WINC1500_post_recv(SOCKET sock)
+{
+	//keep exactly one recv() outstanding so received data lands in the FIFO from the socket callback
+	//instead of the client having to ask for it. Only ask for as much as the FIFO can take.
+	uint32_t u32Space = MQTT_RX_POOL_SIZE - gu32MQTTRxFIFOLen;
+
+	if(gbMQTTRxPosted || gbMQTTRxError || (sock < 0) || (u32Space < MQTT_RX_STAGE_SIZE))
+		return;
+	if(SOCK_ERR_NO_ERROR == recv(sock, gcMQTTRxStage, MQTT_RX_STAGE_SIZE, 0)) //0: no timeout
+		gbMQTTRxPosted=true;
+}
+
+static void WINC1500_fifo_write(const uint8_t *pu8Data, uint32_t u32Len)
+{
+	uint32_t u32Tail=(gu32MQTTRxFIFOPtr+gu32MQTTRxFIFOLen)%MQTT_RX_POOL_SIZE;
+
+	while(u32Len--){
+		gcMQTTRxFIFO[u32Tail]=*pu8Data++;
+		u32Tail=(u32Tail+1)%MQTT_RX_POOL_SIZE;
+		gu32MQTTRxFIFOLen++;
+	}
+}
+
+static void WINC1500_fifo_put(const uint8_t *pu8Data, uint32_t u32Len)
+{
+	//the driver hands a large segment over in several chunks of one recv() and the client cannot drain the
+	//FIFO in between. Bytes are therefore admitted a whole MQTT packet at a time: the fixed header is held
+	//back until the remaining length is known, and a packet that does not fit is counted and skipped up to
+	//the next packet boundary, so the client stays in step with the stream instead of losing the session.
+	while(u32Len>0){
+		uint32_t u32Take;
+		uint32_t u32Body=0;
+		uint32_t i;
+
+		if(gu32MQTTRxBodyLeft>0){
+			u32Take=(u32Len<gu32MQTTRxBodyLeft) ? u32Len : gu32MQTTRxBodyLeft;
+			if(!gbMQTTRxSkip)
+				WINC1500_fifo_write(pu8Data, u32Take);
+			pu8Data+=u32Take;
+			u32Len-=u32Take;
+			gu32MQTTRxBodyLeft-=u32Take;
+			continue;
+		}
+
+		gcMQTTRxHead[gu32MQTTRxHeadLen++]=*pu8Data++;
+		u32Len--;
+		if((gu32MQTTRxHeadLen==1) || ((gcMQTTRxHead[gu32MQTTRxHeadLen-1]&0x80) && (gu32MQTTRxHeadLen<MQTT_RX_HEADER_MAX)))
+			continue; //more remaining length bytes follow
+
+		for(i=gu32MQTTRxHeadLen-1; i>0; i--)
+			u32Body=(u32Body<<7)|(gcMQTTRxHead[i]&0x7F);
+		gbMQTTRxSkip=(gu32MQTTRxHeadLen+u32Body) > (MQTT_RX_POOL_SIZE-gu32MQTTRxFIFOLen);
+		if(gbMQTTRxSkip){
+			gu32MQTTRxOverruns++;
+			#ifdef MQTT_PLATFORM_DBG
+			printf("ERROR >> broker packet of %lu bytes dropped, FIFO full\r\n",(unsigned long)(gu32MQTTRxHeadLen+u32Body));
+			#endif
+		}
+		else{
+			WINC1500_fifo_write(gcMQTTRxHead, gu32MQTTRxHeadLen);
+		}
+		gu32MQTTRxHeadLen=0;
+		gu32MQTTRxBodyLeft=u32Body;
+	}
+}
+
+uint32_t winc1500_rx_overruns(void)
+{
+	return gu32MQTTRxOverruns;
+}
+
 void dnsResolveCallback(uint8_t *hostName, uint32_t hostIp)
 {
 	if((gbMQTTBrokerIpresolved == false) && (!strcmp((const char *)gpcHostAddr, (const char *)hostName)))
@@ -92,7 +183,12 @@ void tcpClientSocketEventHandler(SOCKET sock, uint8_t u8Msg, void *pvMsg)
 			{
 				tstrSocketRecvMsg* pstrRx = (tstrSocketRecvMsg*)pvMsg;
 				gi32MQTTBrokerRxLen = pstrRx->s16BufferSize;
-				if((gi32MQTTBrokerRxLen<0) && (gi32MQTTBrokerRxLen!=SOCK_ERR_TIMEOUT)) {
+				if(gi32MQTTBrokerRxLen>0) {
+					WINC1500_fifo_put(pstrRx->pu8Buffer, (uint32_t)gi32MQTTBrokerRxLen);
+				}
+				else if(gi32MQTTBrokerRxLen!=SOCK_ERR_TIMEOUT) {
+					//0 means the broker closed the connection
+					gbMQTTRxError=true;
 					#ifdef MQTT_PLATFORM_DBG
 					printf("ERROR >> Receive error for broker socket (Err=%ld).\r\n",gi32MQTTBrokerRxLen);
 					#endif
@@ -100,7 +196,11 @@ void tcpClientSocketEventHandler(SOCKET sock, uint8_t u8Msg, void *pvMsg)
 				#ifdef MQTT_PLATFORM_DBG
 				printf("DEBUG >> Remaining data in Rx buffer of broker socket: %d\r\n",pstrRx->u16RemainingSize);
 				#endif
-				gbMQTTBrokerRecvDone=true;
+				//the last chunk of this recv() has been delivered; post the next one right away
+				if((gi32MQTTBrokerRxLen<=0) || (0==pstrRx->u16RemainingSize)) {
+					gbMQTTRxPosted=false;
+					WINC1500_post_recv(sock);
+				}
 			}
 			break;
 			default: break;
@@ -139,68 +239,50 @@ void TimerInit(Timer* timer) {
 	memset(&timer->xTimeOut, '\0', sizeof(timer->xTimeOut));
 }
 
-static int WINC1500_read(Network* n, unsigned char* buffer, int len, int timeout_ms) { 
-  //at times the upper layer requests for single byte of data, but network has more in rx buffer.
-  //this results in callback being invoked multiple times with length 1 before returning. To prevent loss of
-  //data in this process, pool data internally and give it to upper layer on request. 
-  
-  //temporary workaround for timer overrun 
-  if(0==timeout_ms) timeout_ms=10;
-  
-  if(0==gu32MQTTRxFIFOLen){ //no data in internal FIFO
-	  #ifdef MQTT_PLATFORM_DBG
-	  printf("DEBUG >> Requesting data from network\r\n");
-	  #endif
-	  gbMQTTBrokerRecvDone=false;
-	  if (SOCK_ERR_NO_ERROR!=recv(n->socket,gcMQTTRxFIFO,MQTT_RX_POOL_SIZE,timeout_ms)){
-		  #ifdef MQTT_PLATFORM_DBG
-		  printf("ERROR >> recv failed\r\n");
-		  #endif
-		  return -1;
-	  }
-	  //call handle_events until we get rx callback 
-	  while (false==gbMQTTBrokerRecvDone){
-		  m2m_wifi_handle_events(NULL);
-	  }
-	  
-	  //update current FIFO length
-	  if(gi32MQTTBrokerRxLen>0){ //data recieved form network
-		gu32MQTTRxFIFOLen=gi32MQTTBrokerRxLen;
-		gu32MQTTRxFIFOPtr=0;
-		#ifdef MQTT_PLATFORM_DBG
-		printf("DEBUG >> filled FiFo from network. length=%d\r\n",gu32MQTTRxFIFOLen);
-		#endif
-	  
-	  #ifdef MQTT_PLATFORM_DBG
-    	printf("DEBUG >> rx data through socket: \r\n");
-    	int i=0;
-    	for(i=0;i<gu32MQTTRxFIFOLen;i++)
-    	printf("0x%x, ",gcMQTTRxFIFO[i]);
-    	printf("\r\n");
-	  #endif
-	  }
-	  else{//mostly in case of timeout
-		  gu32MQTTRxFIFOLen=0;
-		  gu32MQTTRxFIFOPtr=0;
-		  #ifdef MQTT_PLATFORM_DBG
-		  printf("DEBUG >> no data to send. returning error code (%d)\r\n",gi32MQTTBrokerRxLen);
-		  #endif
-		  return gi32MQTTBrokerRxLen; //this corresponds to the error code.
-	  }
+static int WINC1500_poll(Network* n, unsigned char* buffer, int len) {
+  //never waits: hands over whatever the receive callback has already put in the FIFO.
+  int copied=0;
+
+  if(0==gu32MQTTRxFIFOLen){ //pick up a receive that completed since the last call
+	  m2m_wifi_handle_events(NULL);
+  }
+  while((copied<len) && (gu32MQTTRxFIFOLen>0)){
+	  buffer[copied++]=gcMQTTRxFIFO[gu32MQTTRxFIFOPtr];
+	  gu32MQTTRxFIFOPtr=(gu32MQTTRxFIFOPtr+1)%MQTT_RX_POOL_SIZE;
+	  gu32MQTTRxFIFOLen--;
   }
-  //return data to client from data present in the FIFO from previous recv()
-  if(len>(int)gu32MQTTRxFIFOLen){
+  //room was freed, make sure a receive is outstanding again
+  WINC1500_post_recv(n->socket);
+
+  if((0==copied) && gbMQTTRxError){
 	  #ifdef MQTT_PLATFORM_DBG
-	  printf("ERROR >> unable to process read request since FIFO contains less data than requested\r\n");
+	  printf("ERROR >> broker socket closed\r\n");
 	  #endif
 	  return -1;
   }
- 
-  memcpy((void*)buffer, (const void*)&gcMQTTRxFIFO[gu32MQTTRxFIFOPtr],len);
-  gu32MQTTRxFIFOLen-=len;
-  gu32MQTTRxFIFOPtr+=len;
-  
-  return len;
+  return copied;
+}
+
+
+static int WINC1500_read(Network* n, unsigned char* buffer, int len, int timeout_ms) { 
+  //blocking read on top of the FIFO, for callers that want len bytes or a timeout
+  Timer timer;
+  int got=0;
+  int rc;
+
+  //temporary workaround for timer overrun 
+  if(0==timeout_ms) timeout_ms=10;
+
+  TimerInit(&timer);
+  TimerCountdownMS(&timer, timeout_ms);
+  do{
+	  rc=WINC1500_poll(n, buffer+got, len-got);
+	  if(rc<0)
+		  return rc;
+	  got+=rc;
+  } while((got<len) && !TimerIsExpired(&timer));
+
+  return (got>0) ? got : SOCK_ERR_TIMEOUT;
 }
 
 
@@ -236,12 +318,15 @@ static void WINC1500_disconnect(Network* n) {
 	close(n->socket);
 	n->socket=-1;
 	gbMQTTBrokerConnected=false;
+	WINC1500_reset_rx();
 }
 
 
 void NetworkInit(Network* n) {
 	n->socket = -1;
+	WINC1500_reset_rx();
 	n->mqttread = WINC1500_read;
+	n->mqttpoll = WINC1500_poll;
 	n->mqttwrite = WINC1500_write;
 	n->disconnect = WINC1500_disconnect;
 }
@@ -294,6 +379,10 @@ int ConnectNetwork(Network* n, char* addr, int port, int TLSFlag){
     m2m_wifi_handle_events(NULL);
   }
   
+  /* Start receiving in the background */
+  WINC1500_reset_rx();
+  WINC1500_post_recv(n->socket);
+
   /* Success */
   #ifdef MQTT_PLATFORM_DBG
   printf("INFO >> ConnectNetwork successful\r\n");
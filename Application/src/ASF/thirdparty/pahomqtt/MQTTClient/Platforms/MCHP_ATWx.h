@@ -22,8 +22,11 @@
 
 #include "socket/include/socket.h"
 
-/* As WINC15x0 supports only 7 TCP sockets, maximum of 7 MQTT clients can be supported */
-#define MQTT_MAX_CLIENTS  TCP_SOCK_MAX
+/* As WINC15x0 supports only 7 TCP sockets, maximum of 7 MQTT clients can be supported.
+ * The receive FIFO and connection flags of this port are shared though, so it serves one broker connection. */
+#if !defined(MQTT_MAX_CLIENTS)
+#define MQTT_MAX_CLIENTS  1
+#endif
 
 typedef struct Timer
 {
@@ -38,6 +41,7 @@ struct Network_t
 	int socket;
 	int hostIP;
 	int (*mqttread) (Network*, unsigned char*, int, int);
+	int (*mqttpoll) (Network*, unsigned char*, int);	//copies what has already arrived, 0 if nothing, <0 if the connection is lost
 	int (*mqttwrite) (Network*, unsigned char*, int, int);
 	void (*disconnect) (Network*);
 }; 
@@ -45,6 +49,7 @@ struct Network_t
 int winc1500_read(Network*, unsigned char*, unsigned int, int);
 int winc1500_write(Network*, unsigned char*, unsigned int, int);
 void winc1500_disconnect(Network*);
+uint32_t winc1500_rx_overruns(void);	//broker packets dropped because the receive FIFO was full, since boot
 void NetworkInit(Network* n);
 
 int ConnectNetwork(Network*, char*, int, int);
@@ -32,6 +32,16 @@ static void allocateClient(struct mqtt_module *module)
 	if(!module)
 		return;
 		
+	for(cIdx = 0; cIdx < MQTT_MAX_CLIENTS; cIdx++)
+	{
+		/* A module that is initialized again keeps its client. */
+		if(mqttClientPool[cIdx].mqtt_instance == module)
+		{
+			module->client = &(mqttClientPool[cIdx].client);
+			return;
+		}
+	}
+
 	for(cIdx = 0; cIdx < MQTT_MAX_CLIENTS; cIdx++)
 	{
 		if(mqttClientPool[cIdx].mqtt_instance == NULL)
@@ -75,7 +85,18 @@ int mqtt_init(struct mqtt_module *module, struct mqtt_config *config)
 	
 	if(module->client)
 	{
-		MQTTClientInit(module->client, &(module->network), timeout_ms, config->send_buffer, config->send_buffer_size, config->read_buffer, config->read_buffer_size);
+		/* Initializing again to reconnect keeps the QoS 1 publishes that still wait for their PUBACK.
+		 * MQTTConnect sends them again once the new connection is up. */
+		MQTTClient *c = module->client;
+		MQTTInflight inflight[MAX_INFLIGHT_PUBLISH];
+		int window = c->inflight_window;
+		size_t slot_size = c->inflight_slot_size;
+
+		memcpy(inflight, c->inflight, sizeof(inflight));
+		MQTTClientInit(c, &(module->network), timeout_ms, config->send_buffer, config->send_buffer_size, config->read_buffer, config->read_buffer_size);
+		memcpy(c->inflight, inflight, sizeof(inflight));
+		c->inflight_window = window;
+		c->inflight_slot_size = slot_size;
 		return SUCCESS;
 	}
 	else
@@ -236,7 +257,43 @@ int mqtt_unsubscribe(struct mqtt_module *module, const char *topic)
 	return rc;
 }
 
+int mqtt_set_inflight_window(struct mqtt_module *const module, int window, unsigned char *buffer, uint32_t slot_size)
+{
+	if(!module || !module->client)
+		return FAILURE;
+
+	return MQTTSetInflightWindow(module->client, window, buffer, (size_t)slot_size);
+}
+
+int mqtt_publish_async(struct mqtt_module *const module, const char *topic, const char *msg, uint32_t msg_len, uint8_t qos, uint8_t retain)
+{
+	MQTTMessage mqttMsg;
+
+	mqttMsg.qos = qos;
+	mqttMsg.payload = (char *)msg;
+	mqttMsg.payloadlen = (size_t)msg_len;
+	mqttMsg.retained = retain;
+
+	return MQTTPublishAsync(module->client, topic, &mqttMsg);
+}
+
 int mqtt_yield(struct mqtt_module *module, int timeout_ms)
 {
 	return MQTTYield(module->client, timeout_ms);
+}
+
+int mqtt_poll(struct mqtt_module *module)
+{
+	if(!module || !module->client)
+		return FAILURE;
+
+	return MQTTPoll(module->client);
+}
+
+int mqtt_next_deadline_ms(struct mqtt_module *module)
+{
+	if(!module || !module->client)
+		return -1;
+
+	return MQTTNextDeadlineMS(module->client);
 }
\ No newline at end of file
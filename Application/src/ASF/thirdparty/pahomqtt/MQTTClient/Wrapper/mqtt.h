@@ -317,6 +317,9 @@ void mqtt_get_config_defaults(struct mqtt_config *const config);
 /**
  * \brief Initialize MQTT service.
  *
+ * May be called again on the same module before reconnecting. QoS 1 publishes still in the inflight window are
+ * kept and sent again after the next \ref mqtt_connect.
+ *
  * \param[in]  module          Module instance of MQTT.
  * \param[in]  config          Pointer of configuration structure which will be used in the module.
  *
@@ -541,6 +544,37 @@ int mqtt_disconnect(struct mqtt_module *const module, int force_close);
  */
 int mqtt_publish(struct mqtt_module *const module, const char *topic, const char *msg, uint32_t msg_len, uint8_t qos, uint8_t retain);
 
+/**
+ * \brief Set up the window used by \ref mqtt_publish_async.
+ *
+ * \param[in]  module_inst     Instance of MQTT module.
+ * \param[in]  window          Number of QoS 1 messages that may wait for their PUBACK at once.
+ * \param[in]  buffer          Storage for window packets of slot_size bytes each. Must stay valid while the module is used.
+ * \param[in]  slot_size       Largest serialized PUBLISH (payload, topic and header) that can be sent asynchronously.
+ *
+ * \return     0               Function succeeded
+ * \return     -1              Invalid argument, or messages are still in flight.
+ */
+int mqtt_set_inflight_window(struct mqtt_module *const module, int window, unsigned char *buffer, uint32_t slot_size);
+
+/**
+ * \brief Send publish message to MQTT broker server without waiting for the acknowledgement.
+ * QoS 1 messages are kept in the inflight window until the PUBACK arrives during \ref mqtt_poll, and are sent again
+ * with the DUP flag if it does not. Only blocks while the window is full. The payload is copied and can be reused
+ * as soon as this function returns.
+ *
+ * \param[in]  module_inst     Instance of MQTT module.
+ * \param[in]  topic           Topic of this MQTT message.
+ * \param[in]  msg             Payload of this MQTT message.
+ * \param[in]  msg_len         Payload size of this MQTT message.
+ * \param[in]  qos             QOS level of this MQTT message. (0 <= qos <= 1)
+ * \param[in]  retain          Whether broker server will be store this MQTT message or not.
+ *
+ * \return     0               Message sent
+ * \return     -1              Not connected, window not set up, or the message could not be sent.
+ */
+int mqtt_publish_async(struct mqtt_module *const module, const char *topic, const char *msg, uint32_t msg_len, uint8_t qos, uint8_t retain);
+
 /**
  * \brief Send subscribe message to MQTT broker server.
  * If operation of this function is complete, MQTT_CALLBACK_SUBSCRIBED event will be sent through MQTT callback.
@@ -616,6 +650,28 @@ int mqtt_unsubscribe(struct mqtt_module *const module, const char *topic);
  */
 int mqtt_yield(struct mqtt_module *module, int timeout_ms);
 
+/**
+ * \brief Handle the frames that have already been received without waiting for more.
+ * Subscription handlers are called from here. Also sends the keepalive ping and retransmits
+ * unacknowledged messages when they are due. Call it when the network controller signals an event
+ * or when \ref mqtt_next_deadline_ms has elapsed.
+ *
+ * \param[in]  module_inst     Instance of MQTT module.
+ *
+ * \return     0               Function succeeded
+ * \return     -1              Not connected, the connection was lost, or the broker stopped answering pings.
+ */
+int mqtt_poll(struct mqtt_module *module);
+
+/**
+ * \brief Time until \ref mqtt_poll has a keepalive or retransmission to handle.
+ *
+ * \param[in]  module_inst     Instance of MQTT module.
+ *
+ * \return     Milliseconds until the earliest deadline, 0 if one is already due, -1 if there is none.
+ */
+int mqtt_next_deadline_ms(struct mqtt_module *module);
+
 #ifdef __cplusplus
 }
 #endif
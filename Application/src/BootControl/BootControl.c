@@ -0,0 +1,172 @@
+/**************************************************************************/ /**
+ * @file      BootControl.c
+ * @brief     Boot control record shared by the application and the bootloader. The application marks a firmware
+ *            update as pending in a reserved NVM row; the bootloader only mounts the SD card when it finds one.
+ * @note      Keep this file identical in the Application and Bootloader projects.
+ * @date      2026-10-19
+
+ ******************************************************************************/
+
+/******************************************************************************
+ * Includes
+ ******************************************************************************/
+#include "BootControl/BootControl.h"
+
+#include <asf.h>
+#include <string.h>
+
+/******************************************************************************
+ * Defines
+ ******************************************************************************/
+#define BOOT_CONTROL_ERASED ((uint32_t)0xFFFFFFFF)  ///< Value of an erased flash word
+
+/******************************************************************************
+ * Forward Declarations
+ ******************************************************************************/
+static enum status_code BootControlConfigureNvm(void);
+
+/******************************************************************************
+ * Global Functions
+ ******************************************************************************/
+
+/**
+ * @fn		const struct BootControl *BootControlGet(void)
+ * @brief	Returns the boot control record. Flash is memory mapped, so this needs no driver and works before system_init().
+ * @return	Pointer to the record in flash
+ */
+const struct BootControl *BootControlGet(void)
+{
+    return (const struct BootControl *)BOOT_CONTROL_ADDRESS;
+}
+
+/**
+ * @fn		bool BootControlAppIsValid(uint32_t appStack, uint32_t appReset)
+ * @brief	Sanity checks the first two words of the application vector table
+ * @param	appStack Initial stack pointer of the application
+ * @param	appReset Reset vector of the application
+ * @return	true if the stack pointer is inside SRAM and the reset vector is a Thumb address inside the application area
+ */
+bool BootControlAppIsValid(uint32_t appStack, uint32_t appReset)
+{
+    if (appStack < BOOT_CONTROL_SRAM_START || appStack > BOOT_CONTROL_SRAM_END || (appStack & 0x3) != 0) {
+        return false;
+    }
+    if (appReset <= BOOT_CONTROL_APP_START || appReset >= BOOT_CONTROL_ADDRESS || (appReset & 0x1) == 0) {
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @fn		enum BootAction BootControlDecide(const struct BootControl *ctl, uint32_t appStack, uint32_t appReset, uint8_t *image)
+ * @brief	Decides whether the bootloader can jump straight to the application
+ * @param	ctl Boot control record
+ * @param	appStack Initial stack pointer of the application
+ * @param	appReset Reset vector of the application
+ * @param	image Set to the image to flash when BOOT_ACTION_UPDATE is returned
+ * @return	Action the bootloader must take
+ * @note	Pure function of its inputs, so it can be checked off target.
+ */
+enum BootAction BootControlDecide(const struct BootControl *ctl, uint32_t appStack, uint32_t appReset, uint8_t *image)
+{
+    if (ctl->magic == BOOT_CONTROL_MAGIC) {
+        if (ctl->imageCheck == ~ctl->image && (ctl->image == BOOT_CONTROL_IMAGE_A || ctl->image == BOOT_CONTROL_IMAGE_B)) {
+            *image = (uint8_t)ctl->image;
+            return BOOT_ACTION_UPDATE;
+        }
+        return BOOT_ACTION_RECOVER;
+    }
+
+    if (ctl->magic != BOOT_CONTROL_ERASED) {
+        return BOOT_ACTION_RECOVER;
+    }
+
+    return BootControlAppIsValid(appStack, appReset) ? BOOT_ACTION_JUMP : BOOT_ACTION_RECOVER;
+}
+
+/**
+ * @fn		int32_t BootControlRequestUpdate(uint8_t image)
+ * @brief	Marks a firmware update as pending. The bootloader flashes the image on the next reset.
+ * @param	image BOOT_CONTROL_IMAGE_A or BOOT_CONTROL_IMAGE_B
+ * @return	STATUS_OK on success, an ASF status code otherwise
+ * @note	Erases and writes one NVM row. The CPU stalls on flash reads while the row is written.
+ */
+int32_t BootControlRequestUpdate(uint8_t image)
+{
+    uint8_t page[NVMCTRL_PAGE_SIZE];
+    struct BootControl ctl;
+    enum status_code status;
+
+    if (image != BOOT_CONTROL_IMAGE_A && image != BOOT_CONTROL_IMAGE_B) {
+        return STATUS_ERR_INVALID_ARG;
+    }
+
+    status = BootControlConfigureNvm();
+    if (status != STATUS_OK) {
+        return status;
+    }
+
+    ctl.magic = BOOT_CONTROL_MAGIC;
+    ctl.image = image;
+    ctl.imageCheck = ~ctl.image;
+    memset(page, 0xFF, sizeof(page));
+    memcpy(page, &ctl, sizeof(ctl));
+
+    do {
+        status = nvm_erase_row(BOOT_CONTROL_ADDRESS);
+    } while (status == STATUS_BUSY);
+    if (status != STATUS_OK) {
+        return status;
+    }
+
+    do {
+        status = nvm_write_buffer(BOOT_CONTROL_ADDRESS, page, sizeof(page));
+    } while (status == STATUS_BUSY);
+    return status;
+}
+
+/**
+ * @fn		int32_t BootControlClear(void)
+ * @brief	Clears a pending update so following boots take the fast path
+ * @return	STATUS_OK on success, an ASF status code otherwise
+ */
+int32_t BootControlClear(void)
+{
+    enum status_code status;
+
+    if (BootControlGet()->magic == BOOT_CONTROL_ERASED) {
+        return STATUS_OK;  // Already clear, do not wear the row
+    }
+
+    status = BootControlConfigureNvm();
+    if (status != STATUS_OK) {
+        return status;
+    }
+
+    do {
+        status = nvm_erase_row(BOOT_CONTROL_ADDRESS);
+    } while (status == STATUS_BUSY);
+    return status;
+}
+
+/******************************************************************************
+ * Local Functions
+ ******************************************************************************/
+
+/**
+ * @fn		static enum status_code BootControlConfigureNvm(void)
+ * @brief	Configures the NVM driver for automatic page writes, as the bootloader does
+ * @return	Status of nvm_set_config
+ */
+static enum status_code BootControlConfigureNvm(void)
+{
+    struct nvm_config config_nvm;
+    enum status_code status;
+
+    nvm_get_config_defaults(&config_nvm);
+    config_nvm.manual_page_write = false;
+    do {
+        status = nvm_set_config(&config_nvm);
+    } while (status == STATUS_BUSY);
+    return status;
+}
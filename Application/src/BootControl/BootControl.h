@@ -0,0 +1,63 @@
+/**************************************************************************/ /**
+ * @file      BootControl.h
+ * @brief     Boot control record shared by the application and the bootloader. The application marks a firmware
+ *            update as pending in a reserved NVM row; the bootloader only mounts the SD card when it finds one.
+ * @note      Keep this file identical in the Application and Bootloader projects.
+ * @date      2026-10-19
+
+ ******************************************************************************/
+
+#pragma once
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************************************************************************
+ * Includes
+ ******************************************************************************/
+#include <stdbool.h>
+#include <stdint.h>
+
+/******************************************************************************
+ * Defines
+ ******************************************************************************/
+#define BOOT_CONTROL_ADDRESS ((uint32_t)0x3FF00)  ///< Last NVM row of the SAMD21G18A. The application image must stay below it.
+#define BOOT_CONTROL_MAGIC ((uint32_t)0x4C544342) ///< "BCTL". Marks a record written by BootControlRequestUpdate
+
+#define BOOT_CONTROL_APP_START ((uint32_t)0x12000)  ///< Start of the main application
+#define BOOT_CONTROL_SRAM_START ((uint32_t)0x20000000)
+#define BOOT_CONTROL_SRAM_END ((uint32_t)0x20008000)
+
+#define BOOT_CONTROL_IMAGE_A 1  ///< Flash TestA.bin (same meaning as FlagA.txt)
+#define BOOT_CONTROL_IMAGE_B 2  ///< Flash TestB.bin (same meaning as FlagB.txt)
+
+/******************************************************************************
+ * Structures and Enumerations
+ ******************************************************************************/
+
+/// Record stored at BOOT_CONTROL_ADDRESS. An erased row (all 0xFF) means no update is pending.
+struct BootControl {
+    uint32_t magic;       ///< BOOT_CONTROL_MAGIC when an update is pending
+    uint32_t image;       ///< BOOT_CONTROL_IMAGE_A or BOOT_CONTROL_IMAGE_B
+    uint32_t imageCheck;  ///< Bitwise complement of image, catches a torn write
+};
+
+/// What the bootloader does after reading the boot control record
+enum BootAction {
+    BOOT_ACTION_JUMP = 0,  ///< Nothing pending and the application looks valid. Jump without touching the SD card
+    BOOT_ACTION_UPDATE,    ///< Update pending. Mount the SD card and flash the requested image
+    BOOT_ACTION_RECOVER,   ///< Record corrupt or application invalid. Mount the SD card and look for flag files
+};
+
+/******************************************************************************
+ * Global Function Declaration
+ ******************************************************************************/
+const struct BootControl *BootControlGet(void);
+bool BootControlAppIsValid(uint32_t appStack, uint32_t appReset);
+enum BootAction BootControlDecide(const struct BootControl *ctl, uint32_t appStack, uint32_t appReset, uint8_t *image);
+int32_t BootControlRequestUpdate(uint8_t image);
+int32_t BootControlClear(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,432 @@
+/**************************************************************************/ /**
+ * @file      BusStats.c
+ * @brief     Fixed-memory bus statistics. Aggregates decoded bus transactions into per-address counters, a count-min
+ *            sketch with a top-N list of the busiest address/register pairs and log2 histograms of transaction
+ *            latency and inter-transaction gap. A JSON snapshot is published instead of the raw traffic.
+ * @details   Statistics are kept per interval in one window. Taking a snapshot formats and clears it with the
+ *            scheduler suspended, so a task that records meanwhile waits for one formatting pass per interval
+ *            rather than the module holding a second window. Memory does not depend on the traffic: the first
+ *            BUS_STATS_ADDRESSES addresses are counted exactly, and address/register pairs are counted in a
+ *            count-min sketch (conservative update) that feeds a BUS_STATS_TOP_N heavy hitter list. Sketch estimates can only be too high, never too low.
+ * @date      2026-10-19
+
+ ******************************************************************************/
+
+/******************************************************************************
+ * Includes
+ ******************************************************************************/
+#include "BusStats/BusStats.h"
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "FreeRTOS.h"
+#include "asf.h"
+#include "task.h"
+
+/******************************************************************************
+ * Defines
+ ******************************************************************************/
+#define BUS_STATS_SKETCH_SHIFT 27  ///< 32 - log2(BUS_STATS_SKETCH_WIDTH), keeps the top bits of the row hash
+#if (1UL << (32 - BUS_STATS_SKETCH_SHIFT)) != BUS_STATS_SKETCH_WIDTH
+#error "BUS_STATS_SKETCH_SHIFT does not match BUS_STATS_SKETCH_WIDTH"
+#endif
+
+#define BUS_STATS_KEY(address, reg) (((uint32_t)(address) << 16) | (reg))
+
+#define BUS_STATS_TOP_CLOSE "],\"top\":["  ///< Text between the address and top lists
+#define BUS_STATS_END_RESERVE (sizeof("],\"cut\":255}") - 1)  ///< Longest text that ends a snapshot
+
+/******************************************************************************
+ * Structures and Enumerations
+ ******************************************************************************/
+
+/// Exact counters of one address
+struct BusStatsAddress {
+    uint16_t address;
+    uint32_t count;
+    uint32_t errors;
+};
+
+/// Entry of the heavy hitter list
+struct BusStatsTop {
+    uint32_t key;       ///< BUS_STATS_KEY(address, register)
+    uint32_t estimate;  ///< Sketch estimate when the pair was last seen
+};
+
+/// Statistics of one interval
+struct BusStatsWindow {
+    TickType_t startTick;
+    uint32_t transactions;
+    uint32_t errors;
+    uint32_t untracked;  ///< Transactions to addresses that did not fit in addr[]
+    uint8_t addrCount;
+    uint8_t topCount;
+    struct BusStatsAddress addr[BUS_STATS_ADDRESSES];
+    struct BusStatsTop top[BUS_STATS_TOP_N];
+    uint16_t sketch[BUS_STATS_SKETCH_DEPTH][BUS_STATS_SKETCH_WIDTH];
+    uint16_t latency[BUS_STATS_BUCKETS];
+    uint16_t gap[BUS_STATS_BUCKETS];
+};
+
+/******************************************************************************
+ * Variables
+ ******************************************************************************/
+static struct BusStatsWindow busStatsWindow;
+static uint32_t busStatsLastEndUs = 0;   ///< End of the previous transaction, for the gap histogram
+static bool busStatsHaveLast = false;
+
+/// Odd multipliers of the sketch row hashes
+static const uint32_t busStatsSeed[BUS_STATS_SKETCH_DEPTH] = {0x9E3779B1, 0x85EBCA77, 0xC2B2AE3D, 0x27D4EB2F};
+
+/******************************************************************************
+ * Forward Declarations
+ ******************************************************************************/
+static uint8_t BusStatsBucket(uint32_t us);
+static uint32_t BusStatsSketchAdd(struct BusStatsWindow *w, uint32_t key);
+static void BusStatsTopUpdate(struct BusStatsWindow *w, uint32_t key, uint32_t estimate);
+static void BusStatsAddressUpdate(struct BusStatsWindow *w, const struct BusStatsEvent *ev);
+static uint16_t BusStatsFormatJson(const struct BusStatsWindow *w, TickType_t now, char *buf, uint16_t size);
+static void BusStatsRank(uint8_t *order, const uint32_t *weight, uint8_t count);
+static bool BusStatsAppend(char *buf, uint16_t size, uint16_t *len, uint16_t reserve, const char *fmt, ...);
+
+/******************************************************************************
+ * Global Functions
+ ******************************************************************************/
+
+/**
+ * @fn			uint32_t BusStatsNowUs(void)
+ * @brief		Microseconds since boot, from the RTOS tick count and the SysTick down counter
+ * @return		Time in microseconds. Wraps after about 71 minutes; differences stay valid across the wrap.
+ * @note		Task context only
+ */
+uint32_t BusStatsNowUs(void)
+{
+    TickType_t ticks;
+    uint32_t count;
+
+    // Read again if the tick interrupt ran in between, the counter reloaded at that point
+    do {
+        ticks = xTaskGetTickCount();
+        count = SysTick->VAL;
+    } while (ticks != xTaskGetTickCount());
+
+    return (uint32_t)ticks * portTICK_PERIOD_MS * 1000 + (SysTick->LOAD - count) / (configCPU_CLOCK_HZ / 1000000);
+}
+
+/**
+ * @fn			void BusStatsRecord(const struct BusStatsEvent *ev)
+ * @brief		Adds one transaction to the statistics of the current interval
+ * @param[in]	ev Decoded transaction
+ * @note		Constant time and memory. Safe to call from any task.
+ */
+void BusStatsRecord(const struct BusStatsEvent *ev)
+{
+    uint32_t key = BUS_STATS_KEY(ev->address, ev->reg);
+
+    taskENTER_CRITICAL();
+    struct BusStatsWindow *w = &busStatsWindow;
+
+    w->transactions++;
+    if (ev->status != 0) {
+        w->errors++;
+    }
+    BusStatsAddressUpdate(w, ev);
+    BusStatsTopUpdate(w, key, BusStatsSketchAdd(w, key));
+
+    uint8_t bucket = BusStatsBucket(ev->durationUs);
+    if (w->latency[bucket] < UINT16_MAX) {
+        w->latency[bucket]++;
+    }
+    if (busStatsHaveLast) {
+        bucket = BusStatsBucket(ev->startUs - busStatsLastEndUs);
+        if (w->gap[bucket] < UINT16_MAX) {
+            w->gap[bucket]++;
+        }
+    }
+    busStatsLastEndUs = ev->startUs + ev->durationUs;
+    busStatsHaveLast = true;
+    taskEXIT_CRITICAL();
+}
+
+/**
+ * @fn			uint16_t BusStatsSnapshotJson(char *buf, uint16_t size)
+ * @brief		Closes the current interval and writes its statistics as JSON
+ * @details		{"ms":interval,"n":transactions,"err":errors,"untracked":n,"lat":[buckets],"gap":[buckets],
+ *				"addr":[[address,count,errors],...],"top":[[address,register,estimate],...],"cut":n}. Register -1 means
+ *				none. Addresses are listed busiest first, top pairs by estimate. When buf is too small for all of them
+ *				the least busy entries are left out, and cut counts how many were.
+ * @param[out]	buf Output buffer, BUS_STATS_JSON_MIN_SIZE bytes or more
+ * @param[in]	size Size of buf
+ * @return		Length of the JSON text, 0 if buf is smaller than BUS_STATS_JSON_MIN_SIZE (the interval is dropped)
+ * @note		The scheduler is suspended while formatting, so no transaction is recorded halfway through
+ */
+uint16_t BusStatsSnapshotJson(char *buf, uint16_t size)
+{
+    uint16_t len;
+
+    vTaskSuspendAll();
+    TickType_t now = xTaskGetTickCount();
+    len = BusStatsFormatJson(&busStatsWindow, now, buf, size);
+    memset(&busStatsWindow, 0, sizeof(busStatsWindow));
+    busStatsWindow.startTick = now;
+    xTaskResumeAll();
+    return len;
+}
+
+/**
+ * @fn			uint16_t BusStatsPeekJson(char *buf, uint16_t size)
+ * @brief		Writes the statistics of the current interval so far as JSON, in the format of BusStatsSnapshotJson
+ * @param[out]	buf Output buffer
+ * @param[in]	size Size of buf
+ * @return		Length of the JSON text, 0 if it did not fit
+ * @note		The interval keeps running. The scheduler is suspended while formatting so no transaction is recorded
+ *				halfway through.
+ */
+uint16_t BusStatsPeekJson(char *buf, uint16_t size)
+{
+    uint16_t len;
+
+    vTaskSuspendAll();
+    len = BusStatsFormatJson(&busStatsWindow, xTaskGetTickCount(), buf, size);
+    xTaskResumeAll();
+    return len;
+}
+
+/******************************************************************************
+ * Local Functions
+ ******************************************************************************/
+
+/**
+ * @fn			static uint8_t BusStatsBucket(uint32_t us)
+ * @brief		Log2 histogram bucket of a duration
+ * @param[in]	us Duration in microseconds
+ * @return		Number of significant bits of us, capped at the last bucket
+ * @note
+ */
+static uint8_t BusStatsBucket(uint32_t us)
+{
+    uint8_t bucket = 0;
+    while (us != 0 && bucket < BUS_STATS_BUCKETS - 1) {
+        us >>= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+/**
+ * @fn			static uint32_t BusStatsSketchAdd(struct BusStatsWindow *w, uint32_t key)
+ * @brief		Counts key in the count-min sketch with conservative update
+ * @details		Only the rows that hold the current minimum are incremented, which keeps the overestimate caused by
+ *				colliding keys lower than a plain update would.
+ * @param[in]	w Window to count in
+ * @param[in]	key Address/register pair
+ * @return		Estimated count of key, including this transaction
+ * @note
+ */
+static uint32_t BusStatsSketchAdd(struct BusStatsWindow *w, uint32_t key)
+{
+    uint16_t *cell[BUS_STATS_SKETCH_DEPTH];
+    uint16_t estimate = UINT16_MAX;
+    uint8_t row;
+
+    for (row = 0; row < BUS_STATS_SKETCH_DEPTH; row++) {
+        cell[row] = &w->sketch[row][(key * busStatsSeed[row]) >> BUS_STATS_SKETCH_SHIFT];
+        if (*cell[row] < estimate) {
+            estimate = *cell[row];
+        }
+    }
+    if (estimate == UINT16_MAX) {
+        return estimate;  // Saturated
+    }
+    for (row = 0; row < BUS_STATS_SKETCH_DEPTH; row++) {
+        if (*cell[row] == estimate) {
+            (*cell[row])++;
+        }
+    }
+    return estimate + 1;
+}
+
+/**
+ * @fn			static void BusStatsTopUpdate(struct BusStatsWindow *w, uint32_t key, uint32_t estimate)
+ * @brief		Keeps the BUS_STATS_TOP_N pairs with the highest sketch estimate
+ * @param[in]	w Window to update
+ * @param[in]	key Address/register pair just counted
+ * @param[in]	estimate Its sketch estimate
+ * @note
+ */
+static void BusStatsTopUpdate(struct BusStatsWindow *w, uint32_t key, uint32_t estimate)
+{
+    uint8_t i, smallest = 0;
+
+    for (i = 0; i < w->topCount; i++) {
+        if (w->top[i].key == key) {
+            w->top[i].estimate = estimate;
+            return;
+        }
+        if (w->top[i].estimate < w->top[smallest].estimate) {
+            smallest = i;
+        }
+    }
+    if (w->topCount < BUS_STATS_TOP_N) {
+        smallest = w->topCount++;
+    } else if (estimate <= w->top[smallest].estimate) {
+        return;
+    }
+    w->top[smallest].key = key;
+    w->top[smallest].estimate = estimate;
+}
+
+/**
+ * @fn			static void BusStatsAddressUpdate(struct BusStatsWindow *w, const struct BusStatsEvent *ev)
+ * @brief		Updates the exact per-address counters
+ * @param[in]	w Window to update
+ * @param[in]	ev Transaction
+ * @note		Addresses seen after the table is full are only counted in untracked
+ */
+static void BusStatsAddressUpdate(struct BusStatsWindow *w, const struct BusStatsEvent *ev)
+{
+    struct BusStatsAddress *entry = NULL;
+
+    for (uint8_t i = 0; i < w->addrCount; i++) {
+        if (w->addr[i].address == ev->address) {
+            entry = &w->addr[i];
+            break;
+        }
+    }
+    if (entry == NULL) {
+        if (w->addrCount >= BUS_STATS_ADDRESSES) {
+            w->untracked++;
+            return;
+        }
+        entry = &w->addr[w->addrCount++];
+        entry->address = ev->address;
+    }
+    entry->count++;
+    if (ev->status != 0) {
+        entry->errors++;
+    }
+}
+
+/**
+ * @fn			static uint16_t BusStatsFormatJson(const struct BusStatsWindow *w, TickType_t now, char *buf, uint16_t size)
+ * @brief		Writes the statistics of one window as JSON, leaving out the least busy entries if they do not fit
+ * @param[in]	w Window to format
+ * @param[in]	now Tick count the interval ends at
+ * @param[out]	buf Output buffer
+ * @param[in]	size Size of buf
+ * @return		Length of the JSON text, 0 if not even the counters and histograms fit
+ * @note
+ */
+static uint16_t BusStatsFormatJson(const struct BusStatsWindow *w, TickType_t now, char *buf, uint16_t size)
+{
+    uint32_t weight[BUS_STATS_TOP_N > BUS_STATS_ADDRESSES ? BUS_STATS_TOP_N : BUS_STATS_ADDRESSES];
+    uint8_t order[BUS_STATS_TOP_N > BUS_STATS_ADDRESSES ? BUS_STATS_TOP_N : BUS_STATS_ADDRESSES];
+    uint16_t len = 0;
+    uint8_t listed = 0;
+    uint8_t cut = 0;
+    uint8_t i;
+    bool fits;
+
+    fits = BusStatsAppend(buf, size, &len, 0, "{\"ms\":%lu,\"n\":%lu,\"err\":%lu,\"untracked\":%lu,\"lat\":[",
+                          (unsigned long)((now - w->startTick) * portTICK_PERIOD_MS), (unsigned long)w->transactions,
+                          (unsigned long)w->errors, (unsigned long)w->untracked);
+    for (i = 0; i < BUS_STATS_BUCKETS; i++) {
+        fits = fits && BusStatsAppend(buf, size, &len, 0, "%s%u", (i == 0) ? "" : ",", w->latency[i]);
+    }
+    fits = fits && BusStatsAppend(buf, size, &len, 0, "],\"gap\":[");
+    for (i = 0; i < BUS_STATS_BUCKETS; i++) {
+        fits = fits && BusStatsAppend(buf, size, &len, 0, "%s%u", (i == 0) ? "" : ",", w->gap[i]);
+    }
+    fits = fits && BusStatsAppend(buf, size, &len, sizeof(BUS_STATS_TOP_CLOSE) - 1 + BUS_STATS_END_RESERVE, "],\"addr\":[");
+    if (!fits) {
+        return 0;
+    }
+
+    // Busiest first, so that what does not fit is the least busy
+    for (i = 0; i < w->addrCount; i++) {
+        weight[i] = w->addr[i].count;
+    }
+    BusStatsRank(order, weight, w->addrCount);
+    for (i = 0; i < w->addrCount; i++) {
+        const struct BusStatsAddress *a = &w->addr[order[i]];
+        if (BusStatsAppend(buf, size, &len, sizeof(BUS_STATS_TOP_CLOSE) - 1 + BUS_STATS_END_RESERVE, "%s[%u,%lu,%lu]",
+                           (listed == 0) ? "" : ",", a->address, (unsigned long)a->count, (unsigned long)a->errors)) {
+            listed++;
+        } else {
+            cut++;
+        }
+    }
+    BusStatsAppend(buf, size, &len, BUS_STATS_END_RESERVE, BUS_STATS_TOP_CLOSE);
+
+    for (i = 0; i < w->topCount; i++) {
+        weight[i] = w->top[i].estimate;
+    }
+    BusStatsRank(order, weight, w->topCount);
+    listed = 0;
+    for (i = 0; i < w->topCount; i++) {
+        const struct BusStatsTop *t = &w->top[order[i]];
+        uint16_t reg = (uint16_t)t->key;
+        if (BusStatsAppend(buf, size, &len, BUS_STATS_END_RESERVE, "%s[%u,%d,%lu]", (listed == 0) ? "" : ",",
+                           (unsigned int)(t->key >> 16), (reg == BUS_STATS_NO_REGISTER) ? -1 : (int)reg,
+                           (unsigned long)t->estimate)) {
+            listed++;
+        } else {
+            cut++;
+        }
+    }
+    BusStatsAppend(buf, size, &len, 0, "],\"cut\":%u}", cut);
+    return len;
+}
+
+/**
+ * @fn			static void BusStatsRank(uint8_t *order, const uint32_t *weight, uint8_t count)
+ * @brief		Orders indexes by descending weight. Insertion sort, count is at most a handful.
+ * @param[out]	order Indexes 0 to count - 1, heaviest first
+ * @param[in]	weight Weight of each index
+ * @param[in]	count Number of entries
+ * @note
+ */
+static void BusStatsRank(uint8_t *order, const uint32_t *weight, uint8_t count)
+{
+    for (uint8_t i = 0; i < count; i++) {
+        uint8_t j = i;
+        while (j > 0 && weight[order[j - 1]] < weight[i]) {
+            order[j] = order[j - 1];
+            j--;
+        }
+        order[j] = i;
+    }
+}
+
+/**
+ * @fn			static bool BusStatsAppend(char *buf, uint16_t size, uint16_t *len, uint16_t reserve, const char *fmt, ...)
+ * @brief		printf into buf at *len, only if the text fits with reserve bytes (and the terminator) to spare
+ * @param[in,out] buf Output buffer
+ * @param[in]	size Size of buf
+ * @param[in,out] len Length of the text in buf, advanced by what was written
+ * @param[in]	reserve Bytes that must stay free for the text still to come
+ * @param[in]	fmt printf format
+ * @return		true if the text was appended; otherwise buf and *len are left as they were
+ * @note
+ */
+static bool BusStatsAppend(char *buf, uint16_t size, uint16_t *len, uint16_t reserve, const char *fmt, ...)
+{
+    va_list args;
+    int written;
+
+    if ((uint32_t)*len + reserve >= size) {
+        return false;
+    }
+    va_start(args, fmt);
+    written = vsnprintf(&buf[*len], size - *len - reserve, fmt, args);
+    va_end(args);
+    if (written < 0 || written >= size - *len - reserve) {
+        buf[*len] = '\0';
+        return false;
+    }
+    *len += written;
+    return true;
+}
@@ -0,0 +1,56 @@
+/**************************************************************************/ /**
+ * @file      BusStats.h
+ * @brief     Fixed-memory bus statistics. Aggregates decoded bus transactions into per-address counters, a count-min
+ *            sketch with a top-N list of the busiest address/register pairs and log2 histograms of transaction
+ *            latency and inter-transaction gap. A JSON snapshot is published instead of the raw traffic.
+ * @date      2026-10-19
+
+ ******************************************************************************/
+
+#pragma once
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************************************************************************
+ * Includes
+ ******************************************************************************/
+#include <stdint.h>
+
+/******************************************************************************
+ * Defines
+ ******************************************************************************/
+#define BUS_STATS_ADDRESSES 8     ///< Addresses counted exactly; further addresses only go into the sketch
+#define BUS_STATS_TOP_N 8         ///< Busiest address/register pairs reported per snapshot
+#define BUS_STATS_SKETCH_DEPTH 4  ///< Hash rows of the count-min sketch
+#define BUS_STATS_SKETCH_WIDTH 32 ///< Counters per row, a power of two
+#define BUS_STATS_BUCKETS 16      ///< Log2 histogram buckets. Bucket n holds values in [2^(n-1), 2^n) us, bucket 0 holds 0
+#define BUS_STATS_NO_REGISTER 0xFFFF  ///< Register of a transaction that did not address one
+
+#define BUS_STATS_PUBLISH_MS 10000  ///< Interval between two snapshots
+#define BUS_STATS_JSON_MIN_SIZE 320  ///< Snapshot buffer that always fits the counters and histograms at their widest
+
+/******************************************************************************
+ * Structures and Enumerations
+ ******************************************************************************/
+
+/// One decoded bus transaction
+struct BusStatsEvent {
+    uint16_t address;     ///< Device address
+    uint16_t reg;         ///< First register accessed, BUS_STATS_NO_REGISTER if none
+    int32_t status;       ///< 0 on success, the driver error otherwise
+    uint32_t startUs;     ///< Start time, from BusStatsNowUs
+    uint32_t durationUs;  ///< Time until the transaction completed or failed
+};
+
+/******************************************************************************
+ * Global Function Declaration
+ ******************************************************************************/
+uint32_t BusStatsNowUs(void);
+void BusStatsRecord(const struct BusStatsEvent *ev);
+uint16_t BusStatsSnapshotJson(char *buf, uint16_t size);
+uint16_t BusStatsPeekJson(char *buf, uint16_t size);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,632 @@
+/**************************************************************************/ /**
+ * @file      CaptureCatalog.c
+ * @brief     Append-only catalog of the files stored on the SD card. One fixed-size record per file with its time
+ *            span, channels, trigger, size and CRC, so files are found by time with a binary search instead of a
+ *            directory scan, and new files get a unique name without probing.
+ * @details   Records are written and synced once a file is complete. Afterwards only the header is rewritten,
+ *            when the catalog stops being sorted, and the flags of the record of a file that was overwritten. The
+ *            record count, the next ID and the last end time are kept in RAM, so appending and naming cost no reads.
+ *            Files are written from the Wifi and the CLI task, so every access holds a mutex.
+ * @date      2026-10-19
+
+ ******************************************************************************/
+
+/******************************************************************************
+ * Includes
+ ******************************************************************************/
+#include "CaptureCatalog/CaptureCatalog.h"
+
+#include <crc32.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+
+#include "FreeRTOS.h"
+#include "SerialConsole.h"
+#include "asf.h"
+#include "semphr.h"
+
+/******************************************************************************
+ * Defines
+ ******************************************************************************/
+#define CAPTURE_CATALOG_MAGIC 0x54414343  ///< "CCAT"
+#define CAPTURE_CATALOG_VERSION 1
+#define CAPTURE_CATALOG_HEADER_UNSORTED 0x01  ///< Records are not in end time order
+#define CAPTURE_CATALOG_RECORD_SIZE sizeof(struct CaptureCatalogRecord)
+#define CAPTURE_CATALOG_PARTIAL_SUFFIX ".tmp"  ///< Files still being written, for example by a UART PUT
+
+/******************************************************************************
+ * Structures and Enumerations
+ ******************************************************************************/
+
+/// First record-sized block of the catalog file
+struct CaptureCatalogHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t recordSize;  ///< sizeof(struct CaptureCatalogRecord) when the catalog was created
+    uint8_t flags;        ///< CAPTURE_CATALOG_HEADER_ bits
+    uint8_t reserved[51];
+    uint32_t check;       ///< CRC-32 of the fields above
+};
+
+/******************************************************************************
+ * Variables
+ ******************************************************************************/
+static FIL catalogFile;                  ///< Kept open while the catalog is open
+static char catalogPath[] = CAPTURE_CATALOG_FILE;
+static bool catalogOpen = false;
+static SemaphoreHandle_t catalogMutex = NULL;
+static uint32_t catalogCount = 0;        ///< Records in the file
+static uint32_t catalogNextId = 1;
+static uint32_t catalogLastEnd = 0;      ///< Latest end time appended
+static bool catalogSorted = true;
+
+/******************************************************************************
+ * Forward Declarations
+ ******************************************************************************/
+static uint32_t CaptureCatalogCheck(const void *data, size_t len);
+static FRESULT CaptureCatalogLoad(void);
+static FRESULT CaptureCatalogWriteHeader(void);
+static FRESULT CaptureCatalogReadRecord(uint32_t index, struct CaptureCatalogRecord *rec);
+static FRESULT CaptureCatalogAppend(struct CaptureCatalogRecord *rec);
+static FRESULT CaptureCatalogReplace(const char *name);
+static FRESULT CaptureCatalogScan(void);
+static FRESULT CaptureCatalogSearch(uint32_t time, struct CaptureCatalogRecord *rec);
+static void CaptureCatalogLock(void);
+static void CaptureCatalogUnlock(void);
+
+/******************************************************************************
+ * Global Functions
+ ******************************************************************************/
+
+/**
+ * @fn		FRESULT CaptureCatalogOpen(void)
+ * @brief	Opens the catalog on the mounted SD card, cutting off a torn last record. A missing or corrupt catalog is
+ *			rebuilt from the directory.
+ * @return	FR_OK on success, the FatFs error otherwise
+ * @note	The SD card must be mounted
+ */
+FRESULT CaptureCatalogOpen(void)
+{
+    FRESULT res;
+
+    if (catalogOpen) {
+        return FR_OK;
+    }
+    if (catalogMutex == NULL) {
+        catalogMutex = xSemaphoreCreateMutex();
+    }
+
+    CaptureCatalogLock();
+    catalogPath[0] = LUN_ID_SD_MMC_0_MEM + '0';
+    res = f_open(&catalogFile, catalogPath, FA_OPEN_ALWAYS | FA_READ | FA_WRITE);
+    if (res == FR_OK) {
+        res = CaptureCatalogLoad();
+        if (res != FR_OK) {
+            LogMessage(LOG_INFO_LVL, "Capture catalog: rebuilding (%d)\r\n", res);
+            res = CaptureCatalogScan();
+        }
+        if (res == FR_OK) {
+            catalogOpen = true;
+        } else {
+            f_close(&catalogFile);
+        }
+    }
+    CaptureCatalogUnlock();
+
+    if (res == FR_OK) {
+        LogMessage(LOG_INFO_LVL, "Capture catalog: %lu files\r\n", (unsigned long)catalogCount);
+    }
+    return res;
+}
+
+/**
+ * @fn		void CaptureCatalogClose(void)
+ * @brief	Closes the catalog, for example before the SD card is unmounted. Every record is already on the card.
+ */
+void CaptureCatalogClose(void)
+{
+    if (!catalogOpen) {
+        return;
+    }
+    CaptureCatalogLock();
+    catalogOpen = false;
+    f_close(&catalogFile);
+    CaptureCatalogUnlock();
+}
+
+/**
+ * @fn		bool CaptureCatalogIsOpen(void)
+ * @brief	Returns true if CaptureCatalogOpen succeeded
+ */
+bool CaptureCatalogIsOpen(void)
+{
+    return catalogOpen;
+}
+
+/**
+ * @fn		uint32_t CaptureCatalogCount(void)
+ * @brief	Returns the number of records, those of replaced files included
+ */
+uint32_t CaptureCatalogCount(void)
+{
+    return catalogOpen ? catalogCount : 0;
+}
+
+/**
+ * @fn		uint32_t CaptureCatalogNewName(char *path, uint16_t size)
+ * @brief	Reserves an ID for a new file and makes its name unique. The requested name is kept if it is free,
+ *			otherwise "-<id>" is inserted before the extension.
+ * @param	path Requested path with drive prefix. Replaced by the name to create.
+ * @param	size Size of the path buffer
+ * @return	The reserved ID to pass in the record to CaptureCatalogAdd, 0 if no free name was found
+ * @note	IDs only go up, so a generated name is free unless a file was copied onto the card under that name.
+ *			One lookup is needed in the common case, never more than CAPTURE_CATALOG_NAME_TRIES + 1.
+ */
+uint32_t CaptureCatalogNewName(char *path, uint16_t size)
+{
+    char base[CAPTURE_CATALOG_NAME_MAX + 2];
+    char ext[CAPTURE_CATALOG_NAME_MAX];
+    FILINFO info;
+    uint32_t id;
+
+    info.lfname = NULL;
+    info.lfsize = 0;
+
+    CaptureCatalogLock();
+    id = catalogNextId++;
+    CaptureCatalogUnlock();
+    if (f_stat(path, &info) == FR_NO_FILE) {
+        return id;
+    }
+
+    const char *dot = strrchr(path, '.');
+    size_t baseLen = (dot != NULL) ? (size_t)(dot - path) : strlen(path);
+    if (baseLen >= sizeof(base) || (dot != NULL && strlen(dot) >= sizeof(ext))) {
+        return 0;
+    }
+    memcpy(base, path, baseLen);
+    base[baseLen] = '\0';
+    strcpy(ext, (dot != NULL) ? dot : "");
+
+    for (uint8_t i = 0; i < CAPTURE_CATALOG_NAME_TRIES; i++) {
+        if (i > 0) {
+            CaptureCatalogLock();
+            id = catalogNextId++;
+            CaptureCatalogUnlock();
+        }
+        int len = snprintf(path, size, "%s-%lu%s", base, (unsigned long)id, ext);
+        if (len < 0 || len >= size) {
+            return 0;
+        }
+        if (f_stat(path, &info) == FR_NO_FILE) {
+            return id;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @fn		FRESULT CaptureCatalogAdd(struct CaptureCatalogRecord *rec, const char *path, bool replaces)
+ * @brief	Appends the record of a completed file
+ * @param	rec Record with start, size, crc, channels, trigger and flags filled in, and the ID from
+ *			CaptureCatalogNewName or 0 to take a new one. id, end, name and check are set here.
+ * @param	path File path, with or without drive prefix
+ * @param	replaces true if the file took the place of an existing file of the same name. The previous record of the
+ *			name is then marked CAPTURE_CATALOG_FLAG_REPLACED.
+ * @return	FR_OK once the record is on the card. FR_NOT_READY if the catalog is not open, FR_INVALID_NAME if the name
+ *			is longer than CAPTURE_CATALOG_NAME_MAX allows.
+ * @note	Finding the previous record reads the catalog from the newest record back, one sector per 8 records,
+ *			so callers only ask for it when they overwrote a file.
+ */
+FRESULT CaptureCatalogAdd(struct CaptureCatalogRecord *rec, const char *path, bool replaces)
+{
+    FRESULT res;
+
+    if (!catalogOpen) {
+        return FR_NOT_READY;
+    }
+    if (path[0] != '\0' && path[1] == ':') {
+        path += 2;
+    }
+    if (strlen(path) >= CAPTURE_CATALOG_NAME_MAX) {
+        return FR_INVALID_NAME;
+    }
+
+    memset(rec->name, 0, sizeof(rec->name));
+    strcpy(rec->name, path);
+    rec->reserved = 0;
+    rec->end = get_fattime();
+    if (rec->start == 0 || rec->start > rec->end) {
+        rec->start = rec->end;
+    }
+
+    CaptureCatalogLock();
+    if (rec->id == 0) {
+        rec->id = catalogNextId++;
+    } else if (rec->id >= catalogNextId) {
+        catalogNextId = rec->id + 1;
+    }
+    res = replaces ? CaptureCatalogReplace(rec->name) : FR_OK;
+    if (res == FR_OK) {
+        res = CaptureCatalogAppend(rec);
+    }
+    CaptureCatalogUnlock();
+    return res;
+}
+
+/**
+ * @fn		FRESULT CaptureCatalogRead(uint32_t index, struct CaptureCatalogRecord *rec)
+ * @brief	Reads a record by position, 0 being the oldest
+ * @param	index Record position. Records flagged CAPTURE_CATALOG_FLAG_REPLACED are returned too.
+ * @param	rec Record read
+ * @return	FR_OK on success, FR_NO_FILE past the last record, FR_INT_ERR if the record is corrupt
+ */
+FRESULT CaptureCatalogRead(uint32_t index, struct CaptureCatalogRecord *rec)
+{
+    FRESULT res;
+
+    if (!catalogOpen) {
+        return FR_NOT_READY;
+    }
+    CaptureCatalogLock();
+    res = (index < catalogCount) ? CaptureCatalogReadRecord(index, rec) : FR_NO_FILE;
+    CaptureCatalogUnlock();
+    return res;
+}
+
+/**
+ * @fn		FRESULT CaptureCatalogFind(uint32_t time, struct CaptureCatalogRecord *rec)
+ * @brief	Finds the live file whose time span contains a point in time
+ * @param	time FAT timestamp
+ * @param	rec Record of the file
+ * @return	FR_OK if found, FR_NO_FILE if no file covers the time
+ * @note	O(log n) record reads while the catalog is sorted, O(n) otherwise. A corrupt record found on the way
+ *			rebuilds the catalog and the search runs once more.
+ */
+FRESULT CaptureCatalogFind(uint32_t time, struct CaptureCatalogRecord *rec)
+{
+    FRESULT res;
+
+    if (!catalogOpen) {
+        return FR_NOT_READY;
+    }
+    CaptureCatalogLock();
+    res = CaptureCatalogSearch(time, rec);
+    if (res == FR_INT_ERR) {
+        LogMessage(LOG_INFO_LVL, "Capture catalog: corrupt record, rebuilding\r\n");
+        res = CaptureCatalogScan();
+        if (res == FR_OK) {
+            res = CaptureCatalogSearch(time, rec);
+        }
+    }
+    CaptureCatalogUnlock();
+    return res;
+}
+
+/**
+ * @fn		FRESULT CaptureCatalogRebuild(void)
+ * @brief	Replaces the catalog with one record per file in the root directory
+ * @return	FR_OK on success, the FatFs error otherwise
+ * @note	Rebuilt records carry the modification time as start and end and no CRC
+ */
+FRESULT CaptureCatalogRebuild(void)
+{
+    FRESULT res;
+
+    if (!catalogOpen) {
+        return FR_NOT_READY;
+    }
+    CaptureCatalogLock();
+    res = CaptureCatalogScan();
+    CaptureCatalogUnlock();
+    return res;
+}
+
+/******************************************************************************
+ * Local Functions
+ ******************************************************************************/
+
+/**
+ * @fn		static uint32_t CaptureCatalogCheck(const void *data, size_t len)
+ * @brief	CRC-32 of a header or record without its trailing check field
+ */
+static uint32_t CaptureCatalogCheck(const void *data, size_t len)
+{
+    crc32_t crc;
+
+    crc32_calculate(data, len, &crc);
+    return crc;
+}
+
+/**
+ * @fn		static FRESULT CaptureCatalogLoad(void)
+ * @brief	Validates the open catalog file and loads the count, next ID and sort state
+ * @return	FR_OK if the catalog can be used. FR_NO_FILESYSTEM for an empty or foreign file and FR_INT_ERR for a
+ *			corrupt one, both of which need a rebuild.
+ */
+static FRESULT CaptureCatalogLoad(void)
+{
+    struct CaptureCatalogHeader hdr;
+    struct CaptureCatalogRecord rec;
+    FRESULT res;
+    UINT count;
+
+    res = f_lseek(&catalogFile, 0);
+    if (res == FR_OK) res = f_read(&catalogFile, &hdr, sizeof(hdr), &count);
+    if (res != FR_OK) {
+        return res;
+    }
+    if (count != sizeof(hdr) || hdr.magic != CAPTURE_CATALOG_MAGIC || hdr.version != CAPTURE_CATALOG_VERSION ||
+        hdr.recordSize != CAPTURE_CATALOG_RECORD_SIZE || hdr.check != CaptureCatalogCheck(&hdr, offsetof(struct CaptureCatalogHeader, check))) {
+        return FR_NO_FILESYSTEM;
+    }
+
+    catalogSorted = !(hdr.flags & CAPTURE_CATALOG_HEADER_UNSORTED);
+    catalogCount = (f_size(&catalogFile) - sizeof(hdr)) / CAPTURE_CATALOG_RECORD_SIZE;
+    catalogNextId = 1;
+    catalogLastEnd = 0;
+
+    // Only the last record can be torn by a reset during an append. A bad record before it means corruption.
+    if (catalogCount > 0 && CaptureCatalogReadRecord(catalogCount - 1, &rec) != FR_OK) {
+        catalogCount--;
+        if (catalogCount > 0 && CaptureCatalogReadRecord(catalogCount - 1, &rec) != FR_OK) {
+            return FR_INT_ERR;
+        }
+    }
+    if (f_size(&catalogFile) != sizeof(hdr) + catalogCount * CAPTURE_CATALOG_RECORD_SIZE) {
+        res = f_lseek(&catalogFile, sizeof(hdr) + catalogCount * CAPTURE_CATALOG_RECORD_SIZE);
+        if (res == FR_OK) res = f_truncate(&catalogFile);
+        if (res == FR_OK) res = f_sync(&catalogFile);
+        if (res != FR_OK) {
+            return res;
+        }
+    }
+    if (catalogCount > 0) {
+        catalogNextId = rec.id + 1;
+        catalogLastEnd = rec.end;
+    }
+    return FR_OK;
+}
+
+/**
+ * @fn		static FRESULT CaptureCatalogWriteHeader(void)
+ * @brief	Writes the header with the current sort state
+ * @return	FR_OK on success, the FatFs error otherwise
+ */
+static FRESULT CaptureCatalogWriteHeader(void)
+{
+    struct CaptureCatalogHeader hdr;
+    FRESULT res;
+    UINT count;
+
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.magic = CAPTURE_CATALOG_MAGIC;
+    hdr.version = CAPTURE_CATALOG_VERSION;
+    hdr.recordSize = CAPTURE_CATALOG_RECORD_SIZE;
+    hdr.flags = catalogSorted ? 0 : CAPTURE_CATALOG_HEADER_UNSORTED;
+    hdr.check = CaptureCatalogCheck(&hdr, offsetof(struct CaptureCatalogHeader, check));
+
+    res = f_lseek(&catalogFile, 0);
+    if (res == FR_OK) res = f_write(&catalogFile, &hdr, sizeof(hdr), &count);
+    if (res == FR_OK) res = f_sync(&catalogFile);
+    return res;
+}
+
+/**
+ * @fn		static FRESULT CaptureCatalogReadRecord(uint32_t index, struct CaptureCatalogRecord *rec)
+ * @brief	Reads and checks one record
+ * @param	index Record position, below catalogCount
+ * @param	rec Record read
+ * @return	FR_OK on success, FR_INT_ERR if the record is short or its check does not match
+ */
+static FRESULT CaptureCatalogReadRecord(uint32_t index, struct CaptureCatalogRecord *rec)
+{
+    FRESULT res;
+    UINT count;
+
+    res = f_lseek(&catalogFile, sizeof(struct CaptureCatalogHeader) + index * CAPTURE_CATALOG_RECORD_SIZE);
+    if (res == FR_OK) res = f_read(&catalogFile, rec, sizeof(*rec), &count);
+    if (res != FR_OK) {
+        return res;
+    }
+    if (count != sizeof(*rec) || rec->check != CaptureCatalogCheck(rec, offsetof(struct CaptureCatalogRecord, check))) {
+        return FR_INT_ERR;
+    }
+    return FR_OK;
+}
+
+/**
+ * @fn		static FRESULT CaptureCatalogAppend(struct CaptureCatalogRecord *rec)
+ * @brief	Writes a record after the last one and syncs it. Marks the catalog unsorted if the record ends before the
+ *			previous one.
+ * @param	rec Complete record. check is set here.
+ * @return	FR_OK once the record is on the card
+ */
+static FRESULT CaptureCatalogAppend(struct CaptureCatalogRecord *rec)
+{
+    FRESULT res;
+    UINT count;
+
+    rec->check = CaptureCatalogCheck(rec, offsetof(struct CaptureCatalogRecord, check));
+    res = f_lseek(&catalogFile, sizeof(struct CaptureCatalogHeader) + catalogCount * CAPTURE_CATALOG_RECORD_SIZE);
+    if (res == FR_OK) res = f_write(&catalogFile, rec, sizeof(*rec), &count);
+    if (res == FR_OK) res = f_sync(&catalogFile);
+    if (res != FR_OK) {
+        return res;
+    }
+    catalogCount++;
+
+    if (rec->end < catalogLastEnd && catalogSorted) {
+        catalogSorted = false;
+        res = CaptureCatalogWriteHeader();
+    }
+    if (rec->end > catalogLastEnd) {
+        catalogLastEnd = rec->end;
+    }
+    return res;
+}
+
+/**
+ * @fn		static FRESULT CaptureCatalogReplace(const char *name)
+ * @brief	Marks the live record of a name replaced, if there is one
+ * @param	name File name without drive prefix
+ * @return	FR_OK if there was none or it is marked, FR_INT_ERR on a corrupt record
+ * @note	A name has at most one live record, so the search stops at the newest match
+ */
+static FRESULT CaptureCatalogReplace(const char *name)
+{
+    struct CaptureCatalogRecord rec;
+    FRESULT res;
+    UINT count;
+
+    for (uint32_t i = catalogCount; i-- > 0;) {
+        res = CaptureCatalogReadRecord(i, &rec);
+        if (res != FR_OK) {
+            return res;
+        }
+        if (!(rec.flags & CAPTURE_CATALOG_FLAG_REPLACED) && strcmp(rec.name, name) == 0) {
+            rec.flags |= CAPTURE_CATALOG_FLAG_REPLACED;
+            rec.check = CaptureCatalogCheck(&rec, offsetof(struct CaptureCatalogRecord, check));
+            res = f_lseek(&catalogFile, sizeof(struct CaptureCatalogHeader) + i * CAPTURE_CATALOG_RECORD_SIZE);
+            if (res == FR_OK) res = f_write(&catalogFile, &rec, sizeof(rec), &count);
+            return res;  // Synced with the record that replaces it
+        }
+    }
+    return FR_OK;
+}
+
+/**
+ * @fn		static FRESULT CaptureCatalogScan(void)
+ * @brief	Rewrites the catalog from the files in the root directory
+ * @return	FR_OK on success, the FatFs error otherwise
+ * @note	Hidden and system files are skipped, which keeps the catalog itself out, and so are partial
+ *			CAPTURE_CATALOG_PARTIAL_SUFFIX files. A file whose long name does not fit a record is skipped rather than
+ *			cataloged under its 8.3 alias, which nothing else would look it up by.
+ */
+static FRESULT CaptureCatalogScan(void)
+{
+    struct CaptureCatalogRecord rec;
+    char lfn[CAPTURE_CATALOG_NAME_MAX];
+    char root[3] = {LUN_ID_SD_MMC_0_MEM + '0', ':', '\0'};
+    FILINFO info;
+    DIR dir;
+    FRESULT res;
+
+    catalogCount = 0;
+    catalogNextId = 1;
+    catalogLastEnd = 0;
+    catalogSorted = true;
+    res = f_lseek(&catalogFile, 0);
+    if (res == FR_OK) res = f_truncate(&catalogFile);
+    if (res == FR_OK) res = CaptureCatalogWriteHeader();
+    if (res == FR_OK) res = f_chmod(catalogPath, AM_HID, AM_HID);
+    if (res == FR_OK) res = f_opendir(&dir, root);
+
+    info.lfname = lfn;
+    info.lfsize = sizeof(lfn);
+    while (res == FR_OK) {
+        res = f_readdir(&dir, &info);
+        if (res != FR_OK || info.fname[0] == '\0') {
+            break;
+        }
+        if (info.fattrib & (AM_DIR | AM_HID | AM_SYS)) {
+            continue;
+        }
+        // FatFs leaves lfn empty when the long name does not fit, lfn_idx still tells that there is one
+        if (lfn[0] == '\0' && dir.lfn_idx != 0xFFFF) {
+            continue;
+        }
+        const char *name = (lfn[0] != '\0') ? lfn : info.fname;
+        size_t len = strlen(name);
+        if (len >= CAPTURE_CATALOG_NAME_MAX ||
+            (len >= sizeof(CAPTURE_CATALOG_PARTIAL_SUFFIX) - 1 &&
+             strcasecmp(&name[len - (sizeof(CAPTURE_CATALOG_PARTIAL_SUFFIX) - 1)], CAPTURE_CATALOG_PARTIAL_SUFFIX) == 0)) {
+            continue;
+        }
+
+        memset(&rec, 0, sizeof(rec));
+        rec.id = catalogNextId++;
+        rec.start = ((uint32_t)info.fdate << 16) | info.ftime;
+        rec.end = rec.start;
+        rec.size = info.fsize;
+        rec.flags = CAPTURE_CATALOG_FLAG_REBUILT;
+        strcpy(rec.name, name);
+        res = CaptureCatalogAppend(&rec);
+    }
+    return res;
+}
+
+/**
+ * @fn		static FRESULT CaptureCatalogSearch(uint32_t time, struct CaptureCatalogRecord *rec)
+ * @brief	Looks up a time, by bisection on the end times if the catalog is sorted
+ * @param	time FAT timestamp
+ * @param	rec Record of the file
+ * @return	FR_OK if found, FR_NO_FILE if not, FR_INT_ERR on a corrupt record
+ */
+static FRESULT CaptureCatalogSearch(uint32_t time, struct CaptureCatalogRecord *rec)
+{
+    FRESULT res;
+
+    if (catalogSorted) {
+        // First file that ends at or after the time. It covers the time if it also started before it.
+        uint32_t lo = 0, hi = catalogCount;
+        while (lo < hi) {
+            uint32_t mid = lo + (hi - lo) / 2;
+            res = CaptureCatalogReadRecord(mid, rec);
+            if (res != FR_OK) {
+                return res;
+            }
+            if (rec->end < time) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        // Replaced files keep their place in the order, the first live one after them is the candidate
+        for (; lo < catalogCount; lo++) {
+            res = CaptureCatalogReadRecord(lo, rec);
+            if (res != FR_OK) {
+                return res;
+            }
+            if (!(rec->flags & CAPTURE_CATALOG_FLAG_REPLACED)) {
+                return (rec->start <= time) ? FR_OK : FR_NO_FILE;
+            }
+        }
+        return FR_NO_FILE;
+    }
+
+    for (uint32_t i = catalogCount; i-- > 0;) {
+        res = CaptureCatalogReadRecord(i, rec);
+        if (res != FR_OK) {
+            return res;
+        }
+        if (!(rec->flags & CAPTURE_CATALOG_FLAG_REPLACED) && rec->start <= time && time <= rec->end) {
+            return FR_OK;
+        }
+    }
+    return FR_NO_FILE;
+}
+
+/**
+ * @fn		static void CaptureCatalogLock(void)
+ * @brief	Takes the catalog mutex, if it exists yet
+ */
+static void CaptureCatalogLock(void)
+{
+    if (catalogMutex != NULL) {
+        xSemaphoreTake(catalogMutex, portMAX_DELAY);
+    }
+}
+
+/**
+ * @fn		static void CaptureCatalogUnlock(void)
+ * @brief	Gives the catalog mutex back
+ */
+static void CaptureCatalogUnlock(void)
+{
+    if (catalogMutex != NULL) {
+        xSemaphoreGive(catalogMutex);
+    }
+}
@@ -0,0 +1,78 @@
+/**************************************************************************/ /**
+ * @file      CaptureCatalog.h
+ * @brief     Append-only catalog of the files stored on the SD card. One fixed-size record per file with its time
+ *            span, channels, trigger, size and CRC, so files are found by time with a binary search instead of a
+ *            directory scan, and new files get a unique name without probing.
+ * @date      2026-10-19
+
+ ******************************************************************************/
+
+#pragma once
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************************************************************************
+ * Includes
+ ******************************************************************************/
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "ff.h"
+
+/******************************************************************************
+ * Defines
+ ******************************************************************************/
+#define CAPTURE_CATALOG_FILE "0:captures.cat"  ///< Hidden, so it is not listed or cataloged itself
+#define CAPTURE_CATALOG_NAME_MAX 36             ///< Longest file name cataloged, without drive prefix, terminator included
+#define CAPTURE_CATALOG_NAME_TRIES 4            ///< Numbered names tried when a name is taken by an uncataloged file
+
+#define CAPTURE_CATALOG_FLAG_CRC 0x01       ///< crc holds the CRC-32 of the whole file
+#define CAPTURE_CATALOG_FLAG_REBUILT 0x02   ///< Recovered by a directory scan. start and end are the modification time
+#define CAPTURE_CATALOG_FLAG_REPLACED 0x04  ///< A newer record has the same name. Skipped by lookups
+
+/*
+ * File layout: a header the size of a record, then the records in the order the files were closed. Times are FAT
+ * timestamps as returned by get_fattime, which compare like integers. Records are sorted by end unless the clock
+ * went backwards or the catalog was rebuilt; the header then says so and lookups scan instead of bisecting.
+ * A name has at most one live record: adding a file that overwrote another marks the previous record of its name
+ * CAPTURE_CATALOG_FLAG_REPLACED, which is the only change ever made to a written record.
+ * A torn record at the end is cut off on open. A record with a bad check anywhere else rebuilds the catalog from
+ * the directory.
+ */
+
+/******************************************************************************
+ * Structures and Enumerations
+ ******************************************************************************/
+
+/// One cataloged file, 64 bytes on the card
+struct CaptureCatalogRecord {
+    uint32_t id;        ///< Unique number of the file, also used in generated names
+    uint32_t start;     ///< FAT timestamp of the first data
+    uint32_t end;       ///< FAT timestamp of the last data, set by CaptureCatalogAdd
+    uint32_t size;      ///< File size in bytes
+    uint32_t crc;       ///< CRC-32 of the file if flags has CAPTURE_CATALOG_FLAG_CRC
+    uint8_t channels;   ///< enum CaptureChannel bits captured, 0 for files that are not sensor captures
+    uint8_t trigger;    ///< enum CaptureTrigger the capture ran with
+    uint8_t flags;      ///< CAPTURE_CATALOG_FLAG_ bits
+    uint8_t reserved;
+    char name[CAPTURE_CATALOG_NAME_MAX];  ///< File name without drive prefix
+    uint32_t check;     ///< CRC-32 of the fields above
+};
+
+/******************************************************************************
+ * Global Function Declaration
+ ******************************************************************************/
+FRESULT CaptureCatalogOpen(void);
+void CaptureCatalogClose(void);
+bool CaptureCatalogIsOpen(void);
+uint32_t CaptureCatalogCount(void);
+uint32_t CaptureCatalogNewName(char *path, uint16_t size);
+FRESULT CaptureCatalogAdd(struct CaptureCatalogRecord *rec, const char *path, bool replaces);
+FRESULT CaptureCatalogRead(uint32_t index, struct CaptureCatalogRecord *rec);
+FRESULT CaptureCatalogFind(uint32_t time, struct CaptureCatalogRecord *rec);
+FRESULT CaptureCatalogRebuild(void);
+
+#ifdef __cplusplus
+}
+#endif
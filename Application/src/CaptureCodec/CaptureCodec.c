@@ -0,0 +1,515 @@
+/**************************************************************************/ /**
+ * @file      CaptureCodec.c
+ * @brief     Lossless compression of capture blocks before they are streamed or stored. Each axis is predicted from
+ *            its last sample or its last difference, runs of exact predictions are run-length coded and the
+ *            remaining residuals are Rice coded with a parameter adapted over a small window.
+ * @details   The encoder works on the SERIAL_STREAM_CAPTURE payload built by the IMU task, so the stream, the UDP
+ *            datagrams and the SD segments carry the same packed block. The work per sample is bounded: two
+ *            error sums to pick the predictor, one prediction, at most 15 steps to find k and at most 32 output bits. State is a few words on the stack,
+ *            nothing is kept between blocks, so each block decodes on its own after a lost datagram.
+ * @date      2026-10-19
+
+ ******************************************************************************/
+
+/******************************************************************************
+ * Includes
+ ******************************************************************************/
+#include "CaptureCodec/CaptureCodec.h"
+
+#include <string.h>
+
+#include "BusStats/BusStats.h"
+#include "FreeRTOS.h"
+#include "SerialConsole.h"
+#include "task.h"
+
+/******************************************************************************
+ * Structures and Enumerations
+ ******************************************************************************/
+
+/// Bit stream over a byte buffer, most significant bit first
+struct CodecBits {
+    uint8_t *buf;
+    uint16_t size;  ///< Buffer size in bytes
+    uint16_t pos;   ///< Bytes completed
+    uint32_t acc;   ///< Bits not yet stored, right aligned
+    uint8_t bits;   ///< Number of bits in acc
+    bool overflow;  ///< Writer ran out of buffer, reader ran out of data
+};
+
+/// Prediction and adaptation state of one axis
+struct CodecAxis {
+    int16_t x1;  ///< Previous sample
+    int16_t x2;  ///< Sample before that
+    uint8_t order;  ///< 1 predicts the previous sample, 2 extends the last difference
+    uint32_t a;  ///< Sum of the recent mapped residuals
+    uint32_t n;  ///< Number of recent residuals
+};
+
+/******************************************************************************
+ * Variables
+ ******************************************************************************/
+static volatile bool codecEnabled = true;
+static struct CaptureCodecStats codecStats;
+#if CAPTURE_CODEC_VERIFY
+static uint8_t codecVerify[SERIAL_STREAM_MAX_PAYLOAD];  ///< Decoded copy of the last packed block
+#endif
+
+/******************************************************************************
+ * Forward Declarations
+ ******************************************************************************/
+static uint16_t CaptureCodecPack(const uint8_t *raw, uint16_t len, uint8_t *packed, uint16_t size);
+static uint8_t CaptureCodecChannels(const uint8_t *header);
+static void CodecAxisInit(struct CodecAxis *axis, uint8_t order);
+static uint8_t CodecAxisOrder(const uint8_t *raw, uint8_t nch, uint8_t count, uint8_t c);
+static uint16_t CodecAxisPredict(const struct CodecAxis *axis, uint8_t i);
+static uint16_t CodecAxisResidual(const struct CodecAxis *axis, uint8_t i, int16_t x);
+static void CodecAxisUpdate(struct CodecAxis *axis, int16_t x, uint16_t u);
+static uint8_t CodecAxisK(const struct CodecAxis *axis);
+static void CodecPutBits(struct CodecBits *bw, uint32_t value, uint8_t count);
+static uint32_t CodecGetBits(struct CodecBits *br, uint8_t count);
+static int16_t CodecReadSample(const uint8_t *raw, uint16_t index);
+static void CodecWriteSample(uint8_t *raw, uint16_t index, int16_t x);
+
+/******************************************************************************
+ * Global Functions
+ ******************************************************************************/
+
+/**
+ * @fn			uint16_t CaptureCodecEncode(const uint8_t *raw, uint16_t len, uint8_t *packed, uint16_t size)
+ * @brief		Packs a SERIAL_STREAM_CAPTURE payload into a SERIAL_STREAM_CAPTURE_PACKED payload
+ * @param[in]	raw Capture payload (see ImuFifoStreamBatch)
+ * @param[in]	len Length of raw
+ * @param[out]	packed Packed payload
+ * @param[in]	size Size of packed. Encoding stops once it is full.
+ * @return		Length of the packed payload, 0 if it would not be shorter than raw (send raw as it is)
+ * @note		Counts the block in the statistics either way
+ */
+uint16_t CaptureCodecEncode(const uint8_t *raw, uint16_t len, uint8_t *packed, uint16_t size)
+{
+    uint32_t startUs = BusStatsNowUs();
+    uint16_t out = CaptureCodecPack(raw, len, packed, (size < len) ? size : (uint16_t)(len - 1));
+    uint32_t tookUs = BusStatsNowUs() - startUs;
+    bool mismatch = false;
+
+#if CAPTURE_CODEC_VERIFY
+    if (out != 0) {
+        mismatch = (CaptureCodecDecode(packed, out, codecVerify, sizeof(codecVerify)) != len) || (memcmp(codecVerify, raw, len) != 0);
+    }
+#endif
+
+    taskENTER_CRITICAL();
+    codecStats.blocks++;
+    codecStats.rawBytes += len;
+    codecStats.packedBytes += (out != 0) ? out : len;
+    if (out != 0) {
+        codecStats.packedBlocks++;
+    }
+    if (tookUs > codecStats.worstEncodeUs) {
+        codecStats.worstEncodeUs = tookUs;
+    }
+    if (mismatch) {
+        codecStats.mismatches++;
+    }
+    taskEXIT_CRITICAL();
+    return out;
+}
+
+/**
+ * @fn			int32_t CaptureCodecDecode(const uint8_t *packed, uint16_t len, uint8_t *raw, uint16_t size)
+ * @brief		Unpacks a SERIAL_STREAM_CAPTURE_PACKED payload. Reference for receivers of the stream.
+ * @param[in]	packed Packed payload
+ * @param[in]	len Length of packed
+ * @param[out]	raw Capture payload, as built by ImuFifoStreamBatch
+ * @param[in]	size Size of raw
+ * @return		Length of the capture payload, -1 if the packed payload is malformed or raw is too small
+ * @note
+ */
+int32_t CaptureCodecDecode(const uint8_t *packed, uint16_t len, uint8_t *raw, uint16_t size)
+{
+    uint8_t nch;
+    uint8_t count;
+    uint16_t rawLen;
+    struct CodecBits br = {(uint8_t *)packed, len, CAPTURE_CODEC_HEADER, 0, 0, false};
+
+    if (len < CAPTURE_CODEC_HEADER) {
+        return -1;
+    }
+    nch = CaptureCodecChannels(packed);
+    count = packed[CAPTURE_CODEC_HEADER - 1];
+    rawLen = CAPTURE_CODEC_HEADER + (uint16_t)count * nch * 2;
+    if (rawLen > size) {
+        return -1;
+    }
+    memcpy(raw, packed, CAPTURE_CODEC_HEADER);
+
+    for (uint8_t c = 0; c < nch; c++) {
+        struct CodecAxis axis;
+        uint16_t prevU = 1;
+        bool afterRun = false;
+        uint8_t i = 0;
+
+        CodecAxisInit(&axis, 1 + (uint8_t)CodecGetBits(&br, 1));
+        if (count > 0) {
+            axis.x1 = (int16_t)(uint16_t)CodecGetBits(&br, 16);
+            CodecWriteSample(raw, c, axis.x1);
+            i = 1;
+        }
+        while (i < count) {
+            uint8_t k = CodecAxisK(&axis);
+            uint16_t u;
+
+            if (!afterRun && k == 0 && prevU == 0) {
+                // Elias gamma: leading zeros give the bit length of run + 1
+                uint8_t zeros = 0;
+                while (CodecGetBits(&br, 1) == 0 && zeros < 9 && !br.overflow) {
+                    zeros++;
+                }
+                uint16_t run = (uint16_t)(((1u << zeros) | CodecGetBits(&br, zeros)) - 1);
+                if (br.overflow || zeros >= 9 || run > count - i) {
+                    return -1;
+                }
+                for (; run > 0; run--, i++) {
+                    int16_t x = (int16_t)CodecAxisPredict(&axis, i);
+                    CodecWriteSample(raw, (uint16_t)i * nch + c, x);
+                    CodecAxisUpdate(&axis, x, 0);
+                }
+                afterRun = true;
+                continue;
+            }
+
+            uint16_t q = 0;
+            while (q < CAPTURE_CODEC_ESCAPE && CodecGetBits(&br, 1) == 1) {
+                q++;
+            }
+            u = (q < CAPTURE_CODEC_ESCAPE) ? (uint16_t)((q << k) | CodecGetBits(&br, k)) : (uint16_t)CodecGetBits(&br, 16);
+            if (br.overflow) {
+                return -1;
+            }
+            uint16_t r = (uint16_t)(u >> 1) ^ (uint16_t)(0 - (u & 1));
+            int16_t x = (int16_t)(uint16_t)(CodecAxisPredict(&axis, i) + r);
+            CodecWriteSample(raw, (uint16_t)i * nch + c, x);
+            CodecAxisUpdate(&axis, x, u);
+            prevU = u;
+            afterRun = false;
+            i++;
+        }
+    }
+    return rawLen;
+}
+
+/**
+ * @fn			void CaptureCodecSetEnabled(bool enabled)
+ * @brief		Selects whether capture blocks are sent packed
+ * @param[in]	enabled true to pack, false to send SERIAL_STREAM_CAPTURE payloads as they are
+ */
+void CaptureCodecSetEnabled(bool enabled)
+{
+    codecEnabled = enabled;
+}
+
+/**
+ * @fn			bool CaptureCodecIsEnabled(void)
+ * @brief		Returns whether capture blocks are sent packed
+ * @return		true if the IMU task packs capture blocks
+ */
+bool CaptureCodecIsEnabled(void)
+{
+    return codecEnabled;
+}
+
+/**
+ * @fn			void CaptureCodecGetStats(struct CaptureCodecStats *stats)
+ * @brief		Returns the encoder counters since boot
+ * @param[out]	stats Counters
+ */
+void CaptureCodecGetStats(struct CaptureCodecStats *stats)
+{
+    taskENTER_CRITICAL();
+    *stats = codecStats;
+    taskEXIT_CRITICAL();
+}
+
+/******************************************************************************
+ * Local Functions
+ ******************************************************************************/
+
+/**
+ * @fn			static uint16_t CaptureCodecPack(const uint8_t *raw, uint16_t len, uint8_t *packed, uint16_t size)
+ * @brief		Encodes the axes of a capture payload one after the other
+ * @param[in]	raw Capture payload
+ * @param[in]	len Length of raw
+ * @param[out]	packed Packed payload
+ * @param[in]	size Bytes the packed payload may take, less than len
+ * @return		Length of the packed payload, 0 if raw is malformed or the packed payload would take more than size bytes
+ * @note
+ */
+static uint16_t CaptureCodecPack(const uint8_t *raw, uint16_t len, uint8_t *packed, uint16_t size)
+{
+    uint8_t nch;
+    uint8_t count;
+    struct CodecBits bw = {packed, size, CAPTURE_CODEC_HEADER, 0, 0, false};
+
+    if (len < CAPTURE_CODEC_HEADER || size <= CAPTURE_CODEC_HEADER) {
+        return 0;
+    }
+    nch = CaptureCodecChannels(raw);
+    count = raw[CAPTURE_CODEC_HEADER - 1];
+    if (nch == 0 || len != CAPTURE_CODEC_HEADER + (uint16_t)count * nch * 2) {
+        return 0;
+    }
+    memcpy(packed, raw, CAPTURE_CODEC_HEADER);
+
+    for (uint8_t c = 0; c < nch && !bw.overflow; c++) {
+        struct CodecAxis axis;
+        uint16_t prevU = 1;
+        bool afterRun = false;
+        uint8_t i = 0;
+
+        uint8_t order = CodecAxisOrder(raw, nch, count, c);
+        CodecPutBits(&bw, order - 1, 1);
+        CodecAxisInit(&axis, order);
+        if (count > 0) {
+            axis.x1 = CodecReadSample(raw, c);
+            CodecPutBits(&bw, (uint16_t)axis.x1, 16);
+            i = 1;
+        }
+        while (i < count && !bw.overflow) {
+            uint8_t k = CodecAxisK(&axis);
+            int16_t x = CodecReadSample(raw, (uint16_t)i * nch + c);
+            uint16_t u = CodecAxisResidual(&axis, i, x);
+
+            if (!afterRun && k == 0 && prevU == 0) {
+                // Run mode: count the exact predictions that follow, then send run + 1 as an Elias gamma code
+                uint16_t run = 0;
+                while (u == 0) {
+                    CodecAxisUpdate(&axis, x, 0);
+                    run++;
+                    if (++i == count) {
+                        break;
+                    }
+                    x = CodecReadSample(raw, (uint16_t)i * nch + c);
+                    u = CodecAxisResidual(&axis, i, x);
+                }
+                uint8_t bits = 0;
+                while ((uint16_t)(run + 1) >> bits) {
+                    bits++;
+                }
+                CodecPutBits(&bw, 0, bits - 1);
+                CodecPutBits(&bw, run + 1, bits);
+                afterRun = true;
+                continue;
+            }
+
+            uint16_t q = u >> k;
+            if (q < CAPTURE_CODEC_ESCAPE) {
+                CodecPutBits(&bw, ((1u << q) - 1) << 1, q + 1);
+                CodecPutBits(&bw, u & ((1u << k) - 1), k);
+            } else {
+                CodecPutBits(&bw, (1u << CAPTURE_CODEC_ESCAPE) - 1, CAPTURE_CODEC_ESCAPE);
+                CodecPutBits(&bw, u, 16);
+            }
+            CodecAxisUpdate(&axis, x, u);
+            prevU = u;
+            afterRun = false;
+            i++;
+        }
+    }
+
+    if (!bw.overflow && bw.bits > 0) {
+        CodecPutBits(&bw, 0, 8 - bw.bits);
+    }
+    return bw.overflow ? 0 : bw.pos;
+}
+
+/**
+ * @fn			static uint8_t CaptureCodecChannels(const uint8_t *header)
+ * @brief		Counts the axes enabled in the header of a capture payload
+ * @param[in]	header Capture payload header
+ * @return		Number of int16 values per sample
+ */
+static uint8_t CaptureCodecChannels(const uint8_t *header)
+{
+    uint8_t nch = 0;
+
+    for (uint8_t axis = 0; axis < 3; axis++) {
+        if (header[CAPTURE_CODEC_HEADER - 2] & (1 << axis)) {
+            nch++;
+        }
+    }
+    return nch;
+}
+
+/**
+ * @fn			static void CodecAxisInit(struct CodecAxis *axis, uint8_t order)
+ * @brief		Resets the prediction and adaptation state at the start of an axis
+ * @param[out]	axis Axis state
+ * @param[in]	order Predictor order of the axis, 1 or 2
+ */
+static void CodecAxisInit(struct CodecAxis *axis, uint8_t order)
+{
+    axis->x1 = 0;
+    axis->x2 = 0;
+    axis->order = order;
+    axis->a = 8;
+    axis->n = 1;
+}
+
+/**
+ * @fn			static uint8_t CodecAxisOrder(const uint8_t *raw, uint8_t nch, uint8_t count, uint8_t c)
+ * @brief		Picks the predictor of an axis: the previous sample for noise around a level, the extended difference
+ *				for smooth motion
+ * @param[in]	raw Capture payload
+ * @param[in]	nch Values per sample
+ * @param[in]	count Samples in the block
+ * @param[in]	c Axis, as an index into each sample
+ * @return		Order with the smaller sum of absolute prediction errors over the block, 2 on a tie
+ */
+static uint8_t CodecAxisOrder(const uint8_t *raw, uint8_t nch, uint8_t count, uint8_t c)
+{
+    uint32_t sum1 = 0;
+    uint32_t sum2 = 0;
+
+    for (uint8_t i = 2; i < count; i++) {
+        int32_t x0 = CodecReadSample(raw, (uint16_t)i * nch + c);
+        int32_t d1 = x0 - CodecReadSample(raw, (uint16_t)(i - 1) * nch + c);
+        int32_t d2 = d1 - (CodecReadSample(raw, (uint16_t)(i - 1) * nch + c) - CodecReadSample(raw, (uint16_t)(i - 2) * nch + c));
+        sum1 += (d1 < 0) ? -d1 : d1;
+        sum2 += (d2 < 0) ? -d2 : d2;
+    }
+    return (sum1 < sum2) ? 1 : 2;
+}
+
+/**
+ * @fn			static uint16_t CodecAxisPredict(const struct CodecAxis *axis, uint8_t i)
+ * @brief		Predicts sample i of an axis from the samples before it
+ * @param[in]	axis Axis state after sample i - 1
+ * @param[in]	i Sample index in the block, from 1 on
+ * @return		Prediction, modulo 2^16
+ */
+static uint16_t CodecAxisPredict(const struct CodecAxis *axis, uint8_t i)
+{
+    if (i == 1 || axis->order == 1) {
+        return (uint16_t)axis->x1;
+    }
+    return (uint16_t)(2 * (uint16_t)axis->x1 - (uint16_t)axis->x2);
+}
+
+/**
+ * @fn			static uint16_t CodecAxisResidual(const struct CodecAxis *axis, uint8_t i, int16_t x)
+ * @brief		Predicts sample i of an axis and maps the prediction error
+ * @param[in]	axis Axis state after sample i - 1
+ * @param[in]	i Sample index in the block
+ * @param[in]	x Sample
+ * @return		Zigzag mapped residual, 0 if the prediction was exact
+ */
+static uint16_t CodecAxisResidual(const struct CodecAxis *axis, uint8_t i, int16_t x)
+{
+    int16_t r = (int16_t)(uint16_t)((uint16_t)x - CodecAxisPredict(axis, i));
+    return (uint16_t)(((uint16_t)r << 1) ^ (uint16_t)(r >> 15));
+}
+
+/**
+ * @fn			static void CodecAxisUpdate(struct CodecAxis *axis, int16_t x, uint16_t u)
+ * @brief		Moves the prediction on by one sample and adds the residual to the adaptation statistics
+ * @param[in,out]	axis Axis state
+ * @param[in]	x Sample just coded
+ * @param[in]	u Its mapped residual
+ */
+static void CodecAxisUpdate(struct CodecAxis *axis, int16_t x, uint16_t u)
+{
+    axis->x2 = axis->x1;
+    axis->x1 = x;
+    axis->a += u;
+    if (++axis->n >= CAPTURE_CODEC_WINDOW) {
+        axis->a >>= 1;
+        axis->n >>= 1;
+    }
+}
+
+/**
+ * @fn			static uint8_t CodecAxisK(const struct CodecAxis *axis)
+ * @brief		Rice parameter for the next residual of an axis
+ * @param[in]	axis Axis state
+ * @return		Smallest k with (N << k) >= A, at most 15
+ */
+static uint8_t CodecAxisK(const struct CodecAxis *axis)
+{
+    uint8_t k = 0;
+
+    while ((axis->n << k) < axis->a && k < 15) {
+        k++;
+    }
+    return k;
+}
+
+/**
+ * @fn			static void CodecPutBits(struct CodecBits *bw, uint32_t value, uint8_t count)
+ * @brief		Appends the low bits of a value to a bit stream
+ * @param[in,out]	bw Bit stream
+ * @param[in]	value Bits to append, right aligned
+ * @param[in]	count Number of bits, at most 17
+ * @note		Sets bw->overflow instead of writing past the buffer
+ */
+static void CodecPutBits(struct CodecBits *bw, uint32_t value, uint8_t count)
+{
+    bw->acc = (bw->acc << count) | (value & ((1ul << count) - 1));
+    bw->bits += count;
+    while (bw->bits >= 8) {
+        bw->bits -= 8;
+        if (bw->pos >= bw->size) {
+            bw->overflow = true;
+            return;
+        }
+        bw->buf[bw->pos++] = (uint8_t)(bw->acc >> bw->bits);
+    }
+}
+
+/**
+ * @fn			static uint32_t CodecGetBits(struct CodecBits *br, uint8_t count)
+ * @brief		Takes the next bits from a bit stream
+ * @param[in,out]	br Bit stream
+ * @param[in]	count Number of bits, at most 16
+ * @return		Bits, right aligned. Zeros past the end of the data, with br->overflow set.
+ */
+static uint32_t CodecGetBits(struct CodecBits *br, uint8_t count)
+{
+    while (br->bits < count) {
+        uint8_t byte = 0;
+        if (br->pos < br->size) {
+            byte = br->buf[br->pos++];
+        } else {
+            br->overflow = true;
+        }
+        br->acc = (br->acc << 8) | byte;
+        br->bits += 8;
+    }
+    br->bits -= count;
+    return (br->acc >> br->bits) & ((1ul << count) - 1);
+}
+
+/**
+ * @fn			static int16_t CodecReadSample(const uint8_t *raw, uint16_t index)
+ * @brief		Reads one little endian int16 of a capture payload
+ * @param[in]	raw Capture payload
+ * @param[in]	index Sample word after the header
+ * @return		Sample
+ */
+static int16_t CodecReadSample(const uint8_t *raw, uint16_t index)
+{
+    const uint8_t *p = &raw[CAPTURE_CODEC_HEADER + index * 2];
+    return (int16_t)(uint16_t)(p[0] | ((uint16_t)p[1] << 8));
+}
+
+/**
+ * @fn			static void CodecWriteSample(uint8_t *raw, uint16_t index, int16_t x)
+ * @brief		Writes one little endian int16 of a capture payload
+ * @param[out]	raw Capture payload
+ * @param[in]	index Sample word after the header
+ * @param[in]	x Sample
+ */
+static void CodecWriteSample(uint8_t *raw, uint16_t index, int16_t x)
+{
+    raw[CAPTURE_CODEC_HEADER + index * 2] = (uint8_t)x;
+    raw[CAPTURE_CODEC_HEADER + index * 2 + 1] = (uint8_t)((uint16_t)x >> 8);
+}
@@ -0,0 +1,72 @@
+/**************************************************************************/ /**
+ * @file      CaptureCodec.h
+ * @brief     Lossless compression of capture blocks before they are streamed or stored. Each axis is predicted from
+ *            its last sample or its last difference, runs of exact predictions are run-length coded and the
+ *            remaining residuals are Rice coded with a parameter adapted over a small window.
+ * @date      2026-10-19
+
+ ******************************************************************************/
+
+#pragma once
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************************************************************************
+ * Includes
+ ******************************************************************************/
+#include <stdbool.h>
+#include <stdint.h>
+
+/******************************************************************************
+ * Defines
+ ******************************************************************************/
+#define CAPTURE_CODEC_HEADER 10  ///< t0 (4), t1 (4), channelMask, count, as in a SERIAL_STREAM_CAPTURE payload
+#define CAPTURE_CODEC_ESCAPE 16  ///< Rice quotients from this value on are sent as the raw 16 bit residual
+#define CAPTURE_CODEC_WINDOW 16  ///< Residuals after which the adaptation statistics are halved
+#define CAPTURE_CODEC_VERIFY 0   ///< 1 decodes every packed block again and counts mismatches (debug)
+
+/*
+ * SERIAL_STREAM_CAPTURE_PACKED payload: the 10 byte header of the SERIAL_STREAM_CAPTURE payload, then a bit stream,
+ * most significant bit first, padded with zeros to a byte. The stream holds the enabled axes one after the other in
+ * X, Y, Z order. Each axis starts with one bit selecting its predictor order and its first sample in 16 bits. The
+ * other samples are coded as follows, with A = 8 and N = 1 at the start of the axis:
+ *   prediction  the first sample for the second. After that x[i-1] for order 1
+ *               (bit 0), 2 * x[i-1] - x[i-2] for order 2 (bit 1). The encoder picks the order with the smaller
+ *               sum of absolute errors over the block.
+ *   residual    (int16)(x[i] - prediction), zigzag mapped to u = (r << 1) ^ (r >> 15)
+ *   k           smallest value with (N << k) >= A
+ *   run mode    entered when k is 0 and the previous residual was 0: Elias gamma code of (run + 1), where run is
+ *               the number of zero residuals that follow. Unless the axis ends with the run, the next residual
+ *               is coded normally without entering run mode again.
+ *   normal      q = u >> k. If q < CAPTURE_CODEC_ESCAPE: q one bits, a zero bit, the k low bits of u. Otherwise
+ *               CAPTURE_CODEC_ESCAPE one bits followed by u in 16 bits.
+ *   adaptation  after each residual, A += u and N += 1. When N reaches CAPTURE_CODEC_WINDOW, A and N are halved.
+ */
+
+/******************************************************************************
+ * Structures and Enumerations
+ ******************************************************************************/
+
+/// Counters since boot
+struct CaptureCodecStats {
+    uint32_t blocks;         ///< Blocks given to the encoder
+    uint32_t packedBlocks;   ///< Blocks sent packed. The others did not get smaller and were sent as they were
+    uint32_t rawBytes;       ///< Payload bytes of all blocks before encoding
+    uint32_t packedBytes;    ///< Payload bytes of all blocks as sent
+    uint32_t worstEncodeUs;  ///< Longest encoding of one block
+    uint32_t mismatches;     ///< Blocks that did not decode to the input (CAPTURE_CODEC_VERIFY only)
+};
+
+/******************************************************************************
+ * Global Function Declaration
+ ******************************************************************************/
+uint16_t CaptureCodecEncode(const uint8_t *raw, uint16_t len, uint8_t *packed, uint16_t size);
+int32_t CaptureCodecDecode(const uint8_t *packed, uint16_t len, uint8_t *raw, uint16_t size);
+void CaptureCodecSetEnabled(bool enabled);
+bool CaptureCodecIsEnabled(void);
+void CaptureCodecGetStats(struct CaptureCodecStats *stats);
+
+#ifdef __cplusplus
+}
+#endif
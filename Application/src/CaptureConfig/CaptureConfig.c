@@ -0,0 +1,243 @@
+/**************************************************************************/ /**
+ * @file      CaptureConfig.c
+ * @brief     Remote capture configuration. A compact binary message on the capture control topic sets the channel
+ *            mask, sample rate, trigger, decoder and ID filters. The capture task swaps the new configuration in
+ *            between two capture blocks and the effective configuration is sent back as the acknowledgement.
+ * @details   The MQTT handler decodes and validates a message and leaves it in a single pending slot. A newer
+ *            message replaces one that has not been picked up yet. The capture task takes the pending
+ *            configuration when a block is finished, adjusts what the front end cannot do (for example the sample
+ *            rate) and reports the result, which the Wifi task publishes as the ack. A block is therefore always
+ *            captured and filtered with one configuration from start to end.
+ * @date      2026-10-19
+
+ ******************************************************************************/
+
+/******************************************************************************
+ * Includes
+ ******************************************************************************/
+#include "CaptureConfig/CaptureConfig.h"
+
+#include <string.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+/******************************************************************************
+ * Variables
+ ******************************************************************************/
+static struct CaptureConfig captureActive = {CAPTURE_CH_ALL, CAPTURE_TRIGGER_NONE, 0, CAPTURE_DECODER_RAW, CAPTURE_CONFIG_DEFAULT_RATE_HZ, 0, 0, {0}};
+static struct CaptureConfig capturePending;  ///< Validated config waiting for the next block boundary
+static bool capturePendingValid = false;
+static uint8_t capturePendingSeq = 0;
+static bool captureAckValid = false;         ///< An ack is waiting to be published
+static uint8_t captureAckSeq = 0;
+static uint8_t captureAckStatus = CAPTURE_CONFIG_OK;
+
+/******************************************************************************
+ * Global Functions
+ ******************************************************************************/
+
+/**
+ * @fn			void CaptureConfigGetDefaults(struct CaptureConfig *cfg)
+ * @brief		Fills cfg with the configuration used at boot: all channels, no trigger, raw samples, no filters
+ * @param[out]	cfg Configuration to fill
+ * @note
+ */
+void CaptureConfigGetDefaults(struct CaptureConfig *cfg)
+{
+    memset(cfg, 0, sizeof(struct CaptureConfig));
+    cfg->channelMask = CAPTURE_CH_ALL;
+    cfg->triggerMode = CAPTURE_TRIGGER_NONE;
+    cfg->decoder = CAPTURE_DECODER_RAW;
+    cfg->sampleRateHz = CAPTURE_CONFIG_DEFAULT_RATE_HZ;
+}
+
+/**
+ * @fn			enum CaptureConfigStatus CaptureConfigDecode(const uint8_t *buf, uint16_t len, uint8_t *seq, struct CaptureConfig *cfg)
+ * @brief		Parses and validates a config message
+ * @param[in]	buf Message payload
+ * @param[in]	len Payload length
+ * @param[out]	seq Sequence number of the message, echoed in the ack. Set whenever len > 1
+ * @param[out]	cfg Decoded configuration, only valid when CAPTURE_CONFIG_OK is returned
+ * @return		CAPTURE_CONFIG_OK, or the reason the message was rejected
+ * @note
+ */
+enum CaptureConfigStatus CaptureConfigDecode(const uint8_t *buf, uint16_t len, uint8_t *seq, struct CaptureConfig *cfg)
+{
+    *seq = (len > 1) ? buf[1] : 0;
+    if (len < 1 || buf[0] != CAPTURE_CONFIG_VERSION) {
+        return CAPTURE_CONFIG_BAD_VERSION;
+    }
+    if (len < CAPTURE_CONFIG_HEADER_SIZE || buf[10] > CAPTURE_CONFIG_MAX_FILTERS || len != CAPTURE_CONFIG_HEADER_SIZE + 2 * buf[10]) {
+        return CAPTURE_CONFIG_BAD_LENGTH;
+    }
+
+    cfg->channelMask = buf[2];
+    cfg->triggerMode = buf[3];
+    cfg->triggerChannel = buf[4];
+    cfg->decoder = buf[5];
+    cfg->sampleRateHz = (uint16_t)buf[6] | ((uint16_t)buf[7] << 8);
+    cfg->triggerLevel = (int16_t)((uint16_t)buf[8] | ((uint16_t)buf[9] << 8));
+    cfg->filterCount = buf[10];
+    for (uint8_t i = 0; i < cfg->filterCount; i++) {
+        cfg->filterId[i] = (uint16_t)buf[11 + 2 * i] | ((uint16_t)buf[12 + 2 * i] << 8);
+    }
+
+    if ((cfg->channelMask & ~CAPTURE_CH_ALL) != 0 || cfg->triggerMode >= CAPTURE_TRIGGER_COUNT || cfg->triggerChannel > 2 ||
+        cfg->decoder >= CAPTURE_DECODER_COUNT || cfg->sampleRateHz == 0) {
+        return CAPTURE_CONFIG_BAD_VALUE;
+    }
+    return CAPTURE_CONFIG_OK;
+}
+
+/**
+ * @fn			uint16_t CaptureConfigEncode(const struct CaptureConfig *cfg, uint8_t seq, uint8_t *buf, uint16_t size)
+ * @brief		Serializes cfg in the format read by CaptureConfigDecode
+ * @param[in]	cfg Configuration to encode
+ * @param[in]	seq Sequence number to put in the message
+ * @param[out]	buf Output buffer
+ * @param[in]	size Size of buf
+ * @return		Number of bytes written, 0 if buf is too small
+ * @note
+ */
+uint16_t CaptureConfigEncode(const struct CaptureConfig *cfg, uint8_t seq, uint8_t *buf, uint16_t size)
+{
+    uint16_t len = CAPTURE_CONFIG_HEADER_SIZE + 2 * cfg->filterCount;
+    if (size < len) {
+        return 0;
+    }
+
+    buf[0] = CAPTURE_CONFIG_VERSION;
+    buf[1] = seq;
+    buf[2] = cfg->channelMask;
+    buf[3] = cfg->triggerMode;
+    buf[4] = cfg->triggerChannel;
+    buf[5] = cfg->decoder;
+    buf[6] = (uint8_t)cfg->sampleRateHz;
+    buf[7] = (uint8_t)(cfg->sampleRateHz >> 8);
+    buf[8] = (uint8_t)cfg->triggerLevel;
+    buf[9] = (uint8_t)((uint16_t)cfg->triggerLevel >> 8);
+    buf[10] = cfg->filterCount;
+    for (uint8_t i = 0; i < cfg->filterCount; i++) {
+        buf[11 + 2 * i] = (uint8_t)cfg->filterId[i];
+        buf[12 + 2 * i] = (uint8_t)(cfg->filterId[i] >> 8);
+    }
+    return len;
+}
+
+/**
+ * @fn			void CaptureConfigSubmit(const struct CaptureConfig *cfg, uint8_t seq)
+ * @brief		Queues a validated configuration for the next capture block boundary
+ * @param[in]	cfg Configuration to apply
+ * @param[in]	seq Sequence number to acknowledge once it is applied
+ * @note		A configuration that has not been picked up yet is replaced and never acknowledged
+ */
+void CaptureConfigSubmit(const struct CaptureConfig *cfg, uint8_t seq)
+{
+    taskENTER_CRITICAL();
+    capturePending = *cfg;
+    capturePendingSeq = seq;
+    capturePendingValid = true;
+    taskEXIT_CRITICAL();
+}
+
+/**
+ * @fn			void CaptureConfigReject(uint8_t seq, enum CaptureConfigStatus status)
+ * @brief		Acknowledges a message that was not applied. The ack carries the configuration still in use.
+ * @param[in]	seq Sequence number of the rejected message
+ * @param[in]	status Reason the message was rejected
+ * @note
+ */
+void CaptureConfigReject(uint8_t seq, enum CaptureConfigStatus status)
+{
+    taskENTER_CRITICAL();
+    captureAckSeq = seq;
+    captureAckStatus = status;
+    captureAckValid = true;
+    taskEXIT_CRITICAL();
+}
+
+/**
+ * @fn			bool CaptureConfigTakePending(struct CaptureConfig *cfg, uint8_t *seq)
+ * @brief		Called by the capture task between two blocks to pick up a new configuration
+ * @param[out]	cfg Requested configuration
+ * @param[out]	seq Its sequence number, to pass to CaptureConfigApplied
+ * @return		true if a configuration was waiting
+ * @note
+ */
+bool CaptureConfigTakePending(struct CaptureConfig *cfg, uint8_t *seq)
+{
+    bool taken = false;
+
+    taskENTER_CRITICAL();
+    if (capturePendingValid) {
+        *cfg = capturePending;
+        *seq = capturePendingSeq;
+        capturePendingValid = false;
+        taken = true;
+    }
+    taskEXIT_CRITICAL();
+    return taken;
+}
+
+/**
+ * @fn			void CaptureConfigApplied(const struct CaptureConfig *effective, uint8_t seq)
+ * @brief		Called by the capture task once a configuration is in effect. Makes it the active configuration and
+ *				queues the ack.
+ * @param[in]	effective Configuration as applied, after the front end rounded or dropped what it cannot do
+ * @param[in]	seq Sequence number of the message it came from
+ * @note
+ */
+void CaptureConfigApplied(const struct CaptureConfig *effective, uint8_t seq)
+{
+    taskENTER_CRITICAL();
+    captureActive = *effective;
+    captureAckSeq = seq;
+    captureAckStatus = CAPTURE_CONFIG_OK;
+    captureAckValid = true;
+    taskEXIT_CRITICAL();
+}
+
+/**
+ * @fn			void CaptureConfigGetActive(struct CaptureConfig *cfg)
+ * @brief		Returns the configuration currently in effect
+ * @param[out]	cfg Copy of the active configuration
+ * @note
+ */
+void CaptureConfigGetActive(struct CaptureConfig *cfg)
+{
+    taskENTER_CRITICAL();
+    *cfg = captureActive;
+    taskEXIT_CRITICAL();
+}
+
+/**
+ * @fn			uint16_t CaptureConfigTakeAck(uint8_t *buf, uint16_t size)
+ * @brief		Builds the pending ack, if there is one: a status byte followed by the active configuration
+ * @param[out]	buf Output buffer, at least CAPTURE_CONFIG_ACK_MAX_SIZE bytes
+ * @param[in]	size Size of buf
+ * @return		Length of the ack, 0 if there is nothing to acknowledge
+ * @note
+ */
+uint16_t CaptureConfigTakeAck(uint8_t *buf, uint16_t size)
+{
+    struct CaptureConfig active;
+    uint8_t seq, status;
+    bool valid;
+    uint16_t len;
+
+    taskENTER_CRITICAL();
+    valid = captureAckValid;
+    seq = captureAckSeq;
+    status = captureAckStatus;
+    active = captureActive;
+    captureAckValid = false;
+    taskEXIT_CRITICAL();
+
+    if (!valid || size < 1) {
+        return 0;
+    }
+    buf[0] = status;
+    len = CaptureConfigEncode(&active, seq, &buf[1], size - 1);
+    return (len == 0) ? 0 : len + 1;
+}
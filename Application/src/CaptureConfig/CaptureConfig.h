@@ -0,0 +1,95 @@
+/**************************************************************************/ /**
+ * @file      CaptureConfig.h
+ * @brief     Remote capture configuration. A compact binary message on the capture control topic sets the channel
+ *            mask, sample rate, trigger, decoder and ID filters. The capture task swaps the new configuration in
+ *            between two capture blocks and the effective configuration is sent back as the acknowledgement.
+ * @date      2026-10-19
+
+ ******************************************************************************/
+
+#pragma once
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************************************************************************
+ * Includes
+ ******************************************************************************/
+#include <stdbool.h>
+#include <stdint.h>
+
+/******************************************************************************
+ * Defines
+ ******************************************************************************/
+#define CAPTURE_CONFIG_VERSION 1        ///< First byte of every config and ack message
+#define CAPTURE_CONFIG_MAX_FILTERS 8    ///< Address/ID filters carried in one message
+#define CAPTURE_CONFIG_HEADER_SIZE 11   ///< Encoded size of a config without filters
+#define CAPTURE_CONFIG_MAX_SIZE (CAPTURE_CONFIG_HEADER_SIZE + 2 * CAPTURE_CONFIG_MAX_FILTERS)
+#define CAPTURE_CONFIG_ACK_MAX_SIZE (1 + CAPTURE_CONFIG_MAX_SIZE)  ///< Status byte followed by the effective config
+
+#define CAPTURE_CONFIG_DEFAULT_RATE_HZ 104  ///< Matches IMU_FIFO_XL_ODR
+
+/******************************************************************************
+ * Structures and Enumerations
+ ******************************************************************************/
+
+/// Channel bits of CaptureConfig.channelMask
+enum CaptureChannel {
+    CAPTURE_CH_X = 0x01,
+    CAPTURE_CH_Y = 0x02,
+    CAPTURE_CH_Z = 0x04,
+    CAPTURE_CH_ALL = 0x07
+};
+
+/// Condition a block must meet to be sent
+enum CaptureTrigger {
+    CAPTURE_TRIGGER_NONE = 0,  ///< Every block is sent
+    CAPTURE_TRIGGER_ABOVE,     ///< Only blocks with a sample of triggerChannel above triggerLevel
+    CAPTURE_TRIGGER_BELOW,     ///< Only blocks with a sample of triggerChannel below triggerLevel
+    CAPTURE_TRIGGER_COUNT
+};
+
+/// Decoder run on the captured samples before they are sent
+enum CaptureDecoder {
+    CAPTURE_DECODER_RAW = 0,  ///< Samples are sent as captured
+    CAPTURE_DECODER_COUNT
+};
+
+/// Result byte at the start of an ack
+enum CaptureConfigStatus {
+    CAPTURE_CONFIG_OK = 0,
+    CAPTURE_CONFIG_BAD_VERSION,  ///< Unknown protocol version, nothing changed
+    CAPTURE_CONFIG_BAD_LENGTH,   ///< Message shorter or longer than its filter count says, nothing changed
+    CAPTURE_CONFIG_BAD_VALUE     ///< A field is out of range, nothing changed
+};
+
+/// Capture configuration. On the wire (little endian):
+/// version, seq, channelMask, triggerMode, triggerChannel, decoder, sampleRateHz (2), triggerLevel (2),
+/// filterCount, filterId (2 each)
+struct CaptureConfig {
+    uint8_t channelMask;      ///< enum CaptureChannel bits sent with each sample, 0 stops sending
+    uint8_t triggerMode;      ///< enum CaptureTrigger
+    uint8_t triggerChannel;   ///< Channel index (0 = X) the trigger looks at
+    uint8_t decoder;          ///< enum CaptureDecoder
+    uint16_t sampleRateHz;    ///< Requested rate. The ack reports the rate the front end actually runs at
+    int16_t triggerLevel;     ///< Trigger threshold in raw sensor units
+    uint8_t filterCount;      ///< Number of valid entries in filterId, 0 passes every ID
+    uint16_t filterId[CAPTURE_CONFIG_MAX_FILTERS];  ///< Bus addresses/IDs a decoder keeps
+};
+
+/******************************************************************************
+ * Global Function Declaration
+ ******************************************************************************/
+void CaptureConfigGetDefaults(struct CaptureConfig *cfg);
+enum CaptureConfigStatus CaptureConfigDecode(const uint8_t *buf, uint16_t len, uint8_t *seq, struct CaptureConfig *cfg);
+uint16_t CaptureConfigEncode(const struct CaptureConfig *cfg, uint8_t seq, uint8_t *buf, uint16_t size);
+void CaptureConfigSubmit(const struct CaptureConfig *cfg, uint8_t seq);
+void CaptureConfigReject(uint8_t seq, enum CaptureConfigStatus status);
+bool CaptureConfigTakePending(struct CaptureConfig *cfg, uint8_t *seq);
+void CaptureConfigApplied(const struct CaptureConfig *effective, uint8_t seq);
+void CaptureConfigGetActive(struct CaptureConfig *cfg);
+uint16_t CaptureConfigTakeAck(uint8_t *buf, uint16_t size);
+
+#ifdef __cplusplus
+}
+#endif
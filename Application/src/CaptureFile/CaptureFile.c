@@ -0,0 +1,176 @@
+/**************************************************************************/ /**
+ * @file      CaptureFile.c
+ * @brief     Read access to capture files with FatFs fast seek. A cluster link map (CLMT) is built the first time a
+ *            large open file is seeked, so later seeks jump to any offset without walking the FAT chain from the
+ *            start.
+ * @details   Building a map walks the FAT chain once, which is what a single seek to the end of the file costs
+ *            without a map, so a file that is only read from the start never pays for one. Maps are kept in RAM
+ *            while the file is open and nothing is written to the card: opening a file for reading leaves the
+ *            volume untouched. Maps live in a fixed pool; a file that finds the pool empty, or that has more
+ *            fragments than a map holds, seeks the normal way. Files are opened read-only because FatFs R0.09
+ *            cannot grow a file in fast seek mode.
+ * @date      2026-10-19
+
+ ******************************************************************************/
+
+/******************************************************************************
+ * Includes
+ ******************************************************************************/
+#include "CaptureFile/CaptureFile.h"
+
+#include <stdbool.h>
+#include <string.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+/******************************************************************************
+ * Structures and Enumerations
+ ******************************************************************************/
+
+/// Map in the pool
+struct CaptureFileMap {
+    FIL *owner;  ///< File the map is attached to, NULL if free
+    DWORD tbl[CAPTURE_FILE_MAP_SIZE];
+};
+
+/******************************************************************************
+ * Variables
+ ******************************************************************************/
+static struct CaptureFileMap captureMaps[CAPTURE_FILE_MAPS];
+
+/******************************************************************************
+ * Forward Declarations
+ ******************************************************************************/
+static struct CaptureFileMap *CaptureFileFindMap(FIL *fp);
+static struct CaptureFileMap *CaptureFileClaimMap(FIL *fp);
+static void CaptureFileReleaseMap(FIL *fp);
+
+/******************************************************************************
+ * Global Functions
+ ******************************************************************************/
+
+/**
+ * @fn		FRESULT CaptureFileOpen(FIL *fp, const TCHAR *path)
+ * @brief	Opens an existing file for reading
+ * @param	fp File object, released with CaptureFileClose
+ * @param	path File path with drive prefix
+ * @return	FR_OK if the file is open, the FatFs error otherwise
+ * @note	Seek with CaptureFileSeek to get a map
+ */
+FRESULT CaptureFileOpen(FIL *fp, const TCHAR *path)
+{
+    return f_open(fp, path, FA_OPEN_EXISTING | FA_READ);
+}
+
+/**
+ * @fn		FRESULT CaptureFileSeek(FIL *fp, DWORD ofs)
+ * @brief	Moves the read pointer, attaching a cluster link map on the first seek of a large file
+ * @param	fp File opened with CaptureFileOpen
+ * @param	ofs Offset from the start of the file
+ * @return	Result of f_lseek
+ * @note	A file that is still being written has its map built for the size it had when it was opened. Seeking
+ *			past that size is clipped, as for any file opened for reading.
+ */
+FRESULT CaptureFileSeek(FIL *fp, DWORD ofs)
+{
+    struct CaptureFileMap *map;
+    FRESULT res;
+
+    if (ofs == fp->fptr) {
+        return FR_OK;
+    }
+    // A file keeps its pool entry once it was tried, so a fragmented one does not walk its chain on every seek
+    if (fp->cltbl == NULL && fp->fsize / ((uint32_t)fp->fs->csize * _MAX_SS) >= CAPTURE_FILE_MIN_CLUSTERS &&
+        CaptureFileFindMap(fp) == NULL && (map = CaptureFileClaimMap(fp)) != NULL) {
+        map->tbl[0] = CAPTURE_FILE_MAP_SIZE;
+        fp->cltbl = map->tbl;
+        res = f_lseek(fp, CREATE_LINKMAP);
+        if (res != FR_OK) {
+            // Too fragmented for the pool. The file works as well, seeks just walk the chain.
+            fp->cltbl = NULL;
+            if (res != FR_NOT_ENOUGH_CORE) {
+                return res;
+            }
+        }
+    }
+    return f_lseek(fp, ofs);
+}
+
+/**
+ * @fn		FRESULT CaptureFileClose(FIL *fp)
+ * @brief	Closes a file opened with CaptureFileOpen and returns its map to the pool
+ * @param	fp File object
+ * @return	Result of f_close
+ */
+FRESULT CaptureFileClose(FIL *fp)
+{
+    FRESULT res = f_close(fp);
+    fp->cltbl = NULL;
+    CaptureFileReleaseMap(fp);
+    return res;
+}
+
+/******************************************************************************
+ * Local Functions
+ ******************************************************************************/
+
+/**
+ * @fn		static struct CaptureFileMap *CaptureFileFindMap(FIL *fp)
+ * @brief	Returns the pool entry of a file
+ * @param	fp File object
+ * @return	The entry, NULL if the file has none
+ */
+static struct CaptureFileMap *CaptureFileFindMap(FIL *fp)
+{
+    struct CaptureFileMap *map = NULL;
+
+    taskENTER_CRITICAL();
+    for (uint8_t i = 0; i < CAPTURE_FILE_MAPS; i++) {
+        if (captureMaps[i].owner == fp) {
+            map = &captureMaps[i];
+            break;
+        }
+    }
+    taskEXIT_CRITICAL();
+    return map;
+}
+
+/**
+ * @fn		static struct CaptureFileMap *CaptureFileClaimMap(FIL *fp)
+ * @brief	Takes a free map from the pool
+ * @param	fp File the map is for
+ * @return	The map, NULL if all are in use
+ * @note	Files are opened from the Wifi and the CLI task.
+ */
+static struct CaptureFileMap *CaptureFileClaimMap(FIL *fp)
+{
+    struct CaptureFileMap *map = NULL;
+
+    taskENTER_CRITICAL();
+    for (uint8_t i = 0; i < CAPTURE_FILE_MAPS; i++) {
+        if (captureMaps[i].owner == NULL) {
+            captureMaps[i].owner = fp;
+            map = &captureMaps[i];
+            break;
+        }
+    }
+    taskEXIT_CRITICAL();
+    return map;
+}
+
+/**
+ * @fn		static void CaptureFileReleaseMap(FIL *fp)
+ * @brief	Returns the map of a file to the pool, if it has one
+ * @param	fp File object
+ */
+static void CaptureFileReleaseMap(FIL *fp)
+{
+    taskENTER_CRITICAL();
+    for (uint8_t i = 0; i < CAPTURE_FILE_MAPS; i++) {
+        if (captureMaps[i].owner == fp) {
+            captureMaps[i].owner = NULL;
+        }
+    }
+    taskEXIT_CRITICAL();
+}
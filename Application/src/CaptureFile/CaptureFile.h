@@ -0,0 +1,38 @@
+/**************************************************************************/ /**
+ * @file      CaptureFile.h
+ * @brief     Read access to capture files with FatFs fast seek. A cluster link map (CLMT) is built the first time a
+ *            large open file is seeked, so later seeks jump to any offset without walking the FAT chain from the
+ *            start.
+ * @date      2026-10-19
+
+ ******************************************************************************/
+
+#pragma once
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************************************************************************
+ * Includes
+ ******************************************************************************/
+#include <stdint.h>
+
+#include "ff.h"
+
+/******************************************************************************
+ * Defines
+ ******************************************************************************/
+#define CAPTURE_FILE_MAPS 3            ///< Files with a map at once: both HTTP server slots and the UART transfer
+#define CAPTURE_FILE_MAP_SIZE 24       ///< DWORDs per map. Two per fragment plus two, so 11 fragments
+#define CAPTURE_FILE_MIN_CLUSTERS 8    ///< Files this small seek through the FAT chain and get no map
+
+/******************************************************************************
+ * Global Function Declaration
+ ******************************************************************************/
+FRESULT CaptureFileOpen(FIL *fp, const TCHAR *path);
+FRESULT CaptureFileSeek(FIL *fp, DWORD ofs);
+FRESULT CaptureFileClose(FIL *fp);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,646 @@
+/**************************************************************************/ /**
+ * @file      CaptureSegments.c
+ * @brief     Capture recording to the SD card in a ring of preallocated segment files. The clusters of every
+ *            segment are allocated when the pool is created, so writing a capture never touches the FAT and the
+ *            oldest segment is overwritten once the ring is full.
+ * @details   Records are packed into two sector buffers by the capture and bus tasks. This task writes each full
+ *            sector with one aligned f_write, which FatFs passes straight to the card. The open segment carries a
+ *            cluster link map, so even finding the next cluster is a table lookup instead of a FAT read. The header
+ *            and the directory entry are only synced every CAPTURE_SEGMENTS_SYNC_SECTORS sectors and when recording
+ *            stops. A full segment is cataloged once no sector is waiting. All file access happens in this task; the other tasks only post commands.
+ * @date      2026-10-19
+
+ ******************************************************************************/
+
+/******************************************************************************
+ * Includes
+ ******************************************************************************/
+#include "CaptureSegments/CaptureSegments.h"
+
+#include <crc32.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "BusStats/BusStats.h"
+#include "CaptureCatalog/CaptureCatalog.h"
+#include "EventDedup/EventDedup.h"
+#include "SerialConsole.h"
+#include "SysInit/SysInit.h"
+#include "WifiHandlerThread/WifiHandler.h"
+#include "asf.h"
+#include "task.h"
+
+/******************************************************************************
+ * Defines
+ ******************************************************************************/
+#define CAPTURE_SEGMENTS_NONE 0xFF  ///< No filled segment waits for its catalog record
+
+/******************************************************************************
+ * Structures and Enumerations
+ ******************************************************************************/
+
+/// Work posted to the task
+enum CaptureSegmentsCommand {
+    CAPTURE_SEGMENTS_CMD_NONE = 0,
+    CAPTURE_SEGMENTS_CMD_CREATE,
+    CAPTURE_SEGMENTS_CMD_START,
+    CAPTURE_SEGMENTS_CMD_STOP
+};
+
+/******************************************************************************
+ * Variables
+ ******************************************************************************/
+static TaskHandle_t segTaskHandle = NULL;
+static volatile enum CaptureSegmentsCommand segCommand = CAPTURE_SEGMENTS_CMD_NONE;
+static uint8_t segCreateCount;
+static uint16_t segCreateMb;
+static volatile bool segActive = false;     ///< Records are accepted
+
+// Two buffers, so records keep coming while a sector is written: with one, every record of a card write (about
+// 1 ms, far more during a card stall) would be dropped. f_write sends a whole sector straight from here, a half
+// sector would go through the FatFs window and cost a read of the old sector first.
+static uint8_t segBuffer[2][CAPTURE_SEGMENTS_SECTOR];
+static uint16_t segFillLen = 0;             ///< Bytes reserved in the buffer being filled
+static uint8_t segFill = 0;                 ///< Buffer records are added to
+static volatile uint8_t segCopying[2];      ///< Records reserved in each buffer and still being copied
+static volatile int8_t segReady = -1;       ///< Full buffer to be written once its copies are done, -1 if none
+static uint32_t segQueued = 0;              ///< Sectors handed to the task for the segment being filled
+static uint32_t segDataSectors = 0;         ///< Record sectors per segment
+static uint8_t segSeeded = 0;               ///< Event dictionary slots with a template in the segment being filled
+
+static FIL segFile;
+static bool segOpen = false;
+static DWORD segMap[CAPTURE_SEGMENTS_MAP_SIZE];
+static char segPath[] = CAPTURE_SEGMENTS_PATH;
+static uint8_t segCount = 0;                ///< Segments in the ring
+static uint8_t segIndex = 0;                ///< Segment being written
+static uint32_t segNextSeq = 1;
+static struct CaptureSegmentHeader segHeader;  ///< Header of the open segment
+static uint16_t segUnsynced = 0;            ///< Sectors written since the header was updated
+static uint8_t segDone = CAPTURE_SEGMENTS_NONE;  ///< Filled segment still to be cataloged
+static uint32_t segDoneStart;               ///< Its start time
+static uint32_t segDoneSize;                ///< Its size, header included
+static struct CaptureSegmentsStats segStats;
+
+/******************************************************************************
+ * Forward Declarations
+ ******************************************************************************/
+static void CaptureSegmentsPost(enum CaptureSegmentsCommand command);
+static void CaptureSegmentsSetPath(uint8_t index);
+static uint32_t CaptureSegmentsHeaderCheck(const struct CaptureSegmentHeader *hdr);
+static void CaptureSegmentsCreatePool(uint8_t count, uint32_t size);
+static FRESULT CaptureSegmentsOpenRing(void);
+static FRESULT CaptureSegmentsOpenSegment(bool sync);
+static FRESULT CaptureSegmentsWriteHeader(bool sync);
+static void CaptureSegmentsCloseSegment(void);
+static void CaptureSegmentsCatalogDone(void);
+static void CaptureSegmentsWriteSector(uint8_t index);
+static void CaptureSegmentsNoteBusy(uint32_t startUs);
+static void CaptureSegmentsFlush(void);
+
+/******************************************************************************
+ * Global Functions
+ ******************************************************************************/
+
+/**
+ * @fn			void vCaptureSegmentsTask(void *pvParameters)
+ * @brief		Mounts the SD card, then runs the commands posted by the CLI and writes full sectors to the open segment
+ * @param[in]	pvParameters Unused
+ * @note		The card is mounted here rather than in the Wifi task, so storage does not wait for the network, and
+ *				rather than in the timer daemon, whose stack is too small for FatFs and which must not block
+ */
+void vCaptureSegmentsTask(void *pvParameters)
+{
+    segTaskHandle = xTaskGetCurrentTaskHandle();
+
+    SysInitStart(SYS_INIT_STORAGE, 0);
+    init_storage();
+
+    for (;;) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        enum CaptureSegmentsCommand command = segCommand;
+        segCommand = CAPTURE_SEGMENTS_CMD_NONE;
+        if (command != CAPTURE_SEGMENTS_CMD_NONE && SysInitWaitFor(SYS_INIT_BIT(SYS_INIT_STORAGE), 0) != pdPASS) {
+            LogMessage(LOG_INFO_LVL, "Segments: no SD card\r\n");
+            command = CAPTURE_SEGMENTS_CMD_NONE;
+        }
+        switch (command) {
+            case CAPTURE_SEGMENTS_CMD_CREATE:
+                if (segOpen) {
+                    LogMessage(LOG_INFO_LVL, "Segments: stop recording first\r\n");
+                } else {
+                    CaptureSegmentsCreatePool(segCreateCount, (uint32_t)segCreateMb << 20);
+                }
+                break;
+
+            case CAPTURE_SEGMENTS_CMD_START:
+                if (!segOpen && CaptureSegmentsOpenRing() == FR_OK) {
+                    segQueued = 0;
+                    segSeeded = 0;
+                    segActive = true;
+                }
+                break;
+
+            case CAPTURE_SEGMENTS_CMD_STOP:
+                segActive = false;
+                CaptureSegmentsFlush();
+                CaptureSegmentsCatalogDone();
+                CaptureSegmentsCloseSegment();
+                break;
+
+            default:
+                break;
+        }
+
+        // A sector with a copy still going on is written when the copying task wakes this one again
+        while (segReady >= 0 && segOpen && segCopying[segReady] == 0) {
+            CaptureSegmentsWriteSector((uint8_t)segReady);
+        }
+        // Cataloging a filled segment waits until no sector does
+        if (segDone != CAPTURE_SEGMENTS_NONE && segReady < 0) {
+            CaptureSegmentsCatalogDone();
+        }
+    }
+}
+
+/**
+ * @fn			void CaptureSegmentsCreate(uint8_t count, uint16_t sizeMb)
+ * @brief		Creates or resizes the segment pool. Segments past the new count are deleted.
+ * @param[in]	count Segments in the ring, at most CAPTURE_SEGMENTS_MAX_COUNT. Fewer are made if the card is full.
+ * @param[in]	sizeMb Size of each segment in MB
+ * @note		Done by the segments task, which logs the result. Refused while recording.
+ */
+void CaptureSegmentsCreate(uint8_t count, uint16_t sizeMb)
+{
+    segCreateCount = (count > CAPTURE_SEGMENTS_MAX_COUNT) ? CAPTURE_SEGMENTS_MAX_COUNT : count;
+    segCreateMb = sizeMb;
+    CaptureSegmentsPost(CAPTURE_SEGMENTS_CMD_CREATE);
+}
+
+/**
+ * @fn			void CaptureSegmentsStart(void)
+ * @brief		Starts recording into the segment after the one written last
+ * @note		Done by the segments task
+ */
+void CaptureSegmentsStart(void)
+{
+    CaptureSegmentsPost(CAPTURE_SEGMENTS_CMD_START);
+}
+
+/**
+ * @fn			void CaptureSegmentsStop(void)
+ * @brief		Stops recording. The partial sector is written and the segment header updated.
+ * @note		Done by the segments task
+ */
+void CaptureSegmentsStop(void)
+{
+    segActive = false;
+    CaptureSegmentsPost(CAPTURE_SEGMENTS_CMD_STOP);
+}
+
+/**
+ * @fn			bool CaptureSegmentsIsActive(void)
+ * @brief		Returns true while records are recorded
+ */
+bool CaptureSegmentsIsActive(void)
+{
+    return segActive;
+}
+
+/**
+ * @fn			void CaptureSegmentsRecord(uint8_t type, const uint8_t *payload, uint16_t len)
+ * @brief		Adds a record to the sector being filled. A full sector is handed to the segments task.
+ * @param[in]	type enum eSerialStreamType, not 0
+ * @param[in]	payload Record payload
+ * @param[in]	len Payload length, at most a sector minus the record header. Longer records are counted as dropped.
+ * @note		Called from the capture and bus tasks. Never blocks; the record is dropped if the task is behind.
+ *				Only the space is reserved in a critical section, the record is copied outside of it. A full sector is
+ *				written once the last copy into it is done.
+ */
+void CaptureSegmentsRecord(uint8_t type, const uint8_t *payload, uint16_t len)
+{
+    uint16_t need;
+    uint8_t slot = 0;
+    bool seed = false;
+    bool wake = false;
+
+    if (!segActive || type == 0) {
+        return;
+    }
+    if (type == SERIAL_STREAM_EVENT_TEMPLATE || type == SERIAL_STREAM_EVENT_REPEAT) {
+        slot = ((type == SERIAL_STREAM_EVENT_TEMPLATE) ? payload[0] : (payload[0] >> 4)) % EVENT_DEDUP_SLOTS;
+    }
+
+    taskENTER_CRITICAL();
+    // The first event of each dictionary slot in a segment is a template, so the segment decodes on its own
+    seed = (type == SERIAL_STREAM_EVENT_REPEAT && !(segSeeded & (1 << slot)));
+    need = CAPTURE_SEGMENTS_RECORD_HEADER + (seed ? EVENT_DEDUP_SEED_SIZE : len);
+    if (need > CAPTURE_SEGMENTS_SECTOR) {
+        segStats.dropped++;
+        taskEXIT_CRITICAL();
+        return;
+    }
+    if (segFillLen + need > CAPTURE_SEGMENTS_SECTOR) {
+        if (segReady >= 0) {
+            segStats.dropped++;
+            taskEXIT_CRITICAL();
+            return;
+        }
+        // The rest of the sector is still zero from the last write, which ends its records
+        segReady = (int8_t)segFill;
+        wake = (segCopying[segFill] == 0);
+        segFill ^= 1;
+        segFillLen = 0;
+        if (++segQueued >= segDataSectors) {
+            segQueued = 0;
+            segSeeded = 0;
+            seed = (type == SERIAL_STREAM_EVENT_REPEAT);
+            need = CAPTURE_SEGMENTS_RECORD_HEADER + (seed ? EVENT_DEDUP_SEED_SIZE : len);
+        }
+    }
+    if (type == SERIAL_STREAM_EVENT_TEMPLATE || type == SERIAL_STREAM_EVENT_REPEAT) {
+        segSeeded |= (uint8_t)(1 << slot);
+    }
+    uint8_t index = segFill;
+    uint8_t *rec = &segBuffer[index][segFillLen];
+    segFillLen += need;
+    segCopying[index]++;
+    taskEXIT_CRITICAL();
+
+    if (seed) {
+        // The dictionary only changes under the bus mutex, which the caller holds
+        rec[0] = SERIAL_STREAM_EVENT_TEMPLATE;
+        len = EventDedupSeed(slot, &rec[CAPTURE_SEGMENTS_RECORD_HEADER]);
+    } else {
+        rec[0] = type;
+        memcpy(&rec[CAPTURE_SEGMENTS_RECORD_HEADER], payload, len);
+    }
+    rec[1] = (uint8_t)len;
+    rec[2] = (uint8_t)(len >> 8);
+
+    taskENTER_CRITICAL();
+    segCopying[index]--;
+    wake |= (segCopying[index] == 0 && segReady == (int8_t)index);
+    taskEXIT_CRITICAL();
+
+    if (wake && segTaskHandle != NULL) {
+        xTaskNotifyGive(segTaskHandle);
+    }
+}
+
+/**
+ * @fn			void CaptureSegmentsGetStats(struct CaptureSegmentsStats *stats, uint8_t *count, uint8_t *index)
+ * @brief		Returns the counters and the position in the ring
+ * @param[out]	stats Counters since boot
+ * @param[out]	count Segments in the ring, 0 until recording was started once
+ * @param[out]	index Segment being written
+ */
+void CaptureSegmentsGetStats(struct CaptureSegmentsStats *stats, uint8_t *count, uint8_t *index)
+{
+    taskENTER_CRITICAL();
+    *stats = segStats;
+    *count = segCount;
+    *index = segIndex;
+    taskEXIT_CRITICAL();
+}
+
+/******************************************************************************
+ * Local Functions
+ ******************************************************************************/
+
+/**
+ * @fn			static void CaptureSegmentsPost(enum CaptureSegmentsCommand command)
+ * @brief		Hands a command to the segments task
+ * @param[in]	command Command
+ */
+static void CaptureSegmentsPost(enum CaptureSegmentsCommand command)
+{
+    segCommand = command;
+    if (segTaskHandle != NULL) {
+        xTaskNotifyGive(segTaskHandle);
+    }
+}
+
+/**
+ * @fn			static void CaptureSegmentsSetPath(uint8_t index)
+ * @brief		Puts the drive and the number of a segment into segPath
+ * @param[in]	index Segment number
+ */
+static void CaptureSegmentsSetPath(uint8_t index)
+{
+    segPath[0] = LUN_ID_SD_MMC_0_MEM + '0';
+    segPath[5] = '0' + (index / 10);
+    segPath[6] = '0' + (index % 10);
+}
+
+/**
+ * @fn			static uint32_t CaptureSegmentsHeaderCheck(const struct CaptureSegmentHeader *hdr)
+ * @brief		CRC-32 of a segment header without its check field
+ */
+static uint32_t CaptureSegmentsHeaderCheck(const struct CaptureSegmentHeader *hdr)
+{
+    crc32_t crc;
+
+    crc32_calculate(hdr, offsetof(struct CaptureSegmentHeader, check), &crc);
+    return crc;
+}
+
+/**
+ * @fn			static void CaptureSegmentsCreatePool(uint8_t count, uint32_t size)
+ * @brief		Creates the segment files at full size with empty headers and deletes the ones past count
+ * @param[in]	count Segments wanted
+ * @param[in]	size Bytes per segment, at least two sectors
+ * @note		Seeking past the end of a file opened for writing makes FatFs allocate the clusters. They come from
+ *				the same free area one after the other, so each segment is contiguous unless the card is fragmented.
+ */
+static void CaptureSegmentsCreatePool(uint8_t count, uint32_t size)
+{
+    uint8_t made = 0;
+    FRESULT res = FR_OK;
+
+    if (size < 2 * CAPTURE_SEGMENTS_SECTOR) {
+        size = 2 * CAPTURE_SEGMENTS_SECTOR;
+    }
+    size -= size % CAPTURE_SEGMENTS_SECTOR;
+
+    for (; made < count && res == FR_OK; made++) {
+        CaptureSegmentsSetPath(made);
+        res = f_open(&segFile, segPath, FA_OPEN_ALWAYS | FA_READ | FA_WRITE);
+        if (res != FR_OK) {
+            break;
+        }
+        if (f_size(&segFile) > size) {
+            res = f_lseek(&segFile, size);
+            if (res == FR_OK) res = f_truncate(&segFile);
+        } else {
+            res = f_lseek(&segFile, size);
+            if (res == FR_OK && f_tell(&segFile) != size) {
+                res = FR_DENIED;  // Card full
+            }
+        }
+        memset(&segHeader, 0, sizeof(segHeader));
+        if (res == FR_OK) res = CaptureSegmentsWriteHeader(true);
+        f_close(&segFile);
+        if (res != FR_OK) {
+            f_unlink(segPath);
+            break;
+        }
+    }
+    for (uint8_t i = made; i < CAPTURE_SEGMENTS_MAX_COUNT; i++) {
+        CaptureSegmentsSetPath(i);
+        if (f_unlink(segPath) != FR_OK) {
+            break;
+        }
+    }
+    segCount = made;
+    segNextSeq = 1;
+    LogMessage(LOG_INFO_LVL, "Segments: %u of %u KB created (%d)\r\n", made, (unsigned)(size >> 10), res);
+}
+
+/**
+ * @fn			static FRESULT CaptureSegmentsOpenRing(void)
+ * @brief		Counts the segments, finds the one written last from the headers and opens the one after it
+ * @return		FR_OK if a segment is open, FR_NO_FILE if the pool was never created
+ */
+static FRESULT CaptureSegmentsOpenRing(void)
+{
+    struct CaptureSegmentHeader hdr;
+    uint32_t lastSeq = 0;
+    uint8_t last = 0;
+    FILINFO info;
+    UINT count;
+
+    info.lfname = NULL;
+    info.lfsize = 0;
+    for (segCount = 0; segCount < CAPTURE_SEGMENTS_MAX_COUNT; segCount++) {
+        CaptureSegmentsSetPath(segCount);
+        if (f_stat(segPath, &info) != FR_OK) {
+            break;
+        }
+        if (f_open(&segFile, segPath, FA_OPEN_EXISTING | FA_READ) != FR_OK) {
+            break;
+        }
+        if (f_read(&segFile, &hdr, sizeof(hdr), &count) == FR_OK && count == sizeof(hdr) && hdr.magic == CAPTURE_SEGMENTS_MAGIC &&
+            hdr.check == CaptureSegmentsHeaderCheck(&hdr) && hdr.seq > lastSeq) {
+            lastSeq = hdr.seq;
+            last = segCount;
+        }
+        f_close(&segFile);
+    }
+    if (segCount == 0) {
+        LogMessage(LOG_INFO_LVL, "Segments: none on the card, create them first\r\n");
+        return FR_NO_FILE;
+    }
+
+    segIndex = (lastSeq == 0) ? 0 : (uint8_t)((last + 1) % segCount);
+    segNextSeq = lastSeq + 1;
+    return CaptureSegmentsOpenSegment(false);
+}
+
+/**
+ * @fn			static FRESULT CaptureSegmentsOpenSegment(bool later)
+ * @brief		Opens segment segIndex for overwriting, attaches its cluster link map and writes a fresh header
+ * @param[in]	later Leave the header to the sync after the first sector, so opening costs no header write
+ * @return		FR_OK on success, the FatFs error otherwise
+ */
+static FRESULT CaptureSegmentsOpenSegment(bool later)
+{
+    FRESULT res;
+
+    CaptureSegmentsSetPath(segIndex);
+    res = f_open(&segFile, segPath, FA_OPEN_EXISTING | FA_READ | FA_WRITE);
+    if (res != FR_OK) {
+        LogMessage(LOG_ERROR_LVL, "Segments: cannot open %s (%d)\r\n", segPath, res);
+        return res;
+    }
+    if (f_size(&segFile) < 2 * CAPTURE_SEGMENTS_SECTOR) {
+        f_close(&segFile);
+        return FR_INVALID_OBJECT;
+    }
+
+    segMap[0] = CAPTURE_SEGMENTS_MAP_SIZE;
+    segFile.cltbl = segMap;
+    if (f_lseek(&segFile, CREATE_LINKMAP) != FR_OK) {
+        // Too fragmented for the map. Writes then follow the existing chain, still without allocating.
+        segFile.cltbl = NULL;
+    }
+
+    memset(&segHeader, 0, sizeof(segHeader));
+    segHeader.seq = segNextSeq++;
+    segHeader.start = get_fattime();
+    res = later ? FR_OK : CaptureSegmentsWriteHeader(true);
+    if (res == FR_OK) res = f_lseek(&segFile, CAPTURE_SEGMENTS_SECTOR);
+    if (res != FR_OK) {
+        f_close(&segFile);
+        return res;
+    }
+    segUnsynced = later ? CAPTURE_SEGMENTS_SYNC_SECTORS - 1 : 0;
+    segDataSectors = f_size(&segFile) / CAPTURE_SEGMENTS_SECTOR - 1;
+    segOpen = true;
+    return FR_OK;
+}
+
+/**
+ * @fn			static FRESULT CaptureSegmentsWriteHeader(bool sync)
+ * @brief		Writes segHeader to the start of the open file, keeping the file position
+ * @param[in]	sync Also sync the file. Without it the header stays in the FatFs window, where FatFs readers already
+ *				see it, until the window moves to another sector.
+ * @return		FR_OK on success, the FatFs error otherwise
+ */
+static FRESULT CaptureSegmentsWriteHeader(bool sync)
+{
+    DWORD pos = f_tell(&segFile);
+    FRESULT res;
+    UINT count;
+
+    segHeader.magic = CAPTURE_SEGMENTS_MAGIC;
+    segHeader.version = CAPTURE_SEGMENTS_VERSION;
+    segHeader.end = get_fattime();
+    segHeader.check = CaptureSegmentsHeaderCheck(&segHeader);
+
+    res = f_lseek(&segFile, 0);
+    if (res == FR_OK) res = f_write(&segFile, &segHeader, sizeof(segHeader), &count);
+    if (res == FR_OK) res = f_lseek(&segFile, pos);
+    if (res == FR_OK && sync) res = f_sync(&segFile);
+    return res;
+}
+
+/**
+ * @fn			static void CaptureSegmentsCloseSegment(void)
+ * @brief		Writes the final header of the open segment, closes it and catalogs it
+ */
+static void CaptureSegmentsCloseSegment(void)
+{
+    if (!segOpen) {
+        return;
+    }
+    CaptureSegmentsWriteHeader(true);
+    f_close(&segFile);
+    segOpen = false;
+
+    if (segHeader.used > 0) {
+        segDone = segIndex;
+        segDoneStart = segHeader.start;
+        segDoneSize = CAPTURE_SEGMENTS_SECTOR + segHeader.used;
+        CaptureSegmentsCatalogDone();
+    }
+}
+
+/**
+ * @fn			static void CaptureSegmentsCatalogDone(void)
+ * @brief		Adds the catalog record of the last filled segment, if it has none yet
+ */
+static void CaptureSegmentsCatalogDone(void)
+{
+    struct CaptureCatalogRecord rec;
+    uint32_t startUs = BusStatsNowUs();
+
+    if (segDone == CAPTURE_SEGMENTS_NONE) {
+        return;
+    }
+    memset(&rec, 0, sizeof(rec));
+    rec.start = segDoneStart;
+    rec.size = segDoneSize;
+    CaptureSegmentsSetPath(segDone);
+    segDone = CAPTURE_SEGMENTS_NONE;
+    // The segment was recorded over, its record of the previous lap is replaced
+    CaptureCatalogAdd(&rec, segPath, true);
+    CaptureSegmentsNoteBusy(startUs);
+}
+
+/**
+ * @fn			static void CaptureSegmentsWriteSector(uint8_t index)
+ * @brief		Writes a full sector buffer to the open segment and moves on to the next segment when it is full
+ * @param[in]	index Sector buffer
+ */
+static void CaptureSegmentsWriteSector(uint8_t index)
+{
+    uint32_t startUs = BusStatsNowUs();
+    FRESULT res;
+    UINT count = 0;
+
+    res = f_write(&segFile, segBuffer[index], CAPTURE_SEGMENTS_SECTOR, &count);
+    memset(segBuffer[index], 0, CAPTURE_SEGMENTS_SECTOR);
+
+    taskENTER_CRITICAL();
+    segReady = -1;
+    if (res == FR_OK && count == CAPTURE_SEGMENTS_SECTOR) {
+        segStats.sectors++;
+    } else {
+        segStats.writeErrors++;
+    }
+    taskEXIT_CRITICAL();
+
+    if (res != FR_OK || count != CAPTURE_SEGMENTS_SECTOR) {
+        LogMessage(LOG_ERROR_LVL, "Segments: write failed (%d), recording stopped\r\n", res);
+        segActive = false;
+        CaptureSegmentsCloseSegment();
+        return;
+    }
+
+    segHeader.used += CAPTURE_SEGMENTS_SECTOR;
+    if (f_tell(&segFile) >= f_size(&segFile)) {
+        // The next sector is already waiting. The final header only goes to the FatFs window, which opening the next
+        // segment writes out, and the file is not closed, which would only put a new time in its directory entry.
+        // The new header is synced with the next sector, and the catalog record waits until no sector does.
+        CaptureSegmentsCatalogDone();
+        if (CaptureSegmentsWriteHeader(false) == FR_OK) {
+            segDone = segIndex;
+            segDoneStart = segHeader.start;
+            segDoneSize = CAPTURE_SEGMENTS_SECTOR + segHeader.used;
+        }
+        segOpen = false;
+        segStats.rotations++;
+        segIndex = (uint8_t)((segIndex + 1) % segCount);
+        if (CaptureSegmentsOpenSegment(true) != FR_OK) {
+            segActive = false;
+        }
+    } else if (++segUnsynced >= CAPTURE_SEGMENTS_SYNC_SECTORS) {
+        segUnsynced = 0;
+        CaptureSegmentsWriteHeader(true);
+    }
+    CaptureSegmentsNoteBusy(startUs);
+}
+
+/**
+ * @fn			static void CaptureSegmentsNoteBusy(uint32_t startUs)
+ * @brief		Keeps the longest time the task kept the card busy at once, which a waiting sector may have to wait
+ * @param[in]	startUs BusStatsNowUs() when the work began
+ */
+static void CaptureSegmentsNoteBusy(uint32_t startUs)
+{
+    uint32_t tookUs = BusStatsNowUs() - startUs;
+
+    taskENTER_CRITICAL();
+    if (tookUs > segStats.worstWriteUs) {
+        segStats.worstWriteUs = tookUs;
+    }
+    taskEXIT_CRITICAL();
+}
+
+/**
+ * @fn			static void CaptureSegmentsFlush(void)
+ * @brief		Writes the sector waiting to be written and the partly filled one
+ * @note		Called with recording stopped. A record that was being added when it stopped still makes it in.
+ */
+static void CaptureSegmentsFlush(void)
+{
+    while (segCopying[0] != 0 || segCopying[1] != 0) {
+        vTaskDelay(1);
+    }
+    if (segReady >= 0 && segOpen) {
+        CaptureSegmentsWriteSector((uint8_t)segReady);
+    }
+    taskENTER_CRITICAL();
+    uint8_t index = segFill;
+    bool partial = (segFillLen > 0);
+    segFill ^= 1;
+    segFillLen = 0;
+    taskEXIT_CRITICAL();
+    if (partial && segOpen) {
+        CaptureSegmentsWriteSector(index);
+    } else {
+        memset(segBuffer[index], 0, CAPTURE_SEGMENTS_SECTOR);
+    }
+}
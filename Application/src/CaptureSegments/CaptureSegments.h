@@ -0,0 +1,89 @@
+/**************************************************************************/ /**
+ * @file      CaptureSegments.h
+ * @brief     Capture recording to the SD card in a ring of preallocated segment files. The clusters of every
+ *            segment are allocated when the pool is created, so writing a capture never touches the FAT and the
+ *            oldest segment is overwritten once the ring is full.
+ * @date      2026-10-19
+
+ ******************************************************************************/
+
+#pragma once
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************************************************************************
+ * Includes
+ ******************************************************************************/
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "FreeRTOS.h"
+#include "ff.h"
+
+/******************************************************************************
+ * Defines
+ ******************************************************************************/
+#define CAPTURE_SEGMENTS_TASK_SIZE 400  ///< Also mounts the card and rebuilds the catalog. FatFs puts a 512 byte LFN buffer on the stack
+#define CAPTURE_SEGMENTS_PRIORITY (tskIDLE_PRIORITY + 1)  ///< Below capture and network, the ring buffers absorb the delay
+
+#define CAPTURE_SEGMENTS_PATH "0:seg00.cap"       ///< Digits are replaced by the segment number
+#define CAPTURE_SEGMENTS_MAX_COUNT 100
+#define CAPTURE_SEGMENTS_DEFAULT_COUNT 8
+#define CAPTURE_SEGMENTS_DEFAULT_MB 4
+#define CAPTURE_SEGMENTS_SECTOR 512
+#define CAPTURE_SEGMENTS_SYNC_SECTORS 128          ///< Header and directory entry are updated every 64 KB written
+#define CAPTURE_SEGMENTS_MAP_SIZE 10               ///< Cluster link map items of the open segment, 4 fragments
+
+#define CAPTURE_SEGMENTS_RECORD_HEADER 3  ///< Type (1) and payload length (2) in front of each record
+#define CAPTURE_SEGMENTS_MAGIC 0x4745534C  ///< "LSEG"
+#define CAPTURE_SEGMENTS_VERSION 1
+
+/*
+ * Segment file layout: the first sector holds a struct CaptureSegmentHeader, the following sectors hold records,
+ * type (1, enum eSerialStreamType), payload length (2, little endian), payload, as in the UART stream. A record
+ * never crosses a sector; a zero type byte ends the records of a sector. Only the first "used" bytes after the
+ * header sector belong to the segment, what follows is left over from the previous lap of the ring.
+ * Each segment decodes without the others, so a reader can work on several at once: capture blocks carry no state
+ * between them, and the first bus event of each dictionary slot in a segment is a template (see EventDedup.h).
+ */
+
+/******************************************************************************
+ * Structures and Enumerations
+ ******************************************************************************/
+
+/// First bytes of each segment file
+struct CaptureSegmentHeader {
+    uint32_t magic;     ///< "LSEG"
+    uint16_t version;
+    uint16_t reserved;
+    uint32_t seq;       ///< Increases by one for each segment filled, 0 for a segment never written
+    uint32_t used;      ///< Record bytes after the header sector, a multiple of the sector size
+    uint32_t start;     ///< FAT timestamp of the first record
+    uint32_t end;       ///< FAT timestamp of the last header update
+    uint32_t check;     ///< CRC-32 of the fields above
+};
+
+/// Counters since boot
+struct CaptureSegmentsStats {
+    uint32_t sectors;       ///< Sectors written
+    uint32_t rotations;     ///< Segments completed
+    uint32_t dropped;       ///< Records dropped because both sector buffers were full or longer than a sector
+    uint32_t writeErrors;   ///< Failed writes. Recording stops on the first one
+    uint32_t worstWriteUs;  ///< Longest card work at once: a sector with the header update or rotation after it, or a catalog record
+};
+
+/******************************************************************************
+ * Global Function Declaration
+ ******************************************************************************/
+void vCaptureSegmentsTask(void *pvParameters);
+void CaptureSegmentsCreate(uint8_t count, uint16_t sizeMb);
+void CaptureSegmentsStart(void);
+void CaptureSegmentsStop(void);
+bool CaptureSegmentsIsActive(void);
+void CaptureSegmentsRecord(uint8_t type, const uint8_t *payload, uint16_t len);
+void CaptureSegmentsGetStats(struct CaptureSegmentsStats *stats, uint8_t *count, uint8_t *index);
+
+#ifdef __cplusplus
+}
+#endif
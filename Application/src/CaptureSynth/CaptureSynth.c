@@ -0,0 +1,203 @@
+/**************************************************************************/ /**
+ * @file      CaptureSynth.c
+ * @brief     Synthetic capture source. Replaces the sample values of each IMU batch with a reproducible pattern, so
+ *            triggers, the capture codec, the streams, the SD segments and the uplink can be measured on inputs that
+ *            are known exactly.
+ * @details   The IMU task still drains the FIFO and timestamps the samples, only the values are replaced, so the
+ *            data rate and timing are those of a real capture. CaptureSynthSample has no state: a receiver computes
+ *            the expected value of any sample from the pattern, the seed and the sample index, and checks its
+ *            decoded output against it. With the trigger off, the index is the number of samples received since
+ *            the pattern was started.
+ * @date      2026-10-19
+
+ ******************************************************************************/
+
+/******************************************************************************
+ * Includes
+ ******************************************************************************/
+#include "CaptureSynth/CaptureSynth.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+/******************************************************************************
+ * Variables
+ ******************************************************************************/
+static struct CaptureSynthStatus synthStatus = {CAPTURE_SYNTH_OFF, 0, 0};
+
+/// First quarter of a sine of amplitude CAPTURE_SYNTH_SINE_AMPLITUDE, 16 steps, both ends included
+static const int16_t synthQuarterSine[17] = {0, 803, 1598, 2378, 3135, 3862, 4551, 5197, 5793, 6333, 6811, 7225, 7568, 7839, 8035, 8153, 8192};
+
+static const char *const synthNames[CAPTURE_SYNTH_COUNT] = {"off", "idle", "rest", "step", "sine", "ramp", "noise"};
+
+/******************************************************************************
+ * Forward Declarations
+ ******************************************************************************/
+static uint32_t CaptureSynthHash(uint32_t seed, uint32_t index, uint8_t axis);
+static int16_t CaptureSynthSine(uint32_t phase);
+
+/******************************************************************************
+ * Global Functions
+ ******************************************************************************/
+
+/**
+ * @fn			void CaptureSynthStart(enum CaptureSynthPattern pattern, uint32_t seed)
+ * @brief		Starts replacing captured values by a pattern, from sample index 0
+ * @param[in]	pattern Pattern, CAPTURE_SYNTH_OFF stops
+ * @param[in]	seed Seed of the noise and phase of the periodic patterns
+ */
+void CaptureSynthStart(enum CaptureSynthPattern pattern, uint32_t seed)
+{
+    taskENTER_CRITICAL();
+    synthStatus.pattern = (pattern < CAPTURE_SYNTH_COUNT) ? pattern : CAPTURE_SYNTH_OFF;
+    synthStatus.seed = seed;
+    synthStatus.samples = 0;
+    taskEXIT_CRITICAL();
+}
+
+/**
+ * @fn			void CaptureSynthStop(void)
+ * @brief		Goes back to real samples
+ */
+void CaptureSynthStop(void)
+{
+    CaptureSynthStart(CAPTURE_SYNTH_OFF, 0);
+}
+
+/**
+ * @fn			bool CaptureSynthIsActive(void)
+ * @brief		Returns whether captured values are replaced
+ * @return		true while a pattern runs
+ */
+bool CaptureSynthIsActive(void)
+{
+    return synthStatus.pattern != CAPTURE_SYNTH_OFF;
+}
+
+/**
+ * @fn			void CaptureSynthFill(struct ImuDataBatch *batch)
+ * @brief		Replaces the values of a full batch by the next samples of the pattern. Timestamps are kept.
+ * @param[in,out]	batch Batch from the FIFO decoder
+ * @note		Called by the IMU task before the trigger check, so triggered out batches still use up their indexes
+ */
+void CaptureSynthFill(struct ImuDataBatch *batch)
+{
+    struct CaptureSynthStatus status;
+
+    taskENTER_CRITICAL();
+    status = synthStatus;
+    synthStatus.samples += batch->count;
+    taskEXIT_CRITICAL();
+
+    if (status.pattern == CAPTURE_SYNTH_OFF) {
+        return;
+    }
+    for (uint8_t i = 0; i < batch->count; i++) {
+        batch->sample[i].x = CaptureSynthSample(status.pattern, status.seed, status.samples + i, 0);
+        batch->sample[i].y = CaptureSynthSample(status.pattern, status.seed, status.samples + i, 1);
+        batch->sample[i].z = CaptureSynthSample(status.pattern, status.seed, status.samples + i, 2);
+    }
+}
+
+/**
+ * @fn			int16_t CaptureSynthSample(enum CaptureSynthPattern pattern, uint32_t seed, uint32_t index, uint8_t axis)
+ * @brief		Value of one sample of a pattern. Reference for receivers checking their output.
+ * @param[in]	pattern Pattern
+ * @param[in]	seed Seed given to CaptureSynthStart
+ * @param[in]	index Sample index since the pattern was started
+ * @param[in]	axis 0 for X, 1 for Y, 2 for Z
+ * @return		Sample value
+ */
+int16_t CaptureSynthSample(enum CaptureSynthPattern pattern, uint32_t seed, uint32_t index, uint8_t axis)
+{
+    int16_t rest = (axis == 2) ? CAPTURE_SYNTH_ONE_G : 0;
+
+    switch (pattern) {
+        case CAPTURE_SYNTH_IDLE:
+            return rest;
+
+        case CAPTURE_SYNTH_REST:
+            return (int16_t)(rest + (int16_t)(CaptureSynthHash(seed, index, axis) % 9) - 4);
+
+        case CAPTURE_SYNTH_STEP:
+            return (((index + seed) / CAPTURE_SYNTH_STEP_SAMPLES) & 1) ? (int16_t)(rest + CAPTURE_SYNTH_SINE_AMPLITUDE) : rest;
+
+        case CAPTURE_SYNTH_SINE:
+            return (int16_t)(rest + CaptureSynthSine(index + seed + 16u * axis));
+
+        case CAPTURE_SYNTH_RAMP:
+            return (int16_t)(uint16_t)((index + seed) * 37u + 1000u * axis);
+
+        case CAPTURE_SYNTH_NOISE:
+            return (int16_t)(uint16_t)CaptureSynthHash(seed, index, axis);
+
+        default:
+            return 0;
+    }
+}
+
+/**
+ * @fn			const char *CaptureSynthName(enum CaptureSynthPattern pattern)
+ * @brief		Name of a pattern, as taken by the "synth" command
+ * @param[in]	pattern Pattern
+ * @return		Name, "off" for an unknown pattern
+ */
+const char *CaptureSynthName(enum CaptureSynthPattern pattern)
+{
+    return (pattern < CAPTURE_SYNTH_COUNT) ? synthNames[pattern] : synthNames[CAPTURE_SYNTH_OFF];
+}
+
+/**
+ * @fn			void CaptureSynthGetStatus(struct CaptureSynthStatus *status)
+ * @brief		Returns the pattern, its seed and the samples generated
+ * @param[out]	status Generator state
+ */
+void CaptureSynthGetStatus(struct CaptureSynthStatus *status)
+{
+    taskENTER_CRITICAL();
+    *status = synthStatus;
+    taskEXIT_CRITICAL();
+}
+
+/******************************************************************************
+ * Local Functions
+ ******************************************************************************/
+
+/**
+ * @fn			static uint32_t CaptureSynthHash(uint32_t seed, uint32_t index, uint8_t axis)
+ * @brief		Mixes seed, sample index and axis into 32 random looking bits (lowbias32 finalizer)
+ * @return		Hash
+ */
+static uint32_t CaptureSynthHash(uint32_t seed, uint32_t index, uint8_t axis)
+{
+    uint32_t h = seed ^ (index * 3u + axis) * 0x9E3779B9u;
+
+    h ^= h >> 16;
+    h *= 0x7FEB352Du;
+    h ^= h >> 15;
+    h *= 0x846CA68Bu;
+    h ^= h >> 16;
+    return h;
+}
+
+/**
+ * @fn			static int16_t CaptureSynthSine(uint32_t phase)
+ * @brief		Sine of a 64 step period from the quarter wave table
+ * @param[in]	phase Step, any value
+ * @return		Value between -CAPTURE_SYNTH_SINE_AMPLITUDE and CAPTURE_SYNTH_SINE_AMPLITUDE
+ */
+static int16_t CaptureSynthSine(uint32_t phase)
+{
+    uint8_t step = phase & 15;
+
+    switch ((phase >> 4) & 3) {
+        case 0:
+            return synthQuarterSine[step];
+        case 1:
+            return synthQuarterSine[16 - step];
+        case 2:
+            return (int16_t)-synthQuarterSine[step];
+        default:
+            return (int16_t)-synthQuarterSine[16 - step];
+    }
+}
@@ -0,0 +1,66 @@
+/**************************************************************************/ /**
+ * @file      CaptureSynth.h
+ * @brief     Synthetic capture source. Replaces the sample values of each IMU batch with a reproducible pattern, so
+ *            triggers, the capture codec, the streams, the SD segments and the uplink can be measured on inputs that
+ *            are known exactly.
+ * @date      2026-10-19
+
+ ******************************************************************************/
+
+#pragma once
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************************************************************************
+ * Includes
+ ******************************************************************************/
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "WifiHandlerThread/WifiHandler.h"
+
+/******************************************************************************
+ * Defines
+ ******************************************************************************/
+#define CAPTURE_SYNTH_ONE_G 16384      ///< Gravity on the Z axis in LSB (about 1 g at the 2 g full scale)
+#define CAPTURE_SYNTH_STEP_SAMPLES 64  ///< Samples per level of the step pattern
+#define CAPTURE_SYNTH_SINE_AMPLITUDE 8192
+
+/******************************************************************************
+ * Structures and Enumerations
+ ******************************************************************************/
+
+/// Sample value patterns. Each value depends only on the pattern, the seed, the sample index and the axis.
+enum CaptureSynthPattern {
+    CAPTURE_SYNTH_OFF = 0,  ///< Real samples
+    CAPTURE_SYNTH_IDLE,     ///< Device at rest: 0, 0, 1 g
+    CAPTURE_SYNTH_REST,     ///< Idle plus noise of +/- 4 LSB
+    CAPTURE_SYNTH_STEP,     ///< Two levels, switching every CAPTURE_SYNTH_STEP_SAMPLES samples
+    CAPTURE_SYNTH_SINE,     ///< 64 sample period, axes a quarter period apart
+    CAPTURE_SYNTH_RAMP,     ///< Rises by 37 LSB per sample and wraps
+    CAPTURE_SYNTH_NOISE,    ///< Uniform over the whole int16 range
+    CAPTURE_SYNTH_COUNT
+};
+
+/// Generator state
+struct CaptureSynthStatus {
+    enum CaptureSynthPattern pattern;
+    uint32_t seed;
+    uint32_t samples;  ///< Samples generated since the pattern was started, the index of the next one
+};
+
+/******************************************************************************
+ * Global Function Declaration
+ ******************************************************************************/
+void CaptureSynthStart(enum CaptureSynthPattern pattern, uint32_t seed);
+void CaptureSynthStop(void);
+bool CaptureSynthIsActive(void);
+void CaptureSynthFill(struct ImuDataBatch *batch);
+int16_t CaptureSynthSample(enum CaptureSynthPattern pattern, uint32_t seed, uint32_t index, uint8_t axis);
+const char *CaptureSynthName(enum CaptureSynthPattern pattern);
+void CaptureSynthGetStatus(struct CaptureSynthStatus *status);
+
+#ifdef __cplusplus
+}
+#endif
@@ -10,8 +10,18 @@
  * Includes
  ******************************************************************************/
 #include "CliThread.h"
+#include "CaptureCatalog/CaptureCatalog.h"
+#include "CaptureCodec/CaptureCodec.h"
+#include "CaptureSynth/CaptureSynth.h"
+#include "EventDedup/EventDedup.h"
+#include "CaptureSegments/CaptureSegments.h"
+#include "FatFsSync/FatFsSync.h"
 
 #include "I2cDriver/I2cDriver.h"
+#include "SerialTransfer/SerialTransfer.h"
+#include "SysInit/SysInit.h"
+#include "TaskStats/TaskStats.h"
+#include "UdpStream/UdpStream.h"
 #include "WifiHandlerThread/WifiHandler.h"
 
 /******************************************************************************
@@ -29,6 +39,18 @@ static const CLI_Command_Definition_t xResetCommand = {"reset", "reset: Resets t
 static const CLI_Command_Definition_t xI2cScan = {"i2c", "i2c: Scans I2C bus\r\n", (const pdCOMMAND_LINE_CALLBACK)CLI_i2cScan, 0};
 static const CLI_Command_Definition_t xVersion = {"version", "version: Prints a firmware version\r\n", (const pdCOMMAND_LINE_CALLBACK)CLI_version, 0};
 static const CLI_Command_Definition_t xTicks = {"ticks", "ticks: Prints the number of ticks since the scheduler was started\r\n", (const pdCOMMAND_LINE_CALLBACK)CLI_ticks, 0};
+static const CLI_Command_Definition_t xTasks = {"tasks", "tasks: Prints CPU use since the last call and free stack of each task\r\n", (const pdCOMMAND_LINE_CALLBACK)CLI_Tasks, 0};
+static const CLI_Command_Definition_t xBoot = {"boot", "boot: Prints the boot timeline of each subsystem\r\n", (const pdCOMMAND_LINE_CALLBACK)CLI_BootTimeline, 0};
+static const CLI_Command_Definition_t xTransfer = {"xfer", "xfer [baud]: Transfers files between the SD card and a host over the UART\r\n", (const pdCOMMAND_LINE_CALLBACK)CLI_Transfer, -1};
+static const CLI_Command_Definition_t xUpload = {"upload", "upload <file>: Uploads a file from the SD card over HTTP\r\n", (const pdCOMMAND_LINE_CALLBACK)CLI_Upload, 1};
+static const CLI_Command_Definition_t xStream = {"stream", "stream [on [baud]|off]: Streams captures and bus events as COBS frames on the UART\r\n", (const pdCOMMAND_LINE_CALLBACK)CLI_Stream, -1};
+static const CLI_Command_Definition_t xCaptures = {"captures", "captures [YYYYMMDDhhmmss|rebuild]: Finds the file covering a time in the capture catalog\r\n", (const pdCOMMAND_LINE_CALLBACK)CLI_Captures, -1};
+static const CLI_Command_Definition_t xFs = {"fs", "fs: Prints how often tasks waited for the SD card\r\n", (const pdCOMMAND_LINE_CALLBACK)CLI_Fs, 0};
+static const CLI_Command_Definition_t xSynth = {"synth", "synth [idle|rest|step|sine|ramp|noise [seed]|off]: Replaces captured values by a reproducible pattern\r\n", (const pdCOMMAND_LINE_CALLBACK)CLI_Synth, -1};
+static const CLI_Command_Definition_t xCodec = {"codec", "codec [on|off]: Compresses capture blocks before they are streamed or stored, or prints the ratio\r\n", (const pdCOMMAND_LINE_CALLBACK)CLI_Codec, -1};
+static const CLI_Command_Definition_t xDedup = {"dedup", "dedup [on|off]: Sends repeated bus transactions as references to a template, or prints the ratio\r\n", (const pdCOMMAND_LINE_CALLBACK)CLI_Dedup, -1};
+static const CLI_Command_Definition_t xSegments = {"segments", "segments [create [count] [MB]|on|off]: Records captures into a ring of preallocated files on the SD card\r\n", (const pdCOMMAND_LINE_CALLBACK)CLI_Segments, -1};
+static const CLI_Command_Definition_t xUdp = {"udp", "udp [<ip> [port] [parity]|off]: Streams captures and bus events as UDP datagrams\r\n", (const pdCOMMAND_LINE_CALLBACK)CLI_Udp, -1};
 const CLI_Command_Definition_t xClearScreen = {CLI_COMMAND_CLEAR_SCREEN, CLI_HELP_CLEAR_SCREEN, CLI_CALLBACK_CLEAR_SCREEN, CLI_PARAMS_CLEAR_SCREEN};
 
 SemaphoreHandle_t cliCharReadySemaphore;  ///< Semaphore to indicate that a character has been received
@@ -48,6 +70,8 @@ static void FreeRTOS_read(char *character);
 
 void vCommandConsoleTask(void *pvParameters)
 {
+    SysInitStart(SYS_INIT_CLI, portMAX_DELAY);
+
     // REGISTER COMMANDS HERE
     FreeRTOS_CLIRegisterCommand(&xOTAUCommand);
     FreeRTOS_CLIRegisterCommand(&xClearScreen);
@@ -55,6 +79,18 @@ void vCommandConsoleTask(void *pvParameters)
     FreeRTOS_CLIRegisterCommand(&xI2cScan);
 	FreeRTOS_CLIRegisterCommand(&xVersion);
 	FreeRTOS_CLIRegisterCommand(&xTicks);
+	FreeRTOS_CLIRegisterCommand(&xBoot);
+	FreeRTOS_CLIRegisterCommand(&xTasks);
+	FreeRTOS_CLIRegisterCommand(&xStream);
+	FreeRTOS_CLIRegisterCommand(&xUdp);
+	FreeRTOS_CLIRegisterCommand(&xCaptures);
+	FreeRTOS_CLIRegisterCommand(&xFs);
+	FreeRTOS_CLIRegisterCommand(&xSegments);
+	FreeRTOS_CLIRegisterCommand(&xCodec);
+	FreeRTOS_CLIRegisterCommand(&xSynth);
+	FreeRTOS_CLIRegisterCommand(&xDedup);
+	FreeRTOS_CLIRegisterCommand(&xTransfer);
+	FreeRTOS_CLIRegisterCommand(&xUpload);
 
     char cRxedChar[2];
     unsigned char cInputIndex = 0;
@@ -226,6 +262,7 @@ void CliCharReadySemaphoreGiveFromISR(void)
 // SEE http://www.csie.ntu.edu.tw/~r92094/c++/VT100.html for more info
 // CLI SPECIFIC COMMANDS
 static char bufCli[CLI_MSG_LEN];
+static char bufCliStream[40];
 BaseType_t xCliClearTerminalScreen(char *pcWriteBuffer, size_t xWriteBufferLen, const int8_t *pcCommandString)
 {
     char clearScreen = ASCII_ESC;
@@ -281,6 +318,304 @@ BaseType_t CLI_ticks(int8_t *pcWriteBuffer, size_t xWriteBufferLen, const int8_t
 	SerialConsoleWriteString(bufCli);
 	return pdFALSE;
 }
+
+// Prints when each subsystem started and became ready
+BaseType_t CLI_BootTimeline(int8_t *pcWriteBuffer, size_t xWriteBufferLen, const int8_t *pcCommandString)
+{
+	SysInitPrintTimeline();
+	return pdFALSE;
+}
+
+/**
+ * @brief    Prints the CPU share of each task since the last call, its free stack and the free heap
+ ******************************************************************************/
+BaseType_t CLI_Tasks(int8_t *pcWriteBuffer, size_t xWriteBufferLen, const int8_t *pcCommandString)
+{
+	TaskStatsPrint();
+	return pdFALSE;
+}
+/**
+ * @brief    Switches the console between text and binary stream mode. Without arguments, prints the stream status.
+ * @details  Text typed while streaming is still read as commands, so "stream off" returns to text mode.
+ ******************************************************************************/
+BaseType_t CLI_Stream(int8_t *pcWriteBuffer, size_t xWriteBufferLen, const int8_t *pcCommandString)
+{
+	BaseType_t modeLen, baudLen;
+	const char *mode = FreeRTOS_CLIGetParameter((const char *)pcCommandString, 1, &modeLen);
+	const char *baud = FreeRTOS_CLIGetParameter((const char *)pcCommandString, 2, &baudLen);
+
+	if (mode == NULL) {
+		snprintf((char *)pcWriteBuffer, xWriteBufferLen, "Stream %s at %lu baud, %lu frames dropped\r\n", SerialConsoleIsStreaming() ? "on" : "off",
+				 (unsigned long)SerialConsoleGetBaudrate(), (unsigned long)SerialConsoleStreamDropped());
+	} else if (strncmp(mode, "on", modeLen) == 0 && modeLen == 2) {
+		uint32_t baudrate = (baud != NULL) ? strtoul(baud, NULL, 10) : SERIAL_STREAM_DEFAULT_BAUD;
+		snprintf(bufCliStream, sizeof(bufCliStream), "Streaming at %lu baud\r\n", (unsigned long)baudrate);
+		SerialConsoleWriteString(bufCliStream);
+		SerialConsoleSetMode(SERIAL_MODE_STREAM, baudrate);
+		if (SerialConsoleGetBaudrate() != baudrate) {
+			snprintf((char *)pcWriteBuffer, xWriteBufferLen, "Baud rate not available\r\n");
+		}
+	} else if (strncmp(mode, "off", modeLen) == 0 && modeLen == 3) {
+		SerialConsoleSetMode(SERIAL_MODE_TEXT, SERIAL_CONSOLE_BAUDRATE);
+	} else {
+		snprintf((char *)pcWriteBuffer, xWriteBufferLen, "Usage: stream [on [baud]|off]\r\n");
+	}
+	return pdFALSE;
+}
+
+/**
+ * @brief    Looks up the capture catalog by time, or rebuilds it from the files on the card
+ ******************************************************************************/
+BaseType_t CLI_Captures(int8_t *pcWriteBuffer, size_t xWriteBufferLen, const int8_t *pcCommandString)
+{
+	BaseType_t argLen;
+	const char *arg = FreeRTOS_CLIGetParameter((const char *)pcCommandString, 1, &argLen);
+	struct CaptureCatalogRecord rec;
+	uint32_t field[6] = {0};
+	static const uint8_t digits[6] = {4, 2, 2, 2, 2, 2};
+	FRESULT res;
+
+	if (!CaptureCatalogIsOpen()) {
+		snprintf((char *)pcWriteBuffer, xWriteBufferLen, "Capture catalog not open\r\n");
+		return pdFALSE;
+	}
+	if (arg == NULL) {
+		snprintf((char *)pcWriteBuffer, xWriteBufferLen, "%lu records in the catalog\r\n", (unsigned long)CaptureCatalogCount());
+		return pdFALSE;
+	}
+	if (strncmp(arg, "rebuild", argLen) == 0 && argLen == 7) {
+		res = CaptureCatalogRebuild();
+		snprintf((char *)pcWriteBuffer, xWriteBufferLen, "Rebuilt, %lu records (%d)\r\n", (unsigned long)CaptureCatalogCount(), res);
+		return pdFALSE;
+	}
+
+	// YYYYMMDDhhmmss to a FAT timestamp
+	for (uint8_t i = 0, pos = 0; i < 6; i++) {
+		for (uint8_t d = 0; d < digits[i]; d++, pos++) {
+			if (argLen != 14 || arg[pos] < '0' || arg[pos] > '9') {
+				snprintf((char *)pcWriteBuffer, xWriteBufferLen, "Usage: captures [YYYYMMDDhhmmss|rebuild]\r\n");
+				return pdFALSE;
+			}
+			field[i] = field[i] * 10 + (arg[pos] - '0');
+		}
+	}
+	if (field[0] < 1980) {
+		field[0] = 1980;
+	}
+	uint32_t time = ((field[0] - 1980) << 25) | (field[1] << 21) | (field[2] << 16) | (field[3] << 11) | (field[4] << 5) | (field[5] >> 1);
+
+	res = CaptureCatalogFind(time, &rec);
+	if (res == FR_OK) {
+		snprintf((char *)pcWriteBuffer, xWriteBufferLen, "#%lu %s, %lu bytes, crc %08lx%s\r\n", (unsigned long)rec.id, rec.name, (unsigned long)rec.size,
+				 (unsigned long)rec.crc, (rec.flags & CAPTURE_CATALOG_FLAG_CRC) ? "" : " (unknown)");
+	} else {
+		snprintf((char *)pcWriteBuffer, xWriteBufferLen, "No file at that time (%d)\r\n", res);
+	}
+	return pdFALSE;
+}
+
+/**
+ * @brief    Prints the SD card lock contention between tasks
+ ******************************************************************************/
+BaseType_t CLI_Fs(int8_t *pcWriteBuffer, size_t xWriteBufferLen, const int8_t *pcCommandString)
+{
+	struct FatFsSyncStats stats;
+
+	FatFsSyncGetStats(&stats);
+	snprintf((char *)pcWriteBuffer, xWriteBufferLen, "SD lock: %lu waits, longest %lu ms, %lu timeouts\r\n", (unsigned long)stats.waits,
+			 (unsigned long)(stats.maxWaitTicks * portTICK_PERIOD_MS), (unsigned long)stats.timeouts);
+	return pdFALSE;
+}
+
+/**
+ * @brief    Starts or stops the synthetic capture source, or prints its pattern and the samples generated
+ ******************************************************************************/
+BaseType_t CLI_Synth(int8_t *pcWriteBuffer, size_t xWriteBufferLen, const int8_t *pcCommandString)
+{
+	BaseType_t nameLen, seedLen;
+	const char *name = FreeRTOS_CLIGetParameter((const char *)pcCommandString, 1, &nameLen);
+	const char *seed = FreeRTOS_CLIGetParameter((const char *)pcCommandString, 2, &seedLen);
+
+	if (name == NULL) {
+		struct CaptureSynthStatus status;
+		CaptureSynthGetStatus(&status);
+		snprintf((char *)pcWriteBuffer, xWriteBufferLen, "Synth %s, seed %lu, %lu samples\r\n", CaptureSynthName(status.pattern),
+				 (unsigned long)status.seed, (unsigned long)status.samples);
+		return pdFALSE;
+	}
+	for (int pattern = CAPTURE_SYNTH_OFF; pattern < CAPTURE_SYNTH_COUNT; pattern++) {
+		const char *patternName = CaptureSynthName((enum CaptureSynthPattern)pattern);
+		if (strncmp(name, patternName, nameLen) == 0 && patternName[nameLen] == '\0') {
+			CaptureSynthStart((enum CaptureSynthPattern)pattern, (seed != NULL) ? strtoul(seed, NULL, 10) : 0);
+			return pdFALSE;
+		}
+	}
+	snprintf((char *)pcWriteBuffer, xWriteBufferLen, "Usage: synth [idle|rest|step|sine|ramp|noise [seed]|off]\r\n");
+	return pdFALSE;
+}
+
+/**
+ * @brief    Turns bus event deduplication on or off, or prints its counters
+ ******************************************************************************/
+BaseType_t CLI_Dedup(int8_t *pcWriteBuffer, size_t xWriteBufferLen, const int8_t *pcCommandString)
+{
+	BaseType_t modeLen;
+	const char *mode = FreeRTOS_CLIGetParameter((const char *)pcCommandString, 1, &modeLen);
+
+	if (mode == NULL) {
+		struct EventDedupStats stats;
+		EventDedupGetStats(&stats);
+		uint32_t rawBytes = stats.events * EVENT_DEDUP_EVENT_SIZE;
+		uint32_t ratio = (stats.packedBytes != 0) ? (uint32_t)(((uint64_t)rawBytes * 100) / stats.packedBytes) : 100;
+		snprintf((char *)pcWriteBuffer, xWriteBufferLen, "Dedup %s, %lu/%lu events repeated, %lu -> %lu bytes (%lu.%02lu:1)\r\n",
+				 EventDedupIsEnabled() ? "on" : "off", (unsigned long)stats.repeats, (unsigned long)stats.events, (unsigned long)rawBytes,
+				 (unsigned long)stats.packedBytes, (unsigned long)(ratio / 100), (unsigned long)(ratio % 100));
+	} else if (strncmp(mode, "on", modeLen) == 0 && modeLen == 2) {
+		EventDedupSetEnabled(true);
+	} else if (strncmp(mode, "off", modeLen) == 0 && modeLen == 3) {
+		EventDedupSetEnabled(false);
+	} else {
+		snprintf((char *)pcWriteBuffer, xWriteBufferLen, "Usage: dedup [on|off]\r\n");
+	}
+	return pdFALSE;
+}
+
+/**
+ * @brief    Turns capture compression on or off, or prints the compression counters
+ ******************************************************************************/
+BaseType_t CLI_Codec(int8_t *pcWriteBuffer, size_t xWriteBufferLen, const int8_t *pcCommandString)
+{
+	BaseType_t modeLen;
+	const char *mode = FreeRTOS_CLIGetParameter((const char *)pcCommandString, 1, &modeLen);
+
+	if (mode == NULL) {
+		struct CaptureCodecStats stats;
+		CaptureCodecGetStats(&stats);
+		uint32_t ratio = (stats.packedBytes != 0) ? (uint32_t)(((uint64_t)stats.rawBytes * 100) / stats.packedBytes) : 100;
+		snprintf((char *)pcWriteBuffer, xWriteBufferLen, "Codec %s, %lu/%lu blocks packed, %lu -> %lu bytes (%lu.%02lu:1), worst %lu us, %lu mismatches\r\n",
+				 CaptureCodecIsEnabled() ? "on" : "off", (unsigned long)stats.packedBlocks, (unsigned long)stats.blocks, (unsigned long)stats.rawBytes,
+				 (unsigned long)stats.packedBytes, (unsigned long)(ratio / 100), (unsigned long)(ratio % 100), (unsigned long)stats.worstEncodeUs,
+				 (unsigned long)stats.mismatches);
+	} else if (strncmp(mode, "on", modeLen) == 0 && modeLen == 2) {
+		CaptureCodecSetEnabled(true);
+	} else if (strncmp(mode, "off", modeLen) == 0 && modeLen == 3) {
+		CaptureCodecSetEnabled(false);
+	} else {
+		snprintf((char *)pcWriteBuffer, xWriteBufferLen, "Usage: codec [on|off]\r\n");
+	}
+	return pdFALSE;
+}
+
+/**
+ * @brief    Creates the SD segment pool, starts or stops recording into it, or prints its counters
+ ******************************************************************************/
+BaseType_t CLI_Segments(int8_t *pcWriteBuffer, size_t xWriteBufferLen, const int8_t *pcCommandString)
+{
+	BaseType_t modeLen, countLen, sizeLen;
+	const char *mode = FreeRTOS_CLIGetParameter((const char *)pcCommandString, 1, &modeLen);
+	const char *count = FreeRTOS_CLIGetParameter((const char *)pcCommandString, 2, &countLen);
+	const char *size = FreeRTOS_CLIGetParameter((const char *)pcCommandString, 3, &sizeLen);
+
+	if (mode == NULL) {
+		struct CaptureSegmentsStats stats;
+		uint8_t segments, index;
+		CaptureSegmentsGetStats(&stats, &segments, &index);
+		snprintf((char *)pcWriteBuffer, xWriteBufferLen, "Segments %s, %u/%u, %lu sectors, %lu rotations, %lu dropped, %lu errors, worst write %lu us\r\n",
+				 CaptureSegmentsIsActive() ? "on" : "off", index, segments, (unsigned long)stats.sectors, (unsigned long)stats.rotations,
+				 (unsigned long)stats.dropped, (unsigned long)stats.writeErrors, (unsigned long)stats.worstWriteUs);
+	} else if (strncmp(mode, "create", modeLen) == 0 && modeLen == 6) {
+		uint32_t segments = (count != NULL) ? strtoul(count, NULL, 10) : CAPTURE_SEGMENTS_DEFAULT_COUNT;
+		uint32_t sizeMb = (size != NULL) ? strtoul(size, NULL, 10) : CAPTURE_SEGMENTS_DEFAULT_MB;
+		if (segments == 0 || segments > CAPTURE_SEGMENTS_MAX_COUNT || sizeMb == 0 || sizeMb > 1024) {
+			snprintf((char *)pcWriteBuffer, xWriteBufferLen, "1 to %u segments of 1 to 1024 MB\r\n", CAPTURE_SEGMENTS_MAX_COUNT);
+		} else {
+			CaptureSegmentsCreate((uint8_t)segments, (uint16_t)sizeMb);
+			snprintf((char *)pcWriteBuffer, xWriteBufferLen, "Creating %lu segments of %lu MB\r\n", (unsigned long)segments, (unsigned long)sizeMb);
+		}
+	} else if (strncmp(mode, "on", modeLen) == 0 && modeLen == 2) {
+		CaptureSegmentsStart();
+	} else if (strncmp(mode, "off", modeLen) == 0 && modeLen == 3) {
+		CaptureSegmentsStop();
+	} else {
+		snprintf((char *)pcWriteBuffer, xWriteBufferLen, "Usage: segments [create [count] [MB]|on|off]\r\n");
+	}
+	return pdFALSE;
+}
+
+/**
+ * @brief    Starts, stops or reports the UDP stream. See UdpStream.h for the datagram format.
+ ******************************************************************************/
+BaseType_t CLI_Udp(int8_t *pcWriteBuffer, size_t xWriteBufferLen, const int8_t *pcCommandString)
+{
+	BaseType_t ipLen, portLen, parityLen;
+	const char *ip = FreeRTOS_CLIGetParameter((const char *)pcCommandString, 1, &ipLen);
+	const char *port = FreeRTOS_CLIGetParameter((const char *)pcCommandString, 2, &portLen);
+	const char *parity = FreeRTOS_CLIGetParameter((const char *)pcCommandString, 3, &parityLen);
+
+	if (ip == NULL) {
+		struct UdpStreamStats stats;
+		UdpStreamGetStats(&stats);
+		snprintf((char *)pcWriteBuffer, xWriteBufferLen, "UDP %s, %lu datagrams, %lu parity, %lu send errors, %lu records dropped\r\n",
+				 UdpStreamIsActive() ? "on" : "off", (unsigned long)stats.datagrams, (unsigned long)stats.parity, (unsigned long)stats.sendErrors,
+				 (unsigned long)stats.dropped);
+	} else if (strncmp(ip, "off", ipLen) == 0 && ipLen == 3) {
+		UdpStreamDisable();
+	} else if (ipLen < (BaseType_t)sizeof(bufCliStream)) {
+		memcpy(bufCliStream, ip, ipLen);
+		bufCliStream[ipLen] = '\0';
+		uint32_t addr = nmi_inet_addr(bufCliStream);
+		uint16_t udpPort = (port != NULL) ? (uint16_t)strtoul(port, NULL, 10) : UDP_STREAM_DEFAULT_PORT;
+		uint8_t group = (parity != NULL) ? (uint8_t)strtoul(parity, NULL, 10) : 0;
+		if (addr == 0 || udpPort == 0) {
+			snprintf((char *)pcWriteBuffer, xWriteBufferLen, "Usage: udp [<ip> [port] [parity]|off]\r\n");
+		} else {
+			UdpStreamEnable(addr, udpPort, group);
+			snprintf((char *)pcWriteBuffer, xWriteBufferLen, "Streaming to %s:%u\r\n", bufCliStream, (unsigned)udpPort);
+		}
+	} else {
+		snprintf((char *)pcWriteBuffer, xWriteBufferLen, "Usage: udp [<ip> [port] [parity]|off]\r\n");
+	}
+	return pdFALSE;
+}
+
+/**
+ * @brief    Switches the console to transfer mode until the host quits. See SerialTransfer.h for the protocol.
+ ******************************************************************************/
+BaseType_t CLI_Transfer(int8_t *pcWriteBuffer, size_t xWriteBufferLen, const int8_t *pcCommandString)
+{
+	BaseType_t baudLen;
+	const char *baud = FreeRTOS_CLIGetParameter((const char *)pcCommandString, 1, &baudLen);
+	uint32_t baudrate = (baud != NULL) ? strtoul(baud, NULL, 10) : XFER_DEFAULT_BAUD;
+
+	snprintf(bufCliStream, sizeof(bufCliStream), "Transfer mode at %lu baud\r\n", (unsigned long)baudrate);
+	SerialConsoleWriteString(bufCliStream);
+	SerialTransferRun(baudrate);
+	snprintf((char *)pcWriteBuffer, xWriteBufferLen, "Transfer mode ended\r\n");
+	return pdFALSE;
+}
+
+/**
+ * @brief    Queues the HTTP upload of a file from the SD card. The result is logged by the Wifi task when it ends.
+ ******************************************************************************/
+BaseType_t CLI_Upload(int8_t *pcWriteBuffer, size_t xWriteBufferLen, const int8_t *pcCommandString)
+{
+	BaseType_t nameLen;
+	const char *name = FreeRTOS_CLIGetParameter((const char *)pcCommandString, 1, &nameLen);
+
+	if (nameLen >= (BaseType_t)sizeof(bufCliStream)) {
+		snprintf((char *)pcWriteBuffer, xWriteBufferLen, "File name too long\r\n");
+		return pdFALSE;
+	}
+	memcpy(bufCliStream, name, nameLen);
+	bufCliStream[nameLen] = '\0';
+	if (WifiHandlerUploadFile(bufCliStream) == 0) {
+		snprintf((char *)pcWriteBuffer, xWriteBufferLen, "Uploading %s\r\n", bufCliStream);
+	} else {
+		snprintf((char *)pcWriteBuffer, xWriteBufferLen, "Upload not started\r\n");
+	}
+	return pdFALSE;
+}
+
 /**
  * @brief    Scans fot connected i2c devices
  * @param    p_cli
@@ -0,0 +1,197 @@
+/**************************************************************************/ /**
+ * @file      DeviceId.c
+ * @brief     Serial number and boot counter of the analyzer. The boot counter walks the eight pages of two NVM rows,
+ *            one page per boot, and only ever erases the row that does not hold the latest count: a power loss during
+ *            an erase or a write leaves the previous count readable, and costs one row erase per four boots.
+ * @date      2026-10-19
+
+ ******************************************************************************/
+
+/******************************************************************************
+ * Includes
+ ******************************************************************************/
+#include "DeviceId/DeviceId.h"
+
+#include <asf.h>
+#include <stdio.h>
+#include <string.h>
+
+/******************************************************************************
+ * Defines
+ ******************************************************************************/
+#define DEVICE_ID_ERASED ((uint32_t)0xFFFFFFFF)  ///< Value of an erased flash word
+#define DEVICE_ID_PAGES_PER_ROW (NVMCTRL_ROW_SIZE / NVMCTRL_PAGE_SIZE)
+
+/// Words of the 128-bit serial number, SAMD21 datasheet 10.3.3
+static const uint32_t deviceIdSerialWords[] = {0x0080A00C, 0x0080A040, 0x0080A044, 0x0080A048};
+
+/******************************************************************************
+ * Variables
+ ******************************************************************************/
+static uint32_t deviceIdBoot;  ///< Count of this boot, 0 if the counter could not be written
+
+/******************************************************************************
+ * Forward Declarations
+ ******************************************************************************/
+static enum status_code DeviceIdConfigureNvm(void);
+static enum status_code DeviceIdWritePage(uint32_t address, const struct DeviceIdBootRecord *record, bool erase);
+
+/******************************************************************************
+ * Global Functions
+ ******************************************************************************/
+
+/**
+ * @fn		void DeviceIdInit(void)
+ * @brief	Counts this boot in NVM. Call once after system_init(), before the scheduler starts.
+ * @note	Writes one page, and erases a row every fourth boot. The CPU stalls on flash reads meanwhile.
+ */
+void DeviceIdInit(void)
+{
+    deviceIdBoot = DeviceIdAdvanceBoot((const uint8_t *)DEVICE_ID_BOOT_ADDRESS);
+}
+
+/**
+ * @fn		uint32_t DeviceIdBoot(void)
+ * @brief	Returns the count of this boot
+ * @return	1 on the first boot of a board, one more on each following boot; 0 if it could not be counted
+ */
+uint32_t DeviceIdBoot(void)
+{
+    return deviceIdBoot;
+}
+
+/**
+ * @fn		int DeviceIdFormatSerial(char *text, size_t size)
+ * @brief	Writes the 128-bit serial number of the SAMD21 as 32 hex digits
+ * @param	text Buffer of at least DEVICE_ID_SERIAL_TEXT characters
+ * @param	size Size of text
+ * @return	Number of characters written, without the terminator, or -1 if text is too small
+ */
+int DeviceIdFormatSerial(char *text, size_t size)
+{
+    if (size < DEVICE_ID_SERIAL_TEXT) {
+        return -1;
+    }
+    for (uint8_t i = 0; i < sizeof(deviceIdSerialWords) / sizeof(deviceIdSerialWords[0]); i++) {
+        snprintf(text + 8 * i, size - 8 * i, "%08lX", (unsigned long)*(const volatile uint32_t *)(uintptr_t)deviceIdSerialWords[i]);
+    }
+    return DEVICE_ID_SERIAL_TEXT - 1;
+}
+
+/**
+ * @fn		void DeviceIdPlanBoot(const struct DeviceIdBootRecord *records, const uint8_t *erased, struct DeviceIdBootPlan *plan)
+ * @brief	Picks the page and count of the next boot from the pages of the counter
+ * @param	records Start of each of the DEVICE_ID_BOOT_PAGES pages
+ * @param	erased Nonzero for each page that is all 0xFF
+ * @param	plan Set to the next count, the page to write it to, and whether to erase the page's row first
+ * @note	Pure function of its inputs, so it can be checked off target. A page torn by a power loss, while
+ *			written or erased, fails the check: its words only ever have more bits set than the valid record.
+ */
+void DeviceIdPlanBoot(const struct DeviceIdBootRecord *records, const uint8_t *erased, struct DeviceIdBootPlan *plan)
+{
+    int latest = -1;
+
+    for (uint8_t p = 0; p < DEVICE_ID_BOOT_PAGES; p++) {
+        const struct DeviceIdBootRecord *record = &records[p];
+        if (record->count != DEVICE_ID_ERASED && record->check == ~record->count &&
+            (latest < 0 || record->count > records[latest].count)) {
+            latest = p;
+        }
+    }
+
+    plan->count = (latest < 0) ? 1 : records[latest].count + 1;
+    plan->page = (latest < 0) ? 0 : (uint8_t)((latest + 1) % DEVICE_ID_BOOT_PAGES);
+    if (plan->page % DEVICE_ID_PAGES_PER_ROW != 0 && !erased[plan->page]) {
+        // Torn write after the latest count: go on at the start of the other row
+        plan->page = (uint8_t)(((plan->page / DEVICE_ID_PAGES_PER_ROW + 1) % DEVICE_ID_BOOT_ROWS) * DEVICE_ID_PAGES_PER_ROW);
+    }
+
+    plan->erase = false;
+    if (plan->page % DEVICE_ID_PAGES_PER_ROW == 0) {
+        for (uint8_t p = plan->page; p < plan->page + DEVICE_ID_PAGES_PER_ROW; p++) {
+            plan->erase = plan->erase || !erased[p];
+        }
+    }
+}
+
+/**
+ * @fn		uint32_t DeviceIdAdvanceBoot(const uint8_t *rows)
+ * @brief	Writes the next boot count to the counter rows
+ * @param	rows The counter rows as mapped in memory, at DEVICE_ID_BOOT_ADDRESS on the device
+ * @return	The count written, or 0 if the NVM driver failed
+ */
+uint32_t DeviceIdAdvanceBoot(const uint8_t *rows)
+{
+    struct DeviceIdBootRecord records[DEVICE_ID_BOOT_PAGES];
+    uint8_t erased[DEVICE_ID_BOOT_PAGES];
+    struct DeviceIdBootPlan plan;
+
+    for (uint8_t p = 0; p < DEVICE_ID_BOOT_PAGES; p++) {
+        const uint8_t *page = rows + p * NVMCTRL_PAGE_SIZE;
+        memcpy(&records[p], page, sizeof(records[p]));
+        erased[p] = 1;
+        for (uint8_t i = 0; i < NVMCTRL_PAGE_SIZE; i++) {
+            erased[p] = erased[p] && page[i] == 0xFF;
+        }
+    }
+
+    DeviceIdPlanBoot(records, erased, &plan);
+    records[0] = (struct DeviceIdBootRecord){plan.count, ~plan.count};
+    if (DeviceIdConfigureNvm() != STATUS_OK ||
+        DeviceIdWritePage(DEVICE_ID_BOOT_ADDRESS + plan.page * NVMCTRL_PAGE_SIZE, &records[0], plan.erase) != STATUS_OK) {
+        return 0;
+    }
+    return plan.count;
+}
+
+/******************************************************************************
+ * Local Functions
+ ******************************************************************************/
+
+/**
+ * @fn		static enum status_code DeviceIdConfigureNvm(void)
+ * @brief	Configures the NVM driver for automatic page writes, as BootControl does
+ * @return	Status of nvm_set_config
+ */
+static enum status_code DeviceIdConfigureNvm(void)
+{
+    struct nvm_config config_nvm;
+    enum status_code status;
+
+    nvm_get_config_defaults(&config_nvm);
+    config_nvm.manual_page_write = false;
+    do {
+        status = nvm_set_config(&config_nvm);
+    } while (status == STATUS_BUSY);
+    return status;
+}
+
+/**
+ * @fn		static enum status_code DeviceIdWritePage(uint32_t address, const struct DeviceIdBootRecord *record, bool erase)
+ * @brief	Writes a boot record to the start of an NVM page, the rest of the page left erased
+ * @param	address Address of the page
+ * @param	record Record to write
+ * @param	erase Erase the row of the page first
+ * @return	STATUS_OK on success, an ASF status code otherwise
+ */
+static enum status_code DeviceIdWritePage(uint32_t address, const struct DeviceIdBootRecord *record, bool erase)
+{
+    uint8_t page[NVMCTRL_PAGE_SIZE];
+    enum status_code status = STATUS_OK;
+
+    if (erase) {
+        do {
+            status = nvm_erase_row(address);
+        } while (status == STATUS_BUSY);
+        if (status != STATUS_OK) {
+            return status;
+        }
+    }
+
+    memset(page, 0xFF, sizeof(page));
+    memcpy(page, record, sizeof(*record));
+    do {
+        status = nvm_write_buffer(address, page, sizeof(page));
+    } while (status == STATUS_BUSY);
+    return status;
+}
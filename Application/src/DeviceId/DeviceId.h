@@ -0,0 +1,58 @@
+/**************************************************************************/ /**
+ * @file      DeviceId.h
+ * @brief     Identity of the analyzer in what it publishes: the serial number of the SAMD21, and a boot counter kept
+ *            in two NVM rows below the boot control row. Together with a per-boot message number they key every
+ *            message a receiver stores, across reboots.
+ * @date      2026-10-19
+
+ ******************************************************************************/
+
+#pragma once
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************************************************************************
+ * Includes
+ ******************************************************************************/
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/******************************************************************************
+ * Defines
+ ******************************************************************************/
+#define DEVICE_ID_BOOT_ADDRESS ((uint32_t)0x3FD00)  ///< Two NVM rows up to the boot control row. The application image must stay below it.
+#define DEVICE_ID_BOOT_ROWS 2
+#define DEVICE_ID_BOOT_PAGES (DEVICE_ID_BOOT_ROWS * 4)  ///< Each boot writes the next page, a row is erased every 4 boots
+#define DEVICE_ID_SERIAL_TEXT 33  ///< 32 hex digits and the terminator
+
+/******************************************************************************
+ * Structures and Enumerations
+ ******************************************************************************/
+
+/// Start of each boot counter page. An erased page is all 0xFF, which fails the check.
+struct DeviceIdBootRecord {
+    uint32_t count;
+    uint32_t check;  ///< Bitwise complement of count, catches a torn write
+};
+
+/// Where the next boot count goes
+struct DeviceIdBootPlan {
+    uint32_t count;
+    uint8_t page;
+    bool erase;  ///< Erase the row of page first; the latest count is always in the other row
+};
+
+/******************************************************************************
+ * Global Function Declaration
+ ******************************************************************************/
+void DeviceIdInit(void);
+uint32_t DeviceIdBoot(void);
+int DeviceIdFormatSerial(char *text, size_t size);
+void DeviceIdPlanBoot(const struct DeviceIdBootRecord *records, const uint8_t *erased, struct DeviceIdBootPlan *plan);
+uint32_t DeviceIdAdvanceBoot(const uint8_t *rows);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,351 @@
+/**************************************************************************/ /**
+ * @file      EventDedup.c
+ * @brief     Compression of decoded bus events. A small dictionary keeps the last event of each recently seen
+ *            address and register, so a polled register is sent as a reference to its template, the change of its
+ *            polling period and the few bytes that differ.
+ * @details   A register read once a second at a steady rate, with a duration that varies in its low byte, goes out
+ *            as 3 or 4 bytes instead of 16. The encoder runs in I2cRecordTransaction with the bus mutex held, so the
+ *            firmware dictionary has a single writer; EventDedupReset only raises a flag it picks up.
+ * @date      2026-10-19
+
+ ******************************************************************************/
+
+/******************************************************************************
+ * Includes
+ ******************************************************************************/
+#include "EventDedup/EventDedup.h"
+
+#include <string.h>
+
+#include "FreeRTOS.h"
+#include "SerialConsole.h"
+#include "task.h"
+
+/******************************************************************************
+ * Variables
+ ******************************************************************************/
+static struct EventDedupDictionary dedupDict;  ///< Encoder side of the UART, UDP and SD streams
+static volatile bool dedupEnabled = true;
+static volatile bool dedupResetPending = true;
+static struct EventDedupStats dedupStats;
+
+/******************************************************************************
+ * Forward Declarations
+ ******************************************************************************/
+static uint8_t EventDedupTemplate(struct EventDedupDictionary *dict, uint8_t slot, const uint8_t *event, uint8_t *packed, uint8_t *type);
+static uint32_t EventDedupStart(const uint8_t *event);
+static void EventDedupSetStart(uint8_t *event, uint32_t start);
+
+/******************************************************************************
+ * Global Functions
+ ******************************************************************************/
+
+/**
+ * @fn			void EventDedupInit(struct EventDedupDictionary *dict)
+ * @brief		Empties a dictionary
+ * @param[out]	dict Dictionary
+ */
+void EventDedupInit(struct EventDedupDictionary *dict)
+{
+    memset(dict, 0, sizeof(*dict));
+}
+
+/**
+ * @fn			uint8_t EventDedupEncode(struct EventDedupDictionary *dict, const uint8_t *event, uint8_t *packed, uint8_t *type)
+ * @brief		Encodes an event as a template or as a repeat of one
+ * @param[in,out]	dict Encoder dictionary
+ * @param[in]	event SERIAL_STREAM_EVENT payload
+ * @param[out]	packed Payload to send, EVENT_DEDUP_MAX_SIZE bytes
+ * @param[out]	type SERIAL_STREAM_EVENT_TEMPLATE or SERIAL_STREAM_EVENT_REPEAT
+ * @return		Length of the payload
+ * @note		A fixed amount of work: one pass over the slots and one over the event bytes
+ */
+uint8_t EventDedupEncode(struct EventDedupDictionary *dict, const uint8_t *event, uint8_t *packed, uint8_t *type)
+{
+    uint8_t slot = EVENT_DEDUP_SLOTS;
+    uint8_t oldest = 0;
+
+    dict->uses++;
+    for (uint8_t i = 0; i < EVENT_DEDUP_SLOTS; i++) {
+        struct EventDedupSlot *s = &dict->slot[i];
+        if (s->valid && memcmp(s->event, event, 4) == 0) {
+            slot = i;
+            break;
+        }
+        if (!s->valid || (dict->slot[oldest].valid && s->lastUse < dict->slot[oldest].lastUse)) {
+            oldest = i;
+        }
+    }
+    if (slot == EVENT_DEDUP_SLOTS) {
+        return EventDedupTemplate(dict, oldest, event, packed, type);
+    }
+
+    struct EventDedupSlot *s = &dict->slot[slot];
+    uint32_t start = EventDedupStart(event);
+    uint32_t period = start - EventDedupStart(s->event);
+    int32_t delta = (int32_t)(period - s->period);
+    uint32_t zigzag = ((uint32_t)delta << 1) ^ (uint32_t)(delta >> 31);
+    uint8_t len = 2;
+    uint8_t diffs = 0;
+
+    if (s->repeats >= EVENT_DEDUP_REFRESH) {
+        return EventDedupTemplate(dict, slot, event, packed, type);
+    }
+    do {
+        packed[len++] = (uint8_t)((zigzag & 0x7F) | ((zigzag > 0x7F) ? 0x80 : 0));
+        zigzag >>= 7;
+    } while (zigzag != 0);
+    for (uint8_t i = 0; i < EVENT_DEDUP_EVENT_SIZE; i++) {
+        if (i == EVENT_DEDUP_START_OFFSET) {
+            i += 3;
+            continue;
+        }
+        if (event[i] != s->event[i]) {
+            if (len + 2 >= EVENT_DEDUP_MAX_SIZE) {
+                return EventDedupTemplate(dict, slot, event, packed, type);
+            }
+            packed[len++] = i;
+            packed[len++] = event[i];
+            diffs++;
+        }
+    }
+    packed[0] = (uint8_t)((slot << 4) | diffs);
+    packed[1] = ++s->seq;
+
+    memcpy(s->event, event, EVENT_DEDUP_EVENT_SIZE);
+    s->period = period;
+    s->lastUse = dict->uses;
+    s->repeats++;
+    *type = SERIAL_STREAM_EVENT_REPEAT;
+    return len;
+}
+
+/**
+ * @fn			int8_t EventDedupDecode(struct EventDedupDictionary *dict, uint8_t type, const uint8_t *packed, uint8_t len, uint8_t *event)
+ * @brief		Rebuilds an event from a template or repeat payload. Reference for receivers of the stream.
+ * @param[in,out]	dict Decoder dictionary
+ * @param[in]	type Frame or record type
+ * @param[in]	packed Payload
+ * @param[in]	len Length of the payload
+ * @param[out]	event SERIAL_STREAM_EVENT payload
+ * @return		EVENT_DEDUP_EVENT_SIZE, EVENT_DEDUP_MALFORMED, or EVENT_DEDUP_LOST if the repeat refers to a template
+ *				not received or follows a lost event of its slot
+ */
+int8_t EventDedupDecode(struct EventDedupDictionary *dict, uint8_t type, const uint8_t *packed, uint8_t len, uint8_t *event)
+{
+    if (type == SERIAL_STREAM_EVENT_TEMPLATE) {
+        if ((len != EVENT_DEDUP_MAX_SIZE && len != EVENT_DEDUP_SEED_SIZE) || packed[0] >= EVENT_DEDUP_SLOTS) {
+            return EVENT_DEDUP_MALFORMED;
+        }
+        struct EventDedupSlot *s = &dict->slot[packed[0]];
+        s->seq = packed[1];
+        memcpy(s->event, &packed[2], EVENT_DEDUP_EVENT_SIZE);
+        s->period = 0;
+        for (uint8_t i = 0; len == EVENT_DEDUP_SEED_SIZE && i < 4; i++) {
+            s->period |= (uint32_t)packed[EVENT_DEDUP_MAX_SIZE + i] << (8 * i);
+        }
+        s->valid = true;
+        memcpy(event, s->event, EVENT_DEDUP_EVENT_SIZE);
+        return EVENT_DEDUP_EVENT_SIZE;
+    }
+    if (type != SERIAL_STREAM_EVENT_REPEAT || len < 3) {
+        return EVENT_DEDUP_MALFORMED;
+    }
+
+    uint8_t slot = packed[0] >> 4;
+    uint8_t diffs = packed[0] & 0x0F;
+    uint32_t zigzag = 0;
+    uint8_t pos = 2;
+
+    if (slot >= EVENT_DEDUP_SLOTS) {
+        return EVENT_DEDUP_MALFORMED;
+    }
+    struct EventDedupSlot *s = &dict->slot[slot];
+    for (uint8_t shift = 0;; shift += 7) {
+        if (pos >= len || shift > 28) {
+            return EVENT_DEDUP_MALFORMED;
+        }
+        zigzag |= (uint32_t)(packed[pos] & 0x7F) << shift;
+        if ((packed[pos++] & 0x80) == 0) {
+            break;
+        }
+    }
+    if (len != pos + 2 * diffs) {
+        return EVENT_DEDUP_MALFORMED;
+    }
+    for (uint8_t i = pos; i < len; i += 2) {
+        if (packed[i] >= EVENT_DEDUP_EVENT_SIZE || (packed[i] >= EVENT_DEDUP_START_OFFSET && packed[i] < EVENT_DEDUP_START_OFFSET + 4)) {
+            return EVENT_DEDUP_MALFORMED;
+        }
+    }
+    if (!s->valid || packed[1] != (uint8_t)(s->seq + 1)) {
+        // The template of the slot is out of date: wait for the next one
+        s->valid = false;
+        return EVENT_DEDUP_LOST;
+    }
+
+    uint32_t period = s->period + ((zigzag >> 1) ^ (0 - (zigzag & 1)));
+    uint32_t start = EventDedupStart(s->event) + period;
+    for (; pos < len; pos += 2) {
+        s->event[packed[pos]] = packed[pos + 1];
+    }
+    EventDedupSetStart(s->event, start);
+    s->period = period;
+    s->seq = packed[1];
+    memcpy(event, s->event, EVENT_DEDUP_EVENT_SIZE);
+    return EVENT_DEDUP_EVENT_SIZE;
+}
+
+/**
+ * @fn			uint8_t EventDedupPack(const uint8_t *event, uint8_t *packed, uint8_t *type)
+ * @brief		Encodes an event of the sensor bus with the dictionary of the firmware streams
+ * @param[in]	event SERIAL_STREAM_EVENT payload
+ * @param[out]	packed Payload to send, EVENT_DEDUP_MAX_SIZE bytes
+ * @param[out]	type SERIAL_STREAM_EVENT_TEMPLATE or SERIAL_STREAM_EVENT_REPEAT
+ * @return		Length of the payload
+ * @note		Called with the bus mutex held
+ */
+uint8_t EventDedupPack(const uint8_t *event, uint8_t *packed, uint8_t *type)
+{
+    uint8_t len;
+
+    if (dedupResetPending) {
+        // Slots keep their sequence numbers, so a receiver that missed the reset cannot match a repeat to a template
+        // from before it
+        dedupResetPending = false;
+        for (uint8_t i = 0; i < EVENT_DEDUP_SLOTS; i++) {
+            dedupDict.slot[i].valid = false;
+        }
+    }
+    len = EventDedupEncode(&dedupDict, event, packed, type);
+
+    taskENTER_CRITICAL();
+    dedupStats.events++;
+    dedupStats.packedBytes += len;
+    if (*type == SERIAL_STREAM_EVENT_REPEAT) {
+        dedupStats.repeats++;
+    }
+    taskEXIT_CRITICAL();
+    return len;
+}
+
+/**
+ * @fn			uint8_t EventDedupSeed(uint8_t slot, uint8_t *packed)
+ * @brief		Encodes the current state of a slot of the firmware dictionary as a template with its period. Sent in
+ *				place of the repeat just encoded for the slot, it leaves a receiver in the same state.
+ * @param[in]	slot Slot of the repeat
+ * @param[out]	packed SERIAL_STREAM_EVENT_TEMPLATE payload, EVENT_DEDUP_SEED_SIZE bytes
+ * @return		Length of the payload
+ * @note		Called with the bus mutex held, right after EventDedupPack
+ */
+uint8_t EventDedupSeed(uint8_t slot, uint8_t *packed)
+{
+    const struct EventDedupSlot *s = &dedupDict.slot[slot % EVENT_DEDUP_SLOTS];
+
+    packed[0] = slot % EVENT_DEDUP_SLOTS;
+    packed[1] = s->seq;
+    memcpy(&packed[2], s->event, EVENT_DEDUP_EVENT_SIZE);
+    for (uint8_t i = 0; i < 4; i++) {
+        packed[EVENT_DEDUP_MAX_SIZE + i] = (uint8_t)(s->period >> (8 * i));
+    }
+    return EVENT_DEDUP_SEED_SIZE;
+}
+
+/**
+ * @fn			void EventDedupReset(void)
+ * @brief		Empties the firmware dictionary before the next event, so each template is sent again. Called when a
+ *				stream starts, so it can be decoded from its first event.
+ */
+void EventDedupReset(void)
+{
+    dedupResetPending = true;
+}
+
+/**
+ * @fn			void EventDedupSetEnabled(bool enabled)
+ * @brief		Selects whether bus events are sent as templates and repeats
+ * @param[in]	enabled true to compress, false to send SERIAL_STREAM_EVENT payloads
+ */
+void EventDedupSetEnabled(bool enabled)
+{
+    dedupResetPending = true;
+    dedupEnabled = enabled;
+}
+
+/**
+ * @fn			bool EventDedupIsEnabled(void)
+ * @brief		Returns whether bus events are compressed
+ * @return		true if events are sent as templates and repeats
+ */
+bool EventDedupIsEnabled(void)
+{
+    return dedupEnabled;
+}
+
+/**
+ * @fn			void EventDedupGetStats(struct EventDedupStats *stats)
+ * @brief		Returns the encoder counters since boot
+ * @param[out]	stats Counters
+ */
+void EventDedupGetStats(struct EventDedupStats *stats)
+{
+    taskENTER_CRITICAL();
+    *stats = dedupStats;
+    taskEXIT_CRITICAL();
+}
+
+/******************************************************************************
+ * Local Functions
+ ******************************************************************************/
+
+/**
+ * @fn			static uint8_t EventDedupTemplate(struct EventDedupDictionary *dict, uint8_t slot, const uint8_t *event, uint8_t *packed, uint8_t *type)
+ * @brief		Stores an event in a slot and encodes it as a template
+ * @param[in,out]	dict Encoder dictionary
+ * @param[in]	slot Slot to use
+ * @param[in]	event SERIAL_STREAM_EVENT payload
+ * @param[out]	packed Payload to send
+ * @param[out]	type SERIAL_STREAM_EVENT_TEMPLATE
+ * @return		Length of the payload
+ */
+static uint8_t EventDedupTemplate(struct EventDedupDictionary *dict, uint8_t slot, const uint8_t *event, uint8_t *packed, uint8_t *type)
+{
+    struct EventDedupSlot *s = &dict->slot[slot];
+
+    memcpy(s->event, event, EVENT_DEDUP_EVENT_SIZE);
+    s->period = 0;
+    s->lastUse = dict->uses;
+    s->repeats = 0;
+    s->valid = true;
+
+    packed[0] = slot;
+    packed[1] = ++s->seq;
+    memcpy(&packed[2], event, EVENT_DEDUP_EVENT_SIZE);
+    *type = SERIAL_STREAM_EVENT_TEMPLATE;
+    return EVENT_DEDUP_MAX_SIZE;
+}
+
+/**
+ * @fn			static uint32_t EventDedupStart(const uint8_t *event)
+ * @brief		Reads the start time of an event
+ * @param[in]	event SERIAL_STREAM_EVENT payload
+ * @return		Start time in us
+ */
+static uint32_t EventDedupStart(const uint8_t *event)
+{
+    const uint8_t *p = &event[EVENT_DEDUP_START_OFFSET];
+    return p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/**
+ * @fn			static void EventDedupSetStart(uint8_t *event, uint32_t start)
+ * @brief		Writes the start time of an event
+ * @param[out]	event SERIAL_STREAM_EVENT payload
+ * @param[in]	start Start time in us
+ */
+static void EventDedupSetStart(uint8_t *event, uint32_t start)
+{
+    for (uint8_t i = 0; i < 4; i++) {
+        event[EVENT_DEDUP_START_OFFSET + i] = (uint8_t)(start >> (8 * i));
+    }
+}
@@ -0,0 +1,99 @@
+/**************************************************************************/ /**
+ * @file      EventDedup.h
+ * @brief     Compression of decoded bus events. A small dictionary keeps the last event of each recently seen
+ *            address and register, so a polled register is sent as a reference to its template, the change of its
+ *            polling period and the few bytes that differ.
+ * @date      2026-10-19
+
+ ******************************************************************************/
+
+#pragma once
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************************************************************************
+ * Includes
+ ******************************************************************************/
+#include <stdbool.h>
+#include <stdint.h>
+
+/******************************************************************************
+ * Defines
+ ******************************************************************************/
+#define EVENT_DEDUP_SLOTS 8          ///< Templates kept by encoder and decoder
+#define EVENT_DEDUP_EVENT_SIZE 16    ///< SERIAL_STREAM_EVENT payload
+#define EVENT_DEDUP_MAX_SIZE (2 + EVENT_DEDUP_EVENT_SIZE)  ///< Largest payload the encoder produces
+#define EVENT_DEDUP_SEED_SIZE (EVENT_DEDUP_MAX_SIZE + 4)   ///< Template carrying the period of its slot
+#define EVENT_DEDUP_REFRESH 32       ///< Repeats after which a template is sent again, for receivers that joined late
+#define EVENT_DEDUP_START_OFFSET 8   ///< Start time field of the event, never sent as a byte difference
+
+/*
+ * An event is the 16 byte SERIAL_STREAM_EVENT payload. Events with the same address and register (bytes 0 to 3)
+ * share a dictionary slot. Every event through a slot, template or repeat, carries the next value of an 8 bit
+ * sequence number kept per slot.
+ *   SERIAL_STREAM_EVENT_TEMPLATE  slot (1), sequence (1), event (16), optionally period (4). The receiver stores the
+ *                                 event and the sequence number in the slot and sets the period of the slot to the
+ *                                 one given, or 0. The period is only present in seeds, templates written in place of
+ *                                 a repeat so that a stored segment decodes without the ones before it (see
+ *                                 CaptureSegments.h).
+ *   SERIAL_STREAM_EVENT_REPEAT    slot (high nibble) and k (low nibble), sequence (1), delta of the period (zigzag
+ *                                 LEB128, up to 5 bytes), then k pairs of offset and value. The event is the template
+ *                                 of the slot with the k bytes replaced and start = start of the template + period +
+ *                                 delta. It then becomes the template, and start - previous start becomes the period.
+ *                                 A sequence number other than the one after the slot's means an event of the slot was
+ *                                 lost: the receiver drops the slot and its repeats until the next template.
+ * The encoder sends a template for a new address and register (replacing the least recently used slot), after
+ * EVENT_DEDUP_REFRESH repeats, and when a repeat would not be shorter. A lost event so costs at most
+ * EVENT_DEDUP_REFRESH events of its slot, and is never decoded as a wrong one.
+ */
+
+/******************************************************************************
+ * Structures and Enumerations
+ ******************************************************************************/
+
+/// One template
+struct EventDedupSlot {
+    uint8_t event[EVENT_DEDUP_EVENT_SIZE];  ///< Last event sent through the slot
+    uint32_t period;                        ///< Start time difference of the last two events
+    uint32_t lastUse;                       ///< Encoder only, for the least recently used replacement
+    uint8_t repeats;                        ///< Encoder only, repeats since the template was sent
+    uint8_t seq;                            ///< Sequence number of the last event sent through the slot
+    bool valid;
+};
+
+/// Dictionary state, one on each side of the stream
+struct EventDedupDictionary {
+    struct EventDedupSlot slot[EVENT_DEDUP_SLOTS];
+    uint32_t uses;  ///< Events encoded
+};
+
+/// Counters since boot
+struct EventDedupStats {
+    uint32_t events;       ///< Events encoded
+    uint32_t repeats;      ///< Events sent as a repeat
+    uint32_t packedBytes;  ///< Payload bytes sent for them. Unpacked, each event takes EVENT_DEDUP_EVENT_SIZE.
+};
+
+/// Outcome of decoding a payload
+enum EventDedupResult {
+    EVENT_DEDUP_MALFORMED = -1,  ///< Not a template or repeat payload
+    EVENT_DEDUP_LOST = -2,       ///< Repeat of a slot whose template, or an event since, was not received
+};
+
+/******************************************************************************
+ * Global Function Declaration
+ ******************************************************************************/
+void EventDedupInit(struct EventDedupDictionary *dict);
+uint8_t EventDedupEncode(struct EventDedupDictionary *dict, const uint8_t *event, uint8_t *packed, uint8_t *type);
+int8_t EventDedupDecode(struct EventDedupDictionary *dict, uint8_t type, const uint8_t *packed, uint8_t len, uint8_t *event);
+uint8_t EventDedupPack(const uint8_t *event, uint8_t *packed, uint8_t *type);
+uint8_t EventDedupSeed(uint8_t slot, uint8_t *packed);
+void EventDedupReset(void);
+void EventDedupSetEnabled(bool enabled);
+bool EventDedupIsEnabled(void);
+void EventDedupGetStats(struct EventDedupStats *stats);
+
+#ifdef __cplusplus
+}
+#endif
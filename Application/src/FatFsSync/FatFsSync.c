@@ -0,0 +1,115 @@
+/**************************************************************************/ /**
+ * @file      FatFsSync.c
+ * @brief     FreeRTOS locking for the reentrant FatFs configuration. Each volume is guarded by a mutex, so tasks can
+ *            read and write files on the SD card at the same time, and the contention is counted.
+ * @details   FatFs holds the volume lock for one API call. Mutexes inherit the priority of the highest waiting task,
+ *            so a low priority task inside f_write cannot hold off a higher one longer than that call. Callers keep
+ *            the wait short by transferring about a sector per call, which the upload, the HTTP server and the UART
+ *            transfer already do. With _FS_TINY the sector window is shared by all files of a volume; whole sector
+ *            reads bypass it, so an aligned reader does not evict the partial sector a writer is filling.
+ * @date      2026-10-19
+
+ ******************************************************************************/
+
+/******************************************************************************
+ * Includes
+ ******************************************************************************/
+#include "FatFsSync/FatFsSync.h"
+
+#include "FreeRTOS.h"
+#include "ff.h"
+#include "semphr.h"
+#include "task.h"
+
+/******************************************************************************
+ * Variables
+ ******************************************************************************/
+static SemaphoreHandle_t fatFsVolumeMutex[_VOLUMES];  ///< Created on the first mount of each volume and kept
+static struct FatFsSyncStats fatFsSyncStats;
+
+/******************************************************************************
+ * Global Functions
+ ******************************************************************************/
+
+/**
+ * @fn		int ff_cre_syncobj(BYTE vol, _SYNC_t *sobj)
+ * @brief	Called by f_mount to get the lock of a volume
+ * @param	vol Volume number
+ * @param	sobj Lock of the volume
+ * @return	1 on success, 0 if the mutex could not be allocated (f_mount then fails with FR_INT_ERR)
+ * @note	The mutex of a volume is reused when it is mounted again, as heap_1 cannot free it
+ */
+int ff_cre_syncobj(BYTE vol, _SYNC_t *sobj)
+{
+    if (fatFsVolumeMutex[vol] == NULL) {
+        fatFsVolumeMutex[vol] = xSemaphoreCreateMutex();
+    }
+    *sobj = fatFsVolumeMutex[vol];
+    return (*sobj != NULL);
+}
+
+/**
+ * @fn		int ff_del_syncobj(_SYNC_t sobj)
+ * @brief	Called by f_mount when a volume is unmounted or mounted again. The mutex is kept for the next mount.
+ * @param	sobj Lock of the volume
+ * @return	1
+ */
+int ff_del_syncobj(_SYNC_t sobj)
+{
+    (void)sobj;
+    return 1;
+}
+
+/**
+ * @fn		int ff_req_grant(_SYNC_t sobj)
+ * @brief	Called on entry of every FatFs function that accesses a volume
+ * @param	sobj Lock of the volume
+ * @return	1 once the volume is locked, 0 after _FS_TIMEOUT ticks (the FatFs function then returns FR_TIMEOUT)
+ */
+int ff_req_grant(_SYNC_t sobj)
+{
+    TickType_t start;
+    TickType_t waited;
+
+    if (xSemaphoreTake(sobj, 0) == pdTRUE) {
+        return 1;
+    }
+
+    start = xTaskGetTickCount();
+    if (xSemaphoreTake(sobj, _FS_TIMEOUT) != pdTRUE) {
+        taskENTER_CRITICAL();
+        fatFsSyncStats.timeouts++;
+        taskEXIT_CRITICAL();
+        return 0;
+    }
+    waited = xTaskGetTickCount() - start;
+    taskENTER_CRITICAL();
+    fatFsSyncStats.waits++;
+    if (waited > fatFsSyncStats.maxWaitTicks) {
+        fatFsSyncStats.maxWaitTicks = waited;
+    }
+    taskEXIT_CRITICAL();
+    return 1;
+}
+
+/**
+ * @fn		void ff_rel_grant(_SYNC_t sobj)
+ * @brief	Called on exit of every FatFs function that locked a volume
+ * @param	sobj Lock of the volume
+ */
+void ff_rel_grant(_SYNC_t sobj)
+{
+    xSemaphoreGive(sobj);
+}
+
+/**
+ * @fn		void FatFsSyncGetStats(struct FatFsSyncStats *stats)
+ * @brief	Returns the volume lock contention since boot
+ * @param	stats Counters
+ */
+void FatFsSyncGetStats(struct FatFsSyncStats *stats)
+{
+    taskENTER_CRITICAL();
+    *stats = fatFsSyncStats;
+    taskEXIT_CRITICAL();
+}
@@ -0,0 +1,37 @@
+/**************************************************************************/ /**
+ * @file      FatFsSync.h
+ * @brief     FreeRTOS locking for the reentrant FatFs configuration. Each volume is guarded by a mutex, so tasks can
+ *            read and write files on the SD card at the same time, and the contention is counted.
+ * @date      2026-10-19
+
+ ******************************************************************************/
+
+#pragma once
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************************************************************************
+ * Includes
+ ******************************************************************************/
+#include <stdint.h>
+
+/******************************************************************************
+ * Structures and Enumerations
+ ******************************************************************************/
+
+/// Volume lock contention since boot
+struct FatFsSyncStats {
+    uint32_t waits;         ///< FatFs calls that found the volume locked by another task
+    uint32_t timeouts;      ///< Calls that gave up after _FS_TIMEOUT ticks and returned FR_TIMEOUT
+    uint32_t maxWaitTicks;  ///< Longest wait for the volume
+};
+
+/******************************************************************************
+ * Global Function Declaration
+ ******************************************************************************/
+void FatFsSyncGetStats(struct FatFsSyncStats *stats);
+
+#ifdef __cplusplus
+}
+#endif
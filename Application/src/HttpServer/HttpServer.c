@@ -0,0 +1,674 @@
+/**************************************************************************/ /**
+ * @file      HttpServer.c
+ * @brief     Small HTTP/1.1 server on the WINC1500 socket API to pull captures over the LAN. Lists the files on the SD
+ *            card from the capture catalog, serves them with Range support and returns the current bus statistics
+ *            as JSON.
+ * @details   The server runs in the Wifi task while it is in MQTT mode: WifiHandler forwards socket events to
+ *            HttpServerSocketEvent, which returns false for sockets that are not the server's. There is no dynamic
+ *            allocation. HTTP_SERVER_SLOTS connections are served at once and each holds its request line and an
+ *            open file. All slots share one buffer: the WINC copies received data into it only while the RECV event
+ *            is dispatched, and send() has handed the data to the WINC by the time it returns, so the buffer is free
+ *            again after each event. The buffer belongs to WifiHandler, which also lends it to the HTTP client while
+ *            the server is stopped for a download or upload.
+ *
+ *            A connection reads one request, answers it and is closed. Bodies are sent one buffer at a time, each
+ *            from the SEND event of the previous one. File reads are kept sector aligned so FatFs transfers whole
+ *            sectors from the card straight into the buffer.
+ * @date      2026-10-19
+
+ ******************************************************************************/
+
+/******************************************************************************
+ * Includes
+ ******************************************************************************/
+#include "HttpServer/HttpServer.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "BusStats/BusStats.h"
+#include "CaptureCatalog/CaptureCatalog.h"
+#include "CaptureFile/CaptureFile.h"
+#include "FreeRTOS.h"
+#include "SerialConsole.h"
+#include "SysInit/SysInit.h"
+#include "asf.h"
+#include "ff.h"
+#include "task.h"
+
+/******************************************************************************
+ * Defines
+ ******************************************************************************/
+#define HTTP_SERVER_SECTOR 512
+#define HTTP_SERVER_NAME_MAX 48     ///< Longest file name served, without the drive prefix
+#define HTTP_SERVER_ENTRY_MAX (CAPTURE_CATALOG_NAME_MAX + 96)  ///< Longest entry of the file list
+#define HTTP_SERVER_FILES_PREFIX "/files/"
+
+/******************************************************************************
+ * Structures and Enumerations
+ ******************************************************************************/
+
+enum HttpSlotState {
+    HTTP_SLOT_FREE = 0,
+    HTTP_SLOT_REQUEST,  ///< Reading the request head
+    HTTP_SLOT_BODY      ///< Response header sent, sending the body
+};
+
+enum HttpRoute {
+    HTTP_ROUTE_NONE = 0,  ///< Answered from the header, no body to stream
+    HTTP_ROUTE_LIST,
+    HTTP_ROUTE_FILE,
+    HTTP_ROUTE_STATS
+};
+
+/// One connection
+struct HttpSlot {
+    SOCKET sock;
+    uint8_t state;          ///< enum HttpSlotState
+    uint8_t route;          ///< enum HttpRoute
+    uint16_t status;        ///< Response status decided while reading the request
+    uint8_t head : 1;       ///< HEAD request, no body
+    uint8_t hasRange : 1;
+    uint8_t fileOpen : 1;   ///< file is open
+    uint8_t requestLine : 1;  ///< The request line was parsed, following lines are headers
+    uint8_t lineCut : 1;    ///< The current line did not fit in line[]
+    uint8_t listed : 1;     ///< A catalog record was listed, the next one follows a comma
+    uint8_t lineLen;
+    char line[HTTP_SERVER_LINE_MAX];
+    uint32_t rangeStart;    ///< Range as requested. rangeEnd is inclusive, UINT32_MAX when open ended
+    uint32_t rangeEnd;
+    uint32_t suffix;        ///< Length of a "-n" suffix range, 0 otherwise
+    union {
+        uint32_t remaining;  ///< File bytes left to send
+        uint32_t record;     ///< Next catalog record to list
+    } body;
+    TickType_t lastActivity;
+    FIL file;
+};
+
+/******************************************************************************
+ * Variables
+ ******************************************************************************/
+static SOCKET httpServerSock = -1;
+static struct HttpSlot httpSlots[HTTP_SERVER_SLOTS];
+static char *httpServerBuffer = NULL;  ///< Lent by HttpServerStart, shared by all slots
+static uint16_t httpServerBufferSize = 0;
+
+/******************************************************************************
+ * Forward Declarations
+ ******************************************************************************/
+static struct HttpSlot *HttpServerFindSlot(SOCKET sock);
+static void HttpServerAccept(SOCKET sock);
+static void HttpServerClose(struct HttpSlot *slot);
+static void HttpServerReleaseFile(struct HttpSlot *slot);
+static void HttpServerReceive(struct HttpSlot *slot, const tstrSocketRecvMsg *rx);
+static void HttpServerParseLine(struct HttpSlot *slot, bool first);
+static bool HttpServerDecodePath(char *path);
+static void HttpServerParseRange(struct HttpSlot *slot, const char *value);
+static void HttpServerRespond(struct HttpSlot *slot);
+static uint16_t HttpServerFillBody(struct HttpSlot *slot);
+static void HttpServerSendBody(struct HttpSlot *slot);
+static bool HttpServerStorageReady(void);
+
+/******************************************************************************
+ * Global Functions
+ ******************************************************************************/
+
+/**
+ * @fn			void HttpServerStart(char *buffer, uint16_t size)
+ * @brief		Opens the listening socket if it is not open yet
+ * @param[in]	buffer Receive and send buffer of the server, used until HttpServerStop
+ * @param[in]	size Size of buffer, at least HTTP_SERVER_BUFFER_SIZE
+ * @note		Call periodically while Wi-Fi is connected, a failed bind or listen is retried on the next call
+ */
+void HttpServerStart(char *buffer, uint16_t size)
+{
+    struct sockaddr_in addr;
+
+    if (httpServerSock >= 0 || size < HTTP_SERVER_BUFFER_SIZE) {
+        return;
+    }
+    httpServerBuffer = buffer;
+    httpServerBufferSize = size;
+    httpServerSock = socket(AF_INET, SOCK_STREAM, 0);
+    if (httpServerSock < 0) {
+        return;
+    }
+    addr.sin_family = AF_INET;
+    addr.sin_port = _htons(HTTP_SERVER_PORT);
+    addr.sin_addr.s_addr = 0;
+    if (bind(httpServerSock, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        close(httpServerSock);
+        httpServerSock = -1;
+    }
+}
+
+/**
+ * @fn			void HttpServerStop(void)
+ * @brief		Closes every connection and the listening socket. The buffer is not used afterwards.
+ * @note		Call before socketDeinit and when Wi-Fi is lost
+ */
+void HttpServerStop(void)
+{
+    for (uint8_t i = 0; i < HTTP_SERVER_SLOTS; i++) {
+        if (httpSlots[i].state != HTTP_SLOT_FREE) {
+            HttpServerClose(&httpSlots[i]);
+        }
+    }
+    if (httpServerSock >= 0) {
+        close(httpServerSock);
+        httpServerSock = -1;
+    }
+}
+
+/**
+ * @fn			void HttpServerPoll(void)
+ * @brief		Closes connections that made no progress for HTTP_SERVER_IDLE_MS, so a stalled client cannot hold a slot
+ * @note
+ */
+void HttpServerPoll(void)
+{
+    TickType_t now = xTaskGetTickCount();
+
+    for (uint8_t i = 0; i < HTTP_SERVER_SLOTS; i++) {
+        if (httpSlots[i].state != HTTP_SLOT_FREE && (now - httpSlots[i].lastActivity) > pdMS_TO_TICKS(HTTP_SERVER_IDLE_MS)) {
+            HttpServerClose(&httpSlots[i]);
+        }
+    }
+}
+
+/**
+ * @fn			bool HttpServerSocketEvent(SOCKET sock, uint8_t msgType, void *msg)
+ * @brief		Handles a WINC socket event if it belongs to the server
+ * @param[in]	sock Socket of the event
+ * @param[in]	msgType SOCKET_MSG_* event type
+ * @param[in]	msg Event data
+ * @return		true if the event was for the server, false if it should be passed on
+ * @note		Runs in the Wifi task from m2m_wifi_handle_events
+ */
+bool HttpServerSocketEvent(SOCKET sock, uint8_t msgType, void *msg)
+{
+    struct HttpSlot *slot;
+
+    if (sock >= 0 && sock == httpServerSock) {
+        switch (msgType) {
+            case SOCKET_MSG_BIND:
+                if (((tstrSocketBindMsg *)msg)->status != 0 || listen(httpServerSock, 0) < 0) {
+                    close(httpServerSock);
+                    httpServerSock = -1;
+                }
+                break;
+
+            case SOCKET_MSG_LISTEN:
+                if (((tstrSocketListenMsg *)msg)->status != 0) {
+                    close(httpServerSock);
+                    httpServerSock = -1;
+                } else {
+                    LogMessage(LOG_INFO_LVL, "HTTP server listening on port %d\r\n", HTTP_SERVER_PORT);
+                }
+                break;
+
+            case SOCKET_MSG_ACCEPT:
+                HttpServerAccept(((tstrSocketAcceptMsg *)msg)->sock);
+                break;
+
+            default:
+                break;
+        }
+        return true;
+    }
+
+    slot = HttpServerFindSlot(sock);
+    if (slot == NULL) {
+        return false;
+    }
+    slot->lastActivity = xTaskGetTickCount();
+
+    switch (msgType) {
+        case SOCKET_MSG_RECV:
+            HttpServerReceive(slot, (tstrSocketRecvMsg *)msg);
+            break;
+
+        case SOCKET_MSG_SEND:
+            if (*(int16_t *)msg < 0) {
+                HttpServerClose(slot);
+            } else {
+                HttpServerSendBody(slot);
+            }
+            break;
+
+        default:
+            break;
+    }
+    return true;
+}
+
+/******************************************************************************
+ * Local Functions
+ ******************************************************************************/
+
+/**
+ * @fn			static struct HttpSlot *HttpServerFindSlot(SOCKET sock)
+ * @brief		Returns the slot serving sock, NULL if there is none
+ * @note
+ */
+static struct HttpSlot *HttpServerFindSlot(SOCKET sock)
+{
+    for (uint8_t i = 0; i < HTTP_SERVER_SLOTS; i++) {
+        if (httpSlots[i].state != HTTP_SLOT_FREE && httpSlots[i].sock == sock) {
+            return &httpSlots[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @fn			static void HttpServerAccept(SOCKET sock)
+ * @brief		Gives a new connection a free slot and starts reading its request. Closes it if all slots are busy.
+ * @note
+ */
+static void HttpServerAccept(SOCKET sock)
+{
+    struct HttpSlot *slot = NULL;
+
+    if (sock < 0) {
+        return;
+    }
+    for (uint8_t i = 0; i < HTTP_SERVER_SLOTS; i++) {
+        if (httpSlots[i].state == HTTP_SLOT_FREE) {
+            slot = &httpSlots[i];
+            break;
+        }
+    }
+    if (slot == NULL) {
+        close(sock);
+        return;
+    }
+
+    memset(slot, 0, sizeof(struct HttpSlot));
+    slot->sock = sock;
+    slot->state = HTTP_SLOT_REQUEST;
+    slot->status = 200;
+    slot->lastActivity = xTaskGetTickCount();
+    recv(sock, httpServerBuffer, httpServerBufferSize, 0);
+}
+
+/**
+ * @fn			static void HttpServerClose(struct HttpSlot *slot)
+ * @brief		Closes the connection and the file it was serving, and frees the slot
+ * @note
+ */
+static void HttpServerClose(struct HttpSlot *slot)
+{
+    HttpServerReleaseFile(slot);
+    close(slot->sock);
+    slot->state = HTTP_SLOT_FREE;
+}
+
+/**
+ * @fn			static void HttpServerReleaseFile(struct HttpSlot *slot)
+ * @brief		Closes the file the slot has open
+ * @note
+ */
+static void HttpServerReleaseFile(struct HttpSlot *slot)
+{
+    if (slot->fileOpen) {
+        CaptureFileClose(&slot->file);
+    }
+    slot->fileOpen = false;
+}
+
+/**
+ * @fn			static void HttpServerReceive(struct HttpSlot *slot, const tstrSocketRecvMsg *rx)
+ * @brief		Splits received data into lines until the blank line that ends the request head, then answers
+ * @note		Anything after the head (a request body) is ignored
+ */
+static void HttpServerReceive(struct HttpSlot *slot, const tstrSocketRecvMsg *rx)
+{
+    if (rx->s16BufferSize <= 0) {
+        HttpServerClose(slot);
+        return;
+    }
+    if (slot->state != HTTP_SLOT_REQUEST) {
+        return;
+    }
+
+    for (int16_t i = 0; i < rx->s16BufferSize; i++) {
+        char c = (char)rx->pu8Buffer[i];
+        if (c == '\r') {
+            continue;
+        }
+        if (c != '\n') {
+            if (slot->lineLen < HTTP_SERVER_LINE_MAX - 1) {
+                slot->line[slot->lineLen++] = c;
+            } else {
+                slot->lineCut = true;
+            }
+            continue;
+        }
+
+        slot->line[slot->lineLen] = '\0';
+        if (slot->lineLen == 0 && slot->requestLine) {
+            HttpServerRespond(slot);
+            return;
+        }
+        if (slot->lineLen > 0) {
+            HttpServerParseLine(slot, !slot->requestLine);
+            slot->requestLine = true;
+        }
+        slot->lineLen = 0;
+        slot->lineCut = false;
+    }
+
+    // The WINC delivers the rest of a large segment by itself, only ask for more once it is all consumed
+    if (rx->u16RemainingSize == 0) {
+        recv(slot->sock, httpServerBuffer, httpServerBufferSize, 0);
+    }
+}
+
+/**
+ * @fn			static void HttpServerParseLine(struct HttpSlot *slot, bool first)
+ * @brief		Parses the request line, which picks the route and opens the file, or a header line
+ * @param[in]	slot Connection
+ * @param[in]	first true for the request line
+ * @note		Only the Range header is used, every other header is skipped
+ */
+static void HttpServerParseLine(struct HttpSlot *slot, bool first)
+{
+    char *method, *target, *query, *name;
+
+    if (!first) {
+        if (strncasecmp(slot->line, "Range:", 6) == 0) {
+            HttpServerParseRange(slot, &slot->line[6]);
+        }
+        return;
+    }
+
+    method = strtok(slot->line, " ");
+    target = strtok(NULL, " ");
+    if (slot->lineCut) {
+        slot->status = 414;
+        return;
+    }
+    if (method == NULL || target == NULL) {
+        slot->status = 400;
+        return;
+    }
+    slot->head = (strcmp(method, "HEAD") == 0);
+    if (!slot->head && strcmp(method, "GET") != 0) {
+        slot->status = 405;
+        return;
+    }
+    query = strchr(target, '?');
+    if (query != NULL) {
+        *query = '\0';
+    }
+    if (!HttpServerDecodePath(target)) {
+        slot->status = 400;
+        return;
+    }
+
+    if (strcmp(target, "/stats") == 0) {
+        slot->route = HTTP_ROUTE_STATS;
+        return;
+    }
+    if (!HttpServerStorageReady()) {
+        slot->status = 503;
+        return;
+    }
+
+    if (strcmp(target, "/") == 0) {
+        slot->route = HTTP_ROUTE_LIST;
+        if (!CaptureCatalogIsOpen()) {
+            slot->status = 503;
+        }
+        return;
+    }
+
+    name = &target[strlen(HTTP_SERVER_FILES_PREFIX)];
+    if (strncmp(target, HTTP_SERVER_FILES_PREFIX, strlen(HTTP_SERVER_FILES_PREFIX)) != 0 || name[0] == '\0' ||
+        strchr(name, '/') != NULL || strlen(name) > HTTP_SERVER_NAME_MAX) {
+        slot->status = 404;
+        return;
+    }
+    // The drive prefix goes over the end of "/files/", which makes the path in place
+    name[-2] = LUN_ID_SD_MMC_0_MEM + '0';
+    name[-1] = ':';
+    slot->route = HTTP_ROUTE_FILE;
+    slot->fileOpen = (CaptureFileOpen(&slot->file, &name[-2]) == FR_OK);
+    if (!slot->fileOpen) {
+        slot->status = 404;
+    }
+}
+
+/**
+ * @fn			static bool HttpServerDecodePath(char *path)
+ * @brief		Replaces %XX escapes of the request path by the bytes they stand for, in place
+ * @return		false on a malformed escape or an escaped NUL
+ * @note		'+' is kept, it only stands for a space in query strings
+ */
+static bool HttpServerDecodePath(char *path)
+{
+    char *out = path;
+
+    for (; *path != '\0'; path++) {
+        if (*path == '%') {
+            char hex[3] = {path[1], (path[1] != '\0') ? path[2] : '\0', '\0'};
+            char *end;
+            unsigned long value = strtoul(hex, &end, 16);
+            if (end != &hex[2] || hex[0] == '+' || hex[0] == '-' || hex[0] == ' ' || value == 0) {
+                return false;
+            }
+            *out++ = (char)value;
+            path += 2;
+        } else {
+            *out++ = *path;
+        }
+    }
+    *out = '\0';
+    return true;
+}
+
+/**
+ * @fn			static void HttpServerParseRange(struct HttpSlot *slot, const char *value)
+ * @brief		Reads "bytes=a-b", "bytes=a-" or "bytes=-n". Other units and multiple ranges are ignored, which
+ *				serves the whole file as RFC 7233 allows.
+ * @note
+ */
+static void HttpServerParseRange(struct HttpSlot *slot, const char *value)
+{
+    char *end;
+
+    while (*value == ' ') {
+        value++;
+    }
+    if (strncmp(value, "bytes=", 6) != 0 || strchr(value, ',') != NULL) {
+        return;
+    }
+    value += 6;
+
+    if (*value == '-') {
+        slot->suffix = strtoul(value + 1, &end, 10);
+        slot->hasRange = (end != value + 1 && slot->suffix > 0);
+        return;
+    }
+    slot->rangeStart = strtoul(value, &end, 10);
+    if (end == value || *end != '-') {
+        return;
+    }
+    value = end + 1;
+    slot->rangeEnd = (*value == '\0') ? UINT32_MAX : strtoul(value, &end, 10);
+    slot->hasRange = (*value == '\0' || (end != value && slot->rangeEnd >= slot->rangeStart));
+}
+
+/**
+ * @fn			static void HttpServerRespond(struct HttpSlot *slot)
+ * @brief		Sends the response header once the request head is complete. Errors are answered in full here.
+ * @note
+ */
+static void HttpServerRespond(struct HttpSlot *slot)
+{
+    const char *reason;
+    int len = 0;
+
+    if (!slot->requestLine) {
+        slot->status = 400;
+    }
+
+    if (slot->status == 200 && slot->route == HTTP_ROUTE_FILE) {
+        uint32_t size = slot->file.fsize;
+        uint32_t first = 0, last = (size > 0) ? size - 1 : 0;
+
+        if (slot->hasRange) {
+            if (slot->suffix > 0) {
+                first = (slot->suffix < size) ? size - slot->suffix : 0;
+            } else {
+                first = slot->rangeStart;
+                last = (slot->rangeEnd < last) ? slot->rangeEnd : last;
+            }
+            if (first >= size || (slot->suffix == 0 && slot->rangeStart >= size)) {
+                slot->status = 416;
+            } else {
+                slot->status = 206;
+            }
+        }
+        if (slot->status == 416) {
+            len = snprintf(httpServerBuffer, httpServerBufferSize,
+                           "HTTP/1.1 416 Range Not Satisfiable\r\nContent-Range: bytes */%lu\r\nContent-Length: 0\r\nConnection: close\r\n\r\n",
+                           (unsigned long)size);
+        } else if (CaptureFileSeek(&slot->file, first) != FR_OK) {
+            slot->status = 500;
+        } else {
+            slot->body.remaining = (size > 0) ? last - first + 1 : 0;
+            len = snprintf(httpServerBuffer, httpServerBufferSize,
+                           "HTTP/1.1 %u %s\r\nContent-Type: application/octet-stream\r\nAccept-Ranges: bytes\r\nContent-Length: %lu\r\n",
+                           slot->status, (slot->status == 206) ? "Partial Content" : "OK", (unsigned long)slot->body.remaining);
+            if (slot->status == 206) {
+                len += snprintf(&httpServerBuffer[len], httpServerBufferSize - len, "Content-Range: bytes %lu-%lu/%lu\r\n",
+                                (unsigned long)first, (unsigned long)last, (unsigned long)size);
+            }
+            len += snprintf(&httpServerBuffer[len], httpServerBufferSize - len, "Connection: close\r\n\r\n");
+        }
+    } else if (slot->status == 200) {
+        // List and stats are generated while they are sent, so their length is not known yet
+        len = snprintf(httpServerBuffer, httpServerBufferSize, "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nConnection: close\r\n\r\n");
+    }
+
+    if (slot->status >= 400) {
+        switch (slot->status) {
+            case 400: reason = "Bad Request"; break;
+            case 404: reason = "Not Found"; break;
+            case 405: reason = "Method Not Allowed"; break;
+            case 414: reason = "URI Too Long"; break;
+            case 416: reason = "Range Not Satisfiable"; break;
+            case 503: reason = "Service Unavailable"; break;
+            default: slot->status = 500; reason = "Internal Server Error"; break;
+        }
+        if (slot->status != 416) {
+            len = snprintf(httpServerBuffer, httpServerBufferSize, "HTTP/1.1 %u %s\r\nContent-Length: 0\r\nConnection: close\r\n\r\n",
+                           slot->status, reason);
+        }
+        HttpServerReleaseFile(slot);
+        slot->route = HTTP_ROUTE_NONE;
+    }
+    if (slot->head) {
+        HttpServerReleaseFile(slot);
+        slot->route = HTTP_ROUTE_NONE;
+    }
+
+    slot->state = HTTP_SLOT_BODY;
+    if (send(slot->sock, httpServerBuffer, (uint16_t)len, 0) < 0) {
+        HttpServerClose(slot);
+    }
+}
+
+/**
+ * @fn			static uint16_t HttpServerFillBody(struct HttpSlot *slot)
+ * @brief		Puts the next piece of the response body in the shared buffer
+ * @return		Bytes to send, 0 once the body is complete
+ * @note
+ */
+static uint16_t HttpServerFillBody(struct HttpSlot *slot)
+{
+    uint16_t len = 0;
+
+    switch (slot->route) {
+        case HTTP_ROUTE_FILE: {
+            uint32_t count = HTTP_SERVER_SECTOR - (slot->file.fptr % HTTP_SERVER_SECTOR);
+            UINT read = 0;
+
+            if (count > slot->body.remaining) {
+                count = slot->body.remaining;
+            }
+            if (count == 0 || f_read(&slot->file, httpServerBuffer, count, &read) != FR_OK) {
+                return 0;
+            }
+            slot->body.remaining -= read;
+            return (uint16_t)read;
+        }
+
+        case HTTP_ROUTE_LIST: {
+            struct CaptureCatalogRecord rec;
+
+            if (slot->body.record == 0) {
+                httpServerBuffer[len++] = '[';
+            }
+            while (len < httpServerBufferSize - HTTP_SERVER_ENTRY_MAX - 1) {
+                // Records appended while the list is sent are listed too
+                if (CaptureCatalogRead(slot->body.record, &rec) != FR_OK) {
+                    httpServerBuffer[len++] = ']';
+                    slot->route = HTTP_ROUTE_NONE;
+                    break;
+                }
+                slot->body.record++;
+                if (rec.flags & CAPTURE_CATALOG_FLAG_REPLACED) {
+                    continue;
+                }
+                len += snprintf(&httpServerBuffer[len], httpServerBufferSize - len,
+                                "%s{\"id\":%lu,\"name\":\"%s\",\"size\":%lu,\"start\":%lu,\"end\":%lu,\"ch\":%u}",
+                                slot->listed ? "," : "", (unsigned long)rec.id, rec.name, (unsigned long)rec.size,
+                                (unsigned long)rec.start, (unsigned long)rec.end, rec.channels);
+                slot->listed = true;
+            }
+            return len;
+        }
+
+        case HTTP_ROUTE_STATS:
+            slot->route = HTTP_ROUTE_NONE;
+            len = BusStatsPeekJson(httpServerBuffer, httpServerBufferSize);
+            return (len > 0) ? len : (uint16_t)snprintf(httpServerBuffer, httpServerBufferSize, "{}");
+
+        default:
+            return 0;
+    }
+}
+
+/**
+ * @fn			static void HttpServerSendBody(struct HttpSlot *slot)
+ * @brief		Sends the next piece of the body after the previous send completed, closes once it is all sent
+ * @note
+ */
+static void HttpServerSendBody(struct HttpSlot *slot)
+{
+    uint16_t len;
+
+    if (slot->state != HTTP_SLOT_BODY) {
+        return;
+    }
+    len = HttpServerFillBody(slot);
+    if (len == 0 || send(slot->sock, httpServerBuffer, len, 0) < 0) {
+        HttpServerClose(slot);
+    }
+}
+
+/**
+ * @fn			static bool HttpServerStorageReady(void)
+ * @brief		true once the SD card is mounted
+ * @note
+ */
+static bool HttpServerStorageReady(void)
+{
+    return SysInitWaitFor(SYS_INIT_BIT(SYS_INIT_STORAGE), 0) == pdPASS;
+}
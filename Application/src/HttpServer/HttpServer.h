@@ -0,0 +1,50 @@
+/**************************************************************************/ /**
+ * @file      HttpServer.h
+ * @brief     Small HTTP/1.1 server on the WINC1500 socket API to pull captures over the LAN. Lists the files on the SD
+ *            card from the capture catalog, serves them with Range support and returns the current bus statistics as JSON.
+ * @date      2026-10-19
+
+ ******************************************************************************/
+
+#pragma once
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************************************************************************
+ * Includes
+ ******************************************************************************/
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "socket/include/socket.h"
+
+/******************************************************************************
+ * Defines
+ ******************************************************************************/
+#define HTTP_SERVER_PORT 80
+#define HTTP_SERVER_SLOTS 2          ///< Connections served at once. Further connections are closed on accept
+#define HTTP_SERVER_LINE_MAX 64      ///< Longest request line kept. Longer header lines are truncated
+#define HTTP_SERVER_BUFFER_SIZE 512  ///< Smallest buffer HttpServerStart accepts, one sector of file data
+#define HTTP_SERVER_IDLE_MS 10000    ///< A connection without progress for this long is closed
+
+/*
+ * Routes, all answered with "Connection: close":
+ *   GET /                 JSON list of the cataloged files, oldest first:
+ *                         [{"id":n,"name":"...","size":n,"start":t,"end":t,"ch":n},...] with FAT timestamps
+ *   GET|HEAD /files/NAME  File content. NAME is percent-decoded. Honors a single "Range: bytes=a-b", "a-" or "-n"
+ *                         with 206 or 416
+ *   GET /stats            Bus statistics of the current interval, see BusStatsSnapshotJson
+ */
+
+/******************************************************************************
+ * Global Function Declaration
+ ******************************************************************************/
+void HttpServerStart(char *buffer, uint16_t size);
+void HttpServerStop(void);
+void HttpServerPoll(void);
+bool HttpServerSocketEvent(SOCKET sock, uint8_t msgType, void *msg);
+
+#ifdef __cplusplus
+}
+#endif
@@ -11,6 +11,12 @@
  ******************************************************************************/
 #include "I2cDriver.h"
 
+#include "BusStats/BusStats.h"
+#include "SerialConsole.h"
+#include "CaptureSegments/CaptureSegments.h"
+#include "EventDedup/EventDedup.h"
+#include "UdpStream/UdpStream.h"
+
 /******************************************************************************
  * Defines
  ******************************************************************************/
@@ -344,6 +350,55 @@ static void I2cSetTaskErrorStatus(uint8_t value)
     sensorTransmitError = value;
 }
 
+/**
+ * @fn			static void I2cRecordTransaction(const I2C_Data *data, uint32_t startUs, int32_t error)
+ * @brief       Reports a finished transaction on the sensor bus to the bus statistics, and to the UART and UDP streams
+ *              and the SD segments
+ * @param[in]   data Transaction that was run. The first byte written is taken as the register.
+ * @param[in]   startUs Time the bus was acquired, from BusStatsNowUs
+ * @param[in]   error Result of the transaction, before the mutex is released
+ * @note
+ */
+static void I2cRecordTransaction(const I2C_Data *data, uint32_t startUs, int32_t error)
+{
+    struct BusStatsEvent ev;
+
+    ev.address = data->address;
+    ev.reg = (data->lenOut > 0) ? data->msgOut[0] : BUS_STATS_NO_REGISTER;
+    ev.status = error;
+    ev.startUs = startUs;
+    ev.durationUs = BusStatsNowUs() - startUs;
+    BusStatsRecord(&ev);
+
+    if (SerialConsoleIsStreaming() || UdpStreamIsActive() || CaptureSegmentsIsActive()) {
+        // SERIAL_STREAM_EVENT payload: address (2), register (2), status (4), start us (4), duration us (4), little endian
+        uint8_t frame[16];
+        uint32_t fields[3] = {(uint32_t)ev.status, ev.startUs, ev.durationUs};
+        frame[0] = (uint8_t)ev.address;
+        frame[1] = (uint8_t)(ev.address >> 8);
+        frame[2] = (uint8_t)ev.reg;
+        frame[3] = (uint8_t)(ev.reg >> 8);
+        for (uint8_t i = 0; i < 12; i++) {
+            frame[4 + i] = (uint8_t)(fields[i / 4] >> (8 * (i % 4)));
+        }
+
+        // Polled registers go out as repeats of a dictionary template (see EventDedup.h)
+        uint8_t packed[EVENT_DEDUP_MAX_SIZE];
+        uint8_t type = SERIAL_STREAM_EVENT;
+        const uint8_t *payload = frame;
+        uint8_t len = sizeof(frame);
+        if (EventDedupIsEnabled()) {
+            len = EventDedupPack(frame, packed, &type);
+            payload = packed;
+        }
+        if (SerialConsoleIsStreaming()) {
+            SerialConsoleStreamFrame((enum eSerialStreamType)type, payload, len);
+        }
+        UdpStreamRecord(type, payload, len);
+        CaptureSegmentsRecord(type, payload, len);
+    }
+}
+
 /**
   * @fn			int32_t I2cWriteDataWait(I2C_Data *data, const TickType_t delay, const TickType_t xMaxBlockTime)
   * @brief       This is the main function to use to write data from an I2C device on a given I2C Bus. This function is blocking.
@@ -361,10 +416,12 @@ int32_t I2cWriteDataWait(I2C_Data *data, const TickType_t xMaxBlockTime)
 {
     int32_t error = ERROR_NONE;
     SemaphoreHandle_t semHandle = NULL;
+    uint32_t startUs;
 
     //---0. Get Mutex
     error = I2cGetMutex(WAIT_I2C_LINE_MS);
     if (ERROR_NONE != error) goto exit;
+    startUs = BusStatsNowUs();
 
     //---1. Get Semaphore Handle
     error = I2cGetSemaphoreHandle(&semHandle);
@@ -396,12 +453,14 @@ int32_t I2cWriteDataWait(I2C_Data *data, const TickType_t xMaxBlockTime)
     }
 
     //---8. Release Mutex
+    I2cRecordTransaction(data, startUs, error);
     error |= I2cFreeMutex();
 // xSemaphoreGive(semHandle);
 exit:
     return error;
 
 exitError0:
+    I2cRecordTransaction(data, startUs, error);
     error |= I2cFreeMutex();
     // xSemaphoreGive(semHandle);
     return error;
@@ -423,10 +482,12 @@ int32_t I2cReadDataWait(I2C_Data *data, const TickType_t delay, const TickType_t
 {
     int32_t error = ERROR_NONE;
     SemaphoreHandle_t semHandle = NULL;
+    uint32_t startUs;
 
     //---0. Get Mutex
     error = I2cGetMutex(WAIT_I2C_LINE_MS);
     if (ERROR_NONE != error) goto exit;
+    startUs = BusStatsNowUs();
 
     //---1. Get Semaphore Handle
     error = I2cGetSemaphoreHandle(&semHandle);
@@ -474,12 +535,14 @@ int32_t I2cReadDataWait(I2C_Data *data, const TickType_t delay, const TickType_t
     }
 
     //---8. Release Mutex
+    I2cRecordTransaction(data, startUs, error);
     error = I2cFreeMutex();
 // xSemaphoreGive(semHandle);
 exit:
     return error;
 
 exitError0:
+    I2cRecordTransaction(data, startUs, error);
     error = I2cFreeMutex();
     // xSemaphoreGive(semHandle);
     return error;
@@ -0,0 +1,44 @@
+/**************************************************************************/ /**
+ * @file      ImuBatch.h
+ * @brief     Batch of timestamped IMU samples, as filled by the FIFO decoder and queued for MQTT, UART, UDP and SD.
+ * @date      2026-10-19
+
+ ******************************************************************************/
+
+#pragma once
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************************************************************************
+ * Includes
+ ******************************************************************************/
+#include <stdint.h>
+
+/******************************************************************************
+ * Defines
+ ******************************************************************************/
+#define IMU_BATCH_SIZE 16  ///< Number of IMU samples sent in one MQTT message
+
+/******************************************************************************
+ * Structures and Enumerations
+ ******************************************************************************/
+
+// Structure that holds one timestamped IMU sample (raw accelerometer LSBs)
+struct ImuSample {
+    uint32_t timestampUs;
+    int16_t x;
+    int16_t y;
+    int16_t z;
+};
+
+// Structure that holds a batch of IMU samples drained from the IMU FIFO
+struct ImuDataBatch {
+    uint8_t count;
+    uint8_t channelMask;  ///< Axes to send (enum CaptureChannel), set from the capture configuration
+    struct ImuSample sample[IMU_BATCH_SIZE];
+};
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,351 @@
+/**************************************************************************/ /**
+ * @file      ImuFifo.c
+ * @brief     LSM6DSO FIFO pipeline. Batches accelerometer samples in the IMU FIFO, drains them on the
+ *            watermark interrupt with a single burst read and hands timestamped batches to the WiFi task.
+ * @details   The IMU is configured in continuous (stream) mode with the accelerometer batched at
+ *            IMU_FIFO_XL_BDR, a timestamp word every 8 batches and FIFO compression enabled. When
+ *            IMU_FIFO_WATERMARK words are stored the IMU raises INT1, the task wakes up, reads the FIFO level
+ *            and drains every word with one auto-incrementing I2C read starting at FIFO_DATA_OUT_TAG (the
+ *            device rolls the address back to the TAG register after Z_H). The words are then decoded into
+ *            struct ImuDataBatch and queued for MQTT. One I2C transaction and one wakeup now cover
+ *            IMU_FIFO_WATERMARK samples instead of one.
+ * @date      2026-10-19
+
+ ******************************************************************************/
+
+/******************************************************************************
+ * Includes
+ ******************************************************************************/
+#include "IMU/ImuFifo.h"
+
+#include "CaptureCodec/CaptureCodec.h"
+#include "CaptureConfig/CaptureConfig.h"
+#include "CaptureSynth/CaptureSynth.h"
+#include "I2cDriver/I2cDriver.h"
+#include "SerialConsole.h"
+#include "SysInit/SysInit.h"
+#include "CaptureSegments/CaptureSegments.h"
+#include "UdpStream/UdpStream.h"
+
+/******************************************************************************
+ * Defines
+ ******************************************************************************/
+#define IMU_FIFO_FRAME_SIZE (10 + IMU_BATCH_SIZE * 6)  ///< Largest SERIAL_STREAM_CAPTURE payload
+
+#if IMU_FIFO_FRAME_SIZE + UDP_STREAM_RECORD_HEADER > UDP_STREAM_DATAGRAM_SIZE - UDP_STREAM_HEADER_SIZE
+#error "UDP_STREAM_DATAGRAM_SIZE must hold a full IMU batch"
+#endif
+
+/******************************************************************************
+ * Structures and Enumerations
+ ******************************************************************************/
+
+/// Accelerometer rate selectable through the capture configuration
+struct ImuFifoRate {
+    uint16_t hz;
+    lsm6dso_odr_xl_t odr;
+    lsm6dso_bdr_xl_t bdr;
+    uint32_t periodUs;
+};
+
+/******************************************************************************
+ * Variables
+ ******************************************************************************/
+static SemaphoreHandle_t imuFifoIntSemaphore = NULL;                  ///< Given from the INT1 (FIFO watermark) interrupt
+static uint8_t imuFifoRaw[IMU_FIFO_MAX_WORDS * IMU_FIFO_WORD_SIZE];  ///< Raw FIFO words of one burst read
+static struct ImuFifoDecoder imuFifoDecoder;                          ///< FIFO decoder state
+static struct CaptureConfig imuFifoConfig;                            ///< Capture configuration of the current block
+static uint8_t imuFifoStreamFrame[IMU_FIFO_FRAME_SIZE];               ///< Batch encoded as a SERIAL_STREAM_CAPTURE payload
+/// Batch currently being filled, sharing its memory with the packed payload: the decoder empties the batch once it
+/// has been handed on, and it is packed only after imuFifoStreamFrame holds all of it
+static union {
+    struct ImuDataBatch batch;
+    uint8_t packed[IMU_FIFO_FRAME_SIZE];  ///< The batch as a SERIAL_STREAM_CAPTURE_PACKED payload
+} imuFifoBatch;
+
+/// Rates offered to the capture configuration, slowest first. Faster ODRs are left out because neither the I2C
+/// drain nor the MQTT link keeps up with them.
+static const struct ImuFifoRate imuFifoRates[] = {
+    {12, LSM6DSO_XL_ODR_12Hz5, LSM6DSO_XL_BATCHED_AT_12Hz5, 80000},
+    {26, LSM6DSO_XL_ODR_26Hz, LSM6DSO_XL_BATCHED_AT_26Hz, 38462},
+    {52, LSM6DSO_XL_ODR_52Hz, LSM6DSO_XL_BATCHED_AT_52Hz, 19231},
+    {104, LSM6DSO_XL_ODR_104Hz, LSM6DSO_XL_BATCHED_AT_104Hz, 9615},
+    {208, LSM6DSO_XL_ODR_208Hz, LSM6DSO_XL_BATCHED_AT_208Hz, 4808},
+    {417, LSM6DSO_XL_ODR_417Hz, LSM6DSO_XL_BATCHED_AT_417Hz, 2398},
+};
+
+/******************************************************************************
+ * Forward Declarations
+ ******************************************************************************/
+static void ImuFifoConfigureInterrupt(void);
+static void ImuFifoBatchReady(struct ImuDataBatch *batch);
+static void ImuFifoApplyConfig(stmdev_ctx_t *ctx);
+static bool ImuFifoTriggered(const struct ImuDataBatch *batch);
+static void ImuFifoStreamBatch(const struct ImuDataBatch *batch);
+
+/******************************************************************************
+ * Callback Functions
+ ******************************************************************************/
+
+/**
+ * @fn			void ImuFifoIntCallback(void)
+ * @brief		EXTINT callback for the IMU INT1 line. Wakes up the IMU FIFO task.
+ * @note
+ */
+void ImuFifoIntCallback(void)
+{
+    BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+    xSemaphoreGiveFromISR(imuFifoIntSemaphore, &xHigherPriorityTaskWoken);
+    portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
+}
+
+/******************************************************************************
+ * IMU FIFO Thread
+ ******************************************************************************/
+
+void vImuFifoTask(void *pvParameters)
+{
+    stmdev_ctx_t *ctx = GetImuStruct();
+    uint8_t fifoStatus[2];
+    uint16_t level, words;
+
+    imuFifoIntSemaphore = xSemaphoreCreateBinary();
+    if (imuFifoIntSemaphore == NULL) {
+        LogMessage(LOG_ERROR_LVL, "IMU FIFO: could not allocate semaphore\r\n");
+        vTaskSuspend(NULL);
+    }
+
+    if (SysInitStart(SYS_INIT_CAPTURE, portMAX_DELAY) != pdPASS || InitImu() != 0 || ImuFifoConfigure(ctx) != 0) {
+        LogMessage(LOG_ERROR_LVL, "IMU FIFO: IMU configuration failed\r\n");
+        vTaskSuspend(NULL);
+    }
+
+    CaptureConfigGetActive(&imuFifoConfig);
+    ImuFifoDecoderInit(&imuFifoDecoder, &imuFifoBatch.batch, IMU_FIFO_XL_PERIOD_US, ImuFifoBatchReady);
+    ImuFifoConfigureInterrupt();
+    SysInitReady(SYS_INIT_CAPTURE);
+
+    for (;;) {
+        // The timeout only matters if an edge was missed while the FIFO was above the watermark
+        xSemaphoreTake(imuFifoIntSemaphore, pdMS_TO_TICKS(IMU_FIFO_INT_TIMEOUT_MS));
+
+        if (lsm6dso_read_reg(ctx, LSM6DSO_FIFO_STATUS1, fifoStatus, sizeof(fifoStatus)) != 0) {
+            continue;
+        }
+        level = ((uint16_t)(fifoStatus[1] & 0x03) << 8) | fifoStatus[0];
+
+        while (level > 0) {
+            words = (level > IMU_FIFO_MAX_WORDS) ? IMU_FIFO_MAX_WORDS : level;
+            if (lsm6dso_read_reg(ctx, LSM6DSO_FIFO_DATA_OUT_TAG, imuFifoRaw, words * IMU_FIFO_WORD_SIZE) != 0) {
+                break;
+            }
+            ImuFifoDecode(&imuFifoDecoder, imuFifoRaw, words);
+            level -= words;
+        }
+
+        // Block boundary: a new capture configuration only takes effect here
+        ImuFifoApplyConfig(ctx);
+    }
+}
+
+/******************************************************************************
+ * Global Functions
+ ******************************************************************************/
+
+/**
+ * @fn			int32_t ImuFifoConfigure(stmdev_ctx_t *ctx)
+ * @brief		Configures the LSM6DSO FIFO for watermark driven, compressed accelerometer batching
+ * @details		Compression forces an uncompressed word every 8 batches so that the decoder can resynchronize
+ *				if the FIFO ever overruns and drops the reference sample of a compressed word.
+ * @param[in]	ctx IMU driver context
+ * @return		Returns 0 on success, otherwise the error returned by the I2C driver
+ * @note
+ */
+int32_t ImuFifoConfigure(stmdev_ctx_t *ctx)
+{
+    int32_t error = 0;
+    lsm6dso_emb_sens_t embSens = {0};
+    lsm6dso_pin_int1_route_t int1Route;
+
+    error |= lsm6dso_fifo_mode_set(ctx, LSM6DSO_BYPASS_MODE);
+    error |= lsm6dso_fifo_watermark_set(ctx, IMU_FIFO_WATERMARK);
+    error |= lsm6dso_fifo_xl_batch_set(ctx, IMU_FIFO_XL_BDR);
+    error |= lsm6dso_fifo_gy_batch_set(ctx, LSM6DSO_GY_NOT_BATCHED);
+
+    error |= lsm6dso_timestamp_set(ctx, PROPERTY_ENABLE);
+    error |= lsm6dso_fifo_timestamp_decimation_set(ctx, LSM6DSO_DEC_8);
+
+    embSens.fifo_compr = PROPERTY_ENABLE;
+    error |= lsm6dso_embedded_sens_set(ctx, &embSens);
+    error |= lsm6dso_compression_algo_set(ctx, LSM6DSO_CMP_8_TO_1);
+
+    error |= lsm6dso_pin_int1_route_get(ctx, &int1Route);
+    int1Route.fifo_th = PROPERTY_ENABLE;
+    error |= lsm6dso_pin_int1_route_set(ctx, int1Route);
+
+    error |= lsm6dso_xl_data_rate_set(ctx, IMU_FIFO_XL_ODR);
+    error |= lsm6dso_fifo_mode_set(ctx, LSM6DSO_STREAM_MODE);
+
+    return error;
+}
+
+/******************************************************************************
+ * Local Functions
+ ******************************************************************************/
+
+/**
+ * @fn			static void ImuFifoBatchReady(struct ImuDataBatch *batch)
+ * @brief		Hands a full batch to the WiFi task, and to the UART and UDP streams and the SD segments when they are
+ *				on. The batch is dropped if the queue is full, if no channel is enabled, or if it does not meet the
+ *				trigger condition.
+ * @note		While the synthetic source runs, the sample values are replaced first (see CaptureSynth.h)
+ */
+static void ImuFifoBatchReady(struct ImuDataBatch *batch)
+{
+    if (CaptureSynthIsActive()) {
+        CaptureSynthFill(batch);
+    }
+    if (imuFifoConfig.channelMask == 0 || !ImuFifoTriggered(batch)) {
+        return;
+    }
+    batch->channelMask = imuFifoConfig.channelMask;
+    WifiAddImuBatchToQueue(batch);
+    if (SerialConsoleIsStreaming() || UdpStreamIsActive() || CaptureSegmentsIsActive()) {
+        ImuFifoStreamBatch(batch);
+    }
+}
+
+/**
+ * @fn			static void ImuFifoStreamBatch(const struct ImuDataBatch *batch)
+ * @brief		Sends a batch as a SERIAL_STREAM_CAPTURE frame on the UART and/or record in the UDP stream and the SD
+ *				segments
+ * @details		Payload (little endian): t0 (4), t1 (4), channelMask, count, then for each sample the enabled axes
+ *				as int16 in X, Y, Z order. Samples are evenly spaced between t0 and t1, as in the MQTT message.
+ *				While the codec is on, the payload is packed once and sent as SERIAL_STREAM_CAPTURE_PACKED on all
+ *				three paths, unless packing does not make it shorter.
+ * @param[in]	batch Full batch
+ * @note
+ */
+static void ImuFifoStreamBatch(const struct ImuDataBatch *batch)
+{
+    uint32_t t0 = batch->sample[0].timestampUs;
+    uint32_t t1 = batch->sample[batch->count - 1].timestampUs;
+    uint16_t len = 0;
+
+    for (uint8_t i = 0; i < 4; i++) {
+        imuFifoStreamFrame[len + i] = (uint8_t)(t0 >> (8 * i));
+        imuFifoStreamFrame[len + 4 + i] = (uint8_t)(t1 >> (8 * i));
+    }
+    len += 8;
+    imuFifoStreamFrame[len++] = batch->channelMask;
+    imuFifoStreamFrame[len++] = batch->count;
+    for (uint8_t i = 0; i < batch->count; i++) {
+        const int16_t axes[3] = {batch->sample[i].x, batch->sample[i].y, batch->sample[i].z};
+        for (uint8_t axis = 0; axis < 3; axis++) {
+            if (batch->channelMask & (1 << axis)) {
+                imuFifoStreamFrame[len++] = (uint8_t)axes[axis];
+                imuFifoStreamFrame[len++] = (uint8_t)((uint16_t)axes[axis] >> 8);
+            }
+        }
+    }
+
+    uint8_t type = SERIAL_STREAM_CAPTURE;
+    const uint8_t *payload = imuFifoStreamFrame;
+    if (CaptureCodecIsEnabled()) {
+        uint16_t packedLen = CaptureCodecEncode(imuFifoStreamFrame, len, imuFifoBatch.packed, sizeof(imuFifoBatch.packed));
+        if (packedLen != 0) {
+            type = SERIAL_STREAM_CAPTURE_PACKED;
+            payload = imuFifoBatch.packed;
+            len = packedLen;
+        }
+    }
+    if (SerialConsoleIsStreaming()) {
+        SerialConsoleStreamFrame((enum eSerialStreamType)type, payload, len);
+    }
+    UdpStreamRecord(type, payload, len);
+    CaptureSegmentsRecord(type, payload, len);
+}
+
+/**
+ * @fn			static bool ImuFifoTriggered(const struct ImuDataBatch *batch)
+ * @brief		Checks the trigger condition of the capture configuration against a batch
+ * @param[in]	batch Full batch
+ * @return		true if the batch is to be sent
+ * @note
+ */
+static bool ImuFifoTriggered(const struct ImuDataBatch *batch)
+{
+    if (imuFifoConfig.triggerMode == CAPTURE_TRIGGER_NONE) {
+        return true;
+    }
+
+    for (uint8_t i = 0; i < batch->count; i++) {
+        const struct ImuSample *s = &batch->sample[i];
+        int16_t value = (imuFifoConfig.triggerChannel == 0) ? s->x : (imuFifoConfig.triggerChannel == 1) ? s->y : s->z;
+        if ((imuFifoConfig.triggerMode == CAPTURE_TRIGGER_ABOVE && value > imuFifoConfig.triggerLevel) ||
+            (imuFifoConfig.triggerMode == CAPTURE_TRIGGER_BELOW && value < imuFifoConfig.triggerLevel)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @fn			static void ImuFifoApplyConfig(stmdev_ctx_t *ctx)
+ * @brief		Picks up a capture configuration received over MQTT and reports what was actually applied
+ * @details		The sample rate is rounded down to the closest rate in imuFifoRates (or up to the slowest one).
+ *				Only raw samples are produced by this front end, so ID filters, which belong to bus decoders, are
+ *				dropped. Samples already in the FIFO keep the spacing of the old rate until the next timestamp word.
+ * @param[in]	ctx IMU driver context
+ * @note		Runs between two FIFO drains, so every block is handled with a single configuration
+ */
+static void ImuFifoApplyConfig(stmdev_ctx_t *ctx)
+{
+    struct CaptureConfig cfg;
+    const struct ImuFifoRate *rate = &imuFifoRates[0];
+    uint8_t seq;
+
+    if (!CaptureConfigTakePending(&cfg, &seq)) {
+        return;
+    }
+
+    for (uint8_t i = 0; i < sizeof(imuFifoRates) / sizeof(imuFifoRates[0]); i++) {
+        if (imuFifoRates[i].hz <= cfg.sampleRateHz) {
+            rate = &imuFifoRates[i];
+        }
+    }
+    cfg.sampleRateHz = rate->hz;
+    cfg.filterCount = 0;
+
+    if (rate->periodUs != imuFifoDecoder.periodUs) {
+        if (lsm6dso_fifo_xl_batch_set(ctx, rate->bdr) != 0 || lsm6dso_xl_data_rate_set(ctx, rate->odr) != 0) {
+            LogMessage(LOG_ERROR_LVL, "IMU FIFO: could not change the sample rate\r\n");
+            cfg.sampleRateHz = imuFifoConfig.sampleRateHz;
+        } else {
+            imuFifoDecoder.periodUs = rate->periodUs;
+        }
+    }
+
+    imuFifoConfig = cfg;
+    CaptureConfigApplied(&imuFifoConfig, seq);
+    LogMessage(LOG_INFO_LVL, "Capture config %u applied: channels 0x%x, %u Hz, trigger %u\r\n", seq, cfg.channelMask, cfg.sampleRateHz, cfg.triggerMode);
+}
+
+/**
+ * @fn			static void ImuFifoConfigureInterrupt(void)
+ * @brief		Configures the EXTINT line connected to IMU INT1 to wake up the task on the FIFO watermark
+ * @note
+ */
+static void ImuFifoConfigureInterrupt(void)
+{
+    struct extint_chan_conf config_extint_chan;
+    extint_chan_get_config_defaults(&config_extint_chan);
+    config_extint_chan.gpio_pin = IMU_FIFO_INT_PIN;
+    config_extint_chan.gpio_pin_mux = IMU_FIFO_INT_MUX;
+    config_extint_chan.gpio_pin_pull = EXTINT_PULL_NONE;
+    config_extint_chan.detection_criteria = EXTINT_DETECT_RISING;
+    extint_chan_set_config(IMU_FIFO_INT_LINE, &config_extint_chan);
+
+    extint_register_callback(ImuFifoIntCallback, IMU_FIFO_INT_LINE, EXTINT_CALLBACK_TYPE_DETECT);
+    extint_chan_enable_callback(IMU_FIFO_INT_LINE, EXTINT_CALLBACK_TYPE_DETECT);
+}
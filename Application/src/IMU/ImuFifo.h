@@ -0,0 +1,55 @@
+/**************************************************************************/ /**
+ * @file      ImuFifo.h
+ * @brief     LSM6DSO FIFO pipeline. Batches accelerometer samples in the IMU FIFO, drains them on the
+ *            watermark interrupt with a single burst read and hands timestamped batches to the WiFi task.
+ * @date      2026-10-19
+
+ ******************************************************************************/
+
+#ifndef IMU_FIFO_H_
+#define IMU_FIFO_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************************************************************************
+ * Includes
+ ******************************************************************************/
+#include <stdint.h>
+
+#include "IMU/ImuFifoDecoder.h"
+#include "IMU/lsm6dso_reg.h"
+#include "WifiHandlerThread/WifiHandler.h"
+
+/******************************************************************************
+ * Defines
+ ******************************************************************************/
+#define IMU_FIFO_TASK_SIZE 300
+#define IMU_FIFO_PRIORITY (configMAX_PRIORITIES - 2)
+
+#define IMU_FIFO_WATERMARK 32       ///< FIFO words stored before the watermark interrupt fires
+#define IMU_FIFO_MAX_WORDS 64       ///< Maximum number of words drained on a single burst read
+#define IMU_FIFO_INT_TIMEOUT_MS 2000  ///< Drain the FIFO anyway if no interrupt arrives (missed edge)
+
+#define IMU_FIFO_XL_ODR LSM6DSO_XL_ODR_104Hz
+#define IMU_FIFO_XL_BDR LSM6DSO_XL_BATCHED_AT_104Hz
+#define IMU_FIFO_XL_PERIOD_US 9615  ///< Batch data rate period that matches IMU_FIFO_XL_BDR
+
+/// INT1 of the IMU is wired to the EXT1 IRQ line
+#define IMU_FIFO_INT_PIN EXT1_IRQ_PIN
+#define IMU_FIFO_INT_MUX EXT1_IRQ_MUX
+#define IMU_FIFO_INT_LINE EXT1_IRQ_INPUT
+
+/******************************************************************************
+ * Global Function Declaration
+ ******************************************************************************/
+void vImuFifoTask(void *pvParameters);
+int32_t ImuFifoConfigure(stmdev_ctx_t *ctx);
+void ImuFifoIntCallback(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* IMU_FIFO_H_ */
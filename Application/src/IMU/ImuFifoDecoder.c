@@ -0,0 +1,153 @@
+/**************************************************************************/ /**
+ * @file      ImuFifoDecoder.c
+ * @brief     Decoder of raw LSM6DSO FIFO words into timestamped accelerometer samples. Kept apart from the FIFO
+ *            task so that it builds on the host (see host/).
+ * @date      2026-10-19
+
+ ******************************************************************************/
+
+/******************************************************************************
+ * Includes
+ ******************************************************************************/
+#include "IMU/ImuFifoDecoder.h"
+
+#include <string.h>
+
+#include "IMU/lsm6dso_reg.h"
+
+/******************************************************************************
+ * Defines
+ ******************************************************************************/
+#define IMU_FIFO_TAG_SENSOR(tag) ((tag) >> 3)
+#define IMU_FIFO_TAG_CNT(tag) (((tag) >> 1) & 0x03)
+
+/******************************************************************************
+ * Forward Declarations
+ ******************************************************************************/
+static void ImuFifoEmitXl(struct ImuFifoDecoder *dec, uint8_t age);
+
+/******************************************************************************
+ * Global Functions
+ ******************************************************************************/
+
+/**
+ * @fn			void ImuFifoDecoderInit(struct ImuFifoDecoder *dec, struct ImuDataBatch *batch, uint32_t periodUs, void (*batchReady)(struct ImuDataBatch *batch))
+ * @brief		Resets the decoder state
+ * @param[in]	dec Decoder to initialize
+ * @param[in]	batch Batch that decoded samples are appended to
+ * @param[in]	periodUs Batch data rate period, used to place samples between timestamp words
+ * @param[in]	batchReady Called every time batch fills up. The batch is emptied after the call.
+ * @note
+ */
+void ImuFifoDecoderInit(struct ImuFifoDecoder *dec, struct ImuDataBatch *batch, uint32_t periodUs, void (*batchReady)(struct ImuDataBatch *batch))
+{
+    memset(dec, 0, sizeof(struct ImuFifoDecoder));
+    dec->batch = batch;
+    dec->periodUs = periodUs;
+    dec->batchReady = batchReady;
+    batch->count = 0;
+}
+
+/**
+ * @fn			uint16_t ImuFifoDecode(struct ImuFifoDecoder *dec, const uint8_t *raw, uint16_t words)
+ * @brief		Decodes raw FIFO words (TAG + 6 data bytes each) into timestamped accelerometer samples
+ * @details		Handles uncompressed words (at t, t-1 and t-2), 2x compressed words (two 8-bit deltas per axis at
+ *				t-2 and t-1) and 3x compressed words (three 5-bit deltas per axis packed in 16-bit words at t-2,
+ *				t-1 and t). TAG_CNT advances the time slot and timestamp words anchor the slots to the IMU clock.
+ *				Words of sensors that are not batched are skipped.
+ * @param[in]	dec Decoder state
+ * @param[in]	raw Raw FIFO words
+ * @param[in]	words Number of words in raw
+ * @return		Number of samples appended to the batch
+ * @note
+ */
+uint16_t ImuFifoDecode(struct ImuFifoDecoder *dec, const uint8_t *raw, uint16_t words)
+{
+    uint16_t samples = 0;
+
+    for (uint16_t i = 0; i < words; i++) {
+        const uint8_t *word = &raw[i * IMU_FIFO_WORD_SIZE];
+        const uint8_t *data = &word[1];
+        uint8_t cnt = IMU_FIFO_TAG_CNT(word[0]);
+
+        dec->slot += (uint8_t)(cnt - dec->lastTagCnt) & 0x03;
+        dec->lastTagCnt = cnt;
+
+        switch (IMU_FIFO_TAG_SENSOR(word[0])) {
+            case LSM6DSO_TIMESTAMP_TAG:
+                dec->timestampTicks = (uint32_t)data[0] | ((uint32_t)data[1] << 8) | ((uint32_t)data[2] << 16) | ((uint32_t)data[3] << 24);
+                dec->timestampSlot = dec->slot;
+                break;
+
+            case LSM6DSO_XL_NC_TAG:
+            case LSM6DSO_XL_NC_T_1_TAG:
+            case LSM6DSO_XL_NC_T_2_TAG: {
+                uint8_t age = (IMU_FIFO_TAG_SENSOR(word[0]) == LSM6DSO_XL_NC_TAG) ? 0 : (IMU_FIFO_TAG_SENSOR(word[0]) == LSM6DSO_XL_NC_T_1_TAG) ? 1 : 2;
+                for (uint8_t axis = 0; axis < 3; axis++) {
+                    dec->lastXl[axis] = (int16_t)((uint16_t)data[2 * axis] | ((uint16_t)data[2 * axis + 1] << 8));
+                }
+                ImuFifoEmitXl(dec, age);
+                samples++;
+            } break;
+
+            case LSM6DSO_XL_2XC_TAG:
+                for (uint8_t j = 0; j < 2; j++) {
+                    for (uint8_t axis = 0; axis < 3; axis++) {
+                        dec->lastXl[axis] += (int8_t)data[3 * j + axis];
+                    }
+                    ImuFifoEmitXl(dec, 2 - j);
+                    samples++;
+                }
+                break;
+
+            case LSM6DSO_XL_3XC_TAG:
+                for (uint8_t j = 0; j < 3; j++) {
+                    uint16_t packed = (uint16_t)data[2 * j] | ((uint16_t)data[2 * j + 1] << 8);
+                    for (uint8_t axis = 0; axis < 3; axis++) {
+                        int16_t diff = (packed >> (5 * axis)) & 0x1F;
+                        if (diff & 0x10) {
+                            diff -= 0x20;  // Sign extend the 5-bit delta
+                        }
+                        dec->lastXl[axis] += diff;
+                    }
+                    ImuFifoEmitXl(dec, 2 - j);
+                    samples++;
+                }
+                break;
+
+            default:
+                break;
+        }
+    }
+
+    return samples;
+}
+
+/******************************************************************************
+ * Local Functions
+ ******************************************************************************/
+
+/**
+ * @fn			static void ImuFifoEmitXl(struct ImuFifoDecoder *dec, uint8_t age)
+ * @brief		Appends the last reconstructed accelerometer sample to the batch
+ * @param[in]	dec Decoder state
+ * @param[in]	age Number of time slots the sample is older than the current slot (0, 1 or 2)
+ * @note
+ */
+static void ImuFifoEmitXl(struct ImuFifoDecoder *dec, uint8_t age)
+{
+    struct ImuSample *sample = &dec->batch->sample[dec->batch->count];
+    int32_t slotsSinceTimestamp = (int32_t)(dec->slot - age - dec->timestampSlot);
+
+    sample->timestampUs = dec->timestampTicks * IMU_FIFO_TIMESTAMP_US + slotsSinceTimestamp * (int32_t)dec->periodUs;
+    sample->x = dec->lastXl[0];
+    sample->y = dec->lastXl[1];
+    sample->z = dec->lastXl[2];
+
+    if (++dec->batch->count >= IMU_BATCH_SIZE) {
+        if (dec->batchReady != NULL) {
+            dec->batchReady(dec->batch);
+        }
+        dec->batch->count = 0;
+    }
+}
@@ -0,0 +1,52 @@
+/**************************************************************************/ /**
+ * @file      ImuFifoDecoder.h
+ * @brief     Decoder of raw LSM6DSO FIFO words into timestamped accelerometer samples. Kept apart from the FIFO
+ *            task so that it builds on the host (see host/).
+ * @date      2026-10-19
+
+ ******************************************************************************/
+
+#pragma once
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************************************************************************
+ * Includes
+ ******************************************************************************/
+#include <stdint.h>
+
+#include "IMU/ImuBatch.h"
+
+/******************************************************************************
+ * Defines
+ ******************************************************************************/
+#define IMU_FIFO_WORD_SIZE 7        ///< Each FIFO word is one TAG byte followed by six data bytes
+#define IMU_FIFO_TIMESTAMP_US 25    ///< Resolution of the LSM6DSO timestamp counter
+
+/******************************************************************************
+ * Structures and Enumerations
+ ******************************************************************************/
+
+/// Decoder state carried from one FIFO drain to the next. Compressed words are deltas against the last
+/// sample, and the TAG_CNT field only counts modulo 4, so both must survive across burst reads.
+struct ImuFifoDecoder {
+    int16_t lastXl[3];              ///< Last reconstructed accelerometer sample (reference for compressed words)
+    uint8_t lastTagCnt;             ///< TAG_CNT of the previous word
+    uint32_t slot;                  ///< Running batch data rate time slot
+    uint32_t timestampTicks;        ///< Last timestamp word seen (25 us ticks)
+    uint32_t timestampSlot;         ///< Time slot in which timestampTicks was recorded
+    uint32_t periodUs;              ///< Time between two time slots
+    struct ImuDataBatch *batch;     ///< Batch that decoded samples are appended to
+    void (*batchReady)(struct ImuDataBatch *batch);  ///< Called when batch is full
+};
+
+/******************************************************************************
+ * Global Function Declaration
+ ******************************************************************************/
+void ImuFifoDecoderInit(struct ImuFifoDecoder *dec, struct ImuDataBatch *batch, uint32_t periodUs, void (*batchReady)(struct ImuDataBatch *batch));
+uint16_t ImuFifoDecode(struct ImuFifoDecoder *dec, const uint8_t *raw, uint16_t words);
+
+#ifdef __cplusplus
+}
+#endif
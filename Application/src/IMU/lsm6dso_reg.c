@@ -18,8 +18,9 @@
   */
 
 #include "lsm6dso_reg.h"
-#include "I2cDriver\I2cDriver.h"
+#include "I2cDriver/I2cDriver.h"
 #include <stddef.h>
+#include <string.h>
 
 /**
   * @defgroup  LSM6DSO
@@ -13138,6 +13139,9 @@ static int32_t platform_read(void *handle, uint8_t reg, uint8_t *bufp, uint16_t
 
 stmdev_ctx_t dev_ctx = {.write_reg = platform_write, .read_reg = platform_read};
 
+#define LSM6DSO_I2C_ADDRESS (LSM6DSO_I2C_ADD_L >> 1) ///< 7-bit address (SA0 low) as expected by the I2C driver
+#define LSM6DSO_I2C_TIMEOUT_MS 100
+
 uint8_t msgOutImu[64]; ///<USE ME AS A BUFFER FOR platform_write and platform_read
 I2C_Data imuData; ///<Use me as a structure to communicate with the IMU on platform_write and platform_read
 
@@ -13151,15 +13155,24 @@ I2C_Data imuData; ///<Use me as a structure to communicate with the IMU on platf
  * @param[in]   bufp Pointer to the data to be sent
  * @param[in]   len Length of the data sent
  * @return      Returns what the function "I2cWriteDataWait" returns
- * @note        STUDENTS TO FILL  
+ * @note
 *****************************************************************************/
 static int32_t platform_write(void *handle, uint8_t reg, uint8_t *bufp,uint16_t len)
 {
-	//YOUR JOB: Fill out the structure "imuData" to send to the device
-	//TIP: Use the array "msgOutImu" to copy the data to be sent. Remember that the position [0] of the array you send must be the register, and
-	//starting from position [1] you can copy the data to be sent. Remember to adjust the length accordingly
-return 0;
+	if (len >= sizeof(msgOutImu)) {
+		return ERROR_INVALID_ARG;
+	}
+
+	msgOutImu[0] = reg;
+	memcpy(&msgOutImu[1], bufp, len);
+
+	imuData.address = LSM6DSO_I2C_ADDRESS;
+	imuData.msgOut = (const uint8_t *)msgOutImu;
+	imuData.lenOut = len + 1;
+	imuData.msgIn = NULL;
+	imuData.lenIn = 0;
 
+	return I2cWriteDataWait(&imuData, LSM6DSO_I2C_TIMEOUT_MS);
 }
 
 /**************************************************************************//**
@@ -13172,15 +13185,21 @@ return 0;
  * @param[out]   bufp Pointer to the data to write to (write what was read)
  * @param[in]   len Length of the data to be read
  * @return      Returns what the function "I2cReadDataWait" returns
- * @note        STUDENTS TO FILL  
+ * @note
 *****************************************************************************/
 static  int32_t platform_read(void *handle, uint8_t reg, uint8_t *bufp, uint16_t len)
 {
-	//YOUR JOB: Fill out the structure "imuData" to send to the device
-	//TIP: Check the structure "imuData" and notice that it has a msgOut and msgIn parameter. How do we fill this to our advantage?
-return 0;
+	// The register address goes out first, then the data is read straight into the caller's buffer so that
+	// long burst reads (e.g. draining the FIFO) do not need to fit in msgOutImu.
+	msgOutImu[0] = reg;
 
+	imuData.address = LSM6DSO_I2C_ADDRESS;
+	imuData.msgOut = (const uint8_t *)msgOutImu;
+	imuData.lenOut = 1;
+	imuData.msgIn = bufp;
+	imuData.lenIn = len;
 
+	return I2cReadDataWait(&imuData, 0, LSM6DSO_I2C_TIMEOUT_MS);
 }
 
 
@@ -0,0 +1,363 @@
+/**************************************************************************/ /**
+ * @file      MqttSpool.c
+ * @brief     Store-and-forward spool on the SD card for outbound MQTT messages. Messages that cannot be published
+ *            while the broker is unreachable are appended to a log file and drained in order on reconnect.
+ * @details   The data file is a write-ahead log: each record is written and synced before it counts as spooled.
+ *            The index file only checkpoints the read and write positions. On open, records found past the
+ *            checkpointed end are recovered by scanning, and a torn record at the end is cut off. Records sent
+ *            after the last checkpoint are sent again after a reset, which matches QoS 1 (at least once).
+ *            RAM use is one record buffer, no matter how much is spooled.
+ * @date      2026-10-19
+
+ ******************************************************************************/
+
+/******************************************************************************
+ * Includes
+ ******************************************************************************/
+#include "MqttSpool/MqttSpool.h"
+
+#include <string.h>
+
+#include "SerialConsole.h"
+#include "asf.h"
+
+/******************************************************************************
+ * Defines
+ ******************************************************************************/
+#define MQTT_SPOOL_RECORD_MAGIC 0x5350    ///< "SP"
+#define MQTT_SPOOL_INDEX_MAGIC 0x58444953 ///< "SIDX"
+
+/******************************************************************************
+ * Structures and Enumerations
+ ******************************************************************************/
+
+/// Checkpoint stored in the index file
+struct MqttSpoolIndex {
+    uint32_t magic;
+    uint32_t head;     ///< Offset of the first record not yet sent
+    uint32_t headSeq;  ///< Sequence number of that record
+    uint32_t tail;     ///< Offset where the next record is appended
+    uint32_t check;    ///< Bitwise complement of head ^ headSeq ^ tail
+};
+
+/******************************************************************************
+ * Variables
+ ******************************************************************************/
+static FIL spoolData;                 ///< Data file, kept open while the spool is open
+static FIL spoolIndexFile;            ///< Index file, kept open while the spool is open
+static char spoolDataPath[] = MQTT_SPOOL_DATA_FILE;
+static char spoolIndexPath[] = MQTT_SPOOL_INDEX_FILE;
+static bool spoolOpen = false;
+static struct MqttSpoolIndex spoolIndex;  ///< Current positions. Written to the index file every MQTT_SPOOL_INDEX_INTERVAL changes
+static uint32_t spoolTailSeq = 0;     ///< Sequence number of the next record to append
+static uint16_t spoolUncheckpointed = 0;
+static uint32_t spoolDropped = 0;
+static struct MqttSpoolRecord *spoolRecord = NULL;  ///< Record buffer of the caller, given to MqttSpoolOpen
+
+/******************************************************************************
+ * Forward Declarations
+ ******************************************************************************/
+static uint16_t MqttSpoolCrc(uint16_t crc, const void *data, uint16_t len);
+static FRESULT MqttSpoolReadRecord(uint32_t offset, uint32_t expectedSeq, bool anySeq);
+static FRESULT MqttSpoolRecover(void);
+static FRESULT MqttSpoolCheckpoint(void);
+
+/******************************************************************************
+ * Global Functions
+ ******************************************************************************/
+
+/**
+ * @fn		FRESULT MqttSpoolOpen(struct MqttSpoolRecord *work)
+ * @brief	Opens the spool on the mounted SD card and recovers records written since the last checkpoint
+ * @param	work Buffer that records are read back into. Only used inside MqttSpoolOpen and MqttSpoolDrain, so the
+ *			caller can share it with buffers it does not use during those calls.
+ * @return	FR_OK on success, the FatFs error otherwise
+ * @note	The SD card must be mounted. Must be called from the task that publishes to MQTT.
+ */
+FRESULT MqttSpoolOpen(struct MqttSpoolRecord *work)
+{
+    FRESULT res;
+    UINT count;
+
+    if (spoolOpen) {
+        return FR_OK;
+    }
+    spoolRecord = work;
+
+    spoolDataPath[0] = LUN_ID_SD_MMC_0_MEM + '0';
+    spoolIndexPath[0] = LUN_ID_SD_MMC_0_MEM + '0';
+
+    res = f_open(&spoolData, spoolDataPath, FA_OPEN_ALWAYS | FA_READ | FA_WRITE);
+    if (res != FR_OK) {
+        return res;
+    }
+    res = f_open(&spoolIndexFile, spoolIndexPath, FA_OPEN_ALWAYS | FA_READ | FA_WRITE);
+    if (res != FR_OK) {
+        f_close(&spoolData);
+        return res;
+    }
+
+    // A missing or torn index means starting from the beginning of the log. Worst case some records are sent twice.
+    if (f_read(&spoolIndexFile, &spoolIndex, sizeof(spoolIndex), &count) != FR_OK || count != sizeof(spoolIndex) ||
+        spoolIndex.magic != MQTT_SPOOL_INDEX_MAGIC || spoolIndex.check != ~(spoolIndex.head ^ spoolIndex.headSeq ^ spoolIndex.tail) ||
+        spoolIndex.head > spoolIndex.tail || spoolIndex.tail > f_size(&spoolData)) {
+        memset(&spoolIndex, 0, sizeof(spoolIndex));
+        spoolIndex.magic = MQTT_SPOOL_INDEX_MAGIC;
+        if (MqttSpoolReadRecord(0, 0, true) == FR_OK) {
+            spoolIndex.headSeq = spoolRecord->hdr.seq;
+        }
+    }
+
+    res = MqttSpoolRecover();
+    if (res != FR_OK) {
+        f_close(&spoolIndexFile);
+        f_close(&spoolData);
+        return res;
+    }
+
+    spoolOpen = true;
+    if (spoolIndex.head != spoolIndex.tail) {
+        LogMessage(LOG_INFO_LVL, "MQTT spool: %lu records pending\r\n", (unsigned long)MqttSpoolPending());
+    }
+    return FR_OK;
+}
+
+/**
+ * @fn		bool MqttSpoolIsOpen(void)
+ * @brief	Returns true if MqttSpoolOpen succeeded
+ */
+bool MqttSpoolIsOpen(void)
+{
+    return spoolOpen;
+}
+
+/**
+ * @fn		bool MqttSpoolIsEmpty(void)
+ * @brief	Returns true if there is nothing to drain. New messages must go through the spool while this is false, so they stay in order.
+ */
+bool MqttSpoolIsEmpty(void)
+{
+    return !spoolOpen || spoolIndex.head == spoolIndex.tail;
+}
+
+/**
+ * @fn		FRESULT MqttSpoolAppend(const char *topic, const char *payload, uint16_t len)
+ * @brief	Appends a message to the end of the spool
+ * @param	topic MQTT topic
+ * @param	payload Message payload
+ * @param	len Length of the payload
+ * @return	FR_OK once the record is on the card. FR_DENIED if the spool is full or the message too large.
+ */
+FRESULT MqttSpoolAppend(const char *topic, const char *payload, uint16_t len)
+{
+    struct MqttSpoolRecordHeader hdr;
+    size_t topicLen = strlen(topic);
+    FRESULT res;
+    UINT count;
+
+    if (!spoolOpen) {
+        spoolDropped++;
+        return FR_NOT_READY;
+    }
+    if (topicLen >= MQTT_SPOOL_MAX_TOPIC || len > MQTT_SPOOL_MAX_PAYLOAD ||
+        spoolIndex.tail + sizeof(hdr) + topicLen + len > MQTT_SPOOL_MAX_BYTES) {
+        spoolDropped++;
+        return FR_DENIED;
+    }
+
+    hdr.magic = MQTT_SPOOL_RECORD_MAGIC;
+    hdr.topicLen = (uint8_t)topicLen;
+    hdr.reserved = 0;
+    hdr.payloadLen = len;
+    hdr.crc = MqttSpoolCrc(MqttSpoolCrc(0xFFFF, topic, topicLen), payload, len);
+    hdr.seq = spoolTailSeq;
+
+    res = f_lseek(&spoolData, spoolIndex.tail);
+    if (res == FR_OK) res = f_write(&spoolData, &hdr, sizeof(hdr), &count);
+    if (res == FR_OK) res = f_write(&spoolData, topic, topicLen, &count);
+    if (res == FR_OK) res = f_write(&spoolData, payload, len, &count);
+    if (res == FR_OK) res = f_sync(&spoolData);
+    if (res != FR_OK) {
+        spoolDropped++;
+        return res;
+    }
+
+    spoolIndex.tail += sizeof(hdr) + topicLen + len;
+    spoolTailSeq++;
+    if (++spoolUncheckpointed >= MQTT_SPOOL_INDEX_INTERVAL) {
+        MqttSpoolCheckpoint();
+    }
+    return FR_OK;
+}
+
+/**
+ * @fn		FRESULT MqttSpoolDrain(MqttSpoolPublishFn publish, uint16_t maxRecords)
+ * @brief	Publishes spooled records in order, oldest first
+ * @param	publish Function that publishes one record
+ * @param	maxRecords Most records sent in this call, so the caller keeps servicing its queues
+ * @return	FR_OK if the records were sent or the spool is empty. FR_DISK_ERR if the publish failed; the record
+ *			stays at the head and is sent again on the next call.
+ */
+FRESULT MqttSpoolDrain(MqttSpoolPublishFn publish, uint16_t maxRecords)
+{
+    FRESULT res;
+
+    while (!MqttSpoolIsEmpty() && maxRecords-- > 0) {
+        res = MqttSpoolReadRecord(spoolIndex.head, spoolIndex.headSeq, false);
+        if (res != FR_OK) {
+            // Cannot happen unless the card was changed under us. Drop everything rather than resend garbage.
+            LogMessage(LOG_ERROR_LVL, "MQTT spool: bad record at %lu, discarding spool\r\n", (unsigned long)spoolIndex.head);
+            spoolIndex.head = spoolIndex.tail;
+            break;
+        }
+        if (publish(spoolRecord->topic, spoolRecord->payload, spoolRecord->hdr.payloadLen) != 0) {
+            return FR_DISK_ERR;
+        }
+        spoolIndex.head += sizeof(spoolRecord->hdr) + spoolRecord->hdr.topicLen + spoolRecord->hdr.payloadLen;
+        spoolIndex.headSeq++;
+        if (++spoolUncheckpointed >= MQTT_SPOOL_INDEX_INTERVAL) {
+            MqttSpoolCheckpoint();
+        }
+    }
+
+    if (spoolOpen && spoolIndex.head == spoolIndex.tail && spoolIndex.tail != 0) {
+        // Drained. Start the log over so it does not grow without bound.
+        spoolIndex.head = 0;
+        spoolIndex.tail = 0;
+        spoolIndex.headSeq = spoolTailSeq;
+        res = MqttSpoolCheckpoint();
+        if (res == FR_OK) res = f_lseek(&spoolData, 0);
+        if (res == FR_OK) res = f_truncate(&spoolData);
+        if (res == FR_OK) res = f_sync(&spoolData);
+        return res;
+    }
+    return FR_OK;
+}
+
+/**
+ * @fn		uint32_t MqttSpoolPending(void)
+ * @brief	Returns the number of records waiting to be sent
+ */
+uint32_t MqttSpoolPending(void)
+{
+    return spoolOpen ? spoolTailSeq - spoolIndex.headSeq : 0;
+}
+
+/**
+ * @fn		uint32_t MqttSpoolDropped(void)
+ * @brief	Returns the number of messages that could not be spooled since boot
+ */
+uint32_t MqttSpoolDropped(void)
+{
+    return spoolDropped;
+}
+
+/******************************************************************************
+ * Local Functions
+ ******************************************************************************/
+
+/**
+ * @fn		static uint16_t MqttSpoolCrc(uint16_t crc, const void *data, uint16_t len)
+ * @brief	CRC-16/CCITT, bitwise. Records are short and written at network speed, so a table is not worth the flash.
+ */
+static uint16_t MqttSpoolCrc(uint16_t crc, const void *data, uint16_t len)
+{
+    const uint8_t *bytes = (const uint8_t *)data;
+
+    while (len--) {
+        crc ^= (uint16_t)(*bytes++) << 8;
+        for (uint8_t bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+        }
+    }
+    return crc;
+}
+
+/**
+ * @fn		static FRESULT MqttSpoolReadRecord(uint32_t offset, uint32_t expectedSeq, bool anySeq)
+ * @brief	Reads and checks the record at offset into spoolRecord
+ * @param	offset Offset of the record in the data file
+ * @param	expectedSeq Sequence number the record must have
+ * @param	anySeq Accept any sequence number
+ * @return	FR_OK if a complete, intact record was read. FR_INT_ERR if the record is torn or stale.
+ */
+static FRESULT MqttSpoolReadRecord(uint32_t offset, uint32_t expectedSeq, bool anySeq)
+{
+    struct MqttSpoolRecordHeader *hdr = &spoolRecord->hdr;
+    FRESULT res;
+    UINT count;
+
+    res = f_lseek(&spoolData, offset);
+    if (res != FR_OK) return res;
+    res = f_read(&spoolData, hdr, sizeof(*hdr), &count);
+    if (res != FR_OK) return res;
+    if (count != sizeof(*hdr) || hdr->magic != MQTT_SPOOL_RECORD_MAGIC || hdr->topicLen >= MQTT_SPOOL_MAX_TOPIC ||
+        hdr->payloadLen > MQTT_SPOOL_MAX_PAYLOAD || (!anySeq && hdr->seq != expectedSeq)) {
+        return FR_INT_ERR;
+    }
+
+    res = f_read(&spoolData, spoolRecord->topic, hdr->topicLen, &count);
+    if (res != FR_OK) return res;
+    if (count != hdr->topicLen) return FR_INT_ERR;
+    spoolRecord->topic[hdr->topicLen] = '\0';
+
+    res = f_read(&spoolData, spoolRecord->payload, hdr->payloadLen, &count);
+    if (res != FR_OK) return res;
+    if (count != hdr->payloadLen) return FR_INT_ERR;
+
+    if (MqttSpoolCrc(MqttSpoolCrc(0xFFFF, spoolRecord->topic, hdr->topicLen), spoolRecord->payload, hdr->payloadLen) != hdr->crc) {
+        return FR_INT_ERR;
+    }
+    return FR_OK;
+}
+
+/**
+ * @fn		static FRESULT MqttSpoolRecover(void)
+ * @brief	Finds the real end of the log. Walks from the checkpointed head over every intact record, which also
+ *			picks up records appended after the last checkpoint, and cuts off a torn record at the end.
+ */
+static FRESULT MqttSpoolRecover(void)
+{
+    uint32_t offset = spoolIndex.head;
+    uint32_t seq = spoolIndex.headSeq;
+    FRESULT res;
+
+    while (offset < f_size(&spoolData)) {
+        res = MqttSpoolReadRecord(offset, seq, false);
+        if (res == FR_INT_ERR) {
+            break;
+        } else if (res != FR_OK) {
+            return res;
+        }
+        offset += sizeof(spoolRecord->hdr) + spoolRecord->hdr.topicLen + spoolRecord->hdr.payloadLen;
+        seq++;
+    }
+
+    spoolIndex.tail = offset;
+    spoolTailSeq = seq;
+    if (offset < f_size(&spoolData)) {
+        LogMessage(LOG_INFO_LVL, "MQTT spool: cutting torn data at %lu\r\n", (unsigned long)offset);
+        res = f_lseek(&spoolData, offset);
+        if (res == FR_OK) res = f_truncate(&spoolData);
+        if (res == FR_OK) res = f_sync(&spoolData);
+        if (res != FR_OK) return res;
+    }
+    return MqttSpoolCheckpoint();
+}
+
+/**
+ * @fn		static FRESULT MqttSpoolCheckpoint(void)
+ * @brief	Writes the current positions to the index file
+ */
+static FRESULT MqttSpoolCheckpoint(void)
+{
+    FRESULT res;
+    UINT count;
+
+    spoolIndex.check = ~(spoolIndex.head ^ spoolIndex.headSeq ^ spoolIndex.tail);
+    res = f_lseek(&spoolIndexFile, 0);
+    if (res == FR_OK) res = f_write(&spoolIndexFile, &spoolIndex, sizeof(spoolIndex), &count);
+    if (res == FR_OK) res = f_sync(&spoolIndexFile);
+    if (res == FR_OK) spoolUncheckpointed = 0;
+    return res;
+}
@@ -0,0 +1,70 @@
+/**************************************************************************/ /**
+ * @file      MqttSpool.h
+ * @brief     Store-and-forward spool on the SD card for outbound MQTT messages. Messages that cannot be published
+ *            while the broker is unreachable are appended to a log file and drained in order on reconnect.
+ * @date      2026-10-19
+
+ ******************************************************************************/
+
+#pragma once
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************************************************************************
+ * Includes
+ ******************************************************************************/
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "ff.h"
+
+/******************************************************************************
+ * Defines
+ ******************************************************************************/
+#define MQTT_SPOOL_DATA_FILE "0:spool.dat"  ///< Append-only log of spooled messages
+#define MQTT_SPOOL_INDEX_FILE "0:spool.idx" ///< Checkpoint of the log: first unsent record and end of the log
+
+#define MQTT_SPOOL_MAX_TOPIC 64          ///< Longest topic that can be spooled, including the terminator
+#define MQTT_SPOOL_MAX_PAYLOAD 448       ///< Longest payload that can be spooled, the size of the Wifi task payload buffer
+#define MQTT_SPOOL_MAX_BYTES (4UL << 20) ///< Size of the log at which new messages are dropped
+#define MQTT_SPOOL_INDEX_INTERVAL 16     ///< Records appended or sent between two index checkpoints
+
+/******************************************************************************
+ * Structures and Enumerations
+ ******************************************************************************/
+
+/// Header in front of each record. Followed by topicLen bytes of topic (no terminator) and payloadLen bytes of payload.
+struct MqttSpoolRecordHeader {
+    uint16_t magic;
+    uint8_t topicLen;
+    uint8_t reserved;
+    uint16_t payloadLen;
+    uint16_t crc;  ///< CRC-16/CCITT over the topic and the payload
+    uint32_t seq;  ///< Consecutive record number, rejects stale data behind the end of the log
+};
+
+/// Record read back from the log. The caller provides the buffer (see MqttSpoolOpen).
+struct MqttSpoolRecord {
+    struct MqttSpoolRecordHeader hdr;
+    char topic[MQTT_SPOOL_MAX_TOPIC];
+    char payload[MQTT_SPOOL_MAX_PAYLOAD];
+};
+
+/// Publishes one spooled message. Returns 0 once the broker has accepted it.
+typedef int (*MqttSpoolPublishFn)(const char *topic, const char *payload, uint16_t len);
+
+/******************************************************************************
+ * Global Function Declaration
+ ******************************************************************************/
+FRESULT MqttSpoolOpen(struct MqttSpoolRecord *work);
+bool MqttSpoolIsOpen(void);
+bool MqttSpoolIsEmpty(void);
+FRESULT MqttSpoolAppend(const char *topic, const char *payload, uint16_t len);
+FRESULT MqttSpoolDrain(MqttSpoolPublishFn publish, uint16_t maxRecords);
+uint32_t MqttSpoolPending(void);
+uint32_t MqttSpoolDropped(void);
+
+#ifdef __cplusplus
+}
+#endif
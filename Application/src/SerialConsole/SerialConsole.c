@@ -13,6 +13,17 @@
  *				--Register callbacks for the device to read and write characters asynchronously as required by
  *the CLI
  *				--Initialize the CLI and Debug Logger data structures
+ *				--Send everything written to the console from one ring buffer through a DMA channel
+ *
+ *				Stream mode (CLI command "stream") switches the UART to a higher baud rate and sends binary
+ *				frames instead of text: [type][seq][payload][CRC-32 LE], COBS encoded and terminated by 0x00.
+ *				Text written while streaming is sent as SERIAL_STREAM_LOG frames. A frame is copied into the
+ *				ring whole or dropped, so logs, capture blocks and events never interleave inside a frame.
+ *
+ *				Transfer mode (CLI command "xfer", see SerialTransfer.c) uses the same frames in both directions.
+ *				RX then runs by DMA into a ring instead of one interrupt per character. The SERCOM has no
+ *				idle-line interrupt, so the reader flushes the ring every SERIAL_RX_POLL_MS, or at once when a
+ *				frame delimiter is already in it.
  *
  *				Usage:
  *
@@ -28,13 +39,30 @@
  ******************************************************************************/
 #include "SerialConsole.h"
 
+#include <crc32.h>
+
 #include "CliThread/CliThread.h"
+#include "EventDedup/EventDedup.h"
 
 /******************************************************************************
  * Defines
  ******************************************************************************/
 #define RX_BUFFER_SIZE 512   ///< Size of character buffer for RX, in bytes
-#define TX_BUFFER_SIZE 512   ///< Size of character buffers for TX, in bytes
+#define TX_BUFFER_SIZE 512   ///< Size of the TX ring, in bytes. Must be a power of two
+#define TX_BUFFER_MASK (TX_BUFFER_SIZE - 1)
+
+#define TX_DRAIN_TIMEOUT_MS 500         ///< Longest wait for the TX ring to empty before the baud rate is changed
+#define TX_SHIFT_OUT_MS 2               ///< Time for the last character to leave the shift register
+#define SERIAL_RX_POLL_MS 1             ///< Idle timeout after which received bytes are looked at in transfer mode
+#define SERIAL_RX_SUSPEND_TRIES 100     ///< Polls of the DMA suspend flag before the RX position is read anyway
+#define SERIAL_RX_FRAME_SIZE (SERIAL_FRAME_MAX_SIZE + SERIAL_FRAME_MAX_SIZE / 254 + 1)  ///< Largest COBS encoded frame
+
+#if (TX_BUFFER_SIZE & TX_BUFFER_MASK) != 0
+#error "TX_BUFFER_SIZE must be a power of two"
+#endif
+#if SERIAL_FRAME_ENCODED_SIZE(SERIAL_STREAM_MAX_PAYLOAD) > TX_BUFFER_SIZE
+#error "TX_BUFFER_SIZE must hold the largest stream frame"
+#endif
 
 char debugBuffer[128];
 
@@ -43,29 +71,50 @@ char debugBuffer[128];
  * Structures and Enumerations
  ******************************************************************************/
 cbuf_handle_t cbufRx;   ///< Circular buffer handler for receiving characters from the Serial Interface
-cbuf_handle_t cbufTx;   ///< Circular buffer handler for transmitting characters from the Serial Interface
 
 char latestRx;   ///< Holds the latest character that was received
-char latestTx;   ///< Holds the latest character to be transmitted.
 
 /******************************************************************************
  *  Callback Declaration
  ******************************************************************************/
-void usart_write_callback(struct usart_module *const usart_module);   // Callback for when we finish writing characters to UART
 void usart_read_callback(struct usart_module *const usart_module);    // Callback for when we finis reading characters from UART
+static void usart_tx_dma_callback(struct dma_resource *const resource);   // Callback for when a DMA TX transfer is done
 
 /******************************************************************************
  * Local Function Declaration
  ******************************************************************************/
-static void configure_usart(void);
+static enum status_code configure_usart(uint32_t baudrate);
 static void configure_usart_callbacks(void);
+static void configure_tx_dma(void);
+static void configure_rx_dma(void);
+static uint16_t SerialRxDmaPosition(void);
+static void SerialTxKick(void);
+static uint16_t SerialTxFree(void);
+static void SerialTxPublish(uint16_t head);
+static bool SerialStreamWrite(uint8_t type, const void *payload, uint16_t len);
 
 /******************************************************************************
  * Global Local Variables
  ******************************************************************************/
 struct usart_module usart_instance;
-char rxCharacterBuffer[RX_BUFFER_SIZE];                  ///< Buffer to store received characters
-char txCharacterBuffer[TX_BUFFER_SIZE];                  ///< Buffer to store characters to be sent
+char rxCharacterBuffer[RX_BUFFER_SIZE];                  ///< Buffer to store received characters. DMA RX ring in transfer mode
+static uint8_t txBuffer[TX_BUFFER_SIZE];                 ///< TX ring shared by text and stream frames
+static volatile uint16_t txHead = 0;                     ///< Free running write index, only moved by writers (scheduler suspended)
+static volatile uint16_t txTail = 0;                     ///< Free running read index, only moved by the DMA callback
+static volatile uint16_t txDmaLen = 0;                   ///< Bytes of the transfer in progress
+static volatile bool txDmaBusy = false;
+static volatile bool txPaused = false;                   ///< Set while the USART is reconfigured
+static struct dma_resource txDma;
+COMPILER_ALIGNED(16) static DmacDescriptor txDescriptor;
+static enum eSerialMode serialMode = SERIAL_MODE_TEXT;
+static struct dma_resource rxDma;
+COMPILER_ALIGNED(16) static DmacDescriptor rxDescriptor;  ///< Linked to itself, so the DMA wraps around the ring
+static uint16_t rxRead = 0;                              ///< Next byte of the DMA RX ring to look at
+static uint8_t rxFrame[SERIAL_RX_FRAME_SIZE];            ///< Encoded frame collected up to its delimiter
+static uint16_t rxFrameLen = 0;
+static uint32_t consoleBaudrate = SERIAL_CONSOLE_BAUDRATE;
+static uint8_t streamSeq = 0;                            ///< Sequence number of the next frame
+static uint32_t streamDropped = 0;                       ///< Frames that did not fit in the TX ring
 enum eDebugLogLevels currentDebugLevel = LOG_INFO_LVL;   ///< Variable that holds the level of debug log messages to show. Defaults to showing all debug values
 
 /******************************************************************************
@@ -84,11 +133,13 @@ enum eDebugLogLevels currentDebugLevel = LOG_INFO_LVL;   ///< Variable that hold
 void InitializeSerialConsole(void) {
     // Initialize circular buffers for RX and TX
     cbufRx = circular_buf_init((uint8_t *) rxCharacterBuffer, RX_BUFFER_SIZE);
-    cbufTx = circular_buf_init((uint8_t *) txCharacterBuffer, RX_BUFFER_SIZE);
 
     // Configure USART and Callbacks
-    configure_usart();
+    while (configure_usart(SERIAL_CONSOLE_BAUDRATE) != STATUS_OK) {
+    }
     configure_usart_callbacks();
+    configure_tx_dma();
+    configure_rx_dma();
 
     usart_read_buffer_job(&usart_instance, (uint8_t *) &latestRx, 1);   // Kicks off constant reading of characters
 
@@ -106,23 +157,198 @@ void DeinitializeSerialConsole(void) { usart_disable(&usart_instance); }
  * @fn			void SerialConsoleWriteString(const char * string)
  * @brief		Writes a string to be written to the uart. Copies the string to a ring buffer that is used to hold the
  *text send to the uart
- * @details		Uses the ringbuffer 'cbufTx', which in turn uses the array 'txCharacterBuffer'. Modified to be
- *thread safe.
+ * @details		Uses the TX ring 'txBuffer', which is sent by DMA. Modified to be thread safe. Text that does not
+ *				fit in the ring is dropped. In stream mode the string is sent as one SERIAL_STREAM_LOG frame.
  * @note			Use to send a string of characters to the user via UART
  */
 void SerialConsoleWriteString(const char *string) {
+    if (string == NULL) {
+        return;
+    }
+
     vTaskSuspendAll();
-    if (string != NULL) {
-        for (size_t iter = 0; iter < strlen(string); iter++) {
-            circular_buf_put(cbufTx, string[iter]);
+    size_t len = strlen(string);
+    if (serialMode != SERIAL_MODE_TEXT) {
+        SerialStreamWrite(SERIAL_STREAM_LOG, string, (len > SERIAL_STREAM_MAX_PAYLOAD) ? SERIAL_STREAM_MAX_PAYLOAD : (uint16_t) len);
+    } else {
+        uint16_t head = txHead;
+        uint16_t free = SerialTxFree();
+        for (size_t iter = 0; iter < len && iter < free; iter++) {
+            txBuffer[(head++) & TX_BUFFER_MASK] = (uint8_t) string[iter];
         }
+        SerialTxPublish(head);
+    }
+    xTaskResumeAll();
+}
 
-        if (usart_get_job_status(&usart_instance, USART_TRANSCEIVER_TX) == STATUS_OK) {
-            circular_buf_get(cbufTx, (uint8_t *) &latestTx);   // Perform only if the SERCOM TX is free (not busy)
-            usart_write_buffer_job(&usart_instance, (uint8_t *) &latestTx, 1);
+/**
+ * @fn			bool SerialConsoleStreamFrame(enum eSerialStreamType type, const void *payload, uint16_t len)
+ * @brief		Sends one binary frame while the console is in stream or transfer mode
+ * @param[in]	type Frame type
+ * @param[in]	payload Frame payload
+ * @param[in]	len Payload length, at most SERIAL_STREAM_MAX_PAYLOAD
+ * @return		true if the frame was queued. false in text mode, or if the frame did not fit in the TX ring
+ *				(counted in SerialConsoleStreamDropped, and visible to the receiver as a sequence gap).
+ * @note		Never blocks. Task context only.
+ */
+bool SerialConsoleStreamFrame(enum eSerialStreamType type, const void *payload, uint16_t len) {
+    bool queued = false;
+
+    if (serialMode == SERIAL_MODE_TEXT || len > SERIAL_STREAM_MAX_PAYLOAD) {
+        return false;
+    }
+    vTaskSuspendAll();
+    if (serialMode != SERIAL_MODE_TEXT) {
+        queued = SerialStreamWrite(type, payload, len);
+    }
+    xTaskResumeAll();
+    return queued;
+}
+
+/**
+ * @fn			bool SerialConsoleIsStreaming(void)
+ * @brief		Tells whether the console is in stream mode
+ * @return		true while streaming
+ * @note
+ */
+bool SerialConsoleIsStreaming(void) { return serialMode == SERIAL_MODE_STREAM; }
+
+/**
+ * @fn			enum eSerialMode SerialConsoleGetMode(void)
+ * @brief		Mode the console is in
+ * @return		Current mode
+ * @note
+ */
+enum eSerialMode SerialConsoleGetMode(void) { return serialMode; }
+
+/**
+ * @fn			uint32_t SerialConsoleStreamDropped(void)
+ * @brief		Number of frames dropped because the TX ring was full
+ * @return		Dropped frame count since boot
+ * @note
+ */
+uint32_t SerialConsoleStreamDropped(void) { return streamDropped; }
+
+/**
+ * @fn			uint16_t SerialConsoleTxFree(void)
+ * @brief		Free space in the TX ring, to wait for room for a frame (see SERIAL_FRAME_ENCODED_SIZE)
+ * @return		Free bytes
+ * @note
+ */
+uint16_t SerialConsoleTxFree(void) { return SerialTxFree(); }
+
+/**
+ * @fn			uint32_t SerialConsoleGetBaudrate(void)
+ * @brief		Baud rate the console runs at
+ * @return		Baud rate
+ * @note
+ */
+uint32_t SerialConsoleGetBaudrate(void) { return consoleBaudrate; }
+
+/**
+ * @fn			int16_t SerialConsoleReadFrame(uint8_t *frame, uint16_t size, uint32_t timeoutMs)
+ * @brief		Waits for the next frame received in transfer mode
+ * @param[out]	frame Decoded frame: type, sequence number and payload. Needs room for the CRC as well.
+ * @param[in]	size Size of frame, SERIAL_FRAME_MAX_SIZE for any frame
+ * @param[in]	timeoutMs Longest wait. 0 only looks at what already arrived.
+ * @return		Length of type + sequence number + payload, 0 on timeout, -1 if a damaged frame was discarded
+ * @note		Transfer mode only. Only one task may read.
+ */
+int16_t SerialConsoleReadFrame(uint8_t *frame, uint16_t size, uint32_t timeoutMs) {
+    TickType_t start = xTaskGetTickCount();
+
+    if (serialMode != SERIAL_MODE_TRANSFER) {
+        return 0;
+    }
+    for (;;) {
+        uint16_t position = SerialRxDmaPosition();
+        while (rxRead != position) {
+            uint8_t byte = (uint8_t) rxCharacterBuffer[rxRead];
+            rxRead = (rxRead + 1) % RX_BUFFER_SIZE;
+            if (byte != 0x00) {
+                if (rxFrameLen < sizeof(rxFrame)) {
+                    rxFrame[rxFrameLen] = byte;
+                }
+                if (rxFrameLen <= sizeof(rxFrame)) {
+                    rxFrameLen++;  // One past the buffer marks an overlong frame
+                }
+                continue;
+            }
+            uint16_t encodedLen = rxFrameLen;
+            rxFrameLen = 0;  // The next byte starts a new frame
+            int16_t len = (encodedLen > sizeof(rxFrame)) ? -1 : SerialFrameDecode(rxFrame, encodedLen, frame, size);
+            if (len != 0) {
+                return len;
+            }
         }
+        if ((xTaskGetTickCount() - start) >= pdMS_TO_TICKS(timeoutMs)) {
+            return 0;
+        }
+        vTaskDelay(pdMS_TO_TICKS(SERIAL_RX_POLL_MS));
     }
+}
+
+/**
+ * @fn			void SerialConsoleSetMode(enum eSerialMode mode, uint32_t baudrate)
+ * @brief		Waits for the TX ring to empty, then changes mode and baud rate
+ * @details		Writers keep filling the ring while the USART is reconfigured. Everything written after the switch
+ *				is encoded in the new mode and sent at the new baud rate.
+ * @param[in]	mode New mode
+ * @param[in]	baudrate New baud rate, SERIAL_CONSOLE_BAUDRATE for the text console. If the SERCOM cannot generate
+ *				it, the previous mode and baud rate are kept.
+ * @note		Task context only. Blocks until the TX ring is empty.
+ */
+void SerialConsoleSetMode(enum eSerialMode mode, uint32_t baudrate) {
+    TickType_t start = xTaskGetTickCount();
+    uint32_t previous = consoleBaudrate;
+
+    for (;;) {
+        taskENTER_CRITICAL();
+        if ((txHead == txTail && !txDmaBusy) || (xTaskGetTickCount() - start) > pdMS_TO_TICKS(TX_DRAIN_TIMEOUT_MS)) {
+            txPaused = true;
+            taskEXIT_CRITICAL();
+            break;
+        }
+        taskEXIT_CRITICAL();
+        vTaskDelay(1);
+    }
+    // A transfer still running after the timeout is finished before the SERCOM goes down
+    while (txDmaBusy) {
+    }
+    vTaskDelay(pdMS_TO_TICKS(TX_SHIFT_OUT_MS));
+
+    if (serialMode == SERIAL_MODE_TRANSFER) {
+        dma_abort_job(&rxDma);
+    }
+    usart_disable(&usart_instance);
+    if (configure_usart(baudrate) != STATUS_OK) {
+        mode = serialMode;
+        usart_disable(&usart_instance);
+        while (configure_usart(previous) != STATUS_OK) {
+        }
+    }
+    configure_usart_callbacks();
+    if (mode == SERIAL_MODE_TRANSFER) {
+        rxRead = 0;
+        rxFrameLen = 0;
+        dma_start_transfer_job(&rxDma);
+    } else {
+        circular_buf_reset(cbufRx);
+        usart_read_buffer_job(&usart_instance, (uint8_t *) &latestRx, 1);
+    }
+
+    vTaskSuspendAll();
+    serialMode = mode;
     xTaskResumeAll();
+    if (mode == SERIAL_MODE_STREAM) {
+        // The receiver starts with an empty dictionary, so bus event templates are sent again
+        EventDedupReset();
+    }
+
+    taskENTER_CRITICAL();
+    txPaused = false;
+    SerialTxKick();
+    taskEXIT_CRITICAL();
 }
 
 /**
@@ -197,24 +423,31 @@ COMMAND LINE INTERFACE COMMANDS
  ******************************************************************************/
 
 /**
- * @fn			static void configure_usart(void)
- * @brief		Code to configure the SERCOM "EDBG_CDC_MODULE" to be a UART channel running at 115200 8N1
- * @note
+ * @fn			static enum status_code configure_usart(uint32_t baudrate)
+ * @brief		Code to configure the SERCOM "EDBG_CDC_MODULE" to be a UART channel running at baudrate 8N1
+ * @param[in]	baudrate Baud rate, SERIAL_CONSOLE_BAUDRATE for the text console
+ * @return		STATUS_OK, or the error of usart_init (e.g. STATUS_ERR_BAUDRATE_UNAVAILABLE)
+ * @note		The SERCOM must be disabled
  */
-static void configure_usart(void) {
+static enum status_code configure_usart(uint32_t baudrate) {
     struct usart_config config_usart;
+    enum status_code status;
     usart_get_config_defaults(&config_usart);
 
-    config_usart.baudrate = 115200;
+    config_usart.baudrate = baudrate;
     config_usart.mux_setting = EDBG_CDC_SERCOM_MUX_SETTING;
     config_usart.pinmux_pad0 = EDBG_CDC_SERCOM_PINMUX_PAD0;
     config_usart.pinmux_pad1 = EDBG_CDC_SERCOM_PINMUX_PAD1;
     config_usart.pinmux_pad2 = EDBG_CDC_SERCOM_PINMUX_PAD2;
     config_usart.pinmux_pad3 = EDBG_CDC_SERCOM_PINMUX_PAD3;
-    while (usart_init(&usart_instance, EDBG_CDC_MODULE, &config_usart) != STATUS_OK) {
+    status = usart_init(&usart_instance, EDBG_CDC_MODULE, &config_usart);
+    if (status != STATUS_OK) {
+        return status;
     }
 
     usart_enable(&usart_instance);
+    consoleBaudrate = baudrate;
+    return STATUS_OK;
 }
 
 /**
@@ -223,12 +456,175 @@ static void configure_usart(void) {
  * @note
  */
 static void configure_usart_callbacks(void) {
-    usart_register_callback(&usart_instance, usart_write_callback, USART_CALLBACK_BUFFER_TRANSMITTED);
     usart_register_callback(&usart_instance, usart_read_callback, USART_CALLBACK_BUFFER_RECEIVED);
-    usart_enable_callback(&usart_instance, USART_CALLBACK_BUFFER_TRANSMITTED);
     usart_enable_callback(&usart_instance, USART_CALLBACK_BUFFER_RECEIVED);
 }
 
+/**
+ * @fn			static void configure_tx_dma(void)
+ * @brief		Allocates the DMA channel that moves the TX ring into the USART, one beat per DRE trigger
+ * @note		The descriptor is rewritten for each contiguous span of the ring in SerialTxKick
+ */
+static void configure_tx_dma(void) {
+    struct dma_resource_config config;
+    struct dma_descriptor_config descriptor;
+
+    dma_get_config_defaults(&config);
+    config.peripheral_trigger = SERCOM4_DMAC_ID_TX;
+    config.trigger_action = DMA_TRIGGER_ACTION_BEAT;
+    while (dma_allocate(&txDma, &config) != STATUS_OK) {
+    }
+
+    dma_descriptor_get_config_defaults(&descriptor);
+    descriptor.beat_size = DMA_BEAT_SIZE_BYTE;
+    descriptor.dst_increment_enable = false;
+    descriptor.block_transfer_count = 1;
+    descriptor.source_address = (uint32_t) txBuffer + 1;
+    descriptor.destination_address = (uint32_t) (&usart_instance.hw->USART.DATA.reg);
+    dma_descriptor_create(&txDescriptor, &descriptor);
+    dma_add_descriptor(&txDma, &txDescriptor);
+
+    dma_register_callback(&txDma, usart_tx_dma_callback, DMA_CALLBACK_TRANSFER_DONE);
+    dma_enable_callback(&txDma, DMA_CALLBACK_TRANSFER_DONE);
+}
+
+/**
+ * @fn			static void configure_rx_dma(void)
+ * @brief		Allocates the DMA channel that fills rxCharacterBuffer as a ring in transfer mode
+ * @note		The descriptor links to itself, so the channel runs until it is aborted
+ */
+static void configure_rx_dma(void) {
+    struct dma_resource_config config;
+    struct dma_descriptor_config descriptor;
+
+    dma_get_config_defaults(&config);
+    config.peripheral_trigger = SERCOM4_DMAC_ID_RX;
+    config.trigger_action = DMA_TRIGGER_ACTION_BEAT;
+    while (dma_allocate(&rxDma, &config) != STATUS_OK) {
+    }
+
+    dma_descriptor_get_config_defaults(&descriptor);
+    descriptor.beat_size = DMA_BEAT_SIZE_BYTE;
+    descriptor.src_increment_enable = false;
+    descriptor.block_action = DMA_BLOCK_ACTION_NOACT;
+    descriptor.block_transfer_count = RX_BUFFER_SIZE;
+    descriptor.source_address = (uint32_t) (&usart_instance.hw->USART.DATA.reg);
+    descriptor.destination_address = (uint32_t) rxCharacterBuffer + RX_BUFFER_SIZE;  // End address when the destination increments
+    descriptor.next_descriptor_address = (uint32_t) &rxDescriptor;
+    dma_descriptor_create(&rxDescriptor, &descriptor);
+    dma_add_descriptor(&rxDma, &rxDescriptor);
+}
+
+/**
+ * @fn			static uint16_t SerialRxDmaPosition(void)
+ * @brief		Index in rxCharacterBuffer the RX DMA writes next
+ * @details		The write-back BTCNT is only up to date while the channel is suspended, so the channel is suspended
+ *				for the read. The USART holds received characters meanwhile, nothing is lost.
+ * @return		Write index, 0 to RX_BUFFER_SIZE - 1
+ * @note
+ */
+static uint16_t SerialRxDmaPosition(void) {
+    DmacDescriptor *writeBack = (DmacDescriptor *) DMAC->WRBADDR.reg;
+    uint16_t remaining;
+
+    system_interrupt_enter_critical_section();
+    DMAC->CHID.reg = DMAC_CHID_ID(rxDma.channel_id);
+    DMAC->CHCTRLB.reg |= DMAC_CHCTRLB_CMD_SUSPEND;
+    for (uint8_t tries = 0; tries < SERIAL_RX_SUSPEND_TRIES && !(DMAC->CHINTFLAG.reg & DMAC_CHINTFLAG_SUSP); tries++) {
+    }
+    remaining = writeBack[rxDma.channel_id].BTCNT.reg;
+    DMAC->CHINTFLAG.reg = DMAC_CHINTFLAG_SUSP;
+    DMAC->CHCTRLB.reg |= DMAC_CHCTRLB_CMD_RESUME;
+    system_interrupt_leave_critical_section();
+
+    return (RX_BUFFER_SIZE - remaining) % RX_BUFFER_SIZE;
+}
+
+/**
+ * @fn			static void SerialTxKick(void)
+ * @brief		Starts a DMA transfer of the oldest contiguous span of the TX ring, unless one is running
+ * @note		Call with interrupts disabled, or from the DMA callback
+ */
+static void SerialTxKick(void) {
+    struct dma_descriptor_config descriptor;
+    uint16_t used = txHead - txTail;
+    uint16_t start = txTail & TX_BUFFER_MASK;
+
+    if (txDmaBusy || txPaused || used == 0) {
+        return;
+    }
+    txDmaLen = (used < TX_BUFFER_SIZE - start) ? used : TX_BUFFER_SIZE - start;
+
+    dma_descriptor_get_config_defaults(&descriptor);
+    descriptor.beat_size = DMA_BEAT_SIZE_BYTE;
+    descriptor.dst_increment_enable = false;
+    descriptor.block_transfer_count = txDmaLen;
+    descriptor.source_address = (uint32_t) &txBuffer[start] + txDmaLen;  // End address when the source increments
+    descriptor.destination_address = (uint32_t) (&usart_instance.hw->USART.DATA.reg);
+    dma_descriptor_create(&txDescriptor, &descriptor);
+
+    txDmaBusy = true;
+    dma_start_transfer_job(&txDma);
+}
+
+/**
+ * @fn			static uint16_t SerialTxFree(void)
+ * @brief		Free space in the TX ring
+ * @return		Bytes that can be written past txHead
+ * @note		Only grows while the caller holds the ring, the DMA callback only moves txTail
+ */
+static uint16_t SerialTxFree(void) { return TX_BUFFER_SIZE - (uint16_t) (txHead - txTail); }
+
+/**
+ * @fn			static void SerialTxPublish(uint16_t head)
+ * @brief		Hands the bytes written up to head to the DMA
+ * @param[in]	head New write index
+ * @note
+ */
+static void SerialTxPublish(uint16_t head) {
+    taskENTER_CRITICAL();
+    txHead = head;
+    SerialTxKick();
+    taskEXIT_CRITICAL();
+}
+
+/**
+ * @fn			static bool SerialStreamWrite(uint8_t type, const void *payload, uint16_t len)
+ * @brief		Encodes a whole frame into the TX ring and publishes it, or drops it if it does not fit
+ * @param[in]	type Frame type
+ * @param[in]	payload Frame payload
+ * @param[in]	len Payload length
+ * @return		true if the frame was queued
+ * @note		Call with the scheduler suspended. The sequence number also advances for dropped frames.
+ */
+static bool SerialStreamWrite(uint8_t type, const void *payload, uint16_t len) {
+    const uint8_t *bytes = (const uint8_t *) payload;
+    uint8_t header[SERIAL_STREAM_HEADER_SIZE] = {type, streamSeq++};
+    struct SerialCobs cobs;
+    crc32_t crc;
+
+    if (SERIAL_FRAME_ENCODED_SIZE(len) > SerialTxFree()) {
+        streamDropped++;
+        return false;
+    }
+
+    crc32_calculate(header, sizeof(header), &crc);
+    crc32_recalculate(bytes, len, &crc);
+
+    SerialCobsBegin(&cobs, txBuffer, TX_BUFFER_MASK, txHead);
+    for (uint8_t i = 0; i < sizeof(header); i++) {
+        SerialCobsPut(&cobs, header[i]);
+    }
+    for (uint16_t i = 0; i < len; i++) {
+        SerialCobsPut(&cobs, bytes[i]);
+    }
+    for (uint8_t i = 0; i < SERIAL_STREAM_CRC_SIZE; i++) {
+        SerialCobsPut(&cobs, (uint8_t) (crc >> (8 * i)));
+    }
+    SerialTxPublish(SerialCobsEnd(&cobs));
+    return true;
+}
+
 /******************************************************************************
  * Callback Functions
  ******************************************************************************/
@@ -245,15 +641,14 @@ void usart_read_callback(struct usart_module *const usart_module) {
 }
 
 /**
- * @fn			void usart_write_callback(struct usart_module *const usart_module)
- * @brief		Callback called when the system finishes sending all the bytes requested from a UART read job
+ * @fn			static void usart_tx_dma_callback(struct dma_resource *const resource)
+ * @brief		Callback called when the DMA finished sending a span of the TX ring. Starts the next span.
  * @note
  */
-void usart_write_callback(struct usart_module *const usart_module) {
-    if (circular_buf_get(cbufTx, (uint8_t *) &latestTx) != -1)   // Only continue if there are more characters to send
-    {
-        usart_write_buffer_job(&usart_instance, (uint8_t *) &latestTx, 1);
-    }
+static void usart_tx_dma_callback(struct dma_resource *const resource) {
+    txTail += txDmaLen;
+    txDmaBusy = false;
+    SerialTxKick();
 }
 
 struct usart_module *GetUsartModule(void) { return &usart_instance; }
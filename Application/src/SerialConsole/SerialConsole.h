@@ -35,12 +35,15 @@ extern "C" {
 #include <asf.h>
 #include <stdarg.h>
 
+#include "SerialConsole/SerialFrame.h"
 #include "circular_buffer.h"
 #include "string.h"
 
 /******************************************************************************
  * Defines
  ******************************************************************************/
+#define SERIAL_CONSOLE_BAUDRATE 115200     ///< Baud rate of the text console
+#define SERIAL_STREAM_DEFAULT_BAUD 921600  ///< Stream baud rate when the "stream" command does not give one
 
 /******************************************************************************
  * Structures and Enumerations
@@ -55,12 +58,38 @@ enum eDebugLogLevels {
     N_DEBUG_LEVELS = 6    // Max number of log levels
 };
 
+/// Type byte of a stream frame
+enum eSerialStreamType {
+    SERIAL_STREAM_LOG = 0,      // Console text, not NUL terminated
+    SERIAL_STREAM_CAPTURE = 1,  // Block of captured IMU samples
+    SERIAL_STREAM_EVENT = 2,    // One decoded bus transaction
+    SERIAL_STREAM_TRANSFER = 3,  // File transfer message, both directions (see SerialTransfer.h)
+    SERIAL_STREAM_CAPTURE_PACKED = 4,  // Block of captured IMU samples, compressed (see CaptureCodec.h)
+    SERIAL_STREAM_EVENT_TEMPLATE = 5,  // Bus transaction stored in a dictionary slot (see EventDedup.h)
+    SERIAL_STREAM_EVENT_REPEAT = 6     // Bus transaction as the differences to a dictionary slot
+};
+
+/// What the console UART carries
+enum eSerialMode {
+    SERIAL_MODE_TEXT = 0,  // CLI and logs as text, one RX interrupt per character
+    SERIAL_MODE_STREAM,    // Frames out (logs, captures, events), CLI text in
+    SERIAL_MODE_TRANSFER   // Frames both ways, RX by DMA
+};
+
 /******************************************************************************
  * Global Function Declarations
  ******************************************************************************/
 void InitializeSerialConsole(void);
 void DeinitializeSerialConsole(void);
 void SerialConsoleWriteString(const char *string);
+bool SerialConsoleStreamFrame(enum eSerialStreamType type, const void *payload, uint16_t len);
+bool SerialConsoleIsStreaming(void);
+uint32_t SerialConsoleStreamDropped(void);
+uint16_t SerialConsoleTxFree(void);
+uint32_t SerialConsoleGetBaudrate(void);
+enum eSerialMode SerialConsoleGetMode(void);
+void SerialConsoleSetMode(enum eSerialMode mode, uint32_t baudrate);
+int16_t SerialConsoleReadFrame(uint8_t *frame, uint16_t size, uint32_t timeoutMs);
 int SerialConsoleReadCharacter(uint8_t *rxChar);
 void LogMessage(enum eDebugLogLevels level, const char *format, ...);
 void setLogLevel(enum eDebugLogLevels debugLevel);
@@ -0,0 +1,121 @@
+/**************************************************************************/ /**
+ * @file      SerialFrame.c
+ * @brief     COBS framing of the UART stream and transfer modes: [type][seq][payload][CRC-32 LE], COBS encoded and
+ *            ended by a 0x00 delimiter. No hardware access, so the host tests build it as is.
+ * @details   The encoder writes straight into the console TX ring, one byte at a time, so a frame never needs a
+ *            second buffer. The decoder takes the bytes collected up to a delimiter and checks the CRC.
+ * @date      2026-10-19
+
+ ******************************************************************************/
+
+/******************************************************************************
+ * Includes
+ ******************************************************************************/
+#include "SerialConsole/SerialFrame.h"
+
+#include <crc32.h>
+
+/******************************************************************************
+ * Global Functions
+ ******************************************************************************/
+
+/**
+ * @fn			void SerialCobsBegin(struct SerialCobs *cobs, uint8_t *ring, uint16_t mask, uint16_t start)
+ * @brief		Starts encoding a frame into ring at start
+ * @param[out]	cobs Encoder state
+ * @param[in]	ring Output ring
+ * @param[in]	mask Ring size - 1, the size being a power of two
+ * @param[in]	start Free running index the frame starts at
+ * @note
+ */
+void SerialCobsBegin(struct SerialCobs *cobs, uint8_t *ring, uint16_t mask, uint16_t start)
+{
+    cobs->ring = ring;
+    cobs->mask = mask;
+    cobs->codePos = start;
+    cobs->pos = start + 1;
+    cobs->code = 1;
+}
+
+/**
+ * @fn			void SerialCobsPut(struct SerialCobs *cobs, uint8_t byte)
+ * @brief		COBS encodes one byte
+ * @param[in]	cobs Encoder state
+ * @param[in]	byte Byte to encode
+ * @note		A block is closed on a zero byte or after 254 data bytes
+ */
+void SerialCobsPut(struct SerialCobs *cobs, uint8_t byte)
+{
+    if (byte != 0) {
+        cobs->ring[(cobs->pos++) & cobs->mask] = byte;
+        cobs->code++;
+    }
+    if (byte == 0 || cobs->code == 0xFF) {
+        cobs->ring[cobs->codePos & cobs->mask] = cobs->code;
+        cobs->codePos = cobs->pos++;
+        cobs->code = 1;
+    }
+}
+
+/**
+ * @fn			uint16_t SerialCobsEnd(struct SerialCobs *cobs)
+ * @brief		Closes the last block and writes the frame delimiter
+ * @param[in]	cobs Encoder state
+ * @return		Free running index just past the delimiter
+ * @note		At most SERIAL_FRAME_ENCODED_SIZE of the unencoded length was written since SerialCobsBegin
+ */
+uint16_t SerialCobsEnd(struct SerialCobs *cobs)
+{
+    cobs->ring[cobs->codePos & cobs->mask] = cobs->code;
+    cobs->ring[(cobs->pos++) & cobs->mask] = 0x00;
+    return cobs->pos;
+}
+
+/**
+ * @fn			int16_t SerialFrameDecode(const uint8_t *encoded, uint16_t len, uint8_t *frame, uint16_t size)
+ * @brief		COBS decodes one frame and checks its CRC
+ * @param[in]	encoded Bytes received up to, not including, the delimiter
+ * @param[in]	len Number of encoded bytes
+ * @param[out]	frame Decoded frame, CRC included
+ * @param[in]	size Size of frame
+ * @return		Length without the CRC, 0 for an empty frame, -1 if the frame is damaged or does not fit
+ * @note
+ */
+int16_t SerialFrameDecode(const uint8_t *encoded, uint16_t len, uint8_t *frame, uint16_t size)
+{
+    uint16_t in = 0, out = 0;
+    crc32_t crc;
+
+    if (len == 0) {
+        return 0;
+    }
+    while (in < len) {
+        uint8_t code = encoded[in++];
+        if (code == 0x00) {
+            return -1;  // A delimiter cannot be inside a frame
+        }
+        for (uint8_t i = 1; i < code; i++) {
+            if (in >= len || out >= size) {
+                return -1;
+            }
+            frame[out++] = encoded[in++];
+        }
+        if (code != 0xFF && in < len) {
+            if (out >= size) {
+                return -1;
+            }
+            frame[out++] = 0x00;
+        }
+    }
+    if (out < SERIAL_STREAM_HEADER_SIZE + SERIAL_STREAM_CRC_SIZE) {
+        return -1;
+    }
+    out -= SERIAL_STREAM_CRC_SIZE;
+    crc32_calculate(frame, out, &crc);
+    for (uint8_t i = 0; i < SERIAL_STREAM_CRC_SIZE; i++) {
+        if (frame[out + i] != (uint8_t)(crc >> (8 * i))) {
+            return -1;
+        }
+    }
+    return out;
+}
@@ -0,0 +1,53 @@
+/**************************************************************************/ /**
+ * @file      SerialFrame.h
+ * @brief     COBS framing of the UART stream and transfer modes: [type][seq][payload][CRC-32 LE], COBS encoded and
+ *            ended by a 0x00 delimiter. No hardware access, so the host tests build it as is.
+ * @date      2026-10-19
+
+ ******************************************************************************/
+
+#pragma once
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************************************************************************
+ * Includes
+ ******************************************************************************/
+#include <stdint.h>
+
+/******************************************************************************
+ * Defines
+ ******************************************************************************/
+#define SERIAL_STREAM_MAX_PAYLOAD 256      ///< Largest payload of one stream frame
+#define SERIAL_STREAM_HEADER_SIZE 2        ///< Type and sequence number
+#define SERIAL_STREAM_CRC_SIZE 4           ///< CRC-32 (IEEE 802.3) over header and payload, little endian
+#define SERIAL_FRAME_MAX_SIZE (SERIAL_STREAM_HEADER_SIZE + SERIAL_STREAM_MAX_PAYLOAD + SERIAL_STREAM_CRC_SIZE)
+/// Worst case TX ring space of a frame with len payload bytes: one COBS code byte per 254, the first one and the delimiter
+#define SERIAL_FRAME_ENCODED_SIZE(len) \
+    ((SERIAL_STREAM_HEADER_SIZE + (len) + SERIAL_STREAM_CRC_SIZE) + (SERIAL_STREAM_HEADER_SIZE + (len) + SERIAL_STREAM_CRC_SIZE) / 254 + 2)
+
+/******************************************************************************
+ * Structures and Enumerations
+ ******************************************************************************/
+
+/// Incremental COBS encoder writing into a power of two ring
+struct SerialCobs {
+    uint8_t *ring;     ///< Ring the encoded bytes go to
+    uint16_t mask;     ///< Ring size - 1
+    uint16_t pos;      ///< Free running index of the next data byte
+    uint16_t codePos;  ///< Free running index of the code byte of the current block
+    uint8_t code;      ///< Data bytes in the current block + 1
+};
+
+/******************************************************************************
+ * Global Function Declaration
+ ******************************************************************************/
+void SerialCobsBegin(struct SerialCobs *cobs, uint8_t *ring, uint16_t mask, uint16_t start);
+void SerialCobsPut(struct SerialCobs *cobs, uint8_t byte);
+uint16_t SerialCobsEnd(struct SerialCobs *cobs);
+int16_t SerialFrameDecode(const uint8_t *encoded, uint16_t len, uint8_t *frame, uint16_t size);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,474 @@
+/**************************************************************************/ /**
+ * @file      SerialTransfer.c
+ * @brief     File transfer between the SD card and a host over the console UART. Runs the sliding window protocol
+ *            carried in SERIAL_STREAM_TRANSFER frames while the console is in transfer mode.
+ * @details   The "xfer" CLI command switches the console to transfer mode and runs SerialTransferRun in the CLI
+ *            task until the host sends QUIT or stays silent for XFER_IDLE_TIMEOUT_MS.
+ *
+ *            Both directions are go-back-N on byte offsets. The receiver only takes DATA at the offset it expects
+ *            and answers with a cumulative ACK; anything else is dropped and re-acknowledged, and the sender resends
+ *            from the acknowledged offset. Uploads are acknowledged once the RX ring is drained or every half
+ *            window, the host keeps at most XFER_RX_WINDOW bytes in flight so the DMA RX ring cannot overrun while
+ *            the SD card is busy. Downloads keep XFER_TX_WINDOW bytes in flight and resend after XFER_RTO_MS
+ *            without progress. The CRC-32 of the whole file is checked at the end.
+ *
+ *            An upload is written to XFER_TEMP_NAME and only renamed over the target once DONE matched its size and
+ *            CRC, so an aborted or damaged upload never costs the file it was meant to replace.
+ * @date      2026-10-19
+
+ ******************************************************************************/
+
+/******************************************************************************
+ * Includes
+ ******************************************************************************/
+#include "SerialTransfer/SerialTransfer.h"
+
+#include <crc32.h>
+#include <string.h>
+#include <strings.h>
+
+#include "CaptureCatalog/CaptureCatalog.h"
+#include "CaptureFile/CaptureFile.h"
+#include "FreeRTOS.h"
+#include "SerialConsole.h"
+#include "SysInit/SysInit.h"
+#include "ff.h"
+#include "task.h"
+
+/******************************************************************************
+ * Defines
+ ******************************************************************************/
+#define XFER_MSG_SIZE (1 + 4 + XFER_CHUNK)  ///< Largest message: DATA with a full chunk
+#define XFER_TEMP_NAME "xfer.tmp"           ///< Upload in progress, in the root directory
+
+#if XFER_MSG_SIZE > SERIAL_STREAM_MAX_PAYLOAD
+#error "XFER_CHUNK does not fit in a stream frame"
+#endif
+
+/******************************************************************************
+ * Structures and Enumerations
+ ******************************************************************************/
+
+/// Upload in progress
+struct XferUpload {
+    bool active;
+    uint32_t expected;   ///< Offset of the next byte to write
+    uint32_t unacked;    ///< Bytes written since the last ACK
+    bool gapAcked;       ///< An ACK was already sent for the current gap
+    crc32_t crc;         ///< CRC of the bytes written so far
+    uint32_t start;      ///< FAT timestamp of the PUT, for the catalog
+};
+
+/******************************************************************************
+ * Variables
+ ******************************************************************************/
+static FIL xferFile;
+static char xferPath[2 + XFER_MAX_NAME + 1];        ///< Drive prefix, name, terminator
+/// Received frame and message being sent. A message is copied into the TX ring before the next frame is read.
+static union {
+    uint8_t rx[SERIAL_FRAME_MAX_SIZE];
+    uint8_t tx[XFER_MSG_SIZE];
+} xferBuf;
+static struct XferUpload xferUpload;
+
+/******************************************************************************
+ * Forward Declarations
+ ******************************************************************************/
+static void XferSend(const uint8_t *msg, uint16_t len);
+static void XferSendResult(enum eXferStatus status, uint32_t value);
+static void XferSendAck(uint32_t offset);
+static uint32_t XferGet32(const uint8_t *buf);
+static void XferPut32(uint8_t *buf, uint32_t value);
+static bool XferOpen(const uint8_t *name, uint16_t len, BYTE mode);
+static void XferTempPath(char *path);
+static void XferUploadAbort(void);
+static void XferUploadData(const uint8_t *msg, uint16_t len);
+static void XferUploadDone(const uint8_t *msg, uint16_t len);
+static void XferDownload(void);
+
+/******************************************************************************
+ * Global Functions
+ ******************************************************************************/
+
+/**
+ * @fn			void SerialTransferRun(uint32_t baudrate)
+ * @brief		Switches the console to transfer mode and serves the host until it quits or goes silent
+ * @param[in]	baudrate Transfer baud rate
+ * @note		Runs in the calling (CLI) task. The console is back in text mode at the console baud rate on return.
+ */
+void SerialTransferRun(uint32_t baudrate)
+{
+    int16_t len;
+    bool quit = false;
+
+    SerialConsoleSetMode(SERIAL_MODE_TRANSFER, baudrate);
+    if (SerialConsoleGetMode() != SERIAL_MODE_TRANSFER) {
+        return;
+    }
+    memset(&xferUpload, 0, sizeof(xferUpload));
+
+    while (!quit) {
+        // With an ACK owed, only look at what already arrived; once the ring is drained the ACK goes out
+        len = SerialConsoleReadFrame(xferBuf.rx, sizeof(xferBuf.rx), xferUpload.unacked > 0 ? 0 : XFER_IDLE_TIMEOUT_MS);
+        if (len == 0) {
+            if (xferUpload.unacked > 0) {
+                XferSendAck(xferUpload.expected);
+                continue;
+            }
+            break;  // Idle timeout
+        }
+        if (len < SERIAL_STREAM_HEADER_SIZE + 1 || xferBuf.rx[0] != SERIAL_STREAM_TRANSFER) {
+            continue;  // Damaged frame or not a transfer message
+        }
+
+        const uint8_t *msg = &xferBuf.rx[SERIAL_STREAM_HEADER_SIZE];
+        uint16_t msgLen = len - SERIAL_STREAM_HEADER_SIZE;
+        switch (msg[0]) {
+            case XFER_OP_PUT:
+                XferUploadAbort();
+                if (XferOpen(&msg[1], msgLen - 1, FA_CREATE_ALWAYS | FA_WRITE)) {
+                    xferUpload.active = true;
+                    xferUpload.crc = 0;
+                    xferUpload.start = get_fattime();
+                    XferSendResult(XFER_OK, XFER_RX_WINDOW);
+                }
+                break;
+
+            case XFER_OP_GET:
+                XferUploadAbort();
+                if (XferOpen(&msg[1], msgLen - 1, FA_OPEN_EXISTING | FA_READ)) {
+                    XferDownload();
+                    CaptureFileClose(&xferFile);
+                }
+                break;
+
+            case XFER_OP_DATA:
+                XferUploadData(msg, msgLen);
+                break;
+
+            case XFER_OP_DONE:
+                XferUploadDone(msg, msgLen);
+                break;
+
+            case XFER_OP_QUIT:
+                XferUploadAbort();
+                XferSendResult(XFER_OK, 0);
+                quit = true;
+                break;
+
+            default:
+                break;
+        }
+    }
+
+    XferUploadAbort();
+    SerialConsoleSetMode(SERIAL_MODE_TEXT, SERIAL_CONSOLE_BAUDRATE);
+}
+
+/******************************************************************************
+ * Local Functions
+ ******************************************************************************/
+
+/**
+ * @fn			static void XferSend(const uint8_t *msg, uint16_t len)
+ * @brief		Sends a transfer message, waiting for room in the TX ring instead of dropping it
+ * @param[in]	msg Message
+ * @param[in]	len Message length
+ * @note
+ */
+static void XferSend(const uint8_t *msg, uint16_t len)
+{
+    while (SerialConsoleTxFree() < SERIAL_FRAME_ENCODED_SIZE(len)) {
+        vTaskDelay(1);
+    }
+    SerialConsoleStreamFrame(SERIAL_STREAM_TRANSFER, msg, len);
+}
+
+/**
+ * @fn			static void XferSendResult(enum eXferStatus status, uint32_t value)
+ * @brief		Sends a RESULT message
+ * @param[in]	status Outcome of the request
+ * @param[in]	value Window, file size or FRESULT, depending on the request
+ * @note
+ */
+static void XferSendResult(enum eXferStatus status, uint32_t value)
+{
+    uint8_t msg[6] = {XFER_OP_RESULT, status};
+    XferPut32(&msg[2], value);
+    XferSend(msg, sizeof(msg));
+}
+
+/**
+ * @fn			static void XferSendAck(uint32_t offset)
+ * @brief		Acknowledges every upload byte before offset
+ * @param[in]	offset Next byte expected
+ * @note
+ */
+static void XferSendAck(uint32_t offset)
+{
+    uint8_t msg[5] = {XFER_OP_ACK};
+    XferPut32(&msg[1], offset);
+    XferSend(msg, sizeof(msg));
+    xferUpload.unacked = 0;
+}
+
+/**
+ * @fn			static uint32_t XferGet32(const uint8_t *buf)
+ * @brief		Reads a little endian 32-bit field
+ * @note
+ */
+static uint32_t XferGet32(const uint8_t *buf)
+{
+    return (uint32_t)buf[0] | ((uint32_t)buf[1] << 8) | ((uint32_t)buf[2] << 16) | ((uint32_t)buf[3] << 24);
+}
+
+/**
+ * @fn			static void XferPut32(uint8_t *buf, uint32_t value)
+ * @brief		Writes a little endian 32-bit field
+ * @note
+ */
+static void XferPut32(uint8_t *buf, uint32_t value)
+{
+    for (uint8_t i = 0; i < 4; i++) {
+        buf[i] = (uint8_t)(value >> (8 * i));
+    }
+}
+
+/**
+ * @fn			static bool XferOpen(const uint8_t *name, uint16_t len, BYTE mode)
+ * @brief		Opens a file on the SD card for a PUT or GET request. Sends the error RESULT itself. Files read for a GET
+ *				are opened with CaptureFileOpen so resumed downloads seek with a cluster link map. A PUT opens
+ *				the temporary file; xferPath holds the target either way.
+ * @param[in]	name File name from the request, without drive prefix or terminator
+ * @param[in]	len Name length
+ * @param[in]	mode FatFs open mode
+ * @return		true if xferFile is open
+ * @note
+ */
+static bool XferOpen(const uint8_t *name, uint16_t len, BYTE mode)
+{
+    FRESULT res;
+
+    if (SysInitWaitFor(SYS_INIT_BIT(SYS_INIT_STORAGE), 0) != pdPASS) {
+        XferSendResult(XFER_ERR_STORAGE, 0);
+        return false;
+    }
+    if (len == 0 || len > XFER_MAX_NAME) {
+        XferSendResult(XFER_ERR_FILE, FR_INVALID_NAME);
+        return false;
+    }
+    xferPath[0] = LUN_ID_SD_MMC_0_MEM + '0';
+    xferPath[1] = ':';
+    memcpy(&xferPath[2], name, len);
+    xferPath[2 + len] = '\0';
+
+    if (mode & FA_WRITE) {
+        char temp[2 + sizeof(XFER_TEMP_NAME)];
+        if (strcasecmp(&xferPath[2], XFER_TEMP_NAME) == 0) {
+            XferSendResult(XFER_ERR_FILE, FR_INVALID_NAME);
+            return false;
+        }
+        XferTempPath(temp);
+        res = f_open(&xferFile, temp, mode);
+    } else {
+        res = CaptureFileOpen(&xferFile, xferPath);
+    }
+    if (res != FR_OK) {
+        XferSendResult(XFER_ERR_FILE, res);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @fn			static void XferTempPath(char *path)
+ * @brief		Path of the file an upload is written to until it is verified
+ * @param[out]	path 2 + sizeof(XFER_TEMP_NAME) bytes
+ * @note
+ */
+static void XferTempPath(char *path)
+{
+    path[0] = LUN_ID_SD_MMC_0_MEM + '0';
+    path[1] = ':';
+    memcpy(&path[2], XFER_TEMP_NAME, sizeof(XFER_TEMP_NAME));
+}
+
+/**
+ * @fn			static void XferUploadAbort(void)
+ * @brief		Drops an unfinished upload. The partial temporary file is deleted, the target is not touched.
+ * @note
+ */
+static void XferUploadAbort(void)
+{
+    char temp[2 + sizeof(XFER_TEMP_NAME)];
+
+    if (xferUpload.active) {
+        f_close(&xferFile);
+        XferTempPath(temp);
+        f_unlink(temp);
+    }
+    memset(&xferUpload, 0, sizeof(xferUpload));
+}
+
+/**
+ * @fn			static void XferUploadData(const uint8_t *msg, uint16_t len)
+ * @brief		Writes a DATA message of an upload if it is the next one in order
+ * @param[in]	msg Message
+ * @param[in]	len Message length
+ * @note
+ */
+static void XferUploadData(const uint8_t *msg, uint16_t len)
+{
+    uint32_t offset;
+    UINT written;
+    FRESULT res;
+
+    if (!xferUpload.active || len < 5) {
+        return;
+    }
+    offset = XferGet32(&msg[1]);
+    len -= 5;
+
+    if (offset != xferUpload.expected) {
+        // Resent data (an ACK was lost) or a gap (a frame was lost): tell the host where to continue, once per gap
+        if (offset < xferUpload.expected || !xferUpload.gapAcked) {
+            xferUpload.gapAcked = (offset > xferUpload.expected);
+            XferSendAck(xferUpload.expected);
+        }
+        return;
+    }
+
+    res = f_write(&xferFile, &msg[5], len, &written);
+    if (res != FR_OK || written != len) {
+        XferUploadAbort();
+        XferSendResult(XFER_ERR_FILE, (res != FR_OK) ? res : FR_DENIED);
+        return;
+    }
+    crc32_recalculate(&msg[5], len, &xferUpload.crc);
+    xferUpload.expected += len;
+    xferUpload.unacked += len;
+    xferUpload.gapAcked = false;
+    if (xferUpload.unacked >= XFER_RX_WINDOW / 2) {
+        XferSendAck(xferUpload.expected);
+    }
+}
+
+/**
+ * @fn			static void XferUploadDone(const uint8_t *msg, uint16_t len)
+ * @brief		Finishes an upload. Only if its size and CRC match the host's, the temporary file replaces the target.
+ * @param[in]	msg Message
+ * @param[in]	len Message length
+ * @note
+ */
+static void XferUploadDone(const uint8_t *msg, uint16_t len)
+{
+    char temp[2 + sizeof(XFER_TEMP_NAME)];
+    bool replaced = false;
+    FRESULT res;
+
+    if (!xferUpload.active || len < 9) {
+        XferSendResult(XFER_ERR_STATE, 0);
+        return;
+    }
+    if (XferGet32(&msg[1]) != xferUpload.expected || XferGet32(&msg[5]) != xferUpload.crc) {
+        XferUploadAbort();
+        XferSendResult(XFER_ERR_CRC, 0);
+        return;
+    }
+
+    XferTempPath(temp);
+    res = f_close(&xferFile);
+    if (res == FR_OK) {
+        res = f_unlink(xferPath);
+        replaced = (res == FR_OK);
+        res = (res == FR_NO_FILE) ? FR_OK : res;
+    }
+    if (res == FR_OK) {
+        res = f_rename(temp, xferPath);
+    }
+    if (res != FR_OK) {
+        f_unlink(temp);
+    } else {
+        struct CaptureCatalogRecord rec = {0};
+        rec.start = xferUpload.start;
+        rec.size = xferUpload.expected;
+        rec.crc = xferUpload.crc;
+        rec.flags = CAPTURE_CATALOG_FLAG_CRC;
+        CaptureCatalogAdd(&rec, xferPath, replaced);
+    }
+    memset(&xferUpload, 0, sizeof(xferUpload));
+    XferSendResult((res == FR_OK) ? XFER_OK : XFER_ERR_FILE, res);
+}
+
+/**
+ * @fn			static void XferDownload(void)
+ * @brief		Sends the open xferFile to the host
+ * @details		Up to XFER_TX_WINDOW bytes are sent ahead of the last ACK. Without ACK progress for XFER_RTO_MS the
+ *				file is read again from the acknowledged offset. The CRC is taken the first time each byte is sent.
+ * @note		Returns when the host acknowledged the whole file, on an error, or when the host sends anything
+ *				other than an ACK (for example QUIT), which is then dropped.
+ */
+static void XferDownload(void)
+{
+    uint32_t size = f_size(&xferFile);
+    uint32_t base = 0;     // Acknowledged by the host
+    uint32_t next = 0;     // Next offset to send
+    uint32_t highest = 0;  // End of what was sent at least once, CRC covers up to here
+    uint8_t retries = 0;
+    crc32_t crc = 0;
+    TickType_t progress = xTaskGetTickCount();
+    int16_t len;
+    UINT count;
+    FRESULT res;
+
+    XferSendResult(XFER_OK, size);
+
+    while (base < size) {
+        while (next < size && next - base < XFER_TX_WINDOW) {
+            if ((res = CaptureFileSeek(&xferFile, next)) != FR_OK) {
+                XferSendResult(XFER_ERR_FILE, res);
+                return;
+            }
+            res = f_read(&xferFile, &xferBuf.tx[5], XFER_CHUNK, &count);
+            if (res != FR_OK || count == 0) {
+                XferSendResult(XFER_ERR_FILE, (res != FR_OK) ? res : FR_DISK_ERR);
+                return;
+            }
+            if (next + count > highest) {
+                crc32_recalculate(&xferBuf.tx[5 + (highest - next)], next + count - highest, &crc);
+                highest = next + count;
+            }
+            xferBuf.tx[0] = XFER_OP_DATA;
+            XferPut32(&xferBuf.tx[1], next);
+            XferSend(xferBuf.tx, 5 + count);
+            next += count;
+        }
+
+        len = SerialConsoleReadFrame(xferBuf.rx, sizeof(xferBuf.rx), XFER_RTO_MS);
+        if (len > SERIAL_STREAM_HEADER_SIZE && xferBuf.rx[0] == SERIAL_STREAM_TRANSFER) {
+            const uint8_t *msg = &xferBuf.rx[SERIAL_STREAM_HEADER_SIZE];
+            if (msg[0] != XFER_OP_ACK || len < SERIAL_STREAM_HEADER_SIZE + 5) {
+                return;
+            }
+            uint32_t acked = XferGet32(&msg[1]);
+            if (acked > base && acked <= next) {
+                base = acked;
+                retries = 0;
+                progress = xTaskGetTickCount();
+            }
+        }
+        if ((xTaskGetTickCount() - progress) >= pdMS_TO_TICKS(XFER_RTO_MS)) {
+            if (++retries > XFER_MAX_RETRIES) {
+                XferSendResult(XFER_ERR_TIMEOUT, base);
+                return;
+            }
+            next = base;  // Go back N
+            progress = xTaskGetTickCount();
+        }
+    }
+
+    xferBuf.tx[0] = XFER_OP_DONE;
+    XferPut32(&xferBuf.tx[1], size);
+    XferPut32(&xferBuf.tx[5], crc);
+    XferSend(xferBuf.tx, 9);
+}
@@ -0,0 +1,63 @@
+/**************************************************************************/ /**
+ * @file      SerialTransfer.h
+ * @brief     File transfer between the SD card and a host over the console UART. Runs the sliding window protocol
+ *            carried in SERIAL_STREAM_TRANSFER frames while the console is in transfer mode.
+ * @date      2026-10-19
+
+ ******************************************************************************/
+
+#pragma once
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************************************************************************
+ * Includes
+ ******************************************************************************/
+#include <stdint.h>
+
+/******************************************************************************
+ * Defines
+ ******************************************************************************/
+#define XFER_DEFAULT_BAUD 921600   ///< Transfer baud rate when the "xfer" command does not give one
+#define XFER_CHUNK 240             ///< File bytes carried by one DATA message
+#define XFER_RX_WINDOW 480         ///< Unacknowledged bytes the host may send. Kept below the DMA RX ring size
+#define XFER_TX_WINDOW (4 * XFER_CHUNK)  ///< Unacknowledged bytes the device sends before waiting for an ACK
+#define XFER_RTO_MS 200            ///< Time without ACK progress after which the device resends from the last ACK
+#define XFER_MAX_RETRIES 10        ///< Resends without progress before a download is given up
+#define XFER_IDLE_TIMEOUT_MS 30000 ///< Silence after which transfer mode ends on its own
+#define XFER_MAX_NAME 48           ///< Longest file name, without the drive prefix
+
+/******************************************************************************
+ * Structures and Enumerations
+ ******************************************************************************/
+
+/// First payload byte of a SERIAL_STREAM_TRANSFER frame. Multi-byte fields are little endian.
+enum eXferOp {
+    XFER_OP_PUT = 1,     ///< Host: name. Upload to the SD card, replaces the file after DONE. Answered by RESULT (value = window)
+    XFER_OP_GET = 2,     ///< Host: name. Download from the SD card. Answered by RESULT (value = size), then DATA
+    XFER_OP_DATA = 3,    ///< Either: offset (4), bytes
+    XFER_OP_ACK = 4,     ///< Either: offset (4) of the next byte expected, everything before it was received
+    XFER_OP_DONE = 5,    ///< Sender: size (4), CRC-32 of the file (4). Upload: answered by RESULT
+    XFER_OP_RESULT = 6,  ///< Device: status (1), value (4)
+    XFER_OP_QUIT = 7     ///< Host: leave transfer mode. Answered by RESULT
+};
+
+/// Status byte of XFER_OP_RESULT
+enum eXferStatus {
+    XFER_OK = 0,
+    XFER_ERR_STATE,    ///< Message not expected now
+    XFER_ERR_STORAGE,  ///< SD card not mounted
+    XFER_ERR_FILE,     ///< FatFs error, value holds the FRESULT
+    XFER_ERR_CRC,      ///< Upload size or CRC does not match, the upload was discarded and an existing file kept
+    XFER_ERR_TIMEOUT   ///< Download given up after XFER_MAX_RETRIES
+};
+
+/******************************************************************************
+ * Global Function Declaration
+ ******************************************************************************/
+void SerialTransferRun(uint32_t baudrate);
+
+#ifdef __cplusplus
+}
+#endif
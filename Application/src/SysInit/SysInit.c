@@ -0,0 +1,170 @@
+/**************************************************************************/ /**
+ * @file      SysInit.c
+ * @brief     Dependency aware subsystem bring-up. Each subsystem waits only for its own prerequisites, so capture and
+ *            storage come up without waiting behind the network. Records a boot timeline.
+ * @date      2026-10-19
+
+ ******************************************************************************/
+
+/******************************************************************************
+ * Includes
+ ******************************************************************************/
+#include "SysInit/SysInit.h"
+
+#include <stdio.h>
+
+#include "SerialConsole.h"
+#include "task.h"
+
+/******************************************************************************
+ * Structures and Enumerations
+ ******************************************************************************/
+
+/// Static description of a subsystem
+struct SysInitEntry {
+    const char *name;
+    EventBits_t prerequisites;  ///< Subsystems that must be ready before this one starts
+};
+
+/// Boot timeline of a subsystem, in ticks since SysInitInitialize
+struct SysInitRecord {
+    TickType_t start;
+    TickType_t ready;
+};
+
+/******************************************************************************
+ * Variables
+ ******************************************************************************/
+
+/// Init graph. Keep prerequisites short: anything listed here delays the subsystem that waits for it.
+static const struct SysInitEntry sysInitTable[SYS_INIT_COUNT] = {
+    [SYS_INIT_I2C] = {"I2C", 0},
+    [SYS_INIT_STORAGE] = {"STORAGE", 0},
+    [SYS_INIT_CAPTURE] = {"CAPTURE", SYS_INIT_BIT(SYS_INIT_I2C)},
+    [SYS_INIT_CLI] = {"CLI", 0},
+    [SYS_INIT_NETWORK] = {"NETWORK", 0},
+    [SYS_INIT_MQTT] = {"MQTT", SYS_INIT_BIT(SYS_INIT_NETWORK)},
+};
+
+static EventGroupHandle_t sysInitEvents = NULL;          ///< One bit per subsystem, set when it is ready
+static TickType_t sysInitEpoch = 0;                      ///< Tick count when SysInitInitialize was called
+static struct SysInitRecord sysInitRecord[SYS_INIT_COUNT];  ///< Written only by the task that owns the subsystem
+static volatile EventBits_t sysInitStarted = 0;          ///< Subsystems that have called SysInitStart
+
+/******************************************************************************
+ * Global Functions
+ ******************************************************************************/
+
+/**
+ * @fn		void SysInitInitialize(void)
+ * @brief	Creates the init event group. Must be called before any task that uses SysInitStart is created.
+ */
+void SysInitInitialize(void)
+{
+    sysInitEvents = xEventGroupCreate();
+    if (sysInitEvents == NULL) {
+        SerialConsoleWriteString("ERR: Could not create init event group!\r\n");
+    }
+    sysInitEpoch = xTaskGetTickCount();
+}
+
+/**
+ * @fn		BaseType_t SysInitStart(enum SysInitId id, TickType_t timeout)
+ * @brief	Blocks until all prerequisites of a subsystem are ready, then records its start time
+ * @param	id Subsystem that is about to initialize
+ * @param	timeout Ticks to wait for the prerequisites
+ * @return	pdPASS if all prerequisites are ready, pdFAIL on timeout
+ */
+BaseType_t SysInitStart(enum SysInitId id, TickType_t timeout)
+{
+    if (SysInitWaitFor(sysInitTable[id].prerequisites, timeout) != pdPASS) {
+        LogMessage(LOG_ERROR_LVL, "init: %s prerequisites not ready\r\n", sysInitTable[id].name);
+        return pdFAIL;
+    }
+    sysInitRecord[id].start = xTaskGetTickCount() - sysInitEpoch;
+    taskENTER_CRITICAL();
+    sysInitStarted |= SYS_INIT_BIT(id);
+    taskEXIT_CRITICAL();
+    return pdPASS;
+}
+
+/**
+ * @fn		void SysInitReady(enum SysInitId id)
+ * @brief	Marks a subsystem as ready and wakes everything that depends on it
+ * @param	id Subsystem that finished initializing
+ * @note	Only the first call is recorded, so it is safe to call again after a reconnect.
+ */
+void SysInitReady(enum SysInitId id)
+{
+    if (sysInitEvents == NULL || (xEventGroupGetBits(sysInitEvents) & SYS_INIT_BIT(id))) {
+        return;
+    }
+    sysInitRecord[id].ready = xTaskGetTickCount() - sysInitEpoch;
+    xEventGroupSetBits(sysInitEvents, SYS_INIT_BIT(id));
+    LogMessage(LOG_DEBUG_LVL, "init: %s ready at %lu ms\r\n", sysInitTable[id].name, (unsigned long)(sysInitRecord[id].ready * portTICK_PERIOD_MS));
+}
+
+/**
+ * @fn		BaseType_t SysInitWaitFor(EventBits_t mask, TickType_t timeout)
+ * @brief	Waits until all subsystems in mask are ready
+ * @param	mask SYS_INIT_BIT() of each subsystem to wait for
+ * @param	timeout Ticks to wait. Use 0 to poll.
+ * @return	pdPASS if all subsystems in mask are ready
+ */
+BaseType_t SysInitWaitFor(EventBits_t mask, TickType_t timeout)
+{
+    if (mask == 0) {
+        return pdPASS;
+    }
+    if (sysInitEvents == NULL) {
+        return pdFAIL;
+    }
+    return ((xEventGroupWaitBits(sysInitEvents, mask, pdFALSE, pdTRUE, timeout) & mask) == mask) ? pdPASS : pdFAIL;
+}
+
+/**
+ * @fn		void SysInitPrintTimeline(void)
+ * @brief	Prints when each subsystem started and became ready, and the critical path to the last ready subsystem
+ */
+void SysInitPrintTimeline(void)
+{
+    char buf[64];
+    EventBits_t ready = (sysInitEvents != NULL) ? xEventGroupGetBits(sysInitEvents) : 0;
+    int last = -1;
+
+    SerialConsoleWriteString("\r\nBoot timeline (ms):\r\n");
+    for (int id = 0; id < SYS_INIT_COUNT; id++) {
+        if (ready & SYS_INIT_BIT(id)) {
+            snprintf(buf, sizeof(buf), "%-8s start %6lu ready %6lu\r\n", sysInitTable[id].name, (unsigned long)(sysInitRecord[id].start * portTICK_PERIOD_MS),
+                     (unsigned long)(sysInitRecord[id].ready * portTICK_PERIOD_MS));
+            if (last < 0 || sysInitRecord[id].ready > sysInitRecord[last].ready) {
+                last = id;
+            }
+        } else if (sysInitStarted & SYS_INIT_BIT(id)) {
+            snprintf(buf, sizeof(buf), "%-8s start %6lu not ready\r\n", sysInitTable[id].name, (unsigned long)(sysInitRecord[id].start * portTICK_PERIOD_MS));
+        } else {
+            snprintf(buf, sizeof(buf), "%-8s waiting\r\n", sysInitTable[id].name);
+        }
+        SerialConsoleWriteString(buf);
+    }
+
+    if (last < 0) {
+        return;
+    }
+
+    // Walk back from the last subsystem to come up, always through the prerequisite that was ready last
+    snprintf(buf, sizeof(buf), "Critical path %lu ms: %s", (unsigned long)(sysInitRecord[last].ready * portTICK_PERIOD_MS), sysInitTable[last].name);
+    SerialConsoleWriteString(buf);
+    for (int id = last; sysInitTable[id].prerequisites != 0;) {
+        int next = -1;
+        for (int pre = 0; pre < SYS_INIT_COUNT; pre++) {
+            if ((sysInitTable[id].prerequisites & SYS_INIT_BIT(pre)) && (next < 0 || sysInitRecord[pre].ready > sysInitRecord[next].ready)) {
+                next = pre;
+            }
+        }
+        SerialConsoleWriteString(" <- ");
+        SerialConsoleWriteString(sysInitTable[next].name);
+        id = next;
+    }
+    SerialConsoleWriteString("\r\n");
+}
@@ -0,0 +1,51 @@
+/**************************************************************************/ /**
+ * @file      SysInit.h
+ * @brief     Dependency aware subsystem bring-up. Each subsystem waits only for its own prerequisites, so capture and
+ *            storage come up without waiting behind the network. Records a boot timeline.
+ * @date      2026-10-19
+
+ ******************************************************************************/
+
+#pragma once
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************************************************************************
+ * Includes
+ ******************************************************************************/
+#include "FreeRTOS.h"
+#include "event_groups.h"
+
+/******************************************************************************
+ * Defines
+ ******************************************************************************/
+#define SYS_INIT_BIT(id) ((EventBits_t)1 << (id))  ///< Event group bit of a subsystem
+
+/******************************************************************************
+ * Structures and Enumerations
+ ******************************************************************************/
+
+/// Subsystems brought up at boot. Prerequisites are declared in the table in SysInit.c
+enum SysInitId {
+    SYS_INIT_I2C = 0,  ///< I2C driver
+    SYS_INIT_STORAGE,  ///< SD card mounted
+    SYS_INIT_CAPTURE,  ///< IMU FIFO configured and capturing
+    SYS_INIT_CLI,      ///< Command line interface
+    SYS_INIT_NETWORK,  ///< WINC initialized and connected to the access point
+    SYS_INIT_MQTT,     ///< Connected to the MQTT broker
+    SYS_INIT_COUNT
+};
+
+/******************************************************************************
+ * Global Function Declaration
+ ******************************************************************************/
+void SysInitInitialize(void);
+BaseType_t SysInitStart(enum SysInitId id, TickType_t timeout);
+void SysInitReady(enum SysInitId id);
+BaseType_t SysInitWaitFor(EventBits_t mask, TickType_t timeout);
+void SysInitPrintTimeline(void);
+
+#ifdef __cplusplus
+}
+#endif
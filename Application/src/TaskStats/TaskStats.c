@@ -0,0 +1,123 @@
+/**************************************************************************/ /**
+ * @file      TaskStats.c
+ * @brief     Per task CPU time and stack use on the target. Drives the FreeRTOS run time statistics from the SysTick
+ *            counter and prints them with the "tasks" command.
+ * @details   The run time counter is read by the kernel on every context switch, from PendSV, so it cannot use
+ *            BusStatsNowUs. It combines the tick count with the SysTick down counter like BusStatsNowUs does, with
+ *            interrupts masked and a tick that is pending but not yet counted added in. CPU shares are printed
+ *            for the time since the previous "tasks" command, which keeps them right across the counter wrap.
+ * @date      2026-10-19
+
+ ******************************************************************************/
+
+/******************************************************************************
+ * Includes
+ ******************************************************************************/
+#include "TaskStats/TaskStats.h"
+
+#include <stdio.h>
+
+#include "FreeRTOS.h"
+#include "SerialConsole.h"
+#include "asf.h"
+#include "task.h"
+
+/******************************************************************************
+ * Structures and Enumerations
+ ******************************************************************************/
+
+/// Run time of a task at the previous report
+struct TaskStatsMark {
+    TaskHandle_t handle;
+    uint32_t runTime;
+};
+
+/******************************************************************************
+ * Variables
+ ******************************************************************************/
+static uint32_t taskStatsCyclesPerCount = 1;                ///< CPU cycles per TASK_STATS_COUNTER_US
+static TaskStatus_t taskStatsStatus[TASK_STATS_MAX_TASKS];  ///< Snapshot being printed, static to keep it off the CLI stack
+static struct TaskStatsMark taskStatsMark[TASK_STATS_MAX_TASKS];
+static uint32_t taskStatsMarkTotal = 0;
+
+/******************************************************************************
+ * Global Functions
+ ******************************************************************************/
+
+/**
+ * @fn		void TaskStatsInit(void)
+ * @brief	Called by vTaskStartScheduler through portCONFIGURE_TIMER_FOR_RUN_TIME_STATS. Caches the counter divider,
+ *			configCPU_CLOCK_HZ is a clock generator query that is too slow for every context switch.
+ */
+void TaskStatsInit(void)
+{
+    taskStatsCyclesPerCount = configCPU_CLOCK_HZ / (1000000 / TASK_STATS_COUNTER_US);
+}
+
+/**
+ * @fn		uint32_t TaskStatsRunTimeCounter(void)
+ * @brief	portGET_RUN_TIME_COUNTER_VALUE of the kernel
+ * @return	Time since the scheduler started, in TASK_STATS_COUNTER_US units
+ * @note	Safe in interrupts and in the kernel with the scheduler locked
+ */
+uint32_t TaskStatsRunTimeCounter(void)
+{
+    UBaseType_t mask = portSET_INTERRUPT_MASK_FROM_ISR();
+    uint32_t ticks = xTaskGetTickCountFromISR();
+    uint32_t count = SysTick->VAL;
+
+    // The counter reloaded but the tick interrupt has not run yet
+    if ((SCB->ICSR & SCB_ICSR_PENDSTSET_Msk) && count > SysTick->LOAD / 2) {
+        ticks++;
+    }
+    portCLEAR_INTERRUPT_MASK_FROM_ISR(mask);
+
+    return ticks * (portTICK_PERIOD_MS * 1000 / TASK_STATS_COUNTER_US) + (SysTick->LOAD - count) / taskStatsCyclesPerCount;
+}
+
+/**
+ * @fn		void TaskStatsPrint(void)
+ * @brief	Prints each task with its state, priority, share of the CPU since the last call and the least stack it
+ *			had left, then the free heap
+ */
+void TaskStatsPrint(void)
+{
+    char buf[64];
+    uint32_t total;
+    UBaseType_t count = uxTaskGetSystemState(taskStatsStatus, TASK_STATS_MAX_TASKS, &total);
+    uint32_t elapsed = total - taskStatsMarkTotal;
+    static const char states[] = "XRBSD";  // Running, ready, blocked, suspended, deleted
+
+    if (count == 0) {
+        SerialConsoleWriteString("More tasks than TASK_STATS_MAX_TASKS\r\n");
+        return;
+    }
+
+    snprintf(buf, sizeof(buf), "\r\nTasks over the last %lu ms:\r\n", (unsigned long)(elapsed / (1000 / TASK_STATS_COUNTER_US)));
+    SerialConsoleWriteString(buf);
+    SerialConsoleWriteString("Name     St Pri   CPU%  Stack free\r\n");
+    for (UBaseType_t i = 0; i < count; i++) {
+        const TaskStatus_t *t = &taskStatsStatus[i];
+        uint32_t runTime = t->ulRunTimeCounter;
+
+        for (uint8_t j = 0; j < TASK_STATS_MAX_TASKS; j++) {
+            if (taskStatsMark[j].handle == t->xHandle) {
+                runTime -= taskStatsMark[j].runTime;
+                break;
+            }
+        }
+        // Tenths of a percent, without 64 bit division
+        uint32_t permille = (elapsed >= 1000) ? runTime / (elapsed / 1000) : 0;
+        snprintf(buf, sizeof(buf), "%-8s %c  %u  %4lu.%lu  %u words\r\n", t->pcTaskName, states[t->eCurrentState < 5 ? t->eCurrentState : 0],
+                 (unsigned)t->uxCurrentPriority, (unsigned long)(permille / 10), (unsigned long)(permille % 10), (unsigned)t->usStackHighWaterMark);
+        SerialConsoleWriteString(buf);
+    }
+    snprintf(buf, sizeof(buf), "Heap free %u bytes\r\n", (unsigned)xPortGetFreeHeapSize());
+    SerialConsoleWriteString(buf);
+
+    for (UBaseType_t i = 0; i < TASK_STATS_MAX_TASKS; i++) {
+        taskStatsMark[i].handle = (i < count) ? taskStatsStatus[i].xHandle : NULL;
+        taskStatsMark[i].runTime = (i < count) ? taskStatsStatus[i].ulRunTimeCounter : 0;
+    }
+    taskStatsMarkTotal = total;
+}
@@ -0,0 +1,34 @@
+/**************************************************************************/ /**
+ * @file      TaskStats.h
+ * @brief     Per task CPU time and stack use on the target. Drives the FreeRTOS run time statistics from the SysTick
+ *            counter and prints them with the "tasks" command.
+ * @date      2026-10-19
+
+ ******************************************************************************/
+
+#pragma once
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************************************************************************
+ * Includes
+ ******************************************************************************/
+#include <stdint.h>
+
+/******************************************************************************
+ * Defines
+ ******************************************************************************/
+#define TASK_STATS_COUNTER_US 10  ///< Run time counter resolution. 100 counts per tick, wraps after about 12 hours
+#define TASK_STATS_MAX_TASKS 8    ///< Tasks reported, including the idle and timer tasks
+
+/******************************************************************************
+ * Global Function Declaration
+ ******************************************************************************/
+void TaskStatsInit(void);
+uint32_t TaskStatsRunTimeCounter(void);
+void TaskStatsPrint(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,336 @@
+/**************************************************************************/ /**
+ * @file      UdpStream.c
+ * @brief     Live capture streaming over UDP. Capture batches and bus events are packed into datagrams with a
+ *            sequence number and a timestamp, optionally followed by an XOR parity datagram per group so a receiver
+ *            can rebuild one lost datagram without a retransmission.
+ * @details   Producers call UdpStreamRecord from their own task, like SerialConsoleStreamFrame. Records are packed
+ *            into one of two datagram buffers. When the buffer being filled is full it is handed to the Wifi task and
+ *            filling continues in the other one, so producers never wait for the network. If both are busy the
+ *            record is dropped and counted. The Wifi task sends the handed over buffer from UdpStreamPoll, and also
+ *            flushes a partly filled one once its first record is UDP_STREAM_FLUSH_MS old, which bounds the latency
+ *            when traffic is light. The WINC socket API is only used from the Wifi task.
+ *
+ *            Unlike the MQTT path nothing is acknowledged or resent: a lost datagram is either rebuilt by the
+ *            receiver from the parity of its group or shows up as a gap in the sequence numbers.
+ * @date      2026-10-19
+
+ ******************************************************************************/
+
+/******************************************************************************
+ * Includes
+ ******************************************************************************/
+#include "UdpStream/UdpStream.h"
+
+#include <string.h>
+
+#include "BusStats/BusStats.h"
+#include "EventDedup/EventDedup.h"
+#include "FreeRTOS.h"
+#include "WifiHandlerThread/WifiHandler.h"
+#include "task.h"
+
+/******************************************************************************
+ * Variables
+ ******************************************************************************/
+static volatile bool udpActive = false;
+static volatile bool udpRestart = false;       ///< UdpStreamEnable was called, the Wifi task resets the stream
+static struct sockaddr_in udpDest;
+static uint8_t udpGroup = 0;                   ///< Parity group size, 0 without parity
+static SOCKET udpSock = -1;
+
+static uint8_t udpBuffer[2][UDP_STREAM_DATAGRAM_SIZE];
+static uint16_t udpFillLen[2] = {UDP_STREAM_HEADER_SIZE, UDP_STREAM_HEADER_SIZE};
+static uint8_t udpRecords[2];
+static uint8_t udpFill = 0;                    ///< Buffer records are added to
+static int8_t udpReady = -1;                   ///< Buffer waiting to be sent, -1 if none. The other one is being filled
+static TickType_t udpFillTick;                 ///< Time the first record went into the buffer being filled
+
+static uint8_t udpParity[UDP_STREAM_HEADER_SIZE + UDP_STREAM_DATAGRAM_SIZE];
+static uint16_t udpParityLen = 0;              ///< Longest datagram XORed into the current group
+static uint32_t udpSeq = 0;
+static struct UdpStreamStats udpStats;
+
+/******************************************************************************
+ * Forward Declarations
+ ******************************************************************************/
+static void UdpStreamReset(void);
+static void UdpStreamSend(uint8_t index);
+static void UdpStreamWriteHeader(uint8_t *buf, uint8_t flags, uint32_t seq, uint16_t length, uint8_t records);
+
+/******************************************************************************
+ * Global Functions
+ ******************************************************************************/
+
+/**
+ * @fn			void UdpStreamEnable(uint32_t ip, uint16_t port, uint8_t parityGroup)
+ * @brief		Starts streaming to a receiver, or restarts it with new settings
+ * @param[in]	ip Receiver IPv4 address in network byte order, as returned by nmi_inet_addr
+ * @param[in]	port Receiver UDP port
+ * @param[in]	parityGroup Data datagrams per parity datagram, 0 or 1 for no parity, at most UDP_STREAM_MAX_PARITY_GROUP
+ * @note		Sequence numbers and counters start over, and bus event templates are sent again. The socket is opened
+ *				by the Wifi task.
+ */
+void UdpStreamEnable(uint32_t ip, uint16_t port, uint8_t parityGroup)
+{
+    taskENTER_CRITICAL();
+    udpDest.sin_family = AF_INET;
+    udpDest.sin_port = _htons(port);
+    udpDest.sin_addr.s_addr = ip;
+    udpGroup = (parityGroup > 1) ? ((parityGroup > UDP_STREAM_MAX_PARITY_GROUP) ? UDP_STREAM_MAX_PARITY_GROUP : parityGroup) : 0;
+    udpRestart = true;
+    udpActive = true;
+    taskEXIT_CRITICAL();
+    EventDedupReset();
+    WifiHandlerWake();
+}
+
+/**
+ * @fn			void UdpStreamDisable(void)
+ * @brief		Stops streaming. Records still buffered are discarded and the Wifi task closes the socket.
+ * @note
+ */
+void UdpStreamDisable(void)
+{
+    udpActive = false;
+    WifiHandlerWake();
+}
+
+/**
+ * @fn			bool UdpStreamIsActive(void)
+ * @brief		true while records should be passed to UdpStreamRecord
+ * @note
+ */
+bool UdpStreamIsActive(void)
+{
+    return udpActive;
+}
+
+/**
+ * @fn			void UdpStreamRecord(uint8_t type, const uint8_t *payload, uint16_t len)
+ * @brief		Adds a record to the datagram being filled
+ * @param[in]	type Record type, enum eSerialStreamType
+ * @param[in]	payload Record payload, in the format of the matching UART stream frame
+ * @param[in]	len Payload length
+ * @note		Task context. Never blocks, the record is dropped if both datagram buffers are taken.
+ */
+void UdpStreamRecord(uint8_t type, const uint8_t *payload, uint16_t len)
+{
+    bool wake = false;
+    uint8_t *rec;
+
+    if (!udpActive || len > UDP_STREAM_DATAGRAM_SIZE - UDP_STREAM_HEADER_SIZE - UDP_STREAM_RECORD_HEADER) {
+        return;
+    }
+
+    taskENTER_CRITICAL();
+    if (udpFillLen[udpFill] + UDP_STREAM_RECORD_HEADER + len > UDP_STREAM_DATAGRAM_SIZE) {
+        if (udpReady >= 0) {
+            udpStats.dropped++;
+            taskEXIT_CRITICAL();
+            return;
+        }
+        udpReady = udpFill;
+        udpFill ^= 1;
+        wake = true;
+    }
+    if (udpFillLen[udpFill] == UDP_STREAM_HEADER_SIZE) {
+        udpFillTick = xTaskGetTickCount();
+    }
+    rec = &udpBuffer[udpFill][udpFillLen[udpFill]];
+    rec[0] = type;
+    rec[1] = (uint8_t)len;
+    rec[2] = (uint8_t)(len >> 8);
+    memcpy(&rec[UDP_STREAM_RECORD_HEADER], payload, len);
+    udpFillLen[udpFill] += UDP_STREAM_RECORD_HEADER + len;
+    udpRecords[udpFill]++;
+    taskEXIT_CRITICAL();
+
+    if (wake) {
+        WifiHandlerWake();
+    }
+}
+
+/**
+ * @fn			void UdpStreamPoll(void)
+ * @brief		Sends the datagrams that are due. Opens the socket when streaming starts and closes it when it stops.
+ * @note		Wifi task only, while Wi-Fi is connected
+ */
+void UdpStreamPoll(void)
+{
+    int8_t ready;
+
+    if (udpRestart) {
+        UdpStreamReset();
+    }
+    if (!udpActive) {
+        UdpStreamCloseSocket();
+        return;
+    }
+    if (udpSock < 0) {
+        udpSock = socket(AF_INET, SOCK_DGRAM, 0);
+        if (udpSock < 0) {
+            return;
+        }
+    }
+
+    // At most the full buffer and then the partly filled one
+    for (uint8_t pass = 0; pass < 2; pass++) {
+        taskENTER_CRITICAL();
+        if (udpReady < 0 && udpFillLen[udpFill] > UDP_STREAM_HEADER_SIZE &&
+            (xTaskGetTickCount() - udpFillTick) >= pdMS_TO_TICKS(UDP_STREAM_FLUSH_MS)) {
+            udpReady = udpFill;
+            udpFill ^= 1;
+        }
+        ready = udpReady;
+        taskEXIT_CRITICAL();
+
+        if (ready < 0) {
+            return;
+        }
+        UdpStreamSend((uint8_t)ready);
+
+        taskENTER_CRITICAL();
+        udpFillLen[ready] = UDP_STREAM_HEADER_SIZE;
+        udpRecords[ready] = 0;
+        udpReady = -1;
+        taskEXIT_CRITICAL();
+    }
+}
+
+/**
+ * @fn			void UdpStreamCloseSocket(void)
+ * @brief		Closes the socket, for example before socketDeinit. UdpStreamPoll opens a new one if still streaming.
+ * @note		Wifi task only
+ */
+void UdpStreamCloseSocket(void)
+{
+    if (udpSock >= 0) {
+        close(udpSock);
+        udpSock = -1;
+    }
+}
+
+/**
+ * @fn			uint32_t UdpStreamNextDeadlineMs(void)
+ * @brief		Time until UdpStreamPoll has a datagram to send, for the Wifi task to bound its sleep
+ * @return		Milliseconds, 0 if a datagram is due now, UINT32_MAX if nothing is buffered
+ * @note		Wifi task only
+ */
+uint32_t UdpStreamNextDeadlineMs(void)
+{
+    uint32_t waitMs = UINT32_MAX;
+    TickType_t age;
+
+    // Without a socket (Wi-Fi down or HTTP transfer running) there is nothing to wake up for
+    if (!udpActive || udpSock < 0) {
+        return waitMs;
+    }
+    taskENTER_CRITICAL();
+    if (udpReady >= 0 || udpRestart) {
+        waitMs = 0;
+    } else if (udpFillLen[udpFill] > UDP_STREAM_HEADER_SIZE) {
+        age = (xTaskGetTickCount() - udpFillTick) * portTICK_PERIOD_MS;
+        waitMs = (age >= UDP_STREAM_FLUSH_MS) ? 0 : UDP_STREAM_FLUSH_MS - age;
+    }
+    taskEXIT_CRITICAL();
+    return waitMs;
+}
+
+/**
+ * @fn			void UdpStreamGetStats(struct UdpStreamStats *stats)
+ * @brief		Copies the counters
+ * @param[out]	stats Counters since streaming was last enabled
+ * @note
+ */
+void UdpStreamGetStats(struct UdpStreamStats *stats)
+{
+    taskENTER_CRITICAL();
+    *stats = udpStats;
+    taskEXIT_CRITICAL();
+}
+
+/******************************************************************************
+ * Local Functions
+ ******************************************************************************/
+
+/**
+ * @fn			static void UdpStreamReset(void)
+ * @brief		Empties both buffers and the parity group, and starts the sequence numbers over
+ * @note		Wifi task, after UdpStreamEnable
+ */
+static void UdpStreamReset(void)
+{
+    taskENTER_CRITICAL();
+    udpFillLen[0] = udpFillLen[1] = UDP_STREAM_HEADER_SIZE;
+    udpRecords[0] = udpRecords[1] = 0;
+    udpReady = -1;
+    udpSeq = 0;
+    memset(&udpStats, 0, sizeof(udpStats));
+    udpRestart = false;
+    taskEXIT_CRITICAL();
+
+    memset(udpParity, 0, sizeof(udpParity));
+    udpParityLen = 0;
+    // The receiver may have changed, send from a new socket
+    UdpStreamCloseSocket();
+}
+
+/**
+ * @fn			static void UdpStreamSend(uint8_t index)
+ * @brief		Sends a datagram buffer and adds it to the parity of its group, sending the parity when the group is full
+ * @note		A datagram the WINC refuses still takes its sequence number and its place in the parity, so the
+ *				receiver can rebuild it like any other lost datagram.
+ */
+static void UdpStreamSend(uint8_t index)
+{
+    uint8_t *buf = udpBuffer[index];
+    uint16_t len = udpFillLen[index];
+
+    UdpStreamWriteHeader(buf, 0, udpSeq, len, udpRecords[index]);
+    if (sendto(udpSock, buf, len, 0, (struct sockaddr *)&udpDest, sizeof(udpDest)) < 0) {
+        udpStats.sendErrors++;
+    }
+    udpStats.datagrams++;
+
+    if (udpGroup > 1) {
+        for (uint16_t i = 0; i < len; i++) {
+            udpParity[UDP_STREAM_HEADER_SIZE + i] ^= buf[i];
+        }
+        if (len > udpParityLen) {
+            udpParityLen = len;
+        }
+        if ((udpSeq % udpGroup) == (uint32_t)(udpGroup - 1)) {
+            UdpStreamWriteHeader(udpParity, UDP_STREAM_FLAG_PARITY, udpSeq - (udpGroup - 1), udpParityLen, udpGroup);
+            if (sendto(udpSock, udpParity, UDP_STREAM_HEADER_SIZE + udpParityLen, 0, (struct sockaddr *)&udpDest, sizeof(udpDest)) < 0) {
+                udpStats.sendErrors++;
+            }
+            udpStats.parity++;
+            memset(&udpParity[UDP_STREAM_HEADER_SIZE], 0, udpParityLen);
+            udpParityLen = 0;
+        }
+    }
+    udpSeq++;
+}
+
+/**
+ * @fn			static void UdpStreamWriteHeader(uint8_t *buf, uint8_t flags, uint32_t seq, uint16_t length, uint8_t records)
+ * @brief		Fills in the datagram header described in UdpStream.h
+ * @note
+ */
+static void UdpStreamWriteHeader(uint8_t *buf, uint8_t flags, uint32_t seq, uint16_t length, uint8_t records)
+{
+    uint32_t now = BusStatsNowUs();
+
+    buf[0] = UDP_STREAM_MAGIC0;
+    buf[1] = UDP_STREAM_MAGIC1;
+    buf[2] = UDP_STREAM_VERSION;
+    buf[3] = flags;
+    for (uint8_t i = 0; i < 4; i++) {
+        buf[4 + i] = (uint8_t)(seq >> (8 * i));
+        buf[8 + i] = (uint8_t)(now >> (8 * i));
+    }
+    buf[12] = (uint8_t)length;
+    buf[13] = (uint8_t)(length >> 8);
+    buf[14] = records;
+    buf[15] = udpGroup;
+}
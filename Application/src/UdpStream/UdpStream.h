@@ -0,0 +1,77 @@
+/**************************************************************************/ /**
+ * @file      UdpStream.h
+ * @brief     Live capture streaming over UDP. Capture batches and bus events are packed into datagrams with a
+ *            sequence number and a timestamp, optionally followed by an XOR parity datagram per group so a receiver
+ *            can rebuild one lost datagram without a retransmission.
+ * @date      2026-10-19
+
+ ******************************************************************************/
+
+#pragma once
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************************************************************************
+ * Includes
+ ******************************************************************************/
+#include <stdbool.h>
+#include <stdint.h>
+
+/******************************************************************************
+ * Defines
+ ******************************************************************************/
+#define UDP_STREAM_DEFAULT_PORT 51600
+#define UDP_STREAM_DATAGRAM_SIZE 256  ///< Largest data datagram, header included. Holds two full IMU batches
+#define UDP_STREAM_HEADER_SIZE 16
+#define UDP_STREAM_RECORD_HEADER 3    ///< Type (1) and payload length (2) in front of each record
+#define UDP_STREAM_FLUSH_MS 20        ///< Longest time a record waits for the datagram to fill up
+#define UDP_STREAM_MAX_PARITY_GROUP 16
+
+#define UDP_STREAM_MAGIC0 'L'
+#define UDP_STREAM_MAGIC1 'A'
+#define UDP_STREAM_VERSION 1
+#define UDP_STREAM_FLAG_PARITY 0x01
+
+/*
+ * Datagram header, multi-byte fields little endian:
+ *   0  magic 'L' 'A'     2  version     3  flags
+ *   4  sequence (4)      Data datagrams count up from 0. A parity datagram carries the sequence of the first
+ *                        datagram of its group
+ *   8  timestamp (4)     BusStatsNowUs when the datagram was sent
+ *   12 length (2)        Bytes in the datagram, header included. For parity, bytes of the XOR that follows the header
+ *   14 records (1)       Records in a data datagram, datagrams in the group for parity
+ *   15 group (1)         Parity group size, 0 without parity. Groups start at sequence numbers that are multiples of it
+ *
+ * A data datagram holds records: type (1, enum eSerialStreamType), payload length (2), payload. The payloads are the
+ * same as in the UART stream frames. A parity datagram holds the XOR of the whole data datagrams of its group, each
+ * zero padded to the longest one, so a single missing datagram is the XOR of the parity and the others.
+ */
+
+/******************************************************************************
+ * Structures and Enumerations
+ ******************************************************************************/
+
+/// Counters since streaming was enabled
+struct UdpStreamStats {
+    uint32_t datagrams;  ///< Data datagrams sent, including failed sends (they use up a sequence number)
+    uint32_t parity;     ///< Parity datagrams sent
+    uint32_t sendErrors; ///< Datagrams the WINC did not accept
+    uint32_t dropped;    ///< Records dropped because both datagram buffers were full
+};
+
+/******************************************************************************
+ * Global Function Declaration
+ ******************************************************************************/
+void UdpStreamEnable(uint32_t ip, uint16_t port, uint8_t parityGroup);
+void UdpStreamDisable(void);
+bool UdpStreamIsActive(void);
+void UdpStreamRecord(uint8_t type, const uint8_t *payload, uint16_t len);
+void UdpStreamPoll(void);
+void UdpStreamCloseSocket(void);
+uint32_t UdpStreamNextDeadlineMs(void);
+void UdpStreamGetStats(struct UdpStreamStats *stats);
+
+#ifdef __cplusplus
+}
+#endif
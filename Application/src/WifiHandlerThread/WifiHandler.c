@@ -12,11 +12,23 @@
 
 #include "WifiHandlerThread/WifiHandler.h"
 
+#include "BootControl/BootControl.h"
+#include "BusStats/BusStats.h"
+#include "CaptureCatalog/CaptureCatalog.h"
+#include "CaptureConfig/CaptureConfig.h"
+#include "DeviceId/DeviceId.h"
+#include "HttpServer/HttpServer.h"
+#include "MqttSpool/MqttSpool.h"
+#include "SysInit/SysInit.h"
+#include "UdpStream/UdpStream.h"
+
+#include <crc32.h>
 #include <errno.h>
 
 /******************************************************************************
  * Defines
  ******************************************************************************/
+#define IMU_BATCH_CLOSE_MAX "],\"t1\":4294967295}"  ///< Longest end of an IMU batch message
 
 /******************************************************************************
  * Variables
@@ -29,13 +41,15 @@ int8_t wifiStateMachine = WIFI_MQTT_INIT;   ///< Global variable that determines
 QueueHandle_t xQueueWifiState = NULL;       ///< Queue to determine the Wifi state from other threads.
 QueueHandle_t xQueueGameBuffer = NULL;      ///< Queue to send the next play to the cloud
 QueueHandle_t xQueueImuBuffer = NULL;       ///< Queue to send IMU data to the cloud
+QueueHandle_t xQueueImuBatchBuffer = NULL;  ///< Queue to send batches of IMU samples drained from the IMU FIFO to the cloud
 QueueHandle_t xQueueDistanceBuffer = NULL;  ///< Queue to send the distance to the cloud
+static TaskHandle_t wifiTaskHandle = NULL;  ///< Handle of the Wifi task, woken from the WINC interrupt
 
 /*HTTP DOWNLOAD RELATED DEFINES AND VARIABLES*/
 
 uint8_t do_download_flag = false;  // Flag that when true initializes a download. False to connect to MQTT broker
 /** File download processing state. */
-static download_state down_state = NOT_READY;
+static volatile download_state down_state = NOT_READY;
 /** SD/MMC mount. */
 static FATFS fatfs;
 /** File pointer for file download. */
@@ -46,6 +60,20 @@ static uint32_t http_file_size = 0;
 static uint32_t received_file_size = 0;
 /** File name to download. */
 static char save_file_name[MAIN_MAX_FILE_NAME_LENGTH + 1] = "0:";
+/** Catalog record of the file being downloaded. */
+static struct CaptureCatalogRecord download_record;
+/** File name to upload, set by WifiHandlerUploadFile. */
+static char upload_file_name[MAIN_MAX_FILE_NAME_LENGTH + 1] = "0:";
+
+/** Progress of the file upload. file_object holds the open file while UPLOADING is set. */
+struct HttpUpload {
+    uint32_t size;        ///< Committed file size seen at the last open
+    uint32_t sent;        ///< File bytes handed to the HTTP client
+    crc32_t crc;          ///< CRC-32 of the bytes sent so far
+    TickType_t start;     ///< Tick the request was started
+    bool open;            ///< file_object is open
+};
+static struct HttpUpload httpUpload;
 
 /** UART module for debug. */
 // static struct usart_module cdc_uart_module;
@@ -55,6 +83,13 @@ struct sw_timer_module swt_module_inst;
 
 /** Instance of HTTP client module. */
 struct http_client_module http_client_module_inst;
+/** Send buffer of the HTTP client, static rather than on the Wifi task stack where the client would place it. Also the
+ * buffer of the HTTP server, which is stopped while the client downloads or uploads. Not shared with mqtt_payload:
+ * server events are dispatched while an MQTT publish waits for the WINC. */
+static char http_buffer[HTTP_UPLOAD_SEND_BUFFER_SIZE];
+#if HTTP_UPLOAD_SEND_BUFFER_SIZE < HTTP_SERVER_BUFFER_SIZE
+#error "http_buffer is too small for the HTTP server"
+#endif
 
 /*MQTT RELATED DEFINES AND VARIABLES*/
 
@@ -67,6 +102,19 @@ static struct mqtt_module mqtt_inst;
 /* Receive buffer of the MQTT service. */
 static unsigned char mqtt_read_buffer[MAIN_MQTT_BUFFER_SIZE];
 static unsigned char mqtt_send_buffer[MAIN_MQTT_BUFFER_SIZE];
+/* Copies of pipelined QoS 1 publishes, kept until their PUBACK arrives, across reconnects too (see mqtt_init). */
+static unsigned char mqtt_inflight_buffer[MQTT_INFLIGHT_WINDOW * MAIN_MQTT_BUFFER_SIZE];
+
+/* Payload buffer for IMU batches and bus statistics. Leaves room in the send buffer for the MQTT header and topic.
+ * Shares its memory with the record the spool reads back: a payload is handed to MQTT or the spool before the
+ * MQTT loop drains the spool, and the spool only reads records inside MqttSpoolOpen and MqttSpoolDrain. */
+static union {
+    char msg[MQTT_SPOOL_MAX_PAYLOAD];
+    struct MqttSpoolRecord spool;
+} mqtt_payload;
+
+/* Broker packets the receive FIFO has dropped so far, as last reported. */
+static uint32_t mqtt_rx_overruns = 0;
 
 /******************************************************************************
  * Forward Declarations
@@ -74,8 +122,18 @@ static unsigned char mqtt_send_buffer[MAIN_MQTT_BUFFER_SIZE];
 static void MQTT_InitRoutine(void);
 static void MQTT_HandleGameMessages(void);
 static void MQTT_HandleImuMessages(void);
+static void MQTT_HandleImuBatchMessages(void);
+static uint8_t MQTT_PublishImuBatchPart(const struct ImuDataBatch *batch, uint8_t first, uint32_t seq);
+static void MQTT_HandleCaptureConfigAck(void);
+static void MQTT_HandleBusStats(void);
 static void HTTP_DownloadFileInit(void);
 static void HTTP_DownloadFileTransaction(void);
+static void HTTP_UploadFileInit(void);
+static void HTTP_UploadFileTransaction(void);
+static void WifiWaitForEvent(void);
+static void WifiWakeTask(void);
+static void MQTT_PublishOrSpool(const char *topic, const char *msg, uint16_t len);
+static int MQTT_PublishSpooled(const char *topic, const char *payload, uint16_t len);
 /******************************************************************************
  * Callback Functions
  ******************************************************************************/
@@ -84,10 +142,14 @@ static void HTTP_DownloadFileTransaction(void);
 
 /**
  * \brief Initialize download state to not ready.
+ * Storage is mounted by the segments task in parallel and may already be ready, so that flag is kept.
+ * The state is shared with that task, hence the critical sections around every read-modify-write.
  */
 static void init_state(void)
 {
-    down_state = NOT_READY;
+    taskENTER_CRITICAL();
+    down_state &= STORAGE_READY;
+    taskEXIT_CRITICAL();
 }
 
 /**
@@ -96,7 +158,9 @@ static void init_state(void)
  */
 static void clear_state(download_state mask)
 {
+    taskENTER_CRITICAL();
     down_state &= ~mask;
+    taskEXIT_CRITICAL();
 }
 
 /**
@@ -105,7 +169,9 @@ static void clear_state(download_state mask)
  */
 static void add_state(download_state mask)
 {
+    taskENTER_CRITICAL();
     down_state |= mask;
+    taskEXIT_CRITICAL();
 }
 
 /**
@@ -119,94 +185,6 @@ static inline bool is_state_set(download_state mask)
     return ((down_state & mask) != 0);
 }
 
-/**
- * \brief File existing check.
- * \param[in] fp The file pointer to check.
- * \param[in] file_path_name The file name to check.
- * \return true if this file name is exist, false otherwise.
- */
-static bool is_exist_file(FIL *fp, const char *file_path_name)
-{
-    if (fp == NULL || file_path_name == NULL) {
-        return false;
-    }
-
-    FRESULT ret = f_open(&file_object, (char const *)file_path_name, FA_OPEN_EXISTING);
-    f_close(&file_object);
-    return (ret == FR_OK);
-}
-
-/**
- * \brief Make to unique file name.
- * \param[in] fp The file pointer to check.
- * \param[out] file_path_name The file name change to uniquely and changed name is returned to this buffer.
- * \param[in] max_len Maximum file name length.
- * \return true if this file name is unique, false otherwise.
- */
-static bool rename_to_unique(FIL *fp, char *file_path_name, uint8_t max_len)
-{
-#define NUMBRING_MAX (3)
-#define ADDITION_SIZE (NUMBRING_MAX + 1) /* '-' character is added before the number. */
-    uint16_t i = 1, name_len = 0, ext_len = 0, count = 0;
-    char name[MAIN_MAX_FILE_NAME_LENGTH + 1] = {0};
-    char ext[MAIN_MAX_FILE_EXT_LENGTH + 1] = {0};
-    char numbering[NUMBRING_MAX + 1] = {0};
-    char *p = NULL;
-    bool valid_ext = false;
-
-    if (file_path_name == NULL) {
-        return false;
-    }
-
-    if (!is_exist_file(fp, file_path_name)) {
-        return true;
-    } else if (strlen(file_path_name) > MAIN_MAX_FILE_NAME_LENGTH) {
-        return false;
-    }
-
-    p = strrchr(file_path_name, '.');
-    if (p != NULL) {
-        ext_len = strlen(p);
-        if (ext_len < MAIN_MAX_FILE_EXT_LENGTH) {
-            valid_ext = true;
-            strcpy(ext, p);
-            if (strlen(file_path_name) - ext_len > MAIN_MAX_FILE_NAME_LENGTH - ADDITION_SIZE) {
-                name_len = MAIN_MAX_FILE_NAME_LENGTH - ADDITION_SIZE - ext_len;
-                strncpy(name, file_path_name, name_len);
-            } else {
-                name_len = (p - file_path_name);
-                strncpy(name, file_path_name, name_len);
-            }
-        } else {
-            name_len = MAIN_MAX_FILE_NAME_LENGTH - ADDITION_SIZE;
-            strncpy(name, file_path_name, name_len);
-        }
-    } else {
-        name_len = MAIN_MAX_FILE_NAME_LENGTH - ADDITION_SIZE;
-        strncpy(name, file_path_name, name_len);
-    }
-
-    name[name_len++] = '-';
-
-    for (i = 0, count = 1; i < NUMBRING_MAX; i++) {
-        count *= 10;
-    }
-    for (i = 1; i < count; i++) {
-        sprintf(numbering, MAIN_ZERO_FMT(NUMBRING_MAX), i);
-        strncpy(&name[name_len], numbering, NUMBRING_MAX);
-        if (valid_ext) {
-            strcpy(&name[name_len + NUMBRING_MAX], ext);
-        }
-
-        if (!is_exist_file(fp, name)) {
-            memset(file_path_name, 0, max_len);
-            strcpy(file_path_name, name);
-            return true;
-        }
-    }
-    return false;
-}
-
 /**
  * \brief Start file download via HTTP connection.
  */
@@ -267,7 +245,15 @@ static void store_file_packet(char *data, uint32_t length)
             return;
         }
 
-        rename_to_unique(&file_object, save_file_name, MAIN_MAX_FILE_NAME_LENGTH);
+        memset(&download_record, 0, sizeof(download_record));
+        download_record.id = CaptureCatalogNewName(save_file_name, sizeof(save_file_name));
+        if (download_record.id == 0) {
+            LogMessage(LOG_DEBUG_LVL, "store_file_packet: no free file name. Download canceled.\r\n");
+            add_state(CANCELED);
+            return;
+        }
+        download_record.start = get_fattime();
+        download_record.flags = CAPTURE_CATALOG_FLAG_CRC;
         LogMessage(LOG_DEBUG_LVL, "store_file_packet: creating file [%s]\r\n", save_file_name);
         ret = f_open(&file_object, (char const *)save_file_name, FA_CREATE_ALWAYS | FA_WRITE);
         if (ret != FR_OK) {
@@ -290,10 +276,15 @@ static void store_file_packet(char *data, uint32_t length)
         }
 
         received_file_size += wsize;
+        crc32_recalculate(data, wsize, &download_record.crc);
         LogMessage(LOG_DEBUG_LVL, "store_file_packet: received[%lu], file size[%lu]\r\n", (unsigned long)received_file_size, (unsigned long)http_file_size);
         if (received_file_size >= http_file_size) {
             f_close(&file_object);
             LogMessage(LOG_DEBUG_LVL, "store_file_packet: file downloaded successfully.\r\n");
+            download_record.size = received_file_size;
+            if (CaptureCatalogAdd(&download_record, save_file_name, false) != FR_OK) {
+                LogMessage(LOG_DEBUG_LVL, "store_file_packet: file not cataloged.\r\n");
+            }
             port_pin_set_output_level(LED_0_PIN, false);
             add_state(COMPLETED);
             return;
@@ -301,6 +292,93 @@ static void store_file_packet(char *data, uint32_t length)
     }
 }
 
+/**
+ * \brief Wait for the file being uploaded to grow past offset.
+ * Capture files may still be written while they are uploaded. A FIL sees the file size of the moment it was opened,
+ * so the file is reopened to pick up data the writer has committed with f_sync or f_close.
+ * \param[in] offset File bytes already sent.
+ * \return 1 if more data is available, 0 once the file did not grow for HTTP_UPLOAD_FOLLOW_MS, -1 if the file could not
+ * be reopened or positioned.
+ */
+static int upload_wait_for_data(uint32_t offset)
+{
+    TickType_t since = xTaskGetTickCount();
+
+    while ((xTaskGetTickCount() - since) < pdMS_TO_TICKS(HTTP_UPLOAD_FOLLOW_MS)) {
+        vTaskDelay(pdMS_TO_TICKS(HTTP_UPLOAD_POLL_MS));
+        f_close(&file_object);
+        httpUpload.open = (f_open(&file_object, (char const *)upload_file_name, FA_READ) == FR_OK);
+        if (!httpUpload.open) {
+            return -1;
+        }
+        if (file_object.fsize > offset) {
+            httpUpload.size = file_object.fsize;
+            return (f_lseek(&file_object, offset) == FR_OK) ? 1 : -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * \brief Read the next chunk of the upload entity.
+ * Called by the HTTP client each time the previous chunk was sent. Reads are kept sector aligned, so FatFs transfers
+ * whole sectors from the card straight into the send buffer instead of copying them through its sector window.
+ * \param[in] priv_data Unused.
+ * \param[out] buffer Chunk data.
+ * \param[in] size Room in buffer.
+ * \param[in] written File bytes sent before this chunk.
+ * \return Bytes read, 0 at the end of the file, -1 on a read, reopen or seek error (the HTTP client then drops the
+ * connection, so the server does not accept a truncated file).
+ */
+static int upload_entity_read(void *priv_data, char *buffer, uint32_t size, uint32_t written)
+{
+    uint32_t toBoundary = HTTP_UPLOAD_SECTOR - (written % HTTP_UPLOAD_SECTOR);
+    UINT count = 0;
+    int more;
+
+    if (size > toBoundary) {
+        size = toBoundary;
+    }
+    if (!httpUpload.open) {
+        return -1;
+    }
+    if (written >= httpUpload.size) {
+        more = upload_wait_for_data(written);
+        if (more <= 0) {
+            if (more < 0) {
+                LogMessage(LOG_DEBUG_LVL, "upload_entity_read: file reopen error at %lu\r\n", (unsigned long)written);
+            }
+            return more;
+        }
+    }
+    if (size > httpUpload.size - written) {
+        size = httpUpload.size - written;
+    }
+
+    if (f_read(&file_object, buffer, size, &count) != FR_OK) {
+        LogMessage(LOG_DEBUG_LVL, "upload_entity_read: file read error at %lu\r\n", (unsigned long)written);
+        return -1;
+    }
+    crc32_recalculate(buffer, count, &httpUpload.crc);
+    httpUpload.sent = written + count;
+    return (int)count;
+}
+
+/**
+ * \brief Close the upload entity once the terminating chunk was sent.
+ * \param[in] priv_data Unused.
+ */
+static void upload_entity_close(void *priv_data)
+{
+    if (httpUpload.open) {
+        f_close(&file_object);
+        httpUpload.open = false;
+    }
+}
+
+/** Chunked entity that streams the file named by upload_file_name. */
+static struct http_entity upload_entity = {1, NULL, NULL, upload_entity_read, upload_entity_close, NULL};
+
 /**
  * \brief Callback of the HTTP client.
  *
@@ -322,6 +400,11 @@ static void http_client_callback(struct http_client_module *module_inst, int typ
 
         case HTTP_CLIENT_CALLBACK_RECV_RESPONSE:
             LogMessage(LOG_DEBUG_LVL, "http_client_callback: received response %u data size %u\r\n", (unsigned int)data->recv_response.response_code, (unsigned int)data->recv_response.content_length);
+            if (is_state_set(UPLOADING)) {
+                unsigned int code = (unsigned int)data->recv_response.response_code;
+                add_state((code >= 200 && code < 300) ? COMPLETED : CANCELED);
+                break;
+            }
             if ((unsigned int)data->recv_response.response_code == 200) {
                 http_file_size = data->recv_response.content_length;
                 received_file_size = 0;
@@ -346,6 +429,14 @@ static void http_client_callback(struct http_client_module *module_inst, int typ
         case HTTP_CLIENT_CALLBACK_DISCONNECTED:
             LogMessage(LOG_DEBUG_LVL, "http_client_callback: disconnection reason:%d\r\n", data->disconnected.reason);
 
+            /* Uploads are not retried. Losing the connection before the response means the server has not stored the file. */
+            if (is_state_set(UPLOADING)) {
+                if (!is_state_set(COMPLETED)) {
+                    add_state(CANCELED);
+                }
+                break;
+            }
+
             /* If disconnect reason is equal to -ECONNRESET(-104),
              * It means the server has closed the connection (timeout).
              * This is normal operation.
@@ -446,6 +537,8 @@ static void wifi_cb(uint8_t u8MsgType, void *pvMsg)
             } else if (pstrWifiState->u8CurrState == M2M_WIFI_DISCONNECTED) {
                 LogMessage(LOG_DEBUG_LVL, "wifi_cb: M2M_WIFI_DISCONNECTED\r\n");
                 clear_state(WIFI_CONNECTED);
+                HttpServerStop();
+                UdpStreamCloseSocket();
                 if (is_state_set(DOWNLOADING)) {
                     f_close(&file_object);
                     clear_state(DOWNLOADING);
@@ -455,6 +548,10 @@ static void wifi_cb(uint8_t u8MsgType, void *pvMsg)
                     clear_state(GET_REQUESTED);
                 }
 
+                if (is_state_set(UPLOADING)) {
+                    add_state(CANCELED);
+                }
+
                 /* Disconnect from MQTT broker. */
                 /* Force close the MQTT connection, because cannot send a disconnect message to the broker when network is broken. */
                 mqtt_disconnect(&mqtt_inst, 1);
@@ -488,6 +585,8 @@ static void wifi_cb(uint8_t u8MsgType, void *pvMsg)
 
 /**
  * \brief Initialize SD/MMC storage.
+ * Blocks until a card is mounted. The board has no card detect line, so the slot is polled every
+ * STORAGE_POLL_MS. Called by the segments task, whose stack is sized for FatFs with long file names.
  */
 void init_storage(void)
 {
@@ -500,15 +599,16 @@ void init_storage(void)
         LogMessage(LOG_DEBUG_LVL, "init_storage: please plug an SD/MMC card in slot...\r\n");
 
         /* Wait card present and ready. */
-        do {
-            status = sd_mmc_test_unit_ready(0);
+        while ((status = sd_mmc_test_unit_ready(0)) != CTRL_GOOD) {
             if (CTRL_FAIL == status) {
                 LogMessage(LOG_DEBUG_LVL, "init_storage: SD Card install failed.\r\n");
                 LogMessage(LOG_DEBUG_LVL, "init_storage: try unplug and re-plug the card.\r\n");
                 while (CTRL_NO_PRESENT != sd_mmc_check(0)) {
+                    vTaskDelay(pdMS_TO_TICKS(STORAGE_POLL_MS));
                 }
             }
-        } while (CTRL_GOOD != status);
+            vTaskDelay(pdMS_TO_TICKS(STORAGE_POLL_MS));
+        }
 
         LogMessage(LOG_DEBUG_LVL, "init_storage: mounting SD card...\r\n");
         memset(&fatfs, 0, sizeof(FATFS));
@@ -519,7 +619,11 @@ void init_storage(void)
         }
 
         LogMessage(LOG_DEBUG_LVL, "init_storage: SD card mount OK.\r\n");
+        if (CaptureCatalogOpen() != FR_OK) {
+            LogMessage(LOG_ERROR_LVL, "init_storage: capture catalog not available.\r\n");
+        }
         add_state(STORAGE_READY);
+        SysInitReady(SYS_INIT_STORAGE);
         return;
     }
 }
@@ -571,6 +675,8 @@ static void configure_http_client(void)
     http_client_get_config_defaults(&httpc_conf);
 
     httpc_conf.recv_buffer_size = MAIN_BUFFER_MAX_SIZE;
+    httpc_conf.send_buffer = http_buffer;
+    httpc_conf.send_buffer_size = sizeof(http_buffer);
     httpc_conf.timer_inst = &swt_module_inst;
     httpc_conf.port = 80;
     httpc_conf.tls = 0;
@@ -607,6 +713,9 @@ void SubscribeHandler(MessageData *msgData);
  */
 static void socket_event_handler(SOCKET sock, uint8_t msg_type, void *msg_data)
 {
+    if (HttpServerSocketEvent(sock, msg_type, msg_data)) {
+        return;
+    }
     mqtt_socket_event_handler(sock, msg_type, msg_data);
 }
 
@@ -704,6 +813,26 @@ void SubscribeHandler(MessageData *msgData)
     }
 }
 
+/**
+ void SubscribeHandlerCaptureConfig(MessageData *msgData)
+ * @brief	Handles a binary capture configuration. Valid configurations are applied by the IMU FIFO task at the next
+ *          block boundary and acknowledged from there; invalid ones are acknowledged right away with the reason.
+ * @note	Runs in the Wifi task, from mqtt_poll
+*/
+void SubscribeHandlerCaptureConfig(MessageData *msgData)
+{
+    struct CaptureConfig cfg;
+    uint8_t seq;
+    enum CaptureConfigStatus status = CaptureConfigDecode((const uint8_t *)msgData->message->payload, (uint16_t)msgData->message->payloadlen, &seq, &cfg);
+
+    if (status == CAPTURE_CONFIG_OK) {
+        CaptureConfigSubmit(&cfg, seq);
+    } else {
+        LogMessage(LOG_ERROR_LVL, "Capture config %u rejected (%d)\r\n", seq, status);
+        CaptureConfigReject(seq, status);
+    }
+}
+
 void SubscribeHandlerDebug1Topic(MessageData *msgData)
 {
     port_pin_toggle_output_level(LED_0_PIN);
@@ -751,9 +880,11 @@ static void mqtt_callback(struct mqtt_module *module_inst, int type, union mqtt_
                 mqtt_subscribe(module_inst, LED_TOPIC, 2, SubscribeHandlerLedTopic);
                 mqtt_subscribe(module_inst, IMU_TOPIC, 2, SubscribeHandlerImuTopic);
                 mqtt_subscribe(module_inst, DEBUG_TOPIC_1, 2, SubscribeHandlerDebug1Topic);
+                mqtt_subscribe(module_inst, CAPTURE_CONFIG_TOPIC, 1, SubscribeHandlerCaptureConfig);
                 /* Enable USART receiving callback. */
 
                 LogMessage(LOG_DEBUG_LVL, "MQTT Connected\r\n");
+                SysInitReady(SYS_INIT_MQTT);
             } else {
                 /* Cannot connect for some reason. */
                 LogMessage(LOG_DEBUG_LVL, "MQTT broker decline your access! error code %d\r\n", data->connected.result);
@@ -793,6 +924,11 @@ static void configure_mqtt(void)
         }
     }
 
+    result = mqtt_set_inflight_window(&mqtt_inst, MQTT_INFLIGHT_WINDOW, mqtt_inflight_buffer, MAIN_MQTT_BUFFER_SIZE);
+    if (result < 0) {
+        LogMessage(LOG_DEBUG_LVL, "MQTT inflight window setup failed. Error code is (%d)\r\n", result);
+    }
+
     result = mqtt_register_callback(&mqtt_inst, mqtt_callback);
     if (result < 0) {
         LogMessage(LOG_DEBUG_LVL, "MQTT register callback failed. Error code is (%d)\r\n", result);
@@ -832,6 +968,63 @@ void extint_detection_callback(void)
     // Published in the Wifi thread main loop
 }
 
+/**
+ void nm_bsp_app_isr_hook(void)
+ * @brief	Called by the WINC BSP from the WINC interrupt. Wakes the Wifi task so it can handle the driver event.
+ * @note	Runs in interrupt context.
+*/
+void nm_bsp_app_isr_hook(void)
+{
+    BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+    if (wifiTaskHandle != NULL) {
+        vTaskNotifyGiveFromISR(wifiTaskHandle, &xHigherPriorityTaskWoken);
+    }
+    portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
+}
+
+/**
+ static void WifiWaitForEvent(void)
+ * @brief	Blocks the Wifi task until the WINC raises an interrupt, another task queues data to send, or the next
+ *          software timer (HTTP timeout) or MQTT deadline (keepalive, retransmission) is due.
+ * @note	Waits at most WIFI_EVENT_WAIT_MAX_MS so that state changes from other tasks are still picked up.
+*/
+static void WifiWaitForEvent(void)
+{
+    uint32_t waitMs = sw_timer_next_expiry(&swt_module_inst);
+    if (mqtt_inst.isConnected) {
+        int mqttMs = mqtt_next_deadline_ms(&mqtt_inst);
+        if (mqttMs >= 0 && (uint32_t)mqttMs < waitMs) waitMs = (uint32_t)mqttMs;
+    }
+    uint32_t udpMs = UdpStreamNextDeadlineMs();
+    if (udpMs < waitMs) waitMs = udpMs;
+    if (waitMs > WIFI_EVENT_WAIT_MAX_MS) waitMs = WIFI_EVENT_WAIT_MAX_MS;
+    TickType_t waitTicks = pdMS_TO_TICKS(waitMs);
+    if (waitTicks == 0) waitTicks = 1;
+    ulTaskNotifyTake(pdTRUE, waitTicks);
+}
+
+/**
+ static void WifiWakeTask(void)
+ * @brief	Ends a WifiWaitForEvent early so that data queued by another task is sent without waiting for a timeout.
+ * @note	Called from task context by the WifiAdd*ToQueue functions.
+*/
+static void WifiWakeTask(void)
+{
+    if (wifiTaskHandle != NULL) {
+        xTaskNotifyGive(wifiTaskHandle);
+    }
+}
+
+/**
+ void WifiHandlerWake(void)
+ * @brief	Wakes the Wifi task from another task, for modules that hand it work without a queue
+ * @note
+*/
+void WifiHandlerWake(void)
+{
+    WifiWakeTask();
+}
+
 /**
  static void HTTP_DownloadFileInit(void)
  * @brief	Routine to initialize HTTP download of the OTAU file
@@ -846,6 +1039,8 @@ static void HTTP_DownloadFileInit(void)
     while ((mqtt_inst.isConnected)) {
         m2m_wifi_handle_events(NULL);
     }
+    HttpServerStop();
+    UdpStreamCloseSocket();
     socketDeinit();
     // DOWNLOAD A FILE
     do_download_flag = true;
@@ -872,7 +1067,7 @@ static void HTTP_DownloadFileTransaction(void)
         m2m_wifi_handle_events(NULL);
         /* Checks the timer timeout. */
         sw_timer_task(&swt_module_inst);
-        vTaskDelay(5);
+        WifiWaitForEvent();
     }
 
     // Disable socket for HTTP Transfer
@@ -893,6 +1088,105 @@ static void HTTP_DownloadFileTransaction(void)
     }
 
     f_close(&file_object);
+
+    // Tell the bootloader to flash the new image on the next reset. Without this it boots straight into the application.
+    if (is_state_set(COMPLETED)) {
+        int32_t bootStatus = BootControlRequestUpdate(BOOT_CONTROL_IMAGE_A);
+        if (bootStatus != STATUS_OK) {
+            LogMessage(LOG_INFO_LVL, "[FAIL] Could not mark update pending %d\r\n", bootStatus);
+        }
+    }
+    wifiStateMachine = WIFI_MQTT_INIT;
+}
+
+/**
+ static void HTTP_UploadFileInit(void)
+ * @brief	Routine to start the chunked HTTP upload of the file named by WifiHandlerUploadFile
+ * @note	The file is PUT to MAIN_HTTP_UPLOAD_URL followed by its name. Each chunk is read from the card when the
+ *          previous one was sent, so only one sector of the file is in RAM at a time.
+*/
+static void HTTP_UploadFileInit(void)
+{
+    char url[sizeof(MAIN_HTTP_UPLOAD_URL) + MAIN_MAX_FILE_NAME_LENGTH];
+    FRESULT res;
+    int http_req_status;
+
+    if (mqtt_disconnect(&mqtt_inst, main_mqtt_broker)) {
+        LogMessage(LOG_DEBUG_LVL, "Error connecting to MQTT Broker!\r\n");
+    }
+    while ((mqtt_inst.isConnected)) {
+        m2m_wifi_handle_events(NULL);
+    }
+    HttpServerStop();
+    UdpStreamCloseSocket();
+    socketDeinit();
+    registerSocketCallback(socket_cb, resolve_cb);
+    socketInit();
+
+    clear_state(GET_REQUESTED | DOWNLOADING | COMPLETED | CANCELED | UPLOADING);
+    wifiStateMachine = WIFI_UPLOAD_HANDLE;
+
+    if (!is_state_set(STORAGE_READY) || !is_state_set(WIFI_CONNECTED)) {
+        LogMessage(LOG_INFO_LVL, "Upload: storage or Wi-Fi not ready\r\n");
+        add_state(CANCELED);
+        return;
+    }
+
+    res = f_open(&file_object, (char const *)upload_file_name, FA_READ);
+    if (res != FR_OK) {
+        LogMessage(LOG_INFO_LVL, "Upload: cannot open %s, res %d\r\n", upload_file_name, res);
+        add_state(CANCELED);
+        return;
+    }
+    httpUpload.open = true;
+    httpUpload.size = file_object.fsize;
+    httpUpload.sent = 0;
+    httpUpload.crc = 0;
+    httpUpload.start = xTaskGetTickCount();
+    add_state(UPLOADING);
+
+    snprintf(url, sizeof(url), "%s%s", MAIN_HTTP_UPLOAD_URL, &upload_file_name[2]);
+    http_req_status = http_client_send_request(&http_client_module_inst, url, HTTP_METHOD_PUT, &upload_entity, HTTP_UPLOAD_HEADER);
+    if (http_req_status < 0) {
+        LogMessage(LOG_INFO_LVL, "Upload: request failed %d\r\n", http_req_status);
+        add_state(CANCELED);
+    }
+}
+
+/**
+ static void HTTP_UploadFileTransaction(void)
+ * @brief	Routine to handle the HTTP transaction of uploading a file
+ * @note	Logs the result with the size and CRC-32 of what was sent, so it can be checked against the stored copy,
+ *          along with the throughput and the least free stack of the Wifi task.
+*/
+static void HTTP_UploadFileTransaction(void)
+{
+    uint32_t elapsedMs;
+
+    while (!(is_state_set(COMPLETED) || is_state_set(CANCELED))) {
+        /* Handle pending events from network controller. */
+        m2m_wifi_handle_events(NULL);
+        /* Checks the timer timeout. */
+        sw_timer_task(&swt_module_inst);
+        WifiWaitForEvent();
+    }
+
+    upload_entity_close(NULL);
+    if (is_state_set(UPLOADING)) {
+        elapsedMs = (xTaskGetTickCount() - httpUpload.start) * portTICK_PERIOD_MS;
+        LogMessage(LOG_INFO_LVL,
+                   "Upload %s %s: %lu bytes, CRC32 %08lx, %lu ms, %lu B/s, %lu stack words free\r\n",
+                   upload_file_name,
+                   is_state_set(COMPLETED) ? "done" : "failed",
+                   (unsigned long)httpUpload.sent,
+                   (unsigned long)httpUpload.crc,
+                   (unsigned long)elapsedMs,
+                   (unsigned long)((elapsedMs > 0) ? (uint64_t)httpUpload.sent * 1000 / elapsedMs : 0),
+                   (unsigned long)uxTaskGetStackHighWaterMark(NULL));
+        clear_state(UPLOADING);
+    }
+
+    socketDeinit();
     wifiStateMachine = WIFI_MQTT_INIT;
 }
 
@@ -904,6 +1198,8 @@ static void HTTP_DownloadFileTransaction(void)
 */
 static void MQTT_InitRoutine(void)
 {
+    HttpServerStop();
+    UdpStreamCloseSocket();
     socketDeinit();
     configure_mqtt();
     // Re-enable socket for MQTT Transfer
@@ -934,14 +1230,47 @@ static void MQTT_HandleTransactions(void)
     m2m_wifi_handle_events(NULL);
     sw_timer_task(&swt_module_inst);
 
+    // Serve captures on the LAN whenever Wi-Fi is up in MQTT mode
+    if (is_state_set(WIFI_CONNECTED)) {
+        HttpServerStart(http_buffer, sizeof(http_buffer));
+        UdpStreamPoll();
+    }
+    HttpServerPoll();
+
+    // Open the spool as soon as the SD card is mounted
+    if (!MqttSpoolIsOpen() && SysInitWaitFor(SYS_INIT_BIT(SYS_INIT_STORAGE), 0) == pdPASS) {
+        if (MqttSpoolOpen(&mqtt_payload.spool) != FR_OK) {
+            LogMessage(LOG_ERROR_LVL, "MQTT spool: could not open spool\r\n");
+        }
+    }
+
+    // Send what was spooled while the broker was unreachable before anything new
+    if (mqtt_inst.isConnected && !MqttSpoolIsEmpty()) {
+        MqttSpoolDrain(MQTT_PublishSpooled, MQTT_SPOOL_DRAIN_BURST);
+    }
+
     // Check if data has to be sent!
     MQTT_HandleGameMessages();
     MQTT_HandleImuMessages();
+    MQTT_HandleImuBatchMessages();
+    MQTT_HandleCaptureConfigAck();
+    MQTT_HandleBusStats();
 	
 	MQTT_HandleDebugMessages();
 
-    // Handle MQTT messages
-    if (mqtt_inst.isConnected) mqtt_yield(&mqtt_inst, 100);
+    // Handle the MQTT packets that have arrived, then sleep until the next WINC event or MQTT deadline
+    if (mqtt_inst.isConnected && mqtt_poll(&mqtt_inst) != SUCCESS) {
+        LogMessage(LOG_ERROR_LVL, "MQTT connection lost, reconnecting\r\n");
+        mqtt_disconnect(&mqtt_inst, 1);
+        wifiStateMachine = WIFI_MQTT_INIT;
+        return;
+    }
+    // A packet that did not fit the receive FIFO was skipped whole; the session stays in step with the stream
+    if (winc1500_rx_overruns() != mqtt_rx_overruns) {
+        mqtt_rx_overruns = winc1500_rx_overruns();
+        LogMessage(LOG_WARNING_LVL, "MQTT: broker packet dropped, receive FIFO full (%lu total)\r\n", (unsigned long)mqtt_rx_overruns);
+    }
+    WifiWaitForEvent();
 }
 
 static void MQTT_HandleImuMessages(void)
@@ -953,6 +1282,145 @@ static void MQTT_HandleImuMessages(void)
     }
 }
 
+/**
+ static void MQTT_HandleImuBatchMessages(void)
+ * @brief	Publishes one batch of IMU samples, in as many MQTT messages as it takes to fit the payload buffer
+ * @note	Payload is {"dev":<serial number>,"boot":<boot count>,"seq":<message number>,"t0":<first us>,
+ *			"ch":<mask>,"xyz":[[x,y,z],...],"t1":<last us>}. Samples are evenly spaced at the IMU batch data rate
+ *			between t0 and t1. seq counts messages from 0 on every boot, so a receiver keys stored messages by dev,
+ *			boot and seq: that drops the duplicates QoS 1 and spool replay can deliver and shows the messages lost.
+*/
+static void MQTT_HandleImuBatchMessages(void)
+{
+    static struct ImuDataBatch imuBatchVar;  // Static to keep it off the WiFi task stack
+    static uint32_t imuBatchSeq = 0;
+    uint8_t next = 0;
+
+    if (pdPASS == xQueueReceive(xQueueImuBatchBuffer, &imuBatchVar, 0)) {
+        while (next < imuBatchVar.count) {
+            next = MQTT_PublishImuBatchPart(&imuBatchVar, next, imuBatchSeq++);
+        }
+    }
+}
+
+/**
+ static uint8_t MQTT_PublishImuBatchPart(const struct ImuDataBatch *batch, uint8_t first, uint32_t seq)
+ * @brief	Publishes the samples of a batch from first on that fit one payload
+ * @note	Three axes of -32768 fit 13 samples, so a full batch takes two messages at worst.
+ * @return	Index of the first sample left for the next message
+*/
+static uint8_t MQTT_PublishImuBatchPart(const struct ImuDataBatch *batch, uint8_t first, uint32_t seq)
+{
+    const int room = sizeof(mqtt_payload.msg) - sizeof(IMU_BATCH_CLOSE_MAX);  // Kept for the closing
+    char *msg = mqtt_payload.msg;
+    uint8_t iter = first;
+    int len;
+
+    len = snprintf(msg, room, "{\"dev\":\"");
+    len += DeviceIdFormatSerial(&msg[len], room - len);
+    len += snprintf(&msg[len],
+                    room - len,
+                    "\",\"boot\":%lu,\"seq\":%lu,\"t0\":%lu,\"ch\":%u,\"xyz\":[",
+                    (unsigned long)DeviceIdBoot(),
+                    (unsigned long)seq,
+                    (unsigned long)batch->sample[first].timestampUs,
+                    batch->channelMask);
+    for (; iter < batch->count; iter++) {
+        // Only the axes enabled by the capture configuration are sent
+        const int16_t axes[3] = {batch->sample[iter].x, batch->sample[iter].y, batch->sample[iter].z};
+        char sampleText[26];
+        int sampleLen = snprintf(sampleText, sizeof(sampleText), "%s[", (iter == first) ? "" : ",");
+        for (uint8_t axis = 0; axis < 3; axis++) {
+            if (batch->channelMask & (1 << axis)) {
+                sampleLen += snprintf(&sampleText[sampleLen], sizeof(sampleText) - sampleLen, "%s%d", (sampleText[sampleLen - 1] == '[') ? "" : ",", axes[axis]);
+            }
+        }
+        sampleText[sampleLen++] = ']';
+        if (len + sampleLen >= room) {
+            break;  // The rest goes in the next message
+        }
+        memcpy(&msg[len], sampleText, sampleLen);
+        len += sampleLen;
+    }
+    len += snprintf(&msg[len], sizeof(mqtt_payload.msg) - len, "],\"t1\":%lu}", (unsigned long)batch->sample[iter - 1].timestampUs);
+    MQTT_PublishOrSpool(IMU_TOPIC, msg, len);
+    return iter;
+}
+
+/**
+ static void MQTT_HandleCaptureConfigAck(void)
+ * @brief	Publishes the ack of the last capture configuration: a status byte followed by the effective configuration
+ * @note	Acks are not spooled, they only mean something to a controller that is listening right now
+*/
+static void MQTT_HandleCaptureConfigAck(void)
+{
+    static uint8_t ack[CAPTURE_CONFIG_ACK_MAX_SIZE];
+    uint16_t len;
+
+    if (!mqtt_inst.isConnected) {
+        return;
+    }
+    len = CaptureConfigTakeAck(ack, sizeof(ack));
+    if (len > 0) {
+        mqtt_publish(&mqtt_inst, CAPTURE_CONFIG_ACK_TOPIC, (const char *)ack, len, 1, 0);
+    }
+}
+
+/**
+ static void MQTT_HandleBusStats(void)
+ * @brief	Publishes the bus statistics of the last BUS_STATS_PUBLISH_MS interval
+ * @note	Shares the IMU batch buffer, both are only used from the Wifi task. When the buffer is too small for
+ *			every address and top pair, the least busy ones are left out of the snapshot.
+*/
+static void MQTT_HandleBusStats(void)
+{
+    static TickType_t lastPublish = 0;
+    uint16_t len;
+
+    if ((xTaskGetTickCount() - lastPublish) < pdMS_TO_TICKS(BUS_STATS_PUBLISH_MS)) {
+        return;
+    }
+    lastPublish = xTaskGetTickCount();
+
+    len = BusStatsSnapshotJson(mqtt_payload.msg, sizeof(mqtt_payload.msg));
+    if (len == 0) {
+        LogMessage(LOG_ERROR_LVL, "Bus statistics buffer smaller than BUS_STATS_JSON_MIN_SIZE\r\n");
+        return;
+    }
+    MQTT_PublishOrSpool(BUS_STATS_TOPIC, mqtt_payload.msg, len);
+}
+
+/**
+ static void MQTT_PublishOrSpool(const char *topic, const char *msg, uint16_t len)
+ * @brief	Publishes captured data at QoS 1, or appends it to the SD spool when the broker cannot take it
+ * @note	While older messages are still spooled, new ones are spooled too so the broker sees them in order.
+ *			Live data is pipelined: up to MQTT_INFLIGHT_WINDOW messages wait for their PUBACK at once.
+*/
+static void MQTT_PublishOrSpool(const char *topic, const char *msg, uint16_t len)
+{
+    if (mqtt_inst.isConnected && MqttSpoolIsEmpty()) {
+        if (mqtt_publish_async(&mqtt_inst, topic, msg, len, 1, 0) == 0) {
+            return;
+        }
+    }
+    if (MqttSpoolAppend(topic, msg, len) != FR_OK) {
+        LogMessage(LOG_ERROR_LVL, "MQTT spool: message dropped (%lu total)\r\n", (unsigned long)MqttSpoolDropped());
+    }
+}
+
+/**
+ static int MQTT_PublishSpooled(const char *topic, const char *payload, uint16_t len)
+ * @brief	Publish function handed to MqttSpoolDrain
+ * @return	0 once the broker acknowledged the message
+*/
+static int MQTT_PublishSpooled(const char *topic, const char *payload, uint16_t len)
+{
+    if (!mqtt_inst.isConnected) {
+        return -1;
+    }
+    return mqtt_publish(&mqtt_inst, topic, payload, len, 1, 0);
+}
+
 static void MQTT_HandleGameMessages(void)
 {
     struct GameDataPacket gamePacket;
@@ -1003,15 +1471,17 @@ void vWifiTask(void *pvParameters)
 {
     tstrWifiInitParam param;
     int8_t ret;
-    vTaskDelay(100);
+    wifiTaskHandle = xTaskGetCurrentTaskHandle();
+    SysInitStart(SYS_INIT_NETWORK, portMAX_DELAY);
     init_state();
     // Create buffers to send data
     xQueueWifiState = xQueueCreate(5, sizeof(uint32_t));
     xQueueImuBuffer = xQueueCreate(5, sizeof(struct ImuDataPacket));
+    xQueueImuBatchBuffer = xQueueCreate(2, sizeof(struct ImuDataBatch));
     xQueueGameBuffer = xQueueCreate(2, sizeof(struct GameDataPacket));
     xQueueDistanceBuffer = xQueueCreate(5, sizeof(uint16_t));
 
-    if (xQueueWifiState == NULL || xQueueImuBuffer == NULL || xQueueGameBuffer == NULL || xQueueDistanceBuffer == NULL) {
+    if (xQueueWifiState == NULL || xQueueImuBuffer == NULL || xQueueImuBatchBuffer == NULL || xQueueGameBuffer == NULL || xQueueDistanceBuffer == NULL) {
         SerialConsoleWriteString("ERROR Initializing Wifi Data queues!\r\n");
     }
 
@@ -1025,9 +1495,6 @@ void vWifiTask(void *pvParameters)
     /* Initialize the MQTT service. */
     configure_mqtt();
 
-    /* Initialize SD/MMC storage. */
-    init_storage();
-
     /*Initialize BUTTON 0 as an external interrupt*/
     // configure_extint_channel();
     // configure_extint_callbacks();
@@ -1059,9 +1526,9 @@ void vWifiTask(void *pvParameters)
         m2m_wifi_handle_events(NULL);
         /* Checks the timer timeout. */
         sw_timer_task(&swt_module_inst);
+        WifiWaitForEvent();
     }
-
-    vTaskDelay(1000);
+    SysInitReady(SYS_INIT_NETWORK);
 
     wifiStateMachine = WIFI_MQTT_HANDLE;
     while (1) {
@@ -1087,6 +1554,16 @@ void vWifiTask(void *pvParameters)
                 break;
             }
 
+            case (WIFI_UPLOAD_INIT): {
+                HTTP_UploadFileInit();
+                break;
+            }
+
+            case (WIFI_UPLOAD_HANDLE): {
+                HTTP_UploadFileTransaction();
+                break;
+            }
+
             default:
                 wifiStateMachine = WIFI_MQTT_INIT;
                 break;
@@ -1103,17 +1580,35 @@ void vWifiTask(void *pvParameters)
             LogMessage(LOG_DEBUG_LVL, "MQTT send %s\r\n", mqtt_msg_temp);
             isPressed = false;
         }
-
-        vTaskDelay(100);
     }
     return;
 }
 
 void WifiHandlerSetState(uint8_t state)
 {
-    if (state <= WIFI_DOWNLOAD_HANDLE) {
-        xQueueSend(xQueueWifiState, &state, (TickType_t)10);
+    if (state <= WIFI_UPLOAD_HANDLE) {
+        if (xQueueSend(xQueueWifiState, &state, (TickType_t)10) == pdPASS) WifiWakeTask();
+    }
+}
+
+/**
+ int WifiHandlerUploadFile(const char *name)
+ * @brief	Asks the Wifi task to upload a file from the SD card over HTTP
+ * @param[in]	name File name, without the drive prefix
+
+ * @return		0 if the upload was queued, -1 if the name is too long or an upload is already running
+ * @note	The upload follows the end of the file while it is still being written, see HTTP_UPLOAD_FOLLOW_MS
+*/
+int WifiHandlerUploadFile(const char *name)
+{
+    if (strlen(name) > MAIN_MAX_FILE_NAME_LENGTH - 2 || is_state_set(UPLOADING)) {
+        return -1;
     }
+    upload_file_name[0] = LUN_ID_SD_MMC_0_MEM + '0';
+    upload_file_name[1] = ':';
+    strcpy(&upload_file_name[2], name);
+    WifiHandlerSetState(WIFI_UPLOAD_INIT);
+    return 0;
 }
 
 /**
@@ -1128,6 +1623,26 @@ void WifiHandlerSetState(uint8_t state)
 int WifiAddImuDataToQueue(struct ImuDataPacket *imuPacket)
 {
     int error = xQueueSend(xQueueImuBuffer, imuPacket, (TickType_t)10);
+    if (error == pdPASS) WifiWakeTask();
+    return error;
+}
+
+/**
+ int WifiAddImuBatchToQueue(struct ImuDataBatch *imuBatch)
+ * @brief	Adds a batch of IMU samples to the queue to send via MQTT
+ * @param[in]	imuBatch Batch to copy into the queue
+
+ * @return		Returns pdTrue if data can be added to queue, pdFalse if queue is full or not created yet
+ * @note
+
+*/
+int WifiAddImuBatchToQueue(struct ImuDataBatch *imuBatch)
+{
+    if (xQueueImuBatchBuffer == NULL) {
+        return pdFALSE;
+    }
+    int error = xQueueSend(xQueueImuBatchBuffer, imuBatch, (TickType_t)10);
+    if (error == pdPASS) WifiWakeTask();
     return error;
 }
 
@@ -1143,6 +1658,7 @@ int WifiAddImuDataToQueue(struct ImuDataPacket *imuPacket)
 int WifiAddDistanceDataToQueue(uint16_t *distance)
 {
     int error = xQueueSend(xQueueDistanceBuffer, distance, (TickType_t)10);
+    if (error == pdPASS) WifiWakeTask();
     return error;
 }
 
@@ -1158,5 +1674,6 @@ int WifiAddDistanceDataToQueue(uint16_t *distance)
 int WifiAddGameDataToQueue(struct GameDataPacket *game)
 {
     int error = xQueueSend(xQueueGameBuffer, game, (TickType_t)10);
+    if (error == pdPASS) WifiWakeTask();
     return error;
 }
@@ -16,6 +16,7 @@ extern "C" {
 /******************************************************************************
  * Includes
  ******************************************************************************/
+#include "IMU/ImuBatch.h"
 #include "MQTTClient/Wrapper/mqtt.h"
 #include "SerialConsole.h"
 #include "asf.h"
@@ -34,9 +35,14 @@ extern "C" {
 #define WIFI_MQTT_HANDLE 1      ///< State for Wifi handler to Handle MQTT Connection
 #define WIFI_DOWNLOAD_INIT 2    ///< State for Wifi handler to Initialize Download Connection
 #define WIFI_DOWNLOAD_HANDLE 3  ///< State for Wifi handler to Handle Download Connection
+#define WIFI_UPLOAD_INIT 4      ///< State for Wifi handler to Initialize Upload Connection
+#define WIFI_UPLOAD_HANDLE 5    ///< State for Wifi handler to Handle Upload Connection
 
-#define WIFI_TASK_SIZE 600
+#define WIFI_TASK_SIZE 480  ///< The HTTP client send buffer is http_buffer, not on this stack
 #define WIFI_PRIORITY (configMAX_PRIORITIES - 2)
+#define WIFI_EVENT_WAIT_MAX_MS 100  ///< Longest time the Wifi task blocks waiting for a WINC interrupt or timer expiry
+#define MQTT_SPOOL_DRAIN_BURST 8    ///< Spooled messages sent per pass of the MQTT loop, so the live queues keep draining
+#define MQTT_INFLIGHT_WINDOW 2      ///< QoS 1 publishes that may wait for their PUBACK at once (each costs MAIN_MQTT_BUFFER_SIZE of RAM)
 
 /** Wi-Fi AP Settings. */
 // Note: It is highly recommended that you save your Wi-Fi details in a separate header file, "secret.h", which is not committed to Github (added to gitignore).
@@ -52,6 +58,17 @@ extern "C" {
 /** Content URI for download. */
 
 #define MAIN_HTTP_FILE_URL "http://13.90.136.162/TestA.bin"  ///< Change me to the URL to download your OTAU binary file from!
+#define MAIN_HTTP_UPLOAD_URL "http://13.90.136.162/upload/"  ///< Files are PUT to this URL followed by their name
+
+/** Chunked upload of SD files. */
+#define HTTP_UPLOAD_SECTOR 512   ///< File bytes per chunk. Whole sectors are read by FatFs straight into the send buffer
+#define HTTP_UPLOAD_SEND_BUFFER_SIZE (HTTP_UPLOAD_SECTOR + 7)  ///< Chunk plus its size line and trailing CRLF
+#define HTTP_UPLOAD_FOLLOW_MS 2000  ///< Time the end of a file is watched for data still being written before the upload ends
+#define HTTP_UPLOAD_POLL_MS 50      ///< Interval between two size checks while following the end of a file
+#define HTTP_UPLOAD_HEADER "Content-Type: application/octet-stream\r\n"
+
+/** SD card. */
+#define STORAGE_POLL_MS 500  ///< Interval between two checks of the SD slot while no card is mounted
 
 /** Maximum size for packet buffer. */
 #define MAIN_BUFFER_MAX_SIZE (512)
@@ -70,7 +87,8 @@ typedef enum {
     GET_REQUESTED = 0x04,  /*!< GET request is sent. */
     DOWNLOADING = 0x08,    /*!< Running to download. */
     COMPLETED = 0x10,      /*!< Download completed. */
-    CANCELED = 0x20        /*!< Download canceled. */
+    CANCELED = 0x20,       /*!< Download canceled. */
+    UPLOADING = 0x40       /*!< Running to upload. */
 } download_state;
 
 // Structure definition that holds IMU data
@@ -110,6 +128,9 @@ struct RgbColorPacket {
 #define IMU_TOPIC "P1_IMU_ESE516_T0"                  // Students to change to an unique identifier for each device! IMU Data
 #define DISTANCE_TOPIC "P1_DISTANCE_ESE516_T0"        // Students to change to an unique identifier for each device! Distance Data
 #define TEMPERATURE_TOPIC "P1_TEMPERATURE_ESE516_T0"  // Students to change to an unique identifier for each device! Distance Data
+#define CAPTURE_CONFIG_TOPIC "P1_CAPCFG_ESE516_T0"          // Binary capture configuration (see CaptureConfig.h)
+#define CAPTURE_CONFIG_ACK_TOPIC "P1_CAPCFG_ACK_ESE516_T0"  // Status and effective capture configuration
+#define BUS_STATS_TOPIC "P1_BUSSTATS_ESE516_T0"             // Periodic bus statistics (see BusStats.h)
 
 #else
 /* Chat MQTT topic. */
@@ -119,6 +140,9 @@ struct RgbColorPacket {
 #define IMU_TOPIC "P2_IMU_ESE516_T0"                  // Students to change to an unique identifier for each device! IMU Data
 #define DISTANCE_TOPIC "P2_DISTANCE_ESE516_T0"        // Students to change to an unique identifier for each device! Distance Data
 #define TEMPERATURE_TOPIC "P2_TEMPERATURE_ESE516_T0"  // Students to change to an unique identifier for each device! Distance Data
+#define CAPTURE_CONFIG_TOPIC "P2_CAPCFG_ESE516_T0"          // Binary capture configuration (see CaptureConfig.h)
+#define CAPTURE_CONFIG_ACK_TOPIC "P2_CAPCFG_ACK_ESE516_T0"  // Status and effective capture configuration
+#define BUS_STATS_TOPIC "P2_BUSSTATS_ESE516_T0"             // Periodic bus statistics (see BusStats.h)
 
 #endif
 
@@ -159,13 +183,17 @@ static const char main_mqtt_broker[] = "13.90.136.162";
 void vWifiTask(void *pvParameters);
 void init_storage(void);
 void WifiHandlerSetState(uint8_t state);
+int WifiHandlerUploadFile(const char *name);
+void WifiHandlerWake(void);
 int WifiAddDistanceDataToQueue(uint16_t *distance);
 int WifiAddImuDataToQueue(struct ImuDataPacket *imuPacket);
+int WifiAddImuBatchToQueue(struct ImuDataBatch *imuBatch);
 int WifiAddGameDataToQueue(struct GameDataPacket *game);
 void SubscribeHandlerLedTopic(MessageData *msgData);
 void SubscribeHandlerGameTopic(MessageData *msgData);
 void SubscribeHandlerImuTopic(MessageData *msgData);
 void SubscribeHandlerDistanceTopic(MessageData *msgData);
+void SubscribeHandlerCaptureConfig(MessageData *msgData);
 void configure_extint_channel(void);
 void configure_extint_callbacks(void);
 
@@ -42,6 +42,8 @@
 #include <gclk.h>
 #include <stdint.h>
 void assert_triggered(const char *file, uint32_t line);
+void TaskStatsInit(void);
+uint32_t TaskStatsRunTimeCounter(void);
 #endif
 
 #define configUSE_PREEMPTION 1
@@ -53,7 +55,7 @@ void assert_triggered(const char *file, uint32_t line);
 #define configMAX_PRIORITIES (5)
 #define configMINIMAL_STACK_SIZE ((unsigned short)100)
 /* configTOTAL_HEAP_SIZE is not used when heap_3.c is used. */
-#define configTOTAL_HEAP_SIZE ((size_t)(12000))
+#define configTOTAL_HEAP_SIZE ((size_t)(11520))
 #define configMAX_TASK_NAME_LEN (8)
 #define configUSE_TRACE_FACILITY 1
 #define configUSE_16_BIT_TICKS 0
@@ -65,7 +67,9 @@ void assert_triggered(const char *file, uint32_t line);
 #define configUSE_MALLOC_FAILED_HOOK 1
 #define configUSE_COUNTING_SEMAPHORES 1
 #define configUSE_QUEUE_SETS 1
-#define configGENERATE_RUN_TIME_STATS 0
+#define configGENERATE_RUN_TIME_STATS 1
+#define portCONFIGURE_TIMER_FOR_RUN_TIME_STATS() TaskStatsInit()           // See TaskStats.c
+#define portGET_RUN_TIME_COUNTER_VALUE() TaskStatsRunTimeCounter()
 #define configENABLE_BACKWARD_COMPATIBILITY 1
 #define configUSE_DAEMON_TASK_STARTUP_HOOK 1  // Ported from FreeRToS 9.0.0
 
@@ -146,6 +146,7 @@ void http_client_get_config_defaults(struct http_client_config *const config)
 	config->timer_inst = NULL;
 	config->recv_buffer = NULL;
 	config->recv_buffer_size = 256;
+	config->send_buffer = NULL;
 	config->send_buffer_size = MIN_SEND_BUFFER_SIZE;
 	config->user_agent = DEFAULT_USER_AGENT;
 }
@@ -588,7 +589,8 @@ void _http_client_request(struct http_client_module *const module)
 	struct http_entity * entity;
 	union http_client_data data;
 #define HTTP_CHUNKED_MAX_LENGTH 3 /*TCP MTU is 1400(0x578) */
-	char buffer[module->config.send_buffer_size];
+	char stack_buffer[(module->config.send_buffer == NULL) ? module->config.send_buffer_size : 1];
+	char *buffer = (module->config.send_buffer == NULL) ? stack_buffer : module->config.send_buffer;
 
 	if (module == NULL) {
 		return;
@@ -682,7 +684,9 @@ void _http_client_request(struct http_client_module *const module)
 				module->config.send_buffer_size - HTTP_CHUNKED_MAX_LENGTH - 4, module->req.sent_length);
 			if (size < 0) {
 				/* If occurs problem during the operation, Close this socket. */
-				size = 0;
+				/* A terminating chunk would make the server accept a truncated entity. */
+				_http_client_clear_conn(module, -EIO);
+				return;
 			}
 			buffer[HTTP_CHUNKED_MAX_LENGTH + 1] = '\n';
 			buffer[HTTP_CHUNKED_MAX_LENGTH] = '\r';
@@ -701,12 +705,17 @@ void _http_client_request(struct http_client_module *const module)
 				*ptr = CH_LUT[(size / 0x100) % 16];
 			}		
 			//module->sending = 1;
-			if ((result = send(module->sock, (void*)ptr, ptr + HTTP_CHUNKED_MAX_LENGTH - buffer + size + 4, 0)) < 0) {	
+			/* Size digits from ptr, CRLF, data, CRLF. */
+			if ((result = send(module->sock, (void*)ptr, buffer + HTTP_CHUNKED_MAX_LENGTH + 4 + size - ptr, 0)) < 0) {	
 				_http_client_clear_conn(module, -EIO);
 				return;
 			}
 
 			module->req.sent_length += size;
+			/* Timeout counts from the last chunk, so long uploads are not cut off. */
+			if (module->config.timeout > 0) {
+				sw_timer_enable_callback(module->config.timer_inst, module->timer_id, module->config.timeout);
+			}
 
 			if(size == 0) {
 				if (module->req.entity.close) {
@@ -254,9 +254,15 @@ struct http_client_config {
 	 * Default value is 256.
 	 */
 	uint32_t recv_buffer_size;
+	/**
+	 * Tx buffer of send_buffer_size bytes.
+	 * If it is NULL, the buffer is located in the stack of the task running the client.
+	 * Default value is NULL.
+	 */
+	char *send_buffer;
 	/**
 	 * Send buffer size in the HTTP client service.
-	 * This buffer is located in the stack.
+	 * This buffer is located in the stack unless send_buffer is set.
 	 * Therefore, The size of the buffer increases the speed will increase, but it may cause a stack overflow.
 	 * Apache server is not supported that packet header is divided in the multiple packets.
 	 * So, it MUST bigger than 192.
@@ -63,8 +63,104 @@ void RTT_Handler(void)
 	}
 }
 
+#elif defined(SW_TIMER_HOST)
+void sw_timer_host_advance(uint32_t ticks)
+{
+	sw_timer_tick += ticks;
+}
+
 #endif
 
+/**
+ * \brief Check if timer a expires before timer b.
+ *
+ * Tick count wraps around, so the expire times are compared through their signed difference.
+ */
+static inline bool sw_timer_before(struct sw_timer_module *const module_inst, uint8_t a, uint8_t b)
+{
+	return (int32_t)(module_inst->handler[a].expire_time - module_inst->handler[b].expire_time) < 0;
+}
+
+/**
+ * \brief Put a timer ID at a heap position and keep its back reference up to date.
+ */
+static inline void sw_timer_heap_set(struct sw_timer_module *const module_inst, uint8_t pos, uint8_t timer_id)
+{
+	module_inst->heap[pos] = timer_id;
+	module_inst->handler[timer_id].heap_index = pos;
+}
+
+/**
+ * \brief Move the timer at heap position pos towards the root until the heap is ordered again.
+ */
+static void sw_timer_heap_sift_up(struct sw_timer_module *const module_inst, uint8_t pos)
+{
+	uint8_t timer_id = module_inst->heap[pos];
+
+	while (pos > 0) {
+		uint8_t parent = (pos - 1) / 2;
+		if (!sw_timer_before(module_inst, timer_id, module_inst->heap[parent])) {
+			break;
+		}
+		sw_timer_heap_set(module_inst, pos, module_inst->heap[parent]);
+		pos = parent;
+	}
+	sw_timer_heap_set(module_inst, pos, timer_id);
+}
+
+/**
+ * \brief Move the timer at heap position pos towards the leaves until the heap is ordered again.
+ */
+static void sw_timer_heap_sift_down(struct sw_timer_module *const module_inst, uint8_t pos)
+{
+	uint8_t timer_id = module_inst->heap[pos];
+
+	for (;;) {
+		/* Computed in full width, 2 * pos + 1 does not fit in a heap position once the heap holds 128 timers. */
+		unsigned int child = 2u * pos + 1;
+		if (child >= module_inst->heap_size) {
+			break;
+		}
+		if (child + 1 < module_inst->heap_size &&
+				sw_timer_before(module_inst, module_inst->heap[child + 1], module_inst->heap[child])) {
+			child++;
+		}
+		if (!sw_timer_before(module_inst, module_inst->heap[child], timer_id)) {
+			break;
+		}
+		sw_timer_heap_set(module_inst, pos, module_inst->heap[child]);
+		pos = child;
+	}
+	sw_timer_heap_set(module_inst, pos, timer_id);
+}
+
+/**
+ * \brief Restore heap order after the expire time of the timer at heap position pos was changed.
+ */
+static void sw_timer_heap_update(struct sw_timer_module *const module_inst, uint8_t pos)
+{
+	if (pos > 0 && sw_timer_before(module_inst, module_inst->heap[pos], module_inst->heap[(pos - 1) / 2])) {
+		sw_timer_heap_sift_up(module_inst, pos);
+	} else {
+		sw_timer_heap_sift_down(module_inst, pos);
+	}
+}
+
+/**
+ * \brief Remove an enabled timer from the heap.
+ */
+static void sw_timer_heap_remove(struct sw_timer_module *const module_inst, int timer_id)
+{
+	uint8_t pos = module_inst->handler[timer_id].heap_index;
+
+	module_inst->heap_size--;
+	if (pos != module_inst->heap_size) {
+		/* Fill the hole with the last leaf. */
+		sw_timer_heap_set(module_inst, pos, module_inst->heap[module_inst->heap_size]);
+		sw_timer_heap_update(module_inst, pos);
+	}
+}
+
 void sw_timer_get_config_defaults(struct sw_timer_config *const config)
 {
 	Assert(config);
@@ -88,6 +184,7 @@ void sw_timer_init(struct sw_timer_module *const module_inst, struct sw_timer_co
 	Assert(config->tcc_callback_channel < TCC_NUM_CHANNELS);
 
 	module_inst->accuracy = config->accuracy;
+	module_inst->heap_size = 0;
 #if (SAMD21)
 	/* Start the TCC module. */
 	tcc_module = &module_inst->tcc_inst;
@@ -183,6 +280,10 @@ void sw_timer_unregister_callback(struct sw_timer_module *const module_inst, int
 
 	handler = &module_inst->handler[timer_id];
 
+	if (handler->callback_enable) {
+		sw_timer_heap_remove(module_inst, timer_id);
+		handler->callback_enable = 0;
+	}
 	handler->used = 0;
 }
 
@@ -195,8 +296,16 @@ void sw_timer_enable_callback(struct sw_timer_module *const module_inst, int tim
 
 	handler = &module_inst->handler[timer_id];
 
-	handler->callback_enable = 1;
 	handler->expire_time = sw_timer_tick + (delay / module_inst->accuracy);
+	if (handler->callback_enable) {
+		/* Re-armed while pending, only its position changes. */
+		sw_timer_heap_update(module_inst, handler->heap_index);
+	} else {
+		handler->callback_enable = 1;
+		sw_timer_heap_set(module_inst, module_inst->heap_size, timer_id);
+		module_inst->heap_size++;
+		sw_timer_heap_sift_up(module_inst, handler->heap_index);
+	}
 }
 
 void sw_timer_disable_callback(struct sw_timer_module *const module_inst, int timer_id)
@@ -208,7 +317,10 @@ void sw_timer_disable_callback(struct sw_timer_module *const module_inst, int ti
 
 	handler = &module_inst->handler[timer_id];
 
-	handler->callback_enable = 0;
+	if (handler->callback_enable) {
+		sw_timer_heap_remove(module_inst, timer_id);
+		handler->callback_enable = 0;
+	}
 }
 
 void sw_timer_task(struct sw_timer_module *const module_inst)
@@ -218,24 +330,45 @@ void sw_timer_task(struct sw_timer_module *const module_inst)
 
 	Assert(module_inst);
 
-	for (index = 0; index < CONF_SW_TIMER_COUNT; index++) {
-		if (module_inst->handler[index].used && module_inst->handler[index].callback_enable) {
-			handler = &module_inst->handler[index];
-			if ((int)(handler->expire_time - sw_timer_tick) < 0 && handler->busy == 0) {
-				/* Enter critical section. */
-				handler->busy = 1;
-				/* Timer was expired. */
-				if (handler->period > 0) {
-					handler->expire_time = sw_timer_tick + handler->period;
-				} else {
-					/* One shot. */
-					handler->callback_enable = 0;
-				}
-				/* Call callback function. */
-				handler->callback(module_inst, index, handler->context, handler->period);
-				/* Leave critical section. */
-				handler->busy = 0;
-			}
+	/* Only the root of the heap has to be checked, everything below it expires later. */
+	while (module_inst->heap_size > 0) {
+		index = module_inst->heap[0];
+		handler = &module_inst->handler[index];
+		if ((int)(handler->expire_time - sw_timer_tick) >= 0 || handler->busy) {
+			break;
 		}
+		/* Enter critical section. */
+		handler->busy = 1;
+		/* Timer was expired. Reschedule it before the callback so that the callback can re-arm or cancel it. */
+		if (handler->period > 0) {
+			handler->expire_time = sw_timer_tick + handler->period;
+			sw_timer_heap_sift_down(module_inst, 0);
+		} else {
+			/* One shot. */
+			sw_timer_heap_remove(module_inst, index);
+			handler->callback_enable = 0;
+		}
+		/* Call callback function. */
+		handler->callback(module_inst, index, handler->context, handler->period);
+		/* Leave critical section. */
+		handler->busy = 0;
+	}
+}
+
+uint32_t sw_timer_next_expiry(struct sw_timer_module *const module_inst)
+{
+	int32_t ticks;
+
+	Assert(module_inst);
+
+	if (module_inst->heap_size == 0) {
+		return SW_TIMER_NO_EXPIRY;
+	}
+
+	/* A timer fires on the first tick after its expire time. */
+	ticks = (int32_t)(module_inst->handler[module_inst->heap[0]].expire_time - sw_timer_tick) + 1;
+	if (ticks <= 0) {
+		return 0;
 	}
+	return (uint32_t)ticks * module_inst->accuracy;
 }
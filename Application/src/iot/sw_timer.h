@@ -87,14 +87,23 @@ struct sw_timer_handle {
 	uint32_t period;
 	/** Expired time of timer. */
 	uint32_t expire_time;
+	/** Position of this timer in the deadline heap. Only valid while callback_enable is set. */
+	uint8_t heap_index;
 };
 
+/** Returned by \ref sw_timer_next_expiry when no timer callback is enabled. */
+#define SW_TIMER_NO_EXPIRY         UINT32_MAX
+
 /**
  * \brief SW timer module structure
  */
 struct sw_timer_module {
 	/** Timer handler instances. */
 	struct sw_timer_handle handler[CONF_SW_TIMER_COUNT];
+	/** Binary min-heap of enabled timer IDs, ordered by expire_time. */
+	uint8_t heap[CONF_SW_TIMER_COUNT];
+	/** Number of timer IDs in the heap. */
+	uint8_t heap_size;
 #if (SAMD21)
 	/** Instance of TCC. */
 	struct tcc_module tcc_inst;
@@ -183,6 +192,27 @@ void sw_timer_disable_callback(struct sw_timer_module *const module_inst, int ti
  */
 void sw_timer_task(struct sw_timer_module *const module_inst);
 
+/**
+ * \brief Get the time left until the next timer expires.
+ *
+ * Lets the caller sleep until the next timer is due instead of polling \ref sw_timer_task.
+ *
+ * \param[in]  module_inst     Pointer of timer.
+ *
+ * \return Milliseconds until the earliest enabled timer expires, zero if one is already due,
+ *         or \ref SW_TIMER_NO_EXPIRY if no timer callback is enabled.
+ */
+uint32_t sw_timer_next_expiry(struct sw_timer_module *const module_inst);
+
+#if defined(SW_TIMER_HOST)
+/**
+ * \brief Advance the tick count. Host builds have no TCC, the host tests drive the clock themselves.
+ *
+ * \param[in]  ticks           Ticks (of accuracy milliseconds) to add.
+ */
+void sw_timer_host_advance(uint32_t ticks);
+#endif
+
 #ifdef __cplusplus
 }
 #endif
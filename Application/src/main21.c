@@ -13,7 +13,7 @@
 
 #include "CliThread/CliThread.h"
 #include "FreeRTOS.h"
-#include "I2cDriver\I2cDriver.h"
+#include "I2cDriver/I2cDriver.h"
 #include "SerialConsole.h"
 #include "WifiHandlerThread/WifiHandler.h"
 #include "asf.h"
@@ -22,6 +22,10 @@
 #include "stdio_serial.h"
 #include "rtc.h"
 #include "adc_spi.h"
+#include "IMU/ImuFifo.h"
+#include "SysInit/SysInit.h"
+#include "CaptureSegments/CaptureSegments.h"
+#include "DeviceId/DeviceId.h"
 
 /****
  * Defines and Types
@@ -53,6 +57,8 @@ static TaskHandle_t uiTaskHandle = NULL;        //!< UI task handle
 static TaskHandle_t controlTaskHandle = NULL;   //!< Control task handle
 static TaskHandle_t rtcTaskHandle = NULL;
 static TaskHandle_t adcSpiTaskHandle = NULL;
+static TaskHandle_t imuFifoTaskHandle = NULL;  //!< IMU FIFO task handle
+static TaskHandle_t segmentsTaskHandle = NULL;  //!< SD capture segments task handle
 
 char bufferPrint[64];   ///< Buffer for daemon task
 
@@ -65,6 +71,9 @@ int main(void) {
     /* Initialize the board. */
     system_init();
 
+    /* Count this boot, it keys what the analyzer publishes. */
+    DeviceIdInit();
+
     /* Initialize the UART console. */
     InitializeSerialConsole();
 
@@ -87,16 +96,20 @@ int main(void) {
 void vApplicationDaemonTaskStartupHook(void) {
     SerialConsoleWriteString("\r\n\r\n-----ESE516 Main Program-----\r\n");
 
-    // Initialize HW that needs FreeRTOS Initialization
+    // Start every task first. Each one waits for its own prerequisites (see SysInit.c), so nothing waits on the network.
+    SysInitInitialize();
+    StartTasks();
+
+    // Initialize HW that needs FreeRTOS Initialization. Runs below the priority of the tasks above.
     SerialConsoleWriteString("\r\n\r\nInitialize HW...\r\n");
+    SysInitStart(SYS_INIT_I2C, 0);
     if (I2cInitializeDriver() != STATUS_OK) {
         SerialConsoleWriteString("Error initializing I2C Driver!\r\n");
     } else {
         SerialConsoleWriteString("Initialized I2C Driver!\r\n");
+        SysInitReady(SYS_INIT_I2C);
     }
 
-    StartTasks();
-
     vTaskSuspend(daemonTaskHandle);
 }
 
@@ -111,7 +124,13 @@ static void StartTasks(void) {
     snprintf(bufferPrint, 64, "Heap before starting tasks: %d\r\n", xPortGetFreeHeapSize());
     SerialConsoleWriteString(bufferPrint);
 
-    // Initialize Tasks here
+    // Initialize Tasks here. Capture first.
+
+    if (xTaskCreate(vImuFifoTask, "IMU_FIFO_TASK", IMU_FIFO_TASK_SIZE, NULL, IMU_FIFO_PRIORITY, &imuFifoTaskHandle) != pdPASS) {
+        SerialConsoleWriteString("ERR: IMU FIFO task could not be initialized!\r\n");
+    }
+    snprintf(bufferPrint, 64, "Heap after starting IMU FIFO: %d\r\n", xPortGetFreeHeapSize());
+    SerialConsoleWriteString(bufferPrint);
 
     if (xTaskCreate(vCommandConsoleTask, "CLI_TASK", CLI_TASK_SIZE, NULL, CLI_PRIORITY, &cliTaskHandle) != pdPASS) {
         SerialConsoleWriteString("ERR: CLI task could not be initialized!\r\n");
@@ -131,6 +150,12 @@ static void StartTasks(void) {
         SerialConsoleWriteString("ERR: WIFI task could not be initialized!\r\n");
     }
     snprintf(bufferPrint, 64, "Heap after starting WIFI: %d\r\n", xPortGetFreeHeapSize());
+    SerialConsoleWriteString(bufferPrint);
+
+    if (xTaskCreate(vCaptureSegmentsTask, "SEGMENTS_TASK", CAPTURE_SEGMENTS_TASK_SIZE, NULL, CAPTURE_SEGMENTS_PRIORITY, &segmentsTaskHandle) != pdPASS) {
+        SerialConsoleWriteString("ERR: Segments task could not be initialized!\r\n");
+    }
+    snprintf(bufferPrint, 64, "Heap after starting SEGMENTS: %d\r\n", xPortGetFreeHeapSize());
     SerialConsoleWriteString(bufferPrint);
 	
 	/*if (xTaskCreate(vAdcSpiTask, "ADC_SPI_TASK", ADC_SPI_TASK_SIZE, NULL, ADC_SPI_PRIORITY, &adcSpiTaskHandle) != pdPASS) {
@@ -18,6 +18,7 @@
 #include <string.h>
 
 #include "ASF/sam0/drivers/dsu/crc32/crc32.h"
+#include "BootControl/BootControl.h"
 #include "SD Card/SdCard.h"
 #include "SerialConsole/SerialConsole.h"
 #include "Systick/Systick.h"
@@ -30,6 +31,7 @@
 #define APP_START_RESET_VEC_ADDRESS (APP_START_ADDRESS + (uint32_t) 0x04)   ///< Main application reset vector address
 #define STATUS_OK		0
 #define STATUS_ERR		1
+//#define BOOT_TIME_MEASURE   ///< Uncomment to print how long the fast boot decision takes (from main() to the jump)
 
 /******************************************************************************
  * Structures and Enumerations
@@ -43,6 +45,10 @@ struct usart_module cdc_uart_module;   ///< Structure for UART module connected
 static void jumpToApplication(void);
 static bool StartFilesystemAndTest(void);
 static void configure_nvm(void);
+#ifdef BOOT_TIME_MEASURE
+static void BootTimeStart(void);
+static void BootTimeReport(void);
+#endif
 
 /******************************************************************************
  * Global Variables
@@ -69,6 +75,21 @@ FIL file_object;                               // FILE OBJECT used on main for t
 
 int main(void) {
 
+    /*0.) FAST BOOT. DECIDE BEFORE ANY CLOCK OR PERIPHERAL IS TOUCHED*/
+#ifdef BOOT_TIME_MEASURE
+    BootTimeStart();
+#endif
+    // Without a pending update there is nothing to read from the SD card, so jump straight to the application.
+    uint8_t pendingImage = 0;
+    enum BootAction bootAction = BootControlDecide(BootControlGet(), *(uint32_t *) APP_START_ADDRESS, *(uint32_t *) APP_START_RESET_VEC_ADDRESS, &pendingImage);
+    if (bootAction == BOOT_ACTION_JUMP) {
+#ifdef BOOT_TIME_MEASURE
+        BootTimeReport();
+#endif
+        jumpToApplication();
+    }
+    /*END FAST BOOT*/
+
     /*1.) INIT SYSTEM PERIPHERALS INITIALIZATION*/
     system_init();
     delay_init();
@@ -119,23 +140,32 @@ int main(void) {
 	
 	// Check which flag file (FlagA.txt or FlagB.txt) is present in the SD card
 	// Set a variable called firmwareFlag appropriately
+	// The boot control record names the image directly. Flag files are only probed when recovering.
 	int firmwareFlag = 0;
-	FRESULT fileFlagStatus;
-	fileFlagStatus = f_open(&file_object, flagA, FA_OPEN_EXISTING);
-	if(fileFlagStatus == FR_OK && firmwareFlag == 0)
+	if(bootAction == BOOT_ACTION_UPDATE)
 	{
-		firmwareFlag = 1;
-		SerialConsoleWriteString("FlagA.txt found. Flashing firmware TestA.bin\r\n");
-		
+		firmwareFlag = pendingImage;
+		SerialConsoleWriteString(firmwareFlag == BOOT_CONTROL_IMAGE_A ? "Update pending. Flashing firmware TestA.bin\r\n" : "Update pending. Flashing firmware TestB.bin\r\n");
 	}
-	
-	fileFlagStatus = f_open(&file_object, flagB, FA_OPEN_EXISTING);
-	if(fileFlagStatus == FR_OK && firmwareFlag == 0)
+	else
 	{
-		firmwareFlag = 2;
-		SerialConsoleWriteString("FlagB.txt found. Flashing firmware TestB.bin\r\n");
+		FRESULT fileFlagStatus;
+		fileFlagStatus = f_open(&file_object, flagA, FA_OPEN_EXISTING);
+		if(fileFlagStatus == FR_OK && firmwareFlag == 0)
+		{
+			firmwareFlag = 1;
+			SerialConsoleWriteString("FlagA.txt found. Flashing firmware TestA.bin\r\n");
+			
+		}
+		
+		fileFlagStatus = f_open(&file_object, flagB, FA_OPEN_EXISTING);
+		if(fileFlagStatus == FR_OK && firmwareFlag == 0)
+		{
+			firmwareFlag = 2;
+			SerialConsoleWriteString("FlagB.txt found. Flashing firmware TestB.bin\r\n");
+		}
+		f_close(&file_object);
 	}
-	f_close(&file_object);
 	
 	if(firmwareFlag != 0)
 	{
@@ -240,6 +270,12 @@ int main(void) {
 		f_close(&file_object);
 	
 		SerialConsoleWriteString("Closed File");
+
+		// Following boots take the fast path again
+		if(BootControlClear() != STATUS_OK)
+		{
+			SerialConsoleWriteString("Could not clear boot control record\r\n");
+		}
 		}
 	
     /* END BOOTLOADER HERE!*/
@@ -386,6 +422,48 @@ static void jumpToApplication(void) {
     applicationCodeEntry();
 }
 
+#ifdef BOOT_TIME_MEASURE
+/**
+ * function      static void BootTimeStart(void)
+ * @brief        Starts SysTick as a free running down counter on the CPU clock
+ * @details      Called first thing in main(), before system_init(). The CPU then still runs on the reset clock.
+ * @return
+ ******************************************************************************/
+static void BootTimeStart(void) {
+    SysTick->CTRL = 0;
+    SysTick->LOAD = SysTick_LOAD_RELOAD_Msk;
+    SysTick->VAL = 0;
+    SysTick->CTRL = SysTick_CTRL_CLKSOURCE_Msk | SysTick_CTRL_ENABLE_Msk;
+}
+
+/**
+ * function      static void BootTimeReport(void)
+ * @brief        Prints the time spent since BootTimeStart()
+ * @details      Reads the counter first, then brings up the clocks and the UART to print it. The time spent
+ *				printing is not part of the measurement. Leaves SysTick stopped for the application.
+ * @return
+ ******************************************************************************/
+static void BootTimeReport(void) {
+    uint32_t elapsedCycles = SysTick_LOAD_RELOAD_Msk - SysTick->VAL;
+    uint32_t cpuHz = system_cpu_clock_get_hz();
+    char bootTimeBuf[64];
+
+    SysTick->CTRL = 0;
+    system_init();
+    delay_init();
+    InitializeSerialConsole();
+    system_interrupt_enable_global();
+
+    snprintf(bootTimeBuf, sizeof(bootTimeBuf), "Fast boot: %lu cycles, %lu us\r\n", (unsigned long) elapsedCycles,
+             (unsigned long) (((uint64_t) elapsedCycles * 1000000UL) / cpuHz));
+    SerialConsoleWriteString(bootTimeBuf);
+    delay_cycles_ms(100);   // Delay to allow print
+
+    DeinitializeSerialConsole();
+    SysTick->CTRL = 0;
+}
+#endif
+
 /**
  * function      static void configure_nvm(void)
  * @brief        Configures the NVM driver
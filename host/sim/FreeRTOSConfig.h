@@ -0,0 +1,79 @@
+/**************************************************************************/ /**
+ * @file      FreeRTOSConfig.h
+ * @brief     Kernel configuration of the firmware simulator. Mirrors config/FreeRTOSConfig.h of the firmware, so the
+ *            tasks run with the same priorities, tick, timers and run time statistics; the differences are marked.
+ * @date      2026-10-19
+
+ ******************************************************************************/
+
+#ifndef FREERTOS_CONFIG_H
+#define FREERTOS_CONFIG_H
+
+#include <stdint.h>
+
+void SimAssert(const char *file, int line);
+void TaskStatsInit(void);
+uint32_t TaskStatsRunTimeCounter(void);
+
+#define configUSE_PREEMPTION 1
+#define configUSE_IDLE_HOOK 0
+#define configUSE_TICK_HOOK 0
+#define configCPU_CLOCK_HZ (48000000UL)  // system_gclk_gen_get_hz(GCLK_GENERATOR_0) of the target
+#define configTICK_RATE_HZ ((TickType_t)1000)
+#define configMAX_PRIORITIES (5)
+#define configMINIMAL_STACK_SIZE ((unsigned short)100)
+#define configTOTAL_HEAP_SIZE ((size_t)(3 * 11520))  // Differs: TCBs, stack words and queue pointers are twice as wide
+#define configMAX_TASK_NAME_LEN (8)
+#define configUSE_TRACE_FACILITY 1
+#define configUSE_16_BIT_TICKS 0
+#define configIDLE_SHOULD_YIELD 1
+#define configUSE_MUTEXES 1
+#define configQUEUE_REGISTRY_SIZE 0
+#define configCHECK_FOR_STACK_OVERFLOW 0  // Differs: the tasks run on host thread stacks, see port.c
+#define configUSE_RECURSIVE_MUTEXES 1
+#define configUSE_MALLOC_FAILED_HOOK 1
+#define configUSE_COUNTING_SEMAPHORES 1
+#define configUSE_QUEUE_SETS 1
+#define configGENERATE_RUN_TIME_STATS 1
+#define portCONFIGURE_TIMER_FOR_RUN_TIME_STATS() TaskStatsInit()
+#define portGET_RUN_TIME_COUNTER_VALUE() TaskStatsRunTimeCounter()
+#define configENABLE_BACKWARD_COMPATIBILITY 1
+#define configUSE_DAEMON_TASK_STARTUP_HOOK 1
+#define configUSE_TICKLESS_IDLE 1  // Differs: the idle task sleeps until the next interrupt instead of spinning
+
+#define configUSE_CO_ROUTINES 0
+#define configMAX_CO_ROUTINE_PRIORITIES (2)
+
+#define configUSE_TIMERS 1
+#define configTIMER_TASK_PRIORITY (2)
+#define configTIMER_QUEUE_LENGTH 5
+#define configTIMER_TASK_STACK_DEPTH (128)
+
+#define INCLUDE_vTaskPrioritySet 1
+#define INCLUDE_uxTaskPriorityGet 1
+#define INCLUDE_vTaskDelete 1
+#define INCLUDE_vTaskSuspend 1
+#define INCLUDE_xResumeFromISR 1
+#define INCLUDE_vTaskDelayUntil 1
+#define INCLUDE_vTaskDelay 1
+#define INCLUDE_xTaskGetSchedulerState 1
+#define INCLUDE_xTaskGetCurrentTaskHandle 1
+#define INCLUDE_uxTaskGetStackHighWaterMark 1
+#define INCLUDE_xTaskGetIdleTaskHandle 0
+#define INCLUDE_xTimerGetTimerDaemonTaskHandle 0
+#define INCLUDE_pcTaskGetTaskName 0
+#define INCLUDE_eTaskGetState 0
+
+// Differs: a failed assertion stops the simulator with its location instead of hanging
+#define configASSERT(x)                   \
+    if ((x) == 0) {                       \
+        SimAssert(__FILE__, __LINE__);    \
+    }
+
+#define configCOMMAND_INT_MAX_OUTPUT_SIZE 32
+
+// Differs: FreeRTOS+Trace is not built, its recorder reads the cycle counter of the target
+#define TRC_START 1
+#define vTraceEnable(startOption) ((void)(startOption))
+
+#endif /* FREERTOS_CONFIG_H */
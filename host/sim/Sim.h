@@ -0,0 +1,47 @@
+/**************************************************************************/ /**
+ * @file      Sim.h
+ * @brief     Services of the simulator port (port.c) to the peripheral models: interrupt lines, the clock and the
+ *            lock of the state the models share with their host threads.
+ * @details   A model runs its I/O in a host thread of its own, started with SimThreadStart so that interrupts never
+ *            land in it. When something happened it pends its interrupt line; the handler then runs on the thread of
+ *            the task that was running, in interrupt context, and calls the firmware callbacks like the ASF
+ *            interrupt handlers do. State shared by the host thread and the firmware is only touched under SimLock,
+ *            which also masks the interrupts, so a task never blocks on a lock held by a task that is switched out.
+ * @date      2026-10-19
+
+ ******************************************************************************/
+
+#pragma once
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/// Interrupt lines, in the order their handlers run when several are pending
+enum SimIrq {
+    SIM_IRQ_DMA,     ///< DMAC transfer done, see SimAsf.c
+    SIM_IRQ_USART,   ///< Console SERCOM received a character
+    SIM_IRQ_I2C,     ///< Sensor SERCOM finished a transfer, see SimI2c.c
+    SIM_IRQ_EXTINT,  ///< External interrupt controller
+    SIM_IRQ_WINC,    ///< WINC1500 IRQN line, see SimWinc.c
+    SIM_IRQ_TCC,     ///< TCC0 overflow of the software timer
+    SIM_IRQ_COUNT
+};
+
+typedef void (*SimIsr)(void);
+
+#define SIM_CPU_HZ 48000000UL  ///< GCLK generator 0 of the target
+
+void SimIrqRegister(enum SimIrq irq, SimIsr isr);
+void SimIrqPend(enum SimIrq irq);
+bool SimInIsr(void);
+
+uint64_t SimNowNs(void);
+uint64_t SimTickNs(void);
+
+void SimLock(void);
+void SimUnlock(void);
+int SimThreadStart(void *(*run)(void *), void *arg);
+
+void SimLog(const char *format, ...) __attribute__((format(printf, 1, 2)));
+void SimSetRunTime(uint32_t seconds);
@@ -0,0 +1,883 @@
+/**************************************************************************/ /**
+ * @file      SimAsf.c
+ * @brief     ASF drivers of the firmware simulator and the peripherals behind them: the console USART and its DMA
+ *            channels on a pseudo terminal, the external interrupts, the flash at its target addresses, the board
+ *            pins, the SD card slot and the TCC that counts the software timer.
+ * @details   The console keeps the timing of the target: a host thread feeds received characters one by one at the
+ *            configured baud rate, into the two character FIFO of the SERCOM or, while the RX DMA channel runs, into
+ *            its ring, holding them back rather than overrunning the FIFO, and a TX transfer completes after the time
+ *            its characters take on the wire. Output that no terminal reads is dropped, as it is on an unconnected
+ *            UART.
+ *
+ *            The flash is a file mapped read-only at the NVM addresses the firmware reads, so BootControl and
+ *            DeviceId find their rows where they are on the target; the NVM driver programs it through the file with
+ *            the bits only going from 1 to 0. The serial number words of the chip are mapped at their address too.
+ * @date      2026-10-19
+
+ ******************************************************************************/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "asf.h"
+#include "../stubs/HostDisk.h"
+#include "Sim.h"
+#include "SimModels.h"
+#include "sw_timer.h"
+
+#define SIM_FLASH_MAP_START 0x10000          ///< Lowest flash address mapped, the host reserves the page at 0
+#define SIM_SERIAL_PAGE 0x0080A000           ///< Page of the serial number words of the SAMD21
+#define SIM_USART_FIFO 3                     ///< Characters the SERCOM holds: two in the FIFO, one in the shifter
+#define SIM_USART_MAX_BAUD 3000000           ///< 48 MHz with 16x oversampling
+#define SIM_TX_MAX 0x10000                   ///< Largest DMA block, BTCNT is 16 bit
+#define SIM_TCC_PERIOD_NS (100 * 1000000ull)  ///< sw_timer accuracy the firmware configures
+#define SIM_CONSOLE_ENV "SIM_CONSOLE_FD"    ///< Pseudo terminal kept across system_reset
+
+/// A DMA channel as dma_allocate hands it out
+struct SimDmaChannel {
+    struct dma_resource *resource;
+    uint8_t trigger;
+    bool active;
+    bool done;  ///< Transfer finished, its interrupt is pending
+};
+
+Sercom simSercom[6];
+Dmac simDmac = {.CHINTFLAG = {DMAC_CHINTFLAG_SUSP}};
+SCB_Type simScb;
+
+static char **simArgv;
+COMPILER_ALIGNED(16) static DmacDescriptor simDmaWriteBack[CONF_MAX_USED_CHANNEL_NUM];
+
+/* State below is guarded by SimLock */
+static struct SimDmaChannel simDma[CONF_MAX_USED_CHANNEL_NUM];
+static uint8_t simDmaAllocated = 0;
+static struct usart_module *simUsart = NULL;  ///< The console, the only USART the firmware runs
+static bool simUsartEnabled = false;
+static uint8_t simUsartFifo[SIM_USART_FIFO];
+static uint8_t simUsartFifoLen = 0;
+static int simTxChannel = -1;  ///< Channel whose transfer the TX thread sends, -1 for none
+static uint8_t simTxData[SIM_TX_MAX];
+static uint32_t simTxLen = 0;
+static bool simDiskAttached = false;
+
+static int simConsoleIn = -1;
+static int simConsoleOut = -1;
+static int simConsoleSlave = -1;  ///< Pseudo terminal slave, kept open so output without a reader can be dropped
+static int simTxWake[2] = {-1, -1};
+static int simFlashFd = -1;
+
+static extint_callback_t simExtintCallback[EXTINT_CHANNELS];
+static volatile uint16_t simExtintEnabled = 0;
+static volatile uint16_t simExtintPending = 0;
+static uint8_t simExtintCurrent = 0;
+static volatile uint8_t simPinLevel[64];
+
+/******************************************************************************
+ * Local Functions
+ ******************************************************************************/
+
+static void prvSleepUntil(uint64_t ns)
+{
+    struct timespec ts;
+    uint64_t now = SimNowNs();
+
+    if (ns > now) {
+        ts.tv_sec = (time_t)((ns - now) / 1000000000ull);
+        ts.tv_nsec = (long)((ns - now) % 1000000000ull);
+        while (nanosleep(&ts, &ts) != 0 && errno == EINTR) {
+        }
+    }
+}
+
+/// Time a character takes on the wire at the console baud rate, 8N1
+static uint64_t prvCharNs(void)
+{
+    uint32_t baud = (simUsart != NULL && simUsart->baudrate != 0) ? simUsart->baudrate : 115200;
+    return 10 * 1000000000ull / baud;
+}
+
+/// Receives one character on the console, false while the SERCOM has no room for it. Called with SimLock held.
+static bool prvUsartReceive(uint8_t c)
+{
+    for (int id = 0; id < simDmaAllocated; id++) {
+        struct SimDmaChannel *channel = &simDma[id];
+        DmacDescriptor *wb = &simDmaWriteBack[id];
+
+        if (channel->active && channel->trigger == SERCOM4_DMAC_ID_RX) {
+            DmacDescriptor *desc = channel->resource->descriptor;
+            uint16_t remaining = __atomic_load_n(&wb->BTCNT.reg, __ATOMIC_RELAXED);
+            uint8_t *ring = (uint8_t *)(uintptr_t)(wb->DSTADDR.reg - desc->BTCNT.reg);
+
+            ring[desc->BTCNT.reg - remaining] = c;
+            if (--remaining == 0 && wb->DESCADDR.reg != 0) {
+                *wb = *(DmacDescriptor *)(uintptr_t)wb->DESCADDR.reg;
+                remaining = wb->BTCNT.reg;
+            }
+            __atomic_store_n(&wb->BTCNT.reg, remaining, __ATOMIC_RELEASE);  // The firmware reads it without a lock
+            if (remaining == 0) {
+                channel->active = false;
+                channel->done = true;
+                SimIrqPend(SIM_IRQ_DMA);
+            }
+            return true;
+        }
+    }
+    if (simUsartFifoLen == SIM_USART_FIFO) {
+        return false;
+    }
+    simUsartFifo[simUsartFifoLen++] = c;
+    SimIrqPend(SIM_IRQ_USART);
+    return true;
+}
+
+/// Console receiver: one character per character time, from the terminal. A character the full FIFO cannot take
+/// waits for the next character time, as with flow control, since the host may run the interrupt late.
+static void *prvConsoleRxThread(void *arg)
+{
+    uint8_t data[64];
+    uint64_t next = 0;
+    ssize_t len;
+    bool taken;
+
+    while ((len = read(simConsoleIn, data, sizeof(data))) != 0) {
+        if (len < 0) {
+            if (errno == EINTR || errno == EAGAIN) {
+                continue;
+            }
+            break;
+        }
+        for (ssize_t i = 0; i < len; i++) {
+            do {
+                uint64_t now = SimNowNs();
+                next = ((next > now) ? next : now) + prvCharNs();
+                prvSleepUntil(next);
+                SimLock();
+                taken = !simUsartEnabled || prvUsartReceive(data[i]);
+                SimUnlock();
+            } while (!taken);
+        }
+    }
+    return NULL;
+}
+
+/// Writes console output. A pseudo terminal nobody reads drops what it holds, like an unconnected UART.
+static void prvConsoleWrite(const uint8_t *data, size_t len)
+{
+    while (len > 0) {
+        ssize_t written = write(simConsoleOut, data, len);
+        if (written > 0) {
+            data += written;
+            len -= (size_t)written;
+        } else if (written < 0 && errno == EAGAIN && simConsoleSlave >= 0) {
+            tcflush(simConsoleSlave, TCIFLUSH);
+        } else if (written < 0 && errno == EINTR) {
+            continue;
+        } else {
+            return;
+        }
+    }
+}
+
+/// Console transmitter: sends the transfer of the TX DMA channel and completes it after its time on the wire
+static void *prvConsoleTxThread(void *arg)
+{
+    static uint8_t data[SIM_TX_MAX];
+    uint64_t next = 0;
+    uint8_t wake;
+
+    while (read(simTxWake[0], &wake, 1) >= 0) {
+        uint32_t len;
+        int channel;
+        uint64_t now = SimNowNs();
+
+        SimLock();
+        channel = simTxChannel;
+        len = simTxLen;
+        memcpy(data, simTxData, len);
+        next = ((next > now) ? next : now) + len * prvCharNs();
+        SimUnlock();
+        if (channel < 0) {
+            continue;
+        }
+
+        prvConsoleWrite(data, len);
+        prvSleepUntil(next);
+
+        SimLock();
+        if (simTxChannel == channel && simDma[channel].active) {
+            simDma[channel].active = false;
+            simDma[channel].done = true;
+            simTxChannel = -1;
+            SimIrqPend(SIM_IRQ_DMA);
+        }
+        SimUnlock();
+    }
+    return NULL;
+}
+
+/// SERCOM4 interrupt: hands the held characters to the read job, one callback per finished job
+static void prvUsartIsr(void)
+{
+    for (;;) {
+        struct usart_module *module;
+        bool done = false;
+
+        SimLock();
+        module = simUsart;
+        if (module == NULL || simUsartFifoLen == 0 || module->remaining_rx_buffer_length == 0) {
+            SimUnlock();
+            return;
+        }
+        *module->rx_buffer_ptr++ = simUsartFifo[0];
+        memmove(simUsartFifo, simUsartFifo + 1, --simUsartFifoLen);
+        if (--module->remaining_rx_buffer_length == 0) {
+            module->rx_status = STATUS_OK;
+            done = (module->callback_enable_mask & module->callback_reg_mask & (1 << USART_CALLBACK_BUFFER_RECEIVED)) != 0;
+        }
+        SimUnlock();
+        if (done) {
+            module->callback[USART_CALLBACK_BUFFER_RECEIVED](module);
+        }
+    }
+}
+
+/// DMAC interrupt: calls the done callback of every finished transfer
+static void prvDmaIsr(void)
+{
+    for (int id = 0; id < CONF_MAX_USED_CHANNEL_NUM; id++) {
+        struct dma_resource *resource = NULL;
+
+        SimLock();
+        if (simDma[id].done) {
+            simDma[id].done = false;
+            resource = simDma[id].resource;
+            resource->job_status = STATUS_OK;
+            resource->transfered_size = resource->descriptor->BTCNT.reg;
+        }
+        SimUnlock();
+        if (resource != NULL && (resource->callback_enable & (1 << DMA_CALLBACK_TRANSFER_DONE)) &&
+            resource->callback[DMA_CALLBACK_TRANSFER_DONE] != NULL) {
+            resource->callback[DMA_CALLBACK_TRANSFER_DONE](resource);
+        }
+    }
+}
+
+static void prvExtintIsr(void)
+{
+    uint16_t pending = __atomic_exchange_n(&simExtintPending, 0, __ATOMIC_SEQ_CST);
+
+    for (uint8_t line = 0; line < EXTINT_CHANNELS; line++) {
+        if ((pending & simExtintEnabled & (1u << line)) && simExtintCallback[line] != NULL) {
+            simExtintCurrent = line;
+            simExtintCallback[line]();
+        }
+    }
+}
+
+/// TCC0 of the software timer, which overflows every SIM_TCC_PERIOD_NS
+static void *prvTccThread(void *arg)
+{
+    uint64_t next = SimNowNs();
+
+    for (;;) {
+        next += SIM_TCC_PERIOD_NS;
+        prvSleepUntil(next);
+        SimIrqPend(SIM_IRQ_TCC);
+    }
+    return NULL;
+}
+
+static void prvTccIsr(void)
+{
+    sw_timer_host_advance(1);
+}
+
+/// Checks an NVM address range the way the NVM controller does
+static enum status_code prvNvmCheck(uint32_t address, uint32_t len, uint32_t align)
+{
+    if (address + len > FLASH_SIZE) {
+        return STATUS_ERR_BAD_ADDRESS;
+    }
+    if (address & (align - 1)) {
+        return STATUS_ERR_BAD_ADDRESS;
+    }
+    return (simFlashFd >= 0) ? STATUS_OK : STATUS_ERR_IO;
+}
+
+/******************************************************************************
+ * SimModels.h
+ ******************************************************************************/
+
+/// Keeps the command line to run again on system_reset
+void SimSetArgs(char **argv)
+{
+    simArgv = argv;
+}
+
+/// Opens the console: a new pseudo terminal, linked from path unless it is NULL, or stdin and stdout for "-". A
+/// pseudo terminal opened before system_reset is taken over, so a terminal program stays connected.
+int SimConsoleOpen(const char *path)
+{
+    const char *inherited = getenv(SIM_CONSOLE_ENV);
+    struct termios raw;
+    char fds[32];
+    int master;
+
+    if (path != NULL && strcmp(path, "-") == 0) {
+        simConsoleIn = STDIN_FILENO;
+        simConsoleOut = STDOUT_FILENO;
+        return 0;
+    }
+    if (inherited == NULL || sscanf(inherited, "%d,%d", &master, &simConsoleSlave) != 2) {
+        master = posix_openpt(O_RDWR | O_NOCTTY);
+        if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0) {
+            return -1;
+        }
+        simConsoleSlave = open(ptsname(master), O_RDWR | O_NOCTTY);
+        if (simConsoleSlave < 0 || tcgetattr(simConsoleSlave, &raw) != 0) {
+            return -1;
+        }
+        cfmakeraw(&raw);
+        tcsetattr(simConsoleSlave, TCSANOW, &raw);
+        snprintf(fds, sizeof(fds), "%d,%d", master, simConsoleSlave);
+        setenv(SIM_CONSOLE_ENV, fds, 1);
+    }
+    fcntl(master, F_SETFL, fcntl(master, F_GETFL) | O_NONBLOCK);
+    simConsoleIn = dup(master);
+    simConsoleOut = master;
+    fcntl(simConsoleIn, F_SETFL, fcntl(simConsoleIn, F_GETFL) & ~O_NONBLOCK);  // Shares the file status flags
+    if (path != NULL) {
+        unlink(path);
+        if (symlink(ptsname(master), path) != 0) {
+            return -1;
+        }
+    }
+    SimLog("sim: console on %s\n", ptsname(master));
+    return 0;
+}
+
+/// Maps the flash file at the flash addresses and the serial number of the chip at its own, creating an erased
+/// flash if the file does not exist
+int SimFlashOpen(const char *path, const uint32_t serial[4])
+{
+    static const uint32_t serialOffset[4] = {0x00C, 0x040, 0x044, 0x048};
+    struct stat st;
+    uint8_t *page;
+    void *flash;
+
+    simFlashFd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (simFlashFd < 0 || fstat(simFlashFd, &st) != 0) {
+        return -1;
+    }
+    if (st.st_size < FLASH_SIZE) {
+        uint8_t erased[NVMCTRL_ROW_SIZE];
+        memset(erased, 0xFF, sizeof(erased));
+        for (off_t offset = st.st_size & ~(off_t)(NVMCTRL_ROW_SIZE - 1); offset < FLASH_SIZE; offset += NVMCTRL_ROW_SIZE) {
+            if (pwrite(simFlashFd, erased, sizeof(erased), offset) != (ssize_t)sizeof(erased)) {
+                return -1;
+            }
+        }
+    }
+    flash = mmap((void *)SIM_FLASH_MAP_START, FLASH_SIZE - SIM_FLASH_MAP_START, PROT_READ, MAP_SHARED | MAP_FIXED_NOREPLACE,
+                 simFlashFd, SIM_FLASH_MAP_START);
+    page = mmap((void *)SIM_SERIAL_PAGE, 4096, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE,
+                -1, 0);
+    if (flash != (void *)SIM_FLASH_MAP_START || page != (void *)SIM_SERIAL_PAGE) {
+        SimLog("sim: cannot map the flash (vm.mmap_min_addr must be at most 0x%x)\n", SIM_FLASH_MAP_START);
+        return -1;
+    }
+    memset(page, 0xFF, 4096);
+    for (int i = 0; i < 4; i++) {
+        memcpy(page + serialOffset[i], &serial[i], sizeof(serial[i]));
+    }
+    mprotect(page, 4096, PROT_READ);
+    return 0;
+}
+
+/// Puts the image file in the SD card slot, formatting a new one of sectors if it does not exist. The format runs
+/// in a child process, so the FatFs work area and mutex it needs never come out of the firmware heap.
+int SimDiskOpen(const char *image, uint32_t sectors)
+{
+    if (access(image, F_OK) != 0) {
+        pid_t child = fork();
+        int status;
+
+        if (child == 0) {
+            static FATFS fs;
+            FRESULT res = HostDiskOpen(&fs, image, sectors, 0);
+            _exit((res == FR_OK) ? 0 : 1);
+        }
+        if (child < 0 || waitpid(child, &status, 0) != child || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            return -1;
+        }
+    }
+    if (HostDiskAttach(image) != FR_OK) {
+        return -1;
+    }
+    simDiskAttached = true;
+    return 0;
+}
+
+/// Starts the console threads and the timer, and hooks up the interrupts of this file
+void SimAsfStart(void)
+{
+    for (int pin = 0; pin < 64; pin++) {
+        simPinLevel[pin] = true;  // Pull-ups
+    }
+    simDmac.WRBADDR.reg = (uintptr_t)simDmaWriteBack;
+    SimIrqRegister(SIM_IRQ_DMA, prvDmaIsr);
+    SimIrqRegister(SIM_IRQ_USART, prvUsartIsr);
+    SimIrqRegister(SIM_IRQ_EXTINT, prvExtintIsr);
+    SimIrqRegister(SIM_IRQ_TCC, prvTccIsr);
+    if (simConsoleIn >= 0 && pipe2(simTxWake, O_CLOEXEC) == 0) {
+        SimThreadStart(prvConsoleRxThread, NULL);
+        SimThreadStart(prvConsoleTxThread, NULL);
+    }
+    SimThreadStart(prvTccThread, NULL);
+}
+
+/// Raises an external interrupt line, from any thread
+void SimExtintRaise(uint8_t line)
+{
+    __atomic_fetch_or(&simExtintPending, (uint16_t)(1u << line), __ATOMIC_SEQ_CST);
+    SimIrqPend(SIM_IRQ_EXTINT);
+}
+
+/// Stops the simulator on a failed configASSERT
+void SimAssert(const char *file, int line)
+{
+    SimLog("sim: assertion failed at %s:%d\n", file, line);
+    abort();
+}
+
+/******************************************************************************
+ * System, clock and interrupts
+ ******************************************************************************/
+
+void system_init(void)
+{
+}
+
+/// Starts the simulator over with the same command line, keeping the flash, the card and the console
+void system_reset(void)
+{
+    sigset_t all;
+    struct itimerval stop = {{0, 0}, {0, 0}};
+
+    // The new image blocks the signals itself once it runs, none may arrive in between
+    sigfillset(&all);
+    pthread_sigmask(SIG_BLOCK, &all, NULL);
+    setitimer(ITIMER_REAL, &stop, NULL);
+    SimLog("sim: system reset\n");
+    if (simArgv != NULL) {
+        execv("/proc/self/exe", simArgv);
+    }
+    SimLog("sim: reset failed: %s\n", strerror(errno));
+    _exit(1);
+}
+
+uint32_t system_cpu_clock_get_hz(void)
+{
+    return SIM_CPU_HZ;
+}
+
+void system_interrupt_enter_critical_section(void)
+{
+    vPortEnterCritical();
+}
+
+void system_interrupt_leave_critical_section(void)
+{
+    vPortExitCritical();
+}
+
+void delay_init(void)
+{
+}
+
+/// Busy waits like the cycle counting delay of the target
+void delay_cycles_us(uint32_t us)
+{
+    uint64_t end = SimNowNs() + (uint64_t)us * 1000;
+
+    while (SimNowNs() < end) {
+    }
+}
+
+void delay_cycles_ms(uint32_t ms)
+{
+    delay_cycles_us(ms * 1000);
+}
+
+/// SysTick as the caller would read it now: counting down from LOAD since the last tick was due
+const SysTick_Type *SimSysTick(void)
+{
+    static __thread SysTick_Type sysTick;
+    uint64_t now = SimNowNs();
+    uint64_t tick = SimTickNs();
+    uint64_t counts = (now > tick) ? (now - tick) * (SIM_CPU_HZ / 1000000) / 1000 : 0;
+
+    sysTick.CTRL = 0x7;
+    sysTick.LOAD = SIM_CPU_HZ / configTICK_RATE_HZ - 1;
+    sysTick.VAL = (counts < sysTick.LOAD) ? sysTick.LOAD - (uint32_t)counts : 0;
+    return &sysTick;
+}
+
+/******************************************************************************
+ * PORT
+ ******************************************************************************/
+
+void port_pin_set_output_level(const uint8_t gpio_pin, const bool level)
+{
+    simPinLevel[gpio_pin & 63] = level;
+}
+
+void port_pin_toggle_output_level(const uint8_t gpio_pin)
+{
+    simPinLevel[gpio_pin & 63] = !simPinLevel[gpio_pin & 63];
+}
+
+bool port_pin_get_input_level(const uint8_t gpio_pin)
+{
+    return simPinLevel[gpio_pin & 63];
+}
+
+/******************************************************************************
+ * USART
+ ******************************************************************************/
+
+void usart_get_config_defaults(struct usart_config *const config)
+{
+    memset(config, 0, sizeof(*config));
+    config->baudrate = 9600;
+}
+
+enum status_code usart_init(struct usart_module *const module, Sercom *const hw, const struct usart_config *const config)
+{
+    if (config->baudrate == 0 || config->baudrate > SIM_USART_MAX_BAUD) {
+        return STATUS_ERR_BAUDRATE_UNAVAILABLE;
+    }
+    SimLock();
+    memset(module, 0, sizeof(*module));
+    module->hw = hw;
+    module->baudrate = config->baudrate;
+    if (hw == EDBG_CDC_MODULE) {
+        simUsart = module;
+    }
+    SimUnlock();
+    return STATUS_OK;
+}
+
+void usart_enable(const struct usart_module *const module)
+{
+    SimLock();
+    if (module == simUsart) {
+        simUsartEnabled = true;
+    }
+    SimUnlock();
+}
+
+void usart_disable(const struct usart_module *const module)
+{
+    SimLock();
+    if (module == simUsart) {
+        simUsartEnabled = false;
+        simUsartFifoLen = 0;
+    }
+    SimUnlock();
+}
+
+void usart_register_callback(struct usart_module *const module, usart_callback_t callback_func,
+                             enum usart_callback callback_type)
+{
+    module->callback[callback_type] = callback_func;
+    module->callback_reg_mask |= (uint8_t)(1 << callback_type);
+}
+
+void usart_enable_callback(struct usart_module *const module, enum usart_callback callback_type)
+{
+    module->callback_enable_mask |= (uint8_t)(1 << callback_type);
+}
+
+void usart_disable_callback(struct usart_module *const module, enum usart_callback callback_type)
+{
+    module->callback_enable_mask &= (uint8_t)~(1 << callback_type);
+}
+
+/// Starts reading length characters; characters already held in the SERCOM are taken at once
+enum status_code usart_read_buffer_job(struct usart_module *const module, uint8_t *rx_data, uint16_t length)
+{
+    enum status_code status = STATUS_OK;
+
+    if (length == 0) {
+        return STATUS_ERR_INVALID_ARG;
+    }
+    SimLock();
+    if (module->remaining_rx_buffer_length > 0) {
+        status = STATUS_BUSY;
+    } else {
+        module->rx_buffer_ptr = rx_data;
+        module->remaining_rx_buffer_length = length;
+        module->rx_status = STATUS_BUSY;
+        if (simUsartFifoLen > 0) {
+            SimIrqPend(SIM_IRQ_USART);
+        }
+    }
+    SimUnlock();
+    return status;
+}
+
+enum status_code usart_write_wait(struct usart_module *const module, const uint16_t tx_data)
+{
+    uint8_t c = (uint8_t)tx_data;
+
+    prvConsoleWrite(&c, 1);
+    return STATUS_OK;
+}
+
+void stdio_serial_init(struct usart_module *const module, Sercom *const hw, const struct usart_config *const config)
+{
+    usart_init(module, hw, config);
+    usart_enable(module);
+}
+
+/******************************************************************************
+ * DMAC
+ ******************************************************************************/
+
+void dma_get_config_defaults(struct dma_resource_config *config)
+{
+    memset(config, 0, sizeof(*config));
+}
+
+enum status_code dma_allocate(struct dma_resource *resource, struct dma_resource_config *config)
+{
+    enum status_code status = STATUS_ERR_NOT_FOUND;
+
+    SimLock();
+    if (simDmaAllocated < CONF_MAX_USED_CHANNEL_NUM) {
+        memset(resource, 0, sizeof(*resource));
+        resource->channel_id = simDmaAllocated;
+        simDma[simDmaAllocated].resource = resource;
+        simDma[simDmaAllocated].trigger = config->peripheral_trigger;
+        simDmaAllocated++;
+        status = STATUS_OK;
+    }
+    SimUnlock();
+    return status;
+}
+
+void dma_descriptor_get_config_defaults(struct dma_descriptor_config *config)
+{
+    memset(config, 0, sizeof(*config));
+    config->descriptor_valid = true;
+    config->block_action = DMA_BLOCK_ACTION_INT;
+    config->src_increment_enable = true;
+    config->dst_increment_enable = true;
+}
+
+void dma_descriptor_create(DmacDescriptor *descriptor, struct dma_descriptor_config *config)
+{
+    descriptor->BTCTRL.reg = 0;
+    descriptor->BTCTRL.bit.VALID = config->descriptor_valid;
+    descriptor->BTCTRL.bit.BLOCKACT = config->block_action;
+    descriptor->BTCTRL.bit.BEATSIZE = config->beat_size;
+    descriptor->BTCTRL.bit.SRCINC = config->src_increment_enable;
+    descriptor->BTCTRL.bit.DSTINC = config->dst_increment_enable;
+    descriptor->BTCNT.reg = config->block_transfer_count;
+    descriptor->SRCADDR.reg = config->source_address;
+    descriptor->DSTADDR.reg = config->destination_address;
+    descriptor->DESCADDR.reg = config->next_descriptor_address;
+}
+
+enum status_code dma_add_descriptor(struct dma_resource *resource, DmacDescriptor *descriptor)
+{
+    resource->descriptor = descriptor;
+    return STATUS_OK;
+}
+
+void dma_register_callback(struct dma_resource *resource, dma_callback_t callback, enum dma_callback_type type)
+{
+    resource->callback[type] = callback;
+}
+
+void dma_enable_callback(struct dma_resource *resource, enum dma_callback_type type)
+{
+    resource->callback_enable |= (uint8_t)(1 << type);
+}
+
+/// Starts the channel on its descriptor. Only the console triggers are wired: TX takes the block to the
+/// transmitter at once, RX fills the block as characters arrive.
+enum status_code dma_start_transfer_job(struct dma_resource *resource)
+{
+    struct SimDmaChannel *channel = &simDma[resource->channel_id];
+    DmacDescriptor *desc = resource->descriptor;
+    enum status_code status = STATUS_OK;
+    bool wake = false;
+
+    SimLock();
+    if (channel->active) {
+        status = STATUS_BUSY;
+    } else if (channel->trigger == SERCOM4_DMAC_ID_TX) {
+        uint32_t start = desc->SRCADDR.reg - (desc->BTCTRL.bit.SRCINC ? desc->BTCNT.reg : 0);
+        memcpy(simTxData, (const void *)(uintptr_t)start, desc->BTCNT.reg);
+        simTxLen = desc->BTCNT.reg;
+        simTxChannel = resource->channel_id;
+        wake = true;
+    } else if (channel->trigger != SERCOM4_DMAC_ID_RX) {
+        status = STATUS_ERR_INVALID_ARG;
+    }
+    if (status == STATUS_OK) {
+        simDmaWriteBack[resource->channel_id] = *desc;
+        channel->active = true;
+        channel->done = false;
+        resource->job_status = STATUS_BUSY;
+    }
+    SimUnlock();
+    if (wake) {
+        uint8_t c = 0;
+        ssize_t written = write(simTxWake[1], &c, 1);
+        (void)written;
+    }
+    return status;
+}
+
+void dma_abort_job(struct dma_resource *resource)
+{
+    SimLock();
+    simDma[resource->channel_id].active = false;
+    simDma[resource->channel_id].done = false;
+    if (simTxChannel == resource->channel_id) {
+        simTxChannel = -1;
+    }
+    resource->job_status = STATUS_ABORTED;
+    SimUnlock();
+}
+
+/******************************************************************************
+ * EXTINT
+ ******************************************************************************/
+
+void extint_chan_get_config_defaults(struct extint_chan_conf *const config)
+{
+    memset(config, 0, sizeof(*config));
+    config->gpio_pin_pull = EXTINT_PULL_UP;
+    config->wake_if_sleeping = true;
+    config->detection_criteria = EXTINT_DETECT_FALLING;
+}
+
+void extint_chan_set_config(const uint8_t channel, const struct extint_chan_conf *const config)
+{
+}
+
+enum status_code extint_register_callback(const extint_callback_t callback, const uint8_t channel,
+                                          const enum extint_callback_type type)
+{
+    if (channel >= EXTINT_CHANNELS) {
+        return STATUS_ERR_INVALID_ARG;
+    }
+    if (simExtintCallback[channel] != NULL && simExtintCallback[channel] != callback) {
+        return STATUS_ERR_ALREADY_INITIALIZED;
+    }
+    simExtintCallback[channel] = callback;
+    return STATUS_OK;
+}
+
+enum status_code extint_chan_enable_callback(const uint8_t channel, const enum extint_callback_type type)
+{
+    if (channel >= EXTINT_CHANNELS) {
+        return STATUS_ERR_INVALID_ARG;
+    }
+    __atomic_fetch_or(&simExtintEnabled, (uint16_t)(1u << channel), __ATOMIC_SEQ_CST);
+    return STATUS_OK;
+}
+
+enum status_code extint_chan_disable_callback(const uint8_t channel, const enum extint_callback_type type)
+{
+    if (channel >= EXTINT_CHANNELS) {
+        return STATUS_ERR_INVALID_ARG;
+    }
+    __atomic_fetch_and(&simExtintEnabled, (uint16_t)~(1u << channel), __ATOMIC_SEQ_CST);
+    return STATUS_OK;
+}
+
+uint8_t extint_get_current_channel(void)
+{
+    return simExtintCurrent;
+}
+
+/******************************************************************************
+ * NVM
+ ******************************************************************************/
+
+void nvm_get_config_defaults(struct nvm_config *const config)
+{
+    config->manual_page_write = true;
+}
+
+enum status_code nvm_set_config(const struct nvm_config *const config)
+{
+    return STATUS_OK;
+}
+
+enum status_code nvm_erase_row(const uint32_t row_address)
+{
+    uint8_t erased[NVMCTRL_ROW_SIZE];
+    enum status_code status = prvNvmCheck(row_address, NVMCTRL_ROW_SIZE, NVMCTRL_ROW_SIZE);
+
+    if (status != STATUS_OK) {
+        return status;
+    }
+    memset(erased, 0xFF, sizeof(erased));
+    return (pwrite(simFlashFd, erased, sizeof(erased), row_address) == (ssize_t)sizeof(erased)) ? STATUS_OK : STATUS_ERR_IO;
+}
+
+/// Programs one page: bits only go from 1 to 0, as on the flash
+enum status_code nvm_write_buffer(const uint32_t destination_address, const uint8_t *buffer, uint16_t length)
+{
+    uint8_t page[NVMCTRL_PAGE_SIZE];
+    enum status_code status = prvNvmCheck(destination_address, length, NVMCTRL_PAGE_SIZE);
+
+    if (status != STATUS_OK) {
+        return status;
+    }
+    if (length > NVMCTRL_PAGE_SIZE) {
+        return STATUS_ERR_INVALID_ARG;
+    }
+    if (pread(simFlashFd, page, length, destination_address) != (ssize_t)length) {
+        return STATUS_ERR_IO;
+    }
+    for (uint16_t i = 0; i < length; i++) {
+        page[i] &= buffer[i];
+    }
+    return (pwrite(simFlashFd, page, length, destination_address) == (ssize_t)length) ? STATUS_OK : STATUS_ERR_IO;
+}
+
+/******************************************************************************
+ * SD/MMC: present when an image is attached
+ ******************************************************************************/
+
+void sd_mmc_init(void)
+{
+}
+
+sd_mmc_err_t sd_mmc_check(uint8_t slot)
+{
+    return (slot == 0 && simDiskAttached) ? SD_MMC_OK : SD_MMC_ERR_NO_CARD;
+}
+
+Ctrl_status sd_mmc_test_unit_ready(uint8_t slot)
+{
+    return (slot == 0 && simDiskAttached) ? CTRL_GOOD : CTRL_NO_PRESENT;
+}
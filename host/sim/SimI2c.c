@@ -0,0 +1,810 @@
+/**************************************************************************/ /**
+ * @file      SimI2c.c
+ * @brief     I2C master of the firmware simulator and the devices on the sensor bus: a DS3231 real time clock and
+ *            an LSM6DSO accelerometer with its FIFO, or the devices a script lists.
+ * @details   A transfer takes the time its bytes need on the bus at the configured baud rate, and is applied to the
+ *            addressed device when it completes; an address nobody answers is NACKed. The device models run on the
+ *            bus thread, which also lets the LSM6DSO batch its samples as time passes and raise INT1 on the FIFO
+ *            watermark, like the sensor does between two drains of the firmware.
+ *
+ *            The LSM6DSO FIFO follows the datasheet closely enough for ImuFifoDecoder: TAG_CNT advances per batch,
+ *            a timestamp word in 25 us ticks comes every DEC_TS_BATCH batches, and with compression the samples are
+ *            packed into 3xC and 2xC words when their deltas fit, with an uncompressed word forced every
+ *            UNCOPTR_RATE batches.
+ *
+ *            Script lines are "ADDR MODEL [ARGS]" with ADDR in hex: "68 ds3231", "6a lsm6dso [rest | sine MG HZ]"
+ *            or "50 regs BYTE..." for a plain register file. # starts a comment.
+ * @date      2026-10-19
+
+ ******************************************************************************/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "asf.h"
+#include "Sim.h"
+#include "SimModels.h"
+
+#define SIM_I2C_DEVICES 8
+#define SIM_I2C_RUN_NS 1000000ull  ///< Device models run at least every ms
+
+#define DS3231_TEMP_MSB 0x11
+#define DS3231_LAST_REG 0x12
+
+#define IMU_FUNC_CFG_ACCESS 0x01
+#define IMU_EMB_FUNC_EN_B 0x05
+#define IMU_FIFO_CTRL1 0x07
+#define IMU_FIFO_CTRL2 0x08
+#define IMU_FIFO_CTRL3 0x09
+#define IMU_FIFO_CTRL4 0x0A
+#define IMU_INT1_CTRL 0x0D
+#define IMU_WHO_AM_I 0x0F
+#define IMU_CTRL1_XL 0x10
+#define IMU_CTRL3_C 0x12
+#define IMU_CTRL10_C 0x19
+#define IMU_STATUS_REG 0x1E
+#define IMU_OUTX_L_A 0x28
+#define IMU_TIMESTAMP0 0x40
+#define IMU_FIFO_STATUS1 0x3A
+#define IMU_FIFO_STATUS2 0x3B
+#define IMU_FIFO_DATA_OUT_TAG 0x78
+#define IMU_FIFO_DATA_OUT_Z_H 0x7E
+#define IMU_FIFO_WORDS 512
+#define IMU_TAG_XL_NC 0x02
+#define IMU_TAG_TIMESTAMP 0x04
+#define IMU_TAG_XL_NC_T_2 0x06
+#define IMU_TAG_XL_NC_T_1 0x07
+#define IMU_TAG_XL_2XC 0x08
+#define IMU_TAG_XL_3XC 0x09
+#define IMU_LSB_PER_G 16393  ///< 0.061 mg/LSB at +-2 g
+#define IMU_TIMESTAMP_NS 25000
+
+struct SimI2cDevice;
+
+/// Behaviour of a device model. Hooks left NULL act as a plain register file.
+struct SimI2cModel {
+    const char *name;
+    int (*create)(struct SimI2cDevice *dev, char *args);
+    void (*begin)(struct SimI2cDevice *dev, bool read);  ///< Start of a transfer
+    uint8_t (*read)(struct SimI2cDevice *dev, uint8_t reg);
+    void (*write)(struct SimI2cDevice *dev, uint8_t reg, uint8_t value);
+    uint8_t (*next)(struct SimI2cDevice *dev, uint8_t reg);  ///< Register after reg in a burst
+    void (*run)(struct SimI2cDevice *dev, uint64_t nowNs);   ///< Time passed
+};
+
+struct SimI2cDevice {
+    uint8_t address;
+    uint8_t pointer;
+    uint8_t regs[256];
+    const struct SimI2cModel *model;
+};
+
+/// The LSM6DSO, one per bus
+struct SimImu {
+    uint8_t emb[256];  ///< Embedded functions bank
+    uint8_t fifo[IMU_FIFO_WORDS][7];
+    uint16_t fifoHead;
+    uint16_t fifoLevel;
+    uint8_t out[7];  ///< Word being read out of FIFO_DATA_OUT
+    uint64_t nextBatchNs;
+    uint64_t timestampBaseNs;
+    uint32_t batch;
+    int16_t pending[3][3];  ///< Samples not yet in the FIFO, oldest first, the newest is of the current batch
+    uint8_t pendingCount;
+    int16_t last[3];      ///< Last sample written, the reference of the next compressed deltas
+    uint32_t sinceUncompressed;
+    bool aboveWatermark;
+    double sineMg;
+    double sineHz;
+    uint32_t noise;
+};
+
+/// A transfer of the master. Guarded by SimLock.
+struct SimI2cJob {
+    struct i2c_master_module *module;
+    bool busy;      ///< Started, not yet handed back by the interrupt
+    bool complete;  ///< Done on the bus, interrupt pending
+    bool read;
+    uint8_t address;
+    uint16_t len;
+    uint8_t *dest;
+    uint64_t dueNs;
+    enum status_code status;
+    uint8_t data[65536];
+};
+
+static struct SimI2cDevice simI2cDevices[SIM_I2C_DEVICES];
+static uint8_t simI2cDeviceCount = 0;
+static struct SimImu simImu;
+static struct SimI2cJob simI2cJob;
+static time_t simRtcOffset = 0;  ///< DS3231 time minus host time
+static int simI2cWake[2] = {-1, -1};
+
+/******************************************************************************
+ * DS3231
+ ******************************************************************************/
+
+static uint8_t prvBcd(int value)
+{
+    return (uint8_t)(((value / 10) << 4) | (value % 10));
+}
+
+static int prvFromBcd(uint8_t value)
+{
+    return (value >> 4) * 10 + (value & 0x0F);
+}
+
+/// Seconds since the epoch. Not time(): rtc.c of the firmware defines a global of that name, which the link binds
+/// every call of time() to.
+static time_t prvWallClock(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return ts.tv_sec;
+}
+
+static int prvRtcCreate(struct SimI2cDevice *dev, char *args)
+{
+    dev->regs[0x0E] = 0x1C;                      // Control: oscillator on, square wave off
+    dev->regs[DS3231_TEMP_MSB] = 25;             // 25.25 C
+    dev->regs[DS3231_TEMP_MSB + 1] = 0x40;
+    return 0;
+}
+
+/// The time registers are latched at the start of a read, like the DS3231 copies its counters to its buffer
+static void prvRtcBegin(struct SimI2cDevice *dev, bool read)
+{
+    time_t now = prvWallClock() + simRtcOffset;
+    struct tm tm;
+
+    if (!read) {
+        return;
+    }
+    gmtime_r(&now, &tm);
+    dev->regs[0] = prvBcd(tm.tm_sec);
+    dev->regs[1] = prvBcd(tm.tm_min);
+    dev->regs[2] = prvBcd(tm.tm_hour);
+    dev->regs[3] = (uint8_t)(tm.tm_wday + 1);
+    dev->regs[4] = prvBcd(tm.tm_mday);
+    dev->regs[5] = (uint8_t)(prvBcd(tm.tm_mon + 1) | ((tm.tm_year >= 200) ? 0x80 : 0));
+    dev->regs[6] = prvBcd(tm.tm_year % 100);
+}
+
+/// Setting a time register moves the clock by the difference
+static void prvRtcWrite(struct SimI2cDevice *dev, uint8_t reg, uint8_t value)
+{
+    struct tm tm;
+
+    prvRtcBegin(dev, true);
+    dev->regs[reg] = value;
+    if (reg > 6) {
+        return;
+    }
+    memset(&tm, 0, sizeof(tm));
+    tm.tm_sec = prvFromBcd(dev->regs[0] & 0x7F);
+    tm.tm_min = prvFromBcd(dev->regs[1] & 0x7F);
+    tm.tm_hour = prvFromBcd(dev->regs[2] & 0x3F);
+    tm.tm_mday = prvFromBcd(dev->regs[4] & 0x3F);
+    tm.tm_mon = prvFromBcd(dev->regs[5] & 0x1F) - 1;
+    tm.tm_year = 100 + prvFromBcd(dev->regs[6]) + ((dev->regs[5] & 0x80) ? 100 : 0);
+    simRtcOffset = timegm(&tm) - prvWallClock();
+}
+
+static uint8_t prvRtcNext(struct SimI2cDevice *dev, uint8_t reg)
+{
+    return (reg >= DS3231_LAST_REG) ? 0 : reg + 1;
+}
+
+/******************************************************************************
+ * LSM6DSO
+ ******************************************************************************/
+
+static void prvImuReset(struct SimI2cDevice *dev)
+{
+    double sineMg = simImu.sineMg, sineHz = simImu.sineHz;
+
+    memset(dev->regs, 0, sizeof(dev->regs));
+    memset(&simImu, 0, sizeof(simImu));
+    simImu.sineMg = sineMg;
+    simImu.sineHz = sineHz;
+    simImu.noise = 1;
+    dev->regs[IMU_WHO_AM_I] = 0x6C;
+    dev->regs[IMU_CTRL3_C] = 0x04;  // IF_INC
+}
+
+static int prvImuCreate(struct SimI2cDevice *dev, char *args)
+{
+    char *mode = strtok(args, " \t");
+
+    if (mode != NULL && strcmp(mode, "sine") == 0) {
+        char *mg = strtok(NULL, " \t");
+        char *hz = strtok(NULL, " \t");
+        if (mg == NULL || hz == NULL) {
+            return -1;
+        }
+        simImu.sineMg = atof(mg);
+        simImu.sineHz = atof(hz);
+    } else if (mode != NULL && strcmp(mode, "rest") != 0) {
+        return -1;
+    }
+    prvImuReset(dev);
+    return 0;
+}
+
+static bool prvImuEmbeddedBank(struct SimI2cDevice *dev)
+{
+    return (dev->regs[IMU_FUNC_CFG_ACCESS] & 0x80) != 0;
+}
+
+/// Batch period of the accelerometer from BDR_XL, 0 if it is not batched
+static uint64_t prvImuBatchNs(struct SimI2cDevice *dev)
+{
+    static const uint64_t periodNs[16] = {0,        80000000, 38461538, 19230769, 9615385, 4807692, 2403846, 1201923,
+                                          600962,   300481,   150240,   625000000};
+    if ((dev->regs[IMU_CTRL1_XL] >> 4) == 0 || (dev->regs[IMU_FIFO_CTRL4] & 0x07) == 0) {
+        return 0;  // Powered down, or FIFO in bypass
+    }
+    return periodNs[dev->regs[IMU_FIFO_CTRL3] & 0x0F];
+}
+
+static uint16_t prvImuWatermark(struct SimI2cDevice *dev)
+{
+    return (uint16_t)(((dev->regs[IMU_FIFO_CTRL2] & 0x01) << 8) | dev->regs[IMU_FIFO_CTRL1]);
+}
+
+static void prvImuSample(uint64_t ns, int16_t xyz[3])
+{
+    double t = (double)ns / 1e9;
+    double z = IMU_LSB_PER_G + simImu.sineMg * 1000.0 / 61.0 * sin(2 * M_PI * simImu.sineHz * t);
+
+    for (int axis = 0; axis < 3; axis++) {
+        simImu.noise = simImu.noise * 1103515245u + 12345u;
+        xyz[axis] = (int16_t)((int)((simImu.noise >> 16) % 5) - 2);  // +-2 LSB of noise
+    }
+    xyz[2] = (int16_t)(xyz[2] + (int)lrint(z));
+}
+
+static void prvImuPush(struct SimI2cDevice *dev, uint8_t tag, const uint8_t data[6])
+{
+    uint8_t *word;
+    uint8_t cnt = (uint8_t)(simImu.batch & 0x03);
+    uint8_t value = (uint8_t)((tag << 3) | (cnt << 1));
+
+    value |= (uint8_t)(__builtin_popcount(value) & 1);  // TAG_PARITY
+    if (simImu.fifoLevel == IMU_FIFO_WORDS) {
+        if ((dev->regs[IMU_FIFO_CTRL4] & 0x07) == 1) {
+            return;  // FIFO mode stops when full
+        }
+        simImu.fifoHead = (simImu.fifoHead + 1) % IMU_FIFO_WORDS;  // Continuous mode drops the oldest
+        simImu.fifoLevel--;
+        dev->regs[IMU_FIFO_STATUS2] |= 0x40;  // FIFO_OVR_IA
+    }
+    word = simImu.fifo[(simImu.fifoHead + simImu.fifoLevel) % IMU_FIFO_WORDS];
+    word[0] = value;
+    memcpy(&word[1], data, 6);
+    simImu.fifoLevel++;
+}
+
+/// Writes the oldest pending sample uncompressed, tagged with its age
+static void prvImuPushUncompressed(struct SimI2cDevice *dev)
+{
+    static const uint8_t tagOfAge[3] = {IMU_TAG_XL_NC, IMU_TAG_XL_NC_T_1, IMU_TAG_XL_NC_T_2};
+    uint8_t data[6];
+
+    for (int axis = 0; axis < 3; axis++) {
+        data[2 * axis] = (uint8_t)simImu.pending[0][axis];
+        data[2 * axis + 1] = (uint8_t)((uint16_t)simImu.pending[0][axis] >> 8);
+        simImu.last[axis] = simImu.pending[0][axis];
+    }
+    prvImuPush(dev, tagOfAge[simImu.pendingCount - 1], data);
+    memmove(simImu.pending[0], simImu.pending[1], sizeof(simImu.pending[0]) * 2);
+    simImu.pendingCount--;
+}
+
+/// True if the deltas of the count oldest pending samples, each from the one before, fit in bits
+static bool prvImuDeltasFit(uint8_t count, int bits)
+{
+    const int16_t *previous = simImu.last;
+
+    for (uint8_t i = 0; i < count; i++) {
+        for (int axis = 0; axis < 3; axis++) {
+            int delta = simImu.pending[i][axis] - previous[axis];
+            if (delta < -(1 << (bits - 1)) || delta >= (1 << (bits - 1))) {
+                return false;
+            }
+        }
+        previous = simImu.pending[i];
+    }
+    return true;
+}
+
+/// Writes the three pending samples as one 3xC word, or the two oldest as one 2xC word
+static void prvImuPushCompressed(struct SimI2cDevice *dev, uint8_t count)
+{
+    uint8_t data[6] = {0};
+
+    for (uint8_t i = 0; i < count; i++) {
+        uint16_t packed = 0;
+        for (int axis = 0; axis < 3; axis++) {
+            int delta = simImu.pending[i][axis] - simImu.last[axis];
+            if (count == 3) {
+                packed |= (uint16_t)((delta & 0x1F) << (5 * axis));
+            } else {
+                data[3 * i + axis] = (uint8_t)delta;
+            }
+            simImu.last[axis] = simImu.pending[i][axis];
+        }
+        if (count == 3) {
+            data[2 * i] = (uint8_t)packed;
+            data[2 * i + 1] = (uint8_t)(packed >> 8);
+        }
+    }
+    prvImuPush(dev, (count == 3) ? IMU_TAG_XL_3XC : IMU_TAG_XL_2XC, data);
+    memmove(simImu.pending[0], simImu.pending[count], sizeof(simImu.pending[0]) * (3 - count));
+    simImu.pendingCount -= count;
+}
+
+/// One batch event: a timestamp word when it is due, then the new sample, compressed when it can be
+static void prvImuBatch(struct SimI2cDevice *dev, uint64_t ns)
+{
+    static const uint32_t timestampEvery[4] = {0, 1, 8, 32};
+    static const uint32_t uncompressedEvery[4] = {0, 8, 16, 32};
+    uint32_t tsEvery = timestampEvery[dev->regs[IMU_FIFO_CTRL4] >> 6];
+    uint32_t ncEvery = uncompressedEvery[(dev->regs[IMU_FIFO_CTRL2] >> 1) & 0x03];
+    bool compress = (simImu.emb[IMU_EMB_FUNC_EN_B] & 0x08) && (dev->regs[IMU_FIFO_CTRL2] & 0x40);
+
+    simImu.batch++;
+    if ((dev->regs[IMU_CTRL10_C] & 0x20) && tsEvery != 0 && simImu.batch % tsEvery == 0) {
+        uint32_t ticks = (uint32_t)((ns - simImu.timestampBaseNs) / IMU_TIMESTAMP_NS);
+        uint8_t data[6] = {(uint8_t)ticks, (uint8_t)(ticks >> 8), (uint8_t)(ticks >> 16), (uint8_t)(ticks >> 24), 0, 0};
+        prvImuPush(dev, IMU_TAG_TIMESTAMP, data);
+    }
+
+    prvImuSample(ns, simImu.pending[simImu.pendingCount++]);
+    if (!compress || (ncEvery != 0 && ++simImu.sinceUncompressed >= ncEvery)) {
+        simImu.sinceUncompressed = 0;
+        while (simImu.pendingCount > 0) {
+            prvImuPushUncompressed(dev);
+        }
+    } else if (simImu.pendingCount == 3) {
+        if (prvImuDeltasFit(3, 5)) {
+            prvImuPushCompressed(dev, 3);
+        } else if (prvImuDeltasFit(2, 8)) {
+            prvImuPushCompressed(dev, 2);
+        } else {
+            prvImuPushUncompressed(dev);
+        }
+    }
+}
+
+static void prvImuRun(struct SimI2cDevice *dev, uint64_t nowNs)
+{
+    uint64_t period = prvImuBatchNs(dev);
+    uint16_t watermark = prvImuWatermark(dev);
+    bool above;
+
+    if (period == 0) {
+        simImu.nextBatchNs = 0;
+        return;
+    }
+    if (simImu.nextBatchNs == 0) {
+        simImu.nextBatchNs = nowNs + period;
+    }
+    while (simImu.nextBatchNs <= nowNs) {
+        prvImuBatch(dev, simImu.nextBatchNs);
+        simImu.nextBatchNs += period;
+    }
+
+    above = watermark != 0 && simImu.fifoLevel >= watermark;
+    if (above && !simImu.aboveWatermark && (dev->regs[IMU_INT1_CTRL] & 0x08)) {
+        SimExtintRaise(EXT1_IRQ_INPUT);
+    }
+    simImu.aboveWatermark = above;
+}
+
+static uint8_t prvImuRead(struct SimI2cDevice *dev, uint8_t reg)
+{
+    uint16_t watermark = prvImuWatermark(dev);
+
+    if (prvImuEmbeddedBank(dev) && reg != IMU_FUNC_CFG_ACCESS) {
+        return simImu.emb[reg];
+    }
+    switch (reg) {
+        case IMU_FIFO_STATUS1:
+            return (uint8_t)simImu.fifoLevel;
+        case IMU_FIFO_STATUS2: {
+            uint8_t status = (uint8_t)((simImu.fifoLevel >> 8) & 0x03) | (dev->regs[IMU_FIFO_STATUS2] & 0x40);
+            if (watermark != 0 && simImu.fifoLevel >= watermark) {
+                status |= 0x80;  // FIFO_WTM_IA
+            }
+            dev->regs[IMU_FIFO_STATUS2] &= (uint8_t)~0x40;  // Cleared on read
+            return status;
+        }
+        case IMU_FIFO_DATA_OUT_TAG:
+            if (simImu.fifoLevel == 0) {
+                memset(simImu.out, 0, sizeof(simImu.out));
+            } else {
+                memcpy(simImu.out, simImu.fifo[simImu.fifoHead], sizeof(simImu.out));
+                simImu.fifoHead = (simImu.fifoHead + 1) % IMU_FIFO_WORDS;
+                simImu.fifoLevel--;
+                simImu.aboveWatermark = watermark != 0 && simImu.fifoLevel >= watermark;
+            }
+            return simImu.out[0];
+        case IMU_STATUS_REG:
+            return 0x01;  // XLDA
+        default:
+            if (reg > IMU_FIFO_DATA_OUT_TAG && reg <= IMU_FIFO_DATA_OUT_Z_H) {
+                return simImu.out[reg - IMU_FIFO_DATA_OUT_TAG];
+            }
+            if (reg >= IMU_OUTX_L_A && reg < IMU_OUTX_L_A + 6) {
+                int16_t xyz[3];
+                prvImuSample(SimNowNs(), xyz);
+                return (uint8_t)((uint16_t)xyz[(reg - IMU_OUTX_L_A) / 2] >> (8 * ((reg - IMU_OUTX_L_A) & 1)));
+            }
+            if (reg >= IMU_TIMESTAMP0 && reg < IMU_TIMESTAMP0 + 4) {
+                uint32_t ticks = (uint32_t)((SimNowNs() - simImu.timestampBaseNs) / IMU_TIMESTAMP_NS);
+                return (uint8_t)(ticks >> (8 * (reg - IMU_TIMESTAMP0)));
+            }
+            return dev->regs[reg];
+    }
+}
+
+static void prvImuWrite(struct SimI2cDevice *dev, uint8_t reg, uint8_t value)
+{
+    if (prvImuEmbeddedBank(dev) && reg != IMU_FUNC_CFG_ACCESS) {
+        simImu.emb[reg] = value;
+        return;
+    }
+    switch (reg) {
+        case IMU_WHO_AM_I:
+        case IMU_FIFO_STATUS1:
+        case IMU_FIFO_STATUS2:
+        case IMU_STATUS_REG:
+            return;  // Read only
+        case IMU_CTRL3_C:
+            if (value & 0x01) {
+                prvImuReset(dev);  // SW_RESET clears itself
+                return;
+            }
+            break;
+        case IMU_CTRL10_C:
+            if ((value & 0x20) && !(dev->regs[reg] & 0x20)) {
+                simImu.timestampBaseNs = SimNowNs();
+            }
+            break;
+        case IMU_FIFO_CTRL4:
+            if ((value & 0x07) == 0) {
+                simImu.fifoLevel = 0;  // Bypass empties the FIFO
+                simImu.pendingCount = 0;
+            }
+            break;
+        default:
+            break;
+    }
+    dev->regs[reg] = value;
+    if (reg == IMU_CTRL1_XL || reg == IMU_FIFO_CTRL3 || reg == IMU_FIFO_CTRL4) {
+        simImu.nextBatchNs = 0;  // Batching restarts on the new rate
+    }
+}
+
+/// Bursts roll back from FIFO_DATA_OUT_Z_H to FIFO_DATA_OUT_TAG, and only advance with IF_INC
+static uint8_t prvImuNext(struct SimI2cDevice *dev, uint8_t reg)
+{
+    if (!(dev->regs[IMU_CTRL3_C] & 0x04)) {
+        return reg;
+    }
+    return (reg == IMU_FIFO_DATA_OUT_Z_H) ? IMU_FIFO_DATA_OUT_TAG : (uint8_t)(reg + 1);
+}
+
+/******************************************************************************
+ * Register file
+ ******************************************************************************/
+
+static int prvRegsCreate(struct SimI2cDevice *dev, char *args)
+{
+    int reg = 0;
+
+    for (char *byte = strtok(args, " \t"); byte != NULL && reg < 256; byte = strtok(NULL, " \t")) {
+        dev->regs[reg++] = (uint8_t)strtoul(byte, NULL, 16);
+    }
+    return 0;
+}
+
+static const struct SimI2cModel simI2cModels[] = {
+    {"ds3231", prvRtcCreate, prvRtcBegin, NULL, prvRtcWrite, prvRtcNext, NULL},
+    {"lsm6dso", prvImuCreate, NULL, prvImuRead, prvImuWrite, prvImuNext, prvImuRun},
+    {"regs", prvRegsCreate, NULL, NULL, NULL, NULL, NULL},
+};
+
+/******************************************************************************
+ * Bus
+ ******************************************************************************/
+
+static struct SimI2cDevice *prvFind(uint8_t address)
+{
+    for (uint8_t i = 0; i < simI2cDeviceCount; i++) {
+        if (simI2cDevices[i].address == address) {
+            return &simI2cDevices[i];
+        }
+    }
+    return NULL;
+}
+
+static int prvAdd(uint8_t address, const char *name, char *args)
+{
+    struct SimI2cDevice *dev;
+
+    if (simI2cDeviceCount == SIM_I2C_DEVICES || prvFind(address) != NULL) {
+        return -1;
+    }
+    dev = &simI2cDevices[simI2cDeviceCount];
+    memset(dev, 0, sizeof(*dev));
+    dev->address = address;
+    for (size_t i = 0; i < sizeof(simI2cModels) / sizeof(simI2cModels[0]); i++) {
+        if (strcmp(simI2cModels[i].name, name) == 0) {
+            dev->model = &simI2cModels[i];
+        }
+    }
+    if (dev->model == NULL || dev->model->create(dev, args) != 0) {
+        return -1;
+    }
+    simI2cDeviceCount++;
+    return 0;
+}
+
+/// Runs the transfer on the addressed device. Called with SimLock held.
+static void prvTransfer(struct SimI2cJob *job)
+{
+    struct SimI2cDevice *dev = prvFind(job->address);
+    uint16_t i = 0;
+
+    if (dev == NULL) {
+        job->status = STATUS_ERR_BAD_ADDRESS;  // Address NACK
+        return;
+    }
+    if (dev->model->begin != NULL) {
+        dev->model->begin(dev, job->read);
+    }
+    if (!job->read && job->len > 0) {
+        dev->pointer = job->data[i++];
+    }
+    for (; i < job->len; i++) {
+        if (job->read) {
+            job->data[i] = (dev->model->read != NULL) ? dev->model->read(dev, dev->pointer) : dev->regs[dev->pointer];
+        } else if (dev->model->write != NULL) {
+            dev->model->write(dev, dev->pointer, job->data[i]);
+        } else {
+            dev->regs[dev->pointer] = job->data[i];
+        }
+        dev->pointer = (dev->model->next != NULL) ? dev->model->next(dev, dev->pointer) : (uint8_t)(dev->pointer + 1);
+    }
+    job->status = STATUS_OK;
+}
+
+/// Bus thread: runs the device models and completes the transfer in flight when its time on the bus is over
+static void *prvBusThread(void *arg)
+{
+    struct pollfd wake = {simI2cWake[0], POLLIN, 0};
+    uint8_t drain[16];
+
+    for (;;) {
+        uint64_t now = SimNowNs();
+        uint64_t wait = SIM_I2C_RUN_NS;
+
+        SimLock();
+        for (uint8_t i = 0; i < simI2cDeviceCount; i++) {
+            if (simI2cDevices[i].model->run != NULL) {
+                simI2cDevices[i].model->run(&simI2cDevices[i], now);
+            }
+        }
+        if (simI2cJob.busy && !simI2cJob.complete) {
+            if (simI2cJob.dueNs <= now) {
+                prvTransfer(&simI2cJob);
+                simI2cJob.complete = true;
+                SimIrqPend(SIM_IRQ_I2C);
+            } else if (simI2cJob.dueNs - now < wait) {
+                wait = simI2cJob.dueNs - now;
+            }
+        }
+        SimUnlock();
+
+        struct timespec timeout = {0, (long)wait};
+        if (ppoll(&wake, 1, &timeout, NULL) > 0) {
+            ssize_t len = read(simI2cWake[0], drain, sizeof(drain));
+            (void)len;
+        }
+    }
+    return NULL;
+}
+
+/// SERCOM0 interrupt: hands a finished transfer back to the firmware
+static void prvI2cIsr(void)
+{
+    struct i2c_master_module *module;
+    enum i2c_master_callback callback;
+
+    SimLock();
+    if (!simI2cJob.complete) {
+        SimUnlock();
+        return;
+    }
+    module = simI2cJob.module;
+    if (simI2cJob.read && simI2cJob.status == STATUS_OK) {
+        memcpy(simI2cJob.dest, simI2cJob.data, simI2cJob.len);
+    }
+    module->buffer_remaining = 0;
+    module->status = simI2cJob.status;
+    callback = (simI2cJob.status != STATUS_OK) ? I2C_MASTER_CALLBACK_ERROR
+               : simI2cJob.read                ? I2C_MASTER_CALLBACK_READ_COMPLETE
+                                               : I2C_MASTER_CALLBACK_WRITE_COMPLETE;
+    simI2cJob.complete = false;
+    simI2cJob.busy = false;
+    SimUnlock();
+
+    if ((module->registered_callback & module->enabled_callback & (1 << callback)) && module->callbacks[callback] != NULL) {
+        module->callbacks[callback](module);
+    }
+}
+
+static enum status_code prvStart(struct i2c_master_module *const module, struct i2c_master_packet *const packet, bool read,
+                                 bool stop)
+{
+    uint32_t bits = 9 * (packet->data_length + 1u) + 2;  // Address and data bytes with their ACK, START and STOP
+    enum status_code status = STATUS_OK;
+
+    SimLock();
+    if (simI2cJob.busy) {
+        status = STATUS_BUSY;
+    } else {
+        simI2cJob.module = module;
+        simI2cJob.busy = true;
+        simI2cJob.complete = false;
+        simI2cJob.read = read;
+        simI2cJob.address = (uint8_t)(packet->address & 0x7F);
+        simI2cJob.len = packet->data_length;
+        simI2cJob.dest = packet->data;
+        simI2cJob.dueNs = SimNowNs() + (uint64_t)bits * 1000000 / module->baud_rate;
+        if (!read) {
+            memcpy(simI2cJob.data, packet->data, packet->data_length);
+        }
+        module->buffer = packet->data;
+        module->buffer_length = packet->data_length;
+        module->buffer_remaining = packet->data_length;
+        module->transfer_direction = read;
+        module->status = STATUS_BUSY;
+        module->send_stop = stop;
+    }
+    SimUnlock();
+    if (status == STATUS_OK) {
+        uint8_t c = 0;
+        ssize_t written = write(simI2cWake[1], &c, 1);
+        (void)written;
+    }
+    return status;
+}
+
+/******************************************************************************
+ * SimModels.h
+ ******************************************************************************/
+
+/// Puts the devices of script on the bus, or the ones of the board for NULL
+int SimI2cLoad(const char *script)
+{
+    char line[512];
+    FILE *file;
+    int lineNo = 0;
+
+    if (script == NULL) {
+        char none[] = "";
+        return (prvAdd(0x68, "ds3231", none) == 0 && prvAdd(0x6A, "lsm6dso", none) == 0) ? 0 : -1;
+    }
+    file = fopen(script, "r");
+    if (file == NULL) {
+        return -1;
+    }
+    while (fgets(line, sizeof(line), file) != NULL) {
+        char *comment = strchr(line, '#');
+        char *address, *model, *args;
+
+        lineNo++;
+        if (comment != NULL) {
+            *comment = '\0';
+        }
+        address = strtok(line, " \t\r\n");
+        if (address == NULL) {
+            continue;
+        }
+        model = strtok(NULL, " \t\r\n");
+        args = strtok(NULL, "\r\n");
+        if (model == NULL || prvAdd((uint8_t)strtoul(address, NULL, 16), model, (args != NULL) ? args : model + strlen(model)) != 0) {
+            SimLog("sim: %s:%d: bad I2C device\n", script, lineNo);
+            fclose(file);
+            return -1;
+        }
+    }
+    fclose(file);
+    return 0;
+}
+
+void SimI2cStart(void)
+{
+    SimIrqRegister(SIM_IRQ_I2C, prvI2cIsr);
+    if (pipe2(simI2cWake, O_CLOEXEC | O_NONBLOCK) == 0) {
+        SimThreadStart(prvBusThread, NULL);
+    }
+}
+
+/******************************************************************************
+ * I2C master driver
+ ******************************************************************************/
+
+void i2c_master_get_config_defaults(struct i2c_master_config *const config)
+{
+    memset(config, 0, sizeof(*config));
+    config->baud_rate = I2C_MASTER_BAUD_RATE_100KHZ;
+    config->buffer_timeout = 65535;
+    config->unknown_bus_state_timeout = 65535;
+    config->pinmux_pad0 = PINMUX_DEFAULT;
+    config->pinmux_pad1 = PINMUX_DEFAULT;
+}
+
+enum status_code i2c_master_init(struct i2c_master_module *const module, Sercom *const hw,
+                                 const struct i2c_master_config *const config)
+{
+    if (config->baud_rate == 0 || config->baud_rate > 1000) {
+        return STATUS_ERR_BAUDRATE_UNAVAILABLE;
+    }
+    memset(module, 0, sizeof(*module));
+    module->hw = hw;
+    module->baud_rate = config->baud_rate;
+    return STATUS_OK;
+}
+
+void i2c_master_enable(const struct i2c_master_module *const module)
+{
+}
+
+void i2c_master_reset(struct i2c_master_module *const module)
+{
+    SimLock();
+    if (simI2cJob.module == module) {
+        simI2cJob.busy = false;
+        simI2cJob.complete = false;
+    }
+    SimUnlock();
+}
+
+void i2c_master_register_callback(struct i2c_master_module *const module, i2c_master_callback_t callback,
+                                  enum i2c_master_callback callback_type)
+{
+    module->callbacks[callback_type] = callback;
+    module->registered_callback |= (uint8_t)(1 << callback_type);
+}
+
+void i2c_master_enable_callback(struct i2c_master_module *const module, enum i2c_master_callback callback_type)
+{
+    module->enabled_callback |= (uint8_t)(1 << callback_type);
+}
+
+enum status_code i2c_master_read_packet_job(struct i2c_master_module *const module, struct i2c_master_packet *const packet)
+{
+    return prvStart(module, packet, true, true);
+}
+
+enum status_code i2c_master_write_packet_job(struct i2c_master_module *const module, struct i2c_master_packet *const packet)
+{
+    return prvStart(module, packet, false, true);
+}
+
+enum status_code i2c_master_write_packet_job_no_stop(struct i2c_master_module *const module,
+                                                     struct i2c_master_packet *const packet)
+{
+    return prvStart(module, packet, false, false);
+}
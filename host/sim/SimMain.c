@@ -0,0 +1,157 @@
+/**************************************************************************/ /**
+ * @file      SimMain.c
+ * @brief     firmware_sim: runs the whole firmware on the host, on the FreeRTOS simulator port and the peripheral
+ *            models, for debugging and profiling with the host tools.
+ *              firmware_sim [-c CONSOLE|-] [-f FLASH] [-d IMAGE [-n SECTORS]] [-s SERIAL] [-i SCRIPT]
+ *                           [-H NAME=IP]... [-r IP:PORT=IP:PORT]... [-p OFFSET] [-t SECONDS]
+ * @date      2026-10-19
+
+ ******************************************************************************/
+
+#include <getopt.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "Sim.h"
+#include "SimModels.h"
+#include "SimNet.h"
+
+#define SIM_DEFAULT_FLASH "firmware_sim.nvm"
+#define SIM_DEFAULT_SECTORS 131072  ///< 64 MB card for a new image
+
+int FirmwareMain(void);  ///< main() of main21.c
+
+static void Usage(void)
+{
+    fprintf(stderr,
+            "usage: firmware_sim [-c CONSOLE|-] [-f FLASH] [-d IMAGE [-n SECTORS]] [-s SERIAL] [-i SCRIPT]\n"
+            "                    [-H NAME=IP]... [-r IP:PORT=IP:PORT]... [-p OFFSET] [-t SECONDS]\n"
+            "  -c         console: a pseudo terminal linked from CONSOLE, or stdin and stdout for -\n"
+            "  -f         flash file, %s by default, created erased\n"
+            "  -d, -n     SD card image, formatted with SECTORS (default %u) if new; no card without -d\n"
+            "  -s         chip serial number as 32 hex digits\n"
+            "  -i         I2C devices, lines of \"ADDR MODEL [ARGS]\"; a DS3231 at 68 and an LSM6DSO at 6A by default\n"
+            "  -H         answers the WINC resolver for NAME with IP\n"
+            "  -r         sends the connections and datagrams for the first endpoint to the second\n"
+            "  -p         added to the ports the firmware listens on\n"
+            "  -t         stops after SECONDS, otherwise on SIGINT or SIGTERM\n",
+            SIM_DEFAULT_FLASH, SIM_DEFAULT_SECTORS);
+}
+
+static int ParseSerial(const char *text, uint32_t serial[4])
+{
+    char word[9];
+
+    if (strlen(text) != 32 || strspn(text, "0123456789abcdefABCDEF") != 32) {
+        return -1;
+    }
+    for (int i = 0; i < 4; i++) {
+        memcpy(word, text + 8 * i, 8);
+        word[8] = '\0';
+        serial[i] = (uint32_t)strtoul(word, NULL, 16);
+    }
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t serial[4] = {0x5A5A0001, 0x0000516E, 0x00000000, 0x00000001};
+    const char *console = NULL;
+    const char *flash = SIM_DEFAULT_FLASH;
+    const char *image = NULL;
+    const char *script = NULL;
+    uint32_t sectors = SIM_DEFAULT_SECTORS;
+    uint32_t seconds = 0;
+    sigset_t signals;
+    int opt;
+
+    // Blocked before any thread starts, so the port alone takes them
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    sigaddset(&signals, SIGALRM);
+    sigaddset(&signals, SIGUSR1);
+    sigprocmask(SIG_BLOCK, &signals, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    while ((opt = getopt(argc, argv, "c:f:d:n:s:i:H:r:p:t:h")) != -1) {
+        switch (opt) {
+            case 'c':
+                console = optarg;
+                break;
+            case 'f':
+                flash = optarg;
+                break;
+            case 'd':
+                image = optarg;
+                break;
+            case 'n':
+                sectors = (uint32_t)strtoul(optarg, NULL, 0);
+                break;
+            case 's':
+                if (ParseSerial(optarg, serial) != 0) {
+                    Usage();
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'i':
+                script = optarg;
+                break;
+            case 'H':
+                if (SimNetAddHost(optarg) != 0) {
+                    fprintf(stderr, "firmware_sim: bad host %s\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'r':
+                if (SimNetAddRedirect(optarg) != 0) {
+                    fprintf(stderr, "firmware_sim: bad redirect %s\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'p':
+                SimNetSetPortOffset(atoi(optarg));
+                break;
+            case 't':
+                seconds = (uint32_t)strtoul(optarg, NULL, 0);
+                break;
+            default:
+                Usage();
+                return (opt == 'h') ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+    if (optind != argc) {
+        Usage();
+        return EXIT_FAILURE;
+    }
+
+    SimSetArgs(argv);
+    if (SimConsoleOpen(console) != 0) {
+        fprintf(stderr, "firmware_sim: cannot open the console\n");
+        return EXIT_FAILURE;
+    }
+    if (SimFlashOpen(flash, serial) != 0) {
+        fprintf(stderr, "firmware_sim: cannot open the flash %s\n", flash);
+        return EXIT_FAILURE;
+    }
+    if (image != NULL && SimDiskOpen(image, sectors) != 0) {
+        fprintf(stderr, "firmware_sim: cannot open the SD card image %s\n", image);
+        return EXIT_FAILURE;
+    }
+    if (SimI2cLoad(script) != 0) {
+        fprintf(stderr, "firmware_sim: cannot load the I2C devices of %s\n", (script != NULL) ? script : "the default bus");
+        return EXIT_FAILURE;
+    }
+    SimAsfStart();
+    SimI2cStart();
+    SimWincStart();
+    SimSetRunTime(seconds);
+
+    FirmwareMain();
+    // The task threads are still parked in the port: leave without running exit handlers under them
+    fflush(NULL);
+    _exit(EXIT_SUCCESS);
+}
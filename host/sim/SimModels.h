@@ -0,0 +1,27 @@
+/**************************************************************************/ /**
+ * @file      SimModels.h
+ * @brief     Peripheral models of the firmware simulator, as SimMain.c sets them up before the firmware starts and
+ *            as the models drive each other.
+ * @date      2026-10-19
+
+ ******************************************************************************/
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* SimAsf.c */
+void SimSetArgs(char **argv);
+int SimConsoleOpen(const char *path);
+int SimFlashOpen(const char *path, const uint32_t serial[4]);
+int SimDiskOpen(const char *image, uint32_t sectors);
+void SimAsfStart(void);
+void SimExtintRaise(uint8_t line);
+
+/* SimI2c.c */
+int SimI2cLoad(const char *script);
+void SimI2cStart(void);
+
+/* SimWinc.c, on the host network of SimNet.h */
+void SimWincStart(void);
@@ -0,0 +1,405 @@
+/**************************************************************************/ /**
+ * @file      SimNet.c
+ * @brief     Host network of the firmware simulator, see SimNet.h. Every WINC socket slot is a non-blocking host
+ *            socket; a poll thread reports the ones that became ready to the WINC model, and host names are
+ *            resolved on threads of their own, like the WINC resolves them while the firmware goes on.
+ * @details   --host NAME=IP answers a name without asking the host resolver, --redirect IP:PORT=IP:PORT sends the
+ *            connections and datagrams of the firmware for one endpoint to another (the MQTT broker address is
+ *            compiled in), and the port offset moves the ports the firmware listens on, as port 80 needs rights
+ *            the simulator should not have.
+ * @date      2026-10-19
+
+ ******************************************************************************/
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "Sim.h"
+#include "SimNet.h"
+
+#define SIM_NET_MAPPINGS 8
+#define SIM_NET_POLL_MS 100  ///< Longest poll, so new deadlines are looked at
+
+struct SimNetSocket {
+    int fd;
+    bool tcp;
+    bool wantRead;
+    bool wantWrite;
+};
+
+struct SimNetHost {
+    char name[64];
+    uint32_t addr;
+};
+
+struct SimNetRedirect {
+    struct sockaddr_in from;
+    struct sockaddr_in to;
+};
+
+static struct SimNetSocket simNetSockets[SIM_NET_SOCKETS];  ///< Guarded by SimLock
+static struct SimNetHost simNetHosts[SIM_NET_MAPPINGS];
+static struct SimNetRedirect simNetRedirects[SIM_NET_MAPPINGS];
+static int simNetHostCount = 0;
+static int simNetRedirectCount = 0;
+static int simNetPortOffset = 0;
+static int simNetWake[2] = {-1, -1};
+
+/******************************************************************************
+ * Local Functions
+ ******************************************************************************/
+
+static int prvParseEndpoint(const char *text, struct sockaddr_in *addr)
+{
+    char host[64];
+    unsigned port;
+
+    if (sscanf(text, "%63[^:]:%u", host, &port) != 2 || port > 65535) {
+        return -1;
+    }
+    memset(addr, 0, sizeof(*addr));
+    addr->sin_family = AF_INET;
+    addr->sin_port = htons((uint16_t)port);
+    return (inet_pton(AF_INET, host, &addr->sin_addr) == 1) ? 0 : -1;
+}
+
+/// The endpoint to use for addr and port, after --redirect
+static struct sockaddr_in prvEndpoint(uint32_t addr, uint16_t port)
+{
+    struct sockaddr_in endpoint;
+
+    memset(&endpoint, 0, sizeof(endpoint));
+    endpoint.sin_family = AF_INET;
+    endpoint.sin_addr.s_addr = addr;
+    endpoint.sin_port = port;
+    for (int i = 0; i < simNetRedirectCount; i++) {
+        if (simNetRedirects[i].from.sin_addr.s_addr == addr && simNetRedirects[i].from.sin_port == port) {
+            return simNetRedirects[i].to;
+        }
+    }
+    return endpoint;
+}
+
+static void prvWake(void)
+{
+    uint8_t c = 0;
+    ssize_t written = write(simNetWake[1], &c, 1);
+    (void)written;
+}
+
+static void *prvResolveThread(void *arg)
+{
+    char *name = arg;
+    struct addrinfo hints, *result = NULL;
+    uint32_t addr = 0;
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    if (getaddrinfo(name, NULL, &hints, &result) == 0 && result != NULL) {
+        addr = ((struct sockaddr_in *)result->ai_addr)->sin_addr.s_addr;
+        freeaddrinfo(result);
+    }
+    SimLock();
+    SimWincNetResolved(name, addr);
+    SimUnlock();
+    free(name);
+    return NULL;
+}
+
+/// Poll thread: reports ready sockets and lets the WINC model time out what is due
+static void *prvPollThread(void *arg)
+{
+    for (;;) {
+        struct pollfd fds[SIM_NET_SOCKETS + 1];
+        int slots[SIM_NET_SOCKETS + 1];
+        int count = 0;
+        uint64_t now = SimNowNs();
+        uint64_t deadline;
+        int timeout = SIM_NET_POLL_MS;
+
+        fds[count].fd = simNetWake[0];
+        fds[count].events = POLLIN;
+        slots[count++] = -1;
+        SimLock();
+        for (int slot = 0; slot < SIM_NET_SOCKETS; slot++) {
+            struct SimNetSocket *s = &simNetSockets[slot];
+            if (s->fd >= 0 && (s->wantRead || s->wantWrite)) {
+                fds[count].fd = s->fd;
+                fds[count].events = (short)((s->wantRead ? POLLIN : 0) | (s->wantWrite ? POLLOUT : 0));
+                slots[count++] = slot;
+            }
+        }
+        deadline = SimWincNetDeadline(now);
+        SimUnlock();
+        if (deadline != 0) {
+            uint64_t ms = (deadline > now) ? (deadline - now + 999999) / 1000000 : 0;
+            timeout = (ms < (uint64_t)timeout) ? (int)ms : timeout;
+        }
+
+        if (poll(fds, (nfds_t)count, timeout) < 0 && errno != EINTR) {
+            SimLog("sim: poll failed: %s\n", strerror(errno));
+            return NULL;
+        }
+        if (fds[0].revents & POLLIN) {
+            uint8_t drain[64];
+            ssize_t len = read(simNetWake[0], drain, sizeof(drain));
+            (void)len;
+        }
+
+        SimLock();
+        for (int i = 1; i < count; i++) {
+            short ready = fds[i].revents;
+            if (ready != 0 && simNetSockets[slots[i]].fd == fds[i].fd) {
+                SimWincNetReady(slots[i], (ready & (POLLIN | POLLHUP | POLLERR)) != 0, (ready & (POLLOUT | POLLERR)) != 0);
+            }
+        }
+        SimWincNetDeadline(SimNowNs());
+        SimUnlock();
+    }
+    return NULL;
+}
+
+/******************************************************************************
+ * Options
+ ******************************************************************************/
+
+/// NAME=IP: answers the WINC resolver for NAME with IP
+int SimNetAddHost(const char *mapping)
+{
+    const char *ip = strchr(mapping, '=');
+    struct SimNetHost *host = &simNetHosts[simNetHostCount];
+    struct in_addr addr;
+
+    if (ip == NULL || simNetHostCount == SIM_NET_MAPPINGS || (size_t)(ip - mapping) >= sizeof(host->name) ||
+        inet_pton(AF_INET, ip + 1, &addr) != 1) {
+        return -1;
+    }
+    memcpy(host->name, mapping, (size_t)(ip - mapping));
+    host->name[ip - mapping] = '\0';
+    host->addr = addr.s_addr;
+    simNetHostCount++;
+    return 0;
+}
+
+/// IP:PORT=IP:PORT: connections and datagrams to the first endpoint go to the second
+int SimNetAddRedirect(const char *mapping)
+{
+    const char *to = strchr(mapping, '=');
+    char from[64];
+
+    if (to == NULL || simNetRedirectCount == SIM_NET_MAPPINGS || (size_t)(to - mapping) >= sizeof(from)) {
+        return -1;
+    }
+    memcpy(from, mapping, (size_t)(to - mapping));
+    from[to - mapping] = '\0';
+    if (prvParseEndpoint(from, &simNetRedirects[simNetRedirectCount].from) != 0 ||
+        prvParseEndpoint(to + 1, &simNetRedirects[simNetRedirectCount].to) != 0) {
+        return -1;
+    }
+    simNetRedirectCount++;
+    return 0;
+}
+
+/// Added to the port of every TCP bind of the firmware
+void SimNetSetPortOffset(int offset)
+{
+    simNetPortOffset = offset;
+}
+
+/******************************************************************************
+ * SimNet.h
+ ******************************************************************************/
+
+void SimNetStart(void)
+{
+    for (int slot = 0; slot < SIM_NET_SOCKETS; slot++) {
+        simNetSockets[slot].fd = -1;
+    }
+    if (pipe2(simNetWake, O_CLOEXEC | O_NONBLOCK) == 0) {
+        SimThreadStart(prvPollThread, NULL);
+    }
+}
+
+int SimNetOpen(int slot, bool tcp)
+{
+    struct SimNetSocket *s = &simNetSockets[slot];
+    int one = 1;
+
+    s->fd = socket(AF_INET, (tcp ? SOCK_STREAM : SOCK_DGRAM) | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    s->tcp = tcp;
+    s->wantRead = false;
+    s->wantWrite = false;
+    if (s->fd < 0) {
+        return -1;
+    }
+    setsockopt(s->fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (tcp) {
+        setsockopt(s->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));  // The WINC sends each send() as a segment
+    }
+    return 0;
+}
+
+int SimNetBind(int slot, uint32_t addr, uint16_t port)
+{
+    struct SimNetSocket *s = &simNetSockets[slot];
+    struct sockaddr_in local;
+
+    memset(&local, 0, sizeof(local));
+    local.sin_family = AF_INET;
+    local.sin_addr.s_addr = addr;
+    local.sin_port = s->tcp ? htons((uint16_t)(ntohs(port) + simNetPortOffset)) : port;
+    if (bind(s->fd, (struct sockaddr *)&local, sizeof(local)) != 0) {
+        return -1;
+    }
+    if (s->tcp) {
+        SimLog("sim: TCP port %u listens on %u\n", ntohs(port), ntohs(local.sin_port));
+    }
+    return 0;
+}
+
+int SimNetListen(int slot)
+{
+    return listen(simNetSockets[slot].fd, 4);
+}
+
+/// Starts connecting. Returns 0 when connected, 1 while in progress, -1 on failure.
+int SimNetConnect(int slot, uint32_t addr, uint16_t port)
+{
+    struct sockaddr_in remote = prvEndpoint(addr, port);
+
+    if (connect(simNetSockets[slot].fd, (struct sockaddr *)&remote, sizeof(remote)) == 0) {
+        return 0;
+    }
+    return (errno == EINPROGRESS) ? 1 : -1;
+}
+
+/// Result of a connect that was in progress once the socket is writable: 0 connected, -1 failed
+int SimNetConnectResult(int slot)
+{
+    int error = 0;
+    socklen_t len = sizeof(error);
+
+    if (getsockopt(simNetSockets[slot].fd, SOL_SOCKET, SO_ERROR, &error, &len) != 0) {
+        return -1;
+    }
+    return (error == 0) ? 0 : -1;
+}
+
+/// Accepts a connection of listening slot into newSlot
+int SimNetAccept(int slot, int newSlot, uint32_t *addr, uint16_t *port)
+{
+    struct sockaddr_in remote;
+    socklen_t len = sizeof(remote);
+    int one = 1;
+    int fd = accept4(simNetSockets[slot].fd, (struct sockaddr *)&remote, &len, SOCK_NONBLOCK | SOCK_CLOEXEC);
+
+    if (fd < 0) {
+        return (errno == EAGAIN) ? SIM_NET_WOULD_BLOCK : -1;
+    }
+    if (newSlot < 0) {
+        close(fd);  // No free slot: the WINC refuses the connection
+        return -1;
+    }
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    simNetSockets[newSlot].fd = fd;
+    simNetSockets[newSlot].tcp = true;
+    simNetSockets[newSlot].wantRead = false;
+    simNetSockets[newSlot].wantWrite = false;
+    *addr = remote.sin_addr.s_addr;
+    *port = remote.sin_port;
+    return 0;
+}
+
+/// Receives at most len bytes. Returns their count, 0 when the peer closed, SIM_NET_WOULD_BLOCK or -1.
+long SimNetRecv(int slot, void *buf, uint16_t len, uint32_t *addr, uint16_t *port)
+{
+    struct sockaddr_in remote;
+    socklen_t remoteLen = sizeof(remote);
+    ssize_t received;
+
+    memset(&remote, 0, sizeof(remote));
+    received = recvfrom(simNetSockets[slot].fd, buf, len, 0, (struct sockaddr *)&remote, &remoteLen);
+    if (received < 0) {
+        return (errno == EAGAIN || errno == EINTR) ? SIM_NET_WOULD_BLOCK : -1;
+    }
+    *addr = remote.sin_addr.s_addr;
+    *port = remote.sin_port;
+    return (long)received;
+}
+
+/// Sends len bytes, to addr and port on UDP. Returns the count sent, SIM_NET_WOULD_BLOCK or -1.
+long SimNetSend(int slot, const void *buf, uint16_t len, uint32_t addr, uint16_t port)
+{
+    struct SimNetSocket *s = &simNetSockets[slot];
+    ssize_t sent;
+
+    if (s->tcp) {
+        sent = send(s->fd, buf, len, MSG_NOSIGNAL);
+    } else {
+        struct sockaddr_in remote = prvEndpoint(addr, port);
+        sent = sendto(s->fd, buf, len, 0, (struct sockaddr *)&remote, sizeof(remote));
+    }
+    if (sent < 0) {
+        return (errno == EAGAIN || errno == EINTR) ? SIM_NET_WOULD_BLOCK : -1;
+    }
+    return (long)sent;
+}
+
+/// Sets what the poll thread waits for on slot
+void SimNetWatch(int slot, bool read, bool write)
+{
+    struct SimNetSocket *s = &simNetSockets[slot];
+
+    if (s->wantRead != read || s->wantWrite != write) {
+        s->wantRead = read;
+        s->wantWrite = write;
+        prvWake();
+    }
+}
+
+void SimNetClose(int slot)
+{
+    struct SimNetSocket *s = &simNetSockets[slot];
+
+    if (s->fd >= 0) {
+        close(s->fd);
+        s->fd = -1;
+        s->wantRead = false;
+        s->wantWrite = false;
+        prvWake();
+    }
+}
+
+/// Resolves name, answering through SimWincNetResolved: at once for --host names and addresses, otherwise from a
+/// resolver thread
+void SimNetResolve(const char *name)
+{
+    struct in_addr addr;
+    char *copy;
+
+    for (int i = 0; i < simNetHostCount; i++) {
+        if (strcmp(simNetHosts[i].name, name) == 0) {
+            SimWincNetResolved(name, simNetHosts[i].addr);
+            return;
+        }
+    }
+    if (inet_pton(AF_INET, name, &addr) == 1) {
+        SimWincNetResolved(name, addr.s_addr);
+        return;
+    }
+    copy = strdup(name);
+    if (copy == NULL || SimThreadStart(prvResolveThread, copy) != 0) {
+        free(copy);
+        SimWincNetResolved(name, 0);
+    }
+}
@@ -0,0 +1,41 @@
+/**************************************************************************/ /**
+ * @file      SimNet.h
+ * @brief     Host network of the firmware simulator: the sockets the WINC model (SimWinc.c) runs its socket slots
+ *            on, and the thread that tells it when they are ready.
+ * @details   Kept apart from SimWinc.c because the WINC and the host declare socket types of the same names.
+ *            Addresses and ports are in network byte order on both sides, as in the WINC API. All calls except the
+ *            option setters are made with SimLock held, and the SimWincNet* callbacks are called with it held.
+ * @date      2026-10-19
+
+ ******************************************************************************/
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define SIM_NET_SOCKETS 11      ///< WINC socket slots: TCP_SOCK_MAX then UDP_SOCK_MAX
+#define SIM_NET_WOULD_BLOCK (-2)
+
+/* Options, before SimNetStart */
+int SimNetAddHost(const char *mapping);
+int SimNetAddRedirect(const char *mapping);
+void SimNetSetPortOffset(int offset);
+
+void SimNetStart(void);
+int SimNetOpen(int slot, bool tcp);
+int SimNetBind(int slot, uint32_t addr, uint16_t port);
+int SimNetListen(int slot);
+int SimNetConnect(int slot, uint32_t addr, uint16_t port);
+int SimNetConnectResult(int slot);
+int SimNetAccept(int slot, int newSlot, uint32_t *addr, uint16_t *port);
+long SimNetRecv(int slot, void *buf, uint16_t len, uint32_t *addr, uint16_t *port);
+long SimNetSend(int slot, const void *buf, uint16_t len, uint32_t addr, uint16_t port);
+void SimNetWatch(int slot, bool read, bool write);
+void SimNetClose(int slot);
+void SimNetResolve(const char *name);
+
+/* SimWinc.c */
+void SimWincNetReady(int slot, bool readable, bool writable);
+void SimWincNetResolved(const char *name, uint32_t addr);
+uint64_t SimWincNetDeadline(uint64_t nowNs);
@@ -0,0 +1,667 @@
+/**************************************************************************/ /**
+ * @file      SimWinc.c
+ * @brief     WINC1500 model of the firmware simulator: the parts of the m2m_wifi and socket API the firmware uses, on
+ *            the host network of SimNet.c.
+ * @details   Like the WINC, a call only queues a request and its outcome comes back as an event: the model raises
+ *            the IRQN line (the WINC interrupt, which wakes the Wifi task through nm_bsp_app_isr_hook) and
+ *            m2m_wifi_handle_events then calls the Wi-Fi, socket and resolver callbacks from the task that called
+ *            it. Connecting to the access point always succeeds, after half a second, with 127.0.0.1 from DHCP. Received data
+ *            is delivered one recv() at a time, at most SOCKET_BUFFER_MAX_LENGTH bytes, and a peer that closes or
+ *            fails shows as SOCK_ERR_CONN_ABORTED, like the WINC reports it. Sends are queued in a ring per socket
+ *            and acknowledged once the host took all of their bytes. TLS (SOCKET_FLAGS_SSL) is not modelled.
+ * @date      2026-10-19
+
+ ******************************************************************************/
+
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "Sim.h"
+#include "SimModels.h"
+#include "SimNet.h"
+#include "bsp/include/nm_bsp.h"
+#include "driver/include/m2m_wifi.h"
+#include <socket/include/socket.h>  // The renaming wrapper of sim/, found through the include path
+
+#define SIM_WINC_SEND_RING 4096  ///< Bytes queued for sending per socket
+#define SIM_WINC_SEND_QUEUE 8    ///< send() calls queued per socket
+#define SIM_WINC_EVENTS 32
+#define SIM_WINC_DHCP_IP 0x0100007FUL  ///< 127.0.0.1 in network byte order
+#define SIM_WINC_ASSOCIATE_NS 500000000ULL  ///< From m2m_wifi_connect to connected, about what an access point takes
+
+_Static_assert(SIM_NET_SOCKETS == TCP_SOCK_MAX + UDP_SOCK_MAX, "SimNet slots are the WINC sockets");
+
+enum SimWincEventKind { SIM_WINC_EVENT_WIFI, SIM_WINC_EVENT_SOCKET, SIM_WINC_EVENT_RESOLVE };
+
+struct SimWincSocket {
+    bool used;
+    bool tcp;
+    bool listening;
+    bool connecting;
+    uint32_t generation;  ///< Counts the opens of the slot, so events of a closed socket are dropped
+    bool recvPosted;
+    bool recvFrom;
+    uint8_t *recvBuf;
+    uint16_t recvLen;
+    uint64_t recvDeadline;  ///< SimNowNs when the posted recv times out, 0 for never
+    uint8_t sendRing[SIM_WINC_SEND_RING];
+    uint16_t sendHead;
+    uint16_t sendCount;
+    uint16_t sendLens[SIM_WINC_SEND_QUEUE];  ///< Lengths of the queued send() calls, oldest first
+    uint8_t sendQueued;
+    uint16_t sendDone;  ///< Bytes of the oldest send() already taken by the host
+};
+
+struct SimWincEvent {
+    enum SimWincEventKind kind;
+    uint8_t msg;
+    SOCKET sock;
+    uint32_t generation;
+    union {
+        tstrM2mWifiStateChanged state;
+        tstrM2MIPConfig ip;
+        tstrSocketBindMsg bind;
+        tstrSocketListenMsg listen;
+        tstrSocketAcceptMsg accept;
+        tstrSocketConnectMsg connect;
+        tstrSocketRecvMsg recv;
+        sint16 sent;
+        uint32 resolved;
+    } u;
+    char name[HOSTNAME_MAX_SIZE];
+    uint8_t data[SOCKET_BUFFER_MAX_LENGTH];
+};
+
+// All guarded by SimLock
+static struct SimWincSocket simWincSockets[SIM_NET_SOCKETS];
+static struct SimWincEvent simWincEvents[SIM_WINC_EVENTS];
+static uint8_t simWincEventHead = 0;
+static uint8_t simWincEventCount = 0;
+static uint32_t simWincEventsDropped = 0;
+static uint64_t simWincAssociateAt = 0;  ///< SimNowNs when the pending m2m_wifi_connect succeeds, 0 for none
+static tpfAppWifiCb simWincWifiCb = NULL;
+static tpfAppSocketCb simWincSocketCb = NULL;
+static tpfAppResolveCb simWincResolveCb = NULL;
+
+/******************************************************************************
+ * Local Functions
+ ******************************************************************************/
+
+static struct SimWincEvent *prvEventAlloc(enum SimWincEventKind kind, uint8_t msg, SOCKET sock)
+{
+    struct SimWincEvent *event;
+
+    if (simWincEventCount == SIM_WINC_EVENTS) {
+        if (simWincEventsDropped++ == 0) {
+            SimLog("sim: WINC event queue full, events dropped\n");
+        }
+        return NULL;
+    }
+    event = &simWincEvents[(simWincEventHead + simWincEventCount) % SIM_WINC_EVENTS];
+    memset(&event->u, 0, sizeof(event->u));
+    event->kind = kind;
+    event->msg = msg;
+    event->sock = sock;
+    event->generation = (sock >= 0) ? simWincSockets[sock].generation : 0;
+    return event;
+}
+
+static void prvEventPost(void)
+{
+    simWincEventCount++;
+    SimIrqPend(SIM_IRQ_WINC);
+}
+
+static void prvSocketEvent(SOCKET sock, uint8_t msg, sint16 result)
+{
+    struct SimWincEvent *event = prvEventAlloc(SIM_WINC_EVENT_SOCKET, msg, sock);
+
+    if (event != NULL) {
+        switch (msg) {
+            case SOCKET_MSG_BIND:
+                event->u.bind.status = (sint8)result;
+                break;
+            case SOCKET_MSG_LISTEN:
+                event->u.listen.status = (sint8)result;
+                break;
+            case SOCKET_MSG_CONNECT:
+                event->u.connect.sock = sock;
+                event->u.connect.s8Error = (sint8)result;
+                break;
+            case SOCKET_MSG_RECV:
+            case SOCKET_MSG_RECVFROM:
+                event->u.recv.s16BufferSize = result;
+                break;
+            default:
+                event->u.sent = result;
+                break;
+        }
+        prvEventPost();
+    }
+}
+
+static void prvWatch(SOCKET sock)
+{
+    struct SimWincSocket *s = &simWincSockets[sock];
+
+    SimNetWatch(sock, s->listening || s->recvPosted, s->connecting || s->sendCount > 0);
+}
+
+/// Hands queued bytes of sock to the host and acknowledges every send() that completed
+static void prvFlush(SOCKET sock)
+{
+    struct SimWincSocket *s = &simWincSockets[sock];
+
+    while (s->sendCount > 0) {
+        uint16_t chunk = s->sendCount;
+        long sent;
+
+        if (s->sendHead + chunk > SIM_WINC_SEND_RING) {
+            chunk = SIM_WINC_SEND_RING - s->sendHead;
+        }
+        sent = SimNetSend(sock, &s->sendRing[s->sendHead], chunk, 0, 0);
+        if (sent == SIM_NET_WOULD_BLOCK) {
+            break;
+        }
+        if (sent < 0) {
+            while (s->sendQueued > 0) {
+                prvSocketEvent(sock, SOCKET_MSG_SEND, SOCK_ERR_CONN_ABORTED);
+                s->sendQueued--;
+            }
+            s->sendCount = 0;
+            s->sendDone = 0;
+            break;
+        }
+        s->sendHead = (uint16_t)((s->sendHead + sent) % SIM_WINC_SEND_RING);
+        s->sendCount = (uint16_t)(s->sendCount - sent);
+        s->sendDone = (uint16_t)(s->sendDone + sent);
+        while (s->sendQueued > 0 && s->sendDone >= s->sendLens[0]) {
+            s->sendDone = (uint16_t)(s->sendDone - s->sendLens[0]);
+            prvSocketEvent(sock, SOCKET_MSG_SEND, (sint16)s->sendLens[0]);
+            memmove(&s->sendLens[0], &s->sendLens[1], --s->sendQueued * sizeof(s->sendLens[0]));
+        }
+    }
+    prvWatch(sock);
+}
+
+/// Completes the posted recv of sock from the host, if anything arrived
+static void prvReceive(SOCKET sock)
+{
+    struct SimWincSocket *s = &simWincSockets[sock];
+    struct SimWincEvent *event;
+    uint32_t addr = 0;
+    uint16_t port = 0;
+    long received;
+
+    if (simWincEventCount == SIM_WINC_EVENTS) {
+        return;  // Left in the host socket until the firmware catches up
+    }
+    event = prvEventAlloc(SIM_WINC_EVENT_SOCKET, s->recvFrom ? SOCKET_MSG_RECVFROM : SOCKET_MSG_RECV, sock);
+    received = SimNetRecv(sock, event->data, s->recvLen, &addr, &port);
+    if (received == SIM_NET_WOULD_BLOCK) {
+        return;
+    }
+    event->u.recv.pu8Buffer = s->recvBuf;
+    event->u.recv.s16BufferSize = (received > 0) ? (sint16)received : SOCK_ERR_CONN_ABORTED;
+    event->u.recv.u16RemainingSize = 0;
+    event->u.recv.strRemoteAddr.sin_family = AF_INET;
+    event->u.recv.strRemoteAddr.sin_port = port;
+    event->u.recv.strRemoteAddr.sin_addr.s_addr = addr;
+    prvEventPost();
+    s->recvPosted = false;
+    prvWatch(sock);
+}
+
+/// Accepts a connection on listening sock into a free TCP socket
+static void prvAccept(SOCKET sock)
+{
+    struct SimWincEvent *event;
+    SOCKET newSock = -1;
+    uint32_t addr;
+    uint16_t port;
+
+    if (simWincEventCount == SIM_WINC_EVENTS) {
+        return;
+    }
+    for (SOCKET i = 0; i < TCP_SOCK_MAX; i++) {
+        if (!simWincSockets[i].used) {
+            newSock = i;
+            break;
+        }
+    }
+    if (SimNetAccept(sock, newSock, &addr, &port) != 0 || newSock < 0) {
+        return;
+    }
+    memset(&simWincSockets[newSock], 0, offsetof(struct SimWincSocket, sendRing));
+    simWincSockets[newSock].generation++;
+    simWincSockets[newSock].used = true;
+    simWincSockets[newSock].tcp = true;
+    event = prvEventAlloc(SIM_WINC_EVENT_SOCKET, SOCKET_MSG_ACCEPT, sock);
+    event->u.accept.sock = newSock;
+    event->u.accept.strAddr.sin_family = AF_INET;
+    event->u.accept.strAddr.sin_port = port;
+    event->u.accept.strAddr.sin_addr.s_addr = addr;
+    prvEventPost();
+}
+
+/// Reports the connection to the access point, and DHCP right after, as m2m_wifi_request_dhcp_client is a no-op
+static void prvAssociate(void)
+{
+    struct SimWincEvent *event = prvEventAlloc(SIM_WINC_EVENT_WIFI, M2M_WIFI_RESP_CON_STATE_CHANGED, -1);
+
+    if (event != NULL) {
+        event->u.state.u8CurrState = M2M_WIFI_CONNECTED;
+        prvEventPost();
+    }
+    event = prvEventAlloc(SIM_WINC_EVENT_WIFI, M2M_WIFI_REQ_DHCP_CONF, -1);
+    if (event != NULL) {
+        event->u.ip.u32StaticIP = SIM_WINC_DHCP_IP;
+        event->u.ip.u32Gateway = SIM_WINC_DHCP_IP;
+        event->u.ip.u32DNS = SIM_WINC_DHCP_IP;
+        event->u.ip.u32SubnetMask = 0x000000FFUL;
+        prvEventPost();
+    }
+}
+
+static void prvIsr(void)
+{
+    nm_bsp_app_isr_hook();
+}
+
+static bool prvValid(SOCKET sock)
+{
+    return sock >= 0 && sock < SIM_NET_SOCKETS && simWincSockets[sock].used;
+}
+
+/******************************************************************************
+ * SimNet.h callbacks, with SimLock held
+ ******************************************************************************/
+
+void SimWincNetReady(int slot, bool readable, bool writable)
+{
+    struct SimWincSocket *s = &simWincSockets[slot];
+
+    if (!s->used) {
+        return;
+    }
+    if (writable && s->connecting) {
+        s->connecting = false;
+        prvSocketEvent((SOCKET)slot, SOCKET_MSG_CONNECT, (SimNetConnectResult(slot) == 0) ? SOCK_ERR_NO_ERROR : SOCK_ERR_CONN_ABORTED);
+    } else if (writable) {
+        prvFlush((SOCKET)slot);
+    }
+    if (readable && s->listening) {
+        prvAccept((SOCKET)slot);
+    } else if (readable && s->recvPosted) {
+        prvReceive((SOCKET)slot);
+    }
+    prvWatch((SOCKET)slot);
+}
+
+void SimWincNetResolved(const char *name, uint32_t addr)
+{
+    struct SimWincEvent *event = prvEventAlloc(SIM_WINC_EVENT_RESOLVE, 0, -1);
+
+    if (event != NULL) {
+        snprintf(event->name, sizeof(event->name), "%s", name);
+        event->u.resolved = addr;
+        prvEventPost();
+    }
+}
+
+/// Times out the recv() calls that are due, completes a pending association, and returns the next of these
+/// deadlines, 0 when there is none
+uint64_t SimWincNetDeadline(uint64_t nowNs)
+{
+    uint64_t next = 0;
+
+    if (simWincAssociateAt != 0 && nowNs >= simWincAssociateAt) {
+        simWincAssociateAt = 0;
+        prvAssociate();
+    }
+    next = simWincAssociateAt;
+
+    for (SOCKET sock = 0; sock < SIM_NET_SOCKETS; sock++) {
+        struct SimWincSocket *s = &simWincSockets[sock];
+        if (!s->used || !s->recvPosted || s->recvDeadline == 0) {
+            continue;
+        }
+        if (nowNs >= s->recvDeadline) {
+            s->recvPosted = false;
+            prvSocketEvent(sock, s->recvFrom ? SOCKET_MSG_RECVFROM : SOCKET_MSG_RECV, SOCK_ERR_TIMEOUT);
+            prvWatch(sock);
+        } else if (next == 0 || s->recvDeadline < next) {
+            next = s->recvDeadline;
+        }
+    }
+    return next;
+}
+
+void SimWincStart(void)
+{
+    SimIrqRegister(SIM_IRQ_WINC, prvIsr);
+    SimNetStart();
+}
+
+/******************************************************************************
+ * BSP and m2m_wifi
+ ******************************************************************************/
+
+sint8 nm_bsp_init(void)
+{
+    return M2M_SUCCESS;
+}
+
+sint8 m2m_wifi_init(tstrWifiInitParam *pWifiInitParam)
+{
+    SimLock();
+    simWincWifiCb = pWifiInitParam->pfAppWifiCb;
+    SimUnlock();
+    return M2M_SUCCESS;
+}
+
+/// Any access point accepts the connection after SIM_WINC_ASSOCIATE_NS, see prvAssociate
+sint8 m2m_wifi_connect(char *pcSsid, uint8 u8SsidLen, uint8 u8SecType, void *pvAuthInfo, uint16 u16Ch)
+{
+    SimLock();
+    simWincAssociateAt = SimNowNs() + SIM_WINC_ASSOCIATE_NS;
+    SimUnlock();
+    return M2M_SUCCESS;
+}
+
+sint8 m2m_wifi_request_dhcp_client(void)
+{
+    return M2M_SUCCESS;
+}
+
+/// Calls the callbacks of the events queued so far, from the calling task
+sint8 m2m_wifi_handle_events(void *arg)
+{
+    static struct SimWincEvent event;  // Only the Wifi task handles events
+    // Read without the lock: the firmware polls this in loops, which would keep the model threads off the lock
+    uint8_t pending = __atomic_load_n(&simWincEventCount, __ATOMIC_ACQUIRE);
+    while (pending-- > 0) {
+        bool stale;
+
+        SimLock();
+        event = simWincEvents[simWincEventHead];
+        simWincEventHead = (uint8_t)((simWincEventHead + 1) % SIM_WINC_EVENTS);
+        simWincEventCount--;
+        stale = event.sock >= 0 && (!simWincSockets[event.sock].used || simWincSockets[event.sock].generation != event.generation);
+        SimUnlock();
+
+        if (stale) {
+            if (event.msg == SOCKET_MSG_ACCEPT) {
+                close(event.u.accept.sock);
+            }
+            continue;
+        }
+        switch (event.kind) {
+            case SIM_WINC_EVENT_WIFI:
+                if (simWincWifiCb != NULL) {
+                    simWincWifiCb(event.msg, &event.u);
+                }
+                break;
+            case SIM_WINC_EVENT_SOCKET:
+                if ((event.msg == SOCKET_MSG_RECV || event.msg == SOCKET_MSG_RECVFROM) && event.u.recv.s16BufferSize > 0) {
+                    memcpy(event.u.recv.pu8Buffer, event.data, (size_t)event.u.recv.s16BufferSize);
+                }
+                if (simWincSocketCb != NULL) {
+                    simWincSocketCb(event.sock, event.msg, &event.u);
+                }
+                break;
+            case SIM_WINC_EVENT_RESOLVE:
+                if (simWincResolveCb != NULL) {
+                    simWincResolveCb((uint8 *)event.name, event.u.resolved);
+                }
+                break;
+        }
+    }
+    return M2M_SUCCESS;
+}
+
+/******************************************************************************
+ * Sockets
+ ******************************************************************************/
+
+void socketInit(void)
+{
+}
+
+/// Closes every socket and forgets the callbacks, so nothing of the old session is reported after socketInit
+void socketDeinit(void)
+{
+    for (SOCKET sock = 0; sock < SIM_NET_SOCKETS; sock++) {
+        close(sock);
+    }
+    SimLock();
+    simWincSocketCb = NULL;
+    simWincResolveCb = NULL;
+    SimUnlock();
+}
+
+void registerSocketCallback(tpfAppSocketCb socket_cb, tpfAppResolveCb resolve_cb)
+{
+    SimLock();
+    simWincSocketCb = socket_cb;
+    simWincResolveCb = resolve_cb;
+    SimUnlock();
+}
+
+SOCKET socket(uint16 u16Domain, uint8 u8Type, uint8 u8Flags)
+{
+    SOCKET first = (u8Type == SOCK_STREAM) ? 0 : TCP_SOCK_MAX;
+    SOCKET last = (u8Type == SOCK_STREAM) ? TCP_SOCK_MAX : SIM_NET_SOCKETS;
+    SOCKET sock = -1;
+
+    if (u16Domain != AF_INET || (u8Type != SOCK_STREAM && u8Type != SOCK_DGRAM)) {
+        return -1;
+    }
+    if (u8Flags & SOCKET_FLAGS_SSL) {
+        SimLog("sim: TLS sockets are not modelled\n");
+        return -1;
+    }
+    SimLock();
+    for (SOCKET i = first; i < last; i++) {
+        if (!simWincSockets[i].used) {
+            sock = i;
+            break;
+        }
+    }
+    if (sock >= 0) {
+        struct SimWincSocket *s = &simWincSockets[sock];
+        uint32_t generation = s->generation;
+        memset(s, 0, offsetof(struct SimWincSocket, sendRing));
+        s->generation = generation + 1;
+        s->tcp = (u8Type == SOCK_STREAM);
+        s->used = (SimNetOpen(sock, s->tcp) == 0);
+        if (!s->used) {
+            sock = -1;
+        }
+    }
+    SimUnlock();
+    return sock;
+}
+
+sint8 bind(SOCKET sock, struct sockaddr *pstrAddr, uint8 u8AddrLen)
+{
+    struct sockaddr_in *addr = (struct sockaddr_in *)pstrAddr;
+
+    if (pstrAddr == NULL || u8AddrLen < sizeof(struct sockaddr_in)) {
+        return SOCK_ERR_INVALID_ARG;
+    }
+    SimLock();
+    if (!prvValid(sock)) {
+        SimUnlock();
+        return SOCK_ERR_INVALID_ARG;
+    }
+    prvSocketEvent(sock, SOCKET_MSG_BIND, (SimNetBind(sock, addr->sin_addr.s_addr, addr->sin_port) == 0) ? SOCK_ERR_NO_ERROR : SOCK_ERR_ADDR_ALREADY_IN_USE);
+    SimUnlock();
+    return SOCK_ERR_NO_ERROR;
+}
+
+sint8 listen(SOCKET sock, uint8 backlog)
+{
+    SimLock();
+    if (!prvValid(sock) || !simWincSockets[sock].tcp) {
+        SimUnlock();
+        return SOCK_ERR_INVALID_ARG;
+    }
+    simWincSockets[sock].listening = (SimNetListen(sock) == 0);
+    prvSocketEvent(sock, SOCKET_MSG_LISTEN, simWincSockets[sock].listening ? SOCK_ERR_NO_ERROR : SOCK_ERR_INVALID);
+    prvWatch(sock);
+    SimUnlock();
+    return SOCK_ERR_NO_ERROR;
+}
+
+/// Connections are accepted by the model as they come and reported with SOCKET_MSG_ACCEPT, as on the WINC
+sint8 accept(SOCKET sock, struct sockaddr *addr, uint8 *addrlen)
+{
+    return SOCK_ERR_NO_ERROR;
+}
+
+sint8 connect(SOCKET sock, struct sockaddr *pstrAddr, uint8 u8AddrLen)
+{
+    struct sockaddr_in *addr = (struct sockaddr_in *)pstrAddr;
+    int result;
+
+    if (pstrAddr == NULL || u8AddrLen < sizeof(struct sockaddr_in)) {
+        return SOCK_ERR_INVALID_ARG;
+    }
+    SimLock();
+    if (!prvValid(sock) || !simWincSockets[sock].tcp) {
+        SimUnlock();
+        return SOCK_ERR_INVALID_ARG;
+    }
+    result = SimNetConnect(sock, addr->sin_addr.s_addr, addr->sin_port);
+    if (result == 1) {
+        simWincSockets[sock].connecting = true;
+        prvWatch(sock);
+    } else {
+        prvSocketEvent(sock, SOCKET_MSG_CONNECT, (result == 0) ? SOCK_ERR_NO_ERROR : SOCK_ERR_CONN_ABORTED);
+    }
+    SimUnlock();
+    return SOCK_ERR_NO_ERROR;
+}
+
+static sint16 prvRecv(SOCKET sock, void *pvRecvBuf, uint16 u16BufLen, uint32 u32Timeoutmsec, bool from)
+{
+    struct SimWincSocket *s = &simWincSockets[sock];
+
+    if (pvRecvBuf == NULL || u16BufLen == 0) {
+        return SOCK_ERR_INVALID_ARG;
+    }
+    SimLock();
+    if (!prvValid(sock) || s->recvPosted) {
+        SimUnlock();
+        return SOCK_ERR_INVALID_ARG;
+    }
+    s->recvPosted = true;
+    s->recvFrom = from;
+    s->recvBuf = pvRecvBuf;
+    s->recvLen = (u16BufLen < SOCKET_BUFFER_MAX_LENGTH) ? u16BufLen : SOCKET_BUFFER_MAX_LENGTH;
+    s->recvDeadline = (u32Timeoutmsec != 0) ? SimNowNs() + (uint64_t)u32Timeoutmsec * 1000000 : 0;
+    prvReceive(sock);
+    SimUnlock();
+    return SOCK_ERR_NO_ERROR;
+}
+
+sint16 recv(SOCKET sock, void *pvRecvBuf, uint16 u16BufLen, uint32 u32Timeoutmsec)
+{
+    return prvRecv(sock, pvRecvBuf, u16BufLen, u32Timeoutmsec, false);
+}
+
+sint16 recvfrom(SOCKET sock, void *pvRecvBuf, uint16 u16BufLen, uint32 u32Timeoutmsec)
+{
+    return prvRecv(sock, pvRecvBuf, u16BufLen, u32Timeoutmsec, true);
+}
+
+sint16 send(SOCKET sock, void *pvSendBuffer, uint16 u16SendLength, uint16 u16Flags)
+{
+    struct SimWincSocket *s = &simWincSockets[sock];
+    const uint8_t *data = pvSendBuffer;
+
+    if (pvSendBuffer == NULL || u16SendLength == 0 || u16SendLength > SOCKET_BUFFER_MAX_LENGTH) {
+        return SOCK_ERR_INVALID_ARG;
+    }
+    SimLock();
+    if (!prvValid(sock) || !s->tcp) {
+        SimUnlock();
+        return SOCK_ERR_INVALID_ARG;
+    }
+    if (s->sendQueued == SIM_WINC_SEND_QUEUE || s->sendCount + u16SendLength > SIM_WINC_SEND_RING) {
+        SimUnlock();
+        return SOCK_ERR_BUFFER_FULL;
+    }
+    for (uint16_t i = 0; i < u16SendLength; i++) {
+        s->sendRing[(s->sendHead + s->sendCount + i) % SIM_WINC_SEND_RING] = data[i];
+    }
+    s->sendCount = (uint16_t)(s->sendCount + u16SendLength);
+    s->sendLens[s->sendQueued++] = u16SendLength;
+    prvFlush(sock);
+    SimUnlock();
+    return SOCK_ERR_NO_ERROR;
+}
+
+/// A datagram goes out at once; one the host has no room for is lost, as UDP allows
+sint16 sendto(SOCKET sock, void *pvSendBuffer, uint16 u16SendLength, uint16 flags, struct sockaddr *pstrDestAddr, uint8 u8AddrLen)
+{
+    struct sockaddr_in *addr = (struct sockaddr_in *)pstrDestAddr;
+    long sent;
+
+    if (pvSendBuffer == NULL || u16SendLength > SOCKET_BUFFER_MAX_LENGTH || addr == NULL || u8AddrLen < sizeof(struct sockaddr_in)) {
+        return SOCK_ERR_INVALID_ARG;
+    }
+    SimLock();
+    if (!prvValid(sock) || simWincSockets[sock].tcp) {
+        SimUnlock();
+        return SOCK_ERR_INVALID_ARG;
+    }
+    sent = SimNetSend(sock, pvSendBuffer, u16SendLength, addr->sin_addr.s_addr, addr->sin_port);
+    prvSocketEvent(sock, SOCKET_MSG_SENDTO, (sent >= 0 || sent == SIM_NET_WOULD_BLOCK) ? (sint16)u16SendLength : SOCK_ERR_INVALID_ADDRESS);
+    SimUnlock();
+    return SOCK_ERR_NO_ERROR;
+}
+
+sint8 close(SOCKET sock)
+{
+    SimLock();
+    if (!prvValid(sock)) {
+        SimUnlock();
+        return SOCK_ERR_INVALID_ARG;
+    }
+    SimNetClose(sock);
+    simWincSockets[sock].used = false;
+    simWincSockets[sock].generation++;
+    SimUnlock();
+    return SOCK_ERR_NO_ERROR;
+}
+
+sint8 gethostbyname(uint8 *pcHostName)
+{
+    if (pcHostName == NULL || strlen((char *)pcHostName) >= HOSTNAME_MAX_SIZE) {
+        return SOCK_ERR_INVALID_ARG;
+    }
+    SimLock();
+    SimNetResolve((char *)pcHostName);
+    SimUnlock();
+    return SOCK_ERR_NO_ERROR;
+}
+
+/// Dotted decimal to an address in network byte order, 0 when malformed
+uint32 nmi_inet_addr(char *pcIpAddr)
+{
+    uint8_t bytes[4];
+    unsigned a, b, c, d;
+    char end;
+
+    if (sscanf(pcIpAddr, "%u.%u.%u.%u%c", &a, &b, &c, &d, &end) != 4 || a > 255 || b > 255 || c > 255 || d > 255) {
+        return 0;
+    }
+    bytes[0] = (uint8_t)a;
+    bytes[1] = (uint8_t)b;
+    bytes[2] = (uint8_t)c;
+    bytes[3] = (uint8_t)d;
+    return (uint32)bytes[0] | ((uint32)bytes[1] << 8) | ((uint32)bytes[2] << 16) | ((uint32)bytes[3] << 24);
+}
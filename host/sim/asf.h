@@ -0,0 +1,433 @@
+/**************************************************************************/ /**
+ * @file      asf.h
+ * @brief     ASF of the firmware simulator: the drivers the firmware calls, with the types, registers and board
+ *            definitions it uses. The drivers run against the peripheral models of SimAsf.c and SimI2c.c.
+ * @details   Same guard as the ASF umbrella header of the firmware, which the build force-includes this header in
+ *            front of, so that "asf.h" next to main21.c resolves to this one. Register blocks are plain memory the
+ *            models keep up to date, so the firmware reads them as it does on the target.
+ * @date      2026-10-19
+
+ ******************************************************************************/
+
+#ifndef ASF_H
+#define ASF_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "FreeRTOS.h"
+#include "compiler.h"
+#include "crc32.h"
+#include "ff.h"
+#include "semphr.h"
+#include "task.h"
+#include "timers.h"
+
+#define Assert(expr) ((void)0)
+
+/****
+ * System, clock and interrupts
+ ******************************************************************************/
+void system_init(void);
+void system_reset(void) __attribute__((noreturn));
+uint32_t system_cpu_clock_get_hz(void);
+void system_interrupt_enter_critical_section(void);
+void system_interrupt_leave_critical_section(void);
+#define cpu_irq_enable() portENABLE_INTERRUPTS()
+#define cpu_irq_disable() portDISABLE_INTERRUPTS()
+
+void delay_init(void);
+void delay_cycles_us(uint32_t us);
+void delay_cycles_ms(uint32_t ms);
+#define delay_us(us) delay_cycles_us(us)
+#define delay_ms(ms) delay_cycles_ms(ms)
+#define delay_s(s) delay_cycles_ms(1000 * (s))
+
+/// SysTick down counter, read from the simulated clock, see SimAsf.c
+typedef struct {
+    uint32_t CTRL;
+    uint32_t LOAD;
+    uint32_t VAL;
+} SysTick_Type;
+const SysTick_Type *SimSysTick(void);
+#define SysTick (SimSysTick())
+
+/// The SysTick interrupt never waits for the counter reads of the firmware
+typedef struct {
+    uint32_t ICSR;
+} SCB_Type;
+extern SCB_Type simScb;
+#define SCB (&simScb)
+#define SCB_ICSR_PENDSTSET_Msk (1UL << 26)
+
+/****
+ * PORT
+ ******************************************************************************/
+#define PIN_PA08 8
+#define PIN_PA09 9
+#define PIN_PA14 14
+#define PIN_PA21 21
+#define PIN_PA23 23
+#define PIN_PB02 34
+#define PIN_PB03 35
+
+void port_pin_set_output_level(const uint8_t gpio_pin, const bool level);
+void port_pin_toggle_output_level(const uint8_t gpio_pin);
+bool port_pin_get_input_level(const uint8_t gpio_pin);
+
+/****
+ * Board: SAMW25 Xplained Pro
+ ******************************************************************************/
+#define LED_0_PIN PIN_PA23
+#define LED0_PIN LED_0_PIN
+#define LED_0_ACTIVE false
+#define LED_0_INACTIVE !LED_0_ACTIVE
+#define LED0_ACTIVE LED_0_ACTIVE
+#define LED0_INACTIVE LED_0_INACTIVE
+#define LED_On(led_gpio) port_pin_set_output_level(led_gpio, LED_0_ACTIVE)
+#define LED_Off(led_gpio) port_pin_set_output_level(led_gpio, LED_0_INACTIVE)
+#define LED_Toggle(led_gpio) port_pin_toggle_output_level(led_gpio)
+
+#define BUTTON_0_PIN PIN_PB02
+#define BUTTON_0_ACTIVE false
+#define BUTTON_0_EIC_PIN PIN_PB02
+#define BUTTON_0_EIC_MUX 0
+#define BUTTON_0_EIC_LINE 2
+
+#define EXT1_IRQ_PIN PIN_PB03
+#define EXT1_IRQ_MUX 0
+#define EXT1_IRQ_PINMUX ((EXT1_IRQ_PIN << 16) | EXT1_IRQ_MUX)
+#define EXT1_IRQ_INPUT 3
+
+#define PINMUX_UNUSED 0xFFFFFFFF
+#define PINMUX_DEFAULT 0
+#define PINMUX_PA08C_SERCOM0_PAD0 ((PIN_PA08 << 16) | 2)
+#define PINMUX_PA09C_SERCOM0_PAD1 ((PIN_PA09 << 16) | 2)
+
+/****
+ * SERCOM
+ ******************************************************************************/
+/// The data register is all the firmware touches, the DMA descriptors point at it
+typedef struct {
+    struct {
+        volatile uint16_t reg;
+    } DATA;
+} SercomUsart;
+
+typedef union {
+    SercomUsart USART;
+} Sercom;
+
+extern Sercom simSercom[6];
+#define SERCOM0 (&simSercom[0])
+#define SERCOM2 (&simSercom[2])
+#define SERCOM4 (&simSercom[4])
+
+#define EDBG_CDC_MODULE SERCOM4
+#define EDBG_CDC_SERCOM_MUX_SETTING USART_RX_3_TX_2_XCK_3
+#define EDBG_CDC_SERCOM_PINMUX_PAD0 PINMUX_UNUSED
+#define EDBG_CDC_SERCOM_PINMUX_PAD1 PINMUX_UNUSED
+#define EDBG_CDC_SERCOM_PINMUX_PAD2 ((PIN_PB10 << 16) | 3)
+#define EDBG_CDC_SERCOM_PINMUX_PAD3 ((PIN_PB11 << 16) | 3)
+#define PIN_PB10 42
+#define PIN_PB11 43
+
+/****
+ * USART
+ ******************************************************************************/
+enum usart_signal_mux_settings { USART_RX_3_TX_2_XCK_3 = 0x31 };
+
+enum usart_callback {
+    USART_CALLBACK_BUFFER_TRANSMITTED,
+    USART_CALLBACK_BUFFER_RECEIVED,
+    USART_CALLBACK_ERROR,
+    USART_CALLBACK_N,
+};
+
+struct usart_module;
+typedef void (*usart_callback_t)(struct usart_module *const module);
+
+struct usart_config {
+    uint32_t baudrate;
+    enum usart_signal_mux_settings mux_setting;
+    uint32_t pinmux_pad0;
+    uint32_t pinmux_pad1;
+    uint32_t pinmux_pad2;
+    uint32_t pinmux_pad3;
+};
+
+struct usart_module {
+    Sercom *hw;
+    uint32_t baudrate;
+    usart_callback_t callback[USART_CALLBACK_N];
+    uint8_t callback_reg_mask;
+    uint8_t callback_enable_mask;
+    volatile uint16_t remaining_rx_buffer_length;
+    uint8_t *rx_buffer_ptr;
+    volatile enum status_code rx_status;
+};
+
+void usart_get_config_defaults(struct usart_config *const config);
+enum status_code usart_init(struct usart_module *const module, Sercom *const hw, const struct usart_config *const config);
+void usart_enable(const struct usart_module *const module);
+void usart_disable(const struct usart_module *const module);
+void usart_register_callback(struct usart_module *const module, usart_callback_t callback_func,
+                             enum usart_callback callback_type);
+void usart_enable_callback(struct usart_module *const module, enum usart_callback callback_type);
+void usart_disable_callback(struct usart_module *const module, enum usart_callback callback_type);
+enum status_code usart_read_buffer_job(struct usart_module *const module, uint8_t *rx_data, uint16_t length);
+enum status_code usart_write_wait(struct usart_module *const module, const uint16_t tx_data);
+
+/****
+ * DMAC
+ ******************************************************************************/
+typedef struct {
+    union {
+        struct {
+            uint16_t VALID : 1;
+            uint16_t EVOSEL : 2;
+            uint16_t BLOCKACT : 2;
+            uint16_t : 3;
+            uint16_t BEATSIZE : 2;
+            uint16_t SRCINC : 1;
+            uint16_t DSTINC : 1;
+            uint16_t STEPSEL : 1;
+            uint16_t STEPSIZE : 3;
+        } bit;
+        uint16_t reg;
+    } BTCTRL;
+    union {
+        uint16_t reg;
+    } BTCNT;
+    union {
+        uint32_t reg;
+    } SRCADDR;
+    union {
+        uint32_t reg;
+    } DSTADDR;
+    union {
+        uint32_t reg;
+    } DESCADDR;
+} DmacDescriptor;
+
+/// The channel registers the firmware uses. SUSP reads set: the models keep the write-back BTCNT current anyway.
+typedef struct {
+    struct {
+        volatile uint8_t reg;
+    } CHID;
+    struct {
+        volatile uint32_t reg;
+    } CHCTRLB;
+    struct {
+        volatile uint8_t reg;
+    } CHINTFLAG;
+    struct {
+        uintptr_t reg;
+    } WRBADDR;
+} Dmac;
+
+extern Dmac simDmac;
+#define DMAC (&simDmac)
+#define DMAC_CHID_ID(value) ((uint8_t)(value))
+#define DMAC_CHCTRLB_CMD_SUSPEND (0x1u << 22)
+#define DMAC_CHCTRLB_CMD_RESUME (0x2u << 22)
+#define DMAC_CHINTFLAG_SUSP (0x1u << 2)
+#define CONF_MAX_USED_CHANNEL_NUM 5
+
+#define SERCOM0_DMAC_ID_RX 0x01
+#define SERCOM0_DMAC_ID_TX 0x02
+#define SERCOM4_DMAC_ID_RX 0x09
+#define SERCOM4_DMAC_ID_TX 0x0A
+
+enum dma_beat_size { DMA_BEAT_SIZE_BYTE = 0, DMA_BEAT_SIZE_HWORD, DMA_BEAT_SIZE_WORD };
+enum dma_block_action { DMA_BLOCK_ACTION_NOACT = 0, DMA_BLOCK_ACTION_INT, DMA_BLOCK_ACTION_SUSPEND, DMA_BLOCK_ACTION_BOTH };
+enum dma_transfer_trigger_action {
+    DMA_TRIGGER_ACTION_BLOCK = 0,
+    DMA_TRIGGER_ACTION_BEAT = 2,
+    DMA_TRIGGER_ACTION_TRANSACTION = 3,
+};
+enum dma_callback_type {
+    DMA_CALLBACK_TRANSFER_ERROR,
+    DMA_CALLBACK_TRANSFER_DONE,
+    DMA_CALLBACK_CHANNEL_SUSPEND,
+    DMA_CALLBACK_N,
+};
+
+struct dma_resource;
+typedef void (*dma_callback_t)(struct dma_resource *const resource);
+
+struct dma_descriptor_config {
+    bool descriptor_valid;
+    enum dma_block_action block_action;
+    enum dma_beat_size beat_size;
+    bool src_increment_enable;
+    bool dst_increment_enable;
+    uint16_t block_transfer_count;
+    uint32_t source_address;
+    uint32_t destination_address;
+    uint32_t next_descriptor_address;
+};
+
+struct dma_resource_config {
+    uint8_t peripheral_trigger;
+    enum dma_transfer_trigger_action trigger_action;
+};
+
+struct dma_resource {
+    uint8_t channel_id;
+    dma_callback_t callback[DMA_CALLBACK_N];
+    uint8_t callback_enable;
+    volatile enum status_code job_status;
+    uint32_t transfered_size;
+    DmacDescriptor *descriptor;
+};
+
+void dma_get_config_defaults(struct dma_resource_config *config);
+enum status_code dma_allocate(struct dma_resource *resource, struct dma_resource_config *config);
+void dma_descriptor_get_config_defaults(struct dma_descriptor_config *config);
+void dma_descriptor_create(DmacDescriptor *descriptor, struct dma_descriptor_config *config);
+enum status_code dma_add_descriptor(struct dma_resource *resource, DmacDescriptor *descriptor);
+void dma_register_callback(struct dma_resource *resource, dma_callback_t callback, enum dma_callback_type type);
+void dma_enable_callback(struct dma_resource *resource, enum dma_callback_type type);
+enum status_code dma_start_transfer_job(struct dma_resource *resource);
+void dma_abort_job(struct dma_resource *resource);
+
+/****
+ * I2C master
+ ******************************************************************************/
+enum i2c_master_callback {
+    I2C_MASTER_CALLBACK_WRITE_COMPLETE = 0,
+    I2C_MASTER_CALLBACK_READ_COMPLETE = 1,
+    I2C_MASTER_CALLBACK_ERROR = 2,
+    _I2C_MASTER_CALLBACK_N = 3,
+};
+
+struct i2c_master_module;
+typedef void (*i2c_master_callback_t)(struct i2c_master_module *const module);
+
+#define I2C_MASTER_BAUD_RATE_100KHZ 100
+#define I2C_MASTER_BAUD_RATE_400KHZ 400
+
+struct i2c_master_config {
+    uint32_t baud_rate;  ///< kHz, as in ASF
+    uint16_t unknown_bus_state_timeout;
+    uint16_t buffer_timeout;
+    uint32_t pinmux_pad0;
+    uint32_t pinmux_pad1;
+};
+
+struct i2c_master_packet {
+    uint16_t address;
+    uint16_t data_length;
+    uint8_t *data;
+    bool ten_bit_address;
+    bool high_speed;
+    uint8_t hs_master_code;
+};
+
+struct i2c_master_module {
+    Sercom *hw;
+    uint32_t baud_rate;
+    i2c_master_callback_t callbacks[_I2C_MASTER_CALLBACK_N];
+    volatile uint8_t registered_callback;
+    volatile uint8_t enabled_callback;
+    volatile uint16_t buffer_length;
+    volatile uint16_t buffer_remaining;
+    volatile uint8_t *buffer;
+    volatile uint8_t transfer_direction;
+    volatile enum status_code status;
+    bool send_stop;
+};
+
+void i2c_master_get_config_defaults(struct i2c_master_config *const config);
+enum status_code i2c_master_init(struct i2c_master_module *const module, Sercom *const hw,
+                                 const struct i2c_master_config *const config);
+void i2c_master_enable(const struct i2c_master_module *const module);
+void i2c_master_reset(struct i2c_master_module *const module);
+void i2c_master_register_callback(struct i2c_master_module *const module, i2c_master_callback_t callback,
+                                  enum i2c_master_callback callback_type);
+void i2c_master_enable_callback(struct i2c_master_module *const module, enum i2c_master_callback callback_type);
+enum status_code i2c_master_read_packet_job(struct i2c_master_module *const module,
+                                            struct i2c_master_packet *const packet);
+enum status_code i2c_master_write_packet_job(struct i2c_master_module *const module,
+                                             struct i2c_master_packet *const packet);
+enum status_code i2c_master_write_packet_job_no_stop(struct i2c_master_module *const module,
+                                                     struct i2c_master_packet *const packet);
+
+/****
+ * EXTINT
+ ******************************************************************************/
+#define EXTINT_CHANNELS 16
+
+enum extint_detect {
+    EXTINT_DETECT_NONE,
+    EXTINT_DETECT_RISING,
+    EXTINT_DETECT_FALLING,
+    EXTINT_DETECT_BOTH,
+    EXTINT_DETECT_HIGH,
+    EXTINT_DETECT_LOW,
+};
+enum extint_pull { EXTINT_PULL_UP, EXTINT_PULL_DOWN, EXTINT_PULL_NONE };
+enum extint_callback_type { EXTINT_CALLBACK_TYPE_DETECT };
+
+typedef void (*extint_callback_t)(void);
+
+struct extint_chan_conf {
+    uint32_t gpio_pin;
+    uint32_t gpio_pin_mux;
+    enum extint_pull gpio_pin_pull;
+    bool wake_if_sleeping;
+    bool filter_input_signal;
+    enum extint_detect detection_criteria;
+};
+
+void extint_chan_get_config_defaults(struct extint_chan_conf *const config);
+void extint_chan_set_config(const uint8_t channel, const struct extint_chan_conf *const config);
+enum status_code extint_register_callback(const extint_callback_t callback, const uint8_t channel,
+                                          const enum extint_callback_type type);
+enum status_code extint_chan_enable_callback(const uint8_t channel, const enum extint_callback_type type);
+enum status_code extint_chan_disable_callback(const uint8_t channel, const enum extint_callback_type type);
+uint8_t extint_get_current_channel(void);
+
+/****
+ * NVM: the flash is mapped at its target addresses, see SimAsf.c
+ ******************************************************************************/
+#define NVMCTRL_PAGE_SIZE 64
+#define NVMCTRL_ROW_SIZE (4 * NVMCTRL_PAGE_SIZE)
+#define FLASH_SIZE 0x40000
+
+struct nvm_config {
+    bool manual_page_write;
+};
+
+void nvm_get_config_defaults(struct nvm_config *const config);
+enum status_code nvm_set_config(const struct nvm_config *const config);
+enum status_code nvm_erase_row(const uint32_t row_address);
+enum status_code nvm_write_buffer(const uint32_t destination_address, const uint8_t *buffer, uint16_t length);
+
+/****
+ * SD/MMC over SPI: the card is an image file, see HostDisk.h
+ ******************************************************************************/
+#define LUN_ID_SD_MMC_0_MEM 0
+
+typedef uint8_t sd_mmc_err_t;
+#define SD_MMC_OK 0
+#define SD_MMC_INIT_ONGOING 1
+#define SD_MMC_ERR_NO_CARD 2
+
+typedef enum { CTRL_GOOD = 0, CTRL_FAIL, CTRL_NO_PRESENT, CTRL_BUSY } Ctrl_status;
+
+void sd_mmc_init(void);
+sd_mmc_err_t sd_mmc_check(uint8_t slot);
+Ctrl_status sd_mmc_test_unit_ready(uint8_t slot);
+
+/****
+ * Standard I/O over the console USART
+ ******************************************************************************/
+typedef struct usart_module *usart_if;
+typedef struct usart_config usart_serial_options_t;
+void stdio_serial_init(struct usart_module *const module, Sercom *const hw, const struct usart_config *const config);
+
+#endif /* ASF_H */
@@ -0,0 +1,33 @@
+/**************************************************************************/ /**
+ * @file      compiler.h
+ * @brief     ASF compiler header of the firmware simulator: the standard types, the attributes the firmware uses
+ *            and the ASF status codes.
+ * @date      2026-10-19
+
+ ******************************************************************************/
+
+#ifndef UTILS_COMPILER_H_INCLUDED
+#define UTILS_COMPILER_H_INCLUDED
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <status_codes.h>
+
+#define COMPILER_ALIGNED(a) __attribute__((__aligned__(a)))
+#define COMPILER_WORD_ALIGNED __attribute__((__aligned__(4)))
+#define COMPILER_PACK_SET(alignment) _Pragma("pack(alignment)")
+#define COMPILER_PACK_RESET() _Pragma("pack()")
+#define UNUSED(v) (void)(v)
+
+#ifndef Min
+#define Min(a, b) (((a) < (b)) ? (a) : (b))
+#endif
+#ifndef Max
+#define Max(a, b) (((a) > (b)) ? (a) : (b))
+#endif
+
+#endif /* UTILS_COMPILER_H_INCLUDED */
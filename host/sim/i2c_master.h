@@ -0,0 +1,10 @@
+/**************************************************************************/ /**
+ * @file      i2c_master.h
+ * @brief     The simulator declares the I2C master driver with the rest of its ASF, see asf.h.
+ * @date      2026-10-19
+
+ ******************************************************************************/
+
+#pragma once
+
+#include "asf.h"
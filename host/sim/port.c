@@ -0,0 +1,444 @@
+/**************************************************************************/ /**
+ * @file      port.c
+ * @brief     FreeRTOS port of the firmware simulator, on POSIX threads and signals.
+ * @details   Every task runs on a thread of its own, which waits on its condition variable whenever its task is not
+ *            the current one, so the kernel decides which single thread runs like on the target. The thread stacks
+ *            are the host's; the stack FreeRTOS allocates only holds the SimThread of the task at its top, and
+ *            pxTopOfStack of the TCB points below it and never moves.
+ *
+ *            SIGALRM is the SysTick and SIGUSR1 the peripheral interrupts (Sim.h). Both are process directed, and all
+ *            threads block them except the one of the running task while it is outside a critical section, so the
+ *            handler runs on the running task as an interrupt would. A tick or an interrupt handler that wakes a
+ *            higher priority task switches to it from within the handler, and the interrupted thread resumes there
+ *            when its task runs again. A tick signal that arrives late counts the ticks it missed, so the tick count
+ *            follows the host clock; after a stall of the host it slips instead of running SIM_TICK_CATCH_UP ticks
+ *            back to back.
+ *
+ *            Disabling interrupts is blocking the two signals, one system call, so critical sections cost more than
+ *            on the target and show in profiles as rt_sigprocmask.
+ * @date      2026-10-19
+
+ ******************************************************************************/
+
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "FreeRTOS.h"
+#include "Sim.h"
+#include "task.h"
+
+#define SIM_SIG_TICK SIGALRM
+#define SIM_SIG_IRQ SIGUSR1
+#define SIM_TICK_NS (1000000000ull / configTICK_RATE_HZ)
+#define SIM_TICK_CATCH_UP 20  ///< Ticks counted at most by one tick signal
+
+/// Thread of a task, kept at the top of the stack FreeRTOS allocated for it
+typedef struct SimThread {
+    pthread_t thread;
+    TaskFunction_t code;
+    void *parameters;
+    pthread_cond_t wake;
+    bool running;  ///< Its task is the current one. Guarded by simCpuMutex
+    bool dying;    ///< Its task was deleted. Guarded by simCpuMutex
+} SimThread;
+
+static pthread_once_t simOnce = PTHREAD_ONCE_INIT;
+static pthread_mutex_t simCpuMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t simModelMutex = PTHREAD_MUTEX_INITIALIZER;  ///< Guards the SimLock tickets
+static pthread_cond_t simModelTurn = PTHREAD_COND_INITIALIZER;
+static uint32_t simModelTicket = 0;   ///< Next ticket of SimLock
+static uint32_t simModelServing = 0;  ///< Ticket that holds SimLock
+static sigset_t simInterrupts;                                      ///< SIM_SIG_TICK and SIM_SIG_IRQ
+static uint64_t simStartNs;                                         ///< Host clock at start
+static uint64_t simTickBaseNs = 0;                                  ///< Time of tick 0, moves when ticks slip
+static uint64_t simTicks = 0;                                       ///< Ticks counted
+static volatile uint32_t simIrqPending = 0;                         ///< Bit per SimIrq
+static SimIsr simIsr[SIM_IRQ_COUNT];
+static volatile bool simYieldPending = false;  ///< An interrupt handler woke a task
+static uint32_t simRunSeconds = 0;
+
+static __thread UBaseType_t uxCriticalNesting = 0xaaaaaaaa;  ///< Nonzero until a task runs, as in the ARM port
+static __thread bool simInIsr = false;
+static __thread sigset_t simLockMask;
+
+/******************************************************************************
+ * Local Functions
+ ******************************************************************************/
+
+static uint64_t prvHostNs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static void prvInit(void)
+{
+    sigemptyset(&simInterrupts);
+    sigaddset(&simInterrupts, SIM_SIG_TICK);
+    sigaddset(&simInterrupts, SIM_SIG_IRQ);
+    simStartNs = prvHostNs();
+}
+
+static SimThread *prvThreadOf(TaskHandle_t task)
+{
+    StackType_t *topOfStack = *(StackType_t **)task;  // First member of the TCB
+    return (SimThread *)(topOfStack + 1);
+}
+
+/// Waits until the task of thread is the current one. The thread ends there if its task was deleted.
+static void prvWaitToRun(SimThread *thread)
+{
+    bool dying;
+
+    while (!thread->running && !thread->dying) {
+        pthread_cond_wait(&thread->wake, &simCpuMutex);
+    }
+    dying = thread->dying;
+    pthread_mutex_unlock(&simCpuMutex);
+    if (dying) {
+        pthread_exit(NULL);
+    }
+}
+
+/// Hands the CPU from the calling thread to another one. Interrupts must be disabled.
+static void prvSwitchThread(SimThread *from, SimThread *to)
+{
+    if (from == to) {
+        return;
+    }
+    pthread_mutex_lock(&simCpuMutex);
+    from->running = false;
+    to->running = true;
+    pthread_cond_signal(&to->wake);
+    prvWaitToRun(from);
+}
+
+/// Lets the kernel pick the next task and switches to it. Interrupts must be disabled.
+static void prvSwitchContext(void)
+{
+    SimThread *from = prvThreadOf(xTaskGetCurrentTaskHandle());
+    vTaskSwitchContext();
+    prvSwitchThread(from, prvThreadOf(xTaskGetCurrentTaskHandle()));
+}
+
+static void *prvTaskThread(void *arg)
+{
+    SimThread *thread = arg;
+
+    pthread_mutex_lock(&simCpuMutex);
+    prvWaitToRun(thread);
+    pthread_setname_np(pthread_self(), pcTaskGetName(NULL));  // perf and gdb show the task names
+    uxCriticalNesting = 0;
+    vPortEnableInterrupts();
+    thread->code(thread->parameters);
+
+    // A task function that returns faults on the target
+    SimLog("sim: task %s returned\n", pcTaskGetName(NULL));
+    abort();
+}
+
+/// Handler of both interrupt signals: counts the ticks due, runs the pending peripheral interrupts, then switches
+/// to a task they woke
+static void prvInterrupt(int signal)
+{
+    int savedErrno = errno;
+    BaseType_t switchRequired = pdFALSE;
+    uint32_t pending;
+
+    uxCriticalNesting++;  // The handler runs with both signals blocked
+    simInIsr = true;
+    if (signal == SIM_SIG_TICK) {
+        uint64_t due = (SimNowNs() - simTickBaseNs) / SIM_TICK_NS;
+        if (due > simTicks + SIM_TICK_CATCH_UP) {
+            simTickBaseNs += (due - simTicks - SIM_TICK_CATCH_UP) * SIM_TICK_NS;
+            due = simTicks + SIM_TICK_CATCH_UP;
+        }
+        while (simTicks < due) {
+            simTicks++;
+            if (xTaskIncrementTick() != pdFALSE) {
+                switchRequired = pdTRUE;
+            }
+        }
+    }
+    pending = __atomic_exchange_n(&simIrqPending, 0, __ATOMIC_SEQ_CST);
+    for (int irq = 0; irq < SIM_IRQ_COUNT; irq++) {
+        if ((pending & (1u << irq)) && simIsr[irq] != NULL) {
+            simIsr[irq]();
+        }
+    }
+    if (switchRequired || simYieldPending) {
+        simYieldPending = false;
+        prvSwitchContext();
+    }
+    simInIsr = false;
+    uxCriticalNesting--;
+    errno = savedErrno;
+}
+
+/// Runs in the thread that started the scheduler until the simulation ends: on SIGINT or SIGTERM, which every
+/// thread leaves to this one, or after the run time
+static void prvWaitForEnd(void)
+{
+    sigset_t end;
+    struct timespec timeout = {(time_t)simRunSeconds, 0};
+    struct itimerval stop = {{0, 0}, {0, 0}};
+
+    sigemptyset(&end);
+    sigaddset(&end, SIGINT);
+    sigaddset(&end, SIGTERM);
+    while (sigtimedwait(&end, NULL, (simRunSeconds > 0) ? &timeout : NULL) < 0 && errno == EINTR) {
+    }
+    setitimer(ITIMER_REAL, &stop, NULL);
+}
+
+/******************************************************************************
+ * Port
+ ******************************************************************************/
+
+StackType_t *pxPortInitialiseStack(StackType_t *pxTopOfStack, TaskFunction_t pxCode, void *pvParameters)
+{
+    SimThread *thread = (SimThread *)(((uintptr_t)pxTopOfStack - sizeof(SimThread)) & ~(uintptr_t)portBYTE_ALIGNMENT_MASK);
+    pthread_attr_t attr;
+    sigset_t mask;
+
+    pthread_once(&simOnce, prvInit);
+    memset(thread, 0, sizeof(*thread));
+    thread->code = pxCode;
+    thread->parameters = pvParameters;
+    pthread_cond_init(&thread->wake, NULL);
+
+    // The thread starts with interrupts disabled, and enables them when its task first runs
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    pthread_sigmask(SIG_BLOCK, &simInterrupts, &mask);
+    if (pthread_create(&thread->thread, &attr, prvTaskThread, thread) != 0) {
+        SimLog("sim: cannot create a task thread\n");
+        abort();
+    }
+    pthread_sigmask(SIG_SETMASK, &mask, NULL);
+    pthread_attr_destroy(&attr);
+
+    return (StackType_t *)thread - 1;
+}
+
+BaseType_t xPortStartScheduler(void)
+{
+    struct sigaction action;
+    struct itimerval tick = {{0, 1000000 / configTICK_RATE_HZ}, {0, 1000000 / configTICK_RATE_HZ}};
+    SimThread *first = prvThreadOf(xTaskGetCurrentTaskHandle());
+
+    pthread_once(&simOnce, prvInit);
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = prvInterrupt;
+    action.sa_mask = simInterrupts;
+    action.sa_flags = SA_RESTART;
+    sigaction(SIM_SIG_TICK, &action, NULL);
+    sigaction(SIM_SIG_IRQ, &action, NULL);
+    simTickBaseNs = SimNowNs();
+    setitimer(ITIMER_REAL, &tick, NULL);
+
+    pthread_mutex_lock(&simCpuMutex);
+    first->running = true;
+    pthread_cond_signal(&first->wake);
+    pthread_mutex_unlock(&simCpuMutex);
+
+    prvWaitForEnd();
+    return pdFALSE;
+}
+
+void vPortEndScheduler(void)
+{
+    kill(getpid(), SIGTERM);
+}
+
+void vPortYield(void)
+{
+    vPortEnterCritical();
+    prvSwitchContext();
+    vPortExitCritical();
+}
+
+void vPortYieldFromISR(BaseType_t xSwitchRequired)
+{
+    if (xSwitchRequired == pdFALSE) {
+        return;
+    }
+    if (simInIsr) {
+        simYieldPending = true;  // Switched when the handler is done, like PendSV
+    } else {
+        vPortYield();
+    }
+}
+
+void vPortDisableInterrupts(void)
+{
+    pthread_sigmask(SIG_BLOCK, &simInterrupts, NULL);
+}
+
+void vPortEnableInterrupts(void)
+{
+    pthread_sigmask(SIG_UNBLOCK, &simInterrupts, NULL);
+}
+
+void vPortEnterCritical(void)
+{
+    vPortDisableInterrupts();
+    uxCriticalNesting++;
+}
+
+void vPortExitCritical(void)
+{
+    if (--uxCriticalNesting == 0) {
+        vPortEnableInterrupts();
+    }
+}
+
+UBaseType_t uxPortSetInterruptMask(void)
+{
+    sigset_t previous;
+    pthread_sigmask(SIG_BLOCK, &simInterrupts, &previous);
+    return (UBaseType_t)sigismember(&previous, SIM_SIG_TICK);
+}
+
+void vPortClearInterruptMask(UBaseType_t uxMask)
+{
+    if (uxMask == 0) {
+        vPortEnableInterrupts();
+    }
+}
+
+void vPortTaskDeleted(void *pvTaskToDelete)
+{
+    SimThread *thread = prvThreadOf(pvTaskToDelete);
+
+    pthread_mutex_lock(&simCpuMutex);
+    thread->dying = true;
+    pthread_cond_signal(&thread->wake);
+    pthread_mutex_unlock(&simCpuMutex);
+}
+
+void vPortSuppressTicksAndSleep(TickType_t xExpectedIdleTime)
+{
+    sigset_t mask;
+
+    (void)xExpectedIdleTime;
+    pthread_sigmask(SIG_BLOCK, &simInterrupts, &mask);
+    if (eTaskConfirmSleepModeStatus() != eAbortSleep) {
+        sigsuspend(&mask);  // Returns once an interrupt ran
+    }
+    pthread_sigmask(SIG_SETMASK, &mask, NULL);
+}
+
+/******************************************************************************
+ * Sim.h
+ ******************************************************************************/
+
+/// Sets the handler of an interrupt line. Call before the scheduler starts.
+void SimIrqRegister(enum SimIrq irq, SimIsr isr)
+{
+    simIsr[irq] = isr;
+}
+
+/// Requests an interrupt, from any thread. Its handler runs once however often it was requested meanwhile.
+void SimIrqPend(enum SimIrq irq)
+{
+    __atomic_fetch_or(&simIrqPending, 1u << irq, __ATOMIC_SEQ_CST);
+    kill(getpid(), SIM_SIG_IRQ);
+}
+
+/// True in an interrupt handler
+bool SimInIsr(void)
+{
+    return simInIsr;
+}
+
+/// Host clock since the start of the simulator, in ns
+uint64_t SimNowNs(void)
+{
+    pthread_once(&simOnce, prvInit);
+    return prvHostNs() - simStartNs;
+}
+
+/// SimNowNs of the moment the tick last counted was due. SysTick counts down from there.
+uint64_t SimTickNs(void)
+{
+    return simTickBaseNs + __atomic_load_n(&simTicks, __ATOMIC_RELAXED) * SIM_TICK_NS;
+}
+
+/// Takes the lock of the state the peripheral models share with their host threads, with interrupts disabled.
+/// Not recursive. Taken in turn, so a task that polls a peripheral in a loop cannot keep its model off the lock.
+void SimLock(void)
+{
+    sigset_t mask;
+    uint32_t ticket;
+
+    pthread_once(&simOnce, prvInit);
+    pthread_sigmask(SIG_BLOCK, &simInterrupts, &mask);
+    pthread_mutex_lock(&simModelMutex);
+    ticket = simModelTicket++;
+    while (ticket != simModelServing) {
+        pthread_cond_wait(&simModelTurn, &simModelMutex);
+    }
+    pthread_mutex_unlock(&simModelMutex);
+    simLockMask = mask;
+}
+
+void SimUnlock(void)
+{
+    sigset_t mask = simLockMask;
+
+    pthread_mutex_lock(&simModelMutex);
+    simModelServing++;
+    pthread_cond_broadcast(&simModelTurn);
+    pthread_mutex_unlock(&simModelMutex);
+    pthread_sigmask(SIG_SETMASK, &mask, NULL);
+}
+
+/// Starts a detached host thread of a peripheral model, with the interrupts blocked for good. Returns 0 on success.
+int SimThreadStart(void *(*run)(void *), void *arg)
+{
+    pthread_t thread;
+    pthread_attr_t attr;
+    sigset_t mask;
+    int result;
+
+    pthread_once(&simOnce, prvInit);
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    pthread_sigmask(SIG_BLOCK, &simInterrupts, &mask);
+    result = pthread_create(&thread, &attr, run, arg);
+    pthread_sigmask(SIG_SETMASK, &mask, NULL);
+    pthread_attr_destroy(&attr);
+    return result;
+}
+
+/// Writes a message of the simulator to stderr, with one system call so it is safe in tasks and handlers
+void SimLog(const char *format, ...)
+{
+    char text[256];
+    va_list args;
+    int len;
+
+    va_start(args, format);
+    len = vsnprintf(text, sizeof(text), format, args);
+    va_end(args);
+    if (len > 0) {
+        ssize_t written = write(STDERR_FILENO, text, ((size_t)len < sizeof(text)) ? (size_t)len : sizeof(text) - 1);
+        (void)written;
+    }
+}
+
+/// Ends the simulation after seconds, 0 to run until SIGINT or SIGTERM. Call before the scheduler starts.
+void SimSetRunTime(uint32_t seconds)
+{
+    simRunSeconds = seconds;
+}
@@ -0,0 +1,83 @@
+/**************************************************************************/ /**
+ * @file      portmacro.h
+ * @brief     FreeRTOS port of the firmware simulator: each task is a POSIX thread and only the thread of the current
+ *            task runs. Interrupts are signals that only the running thread leaves unblocked, so disabling them is
+ *            blocking the signals, and an interrupt that wakes a task switches to it from the signal handler like
+ *            PendSV does on the target. See port.c.
+ * @date      2026-10-19
+
+ ******************************************************************************/
+
+#ifndef PORTMACRO_H
+#define PORTMACRO_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+#define portCHAR char
+#define portFLOAT float
+#define portDOUBLE double
+#define portLONG long
+#define portSHORT short
+#define portSTACK_TYPE unsigned long
+#define portBASE_TYPE long
+#define portPOINTER_SIZE_TYPE uintptr_t
+
+typedef portSTACK_TYPE StackType_t;
+typedef long BaseType_t;
+typedef unsigned long UBaseType_t;
+
+#if (configUSE_16_BIT_TICKS == 1)
+#error The simulator keeps the 32 bit tick of the target
+#endif
+typedef uint32_t TickType_t;
+#define portMAX_DELAY (TickType_t)0xffffffffUL
+#define portTICK_TYPE_IS_ATOMIC 1
+
+#define portSTACK_GROWTH (-1)
+#define portTICK_PERIOD_MS ((TickType_t)1000 / configTICK_RATE_HZ)
+#define portBYTE_ALIGNMENT 8
+
+/* Scheduler */
+void vPortYield(void);
+void vPortYieldFromISR(BaseType_t xSwitchRequired);
+#define portYIELD() vPortYield()
+#define portEND_SWITCHING_ISR(xSwitchRequired) vPortYieldFromISR(xSwitchRequired)
+#define portYIELD_FROM_ISR(x) portEND_SWITCHING_ISR(x)
+
+/* Critical sections */
+void vPortDisableInterrupts(void);
+void vPortEnableInterrupts(void);
+void vPortEnterCritical(void);
+void vPortExitCritical(void);
+UBaseType_t uxPortSetInterruptMask(void);
+void vPortClearInterruptMask(UBaseType_t uxMask);
+#define portDISABLE_INTERRUPTS() vPortDisableInterrupts()
+#define portENABLE_INTERRUPTS() vPortEnableInterrupts()
+#define portENTER_CRITICAL() vPortEnterCritical()
+#define portEXIT_CRITICAL() vPortExitCritical()
+#define portSET_INTERRUPT_MASK_FROM_ISR() uxPortSetInterruptMask()
+#define portCLEAR_INTERRUPT_MASK_FROM_ISR(x) vPortClearInterruptMask(x)
+
+/* The thread of a deleted task ends once it no longer runs */
+void vPortTaskDeleted(void *pvTaskToDelete);
+#define portPRE_TASK_DELETE_HOOK(pvTaskToDelete, pxYieldPending) vPortTaskDeleted(pvTaskToDelete)
+#define portCLEAN_UP_TCB(pxTCB) vPortTaskDeleted(pxTCB)
+
+/* The idle task sleeps until the next interrupt instead of spinning, like WFI */
+void vPortSuppressTicksAndSleep(TickType_t xExpectedIdleTime);
+#define portSUPPRESS_TICKS_AND_SLEEP(xExpectedIdleTime) vPortSuppressTicksAndSleep(xExpectedIdleTime)
+
+#define portTASK_FUNCTION_PROTO(vFunction, pvParameters) void vFunction(void *pvParameters)
+#define portTASK_FUNCTION(vFunction, pvParameters) void vFunction(void *pvParameters)
+
+#define portNOP()
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PORTMACRO_H */
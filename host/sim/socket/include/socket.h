@@ -0,0 +1,29 @@
+/**************************************************************************/ /**
+ * @file      socket.h
+ * @brief     WINC1500 socket API in the firmware simulator. The names of the WINC calls are those of the BSD socket
+ *            API of the host, so they are renamed here, in front of the WINC header, for the firmware and for the
+ *            WINC model (SimWinc.c) alike, which leaves the host names to the network model (SimNet.c).
+ * @date      2026-10-19
+
+ ******************************************************************************/
+
+#ifndef SIM_WINC_SOCKET_H
+#define SIM_WINC_SOCKET_H
+
+#define socket WincSocket
+#define bind WincBind
+#define listen WincListen
+#define accept WincAccept
+#define connect WincConnect
+#define recv WincRecv
+#define recvfrom WincRecvfrom
+#define send WincSend
+#define sendto WincSendto
+#define close WincClose
+#define setsockopt WincSetsockopt
+#define getsockopt WincGetsockopt
+#define gethostbyname WincGethostbyname
+
+#include_next "socket/include/socket.h"
+
+#endif /* SIM_WINC_SOCKET_H */
@@ -0,0 +1,10 @@
+/**************************************************************************/ /**
+ * @file      stdio_serial.h
+ * @brief     The simulator declares the standard I/O serial service with the rest of its ASF, see asf.h.
+ * @date      2026-10-19
+
+ ******************************************************************************/
+
+#pragma once
+
+#include "asf.h"
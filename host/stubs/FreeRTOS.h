@@ -0,0 +1,28 @@
+/**************************************************************************/ /**
+ * @file      FreeRTOS.h
+ * @brief     Host stand-in for the FreeRTOS kernel header. Most host tests run single threaded, so critical
+ *            sections are no-ops unless HOST_THREADS is defined (see task.h), and the tick count is whatever the
+ *            test sets.
+ * @date      2026-10-19
+
+ ******************************************************************************/
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef uint32_t TickType_t;
+typedef long BaseType_t;
+typedef unsigned long UBaseType_t;
+
+#define pdFALSE ((BaseType_t)0)
+#define pdTRUE ((BaseType_t)1)
+#define pdPASS pdTRUE
+#define pdFAIL pdFALSE
+#define portMAX_DELAY ((TickType_t)0xffffffffUL)
+#define configTICK_RATE_HZ ((TickType_t)1000)
+#define configCPU_CLOCK_HZ (48000000UL)
+#define portTICK_PERIOD_MS ((TickType_t)1000 / configTICK_RATE_HZ)
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
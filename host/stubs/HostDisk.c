@@ -0,0 +1,159 @@
+/**************************************************************************/ /**
+ * @file      HostDisk.c
+ * @brief     FatFs disk for the host built modules: an image file stands in for the SD card, so the firmware code
+ *            runs on a real FAT volume. Sector reads and writes are counted for the benchmarks, and an optional
+ *            latency model adds up the time a card would take for them.
+ * @date      2026-10-19
+
+ ******************************************************************************/
+
+#include "HostDisk.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "diskio.h"
+
+#define HOST_DISK_SECTOR 512
+
+uint32_t hostFatTime = ((uint32_t)(2026 - 1980) << 25) | (10u << 21) | (19u << 16);
+
+static FILE *hostDiskImage = NULL;
+static uint32_t hostDiskSectors = 0;
+static struct HostDiskStats hostDiskStats;
+static struct HostDiskLatency hostDiskLatency;
+static DWORD hostDiskNextWrite;  ///< Sector after the last one written
+
+/// Formats a new volume on drive 0 and mounts it. image is the image file to create, or NULL for an anonymous
+/// temporary file. clusterSectors is the allocation unit in sectors, 0 to let f_mkfs choose.
+FRESULT HostDiskOpen(FATFS *fs, const char *image, uint32_t sectors, uint8_t clusterSectors)
+{
+    FRESULT res;
+
+    hostDiskImage = (image != NULL) ? fopen(image, "w+b") : tmpfile();
+    if (hostDiskImage == NULL || ftruncate(fileno(hostDiskImage), (off_t)sectors * HOST_DISK_SECTOR) != 0) {
+        return FR_DISK_ERR;
+    }
+    hostDiskSectors = sectors;
+    res = f_mount(0, fs);
+    if (res == FR_OK) res = f_mkfs(0, 1, (UINT)clusterSectors * HOST_DISK_SECTOR);
+    if (res == FR_OK) res = f_mount(0, fs);
+    memset(&hostDiskStats, 0, sizeof(hostDiskStats));
+    memset(&hostDiskLatency, 0, sizeof(hostDiskLatency));
+    return res;
+}
+
+/// Makes an existing image file drive 0, without mounting it: the code under test mounts the volume itself like the
+/// firmware does. The sector count follows from the file size.
+FRESULT HostDiskAttach(const char *image)
+{
+    struct stat st;
+
+    hostDiskImage = fopen(image, "r+be");
+    if (hostDiskImage == NULL) {
+        return FR_NO_FILE;
+    }
+    if (fstat(fileno(hostDiskImage), &st) != 0 || st.st_size < HOST_DISK_SECTOR) {
+        fclose(hostDiskImage);
+        hostDiskImage = NULL;
+        return FR_NO_FILESYSTEM;
+    }
+    hostDiskSectors = (uint32_t)(st.st_size / HOST_DISK_SECTOR);
+    memset(&hostDiskStats, 0, sizeof(hostDiskStats));
+    memset(&hostDiskLatency, 0, sizeof(hostDiskLatency));
+    return FR_OK;
+}
+
+void HostDiskClose(FATFS *fs)
+{
+    f_mount(0, NULL);
+    if (hostDiskImage != NULL) {
+        fclose(hostDiskImage);
+        hostDiskImage = NULL;
+    }
+}
+
+void HostDiskGetStats(struct HostDiskStats *stats)
+{
+    stats->reads = __atomic_load_n(&hostDiskStats.reads, __ATOMIC_RELAXED);
+    stats->writes = __atomic_load_n(&hostDiskStats.writes, __ATOMIC_RELAXED);
+    stats->busyUs = __atomic_load_n(&hostDiskStats.busyUs, __ATOMIC_RELAXED);
+}
+
+void HostDiskSetLatency(const struct HostDiskLatency *latency)
+{
+    hostDiskLatency = *latency;
+}
+
+DSTATUS disk_initialize(BYTE drv)
+{
+    return (drv == 0 && hostDiskImage != NULL) ? 0 : STA_NOINIT;
+}
+
+DSTATUS disk_status(BYTE drv)
+{
+    return disk_initialize(drv);
+}
+
+DRESULT disk_read(BYTE drv, BYTE *buff, DWORD sector, BYTE count)
+{
+    if (drv != 0 || sector + count > hostDiskSectors) {
+        return RES_PARERR;
+    }
+    if (pread(fileno(hostDiskImage), buff, (size_t)count * HOST_DISK_SECTOR, (off_t)sector * HOST_DISK_SECTOR) !=
+        (ssize_t)count * HOST_DISK_SECTOR) {
+        return RES_ERROR;
+    }
+    __atomic_add_fetch(&hostDiskStats.reads, count, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&hostDiskStats.busyUs, hostDiskLatency.commandUs + (uint64_t)hostDiskLatency.sectorUs * count,
+                       __ATOMIC_RELAXED);
+    return RES_OK;
+}
+
+DRESULT disk_write(BYTE drv, const BYTE *buff, DWORD sector, BYTE count)
+{
+    if (drv != 0 || sector + count > hostDiskSectors) {
+        return RES_PARERR;
+    }
+    if (pwrite(fileno(hostDiskImage), buff, (size_t)count * HOST_DISK_SECTOR, (off_t)sector * HOST_DISK_SECTOR) !=
+        (ssize_t)count * HOST_DISK_SECTOR) {
+        return RES_ERROR;
+    }
+    uint64_t written = __atomic_add_fetch(&hostDiskStats.writes, count, __ATOMIC_RELAXED);
+    uint64_t us = hostDiskLatency.commandUs + (uint64_t)hostDiskLatency.sectorUs * count;
+    if (sector != hostDiskNextWrite) {
+        us += hostDiskLatency.jumpUs;
+    }
+    if (hostDiskLatency.stallEvery != 0 && written / hostDiskLatency.stallEvery != (written - count) / hostDiskLatency.stallEvery) {
+        us += hostDiskLatency.stallUs;
+    }
+    hostDiskNextWrite = sector + count;
+    __atomic_add_fetch(&hostDiskStats.busyUs, us, __ATOMIC_RELAXED);
+    return RES_OK;
+}
+
+DRESULT disk_ioctl(BYTE drv, BYTE ctrl, void *buff)
+{
+    switch (ctrl) {
+        case CTRL_SYNC:
+            return RES_OK;
+        case GET_SECTOR_COUNT:
+            *(DWORD *)buff = hostDiskSectors;
+            return RES_OK;
+        case GET_SECTOR_SIZE:
+            *(WORD *)buff = HOST_DISK_SECTOR;
+            return RES_OK;
+        case GET_BLOCK_SIZE:
+            *(DWORD *)buff = 1;
+            return RES_OK;
+        default:
+            return RES_PARERR;
+    }
+}
+
+DWORD get_fattime(void)
+{
+    return hostFatTime;
+}
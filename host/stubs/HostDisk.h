@@ -0,0 +1,38 @@
+/**************************************************************************/ /**
+ * @file      HostDisk.h
+ * @brief     FatFs disk for the host built modules: an image file stands in for the SD card, so the firmware code
+ *            runs on a real FAT volume. Sector reads and writes are counted for the benchmarks.
+ * @date      2026-10-19
+
+ ******************************************************************************/
+
+#pragma once
+
+#include <stdint.h>
+
+#include "ff.h"
+
+/// Sectors moved since HostDiskOpen
+struct HostDiskStats {
+    uint64_t reads;
+    uint64_t writes;
+    uint64_t busyUs;  ///< Time the card would have spent on them under the latency model
+};
+
+/// Card timing charged to busyUs, nothing actually waits. All zero after HostDiskOpen.
+struct HostDiskLatency {
+    uint32_t commandUs;   ///< Each read or write command
+    uint32_t sectorUs;    ///< Each sector moved
+    uint32_t jumpUs;      ///< A write that does not follow the previous one, as FAT and directory updates do
+    uint32_t stallUs;     ///< Internal housekeeping of the card...
+    uint32_t stallEvery;  ///< ...once per this many sectors written, 0 for never
+};
+
+/// FAT timestamp get_fattime returns. Tests move it by hand.
+extern uint32_t hostFatTime;
+
+FRESULT HostDiskOpen(FATFS *fs, const char *image, uint32_t sectors, uint8_t clusterSectors);
+FRESULT HostDiskAttach(const char *image);
+void HostDiskClose(FATFS *fs);
+void HostDiskGetStats(struct HostDiskStats *stats);
+void HostDiskSetLatency(const struct HostDiskLatency *latency);
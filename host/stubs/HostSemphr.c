@@ -0,0 +1,133 @@
+/**************************************************************************/ /**
+ * @file      HostSemphr.c
+ * @brief     FreeRTOS mutexes on POSIX threads for the host built modules, and the HOST_THREADS critical sections
+ *            and task notifications. A tick is a millisecond, as on the target.
+ * @date      2026-10-19
+
+ ******************************************************************************/
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "semphr.h"
+#include "task.h"
+
+struct HostMutex {
+    pthread_mutex_t mutex;
+};
+
+/// Notification value of a thread, created when it first asks for its handle
+struct HostTask {
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    uint32_t value;
+};
+
+static pthread_once_t hostCriticalOnce = PTHREAD_ONCE_INIT;
+static __thread struct HostTask *hostCurrentTask;
+static pthread_mutex_t hostCritical;
+
+static void HostCriticalInit(void)
+{
+    pthread_mutexattr_t attr;
+
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&hostCritical, &attr);
+    pthread_mutexattr_destroy(&attr);
+}
+
+/// Critical sections nest, as taskENTER_CRITICAL does on the target
+void HostCriticalEnter(void)
+{
+    pthread_once(&hostCriticalOnce, HostCriticalInit);
+    pthread_mutex_lock(&hostCritical);
+}
+
+void HostCriticalExit(void)
+{
+    pthread_mutex_unlock(&hostCritical);
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+    if (hostCurrentTask == NULL) {
+        hostCurrentTask = calloc(1, sizeof(struct HostTask));
+        pthread_mutex_init(&hostCurrentTask->mutex, NULL);
+        pthread_cond_init(&hostCurrentTask->cond, NULL);
+    }
+    return hostCurrentTask;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t ticks)
+{
+    struct HostTask *task = xTaskGetCurrentTaskHandle();
+    struct timespec until;
+    uint32_t value;
+
+    clock_gettime(CLOCK_REALTIME, &until);
+    until.tv_sec += (ticks == portMAX_DELAY) ? 1000000 : ticks / 1000;
+    until.tv_nsec += (ticks == portMAX_DELAY) ? 0 : (long)(ticks % 1000) * 1000000L;
+    if (until.tv_nsec >= 1000000000L) {
+        until.tv_sec++;
+        until.tv_nsec -= 1000000000L;
+    }
+    pthread_mutex_lock(&task->mutex);
+    while (task->value == 0 && pthread_cond_timedwait(&task->cond, &task->mutex, &until) == 0) {
+    }
+    value = task->value;
+    task->value = (clearOnExit || value == 0) ? 0 : value - 1;
+    pthread_mutex_unlock(&task->mutex);
+    return value;
+}
+
+void xTaskNotifyGive(TaskHandle_t task)
+{
+    pthread_mutex_lock(&task->mutex);
+    task->value++;
+    pthread_cond_signal(&task->cond);
+    pthread_mutex_unlock(&task->mutex);
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    usleep((useconds_t)ticks * 1000);
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void)
+{
+    struct HostMutex *sem = malloc(sizeof(struct HostMutex));
+
+    if (sem != NULL) {
+        pthread_mutex_init(&sem->mutex, NULL);
+    }
+    return sem;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks)
+{
+    struct timespec until;
+
+    if (ticks == portMAX_DELAY) {
+        return (pthread_mutex_lock(&sem->mutex) == 0) ? pdTRUE : pdFALSE;
+    }
+    if (ticks == 0) {
+        return (pthread_mutex_trylock(&sem->mutex) == 0) ? pdTRUE : pdFALSE;
+    }
+    clock_gettime(CLOCK_REALTIME, &until);
+    until.tv_sec += ticks / 1000;
+    until.tv_nsec += (long)(ticks % 1000) * 1000000L;
+    if (until.tv_nsec >= 1000000000L) {
+        until.tv_sec++;
+        until.tv_nsec -= 1000000000L;
+    }
+    return (pthread_mutex_timedlock(&sem->mutex, &until) == 0) ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem)
+{
+    return (pthread_mutex_unlock(&sem->mutex) == 0) ? pdTRUE : pdFALSE;
+}
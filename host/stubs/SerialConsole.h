@@ -0,0 +1,31 @@
+/**************************************************************************/ /**
+ * @file      SerialConsole.h
+ * @brief     Host stand-in for the console log and the stream record types. Messages are dropped; tests check
+ *            results, not log lines.
+ * @date      2026-10-19
+
+ ******************************************************************************/
+
+#pragma once
+
+enum eDebugLogLevels {
+    LOG_INFO_LVL = 0,
+    LOG_DEBUG_LVL = 1,
+    LOG_WARNING_LVL = 2,
+    LOG_ERROR_LVL = 3,
+    LOG_FATAL_LVL = 4,
+    LOG_OFF_LVL = 5,
+};
+
+#define LogMessage(level, ...) ((void)(level))
+
+/// Record types of the UART stream, as in the firmware header
+enum eSerialStreamType {
+    SERIAL_STREAM_LOG = 0,
+    SERIAL_STREAM_CAPTURE = 1,
+    SERIAL_STREAM_EVENT = 2,
+    SERIAL_STREAM_TRANSFER = 3,
+    SERIAL_STREAM_CAPTURE_PACKED = 4,
+    SERIAL_STREAM_EVENT_TEMPLATE = 5,
+    SERIAL_STREAM_EVENT_REPEAT = 6
+};
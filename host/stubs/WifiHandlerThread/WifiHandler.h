@@ -0,0 +1,13 @@
+/**************************************************************************/ /**
+ * @file      WifiHandler.h
+ * @brief     Host stand-in for the Wifi task header. Only the SD card mount the storage modules call, and the IMU
+ *            batch it brings in; host tests mount their image themselves and provide an empty init_storage.
+ * @date      2026-10-19
+
+ ******************************************************************************/
+
+#pragma once
+
+#include "IMU/ImuBatch.h"
+
+void init_storage(void);
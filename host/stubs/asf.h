@@ -0,0 +1,48 @@
+/**************************************************************************/ /**
+ * @file      asf.h
+ * @brief     Host stand-in for the ASF umbrella header. Only what the host built modules use.
+ * @date      2026-10-19
+
+ ******************************************************************************/
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#define Assert(expr) ((void)0)
+
+/// The SD card is drive 0 of the host disk, see HostDisk.h
+#define LUN_ID_SD_MMC_0_MEM 0
+
+/// ASF status codes used by the host built modules
+enum status_code {
+    STATUS_OK = 0x00,
+    STATUS_BUSY = 0x05,
+    STATUS_ERR_IO = 0x10,
+    STATUS_ERR_INVALID_ARG = 0x17,
+    STATUS_ERR_BAD_DATA = 0x1a,
+};
+
+/// NVM driver. Host tests that use it provide a fake flash.
+#define NVMCTRL_PAGE_SIZE 64
+#define NVMCTRL_ROW_SIZE (4 * NVMCTRL_PAGE_SIZE)
+
+struct nvm_config {
+    bool manual_page_write;
+};
+
+void nvm_get_config_defaults(struct nvm_config *const config);
+enum status_code nvm_set_config(const struct nvm_config *const config);
+enum status_code nvm_erase_row(const uint32_t row_address);
+enum status_code nvm_write_buffer(const uint32_t destination_address, const uint8_t *buffer, uint16_t length);
+
+/// SysTick down counter. Host tests that read it provide hostSysTick.
+typedef struct {
+    volatile uint32_t LOAD;
+    volatile uint32_t VAL;
+} SysTick_Type;
+extern SysTick_Type hostSysTick;
+#define SysTick (&hostSysTick)
@@ -0,0 +1,14 @@
+/**************************************************************************/ /**
+ * @file      compiler.h
+ * @brief     Host stand-in for the ASF compiler header: the standard types and, as on the target, the status codes.
+ * @date      2026-10-19
+
+ ******************************************************************************/
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "status_codes.h"
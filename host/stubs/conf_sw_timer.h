@@ -0,0 +1,11 @@
+/**************************************************************************/ /**
+ * @file      conf_sw_timer.h
+ * @brief     Host configuration of the software timer module. As many timers as a heap position can address,
+ *            for the unit tests and the benchmark.
+ * @date      2026-10-19
+
+ ******************************************************************************/
+
+#pragma once
+
+#define CONF_SW_TIMER_COUNT 250
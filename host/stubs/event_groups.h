@@ -0,0 +1,12 @@
+/**************************************************************************/ /**
+ * @file      event_groups.h
+ * @brief     Host stand-in for the FreeRTOS event group type. Host tests provide the SysInit functions they need.
+ * @date      2026-10-19
+
+ ******************************************************************************/
+
+#pragma once
+
+#include "FreeRTOS.h"
+
+typedef uint32_t EventBits_t;
@@ -0,0 +1,17 @@
+/**************************************************************************/ /**
+ * @file      semphr.h
+ * @brief     Host stand-in for the FreeRTOS semaphore API, on POSIX threads. Only the mutexes the host built
+ *            modules take, for example the FatFs volume lock.
+ * @date      2026-10-19
+
+ ******************************************************************************/
+
+#pragma once
+
+#include "FreeRTOS.h"
+
+typedef struct HostMutex *SemaphoreHandle_t;
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void);
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem);
@@ -0,0 +1,10 @@
+/**************************************************************************/ /**
+ * @file      status_codes.h
+ * @brief     Host stand-in for the ASF status codes, which the host asf.h already defines.
+ * @date      2026-10-19
+
+ ******************************************************************************/
+
+#pragma once
+
+#include "asf.h"
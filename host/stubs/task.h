@@ -0,0 +1,41 @@
+/**************************************************************************/ /**
+ * @file      task.h
+ * @brief     Host stand-in for the FreeRTOS task API used by the host built modules. With HOST_THREADS, tasks are
+ *            POSIX threads and their notifications are real.
+ * @date      2026-10-19
+
+ ******************************************************************************/
+
+#pragma once
+
+#include "FreeRTOS.h"
+
+#ifdef HOST_THREADS
+/// Tests that run modules from several threads: critical sections take one process wide recursive lock
+void HostCriticalEnter(void);
+void HostCriticalExit(void);
+
+typedef struct HostTask *TaskHandle_t;
+TaskHandle_t xTaskGetCurrentTaskHandle(void);
+uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t ticks);
+void xTaskNotifyGive(TaskHandle_t task);
+void vTaskDelay(TickType_t ticks);
+
+#define taskENTER_CRITICAL() HostCriticalEnter()
+#define taskEXIT_CRITICAL() HostCriticalExit()
+#define vTaskSuspendAll() HostCriticalEnter()
+static inline BaseType_t xTaskResumeAll(void)
+{
+    HostCriticalExit();
+    return pdFALSE;
+}
+#else
+#define taskENTER_CRITICAL() ((void)0)
+#define taskEXIT_CRITICAL() ((void)0)
+#define vTaskSuspendAll() ((void)0)
+static inline BaseType_t xTaskResumeAll(void) { return pdFALSE; }
+#endif
+
+/// Tick count the host built modules see. Tests move it by hand.
+extern TickType_t hostTickCount;
+#define xTaskGetTickCount() (hostTickCount)
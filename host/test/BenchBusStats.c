@@ -0,0 +1,47 @@
+/**************************************************************************/ /**
+ * @file      BenchBusStats.c
+ * @brief     Memory and CPU budget of the bus statistics: static RAM of the module, ns per recorded transaction and
+ *            per snapshot, and the snapshot length for a busy interval. The module source is included so that the
+ *            size of its window can be reported.
+ * @date      2026-10-19
+
+ ******************************************************************************/
+
+#include "BusStats/BusStats.c"
+#include "HostTest.h"
+
+#define BENCH_EVENTS 2000000
+#define BENCH_SNAPSHOTS 20000
+#define MQTT_PAYLOAD_SIZE 448  ///< MQTT_SPOOL_MAX_PAYLOAD
+#define RAM_BUDGET 512         ///< Static RAM the module may use
+
+TickType_t hostTickCount;
+SysTick_Type hostSysTick;
+
+int main(void)
+{
+    static char json[MQTT_PAYLOAD_SIZE];
+    uint32_t rng = 0x5EED5EEDu;
+    uint64_t start, recordNs, snapshotNs;
+    uint16_t len = 0;
+    size_t ram = sizeof(busStatsWindow) + sizeof(busStatsLastEndUs) + sizeof(busStatsHaveLast);
+
+    start = HostTestNowNs();
+    for (uint32_t n = 0; n < BENCH_EVENTS; n++) {
+        uint32_t r = HostTestRandom(&rng);
+        struct BusStatsEvent ev = {0x40 + (r & 0x0F), (r >> 8) & 0x7F, (r >> 20) == 0 ? -1 : 0, n * 50, (r >> 16) & 0x3FF};
+        BusStatsRecord(&ev);
+    }
+    recordNs = HostTestNowNs() - start;
+
+    start = HostTestNowNs();
+    for (uint32_t n = 0; n < BENCH_SNAPSHOTS; n++) {
+        len = BusStatsPeekJson(json, sizeof(json));
+    }
+    snapshotNs = HostTestNowNs() - start;
+
+    printf("static RAM            %6zu B (budget %d B, sketch %zu B)\n", ram, RAM_BUDGET, sizeof(busStatsWindow.sketch));
+    printf("record                %6.1f ns/transaction\n", (double)recordNs / BENCH_EVENTS);
+    printf("snapshot              %6.1f us, %u of %d B\n", (double)snapshotNs / BENCH_SNAPSHOTS / 1000.0, len, MQTT_PAYLOAD_SIZE);
+    return (ram <= RAM_BUDGET && len > 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
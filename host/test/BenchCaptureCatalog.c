@@ -0,0 +1,114 @@
+/**************************************************************************/ /**
+ * @file      BenchCaptureCatalog.c
+ * @brief     Host benchmark of the capture catalog with 10000 captures on a FAT image: card sectors read and us per
+ *            lookup by time, sorted and unsorted, and per append of a new and of an overwritten file. On the card each
+ *            sector read costs about a millisecond of SPI transfer.
+ * @date      2026-10-19
+
+ ******************************************************************************/
+
+#include <string.h>
+
+#include "CaptureCatalog/CaptureCatalog.h"
+#include "HostDisk.h"
+#include "HostTest.h"
+#include "task.h"
+
+#define BENCH_CAPTURES 10000
+#define BENCH_LOOKUPS 500
+#define BENCH_APPENDS 20
+#define T0 0x5B530000u
+
+TickType_t hostTickCount;
+
+static FATFS fs;
+
+/// Sectors read and written and ns per call, around a run of calls
+struct Cost {
+    struct HostDiskStats disk;
+    uint64_t t0;
+};
+
+static void CostStart(struct Cost *cost)
+{
+    HostDiskGetStats(&cost->disk);
+    cost->t0 = HostTestNowNs();
+}
+
+static void CostReport(const char *what, const struct Cost *cost, unsigned calls)
+{
+    struct HostDiskStats now;
+    double ns = (double)(HostTestNowNs() - cost->t0) / calls;
+
+    HostDiskGetStats(&now);
+    printf("%-34s %7.1f sectors read %5.1f written %8.1f us\n", what, (double)(now.reads - cost->disk.reads) / calls,
+           (double)(now.writes - cost->disk.writes) / calls, ns / 1000);
+}
+
+static void Add(uint32_t i, bool replaces)
+{
+    struct CaptureCatalogRecord rec;
+    char name[24];
+
+    memset(&rec, 0, sizeof(rec));
+    snprintf(name, sizeof(name), "0:cap%05lu.bin", (unsigned long)i);
+    rec.start = T0 + 4 * i;
+    rec.size = 1u << 20;
+    hostFatTime = T0 + 4 * i + 2;
+    CHECK_EQ(CaptureCatalogAdd(&rec, name, replaces), FR_OK);
+}
+
+static void Lookups(const char *what)
+{
+    struct CaptureCatalogRecord rec;
+    struct Cost cost;
+    uint32_t seed = 11;
+
+    CostStart(&cost);
+    for (int n = 0; n < BENCH_LOOKUPS; n++) {
+        uint32_t i = HostTestRandom(&seed) % BENCH_CAPTURES;
+        FRESULT res = CaptureCatalogFind(T0 + 4 * i + 1, &rec);
+        CHECK(res == FR_OK || res == FR_NO_FILE);
+        CHECK(res == FR_NO_FILE || rec.start <= T0 + 4 * i + 1);
+    }
+    CostReport(what, &cost, BENCH_LOOKUPS);
+}
+
+int main(void)
+{
+    struct Cost cost;
+
+    CHECK_EQ(HostDiskOpen(&fs, NULL, 16384, 8), FR_OK);
+    CHECK_EQ(CaptureCatalogOpen(), FR_OK);
+    for (uint32_t i = 0; i < BENCH_CAPTURES; i++) {
+        Add(i, false);
+    }
+    printf("%u captures, %lu KB of catalog\n", BENCH_CAPTURES,
+           (unsigned long)(CaptureCatalogCount() * sizeof(struct CaptureCatalogRecord) >> 10));
+
+    Lookups("find, sorted (bisection)");
+
+    CostStart(&cost);
+    for (uint32_t i = BENCH_CAPTURES; i < BENCH_CAPTURES + BENCH_APPENDS; i++) {
+        Add(i, false);
+    }
+    CostReport("add, new file", &cost, BENCH_APPENDS);
+
+    // Overwriting the newest files finds them at once, the oldest ones read the whole catalog
+    CostStart(&cost);
+    for (uint32_t i = BENCH_CAPTURES + BENCH_APPENDS; i-- > BENCH_CAPTURES;) {
+        Add(i, true);
+    }
+    CostReport("add, overwrote a recent file", &cost, BENCH_APPENDS);
+    CostStart(&cost);
+    for (uint32_t i = 0; i < BENCH_APPENDS; i++) {
+        Add(i, true);
+    }
+    CostReport("add, overwrote the oldest files", &cost, BENCH_APPENDS);
+
+    Lookups("find, unsorted (scan)");
+
+    CaptureCatalogClose();
+    HostDiskClose(&fs);
+    return HOST_TEST_RESULT();
+}
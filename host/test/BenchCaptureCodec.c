@@ -0,0 +1,118 @@
+/**************************************************************************/ /**
+ * @file      BenchCaptureCodec.c
+ * @brief     Compression ratio and speed of the capture codec on accelerometer-like signals: a board at rest, walking,
+ *            vibration, impacts and full scale noise, three axes at 16 samples per block as the IMU task sends them.
+ *            Reports bytes as sent against raw (a block that does not pack is sent raw), the share of blocks sent
+ *            packed, the largest packed block, and ns per block to encode and to decode.
+ * @date      2026-10-19
+
+ ******************************************************************************/
+
+#include <math.h>
+#include <string.h>
+
+#include "CaptureCodec/CaptureCodec.h"
+#include "HostTest.h"
+
+#define BENCH_BLOCKS 20000
+#define BENCH_COUNT 16
+#define FRAME_SIZE (CAPTURE_CODEC_HEADER + BENCH_COUNT * 6)
+#define LSB_PER_G 16393  ///< LSM6DSO at 2 g full scale
+
+uint32_t BusStatsNowUs(void)
+{
+    return 0;
+}
+
+/// Uniform noise of about +-amp LSB
+static int32_t Noise(uint32_t *seed, int32_t amp)
+{
+    return amp ? (int32_t)(HostTestRandom(seed) % (uint32_t)(2 * amp + 1)) - amp : 0;
+}
+
+/// Sample of one axis at time t (s) for a signal kind
+static int16_t Signal(unsigned kind, unsigned axis, double t, uint32_t *seed)
+{
+    double g = (axis == 2) ? 1.0 : 0.0;
+    int32_t noise = 2;
+
+    switch (kind) {
+        case 0:  // At rest
+            break;
+        case 1:  // Walking: a 2 Hz sway of 0.3 g
+            g += 0.3 * sin(2 * M_PI * 2 * t + axis);
+            noise = 8;
+            break;
+        case 2:  // Motor vibration: 0.05 g at 50 Hz on top of the rest position
+            g += 0.05 * sin(2 * M_PI * 50 * t + axis);
+            noise = 4;
+            break;
+        case 3:  // Impacts: 1.5 g spikes twice a second
+            g += (fmod(t, 0.5) < 0.02) ? 1.5 * (axis + 1) / 3.0 : 0.0;
+            noise = 6;
+            break;
+        default:  // Full scale noise
+            return (int16_t)(HostTestRandom(seed) & 0xFFFF);
+    }
+    int32_t x = (int32_t)lround(g * LSB_PER_G) + Noise(seed, noise);
+    return (int16_t)(x > 32767 ? 32767 : x < -32768 ? -32768 : x);
+}
+
+int main(void)
+{
+    static const char *const kinds[] = {"at rest", "walking", "vibration 50 Hz", "impacts", "full scale noise"};
+    static uint8_t raw[BENCH_BLOCKS][FRAME_SIZE];
+    uint8_t packed[FRAME_SIZE], decoded[FRAME_SIZE];
+    static uint16_t packedLen[BENCH_BLOCKS];
+    uint32_t seed = 2026;
+    bool ok = true;
+
+    printf("%-18s %7s %8s %7s %10s %10s\n", "signal", "ratio", "packed", "largest", "encode", "decode");
+    for (unsigned kind = 0; kind < sizeof(kinds) / sizeof(kinds[0]); kind++) {
+        uint64_t rawBytes = 0, sentBytes = 0, t0, encodeNs, decodeNs;
+        unsigned packedBlocks = 0, largest = 0;
+
+        // 104 Hz, the rate the capture configuration uses by default
+        for (uint32_t b = 0; b < BENCH_BLOCKS; b++) {
+            uint16_t len = CAPTURE_CODEC_HEADER;
+            memset(raw[b], 0, CAPTURE_CODEC_HEADER);
+            raw[b][8] = 7;
+            raw[b][9] = BENCH_COUNT;
+            for (unsigned i = 0; i < BENCH_COUNT; i++) {
+                double t = (b * BENCH_COUNT + i) / 104.0;
+                for (unsigned axis = 0; axis < 3; axis++) {
+                    int16_t x = Signal(kind, axis, t, &seed);
+                    raw[b][len++] = (uint8_t)x;
+                    raw[b][len++] = (uint8_t)((uint16_t)x >> 8);
+                }
+            }
+        }
+
+        t0 = HostTestNowNs();
+        for (uint32_t b = 0; b < BENCH_BLOCKS; b++) {
+            packedLen[b] = CaptureCodecEncode(raw[b], FRAME_SIZE, packed, sizeof(packed));
+        }
+        encodeNs = HostTestNowNs() - t0;
+
+        decodeNs = 0;
+        for (uint32_t b = 0; b < BENCH_BLOCKS; b++) {
+            rawBytes += FRAME_SIZE;
+            sentBytes += packedLen[b] ? packedLen[b] : FRAME_SIZE;
+            if (packedLen[b] == 0) {
+                continue;
+            }
+            packedBlocks++;
+            largest = (packedLen[b] > largest) ? packedLen[b] : largest;
+            CaptureCodecEncode(raw[b], FRAME_SIZE, packed, sizeof(packed));  // Only the lengths were kept
+            t0 = HostTestNowNs();
+            int32_t got = CaptureCodecDecode(packed, packedLen[b], decoded, sizeof(decoded));
+            decodeNs += HostTestNowNs() - t0;
+            ok &= (got == FRAME_SIZE && memcmp(decoded, raw[b], FRAME_SIZE) == 0);
+        }
+        printf("%-18s %6.2fx %7.1f%% %5u B %7.0f ns %7.0f ns\n", kinds[kind], (double)rawBytes / sentBytes,
+               100.0 * packedBlocks / BENCH_BLOCKS, largest, (double)encodeNs / BENCH_BLOCKS,
+               packedBlocks ? (double)decodeNs / packedBlocks : 0.0);
+    }
+    printf("raw block %u B\n", FRAME_SIZE);
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
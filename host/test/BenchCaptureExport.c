@@ -0,0 +1,90 @@
+/**************************************************************************/ /**
+ * @file      BenchCaptureExport.c
+ * @brief     Thread scaling of capture_export: a synthetic capture of a board at rest with six polled registers, in
+ *            4 MB segments, exported to VCD and to a sigrok file at 1, 2, 4... threads up to the cores. Reports the
+ *            record MB decoded per second and the speedup over one thread, and checks that every thread count
+ *            writes as many bytes. The size in MB is the first argument, 32 by default; a directory to keep the
+ *            capture in the second. Up to 100 segments: multi-GB runs take --segment-mb of capture_export.
+ * @date      2026-10-19
+
+ ******************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "CaptureExport.h"
+#include "HostTest.h"
+#include "SegmentSynth.h"
+
+#define BENCH_MB 32
+#define BENCH_SEGMENT_BYTES (4u << 20)
+
+static const char *const formatNames[] = {"vcd", "sr"};
+
+int main(int argc, char **argv)
+{
+    char dir[64] = "/tmp/bench_export_XXXXXX";
+    uint64_t mb = (argc > 1) ? strtoull(argv[1], NULL, 0) : BENCH_MB;
+    struct SegmentSynthConfig config;
+    struct SegmentSynthStats synth;
+    struct CaptureExportOptions options;
+    struct CaptureExportStats stats;
+    unsigned cores = CaptureExportCores(), count;
+    char **paths;
+
+    if (argc > 2) {
+        snprintf(dir, sizeof(dir), "%s", argv[2]);
+        mkdir(dir, 0777);
+    } else if (mkdtemp(dir) == NULL) {
+        return EXIT_FAILURE;
+    }
+    config = (struct SegmentSynthConfig){dir, mb << 20, BENCH_SEGMENT_BYTES, CAPTURE_SYNTH_REST, 1,
+                                         0xFFFFFFFFu - 60000000u, 9615, 6, 0};
+    while (config.bytes / (config.segmentBytes - 512) >= 100) {
+        config.segmentBytes *= 2;
+    }
+    uint64_t start = HostTestNowNs();
+    CHECK_EQ(SegmentSynthWrite(&config, NULL, NULL, &synth), 0);
+    printf("capture: %llu MB in %u segments, %llu samples, %llu bus events, written in %.1f s\n",
+           (unsigned long long)mb, synth.segments, (unsigned long long)synth.samples, (unsigned long long)synth.events,
+           (HostTestNowNs() - start) / 1e9);
+    CHECK_EQ(CaptureExportListDir(dir, &paths, &count), 0);
+
+    for (int f = 0; f < 2; f++) {
+        double single = 0;
+        uint64_t outBytes = 0;
+        printf("%-4s %8s %10s %10s %8s\n", formatNames[f], "threads", "MB/s", "out MB", "speedup");
+        for (unsigned threads = 1;; threads *= 2) {
+            threads = (threads > cores) ? cores : threads;
+            options = (struct CaptureExportOptions){(const char *const *)paths, count, (enum CaptureExportFormat)f,
+                                                    fopen("/dev/null", "wb"), threads, 0};
+            setvbuf(options.out, NULL, _IOFBF, 1 << 20);
+            start = HostTestNowNs();
+            CHECK_EQ(CaptureExportRun(&options, &stats), 0);
+            double s = (HostTestNowNs() - start) / 1e9, rate = stats.bytes / 1048576.0 / s;
+            fclose(options.out);
+            single = (threads == 1) ? rate : single;
+            outBytes = (threads == 1) ? stats.outBytes : outBytes;
+            CHECK_EQ(stats.outBytes, outBytes);
+            CHECK_EQ(stats.samples, synth.samples);
+            printf("%-4s %8u %10.1f %10.1f %7.2fx\n", "", threads, rate, stats.outBytes / 1048576.0, rate / single);
+            if (threads == cores) {
+                break;
+            }
+        }
+    }
+
+    for (unsigned i = 0; i < count; i++) {
+        if (argc <= 2) {
+            remove(paths[i]);
+        }
+        free(paths[i]);
+    }
+    free(paths);
+    if (argc <= 2) {
+        rmdir(dir);
+    }
+    return HOST_TEST_RESULT();
+}
@@ -0,0 +1,80 @@
+/**************************************************************************/ /**
+ * @file      BenchCaptureFile.c
+ * @brief     Host benchmark of random seeks into capture files of 1 to 48 MB on a FAT image with 4 KB clusters,
+ *            through the FAT chain and through a cluster link map. Reports card sectors read and us per seek and
+ *            512 byte read; on the card each sector read costs about a millisecond of SPI transfer.
+ * @date      2026-10-19
+
+ ******************************************************************************/
+
+#include <string.h>
+
+#include "CaptureFile/CaptureFile.h"
+#include "HostDisk.h"
+#include "HostTest.h"
+#include "task.h"
+
+#define BENCH_SEEKS 500
+#define BENCH_CLUSTER_SECTORS 8
+
+TickType_t hostTickCount;
+
+static FATFS fs;
+static uint8_t buf[4096];
+
+static void WriteFile(const char *path, uint32_t size)
+{
+    FIL fp;
+    UINT written;
+
+    CHECK_EQ(f_open(&fp, path, FA_CREATE_ALWAYS | FA_WRITE), FR_OK);
+    for (uint32_t done = 0; done < size; done += sizeof(buf)) {
+        CHECK_EQ(f_write(&fp, buf, sizeof(buf), &written), FR_OK);
+    }
+    CHECK_EQ(f_close(&fp), FR_OK);
+}
+
+/// Sectors read and ns per seek and read, through CaptureFileSeek or plain f_lseek
+static void Measure(const char *path, uint32_t size, bool mapped, double *sectors, double *ns)
+{
+    struct HostDiskStats before, after;
+    uint32_t seed = 7;
+    uint8_t sector[512];
+    uint64_t t0;
+    UINT count;
+    FIL fp;
+
+    CHECK_EQ(CaptureFileOpen(&fp, path), FR_OK);
+    HostDiskGetStats(&before);
+    t0 = HostTestNowNs();
+    for (int n = 0; n < BENCH_SEEKS; n++) {
+        DWORD offset = (HostTestRandom(&seed) % (size / sizeof(sector))) * sizeof(sector);
+        CHECK_EQ(mapped ? CaptureFileSeek(&fp, offset) : f_lseek(&fp, offset), FR_OK);
+        CHECK_EQ(f_read(&fp, sector, sizeof(sector), &count), FR_OK);
+    }
+    *ns = (double)(HostTestNowNs() - t0) / BENCH_SEEKS;
+    HostDiskGetStats(&after);
+    *sectors = (double)(after.reads - before.reads) / BENCH_SEEKS;
+    CHECK(mapped == (fp.cltbl != NULL));
+    CHECK_EQ(CaptureFileClose(&fp), FR_OK);
+}
+
+int main(void)
+{
+    static const uint32_t sizesMb[] = {1, 4, 16, 48};
+
+    CHECK_EQ(HostDiskOpen(&fs, NULL, 128u * 2048u, BENCH_CLUSTER_SECTORS), FR_OK);
+    for (unsigned i = 0; i < sizeof(sizesMb) / sizeof(sizesMb[0]); i++) {
+        char path[16];
+        double chainSectors, chainNs, mapSectors, mapNs;
+
+        snprintf(path, sizeof(path), "0:f%u.bin", i);
+        WriteFile(path, sizesMb[i] << 20);
+        Measure(path, sizesMb[i] << 20, false, &chainSectors, &chainNs);
+        Measure(path, sizesMb[i] << 20, true, &mapSectors, &mapNs);
+        printf("%2u MB: FAT chain %6.1f sectors %7.1f us | map %4.1f sectors %5.1f us per seek and read\n", sizesMb[i],
+               chainSectors, chainNs / 1000, mapSectors, mapNs / 1000);
+    }
+    HostDiskClose(&fs);
+    return HOST_TEST_RESULT();
+}
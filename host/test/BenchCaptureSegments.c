@@ -0,0 +1,210 @@
+/**************************************************************************/ /**
+ * @file      BenchCaptureSegments.c
+ * @brief     Host benchmark of capture recording on a FAT image under an SD card latency model: the time the card
+ *            is busy per 512 byte sector when appending to a growing file, which allocates clusters and updates the
+ *            FAT, against the ring of preallocated segments run by its task. Reports mean, 99th percentile and worst
+ *            case per sector, and the capture rate the two sector buffers absorb at that worst case.
+ * @date      2026-10-19
+
+ ******************************************************************************/
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "BusStats/BusStats.h"
+#include "CaptureCatalog/CaptureCatalog.h"
+#include "CaptureSegments/CaptureSegments.h"
+#include "HostDisk.h"
+#include "HostTest.h"
+#include "SerialConsole.h"
+#include "SysInit/SysInit.h"
+#include "WifiHandlerThread/WifiHandler.h"
+#include "task.h"
+
+#define BENCH_SEGMENTS 8
+#define BENCH_SEGMENT_MB 1
+#define BENCH_SECTORS (12u * 2048u)  ///< 12 MB, so the 8 MB ring wraps
+#define BENCH_RECORD 250             ///< Two records per sector
+
+TickType_t hostTickCount;
+
+static FATFS fs;
+static volatile bool storageReady;
+static uint32_t latencyUs[BENCH_SECTORS];
+
+/// Latency models: a command costs 300 us plus 100 us per sector, a write away from the previous one 2 ms more,
+/// and with housekeeping the card stalls for 30 ms once per MB written
+static const struct HostDiskLatency cardModels[] = {
+    {300, 100, 2000, 0, 0},
+    {300, 100, 2000, 30000, 2048},
+};
+
+/// The task stamps its sector writes with the card time, so worstWriteUs is in the model's time too
+uint32_t BusStatsNowUs(void)
+{
+    struct HostDiskStats stats;
+
+    HostDiskGetStats(&stats);
+    return (uint32_t)stats.busyUs;
+}
+
+BaseType_t SysInitStart(enum SysInitId id, TickType_t timeout)
+{
+    return pdPASS;
+}
+
+BaseType_t SysInitWaitFor(EventBits_t mask, TickType_t timeout)
+{
+    return pdPASS;
+}
+
+void init_storage(void)
+{
+    storageReady = true;
+}
+
+static void *SegmentsTask(void *arg)
+{
+    vCaptureSegmentsTask(NULL);
+    return NULL;
+}
+
+static int CompareUs(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+/// worst is the longest card work a sector can wait for, 0 for the longest time between two sectors
+static void Report(const char *what, uint32_t sectors, uint32_t worst)
+{
+    uint64_t total = 0;
+
+    for (uint32_t i = 0; i < sectors; i++) {
+        total += latencyUs[i];
+    }
+    qsort(latencyUs, sectors, sizeof(latencyUs[0]), CompareUs);
+    if (worst == 0) {
+        worst = latencyUs[sectors - 1];
+    }
+    printf("%-22s mean %6.0f us  p99 %6lu us  worst %6lu us  -> two buffers absorb %5.1f KB/s\n", what,
+           (double)total / sectors, (unsigned long)latencyUs[sectors * 99 / 100], (unsigned long)worst,
+           512.0 * 1e6 / 1024 / worst);
+}
+
+/// Appending to one file, with a sync as often as the segments update their header
+static void MeasureAppend(unsigned run)
+{
+    struct HostDiskStats before, after;
+    uint8_t sector[512];
+    UINT count;
+    FIL fp;
+
+    memset(sector, 0x5A, sizeof(sector));
+    CHECK_EQ(f_unlink("0:append.bin") == FR_OK || run == 0, true);
+    CHECK_EQ(f_open(&fp, "0:append.bin", FA_CREATE_ALWAYS | FA_WRITE), FR_OK);
+    for (uint32_t i = 0; i < BENCH_SECTORS; i++) {
+        HostDiskGetStats(&before);
+        CHECK_EQ(f_write(&fp, sector, sizeof(sector), &count), FR_OK);
+        if ((i + 1) % CAPTURE_SEGMENTS_SYNC_SECTORS == 0) {
+            CHECK_EQ(f_sync(&fp), FR_OK);
+        }
+        HostDiskGetStats(&after);
+        latencyUs[i] = (uint32_t)(after.busyUs - before.busyUs);
+    }
+    CHECK_EQ(f_close(&fp), FR_OK);
+    Report("append, allocating:", BENCH_SECTORS, 0);
+}
+
+/// Card time between two sectors written by the segments task. The catalog record of a full segment is added once
+/// no sector waits, so it falls between two sectors depending on the threads: the worst case is the task's own.
+static void MeasureSegments(void)
+{
+    struct CaptureSegmentsStats stats, start;
+    struct HostDiskStats disk;
+    uint8_t record[BENCH_RECORD];
+    uint64_t last;
+    uint8_t count, index;
+
+    memset(record, 0xA5, sizeof(record));
+    CaptureSegmentsGetStats(&start, &count, &index);
+    CaptureSegmentsStart();
+    while (!CaptureSegmentsIsActive()) {
+        sched_yield();
+    }
+    HostDiskGetStats(&disk);
+    last = disk.busyUs;
+    // Every third record hands a sector to the task, which is waited for so each one is timed on its own
+    for (uint32_t i = 0; i < BENCH_SECTORS; i++) {
+        CaptureSegmentsRecord(SERIAL_STREAM_CAPTURE, record, sizeof(record));
+        CaptureSegmentsRecord(SERIAL_STREAM_CAPTURE, record, sizeof(record));
+        if (i > 0) {
+            do {
+                sched_yield();
+                CaptureSegmentsGetStats(&stats, &count, &index);
+            } while (stats.sectors - start.sectors < i);
+            HostDiskGetStats(&disk);
+            latencyUs[i - 1] = (uint32_t)(disk.busyUs - last);
+            last = disk.busyUs;
+        }
+    }
+    CaptureSegmentsStop();
+    do {
+        sched_yield();
+        CaptureSegmentsGetStats(&stats, &count, &index);
+    } while (CaptureSegmentsIsActive() || stats.sectors - start.sectors < BENCH_SECTORS);
+
+    CHECK_EQ(stats.dropped, 0);
+    CHECK_EQ(stats.writeErrors, 0);
+    CHECK(stats.rotations - start.rotations >= BENCH_SECTORS / (BENCH_SEGMENT_MB * 2048 - 1));
+    // The task's worst is since boot, the run with card stalls comes last
+    Report("segments, preallocated:", BENCH_SECTORS - 1, stats.worstWriteUs);
+}
+
+/// Every segment has one live catalog record although the ring went round
+static void CheckCatalog(void)
+{
+    struct CaptureCatalogRecord rec;
+    int live[BENCH_SEGMENTS] = {0};
+
+    for (uint32_t i = 0; CaptureCatalogRead(i, &rec) == FR_OK; i++) {
+        unsigned n;
+        if (sscanf(rec.name, "seg%02u.cap", &n) == 1 && n < BENCH_SEGMENTS) {
+            live[n] += !(rec.flags & CAPTURE_CATALOG_FLAG_REPLACED);
+        }
+    }
+    for (unsigned n = 0; n < BENCH_SEGMENTS; n++) {
+        CHECK_EQ(live[n], 1);
+    }
+}
+
+int main(void)
+{
+    struct CaptureSegmentsStats stats;
+    uint8_t count = 0, index;
+    pthread_t task;
+
+    CHECK_EQ(HostDiskOpen(&fs, NULL, 64u * 2048u, 8), FR_OK);
+    CHECK_EQ(CaptureCatalogOpen(), FR_OK);
+    pthread_create(&task, NULL, SegmentsTask, NULL);
+    while (!storageReady) {
+        sched_yield();
+    }
+    CaptureSegmentsCreate(BENCH_SEGMENTS, BENCH_SEGMENT_MB);
+    while (count != BENCH_SEGMENTS) {
+        sched_yield();
+        CaptureSegmentsGetStats(&stats, &count, &index);
+    }
+
+    for (unsigned run = 0; run < sizeof(cardModels) / sizeof(cardModels[0]); run++) {
+        printf("%s card housekeeping stalls:\n", cardModels[run].stallEvery ? "With" : "Without");
+        HostDiskSetLatency(&cardModels[run]);
+        MeasureAppend(run);
+        MeasureSegments();
+    }
+    CheckCatalog();
+    // The task thread stays blocked on its notification, the process just ends
+    return HOST_TEST_RESULT();
+}
@@ -0,0 +1,132 @@
+/**************************************************************************/ /**
+ * @file      BenchEventDedup.c
+ * @brief     Compression ratio and speed of the bus event dictionary on polled register streams: one register, as
+ *            many registers as slots, more registers than slots, and a receiver that loses a burst of payloads now
+ *            and then. Reports the payload ratio against plain 16 byte events, the share sent as repeats, the share
+ *            a lossy receiver decodes, and ns per event to encode and to decode.
+ * @date      2026-10-19
+
+ ******************************************************************************/
+
+#include <string.h>
+
+#include "EventDedup/EventDedup.h"
+#include "HostTest.h"
+#include "SerialConsole.h"
+
+#define BENCH_EVENTS 1000000
+#define BENCH_MAX_REGISTERS 16
+
+/// A polled register
+struct Poll {
+    uint16_t address;
+    uint16_t reg;
+    uint32_t periodUs;
+    uint32_t nextUs;
+};
+
+/// One workload
+struct Workload {
+    const char *name;
+    unsigned registers;
+    unsigned lossEvery;  ///< A burst of up to 40 payloads is lost about once per this many, 0 for none
+};
+
+static struct Poll polls[BENCH_MAX_REGISTERS];
+static uint8_t events[BENCH_EVENTS][EVENT_DEDUP_EVENT_SIZE];
+static uint8_t packed[BENCH_EVENTS][EVENT_DEDUP_MAX_SIZE];
+static uint8_t packedLen[BENCH_EVENTS];
+static uint8_t packedType[BENCH_EVENTS];
+
+/// Fills events with the polls of the given registers, with jitter on the start and a duration that varies
+static void MakeEvents(unsigned registers, uint32_t *seed)
+{
+    for (unsigned i = 0; i < registers; i++) {
+        polls[i].address = (uint16_t)(0x40 + i / 3);
+        polls[i].reg = (uint16_t)(i * 7);
+        polls[i].periodUs = 1000 * (5 + HostTestRandom(seed) % 200);
+        polls[i].nextUs = HostTestRandom(seed) % polls[i].periodUs;
+    }
+    for (uint32_t n = 0; n < BENCH_EVENTS; n++) {
+        unsigned p = 0;
+        for (unsigned i = 1; i < registers; i++) {
+            p = (polls[i].nextUs < polls[p].nextUs) ? i : p;
+        }
+        uint32_t r = HostTestRandom(seed);
+        uint32_t fields[3] = {(r >> 8) % 64 == 0 ? 0xFFFFFFFFu : 0, polls[p].nextUs + r % 40, 180 + (r >> 16) % 24};
+        uint8_t *event = events[n];
+        event[0] = (uint8_t)polls[p].address;
+        event[1] = (uint8_t)(polls[p].address >> 8);
+        event[2] = (uint8_t)polls[p].reg;
+        event[3] = (uint8_t)(polls[p].reg >> 8);
+        for (uint8_t i = 0; i < 12; i++) {
+            event[4 + i] = (uint8_t)(fields[i / 4] >> (8 * (i % 4)));
+        }
+        polls[p].nextUs += polls[p].periodUs;
+    }
+}
+
+int main(void)
+{
+    static const struct Workload workloads[] = {
+        {"1 register", 1, 0},
+        {"6 registers", 6, 0},
+        {"8 registers, all slots", EVENT_DEDUP_SLOTS, 0},
+        {"16 registers, 8 slots", 16, 0},
+        {"6 registers, bursts lost", 6, 2000},
+    };
+    static struct EventDedupDictionary enc, dec;
+    uint8_t out[EVENT_DEDUP_EVENT_SIZE];
+    uint32_t seed = 99;
+    bool ok = true;
+
+    printf("%-26s %7s %8s %9s %9s %9s\n", "workload", "ratio", "repeats", "decoded", "encode", "decode");
+    for (unsigned w = 0; w < sizeof(workloads) / sizeof(workloads[0]); w++) {
+        const struct Workload *wl = &workloads[w];
+        uint64_t bytes = 0, t0, encodeNs, decodeNs;
+        uint32_t repeats = 0, decoded = 0, burst = 0, received = 0;
+
+        MakeEvents(wl->registers, &seed);
+        EventDedupInit(&enc);
+        EventDedupInit(&dec);
+        t0 = HostTestNowNs();
+        for (uint32_t n = 0; n < BENCH_EVENTS; n++) {
+            uint8_t type;
+            packedLen[n] = EventDedupEncode(&enc, events[n], packed[n], &type);
+            packedType[n] = type;
+        }
+        encodeNs = HostTestNowNs() - t0;
+
+        // Payloads the receiver loses are marked with length 0
+        for (uint32_t n = 0; n < BENCH_EVENTS; n++) {
+            bytes += packedLen[n];
+            repeats += (packedType[n] == SERIAL_STREAM_EVENT_REPEAT);
+            uint32_t r = HostTestRandom(&seed);
+            if (wl->lossEvery && burst == 0 && r % wl->lossEvery == 0) {
+                burst = 1 + (r >> 8) % 40;
+            }
+            if (burst > 0) {
+                burst--;
+                packedLen[n] = 0;
+            }
+        }
+
+        t0 = HostTestNowNs();
+        for (uint32_t n = 0; n < BENCH_EVENTS; n++) {
+            if (packedLen[n] == 0) {
+                continue;
+            }
+            received++;
+            if (EventDedupDecode(&dec, packedType[n], packed[n], packedLen[n], out) == EVENT_DEDUP_EVENT_SIZE) {
+                decoded++;
+                ok &= (memcmp(out, events[n], sizeof(out)) == 0);
+            }
+        }
+        decodeNs = HostTestNowNs() - t0;
+
+        printf("%-26s %6.2fx %7.1f%% %8.1f%% %6.1f ns %6.1f ns\n", wl->name,
+               (double)BENCH_EVENTS * EVENT_DEDUP_EVENT_SIZE / bytes, 100.0 * repeats / BENCH_EVENTS,
+               100.0 * decoded / BENCH_EVENTS, (double)encodeNs / BENCH_EVENTS, (double)decodeNs / received);
+    }
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
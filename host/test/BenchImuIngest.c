@@ -0,0 +1,165 @@
+/**************************************************************************/ /**
+ * @file      BenchImuIngest.c
+ * @brief     Sustained ingest and query latency of imu_ingest with many simulated analyzers: each sends batches of
+ *            16 three-axis samples at 104 Hz as the firmware formats them, 1% of them twice, and the run crosses
+ *            an hour so the store has two partitions per device. Reports the values stored per second, through
+ *            decoding, repeat detection and the store's writes, then the latency of queries of a second, a minute
+ *            and everything of a device and axis, with the blocks each reads. Arguments: devices (100), seconds of
+ *            data per device (120), and a directory to keep the store in.
+ * @date      2026-10-19
+
+ ******************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "HostTest.h"
+#include "ImuIngest.h"
+#include "ImuStore.h"
+
+#define BENCH_DEVICES 100
+#define BENCH_SECONDS 120
+#define BENCH_PERIOD_US 9615u  ///< 104 Hz
+#define BENCH_BATCH 16
+#define BENCH_PAYLOAD_MAX 448  ///< MQTT_SPOOL_MAX_PAYLOAD
+#define BENCH_START_US 1790002740000000ll  ///< One minute before a full hour
+#define BENCH_QUERIES 300
+
+struct BenchDevice {
+    char name[IMU_STORE_DEVICE_MAX + 1];
+    uint32_t t0;       ///< Device clock
+    int64_t offsetUs;  ///< Wall clock of device time 0
+    int16_t value[3];
+};
+
+static void CountRow(void *context, int64_t us, int16_t value)
+{
+    (void)us;
+    (void)value;
+    (*(uint64_t *)context)++;
+}
+
+static int CompareU64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+int main(int argc, char **argv)
+{
+    unsigned devices = (argc > 1) ? (unsigned)atoi(argv[1]) : BENCH_DEVICES;
+    unsigned seconds = (argc > 2) ? (unsigned)atoi(argv[2]) : BENCH_SECONDS;
+    unsigned rounds = (unsigned)((uint64_t)seconds * 1000000 / (BENCH_BATCH * BENCH_PERIOD_US));
+    char dir[64] = "/tmp/bench_ingest_XXXXXX", command[128];
+    struct BenchDevice *device = calloc(devices, sizeof(*device));
+    char *payload = malloc((size_t)devices * BENCH_PAYLOAD_MAX);
+    int *len = malloc(devices * sizeof(int));
+    struct ImuIngestMessage message;
+    struct ImuIngestStats stats;
+    struct ImuStore *store;
+    struct ImuIngest *ingest;
+    uint32_t randomState = 0x1234567u;
+    uint64_t ingestNs = 0, start;
+
+    if (argc > 3) {
+        snprintf(dir, sizeof(dir), "%s", argv[3]);
+        mkdir(dir, 0777);
+    } else if (mkdtemp(dir) == NULL) {
+        return EXIT_FAILURE;
+    }
+    store = ImuStoreOpen(dir);
+    ingest = ImuIngestOpen(store);
+    for (unsigned d = 0; d < devices; d++) {
+        snprintf(device[d].name, sizeof(device[d].name), "%08X%08X%08X%08X", 0x5A3Eu, d, ~d, 0xC0FFEEu);
+        device[d].t0 = HostTestRandom(&randomState);
+        device[d].offsetUs = BENCH_START_US + (int64_t)(HostTestRandom(&randomState) % 1000000) - device[d].t0;
+    }
+
+    for (unsigned r = 0; r < rounds; r++) {
+        // Formatting is the devices' work, only the ingest is timed
+        for (unsigned d = 0; d < devices; d++) {
+            struct BenchDevice *dev = &device[d];
+            memset(&message, 0, sizeof(message));
+            snprintf(message.device, sizeof(message.device), "%s", dev->name);
+            message.boot = 1;
+            message.seq = r;
+            message.t0 = dev->t0;
+            message.t1 = dev->t0 + (BENCH_BATCH - 1) * BENCH_PERIOD_US;
+            message.channelMask = 7;
+            message.count = BENCH_BATCH;
+            for (int i = 0; i < BENCH_BATCH; i++) {
+                for (int axis = 0; axis < 3; axis++) {  // A board at rest: noise around 1 g on z
+                    dev->value[axis] = (int16_t)(((axis == 2) ? 16384 : 0) + (int)(HostTestRandom(&randomState) % 61) - 30);
+                    message.value[i][axis] = dev->value[axis];
+                }
+            }
+            len[d] = ImuIngestFormat(payload + (size_t)d * BENCH_PAYLOAD_MAX, BENCH_PAYLOAD_MAX, &message);
+            CHECK(len[d] > 0);
+            dev->t0 += BENCH_BATCH * BENCH_PERIOD_US;
+        }
+        start = HostTestNowNs();
+        for (unsigned d = 0; d < devices; d++) {
+            const char *p = payload + (size_t)d * BENCH_PAYLOAD_MAX;
+            int64_t nowUs = device[d].offsetUs + device[d].t0 + 20000;
+            ImuIngestPayload(ingest, p, (size_t)len[d], nowUs);
+            if (HostTestRandom(&randomState) % 100 == 0) {
+                ImuIngestPayload(ingest, p, (size_t)len[d], nowUs + 1000);  // QoS 1 redelivery
+            }
+        }
+        ingestNs += HostTestNowNs() - start;
+    }
+    start = HostTestNowNs();
+    CHECK_EQ(ImuStoreFlush(store), 0);
+    ingestNs += HostTestNowNs() - start;
+    ImuIngestGetStats(ingest, &stats);
+    CHECK_EQ(stats.samples, (uint64_t)devices * rounds * BENCH_BATCH);
+    CHECK_EQ(stats.malformed + stats.storeErrors + stats.lost, 0);
+    printf("%u devices, %u s each: %llu messages (%llu repeats), %llu values in %.2f s\n", devices, seconds,
+           (unsigned long long)stats.messages, (unsigned long long)stats.duplicates,
+           (unsigned long long)stats.events, ingestNs / 1e9);
+    printf("ingest: %.0f values/s, %.0f messages/s, %.1f us per message\n", stats.events / (ingestNs / 1e9),
+           stats.messages / (ingestNs / 1e9), ingestNs / 1e3 / stats.messages);
+
+    printf("%-8s %10s %10s %10s %12s %14s\n", "query", "mean us", "p99 us", "rows", "blocks read", "blocks indexed");
+    static const struct {
+        const char *name;
+        int64_t spanUs;
+    } spans[] = {{"1 s", 1000000}, {"1 min", 60000000}, {"all", INT64_MAX}};
+    for (size_t s = 0; s < sizeof(spans) / sizeof(spans[0]); s++) {
+        uint64_t ns[BENCH_QUERIES], rows = 0, blocksRead = 0, blocks = 0, sum = 0;
+        for (int q = 0; q < BENCH_QUERIES; q++) {
+            const struct BenchDevice *dev = &device[HostTestRandom(&randomState) % devices];
+            int64_t first = dev->offsetUs + dev->t0 - (int64_t)rounds * BENCH_BATCH * BENCH_PERIOD_US;
+            int64_t last = dev->offsetUs + dev->t0;
+            struct ImuStoreQuery query = {dev->name, (uint8_t)(q % 3), INT64_MIN, INT64_MAX, INT16_MIN, INT16_MAX};
+            struct ImuStoreQueryStats qs;
+            if (spans[s].spanUs != INT64_MAX) {
+                query.fromUs = first + (int64_t)(HostTestRandom(&randomState) % (uint64_t)(last - first));
+                query.toUs = query.fromUs + spans[s].spanUs;
+            }
+            start = HostTestNowNs();
+            CHECK_EQ(ImuStoreSelect(dir, &query, CountRow, &rows, &qs), 0);
+            ns[q] = HostTestNowNs() - start;
+            sum += ns[q];
+            blocksRead += qs.blocksRead;
+            blocks += qs.blocks;
+        }
+        qsort(ns, BENCH_QUERIES, sizeof(ns[0]), CompareU64);
+        printf("%-8s %10.1f %10.1f %10.0f %12.1f %14.1f\n", spans[s].name, sum / 1e3 / BENCH_QUERIES,
+               ns[BENCH_QUERIES * 99 / 100] / 1e3, (double)rows / BENCH_QUERIES, (double)blocksRead / BENCH_QUERIES,
+               (double)blocks / BENCH_QUERIES);
+    }
+
+    ImuIngestClose(ingest);
+    CHECK_EQ(ImuStoreClose(store), 0);
+    if (argc <= 3) {
+        snprintf(command, sizeof(command), "rm -rf '%s'", dir);
+        CHECK_EQ(system(command), 0);
+    }
+    free(device);
+    free(payload);
+    free(len);
+    return HOST_TEST_RESULT();
+}
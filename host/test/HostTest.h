@@ -0,0 +1,60 @@
+/**************************************************************************/ /**
+ * @file      HostTest.h
+ * @brief     Minimal assertions shared by the host tests. A failed check prints its location and the test
+ *            returns a non-zero exit code to ctest.
+ * @date      2026-10-19
+
+ ******************************************************************************/
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+static int hostTestFailures __attribute__((unused));
+
+#define CHECK(cond)                                                                  \
+    do {                                                                             \
+        if (!(cond)) {                                                               \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            hostTestFailures++;                                                      \
+        }                                                                            \
+    } while (0)
+
+#define CHECK_EQ(a, b)                                                                                            \
+    do {                                                                                                          \
+        long long _a = (long long)(a), _b = (long long)(b);                                                       \
+        if (_a != _b) {                                                                                           \
+            fprintf(stderr, "%s:%d: check failed: %s == %s (%lld != %lld)\n", __FILE__, __LINE__, #a, #b, _a, _b); \
+            hostTestFailures++;                                                                                   \
+        }                                                                                                         \
+    } while (0)
+
+#define RUN_TEST(fn)                       \
+    do {                                   \
+        int _before = hostTestFailures;    \
+        fn();                              \
+        printf("%s %s\n", _before == hostTestFailures ? "PASS" : "FAIL", #fn); \
+    } while (0)
+
+#define HOST_TEST_RESULT() (hostTestFailures ? EXIT_FAILURE : EXIT_SUCCESS)
+
+/// Deterministic generator so that a failing fuzz case reproduces from its seed
+static inline uint32_t HostTestRandom(uint32_t *state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+/// Monotonic time in nanoseconds, for the benchmark reports
+static inline uint64_t HostTestNowNs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
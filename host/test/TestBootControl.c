@@ -0,0 +1,123 @@
+/**************************************************************************/ /**
+ * @file      TestBootControl.c
+ * @brief     Host tests of the boot control record: the bootloader decision for every record state, and records
+ *            written through a fake NVM that loses power part way through the row write.
+ * @date      2026-10-19
+
+ ******************************************************************************/
+
+#include <string.h>
+
+#include "BootControl/BootControl.h"
+#include "HostTest.h"
+#include "asf.h"
+
+#define APP_STACK 0x20007000u
+#define APP_RESET 0x00012345u
+
+static uint8_t flashRow[NVMCTRL_ROW_SIZE];  ///< The boot control row
+static int32_t writeBudget = -1;            ///< Bytes written before the fake power loss, -1 for no loss
+
+void nvm_get_config_defaults(struct nvm_config *const config)
+{
+    config->manual_page_write = true;
+}
+
+enum status_code nvm_set_config(const struct nvm_config *const config)
+{
+    return STATUS_OK;
+}
+
+enum status_code nvm_erase_row(const uint32_t row_address)
+{
+    CHECK_EQ(row_address, BOOT_CONTROL_ADDRESS);
+    memset(flashRow, 0xFF, sizeof(flashRow));
+    return STATUS_OK;
+}
+
+enum status_code nvm_write_buffer(const uint32_t destination_address, const uint8_t *buffer, uint16_t length)
+{
+    CHECK_EQ(destination_address, BOOT_CONTROL_ADDRESS);
+    CHECK(length <= NVMCTRL_PAGE_SIZE);
+    for (uint16_t i = 0; i < length && writeBudget != 0; i++, writeBudget--) {
+        flashRow[i] &= buffer[i];  // Flash bits only go from 1 to 0
+    }
+    return STATUS_OK;
+}
+
+static const struct BootControl *Row(void)
+{
+    return (const struct BootControl *)flashRow;
+}
+
+static void TestDecide(void)
+{
+    struct BootControl ctl;
+    uint8_t image = 0;
+
+    memset(&ctl, 0xFF, sizeof(ctl));
+    CHECK_EQ(BootControlDecide(&ctl, APP_STACK, APP_RESET, &image), BOOT_ACTION_JUMP);
+    CHECK_EQ(BootControlDecide(&ctl, 0xFFFFFFFFu, 0xFFFFFFFFu, &image), BOOT_ACTION_RECOVER);  // Erased application
+    CHECK_EQ(BootControlDecide(&ctl, APP_STACK, APP_RESET & ~1u, &image), BOOT_ACTION_RECOVER);  // Not a Thumb address
+    CHECK_EQ(BootControlDecide(&ctl, APP_STACK, BOOT_CONTROL_ADDRESS + 1, &image), BOOT_ACTION_RECOVER);
+    CHECK_EQ(BootControlDecide(&ctl, BOOT_CONTROL_SRAM_END + 4, APP_RESET, &image), BOOT_ACTION_RECOVER);
+
+    ctl.magic = BOOT_CONTROL_MAGIC;
+    ctl.image = BOOT_CONTROL_IMAGE_B;
+    ctl.imageCheck = ~ctl.image;
+    CHECK_EQ(BootControlDecide(&ctl, APP_STACK, APP_RESET, &image), BOOT_ACTION_UPDATE);
+    CHECK_EQ(image, BOOT_CONTROL_IMAGE_B);
+
+    ctl.imageCheck = ctl.image;
+    CHECK_EQ(BootControlDecide(&ctl, APP_STACK, APP_RESET, &image), BOOT_ACTION_RECOVER);
+    ctl.image = 3;
+    ctl.imageCheck = ~ctl.image;
+    CHECK_EQ(BootControlDecide(&ctl, APP_STACK, APP_RESET, &image), BOOT_ACTION_RECOVER);
+    ctl.magic = 0x12345678;
+    CHECK_EQ(BootControlDecide(&ctl, APP_STACK, APP_RESET, &image), BOOT_ACTION_RECOVER);
+}
+
+static void TestRequestUpdate(void)
+{
+    uint8_t image = 0;
+
+    writeBudget = -1;
+    CHECK_EQ(BootControlRequestUpdate(BOOT_CONTROL_IMAGE_A), STATUS_OK);
+    CHECK_EQ(BootControlDecide(Row(), APP_STACK, APP_RESET, &image), BOOT_ACTION_UPDATE);
+    CHECK_EQ(image, BOOT_CONTROL_IMAGE_A);
+    CHECK_EQ(BootControlRequestUpdate(7), STATUS_ERR_INVALID_ARG);
+}
+
+static void TestTornWrite(void)
+{
+    // Whatever prefix of the record made it to flash, the bootloader never jumps over a half written request
+    // and never flashes an image that was not requested
+    const struct BootControl full = {BOOT_CONTROL_MAGIC, BOOT_CONTROL_IMAGE_B, ~(uint32_t)BOOT_CONTROL_IMAGE_B};
+
+    for (int32_t budget = 0; budget <= (int32_t)sizeof(struct BootControl); budget++) {
+        uint8_t image = 0;
+        enum BootAction action;
+
+        writeBudget = budget;
+        BootControlRequestUpdate(BOOT_CONTROL_IMAGE_B);
+        action = BootControlDecide(Row(), APP_STACK, APP_RESET, &image);
+        if (memcmp(flashRow, &full, sizeof(full)) == 0) {
+            // Also reached before the last byte: the high bytes of imageCheck are 0xFF, as in an erased row
+            CHECK_EQ(action, BOOT_ACTION_UPDATE);
+            CHECK_EQ(image, BOOT_CONTROL_IMAGE_B);
+        } else if (budget == 0) {
+            CHECK_EQ(action, BOOT_ACTION_JUMP);  // Nothing written, the row is still erased
+        } else {
+            CHECK_EQ(action, BOOT_ACTION_RECOVER);
+        }
+    }
+    writeBudget = -1;
+}
+
+int main(void)
+{
+    RUN_TEST(TestDecide);
+    RUN_TEST(TestRequestUpdate);
+    RUN_TEST(TestTornWrite);
+    return HOST_TEST_RESULT();
+}
@@ -0,0 +1,200 @@
+/**************************************************************************/ /**
+ * @file      TestBusStats.c
+ * @brief     Host tests of the bus statistics: exact address counters, heavy hitters of a skewed synthetic stream
+ *            against the true counts, the histograms, and snapshots that trim entries to fit the MQTT buffer.
+ * @date      2026-10-19
+
+ ******************************************************************************/
+
+#include <string.h>
+
+#include "BusStats/BusStats.h"
+#include "HostTest.h"
+#include "asf.h"
+#include "task.h"
+
+#define MQTT_PAYLOAD_SIZE 448  ///< MQTT_SPOOL_MAX_PAYLOAD, the buffer the Wifi task formats snapshots into
+
+TickType_t hostTickCount;
+SysTick_Type hostSysTick;
+
+static char json[1024];
+
+static void Record(uint16_t address, uint16_t reg, int32_t status, uint32_t startUs, uint32_t durationUs)
+{
+    struct BusStatsEvent ev = {address, reg, status, startUs, durationUs};
+    BusStatsRecord(&ev);
+}
+
+/// Value of "key":<number> in json, -1 if it is missing
+static long JsonNumber(const char *key)
+{
+    char pattern[32];
+    const char *at;
+
+    snprintf(pattern, sizeof(pattern), "\"%s\":", key);
+    at = strstr(json, pattern);
+    return (at == NULL) ? -1 : strtol(at + strlen(pattern), NULL, 10);
+}
+
+/// Brackets balance and the text is one object
+static bool JsonWellFormed(uint16_t len)
+{
+    int depth = 0;
+
+    if (len == 0 || strlen(json) != len || json[0] != '{' || json[len - 1] != '}') {
+        return false;
+    }
+    for (uint16_t i = 0; i < len; i++) {
+        depth += (json[i] == '{' || json[i] == '[') - (json[i] == '}' || json[i] == ']');
+        if (depth < 0 || (depth == 0 && i != len - 1)) {
+            return false;
+        }
+    }
+    return depth == 0;
+}
+
+static void TestAddresses(void)
+{
+    uint16_t len;
+
+    BusStatsSnapshotJson(json, sizeof(json));  // Start from an empty interval
+    for (uint16_t a = 0; a < BUS_STATS_ADDRESSES + 2; a++) {
+        for (uint16_t n = 0; n <= a; n++) {
+            Record(0x10 + a, 0, (n == 0) ? -5 : 0, 0, 10);
+        }
+    }
+    len = BusStatsSnapshotJson(json, sizeof(json));
+    CHECK(JsonWellFormed(len));
+    CHECK_EQ(JsonNumber("n"), (BUS_STATS_ADDRESSES + 2) * (BUS_STATS_ADDRESSES + 3) / 2);
+    CHECK_EQ(JsonNumber("err"), BUS_STATS_ADDRESSES + 2);
+    CHECK_EQ(JsonNumber("untracked"), (BUS_STATS_ADDRESSES + 1) + (BUS_STATS_ADDRESSES + 2));
+    CHECK_EQ(JsonNumber("cut"), 0);
+    // Busiest address first: 0x17 was seen 8 times, once with an error
+    CHECK(strstr(json, "\"addr\":[[23,8,1],[22,7,1],") != NULL);
+    CHECK(strstr(json, "[16,1,1]]") != NULL);
+
+    // The snapshot cleared the interval
+    len = BusStatsSnapshotJson(json, sizeof(json));
+    CHECK(JsonWellFormed(len));
+    CHECK_EQ(JsonNumber("n"), 0);
+    CHECK(strstr(json, "\"addr\":[],\"top\":[]") != NULL);
+}
+
+static void TestHeavyHitters(void)
+{
+    static uint32_t truth[5][256];  // 0x50 to 0x53, then 0x68
+    uint32_t rng = 0xB0757A75u;
+    uint16_t len;
+
+    memset(truth, 0, sizeof(truth));
+    BusStatsSnapshotJson(json, sizeof(json));
+    // Three hot registers over a background of 1024 pairs, each hot one about 10 % of the traffic
+    for (int n = 0; n < 100000; n++) {
+        uint32_t r = HostTestRandom(&rng);
+        uint16_t address, reg;
+        if (r % 10 < 3) {
+            address = 0x68;
+            reg = 0x3B + (r % 10) * 2;
+        } else {
+            address = 0x50 + (r >> 8) % 4;
+            reg = (r >> 16) % 256;
+        }
+        truth[(address == 0x68) ? 4 : address - 0x50][reg]++;
+        Record(address, reg, 0, (uint32_t)n * 100, 20);
+    }
+    len = BusStatsSnapshotJson(json, sizeof(json));
+    CHECK(JsonWellFormed(len));
+
+    // The three hot pairs lead the list, and no estimate is below the true count
+    const char *top = strstr(json, "\"top\":[");
+    CHECK(top != NULL);
+    if (top == NULL) {
+        return;
+    }
+    top += strlen("\"top\":[");
+    for (int rank = 0; rank < BUS_STATS_TOP_N && *top == '['; rank++) {
+        unsigned int address;
+        int reg;
+        unsigned long estimate;
+        CHECK_EQ(sscanf(top, "[%u,%d,%lu]", &address, &reg, &estimate), 3);
+        CHECK(reg >= 0 && reg < 256);
+        if (rank < 3) {
+            CHECK_EQ(address, 0x68);
+            CHECK(reg == 0x3B || reg == 0x3D || reg == 0x3F);
+        }
+        CHECK(estimate >= truth[(address == 0x68) ? 4 : (address - 0x50) & 3][reg & 0xFF]);
+        top = strchr(top, ']') + 1;
+        top += (*top == ',');
+    }
+}
+
+static void TestHistograms(void)
+{
+    uint16_t len;
+
+    BusStatsSnapshotJson(json, sizeof(json));
+    Record(0x20, 1, 0, 1000, 0);     // Latency bucket 0, gap back to the previous interval: last bucket
+    Record(0x20, 1, 0, 1001, 1);     // Bucket 1, gap 1 us: bucket 1
+    Record(0x20, 1, 0, 1002, 3);     // Bucket 2, gap 0 us: bucket 0
+    Record(0x20, 1, 0, 2005, 1000);  // Bucket 10, gap 1000 us: bucket 10
+    Record(0x20, 1, 0, 0x80000000u, 0xFFFFFFFFu);  // Capped at the last bucket, gap too
+    len = BusStatsSnapshotJson(json, sizeof(json));
+    CHECK(JsonWellFormed(len));
+    CHECK(strstr(json, "\"lat\":[1,1,1,0,0,0,0,0,0,0,1,0,0,0,0,1]") != NULL);
+    CHECK(strstr(json, "\"gap\":[1,1,0,0,0,0,0,0,0,0,1,0,0,0,0,2]") != NULL);
+}
+
+static void TestTrimToFit(void)
+{
+    uint16_t len;
+
+    // Every address and top entry as wide as it gets in a busy interval
+    BusStatsSnapshotJson(json, sizeof(json));
+    hostTickCount = 0;
+    BusStatsSnapshotJson(json, sizeof(json));
+    for (uint32_t n = 0; n < 200000; n++) {
+        Record(0xFF00 + n % BUS_STATS_ADDRESSES, 0xFF00 + (n / BUS_STATS_ADDRESSES) % 20, (n % 3 == 0) ? -1 : 0, n * 7,
+               n % 60000);
+    }
+    hostTickCount = 10000;
+    len = BusStatsPeekJson(json, sizeof(json));
+    CHECK(JsonWellFormed(len));
+    CHECK_EQ(JsonNumber("cut"), 0);
+    CHECK(len > MQTT_PAYLOAD_SIZE);  // The case that used to drop the whole interval
+
+    len = BusStatsPeekJson(json, MQTT_PAYLOAD_SIZE);
+    CHECK(JsonWellFormed(len));
+    CHECK(len < MQTT_PAYLOAD_SIZE);
+    CHECK(JsonNumber("cut") > 0);
+    CHECK_EQ(JsonNumber("ms"), 10000);
+    CHECK(strstr(json, "\"addr\":[[") != NULL);  // The busiest entries are still there
+
+    // The smallest buffer the header promises keeps the counters and histograms, and drops every entry
+    len = BusStatsPeekJson(json, BUS_STATS_JSON_MIN_SIZE);
+    CHECK(JsonWellFormed(len));
+    CHECK(len < BUS_STATS_JSON_MIN_SIZE);
+    CHECK(JsonNumber("n") == 200000);
+
+    // Any size from the minimum up gives a well formed snapshot, and nothing is written past size
+    for (uint16_t size = BUS_STATS_JSON_MIN_SIZE; size < 900; size++) {
+        memset(json, '#', sizeof(json));
+        json[sizeof(json) - 1] = '\0';
+        len = BusStatsPeekJson(json, size);
+        CHECK(JsonWellFormed(len));
+        CHECK(json[size] == '#');
+    }
+    CHECK_EQ(BusStatsPeekJson(json, 64), 0);
+
+    len = BusStatsSnapshotJson(json, MQTT_PAYLOAD_SIZE);
+    CHECK(JsonWellFormed(len));
+}
+
+int main(void)
+{
+    RUN_TEST(TestAddresses);
+    RUN_TEST(TestHeavyHitters);
+    RUN_TEST(TestHistograms);
+    RUN_TEST(TestTrimToFit);
+    return HOST_TEST_RESULT();
+}
@@ -0,0 +1,191 @@
+/**************************************************************************/ /**
+ * @file      TestCaptureCatalog.c
+ * @brief     Host tests of the capture catalog on a FAT image: lookups by time while sorted and unsorted, overwritten
+ *            files that leave one live record per name, a torn last record and a corrupt middle one, and the
+ *            directory scan that skips hidden, partial and too long names.
+ * @date      2026-10-19
+
+ ******************************************************************************/
+
+#include <string.h>
+#include <strings.h>
+
+#include "CaptureCatalog/CaptureCatalog.h"
+#include "HostDisk.h"
+#include "HostTest.h"
+#include "task.h"
+
+#define T0 0x5B530000u  ///< 2025-10-19 00:00:00 as a FAT timestamp
+#define CAPTURES 50
+
+TickType_t hostTickCount;
+
+static FATFS fs;
+
+/// Adds a record for name that spans [start, end]
+static void Add(const char *name, uint32_t start, uint32_t end, bool replaces)
+{
+    struct CaptureCatalogRecord rec;
+
+    memset(&rec, 0, sizeof(rec));
+    rec.start = start;
+    rec.size = 100;
+    hostFatTime = end;
+    CHECK_EQ(CaptureCatalogAdd(&rec, name, replaces), FR_OK);
+}
+
+/// ID of the file found at a time, 0 if there is none
+static uint32_t FindId(uint32_t time)
+{
+    struct CaptureCatalogRecord rec;
+    FRESULT res = CaptureCatalogFind(time, &rec);
+
+    CHECK(res == FR_OK || res == FR_NO_FILE);
+    return (res == FR_OK) ? rec.id : 0;
+}
+
+/// Records of a name that are not marked replaced
+static int LiveRecords(const char *name)
+{
+    struct CaptureCatalogRecord rec;
+    int live = 0;
+
+    for (uint32_t i = 0; CaptureCatalogRead(i, &rec) == FR_OK; i++) {
+        live += (strcmp(rec.name, name) == 0 && !(rec.flags & CAPTURE_CATALOG_FLAG_REPLACED));
+    }
+    return live;
+}
+
+/// Overwrites bytes of the catalog file behind its back
+static void Poke(uint32_t offset, const void *data, UINT len)
+{
+    FIL fp;
+    UINT count;
+
+    CHECK_EQ(f_open(&fp, CAPTURE_CATALOG_FILE, FA_WRITE), FR_OK);
+    CHECK_EQ(f_lseek(&fp, offset), FR_OK);
+    CHECK_EQ(f_write(&fp, data, len, &count), FR_OK);
+    CHECK_EQ(f_close(&fp), FR_OK);
+}
+
+static void TestAddAndFind(void)
+{
+    char name[16];
+
+    CHECK_EQ(CaptureCatalogOpen(), FR_OK);
+    CHECK_EQ(CaptureCatalogCount(), 0);
+    // File i spans T0 + 10i - 5 to T0 + 10i, with a gap before the next one
+    for (uint32_t i = 1; i <= CAPTURES; i++) {
+        snprintf(name, sizeof(name), "0:cap%lu.bin", (unsigned long)i);
+        Add(name, T0 + 10 * i - 5, T0 + 10 * i, false);
+    }
+    CHECK_EQ(CaptureCatalogCount(), CAPTURES);
+    for (uint32_t i = 1; i <= CAPTURES; i++) {
+        CHECK_EQ(FindId(T0 + 10 * i - 5), i);
+        CHECK_EQ(FindId(T0 + 10 * i), i);
+        CHECK_EQ(FindId(T0 + 10 * i + 3), 0);
+    }
+    CHECK_EQ(FindId(T0), 0);
+    CHECK_EQ(FindId(T0 + 10 * CAPTURES + 1), 0);
+}
+
+static void TestReplace(void)
+{
+    struct CaptureCatalogRecord rec;
+
+    // cap3.bin written again later: its old span is no longer found, the new one is
+    Add("0:cap3.bin", T0 + 995, T0 + 1000, true);
+    CHECK_EQ(CaptureCatalogCount(), CAPTURES + 1);
+    CHECK_EQ(FindId(T0 + 28), 0);
+    CHECK_EQ(FindId(T0 + 998), CAPTURES + 1);
+    CHECK_EQ(CaptureCatalogRead(2, &rec), FR_OK);
+    CHECK(strcmp(rec.name, "cap3.bin") == 0 && (rec.flags & CAPTURE_CATALOG_FLAG_REPLACED));
+    Add("0:cap3.bin", T0 + 1005, T0 + 1010, true);
+    CHECK_EQ(LiveRecords("cap3.bin"), 1);
+    CHECK_EQ(FindId(T0 + 998), 0);
+
+    // A replacement that ends before the last record makes the catalog unsorted, lookups then scan
+    Add("0:cap7.bin", T0 + 495, T0 + 500, true);
+    CHECK_EQ(LiveRecords("cap7.bin"), 1);
+    CHECK_EQ(FindId(T0 + 68), 0);
+    CHECK_EQ(FindId(T0 + 498), CAPTURES + 3);
+    CHECK_EQ(FindId(T0 + 58), 6);
+    CHECK_EQ(FindId(T0 + 1008), CAPTURES + 2);
+
+    // Without replaces the scan is skipped, which is what new names rely on
+    Add("0:new.bin", T0 + 1015, T0 + 1020, false);
+    CHECK_EQ(LiveRecords("new.bin"), 1);
+}
+
+static void TestTornAndCorrupt(void)
+{
+    static const uint8_t junk[40] = {0xA5};
+    uint32_t count = CaptureCatalogCount();
+    uint8_t flip = 0xFF;
+
+    // A reset during an append leaves part of a record: it is cut off on open
+    CaptureCatalogClose();
+    CHECK(!CaptureCatalogIsOpen());
+    Poke(sizeof(struct CaptureCatalogRecord) * (count + 1), junk, sizeof(junk));
+    CHECK_EQ(CaptureCatalogOpen(), FR_OK);
+    CHECK_EQ(CaptureCatalogCount(), count);
+    CHECK_EQ(FindId(T0 + 10 * 20), 20);
+    CHECK_EQ(LiveRecords("cap3.bin"), 1);
+
+    // A bad record elsewhere is found by a lookup, which rebuilds from the directory: no files there yet
+    CaptureCatalogClose();
+    Poke(sizeof(struct CaptureCatalogRecord) * 5 + 10, &flip, 1);  // cap5.bin, the fifth record
+    CHECK_EQ(CaptureCatalogOpen(), FR_OK);
+    CHECK_EQ(FindId(T0 + 10 * 5), 0);
+    CHECK_EQ(CaptureCatalogCount(), 0);
+}
+
+static void TestScan(void)
+{
+    static const char *const files[] = {
+        "0:short.bin",
+        "0:a-long-capture-name-2026.bin",
+        "0:xfer.tmp",
+        "0:hidden.bin",
+        "0:this-long-name-does-not-fit-a-record-2026-10-19.bin",
+    };
+    struct CaptureCatalogRecord rec;
+    FIL fp;
+    UINT count;
+
+    for (unsigned i = 0; i < sizeof(files) / sizeof(files[0]); i++) {
+        hostFatTime = T0 + 100 * i;
+        CHECK_EQ(f_open(&fp, files[i], FA_CREATE_ALWAYS | FA_WRITE), FR_OK);
+        CHECK_EQ(f_write(&fp, files[i], 10, &count), FR_OK);
+        CHECK_EQ(f_close(&fp), FR_OK);
+    }
+    CHECK_EQ(f_chmod("0:hidden.bin", AM_HID, AM_HID), FR_OK);
+
+    CHECK_EQ(CaptureCatalogRebuild(), FR_OK);
+    CHECK_EQ(CaptureCatalogCount(), 2);
+    for (uint32_t i = 0; CaptureCatalogRead(i, &rec) == FR_OK; i++) {
+        CHECK(strcasecmp(rec.name, "short.bin") == 0 || strcmp(rec.name, "a-long-capture-name-2026.bin") == 0);
+        CHECK(rec.flags & CAPTURE_CATALOG_FLAG_REBUILT);
+        CHECK_EQ(rec.size, 10);
+        CHECK_EQ(rec.start, rec.end);
+    }
+    CHECK_EQ(FindId(T0 + 100), 2);
+
+    // Numbered names skip files that are on the card but not cataloged
+    char path[CAPTURE_CATALOG_NAME_MAX + 2] = "0:xfer.tmp";
+    uint32_t id = CaptureCatalogNewName(path, sizeof(path));
+    CHECK(id > 2);
+    CHECK(strcmp(path, "0:xfer-3.tmp") == 0);
+}
+
+int main(void)
+{
+    CHECK_EQ(HostDiskOpen(&fs, NULL, 8192, 1), FR_OK);
+    RUN_TEST(TestAddAndFind);
+    RUN_TEST(TestReplace);
+    RUN_TEST(TestTornAndCorrupt);
+    RUN_TEST(TestScan);
+    CaptureCatalogClose();
+    HostDiskClose(&fs);
+    return HOST_TEST_RESULT();
+}
@@ -0,0 +1,158 @@
+/**************************************************************************/ /**
+ * @file      TestCaptureCodec.c
+ * @brief     Host tests of the capture codec: random blocks of every axis mask and length, from flat noise to full
+ *            scale random words, round trip through the encoder and the decoder bit for bit, and a packed payload is
+ *            always shorter than the raw one. Truncated and random packed payloads must be rejected or decode within
+ *            the output buffer.
+ * @date      2026-10-19
+
+ ******************************************************************************/
+
+#include <string.h>
+
+#include "CaptureCodec/CaptureCodec.h"
+#include "HostTest.h"
+
+#define FUZZ_BLOCKS 200000
+#define FRAME_SIZE (CAPTURE_CODEC_HEADER + 16 * 6)  ///< Largest capture payload, as in ImuFifo.c
+#define GUARD 0xE7
+
+uint32_t BusStatsNowUs(void)
+{
+    return 0;
+}
+
+/// Builds a capture payload of count samples of the axes in mask. kind picks the signal, see the switch.
+static uint16_t MakeBlock(uint8_t *raw, uint8_t mask, uint8_t count, unsigned kind, uint32_t *seed)
+{
+    uint8_t nch = (uint8_t)(((mask >> 0) & 1) + ((mask >> 1) & 1) + ((mask >> 2) & 1));
+    uint16_t len = CAPTURE_CODEC_HEADER;
+    int32_t level = (int32_t)(HostTestRandom(seed) % 65536) - 32768;
+    int32_t slope = (int32_t)(HostTestRandom(seed) % 201) - 100;
+
+    for (int i = 0; i < 8; i++) {
+        raw[i] = (uint8_t)HostTestRandom(seed);
+    }
+    raw[8] = mask;
+    raw[9] = count;
+    for (uint16_t n = 0; n < (uint16_t)count * nch; n++) {
+        uint32_t r = HostTestRandom(seed);
+        int32_t x;
+        switch (kind % 5) {
+            case 0:  // At rest: a level and a few LSB of noise
+                x = level + (int32_t)(r % 5) - 2;
+                break;
+            case 1:  // Smooth motion
+                x = level + slope * (int32_t)(n / nch) + (int32_t)(r % 3) - 1;
+                break;
+            case 2:  // Held values with the odd step, for the run mode
+                if (r % 8 == 0) level += (int32_t)(r >> 8) % 512 - 256;
+                x = level;
+                break;
+            case 3:  // Full scale words, which do not pack
+                x = (int32_t)(r & 0xFFFF) - 32768;
+                break;
+            default:  // The extremes, so predictions wrap around
+                x = (r & 1) ? 32767 : -32768;
+                break;
+        }
+        raw[len++] = (uint8_t)x;
+        raw[len++] = (uint8_t)((uint32_t)x >> 8);
+    }
+    return len;
+}
+
+static void TestRoundTrip(void)
+{
+    uint8_t raw[FRAME_SIZE], packed[FRAME_SIZE + 4], decoded[FRAME_SIZE + 4];
+    uint32_t seed = 0xC0DEC;
+    unsigned packedBlocks = 0, failures = 0;
+
+    for (uint32_t n = 0; n < FUZZ_BLOCKS && failures < 10; n++) {
+        uint8_t mask = (uint8_t)(1 + HostTestRandom(&seed) % 7);
+        uint8_t count = (uint8_t)(HostTestRandom(&seed) % 17);
+        uint16_t len = MakeBlock(raw, mask, count, n, &seed);
+
+        memset(packed, GUARD, sizeof(packed));
+        uint16_t out = CaptureCodecEncode(raw, len, packed, FRAME_SIZE);
+        if (out == 0) {
+            continue;
+        }
+        packedBlocks++;
+        memset(decoded, GUARD, sizeof(decoded));
+        int32_t got = CaptureCodecDecode(packed, out, decoded, FRAME_SIZE);
+        bool ok = out < len && packed[len - 1] == GUARD && got == len && memcmp(decoded, raw, len) == 0 &&
+                  decoded[len] == GUARD;
+        if (!ok) {
+            fprintf(stderr, "block %lu: mask %u count %u len %u packed %u decoded %ld\n", (unsigned long)n, mask, count,
+                    len, out, (long)got);
+            failures++;
+        }
+    }
+    CHECK_EQ(failures, 0);
+    // Every kind but the full scale words packs
+    CHECK(packedBlocks > FUZZ_BLOCKS / 2);
+}
+
+/// Random blocks whose packed payload only just fits: the encoder must give up rather than return len bytes
+static void TestNoGain(void)
+{
+    uint8_t raw[FRAME_SIZE], packed[FRAME_SIZE];
+    uint32_t seed = 77;
+
+    for (uint32_t n = 0; n < FUZZ_BLOCKS / 10; n++) {
+        uint16_t len = MakeBlock(raw, 7, 16, 3, &seed);
+        uint16_t out = CaptureCodecEncode(raw, len, packed, sizeof(packed));
+        CHECK(out < len);
+        // A smaller output buffer is a limit too
+        out = CaptureCodecEncode(raw, len, packed, 20);
+        CHECK(out <= 20);
+    }
+    // No axis, a short header or a length that does not match the header
+    memset(raw, 0, sizeof(raw));
+    CHECK_EQ(CaptureCodecEncode(raw, FRAME_SIZE, packed, sizeof(packed)), 0);
+    CHECK_EQ(CaptureCodecEncode(raw, 4, packed, sizeof(packed)), 0);
+    raw[8] = 7;
+    raw[9] = 16;
+    CHECK_EQ(CaptureCodecEncode(raw, FRAME_SIZE - 2, packed, sizeof(packed)), 0);
+}
+
+/// Cut and random packed payloads are rejected or decode to something that fits, never past the buffer
+static void TestMalformed(void)
+{
+    uint8_t raw[FRAME_SIZE], packed[FRAME_SIZE], decoded[FRAME_SIZE + 4];
+    uint32_t seed = 4242;
+
+    for (uint32_t n = 0; n < FUZZ_BLOCKS / 10; n++) {
+        uint16_t len = MakeBlock(raw, (uint8_t)(1 + n % 7), 16, n % 3, &seed);
+        uint16_t out = CaptureCodecEncode(raw, len, packed, sizeof(packed));
+        if (out == 0) {
+            continue;
+        }
+        uint16_t cut = (uint16_t)(HostTestRandom(&seed) % out);
+        memset(decoded, GUARD, sizeof(decoded));
+        int32_t got = CaptureCodecDecode(packed, cut, decoded, FRAME_SIZE);
+        CHECK(got == -1 || (got >= CAPTURE_CODEC_HEADER && got <= FRAME_SIZE));
+        CHECK(decoded[FRAME_SIZE] == GUARD);
+        // A raw buffer that is too small for the header's count
+        CHECK_EQ(CaptureCodecDecode(packed, out, decoded, (uint16_t)(len - 1)), -1);
+    }
+    for (uint32_t n = 0; n < FUZZ_BLOCKS / 10; n++) {
+        uint16_t len = (uint16_t)(HostTestRandom(&seed) % sizeof(packed));
+        for (uint16_t i = 0; i < len; i++) {
+            packed[i] = (uint8_t)HostTestRandom(&seed);
+        }
+        memset(decoded, GUARD, sizeof(decoded));
+        int32_t got = CaptureCodecDecode(packed, len, decoded, FRAME_SIZE);
+        CHECK(got == -1 || (got >= CAPTURE_CODEC_HEADER && got <= FRAME_SIZE));
+        CHECK(decoded[FRAME_SIZE] == GUARD);
+    }
+}
+
+int main(void)
+{
+    RUN_TEST(TestRoundTrip);
+    RUN_TEST(TestNoGain);
+    RUN_TEST(TestMalformed);
+    return HOST_TEST_RESULT();
+}
@@ -0,0 +1,161 @@
+/**************************************************************************/ /**
+ * @file      TestCaptureConfig.c
+ * @brief     Host tests of the capture configuration message: decoding of hand-written messages, every rejection
+ *            reason, random messages through the encoder and back, and the pending slot and ack of the handshake.
+ * @date      2026-10-19
+
+ ******************************************************************************/
+
+#include <string.h>
+
+#include "CaptureConfig/CaptureConfig.h"
+#include "HostTest.h"
+
+static void TestDecodeMessage(void)
+{
+    // Version 1, seq 7, X and Z, trigger above on Y at -2, raw, 208 Hz, filters 0x0123 and 0x4567
+    const uint8_t msg[] = {1, 7, 0x05, 1, 1, 0, 0xD0, 0x00, 0xFE, 0xFF, 2, 0x23, 0x01, 0x67, 0x45};
+    struct CaptureConfig cfg;
+    uint8_t seq = 0;
+
+    CHECK_EQ(CaptureConfigDecode(msg, sizeof(msg), &seq, &cfg), CAPTURE_CONFIG_OK);
+    CHECK_EQ(seq, 7);
+    CHECK_EQ(cfg.channelMask, CAPTURE_CH_X | CAPTURE_CH_Z);
+    CHECK_EQ(cfg.triggerMode, CAPTURE_TRIGGER_ABOVE);
+    CHECK_EQ(cfg.triggerChannel, 1);
+    CHECK_EQ(cfg.decoder, CAPTURE_DECODER_RAW);
+    CHECK_EQ(cfg.sampleRateHz, 208);
+    CHECK_EQ(cfg.triggerLevel, -2);
+    CHECK_EQ(cfg.filterCount, 2);
+    CHECK_EQ(cfg.filterId[0], 0x0123);
+    CHECK_EQ(cfg.filterId[1], 0x4567);
+}
+
+static void TestDecodeRejects(void)
+{
+    uint8_t msg[CAPTURE_CONFIG_MAX_SIZE + 1];
+    struct CaptureConfig cfg;
+    uint8_t seq = 0;
+
+    CaptureConfigGetDefaults(&cfg);
+    CHECK_EQ(CaptureConfigEncode(&cfg, 9, msg, sizeof(msg)), CAPTURE_CONFIG_HEADER_SIZE);
+
+    CHECK_EQ(CaptureConfigDecode(msg, 0, &seq, &cfg), CAPTURE_CONFIG_BAD_VERSION);
+    CHECK_EQ(seq, 0);
+    msg[0] = 2;
+    CHECK_EQ(CaptureConfigDecode(msg, CAPTURE_CONFIG_HEADER_SIZE, &seq, &cfg), CAPTURE_CONFIG_BAD_VERSION);
+    CHECK_EQ(seq, 9);  // The ack of a rejected message still carries its sequence number
+    msg[0] = CAPTURE_CONFIG_VERSION;
+
+    CHECK_EQ(CaptureConfigDecode(msg, CAPTURE_CONFIG_HEADER_SIZE - 1, &seq, &cfg), CAPTURE_CONFIG_BAD_LENGTH);
+    CHECK_EQ(CaptureConfigDecode(msg, CAPTURE_CONFIG_HEADER_SIZE + 1, &seq, &cfg), CAPTURE_CONFIG_BAD_LENGTH);
+    msg[10] = 1;  // One filter announced, none carried
+    CHECK_EQ(CaptureConfigDecode(msg, CAPTURE_CONFIG_HEADER_SIZE, &seq, &cfg), CAPTURE_CONFIG_BAD_LENGTH);
+    msg[10] = CAPTURE_CONFIG_MAX_FILTERS + 1;
+    CHECK_EQ(CaptureConfigDecode(msg, CAPTURE_CONFIG_MAX_SIZE + 2, &seq, &cfg), CAPTURE_CONFIG_BAD_LENGTH);
+    msg[10] = 0;
+
+    const struct {
+        uint8_t index;
+        uint8_t value;
+    } bad[] = {
+        {2, 0x08},                     // Unknown channel bit
+        {3, CAPTURE_TRIGGER_COUNT},    // Unknown trigger
+        {4, 3},                        // Trigger channel past Z
+        {5, CAPTURE_DECODER_COUNT},    // Unknown decoder
+    };
+    for (size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); i++) {
+        uint8_t copy[CAPTURE_CONFIG_HEADER_SIZE];
+        memcpy(copy, msg, sizeof(copy));
+        copy[bad[i].index] = bad[i].value;
+        CHECK_EQ(CaptureConfigDecode(copy, sizeof(copy), &seq, &cfg), CAPTURE_CONFIG_BAD_VALUE);
+    }
+    msg[6] = 0;
+    msg[7] = 0;  // 0 Hz
+    CHECK_EQ(CaptureConfigDecode(msg, CAPTURE_CONFIG_HEADER_SIZE, &seq, &cfg), CAPTURE_CONFIG_BAD_VALUE);
+}
+
+static void TestRoundTrip(void)
+{
+    uint32_t rng = 0x1234567u;
+
+    for (int round = 0; round < 10000; round++) {
+        struct CaptureConfig in, out;
+        uint8_t msg[CAPTURE_CONFIG_MAX_SIZE];
+        uint8_t seq = 0;
+        uint16_t len;
+
+        memset(&in, 0, sizeof(in));
+        in.channelMask = HostTestRandom(&rng) & CAPTURE_CH_ALL;
+        in.triggerMode = HostTestRandom(&rng) % CAPTURE_TRIGGER_COUNT;
+        in.triggerChannel = HostTestRandom(&rng) % 3;
+        in.decoder = HostTestRandom(&rng) % CAPTURE_DECODER_COUNT;
+        in.sampleRateHz = 1 + HostTestRandom(&rng) % 0xFFFF;
+        in.triggerLevel = (int16_t)HostTestRandom(&rng);
+        in.filterCount = HostTestRandom(&rng) % (CAPTURE_CONFIG_MAX_FILTERS + 1);
+        for (uint8_t i = 0; i < in.filterCount; i++) {
+            in.filterId[i] = (uint16_t)HostTestRandom(&rng);
+        }
+
+        len = CaptureConfigEncode(&in, (uint8_t)round, msg, sizeof(msg));
+        CHECK_EQ(len, CAPTURE_CONFIG_HEADER_SIZE + 2 * in.filterCount);
+        CHECK_EQ(CaptureConfigEncode(&in, 0, msg, len - 1), 0);  // Too small a buffer writes nothing
+
+        memset(&out, 0, sizeof(out));
+        CHECK_EQ(CaptureConfigDecode(msg, len, &seq, &out), CAPTURE_CONFIG_OK);
+        CHECK_EQ(seq, (uint8_t)round);
+        CHECK(memcmp(&in, &out, sizeof(in)) == 0);
+    }
+}
+
+static void TestHandshake(void)
+{
+    struct CaptureConfig cfg, taken, active;
+    uint8_t ack[CAPTURE_CONFIG_ACK_MAX_SIZE];
+    uint8_t seq = 0;
+
+    CHECK_EQ(CaptureConfigTakeAck(ack, sizeof(ack)), 0);
+    CHECK(!CaptureConfigTakePending(&taken, &seq));
+
+    // A newer message replaces one that was not picked up; only the newer one is applied and acknowledged
+    CaptureConfigGetDefaults(&cfg);
+    cfg.sampleRateHz = 52;
+    CaptureConfigSubmit(&cfg, 1);
+    cfg.sampleRateHz = 416;
+    cfg.filterCount = 1;
+    cfg.filterId[0] = 0x0042;
+    CaptureConfigSubmit(&cfg, 2);
+    CHECK(CaptureConfigTakePending(&taken, &seq));
+    CHECK_EQ(seq, 2);
+    CHECK_EQ(taken.sampleRateHz, 416);
+    CHECK(!CaptureConfigTakePending(&taken, &seq));
+
+    taken.sampleRateHz = 104;  // The front end rounds the rate
+    CaptureConfigApplied(&taken, seq);
+    CaptureConfigGetActive(&active);
+    CHECK_EQ(active.sampleRateHz, 104);
+
+    CHECK_EQ(CaptureConfigTakeAck(ack, sizeof(ack)), 1 + CAPTURE_CONFIG_HEADER_SIZE + 2);
+    CHECK_EQ(ack[0], CAPTURE_CONFIG_OK);
+    CHECK_EQ(CaptureConfigDecode(&ack[1], CAPTURE_CONFIG_HEADER_SIZE + 2, &seq, &cfg), CAPTURE_CONFIG_OK);
+    CHECK_EQ(seq, 2);
+    CHECK_EQ(cfg.sampleRateHz, 104);
+    CHECK_EQ(cfg.filterId[0], 0x0042);
+    CHECK_EQ(CaptureConfigTakeAck(ack, sizeof(ack)), 0);  // Each ack is sent once
+
+    // A rejection acknowledges with the configuration still in use
+    CaptureConfigReject(3, CAPTURE_CONFIG_BAD_VALUE);
+    CHECK_EQ(CaptureConfigTakeAck(ack, sizeof(ack)), 1 + CAPTURE_CONFIG_HEADER_SIZE + 2);
+    CHECK_EQ(ack[0], CAPTURE_CONFIG_BAD_VALUE);
+    CHECK_EQ(ack[2], 3);
+    CHECK_EQ(ack[1 + 6], 104);
+}
+
+int main(void)
+{
+    RUN_TEST(TestDecodeMessage);
+    RUN_TEST(TestDecodeRejects);
+    RUN_TEST(TestRoundTrip);
+    RUN_TEST(TestHandshake);
+    return HOST_TEST_RESULT();
+}
@@ -0,0 +1,367 @@
+/**************************************************************************/ /**
+ * @file      TestCaptureExport.c
+ * @brief     Tests of capture_export on synthetic segments whose samples and bus events are known: the VCD and
+ *            sigrok files against them, the same bytes at any thread count, a device clock that wraps, dropped
+ *            event records and files that are not segments.
+ * @date      2026-10-19
+
+ ******************************************************************************/
+
+#define _GNU_SOURCE  // memmem
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "CaptureExport.h"
+#include "HostTest.h"
+#include "SegmentSynth.h"
+#include "crc32.h"
+
+#define TEST_PERIOD_US 9615  ///< 104 Hz
+
+/// A bus event as the synthetic source made it
+struct TruthEvent {
+    uint64_t start;
+    uint8_t event[16];
+    bool dropped;
+};
+
+struct Truth {
+    struct TruthEvent *item;
+    size_t count;
+    size_t size;
+};
+
+static char testDir[64];
+
+static void OnEvent(void *ctx, uint64_t startUs, const uint8_t *event, bool dropped)
+{
+    struct Truth *truth = ctx;
+    if (truth->count == truth->size) {
+        truth->size = truth->size ? 2 * truth->size : 1024;
+        truth->item = realloc(truth->item, truth->size * sizeof(truth->item[0]));
+    }
+    truth->item[truth->count].start = startUs;
+    memcpy(truth->item[truth->count].event, event, 16);
+    truth->item[truth->count++].dropped = dropped;
+}
+
+static uint32_t Le32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static int CompareStart(const void *a, const void *b)
+{
+    const struct TruthEvent *x = a, *y = b;
+    return (x->start > y->start) - (x->start < y->start);
+}
+
+/// Synthesizes a capture of 3 MB in 1 MB segments, which are 4 chunks each, starting a minute before the device
+/// clock wraps
+static void Synth(struct SegmentSynthConfig *config, struct SegmentSynthStats *stats, struct Truth *truth)
+{
+    char cmd[128];
+
+    snprintf(cmd, sizeof(cmd), "rm -f %s/*.cap", testDir);
+    CHECK_EQ(system(cmd), 0);
+    *config = (struct SegmentSynthConfig){testDir, 3u * ((1u << 20) - 512), 1u << 20, CAPTURE_SYNTH_SINE, 7,
+                                          0xFFFFFFFFu - 60000000u, TEST_PERIOD_US, 6, 50};
+    memset(truth, 0, sizeof(*truth));
+    CHECK_EQ(SegmentSynthWrite(config, OnEvent, truth, stats), 0);
+    // Events come in the order they were polled, their starts are jittered
+    qsort(truth->item, truth->count, sizeof(truth->item[0]), CompareStart);
+}
+
+/// Exports the segments of the test directory and reads the file back
+static char *Export(enum CaptureExportFormat format, unsigned threads, size_t *len, struct CaptureExportStats *stats)
+{
+    struct CaptureExportOptions options = {NULL, 0, format, tmpfile(), threads, 0};
+    char **paths, *data;
+
+    CHECK_EQ(CaptureExportListDir(testDir, &paths, &options.count), 0);
+    options.paths = (const char *const *)paths;
+    CHECK_EQ(CaptureExportRun(&options, stats), 0);
+    *len = (size_t)ftell(options.out);
+    CHECK_EQ(stats->outBytes, *len);
+    data = malloc(*len + 1);
+    rewind(options.out);
+    CHECK(data != NULL && fread(data, 1, *len, options.out) == *len);
+    data[*len] = '\0';
+    fclose(options.out);
+    for (unsigned i = 0; i < options.count; i++) {
+        free(paths[i]);
+    }
+    free(paths);
+    return data;
+}
+
+/// Changes of one VCD signal with repeats of the same value taken out
+struct Changes {
+    uint64_t *t;
+    uint32_t *value;
+    size_t count;
+    size_t size;
+};
+
+static void ChangesAdd(struct Changes *changes, uint64_t t, uint32_t value)
+{
+    if (changes->count > 0 && changes->value[changes->count - 1] == value) {
+        return;
+    }
+    if (changes->count == changes->size) {
+        changes->size = changes->size ? 2 * changes->size : 1024;
+        changes->t = realloc(changes->t, changes->size * sizeof(uint64_t));
+        changes->value = realloc(changes->value, changes->size * sizeof(uint32_t));
+    }
+    changes->t[changes->count] = t;
+    changes->value[changes->count++] = value;
+}
+
+static void ChangesFree(struct Changes *changes)
+{
+    free(changes->t);
+    free(changes->value);
+}
+
+/// Checks the samples and bus transactions of a VCD file against what the synthetic source made
+static void CheckVcd(const char *vcd, size_t len, const struct SegmentSynthConfig *config,
+                     const struct SegmentSynthStats *synth, const struct Truth *truth)
+{
+    struct Changes x = {0}, expected = {0};
+    const char *p = strstr(vcd, "$enddefinitions $end\n"), *end = vcd + len;
+    uint64_t t = 0, lastT = 0, rises = 0, matched = 0;
+    uint32_t addr = 0, reg = 0, status = 0;
+    bool busy = false, rose = false, ordered = true;
+    size_t e = 0;
+
+    CHECK(strstr(vcd, "$timescale 1us $end") != NULL);
+    CHECK(strstr(vcd, "$var integer 16 x x $end") != NULL);
+    CHECK(p != NULL);
+    if (p == NULL) {
+        return;
+    }
+    p += strlen("$enddefinitions $end\n");
+
+    // A rising busy is checked against the event with that start once all changes of its time are read
+    for (;;) {
+        bool line = (p < end);
+        if (!line || *p == '#') {
+            if (rose) {
+                rises++;
+                while (e < truth->count && truth->item[e].start < t) {
+                    e++;
+                }
+                for (size_t k = e; k < truth->count && truth->item[k].start == t; k++) {
+                    const uint8_t *ev = truth->item[k].event;
+                    if (!truth->item[k].dropped && addr == (uint32_t)(ev[0] | (ev[1] << 8)) &&
+                        reg == (uint32_t)(ev[2] | (ev[3] << 8)) && status == Le32(ev + 4)) {
+                        matched++;
+                        break;
+                    }
+                }
+                rose = false;
+            }
+            if (!line) {
+                break;
+            }
+            t = strtoull(p + 1, NULL, 10);
+            ordered &= (t >= lastT);
+            lastT = t;
+        } else {
+            uint32_t value = 0;
+            const char *v = p;
+            if (*v == 'b') {
+                for (v++; *v == '0' || *v == '1'; v++) {
+                    value = (value << 1) | (uint32_t)(*v - '0');
+                }
+                v++;
+            } else {
+                value = (uint32_t)(*v++ - '0');
+            }
+            switch (*v) {
+                case 'x':
+                    ChangesAdd(&x, t, value);
+                    break;
+                case 'b':
+                    rose |= (value && !busy);
+                    busy = value;
+                    break;
+                case 'a':
+                    addr = value;
+                    break;
+                case 'r':
+                    reg = value;
+                    break;
+                case 's':
+                    status = value;
+                    break;
+                default:
+                    break;
+            }
+        }
+        p = memchr(p, '\n', (size_t)(end - p));
+        p = (p == NULL) ? end : p + 1;
+    }
+
+    CHECK(ordered);
+    for (uint64_t i = 0; i < synth->samples; i++) {
+        ChangesAdd(&expected, SegmentSynthSampleUs(config, i), (uint16_t)CaptureSynthSample(config->pattern, config->seed, (uint32_t)i, 0));
+    }
+    CHECK_EQ(x.count, expected.count);
+    CHECK(x.count == expected.count && memcmp(x.t, expected.t, x.count * sizeof(uint64_t)) == 0);
+    CHECK(x.count == expected.count && memcmp(x.value, expected.value, x.count * sizeof(uint32_t)) == 0);
+    CHECK(x.count > 0 && x.t[x.count - 1] > 0xFFFFFFFFull);
+    // Busy does not rise for an event that starts while the one before is still busy
+    CHECK(rises > synth->events / 2);
+    CHECK_EQ(matched, rises);
+    ChangesFree(&x);
+    ChangesFree(&expected);
+}
+
+/// Reads the analog-1-3-N entries of a stored zip in order and checks them against the x samples
+static void CheckSr(const uint8_t *zip, size_t len, const struct SegmentSynthConfig *config,
+                    const struct SegmentSynthStats *synth)
+{
+    size_t pos = 0;
+    uint64_t samples = 0, wrong = 0, logic = 0;
+    unsigned next = 1, entries = 0, badCrc = 0;
+    bool metadata = false;
+
+    while (pos + 30 <= len && Le32(zip + pos) == 0x04034B50u) {
+        uint32_t size = Le32(zip + pos + 18);
+        uint16_t nameLen = (uint16_t)(zip[pos + 26] | (zip[pos + 27] << 8));
+        uint16_t extraLen = (uint16_t)(zip[pos + 28] | (zip[pos + 29] << 8));
+        char name[32];
+        const uint8_t *data = zip + pos + 30 + nameLen + extraLen;
+
+        snprintf(name, sizeof(name), "%.*s", (int)nameLen, (const char *)zip + pos + 30);
+        CHECK_EQ(Le32(zip + pos + 8), 0);  // Stored
+        crc32_t crc = 0;
+        crc32_calculate(data, size, &crc);
+        badCrc += (Le32(zip + pos + 14) != crc);
+        if (entries++ == 0) {
+            CHECK(strcmp(name, "version") == 0 && size == 1 && data[0] == '2');
+        }
+        char expectedName[32];
+        snprintf(expectedName, sizeof(expectedName), "analog-1-3-%u", next);
+        if (strcmp(name, expectedName) == 0) {
+            for (uint32_t i = 0; i < size / 4; i++) {
+                float v;
+                memcpy(&v, data + 4 * i, 4);
+                wrong += (v != (float)CaptureSynthSample(config->pattern, config->seed, (uint32_t)(samples + i), 0));
+            }
+            samples += size / 4;
+            next++;
+        }
+        if (strncmp(name, "logic-1-", 8) == 0) {
+            for (uint32_t i = 0; i < size; i++) {
+                logic += (data[i] & 1);
+            }
+        }
+        if (strcmp(name, "metadata") == 0) {
+            metadata = memmem(data, size, "samplerate=104 Hz\n", 18) != NULL && memmem(data, size, "probe1=i2c_busy\n", 16) != NULL;
+        }
+        pos += 30 + nameLen + extraLen + size;
+    }
+    CHECK_EQ(samples, synth->samples);
+    CHECK_EQ(wrong, 0);
+    CHECK_EQ(badCrc, 0);
+    CHECK(logic > 0);
+    CHECK(metadata);
+    // The central directory and its end follow the entries
+    CHECK(pos + 22 <= len && Le32(zip + pos) == 0x02014B50u);
+    CHECK(Le32(zip + len - 22) == 0x06054B50u);
+}
+
+/// The same files at 1, 3 and 8 threads, and both match the synthetic source
+static void TestExportMatchesSource(void)
+{
+    struct SegmentSynthConfig config;
+    struct SegmentSynthStats synth;
+    struct CaptureExportStats stats;
+    struct Truth truth;
+    static const unsigned threads[] = {1, 3, 8};
+
+    Synth(&config, &synth, &truth);
+    CHECK_EQ(synth.segments, 3);
+    CHECK(synth.dropped > 0);
+
+    for (int f = 0; f < 2; f++) {
+        enum CaptureExportFormat format = f ? CAPTURE_EXPORT_SR : CAPTURE_EXPORT_VCD;
+        size_t firstLen = 0;
+        char *first = NULL;
+        for (unsigned i = 0; i < sizeof(threads) / sizeof(threads[0]); i++) {
+            size_t len;
+            char *data = Export(format, threads[i], &len, &stats);
+            CHECK_EQ(stats.segments, 3);
+            CHECK_EQ(stats.skipped, 0);
+            CHECK_EQ(stats.restarts, 0);
+            CHECK_EQ(stats.samples, synth.samples);
+            CHECK_EQ(stats.events + stats.lostEvents, synth.events);
+            CHECK(stats.lostEvents > 0);
+            CHECK_EQ(stats.malformed, 0);
+            CHECK_EQ(stats.late, 0);
+            if (first == NULL) {
+                first = data;
+                firstLen = len;
+                if (format == CAPTURE_EXPORT_VCD) {
+                    CheckVcd(data, len, &config, &synth, &truth);
+                } else {
+                    CheckSr((const uint8_t *)data, len, &config, &synth);
+                }
+            } else {
+                CHECK(len == firstLen && memcmp(data, first, len) == 0);
+                free(data);
+            }
+        }
+        free(first);
+    }
+    free(truth.item);
+}
+
+/// A file that is not a segment is skipped, a segment copied off short is read as far as it goes
+static void TestExportSkipsBadFiles(void)
+{
+    struct SegmentSynthConfig config;
+    struct SegmentSynthStats synth;
+    struct CaptureExportStats stats;
+    struct Truth truth;
+    char path[128], junk[4096];
+    size_t len;
+
+    Synth(&config, &synth, &truth);
+    memset(junk, 0x5A, sizeof(junk));
+    snprintf(path, sizeof(path), "%s/notes.cap", testDir);
+    FILE *fp = fopen(path, "wb");
+    CHECK(fp != NULL && fwrite(junk, sizeof(junk), 1, fp) == 1);
+    fclose(fp);
+    snprintf(path, sizeof(path), "%s/seg%02u.cap", testDir, (unsigned)(config.seed % synth.segments));
+    CHECK_EQ(truncate(path, 256 * 1024), 0);
+
+    free(Export(CAPTURE_EXPORT_VCD, 4, &len, &stats));
+    CHECK_EQ(stats.skipped, 1);
+    CHECK_EQ(stats.segments, 3);
+    CHECK(stats.samples < synth.samples && stats.samples > synth.samples / 2);
+    CHECK_EQ(stats.malformed, 0);
+    remove(path);
+    snprintf(path, sizeof(path), "%s/notes.cap", testDir);
+    remove(path);
+    free(truth.item);
+}
+
+int main(void)
+{
+    snprintf(testDir, sizeof(testDir), "/tmp/capture_export_XXXXXX");
+    if (mkdtemp(testDir) == NULL) {
+        return EXIT_FAILURE;
+    }
+    RUN_TEST(TestExportMatchesSource);
+    RUN_TEST(TestExportSkipsBadFiles);
+
+    char cmd[128];
+    snprintf(cmd, sizeof(cmd), "rm -rf %s", testDir);
+    CHECK_EQ(system(cmd), 0);
+    return HOST_TEST_RESULT();
+}
@@ -0,0 +1,196 @@
+/**************************************************************************/ /**
+ * @file      TestCaptureFile.c
+ * @brief     Host tests of the capture file reader on a FAT image: seeks through fragmented files land on the right
+ *            data, maps are only built for large files that are seeked, the pool runs out gracefully, and reading
+ *            never writes to the volume.
+ * @date      2026-10-19
+
+ ******************************************************************************/
+
+#include <string.h>
+#include <strings.h>
+
+#include "CaptureFile/CaptureFile.h"
+#include "HostDisk.h"
+#include "HostTest.h"
+#include "asf.h"
+#include "task.h"
+
+#define CLUSTER 512  ///< One sector per cluster, so a few KB make a large file
+
+TickType_t hostTickCount;
+
+static FATFS fs;
+
+/// Byte of a test file at an offset, different for every file
+static uint8_t Pattern(uint8_t file, uint32_t offset)
+{
+    return (uint8_t)(offset * 7 + (offset >> 9) + file * 31);
+}
+
+/// Writes files of the given sizes CLUSTER bytes at a time in turn, so each one ends up in fragments of
+/// `chunk` clusters interleaved with the others
+static void WriteInterleaved(const char *const *paths, const uint32_t *sizes, uint8_t count, uint32_t chunk)
+{
+    FIL files[4];
+    uint8_t buf[CLUSTER];
+    uint32_t done[4] = {0};
+    bool busy = true;
+    UINT written;
+
+    for (uint8_t f = 0; f < count; f++) {
+        CHECK_EQ(f_open(&files[f], paths[f], FA_CREATE_ALWAYS | FA_WRITE), FR_OK);
+    }
+    while (busy) {
+        busy = false;
+        for (uint8_t f = 0; f < count; f++) {
+            for (uint32_t c = 0; c < chunk && done[f] < sizes[f]; c++) {
+                uint32_t n = (sizes[f] - done[f] < CLUSTER) ? sizes[f] - done[f] : CLUSTER;
+                for (uint32_t i = 0; i < n; i++) {
+                    buf[i] = Pattern(f, done[f] + i);
+                }
+                CHECK_EQ(f_write(&files[f], buf, n, &written), FR_OK);
+                done[f] += n;
+            }
+            busy |= (done[f] < sizes[f]);
+        }
+    }
+    for (uint8_t f = 0; f < count; f++) {
+        CHECK_EQ(f_close(&files[f]), FR_OK);
+    }
+}
+
+/// Seeks to random offsets and checks the data found there
+static void CheckSeeks(FIL *fp, uint8_t file, uint32_t size, uint32_t seed)
+{
+    uint8_t buf[64];
+    UINT count;
+
+    for (int n = 0; n < 200; n++) {
+        uint32_t offset = HostTestRandom(&seed) % size;
+        CHECK_EQ(CaptureFileSeek(fp, offset), FR_OK);
+        CHECK_EQ(f_tell(fp), offset);
+        CHECK_EQ(f_read(fp, buf, sizeof(buf), &count), FR_OK);
+        CHECK_EQ(count, (size - offset < sizeof(buf)) ? size - offset : sizeof(buf));
+        for (UINT i = 0; i < count; i++) {
+            if (buf[i] != Pattern(file, offset + i)) {
+                CHECK_EQ(buf[i], Pattern(file, offset + i));
+                return;
+            }
+        }
+    }
+}
+
+static void TestFragmentedSeeks(void)
+{
+    const char *paths[] = {"0:a.bin", "0:b.bin"};
+    const uint32_t sizes[] = {40 * CLUSTER + 100, 60 * CLUSTER};
+    FIL fp;
+
+    // Four clusters per fragment: a.bin has 11 fragments, which just fits a map
+    WriteInterleaved(paths, sizes, 2, 4);
+
+    CHECK_EQ(CaptureFileOpen(&fp, paths[0]), FR_OK);
+    CHECK(fp.cltbl == NULL);  // No map until the first seek
+    CheckSeeks(&fp, 0, sizes[0], 1);
+    CHECK(fp.cltbl != NULL);
+    CHECK_EQ(fp.cltbl[0], 2 * 11 + 2);
+    CHECK_EQ(CaptureFileClose(&fp), FR_OK);
+
+    // Three clusters per fragment: too many fragments for a map, seeks walk the chain
+    const char *paths2[] = {"0:c.bin", "0:d.bin"};
+    WriteInterleaved(paths2, sizes, 2, 3);
+    CHECK_EQ(CaptureFileOpen(&fp, paths2[0]), FR_OK);
+    CheckSeeks(&fp, 0, sizes[0], 2);
+    CHECK(fp.cltbl == NULL);
+    CHECK_EQ(CaptureFileClose(&fp), FR_OK);
+}
+
+static void TestSmallAndSequential(void)
+{
+    const char *paths[] = {"0:small.bin", "0:seq.bin"};
+    const uint32_t sizes[] = {(CAPTURE_FILE_MIN_CLUSTERS - 1) * CLUSTER, 20 * CLUSTER};
+    uint8_t buf[CLUSTER];
+    UINT count;
+    FIL fp;
+
+    WriteInterleaved(paths, sizes, 2, 1);
+    CHECK_EQ(CaptureFileOpen(&fp, paths[0]), FR_OK);
+    CheckSeeks(&fp, 0, sizes[0], 3);
+    CHECK(fp.cltbl == NULL);
+    CHECK_EQ(CaptureFileClose(&fp), FR_OK);
+
+    // Reading from the start, and a seek to where the pointer already is, build no map
+    CHECK_EQ(CaptureFileOpen(&fp, paths[1]), FR_OK);
+    CHECK_EQ(CaptureFileSeek(&fp, 0), FR_OK);
+    for (uint32_t offset = 0; offset < sizes[1]; offset += count) {
+        CHECK_EQ(f_read(&fp, buf, sizeof(buf), &count), FR_OK);
+        CHECK_EQ(count, sizeof(buf));
+        CHECK_EQ(buf[5], Pattern(1, offset + 5));
+    }
+    CHECK(fp.cltbl == NULL);
+    CHECK_EQ(CaptureFileClose(&fp), FR_OK);
+}
+
+static void TestPoolExhausted(void)
+{
+    const char *paths[] = {"0:p0.bin", "0:p1.bin", "0:p2.bin", "0:p3.bin"};
+    const uint32_t sizes[] = {12 * CLUSTER, 13 * CLUSTER, 14 * CLUSTER, 15 * CLUSTER};
+    FIL fp[4];
+
+    WriteInterleaved(paths, sizes, 4, 5);
+    for (uint8_t f = 0; f < 4; f++) {
+        CHECK_EQ(CaptureFileOpen(&fp[f], paths[f]), FR_OK);
+        CheckSeeks(&fp[f], f, sizes[f], 10 + f);
+        CHECK((fp[f].cltbl != NULL) == (f < CAPTURE_FILE_MAPS));
+    }
+    // A closed file returns its map, which the next file to seek gets
+    CHECK_EQ(CaptureFileClose(&fp[0]), FR_OK);
+    CHECK_EQ(CaptureFileClose(&fp[3]), FR_OK);
+    CHECK_EQ(CaptureFileOpen(&fp[3], paths[3]), FR_OK);
+    CheckSeeks(&fp[3], 3, sizes[3], 20);
+    CHECK(fp[3].cltbl != NULL);
+    for (uint8_t f = 1; f < 4; f++) {
+        CHECK_EQ(CaptureFileClose(&fp[f]), FR_OK);
+    }
+}
+
+static void TestReadOnly(void)
+{
+    struct HostDiskStats before, after;
+    FILINFO info;
+    DIR dir;
+    FIL fp;
+    int entries = 0;
+
+    HostDiskGetStats(&before);
+    for (int round = 0; round < 3; round++) {
+        CHECK_EQ(CaptureFileOpen(&fp, "0:a.bin"), FR_OK);
+        CheckSeeks(&fp, 0, 40 * CLUSTER + 100, 30 + round);
+        CHECK_EQ(CaptureFileClose(&fp), FR_OK);
+    }
+    HostDiskGetStats(&after);
+    CHECK_EQ(after.writes, before.writes);
+
+    // Only the files written by the tests are on the volume
+    info.lfname = NULL;
+    info.lfsize = 0;
+    CHECK_EQ(f_opendir(&dir, "0:"), FR_OK);
+    while (f_readdir(&dir, &info) == FR_OK && info.fname[0] != '\0') {
+        size_t len = strlen(info.fname);
+        CHECK(len > 4 && strcasecmp(&info.fname[len - 4], ".bin") == 0);
+        entries++;
+    }
+    CHECK_EQ(entries, 10);
+}
+
+int main(void)
+{
+    CHECK_EQ(HostDiskOpen(&fs, NULL, 8192, 1), FR_OK);
+    RUN_TEST(TestFragmentedSeeks);
+    RUN_TEST(TestSmallAndSequential);
+    RUN_TEST(TestPoolExhausted);
+    RUN_TEST(TestReadOnly);
+    HostDiskClose(&fs);
+    return HOST_TEST_RESULT();
+}
@@ -0,0 +1,183 @@
+/**************************************************************************/ /**
+ * @file      TestDeviceId.c
+ * @brief     Host tests of the boot counter: the page plan for hand-made row states, counts through a fake NVM over
+ *            many boots, boots cut by a power loss part way through the row erase or the page write, and the erase
+ *            wear per boot.
+ * @date      2026-10-19
+
+ ******************************************************************************/
+
+#include <string.h>
+
+#include "DeviceId/DeviceId.h"
+#include "HostTest.h"
+#include "asf.h"
+
+static uint8_t flash[DEVICE_ID_BOOT_ROWS * NVMCTRL_ROW_SIZE];  ///< The boot counter rows
+static int32_t writeBudget = -1;  ///< Bytes written before the fake power loss, -1 for no loss
+static bool eraseTorn = false;    ///< The next erase loses power, leaving random bits of the row unerased
+static uint32_t rowErases[DEVICE_ID_BOOT_ROWS];
+static uint32_t tornErases;
+static uint32_t randomState = 0x2545F491u;
+
+void nvm_get_config_defaults(struct nvm_config *const config)
+{
+    config->manual_page_write = true;
+}
+
+enum status_code nvm_set_config(const struct nvm_config *const config)
+{
+    CHECK(!config->manual_page_write);
+    return STATUS_OK;
+}
+
+enum status_code nvm_erase_row(const uint32_t row_address)
+{
+    uint32_t offset = row_address - DEVICE_ID_BOOT_ADDRESS;
+
+    CHECK(offset < sizeof(flash) && offset % NVMCTRL_ROW_SIZE == 0);
+    rowErases[offset / NVMCTRL_ROW_SIZE]++;
+    for (uint32_t i = 0; i < NVMCTRL_ROW_SIZE; i++) {
+        flash[offset + i] |= eraseTorn ? (uint8_t)HostTestRandom(&randomState) : 0xFF;  // Erasing sets bits to 1
+    }
+    if (eraseTorn) {
+        tornErases++;
+        writeBudget = 0;  // No power left for the page write
+        eraseTorn = false;
+    }
+    return STATUS_OK;
+}
+
+enum status_code nvm_write_buffer(const uint32_t destination_address, const uint8_t *buffer, uint16_t length)
+{
+    uint32_t offset = destination_address - DEVICE_ID_BOOT_ADDRESS;
+
+    CHECK(offset < sizeof(flash) && offset % NVMCTRL_PAGE_SIZE == 0);
+    CHECK(length <= NVMCTRL_PAGE_SIZE);
+    for (uint16_t i = 0; i < length && writeBudget != 0; i++, writeBudget--) {
+        flash[offset + i] &= buffer[i];  // Flash bits only go from 1 to 0
+    }
+    return STATUS_OK;
+}
+
+/// Runs DeviceIdPlanBoot on records and erased flags given per page
+static struct DeviceIdBootPlan Plan(const uint32_t *counts, const uint8_t *erased)
+{
+    struct DeviceIdBootRecord records[DEVICE_ID_BOOT_PAGES];
+    struct DeviceIdBootPlan plan;
+
+    for (int p = 0; p < DEVICE_ID_BOOT_PAGES; p++) {
+        records[p] = (struct DeviceIdBootRecord){counts[p], erased[p] ? 0xFFFFFFFFu : ~counts[p]};
+    }
+    DeviceIdPlanBoot(records, erased, &plan);
+    return plan;
+}
+
+static void TestPlan(void)
+{
+    uint32_t counts[DEVICE_ID_BOOT_PAGES];
+    uint8_t erased[DEVICE_ID_BOOT_PAGES];
+    struct DeviceIdBootPlan plan;
+
+    // A new board starts at 1 on the first page, with nothing to erase
+    memset(counts, 0xFF, sizeof(counts));
+    memset(erased, 1, sizeof(erased));
+    plan = Plan(counts, erased);
+    CHECK_EQ(plan.count, 1);
+    CHECK_EQ(plan.page, 0);
+    CHECK(!plan.erase);
+
+    // The next page of the row, erased
+    counts[0] = 7;
+    erased[0] = 0;
+    plan = Plan(counts, erased);
+    CHECK_EQ(plan.count, 8);
+    CHECK_EQ(plan.page, 1);
+    CHECK(!plan.erase);
+
+    // The last page of a row is followed by the other row, erased first when it holds older counts
+    counts[4] = 3;
+    erased[4] = 0;
+    counts[3] = 10;
+    erased[3] = 0;
+    plan = Plan(counts, erased);
+    CHECK_EQ(plan.count, 11);
+    CHECK_EQ(plan.page, 4);
+    CHECK(plan.erase);
+
+    // And the last page of the second row by the first row
+    memset(counts, 0xFF, sizeof(counts));
+    memset(erased, 1, sizeof(erased));
+    counts[7] = 40;
+    erased[7] = 0;
+    plan = Plan(counts, erased);
+    CHECK_EQ(plan.count, 41);
+    CHECK_EQ(plan.page, 0);
+    CHECK(!plan.erase);
+
+    // A torn page after the latest count is skipped to the other row, never erasing the latest count's row
+    erased[0] = 0;
+    counts[6] = 39;
+    erased[6] = 0;
+    erased[5] = 0;  // Torn, neither erased nor a valid record
+    plan = Plan(counts, erased);
+    CHECK_EQ(plan.page, 0);
+    CHECK(plan.erase);
+    counts[0] = 41;
+    plan = Plan(counts, erased);
+    CHECK_EQ(plan.count, 42);
+    CHECK_EQ(plan.page, 1);
+    CHECK(!plan.erase);
+    erased[1] = 0;  // Torn on page 1: go on at page 4
+    plan = Plan(counts, erased);
+    CHECK_EQ(plan.count, 42);
+    CHECK_EQ(plan.page, 4);
+    CHECK(plan.erase);
+}
+
+static void TestCounts(void)
+{
+    memset(flash, 0xFF, sizeof(flash));
+    memset(rowErases, 0, sizeof(rowErases));
+    for (uint32_t boot = 1; boot <= 1000; boot++) {
+        CHECK_EQ(DeviceIdAdvanceBoot(flash), boot);
+    }
+
+    // One erase per row every eight boots, none on the first pass over the erased rows
+    CHECK_EQ(rowErases[0], 124);
+    CHECK_EQ(rowErases[1], 124);
+}
+
+static void TestPowerLoss(void)
+{
+    uint32_t last = 0, lost = 0;
+
+    memset(flash, 0xFF, sizeof(flash));
+    tornErases = 0;
+    for (int boot = 0; boot < 20000; boot++) {
+        uint32_t r = HostTestRandom(&randomState);
+        if (r % 3 == 0) {
+            // Power lost during the page write, or during an erase if this boot erases
+            writeBudget = (int32_t)(r / 3 % sizeof(struct DeviceIdBootRecord));
+            eraseTorn = (r & 0x100) != 0;
+            DeviceIdAdvanceBoot(flash);
+            writeBudget = -1;
+            eraseTorn = false;
+            lost++;
+            continue;
+        }
+        uint32_t count = DeviceIdAdvanceBoot(flash);
+        CHECK(count > last);  // Every boot that ran gets a count no earlier boot had
+        last = count;
+    }
+    CHECK(lost > 5000);
+    CHECK(tornErases > 200);
+}
+
+int main(void)
+{
+    RUN_TEST(TestPlan);
+    RUN_TEST(TestCounts);
+    RUN_TEST(TestPowerLoss);
+    return HOST_TEST_RESULT();
+}
@@ -0,0 +1,224 @@
+/**************************************************************************/ /**
+ * @file      TestEventDedup.c
+ * @brief     Host tests of the bus event dictionary: polled register streams round trip exactly, a receiver that
+ *            loses payloads never decodes a wrong event and picks its slots up again within EVENT_DEDUP_REFRESH events,
+ *            a reset missed by the receiver, the seed a segment starts with, and random payloads.
+ * @date      2026-10-19
+
+ ******************************************************************************/
+
+#include <string.h>
+
+#include "EventDedup/EventDedup.h"
+#include "HostTest.h"
+#include "SerialConsole.h"
+
+#define TEST_EVENTS 200000
+#define TEST_REGISTERS 12  ///< More than EVENT_DEDUP_SLOTS, so slots get replaced
+
+/// A polled register: address, register, period and the low byte of the value that moves
+struct Poll {
+    uint16_t address;
+    uint16_t reg;
+    uint32_t periodUs;
+    uint32_t nextUs;
+};
+
+static struct Poll polls[TEST_REGISTERS];
+
+static void PollsInit(uint32_t *seed, unsigned registers)
+{
+    for (unsigned i = 0; i < registers; i++) {
+        polls[i].address = (uint16_t)(0x40 + i / 3);
+        polls[i].reg = (uint16_t)(i * 7);
+        polls[i].periodUs = 1000 * (5 + HostTestRandom(seed) % 200);
+        polls[i].nextUs = HostTestRandom(seed) % polls[i].periodUs;
+    }
+}
+
+/// Next event of the register due first: jitter on the start, a duration and a status that sometimes change
+static void NextEvent(uint8_t *event, uint32_t *seed, unsigned registers)
+{
+    unsigned p = 0;
+
+    for (unsigned i = 1; i < registers; i++) {
+        p = (polls[i].nextUs < polls[p].nextUs) ? i : p;
+    }
+    uint32_t r = HostTestRandom(seed);
+    uint32_t start = polls[p].nextUs + r % 40;
+    uint32_t fields[3] = {(r >> 8) % 64 == 0 ? 0xFFFFFFFFu : 0, start, 180 + (r >> 16) % 24};
+
+    event[0] = (uint8_t)polls[p].address;
+    event[1] = (uint8_t)(polls[p].address >> 8);
+    event[2] = (uint8_t)polls[p].reg;
+    event[3] = (uint8_t)(polls[p].reg >> 8);
+    for (uint8_t i = 0; i < 12; i++) {
+        event[4 + i] = (uint8_t)(fields[i / 4] >> (8 * (i % 4)));
+    }
+    polls[p].nextUs += polls[p].periodUs;
+}
+
+/// As many registers as slots, then more so that slots are replaced all the time
+static void TestRoundTrip(void)
+{
+    static struct EventDedupDictionary enc, dec;
+    uint8_t event[EVENT_DEDUP_EVENT_SIZE], packed[EVENT_DEDUP_MAX_SIZE], out[EVENT_DEDUP_EVENT_SIZE];
+    uint32_t seed = 1;
+    uint8_t type;
+
+    for (unsigned registers = EVENT_DEDUP_SLOTS; registers <= TEST_REGISTERS; registers += TEST_REGISTERS - EVENT_DEDUP_SLOTS) {
+        uint32_t bytes = 0, repeats = 0, wrong = 0;
+
+        EventDedupInit(&enc);
+        EventDedupInit(&dec);
+        PollsInit(&seed, registers);
+        for (uint32_t n = 0; n < TEST_EVENTS; n++) {
+            NextEvent(event, &seed, registers);
+            uint8_t len = EventDedupEncode(&enc, event, packed, &type);
+            CHECK(len <= EVENT_DEDUP_MAX_SIZE);
+            bytes += len;
+            repeats += (type == SERIAL_STREAM_EVENT_REPEAT);
+            wrong += (EventDedupDecode(&dec, type, packed, len, out) != EVENT_DEDUP_EVENT_SIZE || memcmp(out, event, sizeof(out)) != 0);
+        }
+        CHECK_EQ(wrong, 0);
+        if (registers <= EVENT_DEDUP_SLOTS) {
+            CHECK(repeats > TEST_EVENTS / 2);
+            CHECK(bytes < TEST_EVENTS * EVENT_DEDUP_EVENT_SIZE / 2);
+        }
+    }
+}
+
+/// Payloads are lost at random, one at a time and in bursts like a lost datagram
+static void TestLoss(void)
+{
+    static struct EventDedupDictionary enc, dec;
+    uint8_t event[EVENT_DEDUP_EVENT_SIZE], packed[EVENT_DEDUP_MAX_SIZE], out[EVENT_DEDUP_EVENT_SIZE];
+    uint32_t seed = 2, decoded = 0, lost = 0, dropped = 0, wrong = 0, burst = 0;
+    uint32_t sinceLoss[TEST_REGISTERS] = {0};
+    uint8_t type;
+
+    EventDedupInit(&enc);
+    EventDedupInit(&dec);
+    PollsInit(&seed, 6);
+    for (uint32_t n = 0; n < TEST_EVENTS; n++) {
+        NextEvent(event, &seed, 6);
+        uint8_t len = EventDedupEncode(&enc, event, packed, &type);
+        unsigned reg = (event[2] / 7) % TEST_REGISTERS;
+        uint32_t r = HostTestRandom(&seed);
+        if (burst == 0 && r % 2000 == 0) {
+            burst = 1 + (r >> 8) % 40;
+        }
+        if (burst > 0) {
+            burst--;
+            dropped++;
+            sinceLoss[reg] = 0;
+            continue;
+        }
+        int8_t res = EventDedupDecode(&dec, type, packed, len, out);
+        if (res == EVENT_DEDUP_EVENT_SIZE) {
+            decoded++;
+            wrong += (memcmp(out, event, sizeof(out)) != 0);
+        } else {
+            CHECK_EQ(res, EVENT_DEDUP_LOST);
+            lost++;
+            // A slot is back by its next template at the latest
+            CHECK(sinceLoss[reg] <= EVENT_DEDUP_REFRESH + 1);
+        }
+        sinceLoss[reg]++;
+    }
+    printf("  %lu dropped, %lu more undecodable until their template, %lu decoded\n", (unsigned long)dropped,
+           (unsigned long)lost, (unsigned long)decoded);
+    CHECK_EQ(wrong, 0);
+    CHECK(decoded > TEST_EVENTS * 9 / 10);
+}
+
+/// The firmware dictionary is reset and the receiver misses the templates sent after it, holding on to older ones
+static void TestMissedReset(void)
+{
+    static struct EventDedupDictionary dec;
+    uint8_t event[EVENT_DEDUP_EVENT_SIZE], packed[EVENT_DEDUP_MAX_SIZE], out[EVENT_DEDUP_EVENT_SIZE];
+    uint32_t seed = 3, wrong = 0, lost = 0;
+    uint8_t type;
+
+    EventDedupInit(&dec);
+    PollsInit(&seed, 4);
+    EventDedupReset();
+    for (uint32_t n = 0; n < 20000; n++) {
+        NextEvent(event, &seed, 4);
+        if (n == 10000) {
+            EventDedupReset();
+        }
+        uint8_t len = EventDedupPack(event, packed, &type);
+        if (n >= 10000 && n < 10100 && type == SERIAL_STREAM_EVENT_TEMPLATE) {
+            continue;
+        }
+        int8_t res = EventDedupDecode(&dec, type, packed, len, out);
+        wrong += (res == EVENT_DEDUP_EVENT_SIZE && memcmp(out, event, sizeof(out)) != 0);
+        lost += (res == EVENT_DEDUP_LOST);
+    }
+    CHECK_EQ(wrong, 0);
+    CHECK(lost > 0);
+}
+
+/// A segment starts on a repeat, which is stored as a seed: a reader without the history decodes the slot from it
+static void TestSeed(void)
+{
+    static struct EventDedupDictionary dec;
+    uint8_t event[EVENT_DEDUP_EVENT_SIZE], packed[EVENT_DEDUP_SEED_SIZE], out[EVENT_DEDUP_EVENT_SIZE];
+    uint32_t seed = 5, wrong = 0, decoded = 0;
+    uint8_t type, seeded = EVENT_DEDUP_SLOTS;
+
+    EventDedupInit(&dec);
+    PollsInit(&seed, 4);
+    EventDedupReset();
+    for (uint32_t n = 0; n < 20000; n++) {
+        NextEvent(event, &seed, 4);
+        uint8_t len = EventDedupPack(event, packed, &type);
+        if (n < 10000) {
+            continue;
+        }
+        uint8_t slot = (type == SERIAL_STREAM_EVENT_TEMPLATE) ? packed[0] : (uint8_t)(packed[0] >> 4);
+        if (seeded == EVENT_DEDUP_SLOTS && type == SERIAL_STREAM_EVENT_REPEAT) {
+            seeded = slot;
+            len = EventDedupSeed(slot, packed);
+            type = SERIAL_STREAM_EVENT_TEMPLATE;
+        }
+        int8_t res = EventDedupDecode(&dec, type, packed, len, out);
+        if (res == EVENT_DEDUP_EVENT_SIZE) {
+            decoded += (slot == seeded);
+            wrong += (memcmp(out, event, sizeof(out)) != 0);
+        }
+    }
+    CHECK_EQ(wrong, 0);
+    CHECK(decoded > 1000);
+}
+
+static void TestMalformed(void)
+{
+    static struct EventDedupDictionary dec;
+    uint8_t packed[EVENT_DEDUP_SEED_SIZE], out[EVENT_DEDUP_EVENT_SIZE + 1];
+    uint32_t seed = 4;
+
+    EventDedupInit(&dec);
+    for (uint32_t n = 0; n < TEST_EVENTS; n++) {
+        uint8_t len = (uint8_t)(HostTestRandom(&seed) % (sizeof(packed) + 1));
+        for (uint8_t i = 0; i < len; i++) {
+            packed[i] = (uint8_t)HostTestRandom(&seed);
+        }
+        out[EVENT_DEDUP_EVENT_SIZE] = 0xE7;
+        int8_t res = EventDedupDecode(&dec, (uint8_t)(SERIAL_STREAM_EVENT_TEMPLATE + n % 2), packed, len, out);
+        CHECK(res == EVENT_DEDUP_EVENT_SIZE || res == EVENT_DEDUP_MALFORMED || res == EVENT_DEDUP_LOST);
+        CHECK_EQ(out[EVENT_DEDUP_EVENT_SIZE], 0xE7);
+    }
+    CHECK_EQ(EventDedupDecode(&dec, SERIAL_STREAM_EVENT, packed, 16, out), EVENT_DEDUP_MALFORMED);
+}
+
+int main(void)
+{
+    RUN_TEST(TestRoundTrip);
+    RUN_TEST(TestLoss);
+    RUN_TEST(TestMissedReset);
+    RUN_TEST(TestSeed);
+    RUN_TEST(TestMalformed);
+    return HOST_TEST_RESULT();
+}
@@ -0,0 +1,303 @@
+/**************************************************************************/ /**
+ * @file      TestFatFsSync.c
+ * @brief     Multi-threaded stress test of the reentrant FatFs on a FAT image file: capture-like writers, upload-like
+ *            readers and a thread creating, listing and deleting small files all run at once. Every file is checked
+ *            afterwards and the free cluster count must match the files on the volume after a remount. Reports the
+ *            aggregate throughput against the same work done one file at a time, and the volume lock contention.
+ * @date      2026-10-19
+
+ ******************************************************************************/
+
+#include <pthread.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "FatFsSync/FatFsSync.h"
+#include "HostDisk.h"
+#include "HostTest.h"
+#include "task.h"
+
+#define WRITERS 2
+#define READERS 2
+#define FILE_SIZE (2u << 20)
+#define CLUSTER_SECTORS 8
+#define SYNC_EVERY (64u << 10)  ///< Writers sync like the capture segments do, about once per 64 KB
+
+TickType_t hostTickCount;
+
+static FATFS fs;
+static int writersRunning;
+
+/// One thread's work and result
+struct Worker {
+    pthread_t thread;
+    unsigned id;
+    uint64_t bytes;   ///< Bytes moved, or operations for the metadata thread
+    unsigned errors;  ///< FatFs errors and bad data
+};
+
+/// Byte of a test file at an offset. Differs between files and between sectors of a file.
+static uint8_t Pattern(unsigned file, uint32_t offset)
+{
+    return (uint8_t)(offset * 13 + (offset >> 9) * 7 + file * 71);
+}
+
+static void *Ticker(void *arg)
+{
+    uint64_t t0 = HostTestNowNs();
+
+    while (__atomic_load_n(&writersRunning, __ATOMIC_RELAXED) >= 0) {
+        __atomic_store_n(&hostTickCount, (TickType_t)((HostTestNowNs() - t0) / 1000000), __ATOMIC_RELAXED);
+        usleep(500);
+    }
+    return NULL;
+}
+
+/// Writes file "w<id>.bin" in 256, 300 and 512 byte pieces like the capture writers
+static void *Writer(void *arg)
+{
+    static const UINT pieces[] = {256, 300, 512};
+    struct Worker *w = arg;
+    uint8_t buf[512];
+    char path[16];
+    uint32_t offset = 0, synced = 0;
+    UINT n, written;
+    FIL fp;
+
+    snprintf(path, sizeof(path), "0:w%u.bin", w->id);
+    w->errors += (f_open(&fp, path, FA_CREATE_ALWAYS | FA_WRITE) != FR_OK);
+    for (unsigned k = 0; offset < FILE_SIZE && w->errors == 0; k++) {
+        n = pieces[k % 3];
+        n = (FILE_SIZE - offset < n) ? FILE_SIZE - offset : n;
+        for (UINT i = 0; i < n; i++) {
+            buf[i] = Pattern(w->id, offset + i);
+        }
+        w->errors += (f_write(&fp, buf, n, &written) != FR_OK || written != n);
+        offset += n;
+        if (offset - synced >= SYNC_EVERY) {
+            w->errors += (f_sync(&fp) != FR_OK);
+            synced = offset;
+        }
+    }
+    w->errors += (f_close(&fp) != FR_OK);
+    w->bytes = offset;
+    __atomic_sub_fetch(&writersRunning, 1, __ATOMIC_RELAXED);
+    return NULL;
+}
+
+/// Checks a whole file in pieces of the given size, returns the bytes read
+static uint64_t ReadAndCheck(const char *path, unsigned file, UINT piece, unsigned *errors)
+{
+    uint8_t buf[1024];
+    uint64_t offset = 0;
+    UINT count;
+    FIL fp;
+
+    if (f_open(&fp, path, FA_READ) != FR_OK) {
+        (*errors)++;
+        return 0;
+    }
+    do {
+        if (f_read(&fp, buf, piece, &count) != FR_OK) {
+            (*errors)++;
+            break;
+        }
+        for (UINT i = 0; i < count; i++) {
+            if (buf[i] != Pattern(file, (uint32_t)offset + i)) {
+                (*errors)++;
+                break;
+            }
+        }
+        offset += count;
+    } while (count == piece);
+    *errors += (offset != f_size(&fp));
+    *errors += (f_close(&fp) != FR_OK);
+    return offset;
+}
+
+/// Reads "r<id>.bin" over and over while the writers run, sector aligned like the uploader or in odd pieces
+static void *Reader(void *arg)
+{
+    struct Worker *w = arg;
+    char path[16];
+
+    snprintf(path, sizeof(path), "0:r%u.bin", w->id);
+    do {
+        w->bytes += ReadAndCheck(path, 100 + w->id, (w->id % 2 == 0) ? 512 : 1000, &w->errors);
+    } while (__atomic_load_n(&writersRunning, __ATOMIC_RELAXED) > 0 && w->errors == 0);
+    return NULL;
+}
+
+/// Creates, looks up, lists and deletes small files while the writers run, like the catalog and flag files
+static void *Metadata(void *arg)
+{
+    struct Worker *w = arg;
+    char path[16];
+    FILINFO info;
+    UINT count;
+    DIR dir;
+    FIL fp;
+
+    info.lfname = NULL;
+    info.lfsize = 0;
+    for (unsigned k = 0; __atomic_load_n(&writersRunning, __ATOMIC_RELAXED) > 0 && w->errors == 0; k++) {
+        snprintf(path, sizeof(path), "0:m%u.txt", k % 16);
+        w->errors += (f_open(&fp, path, FA_CREATE_ALWAYS | FA_WRITE) != FR_OK);
+        w->errors += (f_write(&fp, path, 100, &count) != FR_OK);
+        w->errors += (f_close(&fp) != FR_OK);
+        w->errors += (f_stat(path, &info) != FR_OK || info.fsize != 100);
+        if (k % 4 == 3) {
+            snprintf(path, sizeof(path), "0:m%u.txt", (k - 2) % 16);
+            w->errors += (f_unlink(path) != FR_OK);
+        }
+        if (k % 16 == 0) {
+            w->errors += (f_opendir(&dir, "0:") != FR_OK);
+            while (f_readdir(&dir, &info) == FR_OK && info.fname[0] != '\0') {
+            }
+        }
+        w->bytes++;
+    }
+    return NULL;
+}
+
+/// Writes a file in whole sectors, for the readers
+static void WriteFile(const char *path, unsigned file)
+{
+    uint8_t buf[512];
+    UINT written;
+    FIL fp;
+
+    CHECK_EQ(f_open(&fp, path, FA_CREATE_ALWAYS | FA_WRITE), FR_OK);
+    for (uint32_t offset = 0; offset < FILE_SIZE; offset += sizeof(buf)) {
+        for (UINT i = 0; i < sizeof(buf); i++) {
+            buf[i] = Pattern(file, offset + i);
+        }
+        CHECK_EQ(f_write(&fp, buf, sizeof(buf), &written), FR_OK);
+    }
+    CHECK_EQ(f_close(&fp), FR_OK);
+}
+
+/// Free clusters match the files found in the root directory, so no cluster was lost or shared
+static void CheckFreeSpace(void)
+{
+    FATFS *vol;
+    FILINFO info;
+    DIR dir;
+    DWORD freeClusters, used = 0;
+    DWORD clusterBytes = CLUSTER_SECTORS * 512;
+
+    CHECK_EQ(f_mount(0, NULL), FR_OK);
+    CHECK_EQ(f_mount(0, &fs), FR_OK);
+    CHECK_EQ(f_getfree("0:", &freeClusters, &vol), FR_OK);
+    info.lfname = NULL;
+    info.lfsize = 0;
+    CHECK_EQ(f_opendir(&dir, "0:"), FR_OK);
+    while (f_readdir(&dir, &info) == FR_OK && info.fname[0] != '\0') {
+        used += (info.fsize + clusterBytes - 1) / clusterBytes;
+    }
+    CHECK_EQ(freeClusters + used, vol->n_fatent - 2);
+}
+
+static void TestConcurrent(void)
+{
+    struct Worker writers[WRITERS], readers[READERS], meta;
+    struct HostDiskStats before, after;
+    struct FatFsSyncStats lock;
+    pthread_t ticker;
+    uint64_t t0, ns, moved = 0;
+    unsigned errors = 0;
+
+    for (unsigned i = 0; i < READERS; i++) {
+        char path[16];
+        snprintf(path, sizeof(path), "0:r%u.bin", i);
+        WriteFile(path, 100 + i);
+    }
+
+    memset(writers, 0, sizeof(writers));
+    memset(readers, 0, sizeof(readers));
+    memset(&meta, 0, sizeof(meta));
+    writersRunning = WRITERS;
+    pthread_create(&ticker, NULL, Ticker, NULL);
+    HostDiskGetStats(&before);
+    t0 = HostTestNowNs();
+    for (unsigned i = 0; i < WRITERS; i++) {
+        writers[i].id = i;
+        pthread_create(&writers[i].thread, NULL, Writer, &writers[i]);
+    }
+    for (unsigned i = 0; i < READERS; i++) {
+        readers[i].id = i;
+        pthread_create(&readers[i].thread, NULL, Reader, &readers[i]);
+    }
+    pthread_create(&meta.thread, NULL, Metadata, &meta);
+    for (unsigned i = 0; i < WRITERS; i++) {
+        pthread_join(writers[i].thread, NULL);
+        errors += writers[i].errors;
+        moved += writers[i].bytes;
+    }
+    for (unsigned i = 0; i < READERS; i++) {
+        pthread_join(readers[i].thread, NULL);
+        errors += readers[i].errors;
+        moved += readers[i].bytes;
+    }
+    pthread_join(meta.thread, NULL);
+    errors += meta.errors;
+    ns = HostTestNowNs() - t0;
+    HostDiskGetStats(&after);
+    writersRunning = -1;
+    pthread_join(ticker, NULL);
+
+    CHECK_EQ(errors, 0);
+    FatFsSyncGetStats(&lock);
+    CHECK_EQ(lock.timeouts, 0);
+    printf("concurrent: %u writers, %u readers, metadata: %.1f MB in %.0f ms, %.1f MB/s, %lu metadata ops, "
+           "%llu sectors read %llu written\n",
+           WRITERS, READERS, moved / 1048576.0, ns / 1e6, moved / 1048576.0 / (ns / 1e9), (unsigned long)meta.bytes,
+           (unsigned long long)(after.reads - before.reads), (unsigned long long)(after.writes - before.writes));
+    printf("volume lock: %lu waits, %lu timeouts, longest wait %lu ms\n", (unsigned long)lock.waits,
+           (unsigned long)lock.timeouts, (unsigned long)lock.maxWaitTicks);
+
+    // Same files written and read one after the other, for the comparison
+    struct Worker w = {.id = WRITERS};
+    HostDiskGetStats(&before);
+    t0 = HostTestNowNs();
+    writersRunning = 1;
+    Writer(&w);
+    moved = w.bytes;
+    for (unsigned i = 0; i < READERS; i++) {
+        char path[16];
+        snprintf(path, sizeof(path), "0:r%u.bin", i);
+        moved += ReadAndCheck(path, 100 + i, (i % 2 == 0) ? 512 : 1000, &w.errors);
+    }
+    ns = HostTestNowNs() - t0;
+    HostDiskGetStats(&after);
+    CHECK_EQ(w.errors, 0);
+    printf("serial:     %.1f MB in %.0f ms, %.1f MB/s, %llu sectors read %llu written\n", moved / 1048576.0, ns / 1e6,
+           moved / 1048576.0 / (ns / 1e9), (unsigned long long)(after.reads - before.reads),
+           (unsigned long long)(after.writes - before.writes));
+}
+
+static void TestIntegrity(void)
+{
+    unsigned errors = 0;
+    char path[16];
+
+    for (unsigned i = 0; i <= WRITERS; i++) {
+        snprintf(path, sizeof(path), "0:w%u.bin", i);
+        CHECK_EQ(ReadAndCheck(path, i, 1024, &errors), FILE_SIZE);
+    }
+    for (unsigned i = 0; i < READERS; i++) {
+        snprintf(path, sizeof(path), "0:r%u.bin", i);
+        CHECK_EQ(ReadAndCheck(path, 100 + i, 1024, &errors), FILE_SIZE);
+    }
+    CHECK_EQ(errors, 0);
+    CheckFreeSpace();
+}
+
+int main(void)
+{
+    CHECK_EQ(HostDiskOpen(&fs, NULL, 64u * 2048u, CLUSTER_SECTORS), FR_OK);
+    RUN_TEST(TestConcurrent);
+    RUN_TEST(TestIntegrity);
+    HostDiskClose(&fs);
+    return HOST_TEST_RESULT();
+}
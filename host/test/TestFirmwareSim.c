@@ -0,0 +1,197 @@
+/**************************************************************************/ /**
+ * @file      TestFirmwareSim.c
+ * @brief     Smoke test of firmware_sim: boots the whole firmware on its console pipes, waits for the WINC model to
+ *            join and the MQTT client to reach a local listener the broker is redirected to, then runs CLI commands
+ *            that go through the console, the RTC and IMU models on the I2C bus and the kernel, and stops it.
+ *            Takes the path of firmware_sim as its argument.
+ * @date      2026-10-19
+
+ ******************************************************************************/
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "HostTest.h"
+
+#define BROKER "13.90.136.162:1883"  ///< main_mqtt_broker and CLOUDMQTT_PORT of WifiHandler.h
+#define BOOT_MS 10000
+#define COMMAND_MS 10000
+
+static const char *simPath;
+static pid_t simPid = -1;
+static int simIn = -1;   ///< Console input of the firmware
+static int simOut = -1;  ///< Console output and simulator log
+static char simText[1 << 16];
+static size_t simTextLen = 0;
+static size_t simTextSeen = 0;  ///< Text before this offset was matched already
+
+/// Reads the firmware output until text appears after the last match, for up to ms. Returns where it starts.
+static const char *Expect(const char *text, int ms)
+{
+    uint64_t end = HostTestNowNs() + (uint64_t)ms * 1000000ull;
+
+    for (;;) {
+        const char *found = strstr(simText + simTextSeen, text);
+        struct pollfd pfd = {.fd = simOut, .events = POLLIN};
+        uint64_t now = HostTestNowNs();
+        ssize_t len;
+
+        if (found != NULL) {
+            simTextSeen = (size_t)(found - simText) + strlen(text);
+            return found;
+        }
+        if (now >= end || simTextLen == sizeof(simText) - 1 || poll(&pfd, 1, (int)((end - now) / 1000000ull) + 1) <= 0) {
+            fprintf(stderr, "no \"%s\" in the output of firmware_sim:\n%s\n", text, simText + simTextSeen);
+            return NULL;
+        }
+        len = read(simOut, simText + simTextLen, sizeof(simText) - 1 - simTextLen);
+        if (len <= 0) {
+            fprintf(stderr, "firmware_sim closed its output:\n%s\n", simText + simTextSeen);
+            return NULL;
+        }
+        // The firmware output may hold NUL characters, which would hide what follows from strstr
+        for (ssize_t i = 0; i < len; i++) {
+            if (simText[simTextLen + i] == '\0') {
+                simText[simTextLen + i] = ' ';
+            }
+        }
+        simTextLen += (size_t)len;
+        simText[simTextLen] = '\0';
+    }
+}
+
+/// Types a command, character by character as a terminal sends them
+static void Type(const char *command)
+{
+    for (const char *c = command; *c != '\0'; c++) {
+        CHECK_EQ(write(simIn, c, 1), 1);
+    }
+}
+
+static int Listen(uint16_t *port)
+{
+    struct sockaddr_in addr = {.sin_family = AF_INET, .sin_addr.s_addr = htonl(INADDR_LOOPBACK)};
+    socklen_t len = sizeof(addr);
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+
+    if (fd < 0 || bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(fd, 1) != 0 ||
+        getsockname(fd, (struct sockaddr *)&addr, &len) != 0) {
+        return -1;
+    }
+    *port = ntohs(addr.sin_port);
+    return fd;
+}
+
+/// Starts firmware_sim in dir on pipes, with the broker redirected to port
+static bool Start(const char *dir, uint16_t port)
+{
+    int in[2], out[2];
+    char redirect[64];
+
+    snprintf(redirect, sizeof(redirect), BROKER "=127.0.0.1:%u", port);
+    if (pipe(in) != 0 || pipe(out) != 0) {
+        return false;
+    }
+    simPid = fork();
+    if (simPid == 0) {
+        dup2(in[0], STDIN_FILENO);
+        dup2(out[1], STDOUT_FILENO);
+        dup2(out[1], STDERR_FILENO);
+        close(in[1]);
+        close(out[0]);
+        if (chdir(dir) == 0) {
+            execl(simPath, simPath, "-c", "-", "-r", redirect, "-t", "60", (char *)NULL);
+        }
+        _exit(127);
+    }
+    close(in[0]);
+    close(out[1]);
+    simIn = in[1];
+    simOut = out[0];
+    return simPid > 0;
+}
+
+static int Stop(void)
+{
+    int status = -1;
+
+    kill(simPid, SIGTERM);
+    close(simIn);
+    while (waitpid(simPid, &status, 0) < 0 && errno == EINTR) {
+    }
+    close(simOut);
+    return status;
+}
+
+/// The whole firmware on the simulator: boot, WINC join and broker connection, and CLI commands
+static void TestFirmwareSim(void)
+{
+    char dir[] = "/tmp/test_firmware_sim_XXXXXX";
+    char command[96];
+    struct pollfd pfd;
+    uint16_t port = 0;
+    uint8_t packet = 0;
+    int listener = Listen(&port);
+    int broker = -1;
+    const char *scan;
+
+    CHECK(listener >= 0);
+    CHECK(mkdtemp(dir) != NULL);
+    if (listener < 0 || !Start(dir, port)) {
+        CHECK(false);
+        return;
+    }
+
+    // Boot: the CLI prompt, then the WINC model joins and the MQTT client connects to the listener
+    CHECK(Expect("Type Help", BOOT_MS) != NULL);
+    CHECK(Expect("wifi_cb: IP address is 127.0.0.1", BOOT_MS) != NULL);
+    pfd = (struct pollfd){.fd = listener, .events = POLLIN};
+    CHECK(poll(&pfd, 1, BOOT_MS) == 1);
+    broker = accept(listener, NULL, NULL);
+    CHECK(broker >= 0);
+    pfd = (struct pollfd){.fd = broker, .events = POLLIN};
+    CHECK(broker >= 0 && poll(&pfd, 1, BOOT_MS) == 1 && read(broker, &packet, 1) == 1);
+    CHECK_EQ(packet, 0x10);  // MQTT CONNECT
+
+    // Each command is typed once the previous one finished: the CLI takes one character per semaphore give
+    Type("version\r");
+    CHECK(Expect("Version Number: ", COMMAND_MS) != NULL);
+    Type("ticks\r");
+    CHECK(Expect("Ticks since start of scheduler: ", COMMAND_MS) != NULL);
+    // The scan prints the 8-bit address of a device it finds, and finds each twice as the bus takes 7 bits of it
+    Type("i2c\r");
+    scan = Expect("30: ", COMMAND_MS);
+    CHECK(Expect("70: ", COMMAND_MS) != NULL && Expect("\r\n\r\n", COMMAND_MS) != NULL);
+    CHECK(scan != NULL && strncmp(scan, "30: X X X X 68: 6a: X", 21) == 0);
+    Type("tasks\r");
+    CHECK(Expect("CLI_TAS", COMMAND_MS) != NULL);
+    CHECK(Expect("Heap free", COMMAND_MS) != NULL);
+
+    CHECK_EQ(Stop(), 0);
+    if (broker >= 0) {
+        close(broker);
+    }
+    close(listener);
+    snprintf(command, sizeof(command), "rm -rf '%s'", dir);
+    CHECK_EQ(system(command), 0);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc != 2) {
+        fprintf(stderr, "usage: TestFirmwareSim FIRMWARE_SIM\n");
+        return EXIT_FAILURE;
+    }
+    simPath = argv[1];
+    signal(SIGPIPE, SIG_IGN);
+    RUN_TEST(TestFirmwareSim);
+    return HOST_TEST_RESULT();
+}
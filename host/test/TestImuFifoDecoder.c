@@ -0,0 +1,249 @@
+/**************************************************************************/ /**
+ * @file      TestImuFifoDecoder.c
+ * @brief     Host tests of the LSM6DSO FIFO decoder: hand written words of every tag, and a round trip of random
+ *            sample streams through a reference FIFO encoder, decoded in burst reads of random length.
+ * @date      2026-10-19
+
+ ******************************************************************************/
+
+#include <string.h>
+
+#include "HostTest.h"
+#include "IMU/ImuFifoDecoder.h"
+#include "IMU/lsm6dso_reg.h"
+
+#define TEST_PERIOD_US 10000  ///< Multiple of IMU_FIFO_TIMESTAMP_US, so timestamps are exact
+#define TEST_MAX_SAMPLES 4096
+
+static struct ImuSample decoded[TEST_MAX_SAMPLES];
+static uint32_t decodedCount;
+
+static void CollectBatch(struct ImuDataBatch *batch)
+{
+    for (uint8_t i = 0; i < batch->count && decodedCount < TEST_MAX_SAMPLES; i++) {
+        decoded[decodedCount++] = batch->sample[i];
+    }
+}
+
+static void Flush(struct ImuDataBatch *batch)
+{
+    CollectBatch(batch);
+    batch->count = 0;
+}
+
+static uint8_t Tag(uint8_t sensor, uint32_t slot)
+{
+    return (uint8_t)((sensor << 3) | ((slot & 0x03) << 1));
+}
+
+static uint8_t *PutWord(uint8_t *out, uint8_t tag, const uint8_t data[6])
+{
+    out[0] = tag;
+    memcpy(&out[1], data, 6);
+    return out + IMU_FIFO_WORD_SIZE;
+}
+
+static uint8_t *PutXl(uint8_t *out, uint8_t sensor, uint32_t slot, const int16_t xl[3])
+{
+    uint8_t data[6];
+    for (int axis = 0; axis < 3; axis++) {
+        data[2 * axis] = (uint8_t)xl[axis];
+        data[2 * axis + 1] = (uint8_t)((uint16_t)xl[axis] >> 8);
+    }
+    return PutWord(out, Tag(sensor, slot), data);
+}
+
+static uint8_t *PutTimestamp(uint8_t *out, uint32_t slot)
+{
+    uint32_t ticks = slot * (TEST_PERIOD_US / IMU_FIFO_TIMESTAMP_US);
+    uint8_t data[6] = {(uint8_t)ticks, (uint8_t)(ticks >> 8), (uint8_t)(ticks >> 16), (uint8_t)(ticks >> 24), 0, 0};
+    return PutWord(out, Tag(LSM6DSO_TIMESTAMP_TAG, slot), data);
+}
+
+static bool Fits(int32_t d, int bits)
+{
+    return d >= -(1 << (bits - 1)) && d < (1 << (bits - 1));
+}
+
+/**
+ * Reference encoder. Samples go out in groups of three time slots, tagged with the slot of the last one, the way
+ * the device compresses them: one 3x word if every delta fits in 5 bits, a 2x word and an uncompressed word if the
+ * first two fit in 8 bits, otherwise three uncompressed words (t-2, t-1, t). A timestamp word precedes every
+ * eighth group. Returns the number of words written.
+ */
+static uint32_t EncodeFifo(const int16_t (*xl)[3], uint32_t count, uint8_t *out, uint32_t *wordsOut)
+{
+    uint8_t *p = out;
+    int16_t last[3] = {0, 0, 0};
+    uint32_t stats[3] = {0, 0, 0};
+
+    for (uint32_t g = 0; g + 3 <= count; g += 3) {
+        uint32_t t = g + 2;
+        bool fit5 = true, fit8 = true;
+        int16_t ref[3];
+
+        if ((g / 3) % 8 == 0) {
+            p = PutTimestamp(p, t);
+        }
+        memcpy(ref, last, sizeof(ref));
+        for (uint32_t j = 0; j < 3; j++) {
+            for (int axis = 0; axis < 3; axis++) {
+                int32_t d = xl[g + j][axis] - ref[axis];
+                fit5 &= Fits(d, 5);
+                if (j < 2) {
+                    fit8 &= Fits(d, 8);
+                }
+                ref[axis] = xl[g + j][axis];
+            }
+        }
+
+        if (fit5) {
+            uint8_t data[6];
+            for (uint32_t j = 0; j < 3; j++) {
+                uint16_t packed = 0;
+                for (int axis = 0; axis < 3; axis++) {
+                    packed |= (uint16_t)((xl[g + j][axis] - last[axis]) & 0x1F) << (5 * axis);
+                    last[axis] = xl[g + j][axis];
+                }
+                data[2 * j] = (uint8_t)packed;
+                data[2 * j + 1] = (uint8_t)(packed >> 8);
+            }
+            p = PutWord(p, Tag(LSM6DSO_XL_3XC_TAG, t), data);
+            stats[0]++;
+        } else if (fit8) {
+            uint8_t data[6];
+            for (uint32_t j = 0; j < 2; j++) {
+                for (int axis = 0; axis < 3; axis++) {
+                    data[3 * j + axis] = (uint8_t)(int8_t)(xl[g + j][axis] - last[axis]);
+                    last[axis] = xl[g + j][axis];
+                }
+            }
+            p = PutWord(p, Tag(LSM6DSO_XL_2XC_TAG, t), data);
+            p = PutXl(p, LSM6DSO_XL_NC_TAG, t, xl[g + 2]);
+            memcpy(last, xl[g + 2], sizeof(last));
+            stats[1]++;
+        } else {
+            p = PutXl(p, LSM6DSO_XL_NC_T_2_TAG, t, xl[g]);
+            p = PutXl(p, LSM6DSO_XL_NC_T_1_TAG, t, xl[g + 1]);
+            p = PutXl(p, LSM6DSO_XL_NC_TAG, t, xl[g + 2]);
+            memcpy(last, xl[g + 2], sizeof(last));
+            stats[2]++;
+        }
+    }
+    *wordsOut = (uint32_t)(p - out) / IMU_FIFO_WORD_SIZE;
+    return stats[0] * 3 + stats[1] * 2;  // Samples that travelled compressed
+}
+
+static void TestHandWrittenWords(void)
+{
+    static const uint8_t raw[] = {
+        // Timestamp 400 ticks (10 ms) in slot 0
+        (LSM6DSO_TIMESTAMP_TAG << 3) | (0 << 1), 0x90, 0x01, 0x00, 0x00, 0x00, 0x00,
+        // Uncompressed sample at t in slot 0: (1000, -1000, 16384)
+        (LSM6DSO_XL_NC_TAG << 3) | (0 << 1), 0xE8, 0x03, 0x18, 0xFC, 0x00, 0x40,
+        // Slot 3: 2x word with deltas (+1, -2, +127) at t-2 and (-128, 0, 5) at t-1, then t uncompressed
+        (LSM6DSO_XL_2XC_TAG << 3) | (3 << 1), 0x01, 0xFE, 0x7F, 0x80, 0x00, 0x05,
+        (LSM6DSO_XL_NC_TAG << 3) | (3 << 1), 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        // Slot 6 (TAG_CNT 2): 3x word, deltas (15, -16, -1), (0, 1, 2), (-3, 4, -5) in 5-bit fields
+        (LSM6DSO_XL_3XC_TAG << 3) | (2 << 1), 0x0F, 0xFE, 0x20, 0x08, 0x9D, 0x6C,
+        // A gyroscope word is skipped
+        (LSM6DSO_GYRO_NC_TAG << 3) | (2 << 1), 0x11, 0x22, 0x33, 0x44, 0x55, 0x66,
+    };
+    static const int16_t expect[][3] = {
+        {1000, -1000, 16384}, {1001, -1002, 16511}, {873, -1002, 16516}, {0, 0, 0}, {15, -16, -1}, {15, -15, 1}, {12, -11, -4},
+    };
+    static const uint32_t expectUs[] = {10000, 20000, 30000, 40000, 50000, 60000, 70000};
+    struct ImuFifoDecoder dec;
+    struct ImuDataBatch batch;
+
+    decodedCount = 0;
+    ImuFifoDecoderInit(&dec, &batch, TEST_PERIOD_US, CollectBatch);
+    CHECK_EQ(ImuFifoDecode(&dec, raw, sizeof(raw) / IMU_FIFO_WORD_SIZE), 7);
+    Flush(&batch);
+    CHECK_EQ(decodedCount, 7);
+    for (uint32_t i = 0; i < 7 && i < decodedCount; i++) {
+        CHECK_EQ(decoded[i].x, expect[i][0]);
+        CHECK_EQ(decoded[i].y, expect[i][1]);
+        CHECK_EQ(decoded[i].z, expect[i][2]);
+        CHECK_EQ(decoded[i].timestampUs, expectUs[i]);
+    }
+}
+
+static void TestBatchReady(void)
+{
+    int16_t xl[IMU_BATCH_SIZE * 2 + 4][3];  // A multiple of the three slot groups
+    static uint8_t raw[sizeof(xl) / 6 * 3 * IMU_FIFO_WORD_SIZE];
+    struct ImuFifoDecoder dec;
+    struct ImuDataBatch batch;
+    uint32_t words;
+
+    for (uint32_t i = 0; i < sizeof(xl) / sizeof(xl[0]); i++) {
+        xl[i][0] = (int16_t)(i * 1000);  // Never compressible
+        xl[i][1] = 0;
+        xl[i][2] = (int16_t)-i;
+    }
+    EncodeFifo(xl, sizeof(xl) / sizeof(xl[0]), raw, &words);
+    decodedCount = 0;
+    ImuFifoDecoderInit(&dec, &batch, TEST_PERIOD_US, CollectBatch);
+    ImuFifoDecode(&dec, raw, (uint16_t)words);
+    CHECK_EQ(decodedCount, IMU_BATCH_SIZE * 2);  // Two full batches handed over, the rest still pending
+    CHECK_EQ(batch.count, 4);
+}
+
+static void TestRoundTripFuzz(void)
+{
+    static int16_t xl[3 * 600][3];
+    static uint8_t raw[3 * 600 * 2 * IMU_FIFO_WORD_SIZE];
+    uint32_t seed = 0x1234567u;
+    uint64_t compressed = 0, total = 0;
+
+    for (int iteration = 0; iteration < 200; iteration++) {
+        uint32_t count = 3 * (1 + HostTestRandom(&seed) % 600);
+        uint32_t spread = 1u << (HostTestRandom(&seed) % 15);  // Step size from 1 to 16384 LSB
+        struct ImuFifoDecoder dec;
+        struct ImuDataBatch batch;
+        uint32_t words, at = 0;
+
+        for (uint32_t i = 0; i < count; i++) {
+            for (int axis = 0; axis < 3; axis++) {
+                int32_t prev = i ? xl[i - 1][axis] : 0;
+                int32_t v = prev + (int32_t)(HostTestRandom(&seed) % (2 * spread + 1)) - (int32_t)spread;
+                xl[i][axis] = (int16_t)(v > 32767 ? 32767 : v < -32768 ? -32768 : v);
+            }
+        }
+        compressed += EncodeFifo(xl, count, raw, &words);
+        total += count;
+
+        decodedCount = 0;
+        ImuFifoDecoderInit(&dec, &batch, TEST_PERIOD_US, CollectBatch);
+        while (at < words) {
+            uint32_t n = 1 + HostTestRandom(&seed) % 64;  // One watermark drain of up to IMU_FIFO_MAX_WORDS
+            if (n > words - at) {
+                n = words - at;
+            }
+            ImuFifoDecode(&dec, &raw[at * IMU_FIFO_WORD_SIZE], (uint16_t)n);
+            at += n;
+        }
+        Flush(&batch);
+
+        CHECK_EQ(decodedCount, count);
+        for (uint32_t i = 0; i < count && i < decodedCount; i++) {
+            if (decoded[i].x != xl[i][0] || decoded[i].y != xl[i][1] || decoded[i].z != xl[i][2] ||
+                decoded[i].timestampUs != i * TEST_PERIOD_US) {
+                fprintf(stderr, "iteration %d sample %u differs\n", iteration, (unsigned)i);
+                hostTestFailures++;
+                break;
+            }
+        }
+    }
+    printf("round trip: %llu samples, %.1f%% through compressed words\n", (unsigned long long)total,
+           100.0 * (double)compressed / (double)total);
+}
+
+int main(void)
+{
+    RUN_TEST(TestHandWrittenWords);
+    RUN_TEST(TestBatchReady);
+    RUN_TEST(TestRoundTripFuzz);
+    return HOST_TEST_RESULT();
+}
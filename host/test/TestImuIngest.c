@@ -0,0 +1,565 @@
+/**************************************************************************/ /**
+ * @file      TestImuIngest.c
+ * @brief     Host tests of imu_ingest: batch messages as the firmware writes them and malformed ones, the worst case
+ *            batch that makes the firmware split, repeats and gaps by device, boot and message number, the device
+ *            clock across its wrap, store queries against a reference across partitions and a reopened store with
+ *            a torn index, and the MQTT subscriber against a fake broker on a local socket.
+ * @date      2026-10-19
+
+ ******************************************************************************/
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "HostTest.h"
+#include "ImuIngest.h"
+#include "ImuStore.h"
+#include "MqttSubscriber.h"
+
+#define DEVICE_A "0123456789ABCDEF0123456789ABCDEF"
+#define DEVICE_B "FEDCBA9876543210FEDCBA9876543210"
+#define FIRMWARE_PAYLOAD_MAX 448  ///< MQTT_SPOOL_MAX_PAYLOAD, the payload buffer of WifiHandler.c
+#define NOW_US 1790000000000000ll
+
+static uint32_t randomState = 0x9E3779B9u;
+
+/// Rows handed to a query callback
+struct Rows {
+    int64_t *us;
+    int16_t *value;
+    size_t count;
+    size_t size;
+};
+
+static void CollectRow(void *context, int64_t us, int16_t value)
+{
+    struct Rows *rows = context;
+    if (rows->count == rows->size) {
+        rows->size = (rows->size == 0) ? 256 : rows->size * 2;
+        rows->us = realloc(rows->us, rows->size * sizeof(int64_t));
+        rows->value = realloc(rows->value, rows->size * sizeof(int16_t));
+    }
+    rows->us[rows->count] = us;
+    rows->value[rows->count++] = value;
+}
+
+static void FreeRows(struct Rows *rows)
+{
+    free(rows->us);
+    free(rows->value);
+    memset(rows, 0, sizeof(*rows));
+}
+
+static char *TempDir(void)
+{
+    static char dir[64];
+    snprintf(dir, sizeof(dir), "/tmp/test_ingest_XXXXXX");
+    return mkdtemp(dir);
+}
+
+static void RemoveDir(const char *dir)
+{
+    char command[128];
+    snprintf(command, sizeof(command), "rm -rf '%s'", dir);
+    CHECK_EQ(system(command), 0);
+}
+
+static struct ImuIngestMessage Message(const char *device, uint32_t boot, uint32_t seq, uint32_t t0, uint16_t count,
+                                       uint8_t mask)
+{
+    struct ImuIngestMessage m;
+    memset(&m, 0, sizeof(m));
+    snprintf(m.device, sizeof(m.device), "%s", device);
+    m.boot = boot;
+    m.seq = seq;
+    m.t0 = t0;
+    m.t1 = t0 + 9615u * (count - 1u);  // 104 Hz
+    m.channelMask = mask;
+    m.count = count;
+    for (uint16_t i = 0; i < count; i++) {
+        for (uint8_t axis = 0; axis < 3; axis++) {
+            m.value[i][axis] = (mask & (1u << axis)) ? (int16_t)(seq * 100 + i * 3 + axis) : 0;
+        }
+    }
+    return m;
+}
+
+static void TestDecode(void)
+{
+    static const char firmware[] =
+        "{\"dev\":\"" DEVICE_A "\",\"boot\":7,\"seq\":3,\"t0\":4294967000,\"ch\":5,\"xyz\":[[1,-2],[32767,-32768]],"
+        "\"t1\":104}";
+    static const char *const bad[] = {
+        "{\"dev\":\"" DEVICE_A "\",\"boot\":7,\"t0\":1,\"ch\":1,\"xyz\":[[1]],\"t1\":2}",  // No seq
+        "{\"dev\":\"" DEVICE_A "\",\"seq\":1,\"t0\":1,\"xyz\":[[1]],\"ch\":1,\"t1\":2}",   // ch after xyz
+        "{\"dev\":\"" DEVICE_A "\",\"seq\":1,\"t0\":1,\"ch\":3,\"xyz\":[[1]],\"t1\":2}",   // One axis of two
+        "{\"dev\":\"" DEVICE_A "\",\"seq\":1,\"t0\":1,\"ch\":1,\"xyz\":[[32768]],\"t1\":2}",
+        "{\"dev\":\"" DEVICE_A "\",\"seq\":1,\"t0\":1,\"ch\":1,\"xyz\":[],\"t1\":2}",
+        "{\"dev\":\"" DEVICE_A "\",\"seq\":4294967296,\"t0\":1,\"ch\":1,\"xyz\":[[1]],\"t1\":2}",
+        "{\"dev\":\"../etc\",\"seq\":1,\"t0\":1,\"ch\":1,\"xyz\":[[1]],\"t1\":2}",
+        "{\"dev\":\"a\\\"b\",\"seq\":1,\"t0\":1,\"ch\":1,\"xyz\":[[1]],\"t1\":2}",
+        "{\"dev\":\"" DEVICE_A "\",\"seq\":1,\"seq\":2,\"t0\":1,\"ch\":1,\"xyz\":[[1]],\"t1\":2}",
+        "{\"dev\":\"" DEVICE_A "\",\"seq\":1,\"t0\":1,\"ch\":1,\"xyz\":[[1]],\"t1\":2}x",
+    };
+    struct ImuIngestMessage m, back;
+    char text[FIRMWARE_PAYLOAD_MAX];
+
+    CHECK_EQ(ImuIngestDecode(firmware, strlen(firmware), &m), 0);
+    CHECK(strcmp(m.device, DEVICE_A) == 0);
+    CHECK_EQ(m.boot, 7);
+    CHECK_EQ(m.seq, 3);
+    CHECK_EQ(m.t0, 4294967000u);
+    CHECK_EQ(m.t1, 104);
+    CHECK_EQ(m.channelMask, 5);
+    CHECK_EQ(m.count, 2);
+    CHECK_EQ(m.value[0][0], 1);
+    CHECK_EQ(m.value[0][1], 0);
+    CHECK_EQ(m.value[0][2], -2);
+    CHECK_EQ(m.value[1][0], 32767);
+    CHECK_EQ(m.value[1][2], -32768);
+
+    // The formatter writes what the firmware does
+    CHECK_EQ(ImuIngestFormat(text, sizeof(text), &m), (int)strlen(firmware));
+    CHECK(strcmp(text, firmware) == 0);
+
+    // Any key order, white space, unknown keys, and no boot from older firmware
+    static const char loose[] = " { \"t1\" : 9 , \"extra\":{\"a\":[1,\"]\"]}, \"ch\":2, \"seq\":1, \"dev\":\"Unit1\","
+                                "\"xyz\":[ [ -5 ] ,[6]], \"t0\":0 } ";
+    CHECK_EQ(ImuIngestDecode(loose, strlen(loose), &m), 0);
+    CHECK_EQ(m.boot, 0);
+    CHECK_EQ(m.count, 2);
+    CHECK_EQ(m.value[0][1], -5);
+    CHECK_EQ(m.value[1][1], 6);
+
+    for (size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); i++) {
+        CHECK_EQ(ImuIngestDecode(bad[i], strlen(bad[i]), &m), -1);
+    }
+    // Every cut of a message is rejected within its bytes
+    for (size_t len = 0; len < strlen(firmware); len++) {
+        char *cut = malloc(len + 1);
+        memcpy(cut, firmware, len);
+        CHECK_EQ(ImuIngestDecode(cut, len, &m), -1);
+        free(cut);
+    }
+
+    // Random round trips of messages the size the firmware splits batches to
+    for (int i = 0; i < 2000; i++) {
+        m = Message(DEVICE_B, HostTestRandom(&randomState), HostTestRandom(&randomState),
+                    HostTestRandom(&randomState), (uint16_t)(1 + HostTestRandom(&randomState) % 13),
+                    (uint8_t)(1 + HostTestRandom(&randomState) % 7));
+        for (uint16_t s = 0; s < m.count; s++) {
+            for (uint8_t axis = 0; axis < 3; axis++) {
+                m.value[s][axis] = (m.channelMask & (1u << axis)) ? (int16_t)HostTestRandom(&randomState) : 0;
+            }
+        }
+        int len = ImuIngestFormat(text, sizeof(text), &m);
+        CHECK(len > 0);
+        CHECK_EQ(ImuIngestDecode(text, (size_t)len, &back), 0);
+        CHECK_EQ(back.seq, m.seq);
+        CHECK_EQ(back.count, m.count);
+        CHECK(memcmp(back.value, m.value, m.count * sizeof(m.value[0])) == 0);
+    }
+}
+
+/// A full batch of the widest numbers does not fit the firmware's payload buffer, 13 samples do
+static void TestWorstCase(void)
+{
+    struct ImuIngestMessage m = Message(DEVICE_A, UINT32_MAX, UINT32_MAX, UINT32_MAX, 16, 7);
+    char text[FIRMWARE_PAYLOAD_MAX];
+
+    for (int i = 0; i < 16; i++) {
+        m.value[i][0] = m.value[i][1] = m.value[i][2] = -32768;
+    }
+    m.t1 = UINT32_MAX;
+    CHECK_EQ(ImuIngestFormat(text, sizeof(text), &m), -1);
+    m.count = 13;
+    CHECK(ImuIngestFormat(text, sizeof(text), &m) > 0);
+}
+
+static enum ImuIngestResult Feed(struct ImuIngest *ingest, const struct ImuIngestMessage *m, int64_t nowUs)
+{
+    char text[FIRMWARE_PAYLOAD_MAX];
+    int len = ImuIngestFormat(text, sizeof(text), m);
+    CHECK(len > 0);
+    return ImuIngestPayload(ingest, text, (size_t)len, nowUs);
+}
+
+static void TestDedupe(void)
+{
+    char *dir = TempDir();
+    struct ImuStore *store = ImuStoreOpen(dir);
+    struct ImuIngest *ingest = ImuIngestOpen(store);
+    struct ImuIngestStats stats;
+    struct ImuIngestMessage m;
+    struct Rows rows = {0};
+    struct ImuStoreQueryStats qs;
+    struct ImuStoreQuery query = {DEVICE_A, 0, INT64_MIN, INT64_MAX, INT16_MIN, INT16_MAX};
+    uint32_t t = 1000;
+
+    // Boot 1: 0..99, each sent twice, 50..59 lost, 40 arrives after 45
+    for (uint32_t seq = 0; seq < 100; seq++, t += 16 * 9615) {
+        if (seq >= 50 && seq < 60) {
+            continue;
+        }
+        if (seq == 40) {
+            continue;
+        }
+        m = Message(DEVICE_A, 1, seq, t, 16, 1);
+        CHECK_EQ(Feed(ingest, &m, NOW_US), IMU_INGEST_STORED);
+        CHECK_EQ(Feed(ingest, &m, NOW_US), IMU_INGEST_DUPLICATE);
+        if (seq == 45) {
+            m = Message(DEVICE_A, 1, 40, t - 5 * 16 * 9615, 16, 1);
+            CHECK_EQ(Feed(ingest, &m, NOW_US), IMU_INGEST_STORED);
+            CHECK_EQ(Feed(ingest, &m, NOW_US), IMU_INGEST_DUPLICATE);
+        }
+    }
+    // Boot 2 starts its numbers over and is not a repeat; an older device has its own numbers
+    m = Message(DEVICE_A, 2, 0, 5, 16, 1);
+    CHECK_EQ(Feed(ingest, &m, NOW_US), IMU_INGEST_STORED);
+    m = Message(DEVICE_B, 1, 0, 5, 16, 1);
+    CHECK_EQ(Feed(ingest, &m, NOW_US), IMU_INGEST_STORED);
+    // Too far behind the newest of its boot to tell
+    m = Message(DEVICE_A, 2, 5000, 5, 16, 1);
+    CHECK_EQ(Feed(ingest, &m, NOW_US), IMU_INGEST_STORED);
+    m = Message(DEVICE_A, 2, 1, 5, 16, 1);
+    CHECK_EQ(Feed(ingest, &m, NOW_US), IMU_INGEST_DUPLICATE);
+    CHECK_EQ(ImuIngestPayload(ingest, "{}", 2, NOW_US), IMU_INGEST_MALFORMED);
+
+    ImuIngestGetStats(ingest, &stats);
+    CHECK_EQ(stats.sources, 3);
+    CHECK_EQ(stats.duplicates, 89 + 1 + 1);
+    CHECK_EQ(stats.lost, 10 + 4999);
+    CHECK_EQ(stats.malformed, 1);
+    CHECK_EQ(stats.samples, (90 + 3) * 16);
+    CHECK_EQ(stats.events, stats.samples);
+    CHECK_EQ(stats.storeErrors, 0);
+
+    CHECK_EQ(ImuStoreFlush(store), 0);
+    CHECK_EQ(ImuStoreSelect(dir, &query, CollectRow, &rows, &qs), 0);
+    CHECK_EQ(rows.count, (90 + 2) * 16);
+    query.channel = 1;
+    CHECK_EQ(ImuStoreSelect(dir, &query, CollectRow, &rows, &qs), 0);  // No y axis in the mask
+    CHECK_EQ(rows.count, (90 + 2) * 16);
+
+    FreeRows(&rows);
+    ImuIngestClose(ingest);
+    CHECK_EQ(ImuStoreClose(store), 0);
+    RemoveDir(dir);
+}
+
+/// Stored times follow the device clock across its wrap, anchored where the first message of the boot arrived
+static void TestClock(void)
+{
+    char *dir = TempDir();
+    struct ImuStore *store = ImuStoreOpen(dir);
+    struct ImuIngest *ingest = ImuIngestOpen(store);
+    struct ImuStoreQuery query = {DEVICE_A, 2, INT64_MIN, INT64_MAX, INT16_MIN, INT16_MAX};
+    struct ImuStoreQueryStats qs;
+    struct Rows rows = {0};
+    uint32_t t0 = 0xFFFFFFFFu - 50 * 16 * 9615u;
+
+    for (uint32_t seq = 0; seq < 100; seq++) {
+        struct ImuIngestMessage m = Message(DEVICE_A, 3, seq, t0 + seq * 16 * 9615u, 16, 4);
+        CHECK_EQ(Feed(ingest, &m, NOW_US + seq * 153840ll + ((seq > 0) ? HostTestRandom(&randomState) % 2000000 : 0)),
+                 IMU_INGEST_STORED);
+    }
+    ImuIngestClose(ingest);
+    CHECK_EQ(ImuStoreClose(store), 0);
+
+    CHECK_EQ(ImuStoreSelect(dir, &query, CollectRow, &rows, &qs), 0);
+    CHECK_EQ(rows.count, 1600);
+    for (size_t i = 0; i < rows.count; i++) {
+        CHECK_EQ(rows.us[i], NOW_US + (int64_t)i * 9615);
+    }
+    FreeRows(&rows);
+    RemoveDir(dir);
+}
+
+/// Random rows of several devices over several hours against an in-memory copy, across a reopen and a torn index
+static void TestStore(void)
+{
+    enum { DEVICES = 3, ROWS = 60000 };
+    static const char *const devices[DEVICES] = {"dev0", "dev1", "dev2"};
+    char *dir = TempDir();
+    struct ImuStore *store = ImuStoreOpen(dir);
+    struct Rows reference[DEVICES][3], rows = {0};
+    struct ImuStoreQueryStats qs;
+    int64_t us[DEVICES] = {NOW_US, NOW_US + 5, NOW_US - 3600000000ll};
+    char path[256];
+    FILE *torn;
+
+    memset(reference, 0, sizeof(reference));
+    for (int phase = 0; phase < 2; phase++) {
+        for (int i = 0; i < ROWS; i++) {
+            uint32_t r = HostTestRandom(&randomState);
+            int d = r % DEVICES;
+            uint8_t channel = (r >> 8) % 3;
+            int16_t value = (int16_t)(HostTestRandom(&randomState) % 2000) - 1000;
+            us[d] += 1 + (r >> 16) % 400000;  // Up to 0.4 s between rows: about 7 hours in all
+            CHECK_EQ(ImuStoreAppend(store, devices[d], channel, us[d], value), 0);
+            CollectRow(&reference[d][channel], us[d], value);
+        }
+        CHECK_EQ(ImuStoreClose(store), 0);
+        if (phase == 0) {
+            // A crash left part of an index entry and of the columns behind
+            snprintf(path, sizeof(path), "%s/dev0/h%lld/x.idx", dir, (long long)(us[0] / 3600000000ll));
+            torn = fopen(path, "ab");
+            CHECK(torn != NULL);
+            if (torn != NULL) {
+                fwrite("garbage", 1, 7, torn);
+                fclose(torn);
+            }
+            store = ImuStoreOpen(dir);
+        }
+    }
+    CHECK_EQ(ImuStoreAppend(store = ImuStoreOpen(dir), "bad/name", 0, 0, 0), -1);
+    CHECK_EQ(ImuStoreAppend(store, "dev0", 3, 0, 0), -1);
+    CHECK_EQ(ImuStoreClose(store), 0);
+
+    for (int q = 0; q < 300; q++) {
+        int d = HostTestRandom(&randomState) % DEVICES;
+        uint8_t channel = HostTestRandom(&randomState) % 3;
+        struct Rows *ref = &reference[d][channel];
+        size_t a = HostTestRandom(&randomState) % ref->count, span = HostTestRandom(&randomState) % 3000;
+        size_t b = (a + span < ref->count) ? a + span : ref->count - 1;
+        struct ImuStoreQuery query = {devices[d], channel, ref->us[a], ref->us[b], INT16_MIN, INT16_MAX};
+        size_t expected = 0;
+        bool same = true;
+
+        if (q % 3 == 0) {
+            query.minValue = 900;  // A rare value: most blocks are skipped by their value range
+        }
+        CHECK_EQ(ImuStoreSelect(dir, &query, CollectRow, &rows, &qs), 0);
+        for (size_t i = a; i <= b; i++) {
+            if (ref->value[i] >= query.minValue) {
+                same = same && expected < rows.count && rows.us[expected] == ref->us[i] &&
+                       rows.value[expected] == ref->value[i];
+                expected++;
+            }
+        }
+        CHECK(same);
+        CHECK_EQ(rows.count, expected);
+        CHECK_EQ(qs.rows, expected);
+        // Only the blocks of the range are read: it spans at most 3000 rows, in two partitions at most
+        CHECK(qs.partitions <= 2);
+        CHECK(qs.blocksRead <= span / IMU_STORE_BLOCK_ROWS + 2 * qs.partitions + 2);
+        rows.count = 0;
+    }
+
+    for (int d = 0; d < DEVICES; d++) {
+        for (int c = 0; c < 3; c++) {
+            FreeRows(&reference[d][c]);
+        }
+    }
+    FreeRows(&rows);
+    struct ImuStoreQuery missing = {"dev9", 0, INT64_MIN, INT64_MAX, INT16_MIN, INT16_MAX};
+    CHECK_EQ(ImuStoreSelect(dir, &missing, CollectRow, &rows, &qs), -1);
+    RemoveDir(dir);
+}
+
+/******************************************************************************
+ * Fake broker
+ ******************************************************************************/
+
+struct Received {
+    struct ImuIngest *ingest;
+    int messages;
+    bool topicOk;
+};
+
+static void Receive(void *context, const char *topic, const uint8_t *payload, size_t len)
+{
+    struct Received *received = context;
+    received->messages++;
+    received->topicOk = received->topicOk && strcmp(topic, "P1_IMU_ESE516_T0") == 0;
+    ImuIngestPayload(received->ingest, (const char *)payload, len, NOW_US);
+}
+
+struct Broker {
+    int listenFd;
+    uint8_t connectFlags;
+    char topic[64];
+    int pubacks;
+    uint16_t ackIds[16];
+    bool pinged;
+    const char *payload[4];
+};
+
+static int BrokerRead(int fd, uint8_t *header, uint8_t *body, uint32_t size)
+{
+    uint32_t len = 0, shift = 0, got = 0;
+    uint8_t b;
+
+    if (recv(fd, header, 1, MSG_WAITALL) != 1) {
+        return -1;
+    }
+    do {
+        if (recv(fd, &b, 1, MSG_WAITALL) != 1) {
+            return -1;
+        }
+        len |= (uint32_t)(b & 0x7F) << shift;
+        shift += 7;
+    } while (b & 0x80);
+    if (len > size) {
+        return -1;
+    }
+    while (got < len) {
+        ssize_t n = recv(fd, body + got, len - got, 0);
+        if (n <= 0) {
+            return -1;
+        }
+        got += (uint32_t)n;
+    }
+    return (int)len;
+}
+
+static void BrokerPublish(int fd, const char *topic, const char *payload, uint8_t qos, uint16_t id, bool dup,
+                          bool slowly)
+{
+    uint8_t packet[1024];
+    size_t topicLen = strlen(topic), payloadLen = strlen(payload);
+    uint32_t len = (uint32_t)(2 + topicLen + ((qos > 0) ? 2 : 0) + payloadLen);
+    size_t n = 0;
+
+    packet[n++] = (uint8_t)(0x30 | (dup ? 0x08 : 0) | (qos << 1));
+    do {
+        packet[n] = len & 0x7F;
+        len >>= 7;
+        packet[n++] |= (len > 0) ? 0x80 : 0;
+    } while (len > 0);
+    packet[n++] = (uint8_t)(topicLen >> 8);
+    packet[n++] = (uint8_t)topicLen;
+    memcpy(packet + n, topic, topicLen);
+    n += topicLen;
+    if (qos > 0) {
+        packet[n++] = (uint8_t)(id >> 8);
+        packet[n++] = (uint8_t)id;
+    }
+    memcpy(packet + n, payload, payloadLen);
+    n += payloadLen;
+    for (size_t i = 0; i < n; i += slowly ? 1 : n) {
+        CHECK(send(fd, packet + i, slowly ? 1 : n, MSG_NOSIGNAL) == (ssize_t)(slowly ? 1 : n));
+        if (slowly) {
+            usleep(200);
+        }
+    }
+}
+
+static void *BrokerRun(void *arg)
+{
+    struct Broker *broker = arg;
+    uint8_t header, body[1024];
+    int fd = accept(broker->listenFd, NULL, NULL), len;
+
+    CHECK(fd >= 0);
+    len = BrokerRead(fd, &header, body, sizeof(body));
+    CHECK_EQ(header, 0x10);
+    CHECK(len > 10 && memcmp(body, "\0\4MQTT\4", 7) == 0);
+    broker->connectFlags = body[7];
+    CHECK(send(fd, "\x20\x02\x00\x00", 4, MSG_NOSIGNAL) == 4);
+
+    // A message queued for a kept session may come ahead of the SUBACK
+    BrokerPublish(fd, "P1_IMU_ESE516_T0", broker->payload[0], 1, 10, false, false);
+    len = BrokerRead(fd, &header, body, sizeof(body));
+    CHECK_EQ(header, 0x82);
+    if (len > 5) {
+        uint16_t topicLen = (uint16_t)((body[2] << 8) | body[3]);
+        snprintf(broker->topic, sizeof(broker->topic), "%.*s", topicLen, (const char *)body + 4);
+        CHECK_EQ(body[4 + topicLen], 1);
+    }
+    CHECK(send(fd, "\x90\x03\x00\x01\x01", 5, MSG_NOSIGNAL) == 5);
+
+    BrokerPublish(fd, "P1_IMU_ESE516_T0", broker->payload[1], 1, 11, false, true);
+    BrokerPublish(fd, "P1_IMU_ESE516_T0", broker->payload[1], 1, 11, true, false);  // Redelivered, no PUBACK seen
+    BrokerPublish(fd, "P1_IMU_ESE516_T0", broker->payload[2], 0, 0, false, false);
+    BrokerPublish(fd, "P1_IMU_ESE516_T0", broker->payload[3], 1, 300, false, false);
+
+    while ((len = BrokerRead(fd, &header, body, sizeof(body))) >= 0) {
+        if (header == 0x40 && len == 2 && broker->pubacks < 16) {
+            broker->ackIds[broker->pubacks++] = (uint16_t)((body[0] << 8) | body[1]);
+        } else if (header == 0xC0) {
+            broker->pinged = true;
+            CHECK(send(fd, "\xD0\x00", 2, MSG_NOSIGNAL) == 2);
+            break;
+        }
+    }
+    close(fd);
+    return NULL;
+}
+
+static void TestMqtt(void)
+{
+    char *dir = TempDir();
+    struct ImuStore *store = ImuStoreOpen(dir);
+    struct ImuIngest *ingest = ImuIngestOpen(store);
+    struct sockaddr_in addr = {.sin_family = AF_INET, .sin_addr.s_addr = htonl(INADDR_LOOPBACK)};
+    socklen_t addrLen = sizeof(addr);
+    const char *topics[] = {"P1_IMU_ESE516_T0"};
+    struct MqttSubscriberOptions options = {"127.0.0.1", 0, "test", false, 1, topics, 1};
+    struct ImuIngestStats stats;
+    struct Broker broker = {0};
+    char payloads[4][FIRMWARE_PAYLOAD_MAX];
+    struct MqttSubscriber *sub;
+    pthread_t thread;
+    struct Received received = {ingest, 0, true};
+    int n = 0;
+    uint64_t start;
+
+    for (int i = 0; i < 4; i++) {
+        struct ImuIngestMessage m = Message(DEVICE_A, 1, (uint32_t)i, 1000 + i * 200000, 16, 7);
+        CHECK(ImuIngestFormat(payloads[i], sizeof(payloads[i]), &m) > 0);
+        broker.payload[i] = payloads[i];
+    }
+    broker.listenFd = socket(AF_INET, SOCK_STREAM, 0);
+    CHECK_EQ(bind(broker.listenFd, (struct sockaddr *)&addr, sizeof(addr)), 0);
+    CHECK_EQ(listen(broker.listenFd, 1), 0);
+    CHECK_EQ(getsockname(broker.listenFd, (struct sockaddr *)&addr, &addrLen), 0);
+    options.port = ntohs(addr.sin_port);
+    pthread_create(&thread, NULL, BrokerRun, &broker);
+
+    sub = MqttSubscriberConnect(&options, 2000);
+    CHECK(sub != NULL);
+    start = HostTestNowNs();
+    while (sub != NULL && (n = MqttSubscriberPoll(sub, 50, Receive, &received)) >= 0 &&
+           HostTestNowNs() - start < 5000000000ull) {
+    }
+    CHECK_EQ(n, -1);  // The broker hung up after the ping
+    MqttSubscriberClose(sub);
+    pthread_join(thread, NULL);
+    close(broker.listenFd);
+
+    CHECK_EQ(broker.connectFlags, 0x00);  // Session kept
+    CHECK(strcmp(broker.topic, "P1_IMU_ESE516_T0") == 0);
+    CHECK_EQ(received.messages, 5);
+    CHECK(received.topicOk);
+    CHECK_EQ(broker.pubacks, 4);  // Every QoS 1 delivery, after it was handled
+    CHECK_EQ(broker.ackIds[0], 10);
+    CHECK_EQ(broker.ackIds[1], 11);
+    CHECK_EQ(broker.ackIds[2], 11);
+    CHECK_EQ(broker.ackIds[3], 300);
+    CHECK(broker.pinged);
+    ImuIngestGetStats(ingest, &stats);
+    CHECK_EQ(stats.messages, 5);
+    CHECK_EQ(stats.duplicates, 1);
+    CHECK_EQ(stats.samples, 4 * 16);
+    CHECK_EQ(stats.events, 4 * 16 * 3);
+    ImuIngestClose(ingest);
+    CHECK_EQ(ImuStoreClose(store), 0);
+    RemoveDir(dir);
+}
+
+int main(void)
+{
+    RUN_TEST(TestDecode);
+    RUN_TEST(TestWorstCase);
+    RUN_TEST(TestDedupe);
+    RUN_TEST(TestClock);
+    RUN_TEST(TestStore);
+    RUN_TEST(TestMqtt);
+    return HOST_TEST_RESULT();
+}
@@ -0,0 +1,173 @@
+/**************************************************************************/ /**
+ * @file      TestSerialFrame.c
+ * @brief     Host tests of the UART frame format: the CRC at every alignment, hand-checked COBS encodings, random
+ *            frames through the ring encoder and the decoder across the ring wrap, the worst case size bound, and
+ *            damaged frames.
+ * @date      2026-10-19
+
+ ******************************************************************************/
+
+#include <crc32.h>
+#include <string.h>
+
+#include "HostTest.h"
+#include "SerialConsole/SerialFrame.h"
+
+#define RING_SIZE 512  ///< TX_BUFFER_SIZE of the console
+
+static uint8_t ring[RING_SIZE];
+
+/// Encodes header, payload and CRC like SerialStreamWrite; returns the encoded length, delimiter included
+static uint16_t Encode(uint16_t start, const uint8_t *frame, uint16_t len)
+{
+    struct SerialCobs cobs;
+    crc32_t crc;
+
+    crc32_calculate(frame, len, &crc);
+    SerialCobsBegin(&cobs, ring, RING_SIZE - 1, start);
+    for (uint16_t i = 0; i < len; i++) {
+        SerialCobsPut(&cobs, frame[i]);
+    }
+    for (uint8_t i = 0; i < SERIAL_STREAM_CRC_SIZE; i++) {
+        SerialCobsPut(&cobs, (uint8_t)(crc >> (8 * i)));
+    }
+    return (uint16_t)(SerialCobsEnd(&cobs) - start);
+}
+
+/// Copies the encoded frame out of the ring, as the receiver collects it
+static void Collect(uint16_t start, uint16_t len, uint8_t *out)
+{
+    for (uint16_t i = 0; i < len; i++) {
+        out[i] = ring[(uint16_t)(start + i) & (RING_SIZE - 1)];
+    }
+}
+
+/// Bitwise CRC-32 (IEEE 802.3) to check the word at a time ASF implementation against
+static uint32_t ReferenceCrc(const uint8_t *data, size_t len)
+{
+    uint32_t crc = 0xFFFFFFFFu;
+    for (size_t i = 0; i < len; i++) {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320u : crc >> 1;
+        }
+    }
+    return ~crc;
+}
+
+static void TestCrcAlignment(void)
+{
+    // Short buffers used to be read from the wrong end of their word, e.g. the two byte frame header
+    static uint32_t words[8];
+    uint8_t *bytes = (uint8_t *)words;
+    uint32_t rng = 0x0C4C32u;
+    crc32_t crc;
+
+    for (size_t i = 0; i < sizeof(words); i++) {
+        bytes[i] = (uint8_t)HostTestRandom(&rng);
+    }
+    for (size_t offset = 0; offset < 4; offset++) {
+        for (size_t len = 0; len + offset <= sizeof(words); len++) {
+            crc32_calculate(&bytes[offset], len, &crc);
+            CHECK_EQ(crc, ReferenceCrc(&bytes[offset], len));
+            for (size_t split = 0; split <= len; split++) {
+                crc32_calculate(&bytes[offset], split, &crc);
+                crc32_recalculate(&bytes[offset + split], len - split, &crc);
+                CHECK_EQ(crc, ReferenceCrc(&bytes[offset], len));
+            }
+        }
+    }
+}
+
+static void TestKnownEncoding(void)
+{
+    // The CRC-32 check value: "123456789" gives 0xCBF43926, so the frame has no zero byte and one COBS block
+    const uint8_t frame[] = "123456789";
+    const uint8_t expect[] = {0x0E, '1', '2', '3', '4', '5', '6', '7', '8', '9', 0x26, 0x39, 0xF4, 0xCB, 0x00};
+    // Type 0, seq 0, no payload: every byte of the frame is a zero
+    const uint8_t zeros[] = {0x00, 0x00};
+    crc32_t crc;
+    uint8_t encoded[32];
+    uint8_t decoded[32];
+
+    CHECK_EQ(Encode(0, frame, 9), sizeof(expect));
+    Collect(0, sizeof(expect), encoded);
+    CHECK(memcmp(encoded, expect, sizeof(expect)) == 0);
+    CHECK_EQ(SerialFrameDecode(encoded, sizeof(expect) - 1, decoded, sizeof(decoded)), 9);
+    CHECK(memcmp(decoded, frame, 9) == 0);
+    CHECK_EQ(SerialFrameDecode(encoded, sizeof(expect) - 1, decoded, 12), -1);  // Does not fit
+    CHECK_EQ(SerialFrameDecode(encoded, 0, decoded, sizeof(decoded)), 0);       // Back to back delimiters
+
+    crc32_calculate(zeros, sizeof(zeros), &crc);
+    CHECK_EQ(Encode(0, zeros, sizeof(zeros)), 1 + 1 + 1 + SERIAL_STREAM_CRC_SIZE + 1);
+    CHECK_EQ(ring[0], 0x01);
+    CHECK_EQ(ring[1], 0x01);
+    CHECK_EQ(SerialFrameDecode(ring, 1 + 1 + 1 + SERIAL_STREAM_CRC_SIZE, decoded, sizeof(decoded)), 2);
+}
+
+static void TestRoundTrip(void)
+{
+    uint32_t rng = 0xC0B5C0B5u;
+    uint16_t start = RING_SIZE - 40;  // The first frames wrap around the end of the ring
+
+    for (int round = 0; round < 20000; round++) {
+        uint8_t frame[SERIAL_FRAME_MAX_SIZE];
+        uint8_t encoded[SERIAL_FRAME_ENCODED_SIZE(SERIAL_STREAM_MAX_PAYLOAD)];
+        uint8_t decoded[SERIAL_FRAME_MAX_SIZE];
+        uint16_t payload = HostTestRandom(&rng) % (SERIAL_STREAM_MAX_PAYLOAD + 1);
+        uint16_t len = SERIAL_STREAM_HEADER_SIZE + payload;
+        uint8_t zeros = HostTestRandom(&rng) % 4;  // None, few, many, all zero bytes
+
+        for (uint16_t i = 0; i < len; i++) {
+            uint32_t r = HostTestRandom(&rng);
+            frame[i] = (zeros == 0) ? (uint8_t)(1 + r % 255) : (zeros == 3) ? 0 : (r % (zeros == 1 ? 64 : 3) == 0) ? 0 : (uint8_t)r;
+        }
+        uint16_t encodedLen = Encode(start, frame, len);
+        CHECK(encodedLen <= SERIAL_FRAME_ENCODED_SIZE(payload));
+        Collect(start, encodedLen, encoded);
+        CHECK_EQ(encoded[encodedLen - 1], 0x00);
+        CHECK(memchr(encoded, 0x00, encodedLen - 1) == NULL);
+
+        CHECK_EQ(SerialFrameDecode(encoded, encodedLen - 1, decoded, sizeof(decoded)), len);
+        CHECK(memcmp(decoded, frame, len) == 0);
+        start += encodedLen;
+    }
+}
+
+static void TestDamagedFrames(void)
+{
+    uint32_t rng = 0xBADF00Du;
+
+    for (int round = 0; round < 2000; round++) {
+        uint8_t frame[64];
+        uint8_t encoded[2 * SERIAL_FRAME_ENCODED_SIZE(64)];
+        uint8_t decoded[SERIAL_FRAME_MAX_SIZE];
+        uint16_t len = SERIAL_STREAM_HEADER_SIZE + HostTestRandom(&rng) % (sizeof(frame) - SERIAL_STREAM_HEADER_SIZE);
+
+        for (uint16_t i = 0; i < len; i++) {
+            frame[i] = (uint8_t)HostTestRandom(&rng);
+        }
+        uint16_t encodedLen = Encode(0, frame, len) - 1;
+        Collect(0, encodedLen, encoded);
+
+        // Every single bit error is rejected: by the COBS structure or by the CRC
+        uint16_t bit = HostTestRandom(&rng) % (encodedLen * 8);
+        encoded[bit / 8] ^= (uint8_t)(1u << (bit % 8));
+        CHECK_EQ(SerialFrameDecode(encoded, encodedLen, decoded, sizeof(decoded)), -1);
+        encoded[bit / 8] ^= (uint8_t)(1u << (bit % 8));
+
+        // A frame cut short, or two frames run together after a lost delimiter, too
+        CHECK_EQ(SerialFrameDecode(encoded, encodedLen - 1 - HostTestRandom(&rng) % (encodedLen - 1), decoded, sizeof(decoded)), -1);
+        memcpy(&encoded[encodedLen], encoded, encodedLen);
+        CHECK_EQ(SerialFrameDecode(encoded, 2 * encodedLen, decoded, sizeof(decoded)), -1);
+    }
+}
+
+int main(void)
+{
+    RUN_TEST(TestCrcAlignment);
+    RUN_TEST(TestKnownEncoding);
+    RUN_TEST(TestRoundTrip);
+    RUN_TEST(TestDamagedFrames);
+    return HOST_TEST_RESULT();
+}
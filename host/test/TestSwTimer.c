@@ -0,0 +1,197 @@
+/**************************************************************************/ /**
+ * @file      TestSwTimer.c
+ * @brief     Host tests of the software timer heap against a reference model: random arm, re-arm, cancel and
+ *            unregister sequences over all timers, callbacks that change other timers, and tick wrap around.
+ * @date      2026-10-19
+
+ ******************************************************************************/
+
+#include <string.h>
+
+#include "HostTest.h"
+#include "iot/sw_timer.h"
+
+#define TEST_ACCURACY 10
+
+/// Reference model of one timer, with expire times that never wrap
+struct ModelTimer {
+    bool used;
+    bool enabled;
+    int64_t expire;
+    uint32_t period;
+};
+
+static struct sw_timer_module timers;
+static struct ModelTimer model[CONF_SW_TIMER_COUNT];
+static int64_t now;
+static uint32_t tick;  ///< Mirror of the tick count in sw_timer.c, which keeps running across tests
+static uint32_t fired[CONF_SW_TIMER_COUNT];
+static uint32_t firedCount;
+static int cancelFromCallback = -1;
+
+static void Callback(struct sw_timer_module *const module, int timer_id, void *context, int period)
+{
+    CHECK(context == &model[timer_id]);
+    fired[firedCount++] = (uint32_t)timer_id;
+    if (cancelFromCallback >= 0 && cancelFromCallback != timer_id) {
+        sw_timer_disable_callback(module, cancelFromCallback);
+        model[cancelFromCallback].enabled = false;
+    }
+}
+
+static void Setup(uint32_t startTick)
+{
+    struct sw_timer_config config;
+
+    memset(&timers, 0, sizeof(timers));
+    memset(model, 0, sizeof(model));
+    sw_timer_get_config_defaults(&config);
+    config.accuracy = TEST_ACCURACY;
+    sw_timer_init(&timers, &config);
+    now = 0;
+    sw_timer_host_advance(startTick - tick);
+    tick = startTick;
+    cancelFromCallback = -1;
+}
+
+static void Advance(uint32_t ticks)
+{
+    sw_timer_host_advance(ticks);
+    tick += ticks;
+    now += ticks;
+}
+
+static uint32_t ModelNextExpiry(void)
+{
+    int64_t best = INT64_MAX;
+    for (int i = 0; i < CONF_SW_TIMER_COUNT; i++) {
+        if (model[i].enabled && model[i].expire < best) {
+            best = model[i].expire;
+        }
+    }
+    if (best == INT64_MAX) {
+        return SW_TIMER_NO_EXPIRY;
+    }
+    return best + 1 - now <= 0 ? 0 : (uint32_t)(best + 1 - now) * TEST_ACCURACY;
+}
+
+/// Runs sw_timer_task and checks that exactly the due timers fired, then applies the same to the model
+static void RunTask(void)
+{
+    bool due[CONF_SW_TIMER_COUNT] = {false};
+    uint32_t expected = 0;
+
+    for (int i = 0; i < CONF_SW_TIMER_COUNT; i++) {
+        if (model[i].enabled && model[i].expire < now) {
+            due[i] = true;
+            expected++;
+        }
+    }
+    firedCount = 0;
+    sw_timer_task(&timers);
+    CHECK(firedCount <= expected);
+    for (uint32_t k = 0; k < firedCount; k++) {
+        int id = (int)fired[k];
+        CHECK(due[id]);
+        due[id] = false;
+        if (model[id].period > 0) {
+            model[id].expire = now + model[id].period;
+        } else {
+            model[id].enabled = false;
+        }
+    }
+    // A due timer that did not fire was cancelled by the callback of one that fired before it
+    for (int i = 0; i < CONF_SW_TIMER_COUNT; i++) {
+        CHECK(!due[i] || !model[i].enabled);
+    }
+}
+
+static void TestRandomOperations(uint32_t startTick)
+{
+    uint32_t seed = 0xC0FFEEu ^ startTick;
+    int ids[CONF_SW_TIMER_COUNT];
+
+    Setup(startTick);
+    for (int i = 0; i < CONF_SW_TIMER_COUNT; i++) {
+        uint32_t period = (HostTestRandom(&seed) % 3 == 0) ? 0 : (1 + HostTestRandom(&seed) % 500) * TEST_ACCURACY;
+        ids[i] = sw_timer_register_callback(&timers, Callback, &model[i], period);
+        CHECK_EQ(ids[i], i);
+        model[i].used = true;
+        model[i].period = period / TEST_ACCURACY;
+    }
+    CHECK_EQ(sw_timer_register_callback(&timers, Callback, NULL, 0), -1);
+    CHECK_EQ(sw_timer_next_expiry(&timers), SW_TIMER_NO_EXPIRY);
+
+    for (int step = 0; step < 20000; step++) {
+        uint32_t op = HostTestRandom(&seed) % 16;
+        int id = (int)(HostTestRandom(&seed) % CONF_SW_TIMER_COUNT);
+
+        if (op < 7) {
+            // Arm, or re-arm while pending
+            uint32_t delay = (HostTestRandom(&seed) % 1000) * TEST_ACCURACY;
+            if (!model[id].used) {
+                continue;
+            }
+            sw_timer_enable_callback(&timers, id, delay);
+            model[id].enabled = true;
+            model[id].expire = now + delay / TEST_ACCURACY;
+        } else if (op < 9) {
+            sw_timer_disable_callback(&timers, id);
+            model[id].enabled = false;
+        } else if (op < 10) {
+            // Unregister and register again, the free slot is reused
+            uint32_t period = model[id].period * TEST_ACCURACY;
+            sw_timer_unregister_callback(&timers, id);
+            model[id].enabled = false;
+            CHECK_EQ(sw_timer_register_callback(&timers, Callback, &model[id], period), id);
+        } else {
+            Advance(HostTestRandom(&seed) % 40);
+            cancelFromCallback = (op == 15) ? (int)(HostTestRandom(&seed) % CONF_SW_TIMER_COUNT) : -1;
+            RunTask();
+        }
+        CHECK_EQ(sw_timer_next_expiry(&timers), ModelNextExpiry());
+        if (hostTestFailures) {
+            fprintf(stderr, "start tick %u, step %d\n", (unsigned)startTick, step);
+            return;
+        }
+    }
+}
+
+static void TestRandomOperationsNoWrap(void)
+{
+    TestRandomOperations(0);
+}
+
+static void TestRandomOperationsAcrossWrap(void)
+{
+    // Expire times straddle the 32-bit wrap of the tick count
+    TestRandomOperations(UINT32_MAX - 5000);
+}
+
+static void TestPeriodicFiresOncePerPeriod(void)
+{
+    int id;
+    uint32_t count = 0;
+
+    Setup(0);
+    id = sw_timer_register_callback(&timers, Callback, &model[0], 5 * TEST_ACCURACY);
+    model[0].used = true;
+    model[0].period = 5;
+    sw_timer_enable_callback(&timers, id, 0);
+    model[0].enabled = true;
+    model[0].expire = now;
+    for (int t = 0; t < 100; t++) {
+        Advance(1);
+        RunTask();
+        count += firedCount;
+    }
+    CHECK_EQ(count, 17);  // At tick 1, then every 6 ticks: fires on the first tick after the expire time
+}
+
+int main(void)
+{
+    RUN_TEST(TestRandomOperationsNoWrap);
+    RUN_TEST(TestRandomOperationsAcrossWrap);
+    RUN_TEST(TestPeriodicFiresOncePerPeriod);
+    return HOST_TEST_RESULT();
+}
@@ -0,0 +1,1393 @@
+/**************************************************************************/ /**
+ * @file      CaptureExport.c
+ * @brief     Exports the capture segments of an SD card as a VCD file or a sigrok session file. Each segment is cut
+ *            into chunks of CAPTURE_EXPORT_CHUNK_SECTORS sectors. A chunk decodes on its own once it has a seed: the
+ *            event dictionary and the clock at its start. The work-stealing pool first scans each segment for
+ *            the seeds of its chunks, which only walks the record headers and the event dictionary, then decodes
+ *            and formats the chunks. The calling thread writes the chunks in order as they complete.
+ * @date      2026-10-19
+
+ ******************************************************************************/
+
+#include "CaptureExport.h"
+
+#include <fcntl.h>
+#include <glob.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "CaptureCodec/CaptureCodec.h"
+#include "CaptureSegments/CaptureSegments.h"
+#include "EventDedup/EventDedup.h"
+#include "SerialConsole.h"
+
+#define EXPORT_CHUNK_BYTES ((size_t)CAPTURE_EXPORT_CHUNK_SECTORS * CAPTURE_SEGMENTS_SECTOR)
+#define EXPORT_BLOCK_MAX (CAPTURE_CODEC_HEADER + 255 * 6)  ///< Capture payload of 255 samples of three axes
+#define EXPORT_SCAN UINT32_MAX                             ///< ExportTask.chunk of the scan of a segment
+#define EXPORT_NO_TIME INT64_MIN
+#define EXPORT_CHUNKS_PER_THREAD 4  ///< Chunks decoded ahead of the writer, which bounds the memory in use
+#define EXPORT_CRC_POLYNOMIAL 0xEDB88320u  ///< Reflected, as crc32.c and zip
+
+/// Signals of the VCD file, in the order of exportSignals
+enum ExportSignal {
+    SIGNAL_X,
+    SIGNAL_Y,
+    SIGNAL_Z,
+    SIGNAL_BUSY,
+    SIGNAL_ADDRESS,
+    SIGNAL_REGISTER,
+    SIGNAL_STATUS,
+    SIGNAL_COUNT
+};
+
+static const struct {
+    const char *scope;
+    const char *type;
+    const char *name;
+    uint8_t width;
+    char id;
+} exportSignals[SIGNAL_COUNT] = {
+    {"imu", "integer", "x", 16, 'x'},        {"imu", "integer", "y", 16, 'y'},
+    {"imu", "integer", "z", 16, 'z'},        {"i2c", "wire", "busy", 1, 'b'},
+    {"i2c", "wire", "address", 16, 'a'},     {"i2c", "wire", "register", 16, 'r'},
+    {"i2c", "integer", "status", 32, 's'},
+};
+
+static pthread_once_t exportCrcOnce = PTHREAD_ONCE_INIT;
+static uint32_t exportCrcTable[256];
+
+/// LSM6DSO output data rates, the sample rate of a sigrok file is snapped to the nearest one
+static const double exportRatesHz[] = {12.5, 26, 52, 104, 208, 416, 833, 1666, 3333, 6666};
+
+/// A value change. Changes at the same time keep the order they were made in.
+struct ExportChange {
+    int64_t t;
+    uint32_t value;
+    uint8_t signal;
+};
+
+struct ExportChanges {
+    struct ExportChange *item;
+    size_t count;
+    size_t size;
+};
+
+/// Changes not yet formatted, from first on
+struct ExportQueue {
+    struct ExportChanges list;
+    size_t first;
+};
+
+struct ExportText {
+    char *data;
+    size_t len;
+    size_t size;
+};
+
+/// A bus transaction in a sigrok file
+struct ExportEvent {
+    int64_t start;
+    int64_t end;
+    bool error;
+    bool used;  ///< Marked on a sample
+};
+
+/// Device clock of a segment. Record times are 32 bit microseconds. Each one is taken relative to the time of the
+/// record before it as a signed difference, which follows the counter across its wrap.
+struct ExportClock {
+    int64_t refRel;   ///< Time of the last record, relative to first32
+    int64_t maxRel;   ///< Latest record time so far, relative to first32
+    uint32_t ref32;   ///< Time of the last record
+    uint32_t first32; ///< First time in the segment
+    bool timed;
+};
+
+/// What a chunk needs from the records before it
+struct ExportSeed {
+    struct EventDedupDictionary dict;
+    struct ExportClock clock;
+};
+
+/// VCD formatting state: the time written last and the value of each signal
+struct VcdState {
+    int64_t t;
+    bool timed;
+    uint32_t known;  ///< Signals with a value
+    uint32_t value[SIGNAL_COUNT];
+};
+
+/// Output of one chunk
+struct ExportChunk {
+    bool done;
+    struct CaptureExportStats stats;
+    // VCD: the changes that may have to go before those of the previous chunk, the formatted changes, and the
+    // changes that those of the next chunk may have to go before
+    struct ExportChanges head;
+    struct ExportText text;
+    struct ExportChanges tail;
+    int64_t textFirstT;   ///< Time of the first line of text
+    size_t textSkip;      ///< Length of the first line of text, the time line
+    struct VcdState textState;
+    // sigrok: the samples, with their times for the logic channels, and the bus transactions
+    size_t samples;
+    size_t sampleSize;
+    int64_t *sampleT;
+    float *axis[3];
+    uint32_t axisCrc[3];
+    struct ExportEvent *event;
+    size_t events;
+    size_t eventSize;
+};
+
+struct ExportSegment {
+    char *path;
+    struct CaptureSegmentHeader header;
+    uint32_t chunks;
+    struct ExportSeed *seed;   ///< One per chunk, from the scan
+    struct ExportClock clock;  ///< At the end of the segment, from the scan
+    bool scanned;
+    bool released;             ///< Time base set and chunks queued
+    int64_t base;              ///< Exported time of clock.first32
+    int64_t before;            ///< Latest record time of the segments before, EXPORT_NO_TIME for none
+    struct ExportChunk *chunk;
+};
+
+/// Work of a pool thread: the scan of a segment, or one chunk
+struct ExportTask {
+    uint32_t segment;
+    uint32_t chunk;
+};
+
+/// Tasks of one pool thread. The owner takes the newest from the bottom, the others steal the oldest from the top.
+struct ExportDeque {
+    pthread_mutex_t lock;
+    struct ExportTask *task;
+    size_t top;
+    size_t bottom;
+};
+
+struct CaptureExport {
+    const struct CaptureExportOptions *options;
+    uint32_t windowUs;
+    unsigned threads;
+    struct ExportSegment *segment;
+    uint32_t segments;
+    struct ExportDeque *deque;
+    pthread_mutex_t lock;   ///< Everything below, and the segments' scanned, released and chunk[].done
+    pthread_cond_t work;    ///< Tasks queued, or quit
+    pthread_cond_t ready;   ///< A segment released or a chunk done
+    size_t queued;          ///< Tasks in the deques not yet claimed
+    bool quit;
+    bool failed;
+    uint32_t nextBase;      ///< Next segment to release
+    uint32_t released;      ///< Chunks released
+    uint32_t written;       ///< Chunks written
+    uint32_t window;        ///< Chunks released ahead of the writer
+    unsigned nextDeque;
+    bool timed;             ///< Clock of the segments released so far
+    int64_t end;
+    int64_t max;
+    uint32_t last32;
+    uint32_t restarts;
+    uint64_t outBytes;
+};
+
+struct ExportWorker {
+    struct CaptureExport *ex;
+    unsigned index;
+    pthread_t thread;
+};
+
+/// State while the records of a chunk are walked. out is NULL in the scan, which only follows dict and clock.
+struct ExportWork {
+    struct CaptureExport *ex;
+    struct ExportChunk *out;
+    struct CaptureExportStats *stats;
+    struct EventDedupDictionary dict;
+    struct ExportClock clock;
+    int64_t base;
+    int64_t head;  ///< Changes before this time go to the head of the chunk
+    struct ExportQueue queue;
+    struct VcdState vcd;
+};
+
+struct ZipEntry {
+    char name[24];
+    uint32_t crc;
+    uint32_t size;
+    uint64_t offset;
+};
+
+/// Writer side of a sigrok file: a zip archive of stored entries
+struct ExportSr {
+    struct ZipEntry *entry;
+    size_t entries;
+    size_t entrySize;
+    uint32_t dosTime;
+    uint32_t chunk;
+    struct ExportEvent *pending;  ///< Bus transactions not yet past the samples written
+    struct ExportChunk *held;     ///< Written once the transactions of the next chunk are in
+    size_t count;
+    size_t size;
+    uint8_t *logic;
+    size_t logicSize;
+    uint64_t samples;
+    int64_t firstT;
+    int64_t lastT;
+};
+
+/// Writer side of a VCD file
+struct ExportVcd {
+    struct VcdState state;
+    struct ExportChanges pending;  ///< Tails and heads of chunks not yet written, in time order
+    struct ExportText text;
+};
+
+static void *ExportGrow(void *p, size_t *size, size_t need, size_t elem)
+{
+    if (need <= *size) {
+        return p;
+    }
+    size_t size2 = (*size < 64) ? 64 : *size;
+    while (size2 < need) {
+        size2 *= 2;
+    }
+    p = realloc(p, size2 * elem);
+    if (p == NULL) {
+        abort();
+    }
+    *size = size2;
+    return p;
+}
+
+static uint32_t ExportLe32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void ExportPut(uint8_t *p, uint64_t value, unsigned bytes)
+{
+    for (unsigned i = 0; i < bytes; i++) {
+        p[i] = (uint8_t)(value >> (8 * i));
+    }
+}
+
+static void ExportCrcInit(void)
+{
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t c = i;
+        for (unsigned bit = 0; bit < 8; bit++) {
+            c = (c & 1) ? (c >> 1) ^ EXPORT_CRC_POLYNOMIAL : c >> 1;
+        }
+        exportCrcTable[i] = c;
+    }
+}
+
+/// The CRC-32 of crc32.c, a byte at a time from a table: the zip entries hold hundreds of MB
+static uint32_t ExportCrc(const void *data, size_t len)
+{
+    const uint8_t *p = data;
+    uint32_t crc = 0xFFFFFFFFu;
+
+    pthread_once(&exportCrcOnce, ExportCrcInit);
+    while (len-- > 0) {
+        crc = exportCrcTable[(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+/******************************************************************************
+ * Clock
+ ******************************************************************************/
+
+/// Time of a record field relative to the first time of the segment
+static int64_t ExportClockAt(struct ExportClock *clock, uint32_t t)
+{
+    if (!clock->timed) {
+        clock->timed = true;
+        clock->first32 = t;
+        clock->ref32 = t;
+        clock->refRel = 0;
+        clock->maxRel = 0;
+    }
+    return clock->refRel + (int32_t)(t - clock->ref32);
+}
+
+/// Moves the clock to the time of the record just walked: the last sample of a block, the end of an event
+static void ExportClockSet(struct ExportClock *clock, int64_t rel, uint32_t t)
+{
+    clock->refRel = rel;
+    clock->ref32 = t;
+    if (rel > clock->maxRel) {
+        clock->maxRel = rel;
+    }
+}
+
+/******************************************************************************
+ * VCD formatting
+ ******************************************************************************/
+
+static char *ExportReserve(struct ExportText *text, size_t n)
+{
+    text->data = ExportGrow(text->data, &text->size, text->len + n, 1);
+    return text->data + text->len;
+}
+
+static void VcdTime(struct ExportText *text, int64_t t)
+{
+    char digits[20], *p = ExportReserve(text, 24), *start = p;
+    unsigned n = 0;
+    uint64_t v = (uint64_t)t;
+
+    do {
+        digits[n++] = (char)('0' + v % 10);
+        v /= 10;
+    } while (v != 0);
+    *p++ = '#';
+    while (n > 0) {
+        *p++ = digits[--n];
+    }
+    *p++ = '\n';
+    text->len += (size_t)(p - start);
+}
+
+/// Vectors are written without their leading zeros, which VCD extends them with
+static void VcdValue(struct ExportText *text, uint8_t signal, uint32_t value)
+{
+    char *p = ExportReserve(text, 40), *start = p;
+    int bit = exportSignals[signal].width - 1;
+
+    if (bit == 0) {
+        *p++ = (char)('0' + (value & 1));
+    } else {
+        *p++ = 'b';
+        while (bit > 0 && !((value >> bit) & 1)) {
+            bit--;
+        }
+        for (; bit >= 0; bit--) {
+            *p++ = (char)('0' + ((value >> bit) & 1));
+        }
+        *p++ = ' ';
+    }
+    *p++ = exportSignals[signal].id;
+    *p++ = '\n';
+    text->len += (size_t)(p - start);
+}
+
+/// Formats a change unless the signal already has its value. A change before the last time written is written at
+/// that time and counted as late.
+static void VcdChange(struct ExportText *text, struct VcdState *state, const struct ExportChange *change, uint64_t *late)
+{
+    uint8_t signal = change->signal;
+    int64_t t = (change->t < 0) ? 0 : change->t;
+
+    if ((state->known & (1u << signal)) && state->value[signal] == change->value) {
+        return;
+    }
+    if (state->timed && t < state->t) {
+        t = state->t;
+        (*late)++;
+    }
+    if (!state->timed || t != state->t) {
+        VcdTime(text, t);
+        state->t = t;
+        state->timed = true;
+    }
+    state->known |= 1u << signal;
+    state->value[signal] = change->value;
+    VcdValue(text, signal, change->value);
+}
+
+/******************************************************************************
+ * Changes
+ ******************************************************************************/
+
+static void ExportAppend(struct ExportChanges *list, const struct ExportChange *change)
+{
+    list->item = ExportGrow(list->item, &list->size, list->count + 1, sizeof(*change));
+    list->item[list->count++] = *change;
+}
+
+/// Merges b into a, both in time order. At equal times the changes of a come first.
+static void ExportMerge(struct ExportChanges *a, const struct ExportChanges *b)
+{
+    size_t i = a->count, j = b->count, k = a->count + b->count;
+
+    if (b->count == 0) {
+        return;
+    }
+    a->item = ExportGrow(a->item, &a->size, k, sizeof(a->item[0]));
+    while (j > 0) {
+        a->item[--k] = (i > 0 && a->item[i - 1].t > b->item[j - 1].t) ? a->item[--i] : b->item[--j];
+    }
+    a->count += b->count;
+}
+
+/// Changes waiting in time order. Records come nearly in time order, so a change is mostly appended at the end.
+static void ExportQueuePush(struct ExportQueue *queue, const struct ExportChange *change)
+{
+    struct ExportChanges *list = &queue->list;
+    size_t i = list->count;
+
+    if (queue->first > 0 && queue->first == list->count) {
+        queue->first = list->count = i = 0;
+    } else if (queue->first >= 4096 && 2 * queue->first >= list->count) {
+        memmove(list->item, list->item + queue->first, (list->count - queue->first) * sizeof(list->item[0]));
+        list->count -= queue->first;
+        queue->first = 0;
+        i = list->count;
+    }
+    ExportAppend(list, change);
+    while (i > queue->first && list->item[i - 1].t > change->t) {
+        list->item[i] = list->item[i - 1];
+        i--;
+    }
+    list->item[i] = *change;
+}
+
+/******************************************************************************
+ * Records
+ ******************************************************************************/
+
+static void ExportPush(struct ExportWork *w, int64_t t, uint8_t signal, uint32_t value)
+{
+    struct ExportChange change = {t, value, signal};
+
+    ExportQueuePush(&w->queue, &change);
+}
+
+/// Formats the changes no later record can go before: a record holds no time more than windowUs before the
+/// latest record time. With all, the rest goes to the tail.
+static void ExportFlush(struct ExportWork *w, bool all)
+{
+    struct ExportChunk *out = w->out;
+    int64_t until = w->base + w->clock.maxRel - (int64_t)w->ex->windowUs;
+
+    while (w->queue.first < w->queue.list.count && (all || w->queue.list.item[w->queue.first].t < until)) {
+        struct ExportChange change = w->queue.list.item[w->queue.first++];
+        if (change.t < w->head) {
+            ExportAppend(&out->head, &change);
+        } else if (all) {
+            ExportAppend(&out->tail, &change);
+        } else {
+            bool first = (out->text.len == 0);
+            VcdChange(&out->text, &w->vcd, &change, &out->stats.late);
+            if (first && out->text.len > 0) {
+                out->textFirstT = w->vcd.t;
+                out->textSkip = (size_t)((char *)memchr(out->text.data, '\n', out->text.len) - out->text.data) + 1;
+            }
+        }
+    }
+}
+
+static void ExportSample(struct ExportChunk *out, int64_t t, const int16_t *v)
+{
+    if (out->samples == out->sampleSize) {
+        size_t size = out->sampleSize;
+        out->sampleT = ExportGrow(out->sampleT, &size, out->samples + 1, sizeof(out->sampleT[0]));
+        for (unsigned a = 0; a < 3; a++) {
+            size = out->sampleSize;
+            out->axis[a] = ExportGrow(out->axis[a], &size, out->samples + 1, sizeof(float));
+        }
+        out->sampleSize = size;
+    }
+    for (unsigned a = 0; a < 3; a++) {
+        out->axis[a][out->samples] = v[a];
+    }
+    out->sampleT[out->samples++] = t;
+}
+
+/// Capture block: samples evenly spaced between t0 and t1, see ImuFifo.c. Axes that are not enabled are 0 in a
+/// sigrok file. The scan only reads the header, which a packed block sends as it is.
+static void ExportBlock(struct ExportWork *w, uint8_t type, const uint8_t *payload, uint16_t len)
+{
+    uint8_t raw[EXPORT_BLOCK_MAX];
+
+    if (len < CAPTURE_CODEC_HEADER) {
+        w->stats->malformed++;
+        return;
+    }
+    uint32_t t0 = ExportLe32(payload), t1 = ExportLe32(payload + 4), span = t1 - t0;
+    uint8_t mask = payload[8], count = payload[9];
+    int64_t rel = ExportClockAt(&w->clock, t0);
+    ExportClockSet(&w->clock, rel + span, t1);
+    if (w->out == NULL) {
+        return;
+    }
+
+    if (type == SERIAL_STREAM_CAPTURE_PACKED) {
+        int32_t n = CaptureCodecDecode(payload, len, raw, sizeof(raw));
+        if (n < 0) {
+            w->stats->malformed++;
+            return;
+        }
+        payload = raw;
+        len = (uint16_t)n;
+    }
+    uint8_t channels = (uint8_t)((mask & 1) + ((mask >> 1) & 1) + ((mask >> 2) & 1));
+    if (channels == 0 || (mask & ~7u) || len != CAPTURE_CODEC_HEADER + 2u * count * channels) {
+        w->stats->malformed++;
+        return;
+    }
+
+    const uint8_t *p = payload + CAPTURE_CODEC_HEADER;
+    bool vcd = (w->ex->options->format == CAPTURE_EXPORT_VCD);
+    w->stats->samples += count;
+    for (unsigned i = 0; i < count; i++) {
+        int64_t t = w->base + rel + ((count > 1) ? (int64_t)span * i / (count - 1) : 0);
+        int16_t v[3] = {0, 0, 0};
+        for (uint8_t a = 0; a < 3; a++) {
+            if (mask & (1 << a)) {
+                v[a] = (int16_t)(p[0] | (p[1] << 8));
+                p += 2;
+                if (vcd) {
+                    ExportPush(w, t, (uint8_t)(SIGNAL_X + a), (uint16_t)v[a]);
+                }
+            }
+        }
+        if (!vcd) {
+            ExportSample(w->out, t, v);
+        }
+    }
+}
+
+/// Bus event: address (2), register (2), status (4), start (4), duration (4)
+static void ExportEvent(struct ExportWork *w, const uint8_t *event)
+{
+    uint32_t start = ExportLe32(event + 8), duration = ExportLe32(event + 12), status = ExportLe32(event + 4);
+    int64_t rel = ExportClockAt(&w->clock, start);
+    ExportClockSet(&w->clock, rel + duration, start + duration);
+    if (w->out == NULL) {
+        return;
+    }
+
+    int64_t t = w->base + rel;
+    w->stats->events++;
+    if (w->ex->options->format == CAPTURE_EXPORT_VCD) {
+        ExportPush(w, t, SIGNAL_BUSY, 1);
+        ExportPush(w, t, SIGNAL_ADDRESS, (uint32_t)(event[0] | (event[1] << 8)));
+        ExportPush(w, t, SIGNAL_REGISTER, (uint32_t)(event[2] | (event[3] << 8)));
+        ExportPush(w, t, SIGNAL_STATUS, status);
+        ExportPush(w, t + duration, SIGNAL_BUSY, 0);
+    } else {
+        struct ExportChunk *out = w->out;
+        out->event = ExportGrow(out->event, &out->eventSize, out->events + 1, sizeof(out->event[0]));
+        out->event[out->events++] = (struct ExportEvent){t, t + duration, status != 0, false};
+    }
+}
+
+/// The scan must follow the dictionary and the clock exactly as the chunks do, so both go through here
+static void ExportRecord(struct ExportWork *w, uint8_t type, const uint8_t *payload, uint16_t len)
+{
+    uint8_t event[EVENT_DEDUP_EVENT_SIZE];
+    int8_t res;
+
+    w->stats->records++;
+    switch (type) {
+        case SERIAL_STREAM_CAPTURE:
+        case SERIAL_STREAM_CAPTURE_PACKED:
+            ExportBlock(w, type, payload, len);
+            break;
+        case SERIAL_STREAM_EVENT:
+            if (len == EVENT_DEDUP_EVENT_SIZE) {
+                ExportEvent(w, payload);
+            } else {
+                w->stats->malformed++;
+            }
+            break;
+        case SERIAL_STREAM_EVENT_TEMPLATE:
+        case SERIAL_STREAM_EVENT_REPEAT:
+            res = (len <= EVENT_DEDUP_SEED_SIZE) ? EventDedupDecode(&w->dict, type, payload, (uint8_t)len, event)
+                                                  : EVENT_DEDUP_MALFORMED;
+            if (res == EVENT_DEDUP_EVENT_SIZE) {
+                ExportEvent(w, event);
+            } else if (res == EVENT_DEDUP_LOST) {
+                w->stats->lostEvents++;
+            } else {
+                w->stats->malformed++;
+            }
+            break;
+        default:
+            w->stats->malformed++;
+            break;
+    }
+    if (w->out != NULL && w->ex->options->format == CAPTURE_EXPORT_VCD) {
+        ExportFlush(w, false);
+    }
+}
+
+/// Walks the records of whole sectors: a record never crosses a sector and a zero type byte ends its records
+static void ExportSectors(struct ExportWork *w, const uint8_t *data, size_t len)
+{
+    for (size_t s = 0; s + CAPTURE_SEGMENTS_SECTOR <= len; s += CAPTURE_SEGMENTS_SECTOR) {
+        const uint8_t *sector = data + s;
+        uint16_t pos = 0;
+        while (pos + CAPTURE_SEGMENTS_RECORD_HEADER <= CAPTURE_SEGMENTS_SECTOR && sector[pos] != 0) {
+            uint16_t plen = (uint16_t)(sector[pos + 1] | (sector[pos + 2] << 8));
+            if (pos + CAPTURE_SEGMENTS_RECORD_HEADER + plen > CAPTURE_SEGMENTS_SECTOR) {
+                w->stats->malformed++;
+                break;
+            }
+            ExportRecord(w, sector[pos], sector + pos + CAPTURE_SEGMENTS_RECORD_HEADER, plen);
+            pos = (uint16_t)(pos + CAPTURE_SEGMENTS_RECORD_HEADER + plen);
+        }
+    }
+}
+
+/// Reads the records of a chunk into buffer and returns their length, whole sectors
+static size_t ExportRead(struct CaptureExport *ex, const struct ExportSegment *seg, uint32_t c, uint8_t *buffer)
+{
+    size_t offset = (size_t)c * EXPORT_CHUNK_BYTES, len = seg->header.used - offset, done = 0;
+    int fd = open(seg->path, O_RDONLY);
+
+    len = (len > EXPORT_CHUNK_BYTES) ? EXPORT_CHUNK_BYTES : len;
+    while (fd >= 0 && done < len) {
+        ssize_t n = pread(fd, buffer + done, len - done, (off_t)(CAPTURE_SEGMENTS_SECTOR + offset + done));
+        if (n <= 0) {
+            break;
+        }
+        done += (size_t)n;
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+    if (done < len) {
+        pthread_mutex_lock(&ex->lock);
+        ex->failed = true;
+        pthread_mutex_unlock(&ex->lock);
+    }
+    return done - done % CAPTURE_SEGMENTS_SECTOR;
+}
+
+/// Records the seed of each chunk and the clock at the end of the segment
+static void ExportScan(struct CaptureExport *ex, struct ExportSegment *seg, uint8_t *buffer)
+{
+    struct CaptureExportStats ignored;
+    struct ExportWork w;
+
+    memset(&w, 0, sizeof(w));
+    w.ex = ex;
+    w.stats = &ignored;
+    EventDedupInit(&w.dict);
+    for (uint32_t c = 0; c < seg->chunks; c++) {
+        seg->seed[c].dict = w.dict;
+        seg->seed[c].clock = w.clock;
+        ExportSectors(&w, buffer, ExportRead(ex, seg, c, buffer));
+    }
+    seg->clock = w.clock;
+}
+
+static void ExportFormat(struct CaptureExport *ex, struct ExportSegment *seg, uint32_t c, uint8_t *buffer)
+{
+    struct ExportChunk *out = &seg->chunk[c];
+    struct ExportWork w;
+    size_t len;
+
+    memset(&w, 0, sizeof(w));
+    w.ex = ex;
+    w.out = out;
+    w.stats = &out->stats;
+    w.dict = seg->seed[c].dict;
+    w.clock = seg->seed[c].clock;
+    w.base = seg->base;
+    // Every change of the chunks before is at or before the latest record time so far
+    w.head = seg->before;
+    if (w.clock.timed && seg->base + w.clock.maxRel > w.head) {
+        w.head = seg->base + w.clock.maxRel;
+    }
+
+    len = ExportRead(ex, seg, c, buffer);
+    out->stats.bytes = len;
+    ExportSectors(&w, buffer, len);
+    if (ex->options->format == CAPTURE_EXPORT_VCD) {
+        ExportFlush(&w, true);
+        out->textState = w.vcd;
+        free(w.queue.list.item);
+    } else {
+        for (unsigned a = 0; a < 3; a++) {
+            out->axisCrc[a] = ExportCrc(out->axis[a], out->samples * sizeof(float));
+        }
+    }
+}
+
+/******************************************************************************
+ * Pool
+ ******************************************************************************/
+
+static void ExportDequePush(struct ExportDeque *d, struct ExportTask task)
+{
+    pthread_mutex_lock(&d->lock);
+    if (d->top == d->bottom) {
+        d->top = d->bottom = 0;
+    }
+    d->task[d->bottom++] = task;
+    pthread_mutex_unlock(&d->lock);
+}
+
+static bool ExportDequePop(struct ExportDeque *d, struct ExportTask *task)
+{
+    bool ok;
+
+    pthread_mutex_lock(&d->lock);
+    ok = (d->bottom > d->top);
+    if (ok) {
+        *task = d->task[--d->bottom];
+    }
+    pthread_mutex_unlock(&d->lock);
+    return ok;
+}
+
+static bool ExportDequeSteal(struct ExportDeque *d, struct ExportTask *task)
+{
+    bool ok;
+
+    pthread_mutex_lock(&d->lock);
+    ok = (d->bottom > d->top);
+    if (ok) {
+        *task = d->task[d->top++];
+    }
+    pthread_mutex_unlock(&d->lock);
+    return ok;
+}
+
+/// Sets the time base of the scanned segments in order and queues their chunks, as far as the window allows.
+/// The chunks go to the deque of the thread that got here, self, or in turn when the writer did (self = threads).
+/// Called with the lock held.
+static void ExportRelease(struct CaptureExport *ex, unsigned self)
+{
+    while (ex->nextBase < ex->segments && ex->segment[ex->nextBase].scanned && ex->released - ex->written < ex->window) {
+        uint32_t k = ex->nextBase++;
+        struct ExportSegment *seg = &ex->segment[k];
+
+        seg->before = ex->max;
+        if (seg->clock.timed) {
+            if (!ex->timed) {
+                seg->base = seg->clock.first32;
+            } else {
+                // Segments follow each other, so the time between them is short. A clock that goes back further
+                // than a record may be late is a new boot: the segment goes on from the end of the previous one.
+                int64_t gap = (int32_t)(seg->clock.first32 - ex->last32);
+                seg->base = ex->end + gap;
+                if (gap < -(int64_t)ex->windowUs) {
+                    seg->base = ex->end;
+                    ex->restarts++;
+                }
+            }
+            ex->timed = true;
+            ex->end = seg->base + seg->clock.refRel;
+            ex->last32 = seg->clock.ref32;
+            if (seg->base + seg->clock.maxRel > ex->max) {
+                ex->max = seg->base + seg->clock.maxRel;
+            }
+        }
+
+        seg->chunk = calloc(seg->chunks ? seg->chunks : 1, sizeof(seg->chunk[0]));
+        if (seg->chunk == NULL) {
+            abort();
+        }
+        seg->released = true;
+        ex->released += seg->chunks;
+        unsigned d = (self < ex->threads) ? self : ex->nextDeque++ % ex->threads;
+        // Chunk 0 ends up at the bottom, where the owner takes it first
+        for (uint32_t c = seg->chunks; c-- > 0;) {
+            ExportDequePush(&ex->deque[d], (struct ExportTask){k, c});
+        }
+        ex->queued += seg->chunks;
+        pthread_cond_broadcast(&ex->work);
+        pthread_cond_broadcast(&ex->ready);
+    }
+}
+
+/// Claims one of the queued tasks, then looks for it in the own deque and the others
+static bool ExportTake(struct CaptureExport *ex, unsigned self, struct ExportTask *task)
+{
+    pthread_mutex_lock(&ex->lock);
+    while (ex->queued == 0 && !ex->quit) {
+        pthread_cond_wait(&ex->work, &ex->lock);
+    }
+    if (ex->queued == 0) {
+        pthread_mutex_unlock(&ex->lock);
+        return false;
+    }
+    ex->queued--;
+    pthread_mutex_unlock(&ex->lock);
+
+    for (;;) {
+        if (ExportDequePop(&ex->deque[self], task)) {
+            return true;
+        }
+        for (unsigned i = 1; i < ex->threads; i++) {
+            if (ExportDequeSteal(&ex->deque[(self + i) % ex->threads], task)) {
+                return true;
+            }
+        }
+        sched_yield();
+    }
+}
+
+static void *ExportWorkerThread(void *arg)
+{
+    struct ExportWorker *worker = arg;
+    struct CaptureExport *ex = worker->ex;
+    uint8_t *buffer = malloc(EXPORT_CHUNK_BYTES);
+    struct ExportTask task;
+
+    if (buffer == NULL) {
+        abort();
+    }
+    while (ExportTake(ex, worker->index, &task)) {
+        struct ExportSegment *seg = &ex->segment[task.segment];
+        if (task.chunk == EXPORT_SCAN) {
+            ExportScan(ex, seg, buffer);
+            pthread_mutex_lock(&ex->lock);
+            seg->scanned = true;
+            ExportRelease(ex, worker->index);
+        } else {
+            ExportFormat(ex, seg, task.chunk, buffer);
+            pthread_mutex_lock(&ex->lock);
+            seg->chunk[task.chunk].done = true;
+            pthread_cond_broadcast(&ex->ready);
+        }
+        pthread_mutex_unlock(&ex->lock);
+    }
+    free(buffer);
+    return NULL;
+}
+
+/******************************************************************************
+ * Writers
+ ******************************************************************************/
+
+static void ExportOut(struct CaptureExport *ex, const void *data, size_t len)
+{
+    if (len > 0 && fwrite(data, 1, len, ex->options->out) != len) {
+        ex->failed = true;
+    }
+    ex->outBytes += len;
+}
+
+static void ExportOutText(struct CaptureExport *ex, struct ExportText *text)
+{
+    ExportOut(ex, text->data, text->len);
+    text->len = 0;
+}
+
+static void VcdHeader(struct CaptureExport *ex, struct ExportText *text)
+{
+    uint32_t fat = (ex->segments > 0) ? ex->segment[0].header.start : 0;
+    const char *scope = NULL;
+    int n;
+
+    if (fat != 0) {
+        n = snprintf(ExportReserve(text, 64), 64, "$date %04u-%02u-%02u %02u:%02u:%02u $end\n", 1980 + (fat >> 25),
+                     (fat >> 21) & 15, (fat >> 16) & 31, (fat >> 11) & 31, (fat >> 5) & 63, 2 * (fat & 31));
+        text->len += (size_t)n;
+    }
+    n = snprintf(ExportReserve(text, 128), 128, "$version capture_export $end\n$timescale 1us $end\n$scope module analyzer $end\n");
+    text->len += (size_t)n;
+    for (unsigned s = 0; s < SIGNAL_COUNT; s++) {
+        if (scope == NULL || strcmp(scope, exportSignals[s].scope) != 0) {
+            n = snprintf(ExportReserve(text, 64), 64, "%s$scope module %s $end\n", scope ? "$upscope $end\n" : "",
+                         exportSignals[s].scope);
+            text->len += (size_t)n;
+            scope = exportSignals[s].scope;
+        }
+        n = snprintf(ExportReserve(text, 64), 64, "$var %s %u %c %s $end\n", exportSignals[s].type,
+                     exportSignals[s].width, exportSignals[s].id, exportSignals[s].name);
+        text->len += (size_t)n;
+    }
+    n = snprintf(ExportReserve(text, 64), 64, "$upscope $end\n$upscope $end\n$enddefinitions $end\n");
+    text->len += (size_t)n;
+}
+
+/// Writes the pending changes that go before the text of the chunk, then the text. Its head joins the pending
+/// changes first, its tail after.
+static void VcdChunk(struct CaptureExport *ex, struct ExportVcd *vcd, struct ExportChunk *chunk, uint64_t *late)
+{
+    size_t n = 0;
+
+    ExportMerge(&vcd->pending, &chunk->head);
+    if (chunk->text.len > 0) {
+        while (n < vcd->pending.count && vcd->pending.item[n].t <= chunk->textFirstT) {
+            VcdChange(&vcd->text, &vcd->state, &vcd->pending.item[n++], late);
+        }
+        ExportOutText(ex, &vcd->text);
+        size_t skip = (vcd->state.timed && vcd->state.t == chunk->textFirstT) ? chunk->textSkip : 0;
+        ExportOut(ex, chunk->text.data + skip, chunk->text.len - skip);
+        vcd->state.t = chunk->textState.t;
+        vcd->state.timed = true;
+        vcd->state.known |= chunk->textState.known;
+        for (unsigned s = 0; s < SIGNAL_COUNT; s++) {
+            if (chunk->textState.known & (1u << s)) {
+                vcd->state.value[s] = chunk->textState.value[s];
+            }
+        }
+        if (n > 0) {
+            memmove(vcd->pending.item, vcd->pending.item + n, (vcd->pending.count - n) * sizeof(vcd->pending.item[0]));
+            vcd->pending.count -= n;
+        }
+    }
+    ExportMerge(&vcd->pending, &chunk->tail);
+}
+
+static void VcdFinish(struct CaptureExport *ex, struct ExportVcd *vcd, uint64_t *late)
+{
+    for (size_t n = 0; n < vcd->pending.count; n++) {
+        VcdChange(&vcd->text, &vcd->state, &vcd->pending.item[n], late);
+    }
+    ExportOutText(ex, &vcd->text);
+    free(vcd->pending.item);
+    free(vcd->text.data);
+}
+
+/// Stored zip entry. Sizes fit in 32 bits, the offset may not, which the central directory handles.
+static void ZipAdd(struct CaptureExport *ex, struct ExportSr *sr, const char *name, const void *data, uint32_t size, uint32_t crc)
+{
+    uint8_t h[30];
+    size_t nameLen = strlen(name);
+
+    sr->entry = ExportGrow(sr->entry, &sr->entrySize, sr->entries + 1, sizeof(sr->entry[0]));
+    struct ZipEntry *e = &sr->entry[sr->entries++];
+    snprintf(e->name, sizeof(e->name), "%s", name);
+    e->crc = crc;
+    e->size = size;
+    e->offset = ex->outBytes;
+
+    ExportPut(h, 0x04034B50, 4);
+    ExportPut(h + 4, 20, 2);  // Version needed
+    ExportPut(h + 6, 0, 4);   // Flags, method: stored
+    ExportPut(h + 10, sr->dosTime & 0xFFFF, 2);
+    ExportPut(h + 12, sr->dosTime >> 16, 2);
+    ExportPut(h + 14, crc, 4);
+    ExportPut(h + 18, size, 4);
+    ExportPut(h + 22, size, 4);
+    ExportPut(h + 26, nameLen, 2);
+    ExportPut(h + 28, 0, 2);
+    ExportOut(ex, h, sizeof(h));
+    ExportOut(ex, name, nameLen);
+    ExportOut(ex, data, size);
+}
+
+/// Central directory, with the zip64 records once entries or offsets no longer fit the classic ones
+static void ZipFinish(struct CaptureExport *ex, struct ExportSr *sr)
+{
+    uint64_t start = ex->outBytes, size;
+    uint8_t h[56];
+
+    for (size_t i = 0; i < sr->entries; i++) {
+        const struct ZipEntry *e = &sr->entry[i];
+        bool far = (e->offset >= 0xFFFFFFFFu);
+        size_t nameLen = strlen(e->name);
+
+        ExportPut(h, 0x02014B50, 4);
+        ExportPut(h + 4, far ? 45 : 20, 2);  // Made by
+        ExportPut(h + 6, far ? 45 : 20, 2);  // Needed
+        ExportPut(h + 8, 0, 4);
+        ExportPut(h + 12, sr->dosTime & 0xFFFF, 2);
+        ExportPut(h + 14, sr->dosTime >> 16, 2);
+        ExportPut(h + 16, e->crc, 4);
+        ExportPut(h + 20, e->size, 4);
+        ExportPut(h + 24, e->size, 4);
+        ExportPut(h + 28, nameLen, 2);
+        ExportPut(h + 30, far ? 12 : 0, 2);
+        memset(h + 32, 0, 10);  // Comment, disk, attributes
+        ExportPut(h + 42, far ? 0xFFFFFFFFu : e->offset, 4);
+        ExportOut(ex, h, 46);
+        ExportOut(ex, e->name, nameLen);
+        if (far) {
+            ExportPut(h, 1, 2);
+            ExportPut(h + 2, 8, 2);
+            ExportPut(h + 4, e->offset, 8);
+            ExportOut(ex, h, 12);
+        }
+    }
+    size = ex->outBytes - start;
+    if (sr->entries >= 0xFFFF || start >= 0xFFFFFFFFu || size >= 0xFFFFFFFFu) {
+        uint64_t record = ex->outBytes;
+        ExportPut(h, 0x06064B50, 4);
+        ExportPut(h + 4, 44, 8);
+        ExportPut(h + 12, 45, 2);
+        ExportPut(h + 14, 45, 2);
+        ExportPut(h + 16, 0, 8);  // Disks
+        ExportPut(h + 24, sr->entries, 8);
+        ExportPut(h + 32, sr->entries, 8);
+        ExportPut(h + 40, size, 8);
+        ExportPut(h + 48, start, 8);
+        ExportOut(ex, h, 56);
+        ExportPut(h, 0x07064B50, 4);
+        ExportPut(h + 4, 0, 4);
+        ExportPut(h + 8, record, 8);
+        ExportPut(h + 16, 1, 4);
+        ExportOut(ex, h, 20);
+    }
+    ExportPut(h, 0x06054B50, 4);
+    ExportPut(h + 4, 0, 4);
+    ExportPut(h + 8, (sr->entries >= 0xFFFF) ? 0xFFFF : sr->entries, 2);
+    ExportPut(h + 10, (sr->entries >= 0xFFFF) ? 0xFFFF : sr->entries, 2);
+    ExportPut(h + 12, (size >= 0xFFFFFFFFu) ? 0xFFFFFFFFu : size, 4);
+    ExportPut(h + 16, (start >= 0xFFFFFFFFu) ? 0xFFFFFFFFu : start, 4);
+    ExportPut(h + 20, 0, 2);
+    ExportOut(ex, h, 22);
+}
+
+static void ExportFreeChunk(struct ExportChunk *chunk)
+{
+    free(chunk->head.item);
+    free(chunk->text.data);
+    free(chunk->tail.item);
+    free(chunk->sampleT);
+    for (unsigned a = 0; a < 3; a++) {
+        free(chunk->axis[a]);
+    }
+    free(chunk->event);
+}
+
+/// Writes the held chunk. The logic channels of a sample are set by the bus transactions that overlap it, up to
+/// the next sample, which may be the first of nextT's chunk. A transaction that ends before the first sample still
+/// to be written came too late and is counted as such.
+static void SrWrite(struct CaptureExport *ex, struct ExportSr *sr, int64_t nextT, uint64_t *late)
+{
+    struct ExportChunk *chunk = sr->held;
+    char name[24];
+    size_t first = 0;
+
+    sr->logic = ExportGrow(sr->logic, &sr->logicSize, chunk->samples + 4, 1);
+    for (size_t i = 0; i < chunk->samples; i++) {
+        int64_t t = chunk->sampleT[i];
+        int64_t next = (i + 1 < chunk->samples) ? chunk->sampleT[i + 1]
+                       : (nextT != EXPORT_NO_TIME) ? nextT
+                                                   : t + ((i > 0) ? t - chunk->sampleT[i - 1] : 1);
+        uint8_t bits = 0;
+        while (first < sr->count && sr->pending[first].end < t) {
+            *late += !sr->pending[first].used;
+            first++;
+        }
+        for (size_t e = first; e < sr->count && sr->pending[e].start < next; e++) {
+            if (sr->pending[e].end >= t) {
+                bits |= (uint8_t)(1 | (sr->pending[e].error << 1));
+                sr->pending[e].used = true;
+            }
+        }
+        sr->logic[i] = bits;
+    }
+    memmove(sr->pending, sr->pending + first, (sr->count - first) * sizeof(sr->pending[0]));
+    sr->count -= first;
+
+    if (sr->samples == 0) {
+        sr->firstT = chunk->sampleT[0];
+    }
+    sr->lastT = chunk->sampleT[chunk->samples - 1];
+    sr->samples += chunk->samples;
+    sr->chunk++;
+    snprintf(name, sizeof(name), "logic-1-%u", sr->chunk);
+    ZipAdd(ex, sr, name, sr->logic, (uint32_t)chunk->samples, ExportCrc(sr->logic, chunk->samples));
+    for (unsigned a = 0; a < 3; a++) {
+        snprintf(name, sizeof(name), "analog-1-%u-%u", 3 + a, sr->chunk);
+        ZipAdd(ex, sr, name, chunk->axis[a], (uint32_t)(chunk->samples * sizeof(float)), chunk->axisCrc[a]);
+    }
+}
+
+/// Adds the bus transactions of a chunk, then writes the chunk held before it and holds this one, as a transaction
+/// of this chunk may overlap the last samples of that one. Returns the chunk that is done with, or NULL.
+static struct ExportChunk *SrChunk(struct CaptureExport *ex, struct ExportSr *sr, struct ExportChunk *chunk, uint64_t *late)
+{
+    struct ExportChunk *done = NULL;
+
+    for (size_t e = 0; e < chunk->events; e++) {
+        size_t i = sr->count;
+        sr->pending = ExportGrow(sr->pending, &sr->size, sr->count + 1, sizeof(sr->pending[0]));
+        while (i > 0 && sr->pending[i - 1].start > chunk->event[e].start) {
+            sr->pending[i] = sr->pending[i - 1];
+            i--;
+        }
+        sr->pending[i] = chunk->event[e];
+        sr->count++;
+    }
+    if (chunk->samples == 0) {
+        return chunk;
+    }
+    if (sr->held != NULL) {
+        SrWrite(ex, sr, chunk->sampleT[0], late);
+        done = sr->held;
+    }
+    sr->held = chunk;
+    return done;
+}
+
+static void SrFinish(struct CaptureExport *ex, struct ExportSr *sr, uint64_t *late)
+{
+    double hz = 0;
+    char meta[512];
+
+    if (sr->held != NULL) {
+        SrWrite(ex, sr, EXPORT_NO_TIME, late);
+        ExportFreeChunk(sr->held);
+    }
+
+    if (sr->samples > 1 && sr->lastT > sr->firstT) {
+        hz = (double)(sr->samples - 1) * 1e6 / (double)(sr->lastT - sr->firstT);
+        for (unsigned i = 0; i < sizeof(exportRatesHz) / sizeof(exportRatesHz[0]); i++) {
+            if (hz > exportRatesHz[i] * 0.9 && hz < exportRatesHz[i] * 1.1) {
+                hz = exportRatesHz[i];
+            }
+        }
+    }
+    int n = snprintf(meta, sizeof(meta),
+                     "[global]\nsigrok version=0.5.2\n\n[device 1]\ncapturefile=logic-1\ntotal probes=2\n"
+                     "samplerate=%.0f Hz\ntotal analog=3\nprobe1=i2c_busy\nprobe2=i2c_error\nanalog3=imu_x\n"
+                     "analog4=imu_y\nanalog5=imu_z\nunitsize=1\n",
+                     hz);
+    ZipAdd(ex, sr, "metadata", meta, (uint32_t)n, ExportCrc(meta, (size_t)n));
+    ZipFinish(ex, sr);
+    free(sr->entry);
+    free(sr->pending);
+    free(sr->logic);
+}
+
+/// Writes the chunks in order as the pool completes them
+static void ExportWrite(struct CaptureExport *ex, struct CaptureExportStats *stats)
+{
+    struct ExportVcd vcd;
+    struct ExportSr sr;
+
+    memset(&vcd, 0, sizeof(vcd));
+    memset(&sr, 0, sizeof(sr));
+    if (ex->options->format == CAPTURE_EXPORT_VCD) {
+        VcdHeader(ex, &vcd.text);
+    } else {
+        sr.dosTime = (ex->segments > 0) ? ex->segment[0].header.start : 0;
+        ZipAdd(ex, &sr, "version", "2", 1, ExportCrc("2", 1));
+    }
+
+    for (uint32_t k = 0; k < ex->segments; k++) {
+        struct ExportSegment *seg = &ex->segment[k];
+        pthread_mutex_lock(&ex->lock);
+        while (!seg->released) {
+            pthread_cond_wait(&ex->ready, &ex->lock);
+        }
+        pthread_mutex_unlock(&ex->lock);
+
+        for (uint32_t c = 0; c < seg->chunks; c++) {
+            struct ExportChunk *chunk = &seg->chunk[c];
+            pthread_mutex_lock(&ex->lock);
+            while (!chunk->done) {
+                pthread_cond_wait(&ex->ready, &ex->lock);
+            }
+            pthread_mutex_unlock(&ex->lock);
+
+            struct ExportChunk *done = chunk;
+            if (ex->options->format == CAPTURE_EXPORT_VCD) {
+                VcdChunk(ex, &vcd, chunk, &stats->late);
+            } else {
+                done = SrChunk(ex, &sr, chunk, &stats->late);
+            }
+            stats->bytes += chunk->stats.bytes;
+            stats->records += chunk->stats.records;
+            stats->samples += chunk->stats.samples;
+            stats->events += chunk->stats.events;
+            stats->lostEvents += chunk->stats.lostEvents;
+            stats->malformed += chunk->stats.malformed;
+            stats->late += chunk->stats.late;
+            if (done != NULL) {
+                ExportFreeChunk(done);
+            }
+
+            pthread_mutex_lock(&ex->lock);
+            ex->written++;
+            ExportRelease(ex, ex->threads);
+            pthread_mutex_unlock(&ex->lock);
+        }
+        stats->segments++;
+    }
+
+    if (ex->options->format == CAPTURE_EXPORT_VCD) {
+        VcdFinish(ex, &vcd, &stats->late);
+    } else {
+        SrFinish(ex, &sr, &stats->late);
+    }
+}
+
+/******************************************************************************
+ * Segments
+ ******************************************************************************/
+
+static int ExportCompareSeq(const void *a, const void *b)
+{
+    uint32_t x = ((const struct ExportSegment *)a)->header.seq, y = ((const struct ExportSegment *)b)->header.seq;
+    return (x > y) - (x < y);
+}
+
+/// Reads the header of each file and keeps the written segments, in the order they were filled
+static void ExportLoad(struct CaptureExport *ex, struct CaptureExportStats *stats)
+{
+    const struct CaptureExportOptions *options = ex->options;
+
+    ex->segment = calloc(options->count ? options->count : 1, sizeof(ex->segment[0]));
+    if (ex->segment == NULL) {
+        abort();
+    }
+    for (unsigned i = 0; i < options->count; i++) {
+        struct CaptureSegmentHeader header;
+        FILE *fp = fopen(options->paths[i], "rb");
+        long size = -1;
+        bool ok = false;
+
+        if (fp != NULL) {
+            ok = (fread(&header, sizeof(header), 1, fp) == 1) && fseek(fp, 0, SEEK_END) == 0;
+            size = ftell(fp);
+            fclose(fp);
+        }
+        ok = ok && header.magic == CAPTURE_SEGMENTS_MAGIC && header.version == CAPTURE_SEGMENTS_VERSION && header.seq != 0 &&
+             header.check == ExportCrc(&header, offsetof(struct CaptureSegmentHeader, check)) &&
+             size >= CAPTURE_SEGMENTS_SECTOR;
+        if (!ok) {
+            stats->skipped++;
+            continue;
+        }
+        // The file may have been copied off the card cut short
+        if ((uint64_t)header.used > (uint64_t)size - CAPTURE_SEGMENTS_SECTOR) {
+            header.used = (uint32_t)(size - CAPTURE_SEGMENTS_SECTOR);
+        }
+        header.used -= header.used % CAPTURE_SEGMENTS_SECTOR;
+
+        struct ExportSegment *seg = &ex->segment[ex->segments++];
+        seg->path = strdup(options->paths[i]);
+        seg->header = header;
+        seg->chunks = (uint32_t)((header.used + EXPORT_CHUNK_BYTES - 1) / EXPORT_CHUNK_BYTES);
+        seg->seed = calloc(seg->chunks ? seg->chunks : 1, sizeof(seg->seed[0]));
+        if (seg->path == NULL || seg->seed == NULL) {
+            abort();
+        }
+    }
+    qsort(ex->segment, ex->segments, sizeof(ex->segment[0]), ExportCompareSeq);
+}
+
+/******************************************************************************
+ * Global Functions
+ ******************************************************************************/
+
+/// Decodes the segment files in options and writes them to options->out. Returns 0, or -1 when a file could not
+/// be read or the output not written; stats are filled in either way.
+int CaptureExportRun(const struct CaptureExportOptions *options, struct CaptureExportStats *stats)
+{
+    struct CaptureExport *ex = calloc(1, sizeof(*ex));
+    struct ExportWorker *worker;
+    size_t tasks;
+    int result;
+
+    memset(stats, 0, sizeof(*stats));
+    if (ex == NULL) {
+        return -1;
+    }
+    ex->options = options;
+    ex->windowUs = options->windowUs ? options->windowUs : CAPTURE_EXPORT_WINDOW_US;
+    ex->threads = options->threads ? options->threads : CaptureExportCores();
+    ex->threads = (ex->threads > CAPTURE_EXPORT_MAX_THREADS) ? CAPTURE_EXPORT_MAX_THREADS : ex->threads;
+    ex->window = EXPORT_CHUNKS_PER_THREAD * ex->threads;
+    ex->max = EXPORT_NO_TIME;
+    pthread_mutex_init(&ex->lock, NULL);
+    pthread_cond_init(&ex->work, NULL);
+    pthread_cond_init(&ex->ready, NULL);
+    ExportLoad(ex, stats);
+
+    // A deque holds at most every task there is
+    tasks = ex->segments;
+    for (uint32_t k = 0; k < ex->segments; k++) {
+        tasks += ex->segment[k].chunks;
+    }
+    ex->deque = calloc(ex->threads, sizeof(ex->deque[0]));
+    worker = calloc(ex->threads, sizeof(worker[0]));
+    if (ex->deque == NULL || worker == NULL) {
+        abort();
+    }
+    for (unsigned i = 0; i < ex->threads; i++) {
+        pthread_mutex_init(&ex->deque[i].lock, NULL);
+        ex->deque[i].task = malloc((tasks ? tasks : 1) * sizeof(struct ExportTask));
+        if (ex->deque[i].task == NULL) {
+            abort();
+        }
+    }
+    // The scans are dealt out in turn, the first segments at the bottom where their owners start
+    for (uint32_t k = ex->segments; k-- > 0;) {
+        ExportDequePush(&ex->deque[k % ex->threads], (struct ExportTask){k, EXPORT_SCAN});
+    }
+    ex->queued = ex->segments;
+
+    for (unsigned i = 0; i < ex->threads; i++) {
+        worker[i].ex = ex;
+        worker[i].index = i;
+        pthread_create(&worker[i].thread, NULL, ExportWorkerThread, &worker[i]);
+    }
+    ExportWrite(ex, stats);
+    pthread_mutex_lock(&ex->lock);
+    ex->quit = true;
+    pthread_cond_broadcast(&ex->work);
+    pthread_mutex_unlock(&ex->lock);
+    for (unsigned i = 0; i < ex->threads; i++) {
+        pthread_join(worker[i].thread, NULL);
+    }
+
+    stats->restarts = ex->restarts;
+    stats->outBytes = ex->outBytes;
+    result = (ex->failed || fflush(options->out) != 0) ? -1 : 0;
+    for (uint32_t k = 0; k < ex->segments; k++) {
+        free(ex->segment[k].path);
+        free(ex->segment[k].seed);
+        free(ex->segment[k].chunk);
+    }
+    for (unsigned i = 0; i < ex->threads; i++) {
+        pthread_mutex_destroy(&ex->deque[i].lock);
+        free(ex->deque[i].task);
+    }
+    pthread_mutex_destroy(&ex->lock);
+    pthread_cond_destroy(&ex->work);
+    pthread_cond_destroy(&ex->ready);
+    free(ex->deque);
+    free(ex->segment);
+    free(worker);
+    free(ex);
+    return result;
+}
+
+/// Lists the segment files (*.cap) of a directory, such as the root of an SD card. The caller frees each path and
+/// the array. Returns 0, or -1 if the directory cannot be read. (glob, as dirent.h clashes with the DIR of FatFs.)
+int CaptureExportListDir(const char *dir, char ***paths, unsigned *count)
+{
+    char *pattern = malloc(strlen(dir) + sizeof("/*.[cC][aA][pP]"));
+    glob_t found;
+    int result;
+
+    *paths = NULL;
+    *count = 0;
+    if (pattern == NULL) {
+        abort();
+    }
+    sprintf(pattern, "%s/*.[cC][aA][pP]", dir);
+    result = glob(pattern, GLOB_ERR, NULL, &found);
+    free(pattern);
+    if (result == GLOB_NOMATCH) {
+        return 0;
+    }
+    if (result != 0) {
+        return -1;
+    }
+    *paths = malloc((found.gl_pathc ? found.gl_pathc : 1) * sizeof(char *));
+    if (*paths == NULL) {
+        abort();
+    }
+    for (size_t i = 0; i < found.gl_pathc; i++) {
+        (*paths)[(*count)++] = strdup(found.gl_pathv[i]);
+    }
+    globfree(&found);
+    return 0;
+}
+
+unsigned CaptureExportCores(void)
+{
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return (n > 0) ? (unsigned)n : 1;
+}
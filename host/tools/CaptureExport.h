@@ -0,0 +1,51 @@
+/**************************************************************************/ /**
+ * @file      CaptureExport.h
+ * @brief     Exports the capture segments of an SD card (see CaptureSegments.h) as a VCD file or a sigrok session
+ *            file. Segments are cut into chunks that are decoded on all cores by a work-stealing pool, with the
+ *            firmware's capture codec and event dictionary, and written in time order as they complete.
+ * @date      2026-10-19
+
+ ******************************************************************************/
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define CAPTURE_EXPORT_CHUNK_SECTORS 512  ///< Sectors of a segment decoded as one piece of work
+#define CAPTURE_EXPORT_WINDOW_US 5000000  ///< Default of CaptureExportOptions.windowUs
+#define CAPTURE_EXPORT_MAX_THREADS 256
+
+enum CaptureExportFormat {
+    CAPTURE_EXPORT_VCD,  ///< Value change dump, 1 us timescale
+    CAPTURE_EXPORT_SR,   ///< sigrok session file (zip, version 2): samples of the IMU rate
+};
+
+struct CaptureExportOptions {
+    const char *const *paths;  ///< Segment files, in any order. They are sorted by their header sequence number
+    unsigned count;
+    enum CaptureExportFormat format;
+    FILE *out;                 ///< Written from the calling thread only, never seeked
+    unsigned threads;          ///< Decoding threads, 0 for one per core
+    uint32_t windowUs;         ///< How late a record may arrive after the first sample it holds, 0 for the default
+};
+
+/// Totals of an export
+struct CaptureExportStats {
+    uint32_t segments;    ///< Segments exported
+    uint32_t skipped;     ///< Files that are not a written segment: short, a bad header check, or never written
+    uint32_t restarts;    ///< Segments whose clock went back, such as after a reboot. They follow the previous one
+    uint64_t bytes;       ///< Record bytes read
+    uint64_t records;
+    uint64_t samples;     ///< IMU samples
+    uint64_t events;      ///< Bus events decoded
+    uint64_t lostEvents;  ///< Repeats that could not be decoded because a record of their slot was dropped
+    uint64_t malformed;   ///< Records that did not decode
+    uint64_t late;        ///< Changes written later than their time because they came more than windowUs late
+    uint64_t outBytes;    ///< Bytes written to out
+};
+
+int CaptureExportRun(const struct CaptureExportOptions *options, struct CaptureExportStats *stats);
+int CaptureExportListDir(const char *dir, char ***paths, unsigned *count);
+unsigned CaptureExportCores(void);
@@ -0,0 +1,163 @@
+/**************************************************************************/ /**
+ * @file      CaptureExportMain.c
+ * @brief     capture_export: converts the capture segments of an SD card to a VCD or sigrok file on all cores, or
+ *            writes a synthetic capture to try it on.
+ *              capture_export [-f vcd|sr] [-o FILE] [-j THREADS] [-w MS] DIR|SEGMENT...
+ *              capture_export --synth DIR [--mb N] [--segment-mb N] [--pattern NAME] [--seed N]
+ * @date      2026-10-19
+
+ ******************************************************************************/
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "CaptureExport.h"
+#include "CaptureSegments/CaptureSegments.h"
+#include "SegmentSynth.h"
+
+static void Usage(void)
+{
+    fprintf(stderr,
+            "usage: capture_export [-f vcd|sr] [-o FILE] [-j THREADS] [-w MS] DIR|SEGMENT...\n"
+            "       capture_export --synth DIR [--mb N] [--segment-mb N] [--pattern NAME] [--seed N]\n"
+            "  -f         output format, vcd (default) or sr (sigrok session)\n"
+            "  -o         output file, standard output by default\n"
+            "  -j         decoding threads, one per core by default\n"
+            "  -w         how late a record may arrive after its first sample, default %u ms\n"
+            "  --synth    writes a synthetic capture of N MB (default 64) in segments of N MB (default %u)\n",
+            CAPTURE_EXPORT_WINDOW_US / 1000, CAPTURE_SEGMENTS_DEFAULT_MB);
+}
+
+static int Synth(const char *dir, unsigned mb, unsigned segmentMb, const char *pattern, uint32_t seed)
+{
+    struct SegmentSynthConfig config = {dir, (uint64_t)mb << 20, segmentMb << 20, CAPTURE_SYNTH_REST, seed,
+                                        0xFFFFFFFFu - 60000000u, 9615, 6, 0};
+    struct SegmentSynthStats stats;
+
+    for (unsigned p = 0; p < CAPTURE_SYNTH_COUNT; p++) {
+        if (strcmp(pattern, CaptureSynthName((enum CaptureSynthPattern)p)) == 0) {
+            config.pattern = (enum CaptureSynthPattern)p;
+        }
+    }
+    mkdir(dir, 0777);
+    if (SegmentSynthWrite(&config, NULL, NULL, &stats) != 0) {
+        fprintf(stderr, "capture_export: cannot write %u MB of %u MB segments to %s\n", mb, segmentMb, dir);
+        return EXIT_FAILURE;
+    }
+    fprintf(stderr, "%u segments, %llu samples, %llu bus events\n", stats.segments, (unsigned long long)stats.samples,
+            (unsigned long long)stats.events);
+    return EXIT_SUCCESS;
+}
+
+int main(int argc, char **argv)
+{
+    static const struct option longOptions[] = {
+        {"synth", required_argument, NULL, 's'},      {"mb", required_argument, NULL, 'm'},
+        {"segment-mb", required_argument, NULL, 'g'}, {"pattern", required_argument, NULL, 'p'},
+        {"seed", required_argument, NULL, 'e'},       {"help", no_argument, NULL, 'h'},
+        {NULL, 0, NULL, 0},
+    };
+    struct CaptureExportOptions options = {NULL, 0, CAPTURE_EXPORT_VCD, stdout, 0, 0};
+    struct CaptureExportStats stats;
+    const char *synthDir = NULL, *pattern = "rest", *outPath = NULL;
+    unsigned mb = 64, segmentMb = CAPTURE_SEGMENTS_DEFAULT_MB;
+    uint32_t seed = 1;
+    char **paths = NULL;
+    unsigned count = 0;
+    int opt, result;
+
+    while ((opt = getopt_long(argc, argv, "f:o:j:w:h", longOptions, NULL)) != -1) {
+        switch (opt) {
+            case 'f':
+                options.format = (strcmp(optarg, "sr") == 0) ? CAPTURE_EXPORT_SR : CAPTURE_EXPORT_VCD;
+                break;
+            case 'o':
+                outPath = optarg;
+                break;
+            case 'j':
+                options.threads = (unsigned)atoi(optarg);
+                break;
+            case 'w':
+                options.windowUs = (uint32_t)atoi(optarg) * 1000u;
+                break;
+            case 's':
+                synthDir = optarg;
+                break;
+            case 'm':
+                mb = (unsigned)atoi(optarg);
+                break;
+            case 'g':
+                segmentMb = (unsigned)atoi(optarg);
+                break;
+            case 'p':
+                pattern = optarg;
+                break;
+            case 'e':
+                seed = (uint32_t)strtoul(optarg, NULL, 0);
+                break;
+            default:
+                Usage();
+                return (opt == 'h') ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+    if (synthDir != NULL) {
+        return Synth(synthDir, mb, segmentMb, pattern, seed);
+    }
+    if (optind >= argc) {
+        Usage();
+        return EXIT_FAILURE;
+    }
+
+    // A directory stands for its segment files
+    for (int i = optind; i < argc; i++) {
+        struct stat st;
+        char **found;
+        unsigned n;
+        if (stat(argv[i], &st) == 0 && S_ISDIR(st.st_mode)) {
+            if (CaptureExportListDir(argv[i], &found, &n) != 0) {
+                fprintf(stderr, "capture_export: cannot read %s\n", argv[i]);
+                return EXIT_FAILURE;
+            }
+        } else {
+            found = malloc(sizeof(char *));
+            found[0] = strdup(argv[i]);
+            n = 1;
+        }
+        paths = realloc(paths, (count + n) * sizeof(char *));
+        memcpy(paths + count, found, n * sizeof(char *));
+        count += n;
+        free(found);
+    }
+
+    if (outPath != NULL && (options.out = fopen(outPath, "wb")) == NULL) {
+        fprintf(stderr, "capture_export: cannot create %s\n", outPath);
+        return EXIT_FAILURE;
+    }
+    setvbuf(options.out, NULL, _IOFBF, 1 << 20);
+    options.paths = (const char *const *)paths;
+    options.count = count;
+    result = CaptureExportRun(&options, &stats);
+    if (outPath != NULL && fclose(options.out) != 0) {
+        result = -1;
+    }
+
+    fprintf(stderr,
+            "%u segments (%u files skipped, %u restarts), %llu records, %llu samples, %llu bus events, %llu lost, "
+            "%llu malformed, %llu late, %.1f MB in, %.1f MB out\n",
+            stats.segments, stats.skipped, stats.restarts, (unsigned long long)stats.records,
+            (unsigned long long)stats.samples, (unsigned long long)stats.events, (unsigned long long)stats.lostEvents,
+            (unsigned long long)stats.malformed, (unsigned long long)stats.late, stats.bytes / 1048576.0,
+            stats.outBytes / 1048576.0);
+    for (unsigned i = 0; i < count; i++) {
+        free(paths[i]);
+    }
+    free(paths);
+    if (result != 0) {
+        fprintf(stderr, "capture_export: a segment could not be read or the output not written\n");
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,429 @@
+/**************************************************************************/ /**
+ * @file      ImuIngest.c
+ * @brief     Decodes IMU batch messages and stores their samples. The decoder reads the JSON the firmware writes,
+ *            in any key order and with white space, and skips keys it does not know.
+ * @date      2026-10-19
+
+ ******************************************************************************/
+
+#include "ImuIngest.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/// One boot of one device
+struct IngestSource {
+    char device[IMU_STORE_DEVICE_MAX + 1];
+    uint32_t boot;
+    bool used;
+    bool started;    ///< A message was stored, anchorUs and lastUs are set
+    int64_t anchorUs;  ///< Wall clock time of device time 0 of the boot
+    int64_t lastUs;    ///< Unwrapped device time of the first sample of the newest message
+    uint32_t maxSeq;   ///< Newest message number
+    uint64_t seen[IMU_INGEST_SEQ_WINDOW / 64];  ///< Message numbers received, by seq % IMU_INGEST_SEQ_WINDOW
+};
+
+struct ImuIngest {
+    struct ImuStore *store;
+    struct IngestSource *source;  ///< Open addressing table
+    size_t size;
+    struct ImuIngestStats stats;
+    struct ImuIngestMessage message;
+};
+
+/// Bounded reader of a payload, which is not terminated
+struct IngestText {
+    const char *p;
+    const char *end;
+};
+
+/******************************************************************************
+ * JSON
+ ******************************************************************************/
+
+static void IngestSpace(struct IngestText *t)
+{
+    while (t->p < t->end && (*t->p == ' ' || *t->p == '\t' || *t->p == '\r' || *t->p == '\n')) {
+        t->p++;
+    }
+}
+
+static bool IngestTake(struct IngestText *t, char c)
+{
+    IngestSpace(t);
+    if (t->p < t->end && *t->p == c) {
+        t->p++;
+        return true;
+    }
+    return false;
+}
+
+static bool IngestInteger(struct IngestText *t, int64_t min, int64_t max, int64_t *value)
+{
+    bool negative;
+    int64_t v = 0;
+    const char *start;
+
+    IngestSpace(t);
+    negative = t->p < t->end && *t->p == '-';
+    t->p += negative;
+    start = t->p;
+    while (t->p < t->end && *t->p >= '0' && *t->p <= '9' && v <= max + 1) {
+        v = v * 10 + (*t->p++ - '0');
+    }
+    v = negative ? -v : v;
+    if (t->p == start || v < min || v > max) {
+        return false;
+    }
+    *value = v;
+    return true;
+}
+
+/// A string without escapes, the only kind the firmware writes
+static bool IngestString(struct IngestText *t, char *out, size_t size)
+{
+    size_t len = 0;
+
+    if (!IngestTake(t, '"')) {
+        return false;
+    }
+    while (t->p < t->end && *t->p != '"') {
+        if (*t->p == '\\' || len + 1 >= size) {
+            return false;
+        }
+        out[len++] = *t->p++;
+    }
+    out[len] = '\0';
+    return t->p++ < t->end;
+}
+
+/// Skips a value of a key the decoder does not know
+static bool IngestSkip(struct IngestText *t)
+{
+    int depth = 0;
+    bool inString = false;
+
+    IngestSpace(t);
+    for (; t->p < t->end; t->p++) {
+        char c = *t->p;
+        if (inString) {
+            t->p += (c == '\\');
+            inString = (c != '"');
+        } else if (c == '"') {
+            inString = true;
+        } else if (c == '[' || c == '{') {
+            depth++;
+        } else if (c == ']' || c == '}') {
+            if (depth == 0) {
+                return true;
+            }
+            depth--;
+        } else if (c == ',' && depth == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/// The samples: an array of arrays with one value per axis in the channel mask, which must come first
+static bool IngestSamples(struct IngestText *t, struct ImuIngestMessage *message)
+{
+    int64_t v;
+
+    if (!IngestTake(t, '[')) {
+        return false;
+    }
+    if (IngestTake(t, ']')) {
+        return true;
+    }
+    do {
+        if (message->count == IMU_INGEST_SAMPLES_MAX || !IngestTake(t, '[')) {
+            return false;
+        }
+        int16_t *sample = message->value[message->count++];
+        bool first = true;
+        for (uint8_t axis = 0; axis < IMU_STORE_CHANNELS; axis++) {
+            sample[axis] = 0;
+            if ((message->channelMask & (1u << axis)) == 0) {
+                continue;
+            }
+            if ((!first && !IngestTake(t, ',')) || !IngestInteger(t, INT16_MIN, INT16_MAX, &v)) {
+                return false;
+            }
+            sample[axis] = (int16_t)v;
+            first = false;
+        }
+        if (!IngestTake(t, ']')) {
+            return false;
+        }
+    } while (IngestTake(t, ','));
+    return IngestTake(t, ']');
+}
+
+/******************************************************************************
+ * Sources
+ ******************************************************************************/
+
+static size_t IngestHash(const char *device, uint32_t boot)
+{
+    uint64_t h = 1469598103934665603ull ^ boot;  // FNV-1a
+    for (const char *c = device; *c != '\0'; c++) {
+        h = (h ^ (uint8_t)*c) * 1099511628211ull;
+    }
+    return (size_t)(h ^ (h >> 29));
+}
+
+static struct IngestSource *IngestFind(struct ImuIngest *ingest, const char *device, uint32_t boot)
+{
+    size_t i = IngestHash(device, boot) & (ingest->size - 1);
+    while (ingest->source[i].used &&
+           (ingest->source[i].boot != boot || strcmp(ingest->source[i].device, device) != 0)) {
+        i = (i + 1) & (ingest->size - 1);
+    }
+    return &ingest->source[i];
+}
+
+static void IngestGrow(struct ImuIngest *ingest)
+{
+    struct IngestSource *old = ingest->source;
+    size_t oldSize = ingest->size;
+
+    ingest->size = (oldSize == 0) ? 64 : oldSize * 2;
+    ingest->source = calloc(ingest->size, sizeof(struct IngestSource));
+    for (size_t i = 0; i < oldSize; i++) {
+        if (old[i].used) {
+            *IngestFind(ingest, old[i].device, old[i].boot) = old[i];
+        }
+    }
+    free(old);
+}
+
+static bool IngestSeen(const struct IngestSource *source, uint32_t seq)
+{
+    return (source->seen[(seq % IMU_INGEST_SEQ_WINDOW) / 64] >> (seq % 64)) & 1;
+}
+
+static void IngestMark(struct IngestSource *source, uint32_t seq, bool seen)
+{
+    uint64_t bit = 1ull << (seq % 64);
+    uint64_t *word = &source->seen[(seq % IMU_INGEST_SEQ_WINDOW) / 64];
+    *word = seen ? (*word | bit) : (*word & ~bit);
+}
+
+/// Records the message number of a message. Returns false if it was seen already, or is too old to tell.
+static bool IngestCount(struct ImuIngest *ingest, struct IngestSource *source, uint32_t seq)
+{
+    if (!source->started) {
+        ingest->stats.lost += seq;  // seq counts from 0 on every boot
+    } else if (seq > source->maxSeq) {
+        uint32_t gap = seq - source->maxSeq - 1;
+        if (gap >= IMU_INGEST_SEQ_WINDOW) {
+            memset(source->seen, 0, sizeof(source->seen));
+        } else {
+            for (uint32_t s = source->maxSeq + 1; s < seq; s++) {
+                IngestMark(source, s, false);
+            }
+        }
+        ingest->stats.lost += gap;
+    } else if (source->maxSeq - seq >= IMU_INGEST_SEQ_WINDOW || IngestSeen(source, seq)) {
+        return false;
+    } else {
+        ingest->stats.lost--;  // Late, it was counted lost when a newer one came
+        IngestMark(source, seq, true);
+        return true;
+    }
+    source->maxSeq = seq;
+    IngestMark(source, seq, true);
+    return true;
+}
+
+/******************************************************************************
+ * Global Functions
+ ******************************************************************************/
+
+/// Decodes a batch message. Returns 0, or -1 if it is not one.
+int ImuIngestDecode(const char *payload, size_t len, struct ImuIngestMessage *message)
+{
+    struct IngestText t = {payload, payload + len};
+    char key[16];
+    int64_t v;
+    unsigned found = 0;  // Bits of the keys read, in the order of keys[]
+    static const char *const keys[] = {"dev", "boot", "seq", "t0", "t1", "ch", "xyz"};
+
+    memset(message, 0, offsetof(struct ImuIngestMessage, value));
+    if (!IngestTake(&t, '{')) {
+        return -1;
+    }
+    do {
+        unsigned k = 0;
+        if (!IngestString(&t, key, sizeof(key)) || !IngestTake(&t, ':')) {
+            return -1;
+        }
+        for (; k < sizeof(keys) / sizeof(keys[0]) && strcmp(key, keys[k]) != 0; k++) {
+        }
+        if (k < sizeof(keys) / sizeof(keys[0]) && (found & (1u << k)) != 0) {
+            return -1;  // A key twice
+        }
+        found |= 1u << k;
+        switch (k) {
+            case 0:
+                if (!IngestString(&t, message->device, sizeof(message->device)) ||
+                    !ImuStoreDeviceIsValid(message->device)) {
+                    return -1;
+                }
+                break;
+            case 5:
+                if (!IngestInteger(&t, 1, 7, &v)) {
+                    return -1;
+                }
+                message->channelMask = (uint8_t)v;
+                break;
+            case 6:
+                if ((found & (1u << 5)) == 0 || !IngestSamples(&t, message)) {
+                    return -1;
+                }
+                break;
+            case 1:
+            case 2:
+            case 3:
+            case 4: {
+                uint32_t *fields[] = {NULL, &message->boot, &message->seq, &message->t0, &message->t1};
+                if (!IngestInteger(&t, 0, UINT32_MAX, &v)) {
+                    return -1;
+                }
+                *fields[k] = (uint32_t)v;
+                break;
+            }
+            default:
+                if (!IngestSkip(&t)) {
+                    return -1;
+                }
+                break;
+        }
+    } while (IngestTake(&t, ','));
+    if (!IngestTake(&t, '}') || (found & 0x7D) != 0x7D || message->count == 0) {
+        return -1;  // boot is the only key that may be left out
+    }
+    IngestSpace(&t);
+    return (t.p == t.end) ? 0 : -1;
+}
+
+/// Writes a batch message as the firmware does. Returns its length, or -1 if it does not fit in size.
+int ImuIngestFormat(char *text, size_t size, const struct ImuIngestMessage *message)
+{
+    size_t len;
+    int n = snprintf(text, size, "{\"dev\":\"%s\",\"boot\":%lu,\"seq\":%lu,\"t0\":%lu,\"ch\":%u,\"xyz\":[",
+                     message->device, (unsigned long)message->boot, (unsigned long)message->seq,
+                     (unsigned long)message->t0, message->channelMask);
+
+    if (n < 0 || (size_t)n >= size) {
+        return -1;
+    }
+    len = (size_t)n;
+    for (uint16_t i = 0; i < message->count; i++) {
+        const char *separator = "[";
+        n = snprintf(text + len, size - len, "%s", (i == 0) ? "" : ",");
+        len += (size_t)n;
+        for (uint8_t axis = 0; axis < IMU_STORE_CHANNELS && len < size; axis++) {
+            if (message->channelMask & (1u << axis)) {
+                n = snprintf(text + len, size - len, "%s%d", separator, message->value[i][axis]);
+                len += (size_t)n;
+                separator = ",";
+            }
+        }
+        if (len < size) {
+            len += (size_t)snprintf(text + len, size - len, "]");
+        }
+        if (len >= size) {
+            return -1;
+        }
+    }
+    n = snprintf(text + len, size - len, "],\"t1\":%lu}", (unsigned long)message->t1);
+    if (n < 0 || len + (size_t)n >= size) {
+        return -1;
+    }
+    return (int)(len + (size_t)n);
+}
+
+/// Starts an ingest into store, which stays owned by the caller
+struct ImuIngest *ImuIngestOpen(struct ImuStore *store)
+{
+    struct ImuIngest *ingest = calloc(1, sizeof(*ingest));
+    ingest->store = store;
+    IngestGrow(ingest);
+    return ingest;
+}
+
+/// Decodes a message and stores its samples at the wall clock time they were taken. nowUs is the wall clock time
+/// the message arrived, which anchors the device clock when it is the first of its boot.
+enum ImuIngestResult ImuIngestPayload(struct ImuIngest *ingest, const char *payload, size_t len, int64_t nowUs)
+{
+    struct ImuIngestMessage *m = &ingest->message;
+    struct IngestSource *source;
+    int64_t firstUs, spanUs;
+    bool failed = false;
+
+    ingest->stats.messages++;
+    if (ImuIngestDecode(payload, len, m) != 0) {
+        ingest->stats.malformed++;
+        return IMU_INGEST_MALFORMED;
+    }
+    source = IngestFind(ingest, m->device, m->boot);
+    if (!source->used) {
+        if (2 * (ingest->stats.sources + 1) > ingest->size) {
+            IngestGrow(ingest);
+            source = IngestFind(ingest, m->device, m->boot);
+        }
+        memset(source, 0, sizeof(*source));
+        snprintf(source->device, sizeof(source->device), "%s", m->device);
+        source->boot = m->boot;
+        source->used = true;
+        ingest->stats.sources++;
+    }
+    if (!IngestCount(ingest, source, m->seq)) {
+        ingest->stats.duplicates++;
+        return IMU_INGEST_DUPLICATE;
+    }
+
+    // Each device time is taken relative to the newest one as a signed difference, which follows the wrap
+    if (!source->started) {
+        source->started = true;
+        source->anchorUs = nowUs - m->t0;
+        source->lastUs = m->t0;
+    }
+    firstUs = source->lastUs + (int32_t)(m->t0 - (uint32_t)source->lastUs);
+    spanUs = (uint32_t)(m->t1 - m->t0);
+    if (m->seq == source->maxSeq) {
+        source->lastUs = firstUs;
+    }
+
+    for (uint16_t i = 0; i < m->count; i++) {
+        int64_t us = source->anchorUs + firstUs + ((m->count > 1) ? spanUs * i / (m->count - 1) : 0);
+        for (uint8_t axis = 0; axis < IMU_STORE_CHANNELS; axis++) {
+            if (m->channelMask & (1u << axis)) {
+                failed |= ImuStoreAppend(ingest->store, m->device, axis, us, m->value[i][axis]) != 0;
+                ingest->stats.events++;
+            }
+        }
+    }
+    ingest->stats.samples += m->count;
+    if (failed) {
+        ingest->stats.storeErrors++;
+        return IMU_INGEST_STORE_ERROR;
+    }
+    return IMU_INGEST_STORED;
+}
+
+void ImuIngestGetStats(const struct ImuIngest *ingest, struct ImuIngestStats *stats)
+{
+    *stats = ingest->stats;
+}
+
+/// Frees the ingest. The store is left open.
+void ImuIngestClose(struct ImuIngest *ingest)
+{
+    free(ingest->source);
+    free(ingest);
+}
@@ -0,0 +1,59 @@
+/**************************************************************************/ /**
+ * @file      ImuIngest.h
+ * @brief     Ingest of the IMU batch messages of the analyzers (MQTT_HandleImuBatchMessages in WifiHandler.c) into
+ *            an ImuStore. A message is keyed by its device serial number, boot count and message number: repeats,
+ *            from QoS 1 redelivery or the replay of the device's SD spool, are dropped and gaps counted as lost.
+ *            Device times are 32-bit microseconds; each boot is unwrapped and anchored to the wall clock when its
+ *            first message arrives, so the store holds microseconds since the epoch.
+ * @date      2026-10-19
+
+ ******************************************************************************/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ImuStore.h"
+
+#define IMU_INGEST_SAMPLES_MAX 255
+#define IMU_INGEST_SEQ_WINDOW 4096  ///< Message numbers behind the newest of a boot that are still told apart
+
+enum ImuIngestResult {
+    IMU_INGEST_STORED,
+    IMU_INGEST_DUPLICATE,  ///< Seen before, or too far behind the newest message of its boot to tell
+    IMU_INGEST_MALFORMED,
+    IMU_INGEST_STORE_ERROR,
+};
+
+/// A batch message, decoded
+struct ImuIngestMessage {
+    char device[IMU_STORE_DEVICE_MAX + 1];
+    uint32_t boot;  ///< 0 when the device could not count its boots, or sent none
+    uint32_t seq;
+    uint32_t t0;    ///< Device time of the first sample, us
+    uint32_t t1;    ///< Device time of the last sample
+    uint8_t channelMask;
+    uint16_t count;
+    int16_t value[IMU_INGEST_SAMPLES_MAX][IMU_STORE_CHANNELS];  ///< By axis; axes not in channelMask are 0
+};
+
+struct ImuIngestStats {
+    uint64_t messages;    ///< Messages received
+    uint64_t duplicates;
+    uint64_t malformed;
+    uint64_t lost;        ///< Message numbers skipped over and not received since
+    uint64_t samples;     ///< Samples stored
+    uint64_t events;      ///< Values stored, a sample holds one per enabled axis
+    uint64_t storeErrors;
+    uint32_t sources;     ///< Device boots seen
+};
+
+struct ImuIngest;
+
+int ImuIngestDecode(const char *payload, size_t len, struct ImuIngestMessage *message);
+int ImuIngestFormat(char *text, size_t size, const struct ImuIngestMessage *message);
+struct ImuIngest *ImuIngestOpen(struct ImuStore *store);
+enum ImuIngestResult ImuIngestPayload(struct ImuIngest *ingest, const char *payload, size_t len, int64_t nowUs);
+void ImuIngestGetStats(const struct ImuIngest *ingest, struct ImuIngestStats *stats);
+void ImuIngestClose(struct ImuIngest *ingest);
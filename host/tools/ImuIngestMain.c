@@ -0,0 +1,203 @@
+/**************************************************************************/ /**
+ * @file      ImuIngestMain.c
+ * @brief     imu_ingest: subscribes to the IMU topics of the analyzers on an MQTT broker and stores their batches
+ *            in a columnar store, or queries the store.
+ *              imu_ingest -d DIR [-H HOST] [-p PORT] [-t TOPIC]... [-i CLIENT] [-c] [-F SECONDS]
+ *              imu_ingest -d DIR --query DEVICE [--channel x|y|z] [--from US] [--to US] [--min V] [--max V]
+ * @date      2026-10-19
+
+ ******************************************************************************/
+
+#include <getopt.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "ImuIngest.h"
+#include "ImuStore.h"
+#include "MqttSubscriber.h"
+
+#define INGEST_DEFAULT_TOPIC "P1_IMU_ESE516_T0"  ///< IMU_TOPIC of WifiHandler.h
+#define INGEST_TOPICS_MAX 16
+
+static volatile sig_atomic_t ingestStop = 0;
+
+static void Usage(void)
+{
+    fprintf(stderr,
+            "usage: imu_ingest -d DIR [-H HOST] [-p PORT] [-t TOPIC]... [-i CLIENT] [-c] [-F SECONDS]\n"
+            "       imu_ingest -d DIR --query DEVICE [--channel x|y|z] [--from US] [--to US] [--min V] [--max V]\n"
+            "  -d         store directory\n"
+            "  -H, -p     broker, localhost:1883 by default\n"
+            "  -t         topic filter, %s by default; repeat for more\n"
+            "  -i         client id, imu_ingest by default. The session is kept unless -c\n"
+            "  -F         seconds between writes of the buffered rows, default 5\n"
+            "  --query    prints the rows of a device and channel as \"us value\", times in us since the epoch\n",
+            INGEST_DEFAULT_TOPIC);
+}
+
+static void Stop(int signal)
+{
+    (void)signal;
+    ingestStop = 1;
+}
+
+static int64_t WallClockUs(void)
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (int64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+static void OnMessage(void *context, const char *topic, const uint8_t *payload, size_t len)
+{
+    (void)topic;
+    ImuIngestPayload(context, (const char *)payload, len, WallClockUs());
+}
+
+static void PrintRow(void *context, int64_t us, int16_t value)
+{
+    fprintf(context, "%lld %d\n", (long long)us, value);
+}
+
+static int Query(const char *dir, const struct ImuStoreQuery *query)
+{
+    struct ImuStoreQueryStats stats;
+    int result = ImuStoreSelect(dir, query, PrintRow, stdout, &stats);
+
+    fprintf(stderr, "%llu rows; %u partitions, %llu of %llu blocks read\n", (unsigned long long)stats.rows,
+            stats.partitions, (unsigned long long)stats.blocksRead, (unsigned long long)stats.blocks);
+    if (result != 0) {
+        fprintf(stderr, "imu_ingest: cannot read %s of %s\n", query->device, dir);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+static void PrintStats(const struct ImuIngest *ingest)
+{
+    struct ImuIngestStats stats;
+    ImuIngestGetStats(ingest, &stats);
+    fprintf(stderr,
+            "%llu messages from %u device boots, %llu duplicates, %llu lost, %llu malformed, %llu samples, "
+            "%llu values, %llu store errors\n",
+            (unsigned long long)stats.messages, stats.sources, (unsigned long long)stats.duplicates,
+            (unsigned long long)stats.lost, (unsigned long long)stats.malformed, (unsigned long long)stats.samples,
+            (unsigned long long)stats.events, (unsigned long long)stats.storeErrors);
+}
+
+static int Ingest(const char *dir, const struct MqttSubscriberOptions *options, unsigned flushS)
+{
+    struct ImuStore *store = ImuStoreOpen(dir);
+    struct ImuIngest *ingest;
+    time_t lastFlush = time(NULL);
+
+    if (store == NULL) {
+        fprintf(stderr, "imu_ingest: cannot create %s\n", dir);
+        return EXIT_FAILURE;
+    }
+    ingest = ImuIngestOpen(store);
+    signal(SIGINT, Stop);
+    signal(SIGTERM, Stop);
+    while (!ingestStop) {
+        struct MqttSubscriber *sub = MqttSubscriberConnect(options, 5000);
+        if (sub == NULL) {
+            fprintf(stderr, "imu_ingest: cannot connect to %s:%u, retrying\n", options->host, options->port);
+            sleep(1);
+            continue;
+        }
+        fprintf(stderr, "imu_ingest: connected to %s:%u\n", options->host, options->port);
+        while (!ingestStop && MqttSubscriberPoll(sub, 200, OnMessage, ingest) >= 0) {
+            if (time(NULL) - lastFlush >= (time_t)flushS) {
+                if (ImuStoreFlush(store) != 0) {
+                    fprintf(stderr, "imu_ingest: cannot write to %s\n", dir);
+                }
+                lastFlush = time(NULL);
+            }
+        }
+        MqttSubscriberClose(sub);
+    }
+    PrintStats(ingest);
+    ImuIngestClose(ingest);
+    return (ImuStoreClose(store) == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+int main(int argc, char **argv)
+{
+    static const struct option longOptions[] = {
+        {"query", required_argument, NULL, 'q'}, {"channel", required_argument, NULL, 'n'},
+        {"from", required_argument, NULL, 'f'},  {"to", required_argument, NULL, 'o'},
+        {"min", required_argument, NULL, 'a'},   {"max", required_argument, NULL, 'b'},
+        {"help", no_argument, NULL, 'h'},        {NULL, 0, NULL, 0},
+    };
+    const char *topics[INGEST_TOPICS_MAX];
+    struct MqttSubscriberOptions options = {"localhost", 1883, "imu_ingest", false, 60, topics, 0};
+    struct ImuStoreQuery query = {NULL, 0, INT64_MIN, INT64_MAX, INT16_MIN, INT16_MAX};
+    const char *dir = NULL;
+    unsigned flushS = 5;
+    int opt;
+
+    while ((opt = getopt_long(argc, argv, "d:H:p:t:i:cF:h", longOptions, NULL)) != -1) {
+        switch (opt) {
+            case 'd':
+                dir = optarg;
+                break;
+            case 'H':
+                options.host = optarg;
+                break;
+            case 'p':
+                options.port = (uint16_t)atoi(optarg);
+                break;
+            case 't':
+                if (options.topicCount < INGEST_TOPICS_MAX) {
+                    topics[options.topicCount++] = optarg;
+                }
+                break;
+            case 'i':
+                options.clientId = optarg;
+                break;
+            case 'c':
+                options.cleanSession = true;
+                break;
+            case 'F':
+                flushS = (unsigned)atoi(optarg);
+                break;
+            case 'q':
+                query.device = optarg;
+                break;
+            case 'n':
+                query.channel = (uint8_t)((optarg[0] == 'y') ? 1 : (optarg[0] == 'z') ? 2 : 0);
+                break;
+            case 'f':
+                query.fromUs = strtoll(optarg, NULL, 0);
+                break;
+            case 'o':
+                query.toUs = strtoll(optarg, NULL, 0);
+                break;
+            case 'a':
+                query.minValue = (int16_t)atoi(optarg);
+                break;
+            case 'b':
+                query.maxValue = (int16_t)atoi(optarg);
+                break;
+            default:
+                Usage();
+                return (opt == 'h') ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+    if (dir == NULL || optind != argc) {
+        Usage();
+        return EXIT_FAILURE;
+    }
+    if (query.device != NULL) {
+        return Query(dir, &query);
+    }
+    if (options.topicCount == 0) {
+        topics[options.topicCount++] = INGEST_DEFAULT_TOPIC;
+    }
+    return Ingest(dir, &options, flushS);
+}
@@ -0,0 +1,421 @@
+/**************************************************************************/ /**
+ * @file      ImuStore.c
+ * @brief     Columnar store of IMU samples on disk. Rows are buffered per device and channel and written a block at
+ *            a time: the two columns at the block's row, then its index entry. The index is written last and is
+ *            the only thing a reader trusts, so a block cut short by a crash is written over by the next one.
+ * @date      2026-10-19
+
+ ******************************************************************************/
+
+#include "ImuStore.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define STORE_PATH_MAX 4096
+
+static const char storeChannelNames[IMU_STORE_CHANNELS] = {'x', 'y', 'z'};
+
+/// Rows of one device and channel not yet written, and where they go
+struct StoreWriter {
+    char device[IMU_STORE_DEVICE_MAX + 1];
+    uint8_t channel;
+    bool used;
+    bool rowKnown;      ///< nextRow was read from the index of the partition
+    int64_t partition;  ///< Hour of the rows buffered
+    uint64_t nextRow;
+    uint32_t rows;
+    int64_t *us;
+    int16_t *value;
+};
+
+struct ImuStore {
+    char dir[STORE_PATH_MAX / 2];
+    struct StoreWriter *writer;  ///< Open addressing table of writers
+    size_t size;
+    size_t count;
+};
+
+/******************************************************************************
+ * Paths
+ ******************************************************************************/
+
+static int64_t StorePartition(int64_t us)
+{
+    return (us >= 0) ? us / IMU_STORE_PARTITION_US : -((-us - 1) / IMU_STORE_PARTITION_US) - 1;
+}
+
+static void StorePath(char *path, const char *dir, const char *device, int64_t partition, uint8_t channel,
+                      const char *ext)
+{
+    snprintf(path, STORE_PATH_MAX, "%s/%s/h%lld/%c.%s", dir, device, (long long)partition,
+             storeChannelNames[channel], ext);
+}
+
+/// Creates the directories of the partition
+static int StoreMakePartition(const char *dir, const char *device, int64_t partition)
+{
+    char path[STORE_PATH_MAX];
+
+    snprintf(path, sizeof(path), "%s/%s", dir, device);
+    if (mkdir(path, 0777) != 0 && errno != EEXIST) {
+        return -1;
+    }
+    snprintf(path, sizeof(path), "%s/%s/h%lld", dir, device, (long long)partition);
+    if (mkdir(path, 0777) != 0 && errno != EEXIST) {
+        return -1;
+    }
+    return 0;
+}
+
+/// Reads the index of a partition and channel. A torn entry at the end is dropped. Returns the entry count, or
+/// -1 if there is no index.
+static long StoreReadIndex(const char *path, struct ImuStoreBlock **blocks)
+{
+    struct stat st;
+    int fd = open(path, O_RDONLY);
+    long count;
+
+    *blocks = NULL;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        return -1;
+    }
+    count = (long)(st.st_size / (off_t)sizeof(struct ImuStoreBlock));
+    *blocks = malloc((size_t)(count > 0 ? count : 1) * sizeof(struct ImuStoreBlock));
+    if (pread(fd, *blocks, (size_t)count * sizeof(struct ImuStoreBlock), 0) !=
+        (ssize_t)((size_t)count * sizeof(struct ImuStoreBlock))) {
+        count = -1;
+    }
+    close(fd);
+    return count;
+}
+
+static bool StoreWriteAll(int fd, const void *data, size_t len, off_t offset)
+{
+    const uint8_t *p = data;
+    while (len > 0) {
+        ssize_t n = pwrite(fd, p, len, offset);
+        if (n <= 0) {
+            return false;
+        }
+        p += n;
+        len -= (size_t)n;
+        offset += n;
+    }
+    return true;
+}
+
+/******************************************************************************
+ * Writers
+ ******************************************************************************/
+
+static size_t StoreHash(const char *device, uint8_t channel)
+{
+    uint64_t h = 1469598103934665603ull ^ channel;  // FNV-1a
+    for (const char *c = device; *c != '\0'; c++) {
+        h = (h ^ (uint8_t)*c) * 1099511628211ull;
+    }
+    return (size_t)(h ^ (h >> 29));
+}
+
+static struct StoreWriter *StoreFind(struct ImuStore *store, const char *device, uint8_t channel)
+{
+    size_t i = StoreHash(device, channel) & (store->size - 1);
+    while (store->writer[i].used) {
+        if (store->writer[i].channel == channel && strcmp(store->writer[i].device, device) == 0) {
+            break;
+        }
+        i = (i + 1) & (store->size - 1);
+    }
+    return &store->writer[i];
+}
+
+static void StoreGrow(struct ImuStore *store)
+{
+    struct StoreWriter *old = store->writer;
+    size_t oldSize = store->size;
+
+    store->size = (oldSize == 0) ? 64 : oldSize * 2;
+    store->writer = calloc(store->size, sizeof(struct StoreWriter));
+    for (size_t i = 0; i < oldSize; i++) {
+        if (old[i].used) {
+            *StoreFind(store, old[i].device, old[i].channel) = old[i];
+        }
+    }
+    free(old);
+}
+
+/// Writes the buffered rows of a writer as one block
+static int StoreWriteBlock(struct ImuStore *store, struct StoreWriter *w)
+{
+    char path[STORE_PATH_MAX];
+    struct ImuStoreBlock block;
+    int fdUs, fdValue, fdIndex;
+    bool ok;
+
+    if (w->rows == 0) {
+        return 0;
+    }
+    if (!w->rowKnown) {
+        struct ImuStoreBlock *blocks;
+        long count;
+        if (StoreMakePartition(store->dir, w->device, w->partition) != 0) {
+            return -1;
+        }
+        StorePath(path, store->dir, w->device, w->partition, w->channel, "idx");
+        count = StoreReadIndex(path, &blocks);
+        w->nextRow = (count > 0) ? blocks[count - 1].firstRow + blocks[count - 1].rows : 0;
+        if (count >= 0 && truncate(path, (off_t)count * (off_t)sizeof(struct ImuStoreBlock)) != 0) {
+            free(blocks);
+            return -1;
+        }
+        free(blocks);
+        w->rowKnown = true;
+    }
+
+    block = (struct ImuStoreBlock){w->us[0], w->us[0], w->nextRow, w->rows, w->value[0], w->value[0]};
+    for (uint32_t i = 1; i < w->rows; i++) {
+        block.minUs = (w->us[i] < block.minUs) ? w->us[i] : block.minUs;
+        block.maxUs = (w->us[i] > block.maxUs) ? w->us[i] : block.maxUs;
+        block.minValue = (w->value[i] < block.minValue) ? w->value[i] : block.minValue;
+        block.maxValue = (w->value[i] > block.maxValue) ? w->value[i] : block.maxValue;
+    }
+
+    StorePath(path, store->dir, w->device, w->partition, w->channel, "ts");
+    fdUs = open(path, O_WRONLY | O_CREAT, 0666);
+    StorePath(path, store->dir, w->device, w->partition, w->channel, "val");
+    fdValue = open(path, O_WRONLY | O_CREAT, 0666);
+    StorePath(path, store->dir, w->device, w->partition, w->channel, "idx");
+    fdIndex = open(path, O_WRONLY | O_CREAT | O_APPEND, 0666);
+    ok = fdUs >= 0 && fdValue >= 0 && fdIndex >= 0 &&
+         StoreWriteAll(fdUs, w->us, w->rows * sizeof(int64_t), (off_t)(w->nextRow * sizeof(int64_t))) &&
+         StoreWriteAll(fdValue, w->value, w->rows * sizeof(int16_t), (off_t)(w->nextRow * sizeof(int16_t))) &&
+         write(fdIndex, &block, sizeof(block)) == (ssize_t)sizeof(block);
+    if (fdUs >= 0) {
+        close(fdUs);
+    }
+    if (fdValue >= 0) {
+        close(fdValue);
+    }
+    if (fdIndex >= 0) {
+        close(fdIndex);
+    }
+    if (!ok) {
+        w->rowKnown = false;  // Read the index again, it may hold a torn entry
+        return -1;
+    }
+    w->nextRow += w->rows;
+    w->rows = 0;
+    return 0;
+}
+
+/******************************************************************************
+ * Global Functions
+ ******************************************************************************/
+
+/// Opens the store in dir, creating the directory. Returns NULL if it cannot be created.
+struct ImuStore *ImuStoreOpen(const char *dir)
+{
+    struct ImuStore *store;
+
+    if (mkdir(dir, 0777) != 0 && errno != EEXIST) {
+        return NULL;
+    }
+    store = calloc(1, sizeof(*store));
+    snprintf(store->dir, sizeof(store->dir), "%s", dir);
+    StoreGrow(store);
+    return store;
+}
+
+/// Adds a row. Rows are buffered; a full block is written. Returns 0, or -1 for a bad device or channel or a
+/// failed write.
+int ImuStoreAppend(struct ImuStore *store, const char *device, uint8_t channel, int64_t us, int16_t value)
+{
+    struct StoreWriter *w;
+    int64_t partition = StorePartition(us);
+    int result = 0;
+
+    if (channel >= IMU_STORE_CHANNELS) {
+        return -1;
+    }
+    w = StoreFind(store, device, channel);
+    if (!w->used) {
+        if (!ImuStoreDeviceIsValid(device)) {
+            return -1;
+        }
+        if (2 * (store->count + 1) > store->size) {
+            StoreGrow(store);
+            w = StoreFind(store, device, channel);
+        }
+        *w = (struct StoreWriter){.channel = channel, .used = true, .partition = partition};
+        snprintf(w->device, sizeof(w->device), "%s", device);
+        w->us = malloc(IMU_STORE_BLOCK_ROWS * sizeof(int64_t));
+        w->value = malloc(IMU_STORE_BLOCK_ROWS * sizeof(int16_t));
+        store->count++;
+    }
+    if (partition != w->partition) {
+        result = StoreWriteBlock(store, w);
+        w->partition = partition;
+        w->rowKnown = false;
+        w->rows = 0;
+    }
+    w->us[w->rows] = us;
+    w->value[w->rows++] = value;
+    if (w->rows == IMU_STORE_BLOCK_ROWS && StoreWriteBlock(store, w) != 0) {
+        w->rows = 0;  // Dropped rather than grow without bound
+        result = -1;
+    }
+    return result;
+}
+
+/// Writes the buffered rows of every device and channel, as blocks cut short. Returns 0, or -1 if a write failed.
+int ImuStoreFlush(struct ImuStore *store)
+{
+    int result = 0;
+    for (size_t i = 0; i < store->size; i++) {
+        if (store->writer[i].used && StoreWriteBlock(store, &store->writer[i]) != 0) {
+            result = -1;
+        }
+    }
+    return result;
+}
+
+/// Flushes and frees the store
+int ImuStoreClose(struct ImuStore *store)
+{
+    int result = ImuStoreFlush(store);
+    for (size_t i = 0; i < store->size; i++) {
+        free(store->writer[i].us);
+        free(store->writer[i].value);
+    }
+    free(store->writer);
+    free(store);
+    return result;
+}
+
+/// Hands the rows of a device and channel in the time and value range of query to fn, in the order they were
+/// stored within each partition and partitions in time order. Reads the index of the partitions the time range
+/// touches and the columns of the blocks that can hold a match. Rows still buffered by an open store are not seen.
+/// Returns 0, or -1 if the device is not in the store or a column cannot be read.
+int ImuStoreSelect(const char *dir, const struct ImuStoreQuery *query, ImuStoreRowFn fn, void *context,
+                   struct ImuStoreQueryStats *stats)
+{
+    char path[STORE_PATH_MAX];
+    int64_t *partitions = NULL, first = StorePartition(query->fromUs), last = StorePartition(query->toUs);
+    size_t count = 0, size = 0;
+    int64_t *us = malloc(IMU_STORE_BLOCK_ROWS * sizeof(int64_t));
+    int16_t *value = malloc(IMU_STORE_BLOCK_ROWS * sizeof(int16_t));
+    struct dirent *entry;
+    DIR *dp;
+    int result = 0;
+
+    memset(stats, 0, sizeof(*stats));
+    if (!ImuStoreDeviceIsValid(query->device) || query->channel >= IMU_STORE_CHANNELS) {
+        free(us);
+        free(value);
+        return -1;
+    }
+    snprintf(path, sizeof(path), "%s/%s", dir, query->device);
+    if ((dp = opendir(path)) == NULL) {
+        free(us);
+        free(value);
+        return -1;
+    }
+    while ((entry = readdir(dp)) != NULL) {
+        long long hour;
+        char end;
+        if (sscanf(entry->d_name, "h%lld%c", &hour, &end) == 1 && hour >= first && hour <= last) {
+            if (count == size) {
+                size = (size == 0) ? 16 : size * 2;
+                partitions = realloc(partitions, size * sizeof(int64_t));
+            }
+            partitions[count++] = hour;
+        }
+    }
+    closedir(dp);
+    for (size_t i = 1; i < count; i++) {  // Insertion sort, a range touches few partitions
+        int64_t p = partitions[i];
+        size_t j = i;
+        for (; j > 0 && partitions[j - 1] > p; j--) {
+            partitions[j] = partitions[j - 1];
+        }
+        partitions[j] = p;
+    }
+
+    for (size_t i = 0; i < count && result == 0; i++) {
+        struct ImuStoreBlock *blocks;
+        long n;
+        int fdUs, fdValue;
+
+        StorePath(path, dir, query->device, partitions[i], query->channel, "idx");
+        n = StoreReadIndex(path, &blocks);
+        if (n <= 0) {
+            free(blocks);
+            continue;
+        }
+        stats->partitions++;
+        stats->blocks += (uint64_t)n;
+        StorePath(path, dir, query->device, partitions[i], query->channel, "ts");
+        fdUs = open(path, O_RDONLY);
+        StorePath(path, dir, query->device, partitions[i], query->channel, "val");
+        fdValue = open(path, O_RDONLY);
+        for (long b = 0; b < n && result == 0; b++) {
+            const struct ImuStoreBlock *block = &blocks[b];
+            if (block->maxUs < query->fromUs || block->minUs > query->toUs || block->maxValue < query->minValue ||
+                block->minValue > query->maxValue) {
+                continue;
+            }
+            if (block->rows > IMU_STORE_BLOCK_ROWS || fdUs < 0 || fdValue < 0 ||
+                pread(fdUs, us, block->rows * sizeof(int64_t), (off_t)(block->firstRow * sizeof(int64_t))) !=
+                    (ssize_t)(block->rows * sizeof(int64_t)) ||
+                pread(fdValue, value, block->rows * sizeof(int16_t), (off_t)(block->firstRow * sizeof(int16_t))) !=
+                    (ssize_t)(block->rows * sizeof(int16_t))) {
+                result = -1;
+                break;
+            }
+            stats->blocksRead++;
+            stats->rowsRead += block->rows;
+            for (uint32_t r = 0; r < block->rows; r++) {
+                if (us[r] >= query->fromUs && us[r] <= query->toUs && value[r] >= query->minValue &&
+                    value[r] <= query->maxValue) {
+                    stats->rows++;
+                    fn(context, us[r], value[r]);
+                }
+            }
+        }
+        if (fdUs >= 0) {
+            close(fdUs);
+        }
+        if (fdValue >= 0) {
+            close(fdValue);
+        }
+        free(blocks);
+    }
+    free(partitions);
+    free(us);
+    free(value);
+    return result;
+}
+
+/// A device name is a directory of the store: 1 to IMU_STORE_DEVICE_MAX letters, digits, '-' or '_'
+bool ImuStoreDeviceIsValid(const char *device)
+{
+    size_t len = 0;
+    for (; device[len] != '\0'; len++) {
+        char c = device[len];
+        if (len == IMU_STORE_DEVICE_MAX ||
+            !((c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '-' || c == '_')) {
+            return false;
+        }
+    }
+    return len > 0;
+}
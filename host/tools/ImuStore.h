@@ -0,0 +1,60 @@
+/**************************************************************************/ /**
+ * @file      ImuStore.h
+ * @brief     Columnar store of IMU samples on disk, partitioned by device and by hour. Each partition holds, per
+ *            channel, a timestamp column (int64 us since the epoch), a value column (int16) and an index with the
+ *            time and value range of every block of rows. A query reads the index of the partitions its range
+ *            touches and only the blocks that overlap it.
+ *              DIR/<device>/h<hour since the epoch>/<x|y|z>.ts, .val, .idx
+ * @date      2026-10-19
+
+ ******************************************************************************/
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define IMU_STORE_BLOCK_ROWS 1024  ///< Rows of a block; a flush before it fills cuts it short
+#define IMU_STORE_PARTITION_US 3600000000ll
+#define IMU_STORE_DEVICE_MAX 40  ///< Longest device name, letters, digits, '-' and '_' only
+#define IMU_STORE_CHANNELS 3
+
+/// Index entry of one block, in the .idx file of its partition and channel
+struct ImuStoreBlock {
+    int64_t minUs;
+    int64_t maxUs;
+    uint64_t firstRow;  ///< Row of the block in the .ts and .val columns
+    uint32_t rows;
+    int16_t minValue;
+    int16_t maxValue;
+};
+
+struct ImuStoreQuery {
+    const char *device;
+    uint8_t channel;   ///< 0, 1, 2 for x, y, z
+    int64_t fromUs;    ///< Inclusive
+    int64_t toUs;      ///< Inclusive
+    int16_t minValue;  ///< Only values in [minValue, maxValue]; INT16_MIN and INT16_MAX for all
+    int16_t maxValue;
+};
+
+/// Work of a query
+struct ImuStoreQueryStats {
+    uint32_t partitions;  ///< Partitions whose index was read
+    uint64_t blocks;      ///< Blocks in those indexes
+    uint64_t blocksRead;  ///< Blocks whose columns were read
+    uint64_t rowsRead;
+    uint64_t rows;        ///< Rows handed to the callback
+};
+
+struct ImuStore;
+
+typedef void (*ImuStoreRowFn)(void *context, int64_t us, int16_t value);
+
+struct ImuStore *ImuStoreOpen(const char *dir);
+int ImuStoreAppend(struct ImuStore *store, const char *device, uint8_t channel, int64_t us, int16_t value);
+int ImuStoreFlush(struct ImuStore *store);
+int ImuStoreClose(struct ImuStore *store);
+int ImuStoreSelect(const char *dir, const struct ImuStoreQuery *query, ImuStoreRowFn fn, void *context,
+                   struct ImuStoreQueryStats *stats);
+bool ImuStoreDeviceIsValid(const char *device);
@@ -0,0 +1,332 @@
+/**************************************************************************/ /**
+ * @file      MqttSubscriber.c
+ * @brief     Minimal MQTT 3.1.1 subscriber. Packets are read into one buffer and taken out whole; a message is
+ *            acknowledged after its callback, so a subscriber that dies while handling it gets it again.
+ * @date      2026-10-19
+
+ ******************************************************************************/
+
+#include "MqttSubscriber.h"
+
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MQTT_CONNECT 0x10
+#define MQTT_CONNACK 0x20
+#define MQTT_PUBLISH 0x30
+#define MQTT_PUBACK 0x40
+#define MQTT_SUBSCRIBE 0x82  ///< With the reserved flags the standard asks for
+#define MQTT_SUBACK 0x90
+#define MQTT_PINGREQ 0xC0
+#define MQTT_PINGRESP 0xD0
+#define MQTT_SUBSCRIBE_ID 1
+
+struct MqttSubscriber {
+    int fd;
+    uint8_t *buffer;
+    size_t len;
+    size_t size;
+    uint16_t keepAliveS;
+    uint64_t lastSendMs;
+    uint64_t lastReceiveMs;
+    bool pingSent;
+};
+
+/// A packet whole in the buffer
+struct MqttPacket {
+    uint8_t header;
+    const uint8_t *body;
+    uint32_t bodyLen;
+    size_t total;  ///< Bytes of the packet in the buffer
+};
+
+static uint64_t MqttNowMs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000u + (uint64_t)ts.tv_nsec / 1000000u;
+}
+
+static int MqttSend(struct MqttSubscriber *sub, const uint8_t *data, size_t len)
+{
+    while (len > 0) {
+        ssize_t n = send(sub->fd, data, len, MSG_NOSIGNAL);
+        if (n <= 0) {
+            return -1;
+        }
+        data += n;
+        len -= (size_t)n;
+    }
+    sub->lastSendMs = MqttNowMs();
+    return 0;
+}
+
+/// Writes the fixed header of a packet with a body of len bytes. Returns its length.
+static size_t MqttHeader(uint8_t *p, uint8_t type, uint32_t len)
+{
+    size_t n = 0;
+    p[n++] = type;
+    do {
+        p[n] = len & 0x7F;
+        len >>= 7;
+        p[n++] |= (len > 0) ? 0x80 : 0;
+    } while (len > 0);
+    return n;
+}
+
+static size_t MqttString(uint8_t *p, const char *s)
+{
+    size_t len = strlen(s);
+    p[0] = (uint8_t)(len >> 8);
+    p[1] = (uint8_t)len;
+    memcpy(p + 2, s, len);
+    return len + 2;
+}
+
+/// Finds the first packet in the buffer. Returns 1 if it is whole, 0 if more bytes are needed, -1 if it is too long.
+static int MqttParse(const struct MqttSubscriber *sub, struct MqttPacket *packet)
+{
+    uint32_t len = 0;
+    size_t i = 1;
+
+    for (;; i++) {
+        if (i >= sub->len) {
+            return 0;
+        }
+        if (i > 4) {
+            return -1;
+        }
+        len |= (uint32_t)(sub->buffer[i] & 0x7F) << (7 * (i - 1));
+        if ((sub->buffer[i] & 0x80) == 0) {
+            break;
+        }
+    }
+    if (len > MQTT_SUBSCRIBER_PACKET_MAX) {
+        return -1;
+    }
+    if (sub->len < i + 1 + len) {
+        return 0;
+    }
+    packet->header = sub->buffer[0];
+    packet->body = sub->buffer + i + 1;
+    packet->bodyLen = len;
+    packet->total = i + 1 + len;
+    return 1;
+}
+
+/// Waits up to timeoutMs for bytes from the broker. Returns 1 if some arrived, 0 on timeout, -1 if the connection
+/// closed.
+static int MqttReceive(struct MqttSubscriber *sub, int timeoutMs)
+{
+    struct pollfd pfd = {sub->fd, POLLIN, 0};
+    ssize_t n;
+
+    if (sub->size - sub->len < 4096) {
+        sub->size *= 2;
+        sub->buffer = realloc(sub->buffer, sub->size);
+    }
+    if (poll(&pfd, 1, timeoutMs) <= 0) {
+        return 0;
+    }
+    n = recv(sub->fd, sub->buffer + sub->len, sub->size - sub->len, 0);
+    if (n <= 0) {
+        return -1;
+    }
+    sub->len += (size_t)n;
+    sub->lastReceiveMs = MqttNowMs();
+    return 1;
+}
+
+/// Handles one packet. Returns 1 for a message, 0 for another packet, -1 for a protocol error.
+static int MqttHandle(struct MqttSubscriber *sub, const struct MqttPacket *packet, MqttMessageFn fn, void *context)
+{
+    uint8_t qos = (packet->header >> 1) & 0x3;
+    uint32_t topicLen, at;
+    char *topic;
+
+    switch (packet->header & 0xF0) {
+        case MQTT_PUBLISH:
+            if (packet->bodyLen < 2 || qos > 1) {
+                return -1;  // QoS 2 is never granted to a QoS 1 subscription
+            }
+            topicLen = ((uint32_t)packet->body[0] << 8) | packet->body[1];
+            at = 2 + topicLen + ((qos > 0) ? 2 : 0);
+            if (at > packet->bodyLen) {
+                return -1;
+            }
+            topic = malloc(topicLen + 1);
+            memcpy(topic, packet->body + 2, topicLen);
+            topic[topicLen] = '\0';
+            fn(context, topic, packet->body + at, packet->bodyLen - at);
+            free(topic);
+            if (qos == 1) {
+                uint8_t ack[4] = {MQTT_PUBACK, 2, packet->body[2 + topicLen], packet->body[3 + topicLen]};
+                if (MqttSend(sub, ack, sizeof(ack)) != 0) {
+                    return -1;
+                }
+            }
+            return 1;
+        case MQTT_SUBACK & 0xF0:
+            for (uint32_t i = 2; i < packet->bodyLen; i++) {
+                if (packet->body[i] & 0x80) {
+                    fprintf(stderr, "mqtt: the broker refused a subscription\n");
+                    return -1;
+                }
+            }
+            return 0;
+        case MQTT_PINGRESP:
+            sub->pingSent = false;
+            return 0;
+        default:
+            return 0;
+    }
+}
+
+/******************************************************************************
+ * Global Functions
+ ******************************************************************************/
+
+/// Connects to the broker and subscribes to the topics of options. Returns NULL if the broker cannot be reached or
+/// refuses the connection; a refused subscription shows in MqttSubscriberPoll.
+struct MqttSubscriber *MqttSubscriberConnect(const struct MqttSubscriberOptions *options, int timeoutMs)
+{
+    struct addrinfo hints = {.ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM}, *found, *ai;
+    struct MqttSubscriber *sub = calloc(1, sizeof(*sub));
+    struct MqttPacket packet;
+    char port[8];
+    uint8_t *p;
+    size_t len, n;
+    int one = 1, parsed = 0;
+    uint64_t deadline;
+
+    snprintf(port, sizeof(port), "%u", options->port);
+    if (getaddrinfo(options->host, port, &hints, &found) != 0) {
+        free(sub);
+        return NULL;
+    }
+    sub->fd = -1;
+    for (ai = found; ai != NULL && sub->fd < 0; ai = ai->ai_next) {
+        sub->fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (sub->fd >= 0 && connect(sub->fd, ai->ai_addr, ai->ai_addrlen) != 0) {
+            close(sub->fd);
+            sub->fd = -1;
+        }
+    }
+    freeaddrinfo(found);
+    if (sub->fd < 0) {
+        free(sub);
+        return NULL;
+    }
+    setsockopt(sub->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    sub->size = 65536;
+    sub->buffer = malloc(sub->size);
+    sub->keepAliveS = options->keepAliveS;
+
+    // CONNECT, and SUBSCRIBE right behind it
+    len = 64 + strlen(options->clientId);
+    for (unsigned i = 0; i < options->topicCount; i++) {
+        len += 3 + strlen(options->topics[i]);
+    }
+    p = malloc(len);
+    n = MqttHeader(p, MQTT_CONNECT, (uint32_t)(10 + 2 + strlen(options->clientId)));
+    n += MqttString(p + n, "MQTT");
+    p[n++] = 4;  // Protocol level of 3.1.1
+    p[n++] = options->cleanSession ? 0x02 : 0x00;
+    p[n++] = (uint8_t)(options->keepAliveS >> 8);
+    p[n++] = (uint8_t)options->keepAliveS;
+    n += MqttString(p + n, options->clientId);
+    len = 2;
+    for (unsigned i = 0; i < options->topicCount; i++) {
+        len += 3 + strlen(options->topics[i]);
+    }
+    n += MqttHeader(p + n, MQTT_SUBSCRIBE, (uint32_t)len);
+    p[n++] = 0;
+    p[n++] = MQTT_SUBSCRIBE_ID;
+    for (unsigned i = 0; i < options->topicCount; i++) {
+        n += MqttString(p + n, options->topics[i]);
+        p[n++] = 1;
+    }
+    if (MqttSend(sub, p, n) != 0) {
+        free(p);
+        MqttSubscriberClose(sub);
+        return NULL;
+    }
+    free(p);
+
+    deadline = MqttNowMs() + (uint64_t)timeoutMs;
+    while ((parsed = MqttParse(sub, &packet)) == 0 && MqttNowMs() < deadline) {
+        if (MqttReceive(sub, (int)(deadline - MqttNowMs())) < 0) {
+            break;
+        }
+    }
+    if (parsed != 1 || packet.header != MQTT_CONNACK || packet.bodyLen != 2 || packet.body[1] != 0) {
+        if (parsed == 1 && packet.header == MQTT_CONNACK && packet.bodyLen == 2) {
+            fprintf(stderr, "mqtt: connection refused, code %u\n", packet.body[1]);
+        }
+        MqttSubscriberClose(sub);
+        return NULL;
+    }
+    sub->len -= packet.total;
+    memmove(sub->buffer, sub->buffer + packet.total, sub->len);
+    return sub;
+}
+
+/// Hands the messages that arrive within timeoutMs to fn, acknowledging each after fn returns, and pings the broker
+/// when the connection is idle. Returns the number of messages, or -1 once the connection is lost: the caller
+/// closes the subscriber and connects again.
+int MqttSubscriberPoll(struct MqttSubscriber *sub, int timeoutMs, MqttMessageFn fn, void *context)
+{
+    struct MqttPacket packet;
+    int messages = 0, parsed, handled;
+    uint64_t now;
+
+    if (MqttReceive(sub, timeoutMs) < 0) {
+        return -1;
+    }
+    while ((parsed = MqttParse(sub, &packet)) == 1) {
+        if ((handled = MqttHandle(sub, &packet, fn, context)) < 0) {
+            return -1;
+        }
+        messages += handled;
+        sub->len -= packet.total;
+        memmove(sub->buffer, sub->buffer + packet.total, sub->len);
+    }
+    if (parsed < 0) {
+        return -1;
+    }
+
+    now = MqttNowMs();
+    if (sub->keepAliveS > 0) {
+        if (sub->pingSent && now - sub->lastReceiveMs > sub->keepAliveS * 1500u) {
+            return -1;  // The broker did not answer the ping
+        }
+        if (!sub->pingSent && now - sub->lastSendMs >= sub->keepAliveS * 500u) {
+            uint8_t ping[2] = {MQTT_PINGREQ, 0};
+            if (MqttSend(sub, ping, sizeof(ping)) != 0) {
+                return -1;
+            }
+            sub->pingSent = true;
+        }
+    }
+    return messages;
+}
+
+void MqttSubscriberClose(struct MqttSubscriber *sub)
+{
+    if (sub == NULL) {
+        return;
+    }
+    if (sub->fd >= 0) {
+        close(sub->fd);
+    }
+    free(sub->buffer);
+    free(sub);
+}
@@ -0,0 +1,34 @@
+/**************************************************************************/ /**
+ * @file      MqttSubscriber.h
+ * @brief     Minimal MQTT 3.1.1 subscriber over TCP, for the host tools: connects, subscribes at QoS 1, receives
+ *            messages and acknowledges each one once its callback returned, and keeps the session alive. With a
+ *            clean session off, the broker keeps what arrives while the subscriber is away.
+ * @date      2026-10-19
+
+ ******************************************************************************/
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define MQTT_SUBSCRIBER_PACKET_MAX (1u << 20)  ///< Longest packet taken from the broker
+
+struct MqttSubscriberOptions {
+    const char *host;
+    uint16_t port;
+    const char *clientId;
+    bool cleanSession;
+    uint16_t keepAliveS;
+    const char *const *topics;  ///< Topic filters, subscribed at QoS 1
+    unsigned topicCount;
+};
+
+typedef void (*MqttMessageFn)(void *context, const char *topic, const uint8_t *payload, size_t len);
+
+struct MqttSubscriber;
+
+struct MqttSubscriber *MqttSubscriberConnect(const struct MqttSubscriberOptions *options, int timeoutMs);
+int MqttSubscriberPoll(struct MqttSubscriber *sub, int timeoutMs, MqttMessageFn fn, void *context);
+void MqttSubscriberClose(struct MqttSubscriber *sub);
@@ -0,0 +1,271 @@
+/**************************************************************************/ /**
+ * @file      SegmentSynth.c
+ * @brief     Writes synthetic capture segments as the firmware records them, see SegmentSynth.h. Records are laid
+ *            out as CaptureSegmentsRecord does: a record never crosses a sector, and the first event of each
+ *            dictionary slot in a segment is a seed. The segment names start at a point of the ring given by the
+ *            seed, so the order of the names is not the order of the segments.
+ * @date      2026-10-19
+
+ ******************************************************************************/
+
+#include "SegmentSynth.h"
+
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "CaptureCodec/CaptureCodec.h"
+#include "CaptureSegments/CaptureSegments.h"
+#include "EventDedup/EventDedup.h"
+#include "SerialConsole.h"
+#include "crc32.h"
+
+#define SYNTH_FAT_TIME (((uint32_t)(2026 - 1980) << 25) | (10u << 21) | (19u << 16))
+#define SYNTH_DRAIN_US 1000  ///< A block is recorded this long after its last sample, as the FIFO is drained
+#define SYNTH_FRAME_SIZE (CAPTURE_CODEC_HEADER + SEGMENT_SYNTH_BLOCK * 6)
+
+struct SynthPoll {
+    uint16_t address;
+    uint16_t reg;
+    uint32_t periodUs;
+    uint64_t nextUs;
+};
+
+struct SynthWriter {
+    const struct SegmentSynthConfig *config;
+    struct SegmentSynthStats *stats;
+    FILE *fp;
+    uint32_t files;
+    uint32_t dataSectors;  ///< Record sectors per segment
+    uint32_t sectors;      ///< Record sectors of the open segment
+    uint64_t total;        ///< Record sectors to write
+    uint8_t sector[CAPTURE_SEGMENTS_SECTOR];
+    uint16_t fill;
+    uint8_t seeded;        ///< Dictionary slots with a template in the open segment
+    bool failed;
+};
+
+/// The codec times its encoder with this; nothing here looks at it
+uint32_t BusStatsNowUs(void)
+{
+    return 0;
+}
+
+static uint32_t SynthRandom(uint32_t *seed)
+{
+    *seed ^= *seed << 13;
+    *seed ^= *seed >> 17;
+    *seed ^= *seed << 5;
+    return *seed;
+}
+
+static void SynthPut32(uint8_t *p, uint32_t value)
+{
+    for (unsigned i = 0; i < 4; i++) {
+        p[i] = (uint8_t)(value >> (8 * i));
+    }
+}
+
+/// Writes the header of the open segment and closes it. The sectors past the records keep what was there.
+static void SynthClose(struct SynthWriter *w)
+{
+    struct CaptureSegmentHeader header;
+    crc32_t crc;
+
+    memset(&header, 0, sizeof(header));
+    header.magic = CAPTURE_SEGMENTS_MAGIC;
+    header.version = CAPTURE_SEGMENTS_VERSION;
+    header.seq = w->stats->segments;
+    header.used = w->sectors * CAPTURE_SEGMENTS_SECTOR;
+    header.start = SYNTH_FAT_TIME;
+    header.end = SYNTH_FAT_TIME;
+    crc32_calculate(&header, offsetof(struct CaptureSegmentHeader, check), &crc);
+    header.check = crc;
+    w->failed |= fseek(w->fp, 0, SEEK_SET) != 0 || fwrite(&header, sizeof(header), 1, w->fp) != 1;
+    w->failed |= fflush(w->fp) != 0 || ftruncate(fileno(w->fp), w->config->segmentBytes) != 0;
+    w->failed |= fclose(w->fp) != 0;
+    w->fp = NULL;
+}
+
+/// Opens the next segment: a header sector of zeros, then an old lap's worth of bytes that must not be decoded
+static void SynthOpen(struct SynthWriter *w)
+{
+    char path[1024];
+    uint8_t junk[CAPTURE_SEGMENTS_SECTOR];
+    uint32_t seed = w->config->seed + w->stats->segments + 1;
+
+    snprintf(path, sizeof(path), "%s/seg%02u.cap", w->config->dir,
+             (unsigned)((w->stats->segments + w->config->seed) % w->files));
+    w->fp = fopen(path, "w+b");
+    w->stats->segments++;
+    w->sectors = 0;
+    w->seeded = 0;
+    if (w->fp == NULL) {
+        w->failed = true;
+        return;
+    }
+    for (unsigned i = 0; i < sizeof(junk); i++) {
+        junk[i] = (uint8_t)SynthRandom(&seed);
+    }
+    // The last segment is not filled: its tail is left over from the lap before
+    if (w->total - w->stats->bytes / CAPTURE_SEGMENTS_SECTOR < w->dataSectors) {
+        for (uint32_t s = 0; s <= w->dataSectors; s++) {
+            w->failed |= fwrite(junk, sizeof(junk), 1, w->fp) != 1;
+        }
+    }
+    w->failed |= fseek(w->fp, CAPTURE_SEGMENTS_SECTOR, SEEK_SET) != 0;
+}
+
+static void SynthFlush(struct SynthWriter *w)
+{
+    if (w->fill == 0) {
+        return;
+    }
+    memset(&w->sector[w->fill], 0, sizeof(w->sector) - w->fill);
+    w->failed |= fwrite(w->sector, sizeof(w->sector), 1, w->fp) != 1;
+    w->fill = 0;
+    w->sectors++;
+    w->stats->bytes += CAPTURE_SEGMENTS_SECTOR;
+    if (w->sectors == w->dataSectors) {
+        SynthClose(w);
+    }
+}
+
+/// Adds a record as CaptureSegmentsRecord does. dict is the encoder dictionary after an event was encoded.
+/// Returns false once the records are written, without adding it.
+static bool SynthRecord(struct SynthWriter *w, uint8_t type, const uint8_t *payload, uint16_t len, const struct EventDedupDictionary *dict)
+{
+    uint8_t seed[EVENT_DEDUP_SEED_SIZE];
+    bool event = (type == SERIAL_STREAM_EVENT_TEMPLATE || type == SERIAL_STREAM_EVENT_REPEAT);
+    uint8_t slot = event ? (((type == SERIAL_STREAM_EVENT_TEMPLATE) ? payload[0] : (payload[0] >> 4)) % EVENT_DEDUP_SLOTS) : 0;
+
+    if (w->fill + CAPTURE_SEGMENTS_RECORD_HEADER + ((type == SERIAL_STREAM_EVENT_REPEAT) ? EVENT_DEDUP_SEED_SIZE : len) >
+        CAPTURE_SEGMENTS_SECTOR) {
+        SynthFlush(w);
+    }
+    if (w->stats->bytes >= w->total * CAPTURE_SEGMENTS_SECTOR) {
+        return false;
+    }
+    if (w->fp == NULL) {
+        SynthOpen(w);
+    }
+    if (type == SERIAL_STREAM_EVENT_REPEAT && !(w->seeded & (1 << slot))) {
+        const struct EventDedupSlot *s = &dict->slot[slot];
+        seed[0] = slot;
+        seed[1] = s->seq;
+        memcpy(&seed[2], s->event, EVENT_DEDUP_EVENT_SIZE);
+        SynthPut32(&seed[EVENT_DEDUP_MAX_SIZE], s->period);
+        type = SERIAL_STREAM_EVENT_TEMPLATE;
+        payload = seed;
+        len = EVENT_DEDUP_SEED_SIZE;
+    }
+    if (event) {
+        w->seeded |= (uint8_t)(1 << slot);
+    }
+    w->sector[w->fill] = type;
+    w->sector[w->fill + 1] = (uint8_t)len;
+    w->sector[w->fill + 2] = (uint8_t)(len >> 8);
+    memcpy(&w->sector[w->fill + CAPTURE_SEGMENTS_RECORD_HEADER], payload, len);
+    w->fill = (uint16_t)(w->fill + CAPTURE_SEGMENTS_RECORD_HEADER + len);
+    return true;
+}
+
+/// Time of a sample on the 64 bit clock the events are reported on
+uint64_t SegmentSynthSampleUs(const struct SegmentSynthConfig *config, uint64_t index)
+{
+    return config->startUs + index * config->periodUs;
+}
+
+/// Writes segments until config->bytes of records are written. Returns 0, or -1 if a file could not be written
+/// or the capture needs more than CAPTURE_SEGMENTS_MAX_COUNT segments.
+int SegmentSynthWrite(const struct SegmentSynthConfig *config, SegmentSynthEventFn onEvent, void *ctx, struct SegmentSynthStats *stats)
+{
+    struct SynthPoll polls[32];
+    struct SynthWriter w;
+    struct EventDedupDictionary dict;
+    uint8_t raw[SYNTH_FRAME_SIZE], packed[SYNTH_FRAME_SIZE], event[EVENT_DEDUP_EVENT_SIZE], ev[EVENT_DEDUP_MAX_SIZE];
+    uint32_t seed = config->seed | 1;
+    unsigned registers = (config->registers > 32) ? 32 : config->registers;
+    uint64_t sample = 0;
+
+    memset(stats, 0, sizeof(*stats));
+    memset(&w, 0, sizeof(w));
+    w.config = config;
+    w.stats = stats;
+    w.dataSectors = config->segmentBytes / CAPTURE_SEGMENTS_SECTOR - 1;
+    w.total = config->bytes / CAPTURE_SEGMENTS_SECTOR;
+    w.files = (uint32_t)((w.total + w.dataSectors - 1) / w.dataSectors);
+    if (w.dataSectors == 0 || w.files == 0 || w.files > CAPTURE_SEGMENTS_MAX_COUNT) {
+        return -1;
+    }
+    EventDedupInit(&dict);
+    for (unsigned i = 0; i < registers; i++) {
+        polls[i].address = (uint16_t)(0x40 + i / 3);
+        polls[i].reg = (uint16_t)(i * 7);
+        polls[i].periodUs = 1000 * (5 + SynthRandom(&seed) % 200);
+        polls[i].nextUs = config->startUs + SynthRandom(&seed) % polls[i].periodUs;
+    }
+
+    while (!w.failed) {
+        uint64_t blockUs = SegmentSynthSampleUs(config, sample + SEGMENT_SYNTH_BLOCK - 1) + SYNTH_DRAIN_US;
+        unsigned p = 0;
+        for (unsigned i = 1; i < registers; i++) {
+            p = (polls[i].nextUs < polls[p].nextUs) ? i : p;
+        }
+
+        if (registers > 0 && polls[p].nextUs + 250 < blockUs) {
+            // Jitter on the start, a duration that varies and now and then a failed transfer
+            uint32_t r = SynthRandom(&seed);
+            uint64_t start = polls[p].nextUs + r % 40;
+            uint32_t fields[3] = {((r >> 8) % 64 == 0) ? 0xFFFFFFFBu : 0, (uint32_t)start, 180 + (r >> 16) % 24};
+            uint8_t type;
+
+            event[0] = (uint8_t)polls[p].address;
+            event[1] = (uint8_t)(polls[p].address >> 8);
+            event[2] = (uint8_t)polls[p].reg;
+            event[3] = (uint8_t)(polls[p].reg >> 8);
+            for (unsigned i = 0; i < 3; i++) {
+                SynthPut32(&event[4 + 4 * i], fields[i]);
+            }
+            polls[p].nextUs += polls[p].periodUs;
+            uint8_t len = EventDedupEncode(&dict, event, ev, &type);
+            bool drop = config->dropEvery && SynthRandom(&seed) % config->dropEvery == 0;
+            if (drop) {
+                stats->dropped++;
+            } else if (SynthRecord(&w, type, ev, len, &dict)) {
+                stats->events++;
+            } else {
+                break;
+            }
+            if (onEvent != NULL) {
+                onEvent(ctx, start, event, drop);
+            }
+            continue;
+        }
+
+        uint16_t len = CAPTURE_CODEC_HEADER;
+        SynthPut32(raw, (uint32_t)SegmentSynthSampleUs(config, sample));
+        SynthPut32(raw + 4, (uint32_t)SegmentSynthSampleUs(config, sample + SEGMENT_SYNTH_BLOCK - 1));
+        raw[8] = 7;
+        raw[9] = SEGMENT_SYNTH_BLOCK;
+        for (unsigned i = 0; i < SEGMENT_SYNTH_BLOCK; i++) {
+            for (uint8_t a = 0; a < 3; a++) {
+                int16_t x = CaptureSynthSample(config->pattern, config->seed, (uint32_t)(sample + i), a);
+                raw[len++] = (uint8_t)x;
+                raw[len++] = (uint8_t)((uint16_t)x >> 8);
+            }
+        }
+        uint16_t packedLen = CaptureCodecEncode(raw, len, packed, sizeof(packed));
+        if (!((packedLen != 0) ? SynthRecord(&w, SERIAL_STREAM_CAPTURE_PACKED, packed, packedLen, NULL)
+                               : SynthRecord(&w, SERIAL_STREAM_CAPTURE, raw, len, NULL))) {
+            break;
+        }
+        sample += SEGMENT_SYNTH_BLOCK;
+        stats->samples += SEGMENT_SYNTH_BLOCK;
+    }
+    if (w.fp != NULL) {
+        SynthClose(&w);
+    }
+    return w.failed ? -1 : 0;
+}
@@ -0,0 +1,44 @@
+/**************************************************************************/ /**
+ * @file      SegmentSynth.h
+ * @brief     Writes synthetic capture segments as the firmware records them: IMU blocks of a CaptureSynth pattern
+ *            through the capture codec, polled bus events through the event dictionary with a seed for each slot
+ *            in each segment, in sectors of records behind a segment header. The samples are known from their
+ *            index and the events are handed to a callback, so an export can be checked against them.
+ * @date      2026-10-19
+
+ ******************************************************************************/
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "CaptureSynth/CaptureSynth.h"
+
+#define SEGMENT_SYNTH_BLOCK 16  ///< Samples per IMU block, as the IMU task sends them
+
+struct SegmentSynthConfig {
+    const char *dir;                  ///< Where seg00.cap... are written
+    uint64_t bytes;                   ///< Record bytes to write, in whole sectors
+    uint32_t segmentBytes;            ///< Size of a segment file with its header sector, a multiple of 512
+    enum CaptureSynthPattern pattern;
+    uint32_t seed;                    ///< Of the pattern, the bus and the file names
+    uint32_t startUs;                 ///< Device clock at the first sample
+    uint32_t periodUs;                ///< IMU sample period
+    uint8_t registers;                ///< Registers polled on the bus, 0 for no bus events
+    uint32_t dropEvery;               ///< About one bus event record in this many is dropped, as a full sector buffer does; 0 for none
+};
+
+struct SegmentSynthStats {
+    uint32_t segments;
+    uint64_t bytes;    ///< Record bytes, whole sectors
+    uint64_t samples;
+    uint64_t events;   ///< Recorded, without the dropped ones
+    uint64_t dropped;
+};
+
+/// Called for each bus event in time order with its start on a 64 bit clock, and whether its record was dropped
+typedef void (*SegmentSynthEventFn)(void *ctx, uint64_t startUs, const uint8_t *event, bool dropped);
+
+int SegmentSynthWrite(const struct SegmentSynthConfig *config, SegmentSynthEventFn onEvent, void *ctx, struct SegmentSynthStats *stats);
+uint64_t SegmentSynthSampleUs(const struct SegmentSynthConfig *config, uint64_t index);
@@ -0,0 +1,243 @@
+#!/usr/bin/env python3
+"""Copies files between a host and the SD card of the analyzer over the console UART.
+
+Speaks the transfer protocol of Application/src/SerialTransfer: SERIAL_STREAM_TRANSFER frames, each
+[type][seq][message][CRC-32 LE] COBS encoded and ended by 0x00. The "xfer" console command switches the UART to the
+transfer baud rate; this script sends it, runs one PUT or GET, and sends QUIT, which puts the console back in text
+mode.
+
+    xfer.py /dev/ttyACM0 put capture.csv            # local file -> SD card, same name
+    xfer.py /dev/ttyACM0 get log0001.bin out.bin     # SD card -> local file
+    xfer.py --self-test                               # frame codec check, no device needed
+
+Needs pyserial for the device commands.
+"""
+import argparse
+import binascii
+import struct
+import sys
+import time
+
+CONSOLE_BAUD = 115200         # SERIAL_CONSOLE_BAUDRATE
+DEFAULT_BAUD = 921600         # XFER_DEFAULT_BAUD
+CHUNK = 240                   # XFER_CHUNK
+RTO = 0.2                     # XFER_RTO_MS
+MAX_RETRIES = 10              # XFER_MAX_RETRIES
+TYPE_TRANSFER = 3             # SERIAL_STREAM_TRANSFER
+
+OP_PUT, OP_GET, OP_DATA, OP_ACK, OP_DONE, OP_RESULT, OP_QUIT = range(1, 8)
+STATUS = ["OK", "bad state", "no SD card", "file error", "size or CRC mismatch", "timeout"]
+
+
+def cobs_encode(data):
+    out = bytearray([0])
+    code_pos, code = 0, 1
+    for byte in data:
+        if byte:
+            out.append(byte)
+            code += 1
+        if not byte or code == 0xFF:
+            out[code_pos] = code
+            code_pos, code = len(out), 1
+            out.append(0)
+    out[code_pos] = code
+    return bytes(out)
+
+
+def cobs_decode(data):
+    out = bytearray()
+    i = 0
+    while i < len(data):
+        code = data[i]
+        if code == 0 or i + code > len(data) + (1 if code == 1 else 0):
+            raise ValueError("bad COBS block")
+        out += data[i + 1:i + code]
+        i += code
+        if code != 0xFF and i < len(data):
+            out.append(0)
+    return bytes(out)
+
+
+def frame_encode(seq, message):
+    body = bytes([TYPE_TRANSFER, seq & 0xFF]) + message
+    return cobs_encode(body + struct.pack("<I", binascii.crc32(body))) + b"\0"
+
+
+def frame_decode(encoded):
+    """Returns (type, seq, message), or None for a damaged frame"""
+    try:
+        raw = cobs_decode(encoded)
+    except ValueError:
+        return None
+    if len(raw) < 6 or struct.unpack("<I", raw[-4:])[0] != binascii.crc32(raw[:-4]):
+        return None
+    return raw[0], raw[1], raw[2:-4]
+
+
+class Link:
+    """Frames over a serial port"""
+
+    def __init__(self, port):
+        self.port = port
+        self.seq = 0
+        self.rx = bytearray()
+
+    def send(self, message):
+        self.port.write(frame_encode(self.seq, message))
+        self.seq = (self.seq + 1) & 0xFF
+
+    def recv(self, timeout):
+        """Next transfer message, None on timeout. Damaged frames and other frame types are skipped."""
+        deadline = time.monotonic() + timeout
+        while True:
+            end = self.rx.find(0)
+            if end >= 0:
+                encoded, self.rx = bytes(self.rx[:end]), self.rx[end + 1:]
+                frame = frame_decode(encoded) if encoded else None
+                if frame and frame[0] == TYPE_TRANSFER and frame[2]:
+                    return frame[2]
+                continue
+            left = deadline - time.monotonic()
+            if left <= 0:
+                return None
+            self.port.timeout = min(left, 0.05)
+            self.rx += self.port.read(max(1, self.port.in_waiting))
+
+    def result(self, timeout=2.0):
+        """Waits for a RESULT, returns (status, value)"""
+        deadline = time.monotonic() + timeout
+        while time.monotonic() < deadline:
+            msg = self.recv(deadline - time.monotonic())
+            if msg and msg[0] == OP_RESULT and len(msg) >= 6:
+                return msg[1], struct.unpack("<I", msg[2:6])[0]
+        raise TimeoutError("no answer from the device")
+
+
+def check(status, value, what):
+    if status != 0:
+        name = STATUS[status] if status < len(STATUS) else str(status)
+        raise RuntimeError("%s: %s (%d)" % (what, name, value))
+
+
+def put(link, data, name):
+    link.send(bytes([OP_PUT]) + name.encode())
+    status, window = link.result()
+    check(status, window, "PUT " + name)
+    base = sent = 0
+    retries = 0
+    while base < len(data):
+        while sent < len(data) and sent - base < window:
+            chunk = data[sent:sent + CHUNK]
+            link.send(struct.pack("<BI", OP_DATA, sent) + chunk)
+            sent += len(chunk)
+        msg = link.recv(RTO)
+        if msg and msg[0] == OP_ACK and len(msg) >= 5:
+            acked = struct.unpack("<I", msg[1:5])[0]
+            if acked > base:
+                base, retries = acked, 0
+            else:
+                sent = base  # Duplicate ACK: the device saw a gap
+        elif msg is None:
+            retries += 1
+            if retries > MAX_RETRIES:
+                raise TimeoutError("upload stalled at %d of %d bytes" % (base, len(data)))
+            sent = base  # Go back N
+        elif msg[0] == OP_RESULT:
+            check(msg[1], struct.unpack("<I", msg[2:6])[0], "PUT " + name)
+    link.send(struct.pack("<BII", OP_DONE, len(data), binascii.crc32(data)))
+    check(*link.result(), "DONE " + name)
+
+
+def get(link, name):
+    link.send(bytes([OP_GET]) + name.encode())
+    status, size = link.result()
+    check(status, size, "GET " + name)
+    data = bytearray()
+    while True:
+        msg = link.recv(RTO * (MAX_RETRIES + 2))
+        if msg is None:
+            raise TimeoutError("download stalled at %d of %d bytes" % (len(data), size))
+        if msg[0] == OP_DATA and len(msg) >= 5:
+            if struct.unpack("<I", msg[1:5])[0] == len(data):
+                data += msg[5:]
+            link.send(struct.pack("<BI", OP_ACK, len(data)))
+        elif msg[0] == OP_DONE and len(msg) >= 9:
+            total, crc = struct.unpack("<II", msg[1:9])
+            if total != len(data) or crc != binascii.crc32(bytes(data)):
+                raise RuntimeError("GET %s: size or CRC mismatch" % name)
+            return bytes(data)
+        elif msg[0] == OP_RESULT:
+            check(msg[1], struct.unpack("<I", msg[2:6])[0], "GET " + name)
+
+
+def session(args):
+    import serial  # pyserial
+
+    port = serial.Serial(args.port, CONSOLE_BAUD, timeout=0.5)
+    port.write(b"\rxfer %d\r" % args.baud)
+    port.flush()
+    deadline = time.monotonic() + 2.0
+    banner = b""
+    while b"Transfer mode at" not in banner and time.monotonic() < deadline:
+        banner += port.read(64)
+    if b"Transfer mode at" not in banner:
+        raise RuntimeError("the console did not enter transfer mode")
+    time.sleep(0.05)  # The device waits for its TX ring to drain before it changes the baud rate
+    port.baudrate = args.baud
+    port.reset_input_buffer()
+    link = Link(port)
+    try:
+        start = time.monotonic()
+        if args.op == "put":
+            data = open(args.src, "rb").read()
+            put(link, data, args.dst or args.src.replace("\\", "/").split("/")[-1])
+        else:
+            data = get(link, args.src)
+            open(args.dst or args.src.split("/")[-1], "wb").write(data)
+        took = time.monotonic() - start
+        print("%d bytes in %.2f s, %.1f kB/s" % (len(data), took, len(data) / max(took, 1e-6) / 1000))
+    finally:
+        link.send(bytes([OP_QUIT]))
+        try:
+            link.result()
+        except TimeoutError:
+            pass
+        port.baudrate = CONSOLE_BAUD
+
+
+def self_test():
+    # Same vectors as host/test/TestSerialFrame.c
+    assert binascii.crc32(b"123456789") == 0xCBF43926
+    assert cobs_encode(b"\0\0") == b"\x01\x01\x01"
+    body = bytes([TYPE_TRANSFER, 7]) + bytes(range(256)) * 2
+    for cut in range(len(body)):
+        msg = body[2:2 + cut]
+        frame = frame_encode(7, msg)
+        assert frame.count(0) == 1 and frame[-1] == 0
+        assert frame_decode(frame[:-1]) == (TYPE_TRANSFER, 7, msg)
+        bad = bytearray(frame[:-1])
+        bad[len(bad) // 2] ^= 0x10
+        assert 0 in bad or frame_decode(bytes(bad)) is None
+    print("self test passed")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n")[0])
+    parser.add_argument("--self-test", action="store_true", help="check the frame codec and exit")
+    parser.add_argument("--baud", type=int, default=DEFAULT_BAUD, help="transfer baud rate")
+    parser.add_argument("port", nargs="?")
+    parser.add_argument("op", nargs="?", choices=["put", "get"])
+    parser.add_argument("src", nargs="?", help="local file for put, SD card file for get")
+    parser.add_argument("dst", nargs="?", help="SD card name for put, local file for get")
+    args = parser.parse_args()
+    if args.self_test:
+        self_test()
+        return 0
+    if not (args.port and args.op and args.src):
+        parser.error("port, put|get and a file are required")
+    session(args)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())